@@ -49,6 +49,7 @@ ES_h264::ES_h264(uint16_t pes_pid)
   es_alloc_init                 = 240000;
   m_SPSRawId                    = -1;
   m_PPSRawId                    = -1;
+  m_SEIOffset                   = -1;
   m_fpsRate = 0;
   m_fpsScale = 0;
   m_recoveryPoint = false;
@@ -114,6 +115,15 @@ void ES_h264::Parse(STREAM_PKT* pkt)
           m_streamData.pps[m_SPSRawId].raw_data_size = 0;
         m_SPSRawId = -1, es_extraDataChanged = true;
       }
+      if (m_SEIOffset >= 0)
+      {
+        // The SEI NAL unit ends at this start code
+        int codeOffset = p >= 5 && es_buf[p - 5] == 0 ? 5 : 4;
+        size_t seiPos = es_consumed + m_SEIOffset;
+        if (p - codeOffset > seiPos)
+          ParseCaptionSEI(es_buf + seiPos, p - codeOffset - seiPos);
+        m_SEIOffset = -1;
+      }
       pOld = p - 1;
       if (Parse_H264(startcode, p, frameComplete) < 0)
       {
@@ -148,6 +158,7 @@ void ES_h264::Parse(STREAM_PKT* pkt)
       pkt->duration       = duration;
       pkt->streamChange   = SetVideoInformation(m_fpsScale << 1, m_fpsRate, m_Height, m_Width, static_cast<float>(DAR), m_Interlaced);
       pkt->recoveryPoint  = m_recoveryPoint;
+      SetCaptionData(pkt);
 
       if (es_extraDataChanged)
       {
@@ -172,6 +183,7 @@ void ES_h264::Parse(STREAM_PKT* pkt)
       }
       es_extraDataChanged = false;
     }
+    es_cc_parsed.clear();
     m_StartCode = 0xffffffff;
     es_parsed = es_consumed;
     es_found_frame = false;
@@ -188,6 +200,7 @@ void ES_h264::Reset()
   m_NeedSPS = true;
   m_NeedPPS = true;
   m_recoveryPoint = false;
+  m_SEIOffset = -1;
   memset(&m_streamData, 0, sizeof(m_streamData));
 }
 
@@ -253,6 +266,8 @@ int ES_h264::Parse_H264(uint32_t startcode, int buf_ptr, bool &complete)
       es_consumed = buf_ptr - 4;
       return -1;
     }
+    // Parsed for closed captions when the next start code is found
+    m_SEIOffset = buf_ptr - es_consumed;
     break;
 
   case NAL_SPS:
@@ -90,6 +90,7 @@ namespace TSDemux
 
     int             m_SPSRawId;
     int             m_PPSRawId;
+    int             m_SEIOffset;      /* SEI payload offset from the frame start, -1 if none */
 
     int Parse_H264(uint32_t startcode, int buf_ptr, bool &complete);
     bool Parse_PPS(uint8_t *buf, int len);
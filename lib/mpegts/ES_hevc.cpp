@@ -91,7 +91,9 @@ void ES_hevc::Parse(STREAM_PKT* pkt)
       pkt->pts      = m_PTS;
       pkt->duration = duration;
       pkt->streamChange = streamChange;
+      SetCaptionData(pkt);
     }
+    es_cc_parsed.clear();
     m_StartCode = 0xffffffff;
     m_LastStartPos = -1;
     es_parsed = es_consumed;
@@ -257,10 +259,14 @@ void ES_hevc::Parse_HEVC(int buf_ptr, unsigned int NumBytesInNalUnit, bool &comp
         complete = true;
         es_consumed = buf_ptr - 3;
       }
+      else if (NumBytesInNalUnit > 5)
+        ParseCaptionSEI(buf + 2, NumBytesInNalUnit - 5); // without header and next start code
       break;
 
     case NAL_SFX_SEI_NUT:
-       break;
+      if (NumBytesInNalUnit > 5)
+        ParseCaptionSEI(buf + 2, NumBytesInNalUnit - 5);
+      break;
 
     default:
       DBG(DEMUX_DBG_INFO, "HEVC fixme: nal unknown %i\n", hdr.nal_unit_type);
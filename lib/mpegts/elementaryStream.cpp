@@ -24,6 +24,7 @@ ElementaryStream::ElementaryStream(uint16_t pes_pid)
   , p_dts(PTS_UNSET)
   , p_pts(PTS_UNSET)
   , has_stream_info(false)
+  , is_sample_aes(false)
   , es_alloc_init(ES_INIT_BUFFER_SIZE)
   , es_buf(NULL)
   , es_alloc(0)
@@ -53,6 +54,8 @@ void ElementaryStream::Reset(void)
   ClearBuffer();
   es_found_frame = false;
   es_frame_valid = false;
+  es_cc_parsed.clear();
+  es_cc_data.clear();
 }
 
 void ElementaryStream::ClearBuffer()
@@ -204,6 +207,8 @@ void ElementaryStream::ResetStreamPacket(STREAM_PKT* pkt)
   pkt->duration           = 0;
   pkt->streamChange       = false;
   pkt->recoveryPoint      = false;
+  pkt->ccData             = NULL;
+  pkt->ccDataSize         = 0;
 }
 
 uint64_t ElementaryStream::Rescale(uint64_t a, uint64_t b, uint64_t c)
@@ -286,3 +291,73 @@ bool ElementaryStream::SetAudioInformation(int Channels, int SampleRate, int Bit
   has_stream_info = true;
   return ret;
 }
+
+/*
+ * Parse the SEI messages of a SEI NAL unit payload (after the NAL unit header),
+ * the CEA-608/708 cc_data carried as ATSC A/53 user data registered by
+ * ITU-T T.35 are appended to the cc_data of the frame being parsed
+ */
+void ElementaryStream::ParseCaptionSEI(const unsigned char* buf, size_t len)
+{
+  // Remove the emulation prevention bytes
+  std::vector<unsigned char> rbsp;
+  rbsp.reserve(len);
+  unsigned int zero_count = 0;
+  for (size_t i = 0; i < len; i++)
+  {
+    if (zero_count >= 2 && buf[i] == 3)
+    {
+      zero_count = 0;
+      continue;
+    }
+    zero_count = buf[i] == 0 ? zero_count + 1 : 0;
+    rbsp.push_back(buf[i]);
+  }
+
+  size_t p = 0;
+  size_t size = rbsp.size();
+  // The last byte is the rbsp_trailing_bits
+  while (p + 1 < size)
+  {
+    size_t payload_type = 0;
+    while (p < size && rbsp[p] == 0xff)
+      payload_type += 255, p++;
+    if (p >= size)
+      return;
+    payload_type += rbsp[p++];
+
+    size_t payload_size = 0;
+    while (p < size && rbsp[p] == 0xff)
+      payload_size += 255, p++;
+    if (p >= size)
+      return;
+    payload_size += rbsp[p++];
+
+    if (payload_size > size - p)
+      return;
+
+    // user_data_registered_itu_t_t35: country code USA, provider code ATSC,
+    // user identifier "GA94", user_data_type_code cc_data
+    const unsigned char* data = &rbsp[p];
+    if (payload_type == 4 && payload_size >= 10 &&
+        data[0] == 0xb5 && data[1] == 0x00 && data[2] == 0x31 &&
+        memcmp(data + 3, "GA94", 4) == 0 && data[7] == 0x03 &&
+        (data[8] & 0x40) != 0) // process_cc_data_flag
+    {
+      size_t cc_size = (data[8] & 0x1f) * 3;
+      if (cc_size > payload_size - 10)
+        cc_size = (payload_size - 10) / 3 * 3;
+      // Skip em_data
+      es_cc_parsed.insert(es_cc_parsed.end(), data + 10, data + 10 + cc_size);
+    }
+    p += payload_size;
+  }
+}
+
+void ElementaryStream::SetCaptionData(STREAM_PKT* pkt)
+{
+  es_cc_data.swap(es_cc_parsed);
+  es_cc_parsed.clear();
+  pkt->ccData = es_cc_data.empty() ? NULL : es_cc_data.data();
+  pkt->ccDataSize = es_cc_data.size();
+}
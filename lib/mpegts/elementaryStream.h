@@ -11,6 +11,7 @@
 
 #include <inttypes.h>
 #include <cstddef>    // for size_t
+#include <vector>
 
 #define ES_INIT_BUFFER_SIZE     64000
 #define ES_MAX_BUFFER_SIZE      1048576
@@ -74,6 +75,8 @@ namespace TSDemux
     uint64_t              duration;
     bool                  streamChange;
     bool                  recoveryPoint;
+    const unsigned char*  ccData;         ///< CEA-608/708 cc_data triplets of the video frame
+    size_t                ccDataSize;
   };
 
   class ElementaryStream
@@ -95,6 +98,7 @@ namespace TSDemux
     int64_t p_pts;               ///< previous MPEG stream PTS (presentation time for audio and video)
 
     bool has_stream_info;         ///< true if stream info is completed else it requires parsing of iframe
+    bool is_sample_aes;           ///< true if the stream is encrypted with HLS SAMPLE-AES
 
     STREAM_INFO stream_info;
 
@@ -106,6 +110,8 @@ namespace TSDemux
     uint64_t Rescale(uint64_t a, uint64_t b, uint64_t c);
     bool SetVideoInformation(int FpsScale, int FpsRate, int Height, int Width, float Aspect, bool Interlaced);
     bool SetAudioInformation(int Channels, int SampleRate, int BitRate, int BitsPerSample, int BlockAlign);
+    void ParseCaptionSEI(const unsigned char* buf, size_t len);
+    void SetCaptionData(STREAM_PKT* pkt);
 
     size_t es_alloc_init;         ///< Initial allocation of memory for buffer
     unsigned char* es_buf;        ///< The Pointer to buffer
@@ -117,6 +123,8 @@ namespace TSDemux
     bool   es_found_frame;        ///< Parser: Found frame
     bool   es_frame_valid;
     bool   es_extraDataChanged;
+    std::vector<unsigned char> es_cc_parsed; ///< Parser: cc_data of the frame being parsed
+    std::vector<unsigned char> es_cc_data;   ///< cc_data of the last frame packet
   };
 }
 
@@ -165,6 +165,16 @@ void AVContext::ResetPackets()
   {
     it->second.Reset();
   }
+  splice_info_sections.clear();
+}
+
+std::vector<std::vector<unsigned char> > AVContext::TakeSpliceInfoSections()
+{
+  PLATFORM::CLockObject lock(mutex);
+
+  std::vector<std::vector<unsigned char> > sections;
+  sections.swap(splice_info_sections);
+  return sections;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -198,6 +208,12 @@ uint64_t AVContext::decode_pts(const unsigned char* p)
   return pts;
 }
 
+bool AVContext::is_sample_aes_type(uint8_t pes_type)
+{
+  // Stream types of HLS SAMPLE-AES encrypted streams
+  return pes_type == 0xdb || pes_type == 0xcf || pes_type == 0xc1 || pes_type == 0xc2;
+}
+
 STREAM_TYPE AVContext::get_stream_type(uint8_t pes_type)
 {
   switch (pes_type)
@@ -215,9 +231,12 @@ STREAM_TYPE AVContext::get_stream_type(uint8_t pes_type)
     case 0x0f:
     case 0x11:
       return STREAM_TYPE_AUDIO_AAC;
+    case 0xcf: // HLS SAMPLE-AES
+      return STREAM_TYPE_AUDIO_AAC_ADTS;
     case 0x10:
       return STREAM_TYPE_VIDEO_MPEG4;
     case 0x1b:
+    case 0xdb: // HLS SAMPLE-AES
       return STREAM_TYPE_VIDEO_H264;
     case 0x24:
       return STREAM_TYPE_VIDEO_HEVC;
@@ -229,7 +248,10 @@ STREAM_TYPE AVContext::get_stream_type(uint8_t pes_type)
     case 0x83:
     case 0x84:
     case 0x87:
+    case 0xc1: // HLS SAMPLE-AES
       return STREAM_TYPE_AUDIO_AC3;
+    case 0xc2: // HLS SAMPLE-AES
+      return STREAM_TYPE_AUDIO_EAC3;
     case 0x82:
     case 0x85:
     case 0x8a:
@@ -819,7 +841,16 @@ int AVContext::parse_ts_psi()
         STREAM_TYPE stream_type = get_stream_type(pes_type);
         DBG(DEMUX_DBG_DEBUG, "%s: PMT(%.4x) version %u: new PES %.4x %s\n", __FUNCTION__,
                   this->packet->pid, version, pes_pid, ElementaryStream::GetStreamCodecName(stream_type));
-        if (stream_type != STREAM_TYPE_UNKNOWN)
+        if (pes_type == 0x86) // SCTE-35 splice info sections
+        {
+          Packet& sec = this->packets[pes_pid];
+          sec.pid = pes_pid;
+          sec.packet_type = PACKET_TYPE_PSI;
+          sec.channel = this->packet->channel;
+          DBG(DEMUX_DBG_DEBUG, "%s: PMT(%.4x) version %u: register SCTE-35 %.4x\n", __FUNCTION__,
+                  this->packet->pid, version, pes_pid);
+        }
+        else if (stream_type != STREAM_TYPE_UNKNOWN)
         {
           Packet& pes = this->packets[pes_pid];
           pes.pid = pes_pid;
@@ -872,6 +903,7 @@ int AVContext::parse_ts_psi()
 
           es->stream_type = stream_type;
           es->stream_info = stream_info;
+          es->is_sample_aes = is_sample_aes_type(pes_type);
           pes.stream = es;
           DBG(DEMUX_DBG_DEBUG, "%s: PMT(%.4x) version %u: register PES %.4x %s\n", __FUNCTION__,
                   this->packet->pid, version, pes_pid, es->GetStreamCodecName());
@@ -893,6 +925,21 @@ int AVContext::parse_ts_psi()
       this->packet->packet_table.version = version;
       return AVCONTEXT_PROGRAM_CHANGE;
     }
+    case 0xfc: // SCTE-35 splice info section
+    {
+      // store the complete section, from the table id
+      len = this->packet->packet_table.len;
+      std::vector<unsigned char> section(len + 3);
+      section[0] = 0xfc;
+      section[1] = 0x30 | ((len >> 8) & 0x0f);
+      section[2] = len & 0xff;
+      memcpy(&section[3], this->packet->packet_table.buf, len);
+      if (this->splice_info_sections.size() < MAX_SPLICE_INFO_SECTIONS)
+        this->splice_info_sections.push_back(section);
+      DBG(DEMUX_DBG_DEBUG, "%s: SCTE-35(%.4x) section length %u\n", __FUNCTION__,
+              this->packet->pid, (unsigned)len);
+      break;
+    }
     default:
       // CAT, NIT table
       break;
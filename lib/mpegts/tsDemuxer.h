@@ -25,6 +25,8 @@
 #define TS_CHECK_MIN_SCORE          2
 #define TS_CHECK_MAX_SCORE          10
 
+#define MAX_SPLICE_INFO_SECTIONS    16
+
 namespace TSDemux
 {
   class TSDemuxer
@@ -63,6 +65,9 @@ namespace TSDemux
     uint16_t GetChannel(uint16_t pid) const;
     void ResetPackets();
 
+    // Get and remove the SCTE-35 splice info sections found, from the table id
+    std::vector<std::vector<unsigned char> > TakeSpliceInfoSections();
+
     // TS parser
     int TSResync();
     uint64_t GoNext();
@@ -80,6 +85,7 @@ namespace TSDemux
 
     int configure_ts();
     static STREAM_TYPE get_stream_type(uint8_t pes_type);
+    static bool is_sample_aes_type(uint8_t pes_type);
     static uint8_t av_rb8(const unsigned char* p);
     static uint16_t av_rb16(const unsigned char* p);
     static uint32_t av_rb32(const unsigned char* p);
@@ -118,6 +124,9 @@ namespace TSDemux
     const unsigned char* payload;
     size_t payload_len;
     Packet* packet;
+
+    // SCTE-35 splice info sections
+    std::vector<std::vector<unsigned char> > splice_info_sections;
   };
 }
 
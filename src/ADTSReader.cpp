@@ -178,5 +178,5 @@ bool ADTSReader::ReadPacket()
 
     return m_frameParser.parse(m_stream);
   }
-  return true;
+  return false;
 }
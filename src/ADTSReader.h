@@ -11,7 +11,12 @@
 #include <stdint.h>
 #include <bento4/Ap4Types.h>
 #include <bento4/Ap4DataBuffer.h>
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "test/KodiStubs.h"
+#else
 #include <kodi/addon-instance/Inputstream.h>
+#endif
 
 class AP4_ByteStream;
 
@@ -35,7 +40,7 @@ private:
 
   uint8_t m_majorVer;
   uint8_t m_flags;
-  uint64_t m_timestamp;
+  uint64_t m_timestamp{0};
 };
 
 
@@ -87,5 +92,5 @@ private:
   ID3TAG m_id3TagParser;
   ADTSFrame m_frameParser;
   uint64_t m_basePts{0};
-  uint64_t m_pts;
+  uint64_t m_pts{ADTS_PTS_UNSET};
 };
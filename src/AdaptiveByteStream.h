@@ -40,6 +40,10 @@ public:
   bool waitingForSegment() const { return m_adStream->waitingForSegment(); }
   void FixateInitialization(bool on) { m_adStream->FixateInitialization(on); }
   void SetSegmentFileOffset(uint64_t offset) { m_adStream->SetSegmentFileOffset(offset); }
+  bool GetSampleAesKey(std::string& key, uint8_t* iv)
+  {
+    return m_adStream->GetSampleAesKey(key, iv);
+  }
 
 protected:
   adaptive::AdaptiveStream* m_adStream;
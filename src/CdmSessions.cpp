@@ -0,0 +1,245 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "CdmSessions.h"
+
+#include "common/AdaptiveDecrypter.h"
+#include "common/KeySystemHandlers.h"
+#include "utils/Base64Utils.h"
+#include "utils/StringUtils.h"
+#include "utils/Utils.h"
+#include "utils/log.h"
+
+#include <cstring>
+
+#include <bento4/Ap4.h>
+
+using namespace PLAYLIST;
+using namespace SESSION;
+using namespace UTILS;
+
+CCdmSessionFactory::CCdmSessionFactory(SSD::SSD_DECRYPTER& decrypter,
+                                       const DRM::IKeySystemHandler& handler,
+                                       const PROPERTIES::KodiProperties& kodiProps,
+                                       InitSegmentGetter getInitSegment)
+  : m_decrypter{decrypter},
+    m_handler{handler},
+    m_kodiProps{kodiProps},
+    m_getInitSegment{std::move(getInitSegment)}
+{
+}
+
+bool CCdmSessionFactory::GetInitData(CPeriod::PSSHSet& psshSet,
+                                     const uint8_t* systemId,
+                                     AP4_DataBuffer& initData,
+                                     const char*& optionalKeyParameter)
+{
+  optionalKeyParameter = nullptr;
+
+  if (psshSet.pssh_ == "FILE")
+  {
+    LOG::Log(LOGDEBUG, "Searching PSSH data in FILE");
+
+    if (m_kodiProps.m_licenseData.empty())
+      return GetInitDataFromInitSegment(psshSet, systemId, initData);
+
+    if (psshSet.defaultKID_.empty())
+      return false;
+
+    std::string licenseData = BASE64::Decode(m_kodiProps.m_licenseData);
+    // Replace KID placeholder, if any
+    STRING::ReplaceFirst(licenseData, "{KID}", psshSet.defaultKID_);
+
+    initData.SetData(reinterpret_cast<const AP4_Byte*>(licenseData.c_str()),
+                     static_cast<AP4_Size>(licenseData.size()));
+  }
+  else
+  {
+    std::vector<uint8_t> keySystemInitData;
+    if (!m_handler.GetInitData(psshSet, m_kodiProps, keySystemInitData, optionalKeyParameter))
+    {
+      LOG::Log(LOGERROR, "Cannot get the init data of the PSSH set");
+      return false;
+    }
+    initData.SetData(keySystemInitData.data(), static_cast<AP4_Size>(keySystemInitData.size()));
+  }
+  return true;
+}
+
+bool CCdmSessionFactory::GetInitDataFromInitSegment(CPeriod::PSSHSet& psshSet,
+                                                    const uint8_t* systemId,
+                                                    AP4_DataBuffer& initData)
+{
+  // The init segment is cached, so it will be not downloaded again when the stream start
+  std::string initSegmentData;
+  int trackType{AP4_Track::TYPE_UNKNOWN};
+  if (!m_getInitSegment || !m_getInitSegment(psshSet.adaptation_set_, initSegmentData, trackType))
+  {
+    LOG::Log(LOGERROR, "Cannot get the initialization segment to search PSSH data");
+    return false;
+  }
+
+  AP4_MemoryByteStream initSegmentStream{reinterpret_cast<const AP4_Byte*>(initSegmentData.data()),
+                                         static_cast<AP4_Size>(initSegmentData.size())};
+  AP4_File initSegmentFile{initSegmentStream, AP4_DefaultAtomFactory::Instance_, true};
+
+  AP4_Movie* movie{initSegmentFile.GetMovie()};
+  if (movie == NULL)
+  {
+    LOG::Log(LOGERROR, "No MOOV in stream!");
+    return false;
+  }
+  AP4_Array<AP4_PsshAtom>& pssh{movie->GetPsshAtoms()};
+
+  for (size_t i{0}; !initData.GetDataSize() && i < pssh.ItemCount(); i++)
+  {
+    if (std::memcmp(pssh[i].GetSystemId(), systemId, 16) != 0)
+      continue;
+
+    initData.AppendData(pssh[i].GetData().GetData(), pssh[i].GetData().GetDataSize());
+    if (!psshSet.defaultKID_.empty())
+      continue;
+
+    if (pssh[i].GetKid(0))
+    {
+      psshSet.defaultKID_ = std::string((const char*)pssh[i].GetKid(0), 16);
+    }
+    else if (AP4_Track* track = movie->GetTrack(static_cast<AP4_Track::Type>(trackType)))
+    {
+      AP4_ProtectedSampleDescription* m_protectedDesc =
+          static_cast<AP4_ProtectedSampleDescription*>(track->GetSampleDescription(0));
+      AP4_ContainerAtom* schi;
+      if (m_protectedDesc->GetSchemeInfo() &&
+          (schi = m_protectedDesc->GetSchemeInfo()->GetSchiAtom()))
+      {
+        AP4_TencAtom* tenc{AP4_DYNAMIC_CAST(AP4_TencAtom, schi->GetChild(AP4_ATOM_TYPE_TENC, 0))};
+        if (tenc)
+        {
+          psshSet.defaultKID_ =
+              std::string(reinterpret_cast<const char*>(tenc->GetDefaultKid()), 16);
+        }
+        else
+        {
+          AP4_PiffTrackEncryptionAtom* piff{
+              AP4_DYNAMIC_CAST(AP4_PiffTrackEncryptionAtom,
+                               schi->GetChild(AP4_UUID_PIFF_TRACK_ENCRYPTION_ATOM, 0))};
+          if (piff)
+          {
+            psshSet.defaultKID_ =
+                std::string(reinterpret_cast<const char*>(piff->GetDefaultKid()), 16);
+          }
+        }
+      }
+    }
+  }
+
+  if (!initData.GetDataSize())
+  {
+    LOG::Log(LOGERROR, "Could not extract license from video stream (PSSH not found)");
+    return false;
+  }
+  return true;
+}
+
+bool CCdmSessionFactory::CreateSessions(CPeriod& period,
+                                        const uint8_t* systemId,
+                                        bool addDefaultKID,
+                                        bool isLicenseDeferred,
+                                        std::vector<CCdmSession>& sessions)
+{
+  // cdmSession 0 is reserved for unencrypted streams
+  for (size_t ses{1}; ses < sessions.size(); ++ses)
+  {
+    AP4_DataBuffer init_data;
+    const char* optionalKeyParameter{nullptr};
+
+    CPeriod::PSSHSet& sessionPsshset = period.GetPSSHSets()[ses];
+    CCdmSession& session{sessions[ses]};
+
+    // The CDM open a single key system, the streams of the other ones cannot be played
+    if (!sessionPsshset.m_keySystem.empty() &&
+        !DRM::IsKeySystem(sessionPsshset.m_keySystem, m_handler.GetKeySystem()))
+    {
+      LOG::Log(LOGDEBUG, "Skipped PSSH set %zu of key system %s", ses,
+               sessionPsshset.m_keySystem.c_str());
+      session.m_decrypterCaps.flags = SSD::SSD_DECRYPTER::SSD_CAPS::SSD_INVALID;
+      period.RemovePSSHSet(static_cast<std::uint16_t>(ses));
+      continue;
+    }
+
+    if (!GetInitData(sessionPsshset, systemId, init_data, optionalKeyParameter))
+      return false;
+
+    std::string defaultKid{sessionPsshset.defaultKID_};
+    const uint8_t* defkid{
+        defaultKid.empty() ? nullptr : reinterpret_cast<const uint8_t*>(defaultKid.data())};
+
+    if (addDefaultKID && ses == 1 && session.m_cencSingleSampleDecrypter)
+    {
+      // If the CDM has been pre-initialized, on non-android systems
+      // we use the same session opened then we have to add the current KID
+      // because the session has been opened with a different PSSH/KID
+      session.m_cencSingleSampleDecrypter->AddKeyId(defaultKid);
+      session.m_cencSingleSampleDecrypter->SetDefaultKeyId(defaultKid);
+    }
+
+    if (!defaultKid.empty())
+    {
+      std::string hexKid{STRING::ToHexadecimal(defaultKid)};
+      LOG::Log(LOGDEBUG, "Initializing stream with KID: %s", hexKid.c_str());
+
+      for (size_t i{1}; i < ses; ++i)
+      {
+        if (m_decrypter.HasLicenseKey(sessions[i].m_cencSingleSampleDecrypter, defkid))
+        {
+          session.m_cencSingleSampleDecrypter = sessions[i].m_cencSingleSampleDecrypter;
+          session.m_sharedCencSsd = true;
+          break;
+        }
+      }
+    }
+    else
+    {
+      for (size_t i{1}; i < ses; ++i)
+      {
+        if (sessionPsshset.pssh_ == period.GetPSSHSets()[i].pssh_)
+        {
+          session.m_cencSingleSampleDecrypter = sessions[i].m_cencSingleSampleDecrypter;
+          session.m_sharedCencSsd = true;
+          break;
+        }
+      }
+      if (!session.m_cencSingleSampleDecrypter)
+      {
+        LOG::Log(LOGWARNING, "Initializing stream with unknown KID!");
+      }
+    }
+
+    if (init_data.GetDataSize() >= 4 &&
+        (session.m_cencSingleSampleDecrypter ||
+         (session.m_cencSingleSampleDecrypter = m_handler.CreateDecrypter(
+              m_decrypter, init_data, optionalKeyParameter, defaultKid, isLicenseDeferred,
+              sessionPsshset.m_cryptoMode)) != nullptr))
+    {
+      m_handler.GetCapabilities(m_decrypter, session.m_cencSingleSampleDecrypter, defkid,
+                                sessionPsshset.media_, session.m_decrypterCaps);
+
+      if (session.m_decrypterCaps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_INVALID)
+        period.RemovePSSHSet(static_cast<std::uint16_t>(ses));
+    }
+    else
+    {
+      LOG::Log(LOGERROR, "Initialize failed (SingleSampleDecrypter)");
+      for (size_t i(ses); i < sessions.size(); ++i)
+        sessions[i].m_cencSingleSampleDecrypter = nullptr;
+
+      return false;
+    }
+  }
+  return true;
+}
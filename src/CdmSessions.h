@@ -0,0 +1,121 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include "SSD_dll.h"
+#include "common/Period.h"
+#include "utils/PropertiesUtils.h"
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class Adaptive_CencSingleSampleDecrypter;
+class AP4_DataBuffer;
+
+namespace DRM
+{
+class IKeySystemHandler;
+} // namespace DRM
+
+namespace SESSION
+{
+/*!
+ * \brief The CDM session of a PSSH set.
+ */
+struct CCdmSession
+{
+  SSD::SSD_DECRYPTER::SSD_CAPS m_decrypterCaps;
+  Adaptive_CencSingleSampleDecrypter* m_cencSingleSampleDecrypter;
+  const char* m_cdmSessionStr = nullptr;
+  bool m_sharedCencSsd{false};
+};
+
+/*!
+ * \brief Create the CDM sessions of the PSSH sets of a period. The init data
+ *        of each PSSH set is taken from the manifest, from the license data
+ *        property or from the PSSH of the stream init segment, the PSSH sets
+ *        with a default KID already licensed or with the same PSSH share the
+ *        CDM session.
+ */
+class ATTR_DLL_LOCAL CCdmSessionFactory
+{
+public:
+  /*!
+   * \brief Get the init segment of the initial representation of an adaptation set.
+   * \param adp The adaptation set
+   * \param initSegment [OUT] The init segment data
+   * \param trackType [OUT] The AP4_Track::Type of the stream
+   * \return True if success, otherwise false
+   */
+  using InitSegmentGetter =
+      std::function<bool(PLAYLIST::CAdaptationSet* adp, std::string& initSegment, int& trackType)>;
+
+  /*!
+   * \param decrypter The DRM decrypter, must outlive this object
+   * \param handler The handler of the key system opened by the decrypter
+   * \param kodiProps The Kodi properties of the session
+   * \param getInitSegment The callback to get the init segment of the PSSH sets
+   *                       without PSSH in the manifest
+   */
+  CCdmSessionFactory(SSD::SSD_DECRYPTER& decrypter,
+                     const DRM::IKeySystemHandler& handler,
+                     const UTILS::PROPERTIES::KodiProperties& kodiProps,
+                     InitSegmentGetter getInitSegment);
+
+  /*!
+   * \brief Get the init data to create the CDM session of a PSSH set, the
+   *        default KID of the PSSH set is set from the init segment if missing.
+   * \param psshSet The PSSH set
+   * \param systemId The DRM system id (16 bytes) of the supported key system
+   * \param initData [OUT] The init data
+   * \param optionalKeyParameter [OUT] The optional key parameter of the decrypter
+   * \return True if success, otherwise false
+   */
+  bool GetInitData(PLAYLIST::CPeriod::PSSHSet& psshSet,
+                   const uint8_t* systemId,
+                   AP4_DataBuffer& initData,
+                   const char*& optionalKeyParameter);
+
+  /*!
+   * \brief Create the CDM sessions of the PSSH sets of the period, the session 0
+   *        is reserved for unencrypted streams. The PSSH sets not allowed by the
+   *        decrypter capabilities or of another key system are removed from the period.
+   * \param period The period
+   * \param systemId The DRM system id (16 bytes) of the supported key system
+   * \param addDefaultKID True to add the default KID to the pre-initialized session 1
+   * \param isLicenseDeferred True to create the sessions without the license request
+   * \param sessions [IN/OUT] The CDM sessions, sized as the PSSH sets
+   * \return True if success, otherwise false
+   */
+  bool CreateSessions(PLAYLIST::CPeriod& period,
+                      const uint8_t* systemId,
+                      bool addDefaultKID,
+                      bool isLicenseDeferred,
+                      std::vector<CCdmSession>& sessions);
+
+private:
+  bool GetInitDataFromInitSegment(PLAYLIST::CPeriod::PSSHSet& psshSet,
+                                  const uint8_t* systemId,
+                                  AP4_DataBuffer& initData);
+
+  SSD::SSD_DECRYPTER& m_decrypter;
+  const DRM::IKeySystemHandler& m_handler;
+  const UTILS::PROPERTIES::KodiProperties& m_kodiProps;
+  InitSegmentGetter m_getInitSegment;
+};
+
+} // namespace SESSION
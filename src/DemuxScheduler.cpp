@@ -0,0 +1,89 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "DemuxScheduler.h"
+
+using namespace SESSION;
+
+int CDemuxScheduler::Select(const std::vector<StreamState>& states)
+{
+  if (m_records.size() != states.size())
+    m_records.resize(states.size());
+
+  // The ready stream with the earliest sample
+  int selected{SELECT_NONE};
+  for (size_t i{0}; i < states.size(); ++i)
+  {
+    const StreamState& state = states[i];
+    StreamRecord& record = m_records[i];
+
+    if (state.m_status == StreamStatus::IDLE)
+    {
+      record.m_hasTime = false;
+    }
+    else if (state.m_status == StreamStatus::READY)
+    {
+      record.m_hasTime = true;
+      record.m_lastTime = state.m_time;
+
+      if (selected == SELECT_NONE || state.m_time < states[selected].m_time)
+        selected = static_cast<int>(i);
+    }
+  }
+
+  // Check if a waiting stream can deliver a sample that should come before,
+  // the last known timestamp of the stream is the lower bound of its next sample
+  bool isWaiting{false};
+  for (size_t i{0}; i < states.size(); ++i)
+  {
+    const StreamState& state = states[i];
+    if (state.m_status != StreamStatus::WAITING)
+      continue;
+
+    StreamRecord& record = m_records[i];
+    bool isBlocking{false};
+
+    if (selected == SELECT_NONE)
+      isBlocking = true;
+    else if (!record.m_hasTime)
+      isBlocking = state.m_isEssential; // Not started yet, position unknown
+    else if (state.m_isEssential)
+      isBlocking = record.m_lastTime <= states[selected].m_time;
+    else
+      isBlocking = record.m_lastTime + m_maxSkew < states[selected].m_time;
+
+    if (isBlocking)
+    {
+      record.m_waitCount++;
+      isWaiting = true;
+    }
+    else
+      record.m_skipCount++;
+  }
+
+  return isWaiting ? SELECT_WAIT : selected;
+}
+
+void CDemuxScheduler::Reset()
+{
+  for (StreamRecord& record : m_records)
+  {
+    record.m_hasTime = false;
+    record.m_lastTime = 0;
+  }
+}
+
+uint64_t CDemuxScheduler::GetWaitCount(size_t index) const
+{
+  return index < m_records.size() ? m_records[index].m_waitCount : 0;
+}
+
+uint64_t CDemuxScheduler::GetSkipCount(size_t index) const
+{
+  return index < m_records.size() ? m_records[index].m_skipCount : 0;
+}
@@ -0,0 +1,93 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+#include <cstdint>
+#include <vector>
+
+namespace SESSION
+{
+/*!
+ * \brief Choose the stream from which to demux the next sample.
+ *        The streams are interleaved by timestamp, but a lagging stream
+ *        that is waiting for data only hold back the other streams
+ *        when it could deliver an earlier sample. Non-essential streams
+ *        (e.g. subtitles, secondary audio) are tolerated to lag behind
+ *        up to a bounded skew, so they can't stall video and main audio.
+ */
+class ATTR_DLL_LOCAL CDemuxScheduler
+{
+public:
+  enum class StreamStatus
+  {
+    IDLE, // Disabled or at end of stream, not considered
+    READY, // A sample is ready to be demuxed
+    WAITING, // Sample read in progress or waiting for a segment
+  };
+
+  struct StreamState
+  {
+    StreamStatus m_status{StreamStatus::IDLE};
+    bool m_isEssential{true};
+    uint64_t m_time{0}; // DTS or PTS of the ready sample, used only when READY
+  };
+
+  static constexpr int SELECT_NONE = -1; // No stream can provide samples
+  static constexpr int SELECT_WAIT = -2; // Wait for a stream that is not ready
+
+  /*!
+   * \param maxSkew The maximum time a non-essential stream can lag
+   *                behind the other streams before they have to wait for it
+   */
+  explicit CDemuxScheduler(uint64_t maxSkew) : m_maxSkew{maxSkew} {}
+
+  /*!
+   * \brief Select the stream for the next sample.
+   * \param states The current state of each stream, by stream index
+   * \return The index of the stream to demux, otherwise SELECT_NONE or SELECT_WAIT
+   */
+  int Select(const std::vector<StreamState>& states);
+
+  /*!
+   * \brief Forget the last known stream timestamps, to be called when the
+   *        streams positions change (e.g. seek).
+   */
+  void Reset();
+
+  /*!
+   * \brief Get the number of times the stream has held back the others.
+   */
+  uint64_t GetWaitCount(size_t index) const;
+
+  /*!
+   * \brief Get the number of times the stream was not ready and the
+   *        others have been demuxed anyway within the tolerated skew.
+   */
+  uint64_t GetSkipCount(size_t index) const;
+
+private:
+  struct StreamRecord
+  {
+    bool m_hasTime{false};
+    uint64_t m_lastTime{0};
+    uint64_t m_waitCount{0};
+    uint64_t m_skipCount{0};
+  };
+
+  uint64_t m_maxSkew;
+  std::vector<StreamRecord> m_records;
+};
+
+} // namespace SESSION
@@ -0,0 +1,400 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "KeyRotation.h"
+
+#include "utils/log.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <kodi/tools/StringUtils.h>
+
+using namespace kodi::tools;
+using namespace SESSION;
+
+namespace
+{
+// Max number of decrypters created for the rotated keys, a live stream can
+// rotate the keys for hours, so the oldest licenses must be released
+constexpr size_t MAX_ROTATED_DECRYPTERS = 4;
+// Max number of PSSH init data remembered to not request again the same license
+constexpr size_t MAX_REQUESTED_INIT_DATA = 16;
+} // unnamed namespace
+
+CKeyRotation::CKeyRotation(SSD::SSD_DECRYPTER* decrypter,
+                           const uint8_t* systemId,
+                           CryptoMode cryptoMode)
+  : m_decrypter{decrypter}, m_cryptoMode{cryptoMode}
+{
+  std::memcpy(m_systemId, systemId, sizeof(m_systemId));
+}
+
+CKeyRotation::~CKeyRotation()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopping = true;
+    m_requests.clear();
+  }
+  m_cvRequest.notify_one();
+
+  // Wait the license acquisition in progress
+  if (m_thread.joinable())
+    m_thread.join();
+
+  for (Entry& entry : m_entries)
+  {
+    if (entry.m_isOwned)
+      m_decrypter->DestroySingleSampleDecrypter(entry.m_ssd);
+  }
+}
+
+bool CKeyRotation::AddDecrypter(Adaptive_CencSingleSampleDecrypter* ssd,
+                                const SSD::SSD_DECRYPTER::SSD_CAPS& caps)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if (!ssd || std::any_of(m_entries.begin(), m_entries.end(),
+                          [ssd](const Entry& entry) { return entry.m_ssd == ssd; }))
+    return false;
+
+  Entry entry;
+  entry.m_ssd = ssd;
+  entry.m_caps = caps;
+  m_entries.emplace_back(std::move(entry));
+  return true;
+}
+
+void CKeyRotation::AcquireLicense(std::string_view initData,
+                                  const std::vector<std::string>& keyIds,
+                                  uint32_t media)
+{
+  if (initData.size() < 4)
+    return;
+
+  // A PSSH that list only already licensed keys dont need a new license
+  if (!keyIds.empty() && HasAllKeys(keyIds))
+    return;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if (m_isStopping)
+    return;
+
+  auto requested = std::find(m_requestedInitData.begin(), m_requestedInitData.end(), initData);
+  if (requested != m_requestedInitData.end())
+  {
+    // Move to the most recently requested
+    std::rotate(requested, requested + 1, m_requestedInitData.end());
+    return;
+  }
+
+  m_requestedInitData.emplace_back(initData);
+  if (m_requestedInitData.size() > MAX_REQUESTED_INIT_DATA)
+    m_requestedInitData.pop_front();
+
+  Request request;
+  request.m_initData = initData;
+  request.m_defaultKeyId = keyIds.empty() ? "" : keyIds.front();
+  request.m_keyIds = keyIds;
+  request.m_media = media;
+
+  LOG::Log(LOGDEBUG, "Key rotation: requested license for new PSSH (KID: %s)",
+           StringUtils::ToHexadecimal(request.m_defaultKeyId).c_str());
+
+  m_requests.emplace_back(std::move(request));
+  StartWorker();
+}
+
+void CKeyRotation::AcquirePendingLicense(Adaptive_CencSingleSampleDecrypter* ssd,
+                                         std::string_view keyId,
+                                         uint32_t media)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  auto entry = std::find_if(m_entries.begin(), m_entries.end(),
+                            [ssd](const Entry& entry) { return entry.m_ssd == ssd; });
+  if (m_isStopping || entry == m_entries.end() || entry->m_isLicensePending)
+    return;
+
+  entry->m_isLicensePending = true;
+
+  Request request;
+  request.m_defaultKeyId = keyId;
+  request.m_media = media;
+  request.m_pendingSsd = ssd;
+  m_requests.emplace_back(std::move(request));
+  StartWorker();
+}
+
+bool CKeyRotation::GetCaps(Adaptive_CencSingleSampleDecrypter* ssd,
+                           SSD::SSD_DECRYPTER::SSD_CAPS& caps)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  auto entry = std::find_if(m_entries.begin(), m_entries.end(),
+                            [ssd](const Entry& entry) { return entry.m_ssd == ssd; });
+  if (entry == m_entries.end())
+    return false;
+
+  caps = entry->m_caps;
+  return true;
+}
+
+bool CKeyRotation::HasKey(Adaptive_CencSingleSampleDecrypter* ssd, const uint8_t* keyId)
+{
+  if (!ssd)
+    return false;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (std::any_of(m_entries.begin(), m_entries.end(), [ssd](const Entry& entry)
+                    { return entry.m_ssd == ssd && entry.m_isLicensePending; }))
+      return true;
+  }
+  return m_decrypter->HasLicenseKey(ssd, keyId);
+}
+
+CKeyRotation::KeyStatus CKeyRotation::GetDecrypter(const uint8_t* keyId,
+                                                   Adaptive_CencSingleSampleDecrypter*& ssd,
+                                                   SSD::SSD_DECRYPTER::SSD_CAPS& caps)
+{
+  Adaptive_CencSingleSampleDecrypter* keySsd{UseDecrypter(keyId)};
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  auto entry = std::find_if(m_entries.begin(), m_entries.end(),
+                            [keySsd](const Entry& entry) { return entry.m_ssd == keySsd; });
+  if (!keySsd || entry == m_entries.end())
+    return IsAcquiring() ? KeyStatus::PENDING : KeyStatus::NOT_AVAILABLE;
+
+  entry->m_lastUse = ++m_useTick;
+  ssd = entry->m_ssd;
+  caps = entry->m_caps;
+  return KeyStatus::AVAILABLE;
+}
+
+void CKeyRotation::ReleaseDecrypter(Adaptive_CencSingleSampleDecrypter* ssd)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  for (Entry& entry : m_entries)
+  {
+    if (entry.m_ssd == ssd && entry.m_useCount > 0)
+      entry.m_useCount--;
+  }
+}
+
+bool CKeyRotation::IsKeyPending(const uint8_t* keyId)
+{
+  Adaptive_CencSingleSampleDecrypter* ssd{UseDecrypter(keyId)};
+  if (ssd)
+  {
+    ReleaseDecrypter(ssd);
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return IsAcquiring();
+}
+
+Adaptive_CencSingleSampleDecrypter* CKeyRotation::UseDecrypter(const uint8_t* keyId)
+{
+  // The decrypters in use cannot be evicted, so they can be queried without
+  // hold the lock, a slow CDM must not block the other threads
+  std::vector<Adaptive_CencSingleSampleDecrypter*> ssds;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (Entry& entry : m_entries)
+    {
+      entry.m_useCount++;
+      ssds.emplace_back(entry.m_ssd);
+    }
+  }
+
+  Adaptive_CencSingleSampleDecrypter* keySsd{nullptr};
+  for (Adaptive_CencSingleSampleDecrypter* ssd : ssds)
+  {
+    if (m_decrypter->HasLicenseKey(ssd, keyId))
+    {
+      keySsd = ssd;
+      break;
+    }
+  }
+
+  // Release the other decrypters, the one found stay in use
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (Entry& entry : m_entries)
+  {
+    if (entry.m_ssd != keySsd && entry.m_useCount > 0 &&
+        std::find(ssds.begin(), ssds.end(), entry.m_ssd) != ssds.end())
+      entry.m_useCount--;
+  }
+  return keySsd;
+}
+
+bool CKeyRotation::HasAllKeys(const std::vector<std::string>& keyIds)
+{
+  for (const std::string& keyId : keyIds)
+  {
+    Adaptive_CencSingleSampleDecrypter* ssd{
+        keyId.size() == 16 ? UseDecrypter(reinterpret_cast<const uint8_t*>(keyId.data()))
+                           : nullptr};
+    if (!ssd)
+      return false;
+
+    ReleaseDecrypter(ssd);
+  }
+  return true;
+}
+
+void CKeyRotation::EvictDecrypters(std::vector<Adaptive_CencSingleSampleDecrypter*>& evicted)
+{
+  while (std::count_if(m_entries.begin(), m_entries.end(),
+                       [](const Entry& entry) { return entry.m_isOwned; }) >
+         static_cast<std::ptrdiff_t>(MAX_ROTATED_DECRYPTERS))
+  {
+    auto lru = m_entries.end();
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+      if (it->m_isOwned && it->m_useCount == 0 && (lru == m_entries.end() ||
+                                                    it->m_lastUse < lru->m_lastUse))
+        lru = it;
+    }
+    // All in use by the readers
+    if (lru == m_entries.end())
+      break;
+
+    // The license can be requested again when its PSSH will be found again
+    auto requested =
+        std::find(m_requestedInitData.begin(), m_requestedInitData.end(), lru->m_initData);
+    if (requested != m_requestedInitData.end())
+      m_requestedInitData.erase(requested);
+
+    evicted.emplace_back(lru->m_ssd);
+    m_entries.erase(lru);
+  }
+}
+
+void CKeyRotation::StartWorker()
+{
+  if (!m_thread.joinable())
+    m_thread = std::thread(&CKeyRotation::Worker, this);
+
+  m_cvRequest.notify_one();
+}
+
+void CKeyRotation::Worker()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  while (true)
+  {
+    m_cvRequest.wait(lock, [this] { return m_isStopping || !m_requests.empty(); });
+    if (m_isStopping)
+      break;
+
+    Request request{std::move(m_requests.front())};
+    m_requests.pop_front();
+    m_isAcquiring = true;
+
+    // The license request can take time, dont block the readers meanwhile
+    lock.unlock();
+
+    if (request.m_pendingSsd)
+    {
+      const bool isLicensed{request.m_pendingSsd->AcquirePendingLicense()};
+      LOG::Log(isLicensed ? LOGDEBUG : LOGERROR, "Deferred license %s",
+               isLicensed ? "acquired" : "not acquired, no keys available");
+
+      // The capabilities queried before the license are incomplete
+      SSD::SSD_DECRYPTER::SSD_CAPS caps{};
+      if (isLicensed)
+      {
+        const uint8_t* defaultKeyId{
+            request.m_defaultKeyId.size() == 16
+                ? reinterpret_cast<const uint8_t*>(request.m_defaultKeyId.data())
+                : nullptr};
+        m_decrypter->GetCapabilities(request.m_pendingSsd, defaultKeyId, request.m_media, caps);
+      }
+
+      lock.lock();
+      for (Entry& entry : m_entries)
+      {
+        if (entry.m_ssd != request.m_pendingSsd)
+          continue;
+
+        entry.m_isLicensePending = false;
+        if (isLicensed)
+        {
+          entry.m_caps = caps;
+          m_isCapsUpdated = true;
+        }
+      }
+      m_isAcquiring = false;
+      continue;
+    }
+
+    // The keys can have been licensed by a previous request
+    Adaptive_CencSingleSampleDecrypter* ssd{nullptr};
+    SSD::SSD_DECRYPTER::SSD_CAPS caps{};
+    if (request.m_keyIds.empty() || !HasAllKeys(request.m_keyIds))
+    {
+      AP4_DataBuffer initData{reinterpret_cast<const AP4_Byte*>(request.m_initData.data()),
+                              static_cast<AP4_Size>(request.m_initData.size())};
+      ssd = m_decrypter->CreateSingleSampleDecrypter(initData, nullptr, request.m_defaultKeyId,
+                                                     false, m_cryptoMode);
+      if (ssd)
+      {
+        const uint8_t* defaultKeyId{
+            request.m_defaultKeyId.empty()
+                ? nullptr
+                : reinterpret_cast<const uint8_t*>(request.m_defaultKeyId.data())};
+        m_decrypter->GetCapabilities(ssd, defaultKeyId, request.m_media, caps);
+
+        if (caps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_INVALID)
+        {
+          LOG::LogF(LOGERROR, "Key rotation: the decrypter of the new license is not usable");
+          m_decrypter->DestroySingleSampleDecrypter(ssd);
+          ssd = nullptr;
+        }
+      }
+      else
+        LOG::LogF(LOGERROR, "Key rotation: cannot acquire the license of the new PSSH");
+    }
+
+    std::vector<Adaptive_CencSingleSampleDecrypter*> evicted;
+    lock.lock();
+    if (ssd)
+    {
+      Entry entry;
+      entry.m_ssd = ssd;
+      entry.m_caps = caps;
+      entry.m_isOwned = true;
+      entry.m_initData = std::move(request.m_initData);
+      entry.m_lastUse = ++m_useTick;
+      m_entries.emplace_back(std::move(entry));
+      LOG::Log(LOGDEBUG, "Key rotation: license acquired (KID: %s)",
+               StringUtils::ToHexadecimal(request.m_defaultKeyId).c_str());
+
+      EvictDecrypters(evicted);
+    }
+    m_isAcquiring = false;
+
+    if (!evicted.empty())
+    {
+      lock.unlock();
+      for (Adaptive_CencSingleSampleDecrypter* evictedSsd : evicted)
+      {
+        LOG::Log(LOGDEBUG, "Key rotation: released the least recently used license");
+        m_decrypter->DestroySingleSampleDecrypter(evictedSsd);
+      }
+      lock.lock();
+    }
+  }
+}
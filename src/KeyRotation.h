@@ -0,0 +1,199 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include "SSD_dll.h"
+#include "common/AdaptiveDecrypter.h"
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace SESSION
+{
+/*!
+ * \brief Handle the key rotation of a DRM protected content.
+ *        When a new PSSH is found (in a fragment or by a manifest update)
+ *        the license is acquired ahead of use in a background thread,
+ *        then the sample readers can look up the decrypter that own the key
+ *        of the fragment to switch to it at the fragment boundary.
+ *        The same thread acquires the deferred licenses of the session decrypters.
+ *        Licenses are acquired one at a time, in the order of request.
+ *        The decrypters created for the rotated keys are kept up to a limit,
+ *        then the least recently used one not in use by a reader is destroyed.
+ */
+class ATTR_DLL_LOCAL CKeyRotation
+{
+public:
+  /*!
+   * \param decrypter The DRM decrypter, must outlive this object
+   * \param systemId The DRM system id (16 bytes) of the supported key system
+   * \param cryptoMode The encryption mode used to create the new decrypters
+   */
+  CKeyRotation(SSD::SSD_DECRYPTER* decrypter, const uint8_t* systemId, CryptoMode cryptoMode);
+  ~CKeyRotation();
+
+  const uint8_t* GetSystemId() const { return m_systemId; }
+
+  /*!
+   * \brief Add a decrypter created by the session initialization, the decrypter
+   *        is not owned, it must outlive this object.
+   * \param ssd The decrypter
+   * \param caps The decrypter capabilities
+   * \return True if added, false if already added or not valid
+   */
+  bool AddDecrypter(Adaptive_CencSingleSampleDecrypter* ssd,
+                    const SSD::SSD_DECRYPTER::SSD_CAPS& caps);
+
+  /*!
+   * \brief Request the license for new PSSH init data, it will be acquired in
+   *        background. The request is ignored when the same init data has been
+   *        already requested, or when all the KIDs are already licensed.
+   * \param initData The PSSH init data (the PSSH box or his payload)
+   * \param keyIds The KIDs (16 bytes each) listed by the PSSH, can be empty
+   * \param media The media type, see SSD_CAPS::SSD_MEDIA_*
+   */
+  void AcquireLicense(std::string_view initData,
+                      const std::vector<std::string>& keyIds,
+                      uint32_t media);
+
+  /*!
+   * \brief Request the license left pending by a decrypter created without
+   *        sending the license request (deferred license), it will be acquired
+   *        in background. The decrypter must be already added. Once the license
+   *        is acquired the decrypter capabilities are queried again, since
+   *        without keys they are incomplete (e.g. secure path, HDCP limit).
+   * \param ssd The decrypter
+   * \param keyId The default KID (16 bytes) of the stream, can be empty
+   * \param media The media type, see SSD_CAPS::SSD_MEDIA_*
+   */
+  void AcquirePendingLicense(Adaptive_CencSingleSampleDecrypter* ssd,
+                             std::string_view keyId,
+                             uint32_t media);
+
+  /*!
+   * \brief Check if the capabilities of some decrypter has been updated since
+   *        the last call, the update flag is cleared.
+   * \return True if updated, otherwise false
+   */
+  bool TakeUpdatedCaps() { return m_isCapsUpdated.exchange(false); }
+
+  /*!
+   * \brief Get the current capabilities of a decrypter.
+   * \param ssd The decrypter
+   * \param caps [OUT] The decrypter capabilities
+   * \return True if the decrypter has been found, otherwise false
+   */
+  bool GetCaps(Adaptive_CencSingleSampleDecrypter* ssd, SSD::SSD_DECRYPTER::SSD_CAPS& caps);
+
+  /*!
+   * \brief Check if a decrypter have the key. While the license of the decrypter
+   *        is pending, it is assumed to have the keys of the stream it has been
+   *        created for, the decrypt will wait the license.
+   * \param ssd The decrypter
+   * \param keyId The KID (16 bytes)
+   * \return True if the decrypter have the key, otherwise false
+   */
+  bool HasKey(Adaptive_CencSingleSampleDecrypter* ssd, const uint8_t* keyId);
+
+  enum class KeyStatus
+  {
+    AVAILABLE, // A decrypter have the key
+    PENDING, // Not available yet, some license is being acquired
+    NOT_AVAILABLE, // No license provide the key
+  };
+
+  /*!
+   * \brief Find the decrypter that have the key, it does not wait for the
+   *        pending licenses. A decrypter found is in use until released.
+   * \param keyId The KID (16 bytes)
+   * \param ssd [OUT] The decrypter
+   * \param caps [OUT] The decrypter capabilities
+   * \return The status of the key, the decrypter is set only when available
+   */
+  KeyStatus GetDecrypter(const uint8_t* keyId,
+                         Adaptive_CencSingleSampleDecrypter*& ssd,
+                         SSD::SSD_DECRYPTER::SSD_CAPS& caps);
+
+  /*!
+   * \brief Release a decrypter got by GetDecrypter, once released by all
+   *        the readers a decrypter of rotated keys can be destroyed.
+   * \param ssd The decrypter
+   */
+  void ReleaseDecrypter(Adaptive_CencSingleSampleDecrypter* ssd);
+
+  /*!
+   * \brief Check if the key is not available yet but some license is being acquired.
+   * \param keyId The KID (16 bytes)
+   * \return True if pending, otherwise false
+   */
+  bool IsKeyPending(const uint8_t* keyId);
+
+private:
+  struct Entry
+  {
+    Adaptive_CencSingleSampleDecrypter* m_ssd{nullptr};
+    SSD::SSD_DECRYPTER::SSD_CAPS m_caps{};
+    bool m_isOwned{false};
+    bool m_isLicensePending{false};
+    std::string m_initData; // The PSSH init data of an owned decrypter
+    unsigned int m_useCount{0}; // Number of readers that use the decrypter
+    uint64_t m_lastUse{0};
+  };
+
+  struct Request
+  {
+    std::string m_initData;
+    std::string m_defaultKeyId;
+    std::vector<std::string> m_keyIds;
+    uint32_t m_media{0};
+    // Decrypter with a pending license, when set the init data is not used
+    Adaptive_CencSingleSampleDecrypter* m_pendingSsd{nullptr};
+  };
+
+  /*!
+   * \brief Find the decrypter that have the key, the decrypter found is in use
+   *        until released. Must be called without hold the lock.
+   */
+  Adaptive_CencSingleSampleDecrypter* UseDecrypter(const uint8_t* keyId);
+  bool HasAllKeys(const std::vector<std::string>& keyIds);
+  bool IsAcquiring() const { return !m_requests.empty() || m_isAcquiring; }
+  void EvictDecrypters(std::vector<Adaptive_CencSingleSampleDecrypter*>& evicted);
+  void StartWorker();
+  void Worker();
+
+  SSD::SSD_DECRYPTER* m_decrypter;
+  uint8_t m_systemId[16];
+  CryptoMode m_cryptoMode;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cvRequest;
+  std::vector<Entry> m_entries;
+  std::deque<std::string> m_requestedInitData; // From the least recently requested
+  std::deque<Request> m_requests;
+  std::atomic<bool> m_isCapsUpdated{false};
+  uint64_t m_useTick{0};
+  bool m_isAcquiring{false};
+  bool m_isStopping{false};
+  std::thread m_thread;
+};
+
+} // namespace SESSION
@@ -44,7 +44,7 @@ namespace SSD
     {
       PROPERTY_HEADER
   };
-    static const uint32_t version = 22;
+    static const uint32_t version = 25;
 #if defined(ANDROID)
     virtual void* GetJNIEnv() = 0;
     virtual int GetSDKVersion() = 0;
@@ -10,6 +10,7 @@
 
 #include "aes_decrypter.h"
 #include "common/Chooser.h"
+#include "common/KeySystemHandlers.h"
 #include "parser/DASHTree.h"
 #include "parser/HLSTree.h"
 #include "parser/SmoothTree.h"
@@ -24,6 +25,7 @@
 #include "utils/Utils.h"
 #include "utils/log.h"
 
+#include <algorithm>
 #include <array>
 
 #include <kodi/addon-instance/Inputstream.h>
@@ -84,6 +86,10 @@ CSession::CSession(const PROPERTIES::KodiProperties& kodiProps,
       m_mediaTypeMask = static_cast<uint8_t>(~0);
   }
 
+  m_isAudioOnly = kodiProps.m_isAudioOnly;
+  if (m_isAudioOnly)
+    LOG::Log(LOGDEBUG, "Audio only mode enabled, the video downloads are suspended");
+
   if (!kodiProps.m_serverCertificate.empty())
   {
     std::string decCert{BASE64::Decode(kodiProps.m_serverCertificate)};
@@ -104,7 +110,7 @@ CSession::~CSession()
   m_reprChooser = nullptr;
 }
 
-void CSession::SetSupportedDecrypterURN(std::string& key_system)
+void CSession::SetSupportedDecrypterURN(std::vector<std::string>& keySystems)
 {
   typedef SSD::SSD_DECRYPTER* (*CreateDecryptorInstanceFunc)(SSD::SSD_HOST * host,
                                                              uint32_t version);
@@ -159,14 +165,21 @@ void CSession::SetSupportedDecrypterURN(std::string& key_system)
         if (m_dllHelper->RegisterSymbol(startup, "CreateDecryptorInstance"))
         {
           SSD::SSD_DECRYPTER* decrypter = startup(m_KodiHost.get(), SSD::SSD_HOST::version);
-          const char* suppUrn(0);
 
-          if (decrypter && (suppUrn = decrypter->SelectKeySytem(m_kodiProps.m_licenseType.c_str())))
+          // The license type can be a comma separated list of key systems
+          for (const std::string& licenseType : STRING::Split(m_kodiProps.m_licenseType, ','))
+          {
+            const char* suppUrn{decrypter ? decrypter->SelectKeySytem(licenseType.c_str())
+                                          : nullptr};
+            if (suppUrn)
+              keySystems.emplace_back(suppUrn);
+          }
+          if (!keySystems.empty())
           {
             LOG::Log(LOGDEBUG, "Found decrypter: %s", item.Path().c_str());
             success = true;
             m_decrypter = decrypter;
-            key_system = suppUrn;
+            DRM::SortKeySystems(keySystems);
             break;
           }
         }
@@ -185,6 +198,9 @@ void CSession::SetSupportedDecrypterURN(std::string& key_system)
 
 void CSession::DisposeSampleDecrypter()
 {
+  // Owns the decrypters of the rotated keys, must be released before the others
+  m_keyRotation.reset();
+
   if (m_decrypter)
   {
     for (auto& cdmSession : m_cdmSessions)
@@ -232,8 +248,11 @@ bool CSession::Initialize()
   // Get URN's wich are supported by this addon
   if (!m_kodiProps.m_licenseType.empty())
   {
-    SetSupportedDecrypterURN(m_adaptiveTree->m_supportedKeySystem);
-    LOG::Log(LOGDEBUG, "Supported URN: %s", m_adaptiveTree->m_supportedKeySystem.c_str());
+    SetSupportedDecrypterURN(m_adaptiveTree->m_supportedKeySystems);
+    for (const std::string& keySystem : m_adaptiveTree->m_supportedKeySystems)
+    {
+      LOG::Log(LOGDEBUG, "Supported URN: %s", keySystem.c_str());
+    }
   }
 
   // Preinitialize the DRM, if pre-initialisation data are provided
@@ -308,12 +327,131 @@ void CSession::CheckHDCP()
 
       const SSD::SSD_DECRYPTER::SSD_CAPS& ssd_caps = decrypterCaps[repr->m_psshSetPos];
 
-      if (repr->GetHdcpVersion() > ssd_caps.hdcpVersion ||
-          (ssd_caps.hdcpLimit > 0 && repr->GetWidth() * repr->GetHeight() > ssd_caps.hdcpLimit))
+      const bool isHdcpCompliant{
+          repr->GetHdcpVersion() <= ssd_caps.hdcpVersion &&
+          (ssd_caps.hdcpLimit == 0 || repr->GetWidth() * repr->GetHeight() <= ssd_caps.hdcpLimit)};
+
+      if (!isHdcpCompliant && m_streams.empty())
       {
         LOG::Log(LOGDEBUG, "Representation ID \"%s\" removed as not HDCP compliant",
                  repr->GetId().data());
         itRepr = adp->GetRepresentations().erase(itRepr);
+        continue;
+      }
+
+      // While playing the representations can be in use by the streams,
+      // so they are only excluded from the stream quality selection
+      if (repr->IsHdcpCompliant() != isHdcpCompliant)
+      {
+        LOG::Log(LOGDEBUG, "Representation ID \"%s\" %s as not HDCP compliant",
+                 repr->GetId().data(), isHdcpCompliant ? "no longer excluded" : "excluded");
+        repr->SetIsHdcpCompliant(isHdcpCompliant);
+      }
+      itRepr++;
+    }
+  }
+}
+
+void CSession::SetSecurePath(CCdmSession& session)
+{
+  session.m_cdmSessionStr = session.m_cencSingleSampleDecrypter->GetSessionId();
+
+  if (m_settingNoSecureDecoder && !m_kodiProps.m_isLicenseForceSecureDecoder &&
+      !m_adaptiveTree->m_currentPeriod->IsSecureDecodeNeeded())
+    session.m_decrypterCaps.flags &= ~SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SECURE_DECODER;
+}
+
+void CSession::RefreshDecrypterCaps()
+{
+  if (!m_keyRotation || !m_keyRotation->TakeUpdatedCaps())
+    return;
+
+  bool isSecureVideoSession{false};
+  bool isCapsChanged{false};
+
+  for (size_t ses{1}; ses < m_cdmSessions.size(); ++ses)
+  {
+    CCdmSession& session{m_cdmSessions[ses]};
+    SSD::SSD_DECRYPTER::SSD_CAPS caps;
+    if (!session.m_cencSingleSampleDecrypter ||
+        !m_keyRotation->GetCaps(session.m_cencSingleSampleDecrypter, caps))
+      continue;
+
+    CCdmSession refreshed{session};
+    refreshed.m_decrypterCaps = caps;
+    if (!(caps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_INVALID) &&
+        (caps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SECURE_PATH))
+      SetSecurePath(refreshed);
+
+    const SSD::SSD_DECRYPTER::SSD_CAPS& newCaps{refreshed.m_decrypterCaps};
+    if (newCaps.flags != session.m_decrypterCaps.flags ||
+        newCaps.hdcpVersion != session.m_decrypterCaps.hdcpVersion ||
+        newCaps.hdcpLimit != session.m_decrypterCaps.hdcpLimit)
+    {
+      LOG::Log(LOGDEBUG, "Decrypter capabilities of session %zu updated by the license", ses);
+      if (newCaps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_INVALID)
+        LOG::Log(LOGERROR, "The license of session %zu does not allow the decryption", ses);
+      session = refreshed;
+      isCapsChanged = true;
+    }
+
+    if ((session.m_decrypterCaps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SECURE_PATH) &&
+        !(session.m_decrypterCaps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_INVALID))
+      isSecureVideoSession = true;
+  }
+
+  if (!isCapsChanged)
+    return;
+
+  if (!m_settingIsHdcpOverride)
+    CheckHDCP();
+
+  m_reprChooser->SetSecureSession(isSecureVideoSession);
+  // The stream info must be updated, e.g. the crypto session of the secure path
+  m_changed = true;
+}
+
+void CSession::CheckVideoCodecs()
+{
+  const UTILS::PROPERTIES::ChooserProps& props{m_kodiProps.m_chooserProps};
+  if (props.m_videoCodecs.empty() && props.m_videoCodecsSecure.empty())
+    return;
+
+  auto isSupported = [&](const std::unique_ptr<CRepresentation>& repr)
+  {
+    const bool isSecureDecoder{repr->m_psshSetPos < m_cdmSessions.size() &&
+                               (m_cdmSessions[repr->m_psshSetPos].m_decrypterCaps.flags &
+                                SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SECURE_DECODER)};
+    const std::set<std::string>& codecs{isSecureDecoder && !props.m_videoCodecsSecure.empty()
+                                            ? props.m_videoCodecsSecure
+                                            : props.m_videoCodecs};
+    return codecs.empty() || codecs.count(GetVideoCodecFamily(repr->GetFirstCodec())) > 0;
+  };
+
+  uint32_t adpIndex{0};
+  CAdaptationSet* adp{nullptr};
+
+  while ((adp = m_adaptiveTree->GetAdaptationSet(adpIndex++)))
+  {
+    if (adp->GetStreamType() != StreamType::VIDEO)
+      continue;
+
+    auto& reprs = adp->GetRepresentations();
+    // Keep the adaptation set as is when none of the codecs are declared, let the decoder try
+    if (std::none_of(reprs.begin(), reprs.end(), isSupported))
+    {
+      LOG::Log(LOGWARNING, "No representation with a supported video codec in adaptation set "
+                           "ID \"%s\"", adp->GetId().data());
+      continue;
+    }
+
+    for (auto itRepr = reprs.begin(); itRepr != reprs.end();)
+    {
+      if (!isSupported(*itRepr))
+      {
+        LOG::Log(LOGDEBUG, "Representation ID \"%s\" removed as the codec is not supported",
+                 (*itRepr)->GetId().data());
+        itRepr = reprs.erase(itRepr);
       }
       else
         itRepr++;
@@ -358,10 +496,22 @@ bool CSession::PreInitializeDRM(std::string& challengeB64,
     return false;
   }
 
+  // Set the provided PSSH
+  std::string decPssh{BASE64::Decode(psshData)};
+
   if (!m_decrypter->HasCdmSession())
   {
-    if (!m_decrypter->OpenDRMSystem(m_kodiProps.m_licenseKey.c_str(), m_serverCertificate,
-                                    m_drmConfig))
+    // The key system of the PSSH box, otherwise the cheapest one supported
+    const DRM::KeySystemInfo* psshKeySystem{
+        decPssh.size() >= 28
+            ? DRM::ResolveKeySystem(reinterpret_cast<const uint8_t*>(decPssh.data()) + 12)
+            : nullptr};
+    const std::string licenseKey{
+        SelectCdmKeySystem(psshKeySystem ? psshKeySystem->m_name : "", m_kodiProps.m_licenseKey)};
+    if (licenseKey.empty())
+      return false;
+
+    if (!m_decrypter->OpenDRMSystem(licenseKey.c_str(), m_serverCertificate, m_drmConfig))
     {
       LOG::LogF(LOGERROR, "OpenDRMSystem failed");
       return false;
@@ -372,8 +522,6 @@ bool CSession::PreInitializeDRM(std::string& challengeB64,
   init_data.SetBufferSize(1024);
   const char* optionalKeyParameter{nullptr};
 
-  // Set the provided PSSH
-  std::string decPssh{BASE64::Decode(psshData)};
   init_data.SetData(reinterpret_cast<const AP4_Byte*>(decPssh.data()), decPssh.size());
 
   // Decode the provided KID
@@ -408,6 +556,29 @@ bool CSession::PreInitializeDRM(std::string& challengeB64,
   return true;
 }
 
+std::string CSession::SelectCdmKeySystem(std::string_view keySystem, std::string_view licenseKey)
+{
+  const std::vector<std::string>& supported{m_adaptiveTree->m_supportedKeySystems};
+  auto itKeySystem = std::find_if(supported.begin(), supported.end(),
+                                  [keySystem](const std::string& supportedKeySystem)
+                                  { return DRM::IsSameKeySystem(keySystem, supportedKeySystem); });
+  // Supported key systems are sorted from the cheapest one
+  if (itKeySystem == supported.end())
+    itKeySystem = supported.begin();
+
+  const DRM::IKeySystemHandler* handler{
+      itKeySystem != supported.end() ? DRM::GetHandler(*itKeySystem) : nullptr};
+  if (!handler || !m_decrypter->SelectKeySytem(handler->GetInfo().m_name.data()))
+  {
+    LOG::LogF(LOGERROR, "No key system supported by the decrypter");
+    return "";
+  }
+
+  m_cdmKeySystem = *itKeySystem;
+  LOG::Log(LOGDEBUG, "CDM key system: %s", m_cdmKeySystem.c_str());
+  return handler->GetLicenseRequestTemplate(licenseKey);
+}
+
 bool CSession::InitializeDRM(bool addDefaultKID /* = false */)
 {
   bool isSecureVideoSession{false};
@@ -439,231 +610,94 @@ bool CSession::InitializeDRM(bool addDefaultKID /* = false */)
 
     if (!m_decrypter->HasCdmSession())
     {
+      // The CDM open a single key system, the cheapest one of the PSSH sets is used
+      std::vector<std::string_view> keySystems;
+      for (const CPeriod::PSSHSet& psshSet : m_adaptiveTree->m_currentPeriod->GetPSSHSets())
+      {
+        if (!psshSet.m_keySystem.empty())
+          keySystems.emplace_back(psshSet.m_keySystem);
+      }
+      licenseKey = SelectCdmKeySystem(
+          DRM::SelectKeySystem(keySystems, m_adaptiveTree->m_supportedKeySystems), licenseKey);
+      if (licenseKey.empty())
+        return false;
+
       if (!m_decrypter->OpenDRMSystem(licenseKey.c_str(), m_serverCertificate, m_drmConfig))
       {
         LOG::Log(LOGERROR, "OpenDRMSystem failed");
         return false;
       }
     }
-    std::string strkey(m_adaptiveTree->m_supportedKeySystem.substr(9));
-    size_t pos;
-    while ((pos = strkey.find('-')) != std::string::npos)
-      strkey.erase(pos, 1);
-    if (strkey.size() != 32)
+    unsigned char key_system[16];
+    const DRM::IKeySystemHandler* handler{DRM::GetHandler(m_cdmKeySystem)};
+    if (!handler || !DRM::ParseSystemId(m_cdmKeySystem, key_system))
     {
-      LOG::Log(LOGERROR, "Key system mismatch (%s)!", m_adaptiveTree->m_supportedKeySystem.c_str());
+      LOG::Log(LOGERROR, "Key system mismatch (%s)!", m_cdmKeySystem.c_str());
       return false;
     }
 
-    unsigned char key_system[16];
-    AP4_ParseHex(strkey.c_str(), key_system, 16);
+#if defined(ANDROID)
+    // MediaDrm needs the keys to configure the secure decoder of the streams
+    const bool isLicenseDeferred{false};
+#else
+    // The license is requested in background, the clear lead of the streams
+    // is played meanwhile and the decrypt waits the license when needed
+    const bool isLicenseDeferred{m_kodiProps.m_isLicenseDeferred};
+#endif
 
-    // cdmSession 0 is reserved for unencrypted streams
-    for (size_t ses{1}; ses < m_cdmSessions.size(); ++ses)
+    auto getInitSegment = [this](CAdaptationSet* adp, std::string& initSegment, int& trackType)
     {
-      AP4_DataBuffer init_data;
-      const char* optionalKeyParameter{nullptr};
-
-      CPeriod::PSSHSet& sessionPsshset = m_adaptiveTree->m_currentPeriod->GetPSSHSets()[ses];
-
-      if (sessionPsshset.pssh_ == "FILE")
-      {
-        LOG::Log(LOGDEBUG, "Searching PSSH data in FILE");
-
-        if (m_kodiProps.m_licenseData.empty())
-        {
-          auto initialRepr{m_reprChooser->GetRepresentation(sessionPsshset.adaptation_set_)};
-
-          CStream stream{*m_adaptiveTree, sessionPsshset.adaptation_set_, initialRepr, m_kodiProps,
-                         false};
-
-          stream.m_isEnabled = true;
-          stream.m_adStream.start_stream();
-          stream.SetAdByteStream(std::make_unique<CAdaptiveByteStream>(&stream.m_adStream));
-          stream.SetStreamFile(std::make_unique<AP4_File>(*stream.GetAdByteStream(),
-                                                          AP4_DefaultAtomFactory::Instance_, true));
-          AP4_Movie* movie{stream.GetStreamFile()->GetMovie()};
-          if (movie == NULL)
-          {
-            LOG::Log(LOGERROR, "No MOOV in stream!");
-            stream.Disable();
-            return false;
-          }
-          AP4_Array<AP4_PsshAtom>& pssh{movie->GetPsshAtoms()};
-
-          for (size_t i{0}; !init_data.GetDataSize() && i < pssh.ItemCount(); i++)
-          {
-            if (memcmp(pssh[i].GetSystemId(), key_system, 16) == 0)
-            {
-              init_data.AppendData(pssh[i].GetData().GetData(), pssh[i].GetData().GetDataSize());
-              if (sessionPsshset.defaultKID_.empty())
-              {
-                if (pssh[i].GetKid(0))
-                {
-                  sessionPsshset.defaultKID_ = std::string((const char*)pssh[i].GetKid(0), 16);
-                }
-                else if (AP4_Track* track = movie->GetTrack(
-                             static_cast<AP4_Track::Type>(stream.m_adStream.GetTrackType())))
-                {
-                  AP4_ProtectedSampleDescription* m_protectedDesc =
-                      static_cast<AP4_ProtectedSampleDescription*>(track->GetSampleDescription(0));
-                  AP4_ContainerAtom* schi;
-                  if (m_protectedDesc->GetSchemeInfo() &&
-                      (schi = m_protectedDesc->GetSchemeInfo()->GetSchiAtom()))
-                  {
-                    AP4_TencAtom* tenc{
-                        AP4_DYNAMIC_CAST(AP4_TencAtom, schi->GetChild(AP4_ATOM_TYPE_TENC, 0))};
-                    if (tenc)
-                    {
-                      sessionPsshset.defaultKID_ =
-                          std::string(reinterpret_cast<const char*>(tenc->GetDefaultKid()), 16);
-                    }
-                    else
-                    {
-                      AP4_PiffTrackEncryptionAtom* piff{
-                          AP4_DYNAMIC_CAST(AP4_PiffTrackEncryptionAtom,
-                                           schi->GetChild(AP4_UUID_PIFF_TRACK_ENCRYPTION_ATOM, 0))};
-                      if (piff)
-                      {
-                        sessionPsshset.defaultKID_ =
-                            std::string(reinterpret_cast<const char*>(piff->GetDefaultKid()), 16);
-                      }
-                    }
-                  }
-                }
-              }
-            }
-          }
-
-          if (!init_data.GetDataSize())
-          {
-            LOG::Log(LOGERROR, "Could not extract license from video stream (PSSH not found)");
-            stream.Disable();
-            return false;
-          }
-          stream.Disable();
-        }
-        else if (!sessionPsshset.defaultKID_.empty())
-        {
-          std::string licenseData = BASE64::Decode(m_kodiProps.m_licenseData);
-          // Replace KID placeholder, if any
-          STRING::ReplaceFirst(licenseData, "{KID}", sessionPsshset.defaultKID_);
-
-          init_data.SetData(reinterpret_cast<const AP4_Byte*>(licenseData.c_str()),
-                            static_cast<AP4_Size>(licenseData.size()));
-        }
-        else
-          return false;
-      }
-      else
-      {
-        if (m_kodiProps.m_manifestType == PROPERTIES::ManifestType::ISM)
-        {
-          if (m_kodiProps.m_licenseType == "com.widevine.alpha")
-          {
-            std::string licenseData{m_kodiProps.m_licenseData};
-            if (licenseData.empty())
-              licenseData = "e0tJRH0="; // {KID}
-            std::vector<uint8_t> init_data_v;
-            CreateISMlicense(sessionPsshset.defaultKID_, licenseData, init_data_v);
-            init_data.SetData(init_data_v.data(), init_data_v.size());
-          }
-          else
-          {
-            init_data.SetData(reinterpret_cast<const uint8_t*>(sessionPsshset.pssh_.data()),
-                              sessionPsshset.pssh_.size());
-            optionalKeyParameter =
-                m_kodiProps.m_licenseData.empty() ? nullptr : m_kodiProps.m_licenseData.c_str();
-          }
-        }
-        else
-        {
-          std::string decPssh{BASE64::Decode(sessionPsshset.pssh_)};
-          init_data.SetBufferSize(1024);
-          init_data.SetData(reinterpret_cast<const AP4_Byte*>(decPssh.data()), decPssh.size());
-        }
-      }
+      auto initialRepr{m_reprChooser->GetRepresentation(adp)};
+      CStream stream{*m_adaptiveTree, adp, initialRepr, m_kodiProps, false};
+      trackType = stream.m_adStream.GetTrackType();
+      return stream.m_adStream.GetInitSegmentData(initSegment);
+    };
+
+    CCdmSessionFactory sessionFactory{*m_decrypter, *handler, m_kodiProps, getInitSegment};
+    if (!sessionFactory.CreateSessions(*m_adaptiveTree->m_currentPeriod, key_system,
+                                       addDefaultKID, isLicenseDeferred, m_cdmSessions))
+    {
+      return false;
+    }
 
+    for (size_t ses{1}; ses < m_cdmSessions.size(); ++ses)
+    {
       CCdmSession& session{m_cdmSessions[ses]};
-      std::string defaultKid{sessionPsshset.defaultKID_};
-      const uint8_t* defkid{
-          defaultKid.empty() ? nullptr : reinterpret_cast<const uint8_t*>(defaultKid.data())};
-
-      if (addDefaultKID && ses == 1 && session.m_cencSingleSampleDecrypter)
+      if (!(session.m_decrypterCaps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_INVALID) &&
+          (session.m_decrypterCaps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SECURE_PATH))
       {
-        // If the CDM has been pre-initialized, on non-android systems
-        // we use the same session opened then we have to add the current KID
-        // because the session has been opened with a different PSSH/KID
-        session.m_cencSingleSampleDecrypter->AddKeyId(defaultKid);
-        session.m_cencSingleSampleDecrypter->SetDefaultKeyId(defaultKid);
+        SetSecurePath(session);
+        isSecureVideoSession = true;
       }
+    }
 
-      if (m_decrypter && !defaultKid.empty())
-      {
-        std::string hexKid{StringUtils::ToHexadecimal(defaultKid)};
-        LOG::Log(LOGDEBUG, "Initializing stream with KID: %s", hexKid.c_str());
-
-        for (size_t i{1}; i < ses; ++i)
-        {
-          if (m_decrypter->HasLicenseKey(m_cdmSessions[i].m_cencSingleSampleDecrypter, defkid))
-          {
-            session.m_cencSingleSampleDecrypter = m_cdmSessions[i].m_cencSingleSampleDecrypter;
-            session.m_sharedCencSsd = true;
-            break;
-          }
-        }
+    // Licenses of new keys found in the fragments or manifest updates
+    // will be acquired by the key rotation. The instance is kept when the DRM
+    // is initialized again (e.g. new PSSH of a period), the readers refer to it
+    if (!m_keyRotation)
+    {
+      const CryptoMode cryptoMode{
+          m_adaptiveTree->m_currentPeriod->GetPSSHSets()[1].m_cryptoMode};
+      m_keyRotation = std::make_unique<CKeyRotation>(
+          m_decrypter, key_system,
+          cryptoMode == CryptoMode::NONE ? CryptoMode::AES_CTR : cryptoMode);
+    }
 
-      }
-      else if (defaultKid.empty())
+    for (size_t ses{1}; ses < m_cdmSessions.size(); ++ses)
+    {
+      const CCdmSession& session{m_cdmSessions[ses]};
+      // The decrypters of a previous initialization are already added
+      if (!(session.m_decrypterCaps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_INVALID) &&
+          m_keyRotation->AddDecrypter(session.m_cencSingleSampleDecrypter,
+                                      session.m_decrypterCaps))
       {
-        for (size_t i{1}; i < ses; ++i)
+        if (isLicenseDeferred)
         {
-          if (sessionPsshset.pssh_ == m_adaptiveTree->m_currentPeriod->GetPSSHSets()[i].pssh_)
-          {
-            session.m_cencSingleSampleDecrypter = m_cdmSessions[i].m_cencSingleSampleDecrypter;
-            session.m_sharedCencSsd = true;
-            break;
-          }
-        }
-        if (!session.m_cencSingleSampleDecrypter)
-        {
-          LOG::Log(LOGWARNING, "Initializing stream with unknown KID!");
+          const CPeriod::PSSHSet& psshSet{m_adaptiveTree->m_currentPeriod->GetPSSHSets()[ses]};
+          m_keyRotation->AcquirePendingLicense(session.m_cencSingleSampleDecrypter,
+                                               psshSet.defaultKID_, psshSet.media_);
         }
       }
-
-      if (m_decrypter && init_data.GetDataSize() >= 4 &&
-          (session.m_cencSingleSampleDecrypter ||
-           (session.m_cencSingleSampleDecrypter = m_decrypter->CreateSingleSampleDecrypter(
-                init_data, optionalKeyParameter, defaultKid, false,
-                sessionPsshset.m_cryptoMode == CryptoMode::NONE ? CryptoMode::AES_CTR
-                                                                : sessionPsshset.m_cryptoMode)) !=
-               0))
-      {
-        m_decrypter->GetCapabilities(session.m_cencSingleSampleDecrypter, defkid,
-                                     sessionPsshset.media_, session.m_decrypterCaps);
-
-        if (session.m_decrypterCaps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_INVALID)
-        {
-          m_adaptiveTree->m_currentPeriod->RemovePSSHSet(static_cast<std::uint16_t>(ses));
-        }
-        else if (session.m_decrypterCaps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SECURE_PATH)
-        {
-          session.m_cdmSessionStr = session.m_cencSingleSampleDecrypter->GetSessionId();
-          isSecureVideoSession = true;
-
-          if (m_settingNoSecureDecoder && !m_kodiProps.m_isLicenseForceSecureDecoder &&
-              !m_adaptiveTree->m_currentPeriod->IsSecureDecodeNeeded())
-            session.m_decrypterCaps.flags &= ~SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SECURE_DECODER;
-        }
-      }
-      else
-      {
-        LOG::Log(LOGERROR, "Initialize failed (SingleSampleDecrypter)");
-        for (size_t i(ses); i < m_cdmSessions.size(); ++i)
-          m_cdmSessions[i].m_cencSingleSampleDecrypter = nullptr;
-
-        return false;
-      }
     }
   }
 
@@ -716,6 +750,8 @@ bool CSession::InitializePeriod(bool isSessionOpened /* = false */)
       return false;
   }
 
+  CheckVideoCodecs();
+
   uint32_t adpIndex{0};
   CAdaptationSet* adp{nullptr};
   SETTINGS::StreamSelection streamSelectionMode{m_reprChooser->GetStreamSelectionMode()};
@@ -1063,7 +1099,7 @@ void CSession::EnableStream(CStream* stream, bool enable)
 {
   if (enable)
   {
-    if (!m_timingStream)
+    if (!m_timingStream || m_timingStream->m_isSuspended)
       m_timingStream = stream;
 
     stream->m_isEnabled = true;
@@ -1077,6 +1113,69 @@ void CSession::EnableStream(CStream* stream, bool enable)
   }
 }
 
+void CSession::SuspendStream(CStream* stream)
+{
+  if (!m_isAudioOnly || !stream->m_isEnabled || stream->m_isSuspended)
+    return;
+
+  // The included streams (e.g. muxed audio) are demuxed from the video download
+  for (auto& incStream : m_streams)
+  {
+    if (incStream->m_isEnabled && incStream->m_mainId > 0 &&
+        GetStream(incStream->m_mainId) == stream &&
+        incStream->m_adStream.getRepresentation()->IsIncludedStream())
+    {
+      LOG::Log(LOGDEBUG, "The video stream carry included streams, cannot be suspended");
+      return;
+    }
+  }
+
+  stream->Suspend();
+  LOG::Log(LOGDEBUG, "Video stream (physical index %u) suspended",
+           stream->m_info.GetPhysicalIndex());
+
+  // The timing stream provide the start PTS to the other streams
+  if (stream == m_timingStream)
+  {
+    m_timingStream = nullptr;
+    for (auto& otherStream : m_streams)
+    {
+      if (otherStream->m_isEnabled && !otherStream->m_isSuspended && otherStream->GetReader())
+      {
+        m_timingStream = otherStream.get();
+        break;
+      }
+    }
+  }
+}
+
+void CSession::ResumeStream(CStream* stream)
+{
+  if (!stream->m_isSuspended)
+    return;
+
+  if (!stream->Resume())
+  {
+    LOG::LogF(LOGERROR, "Cannot resume the stream (physical index %u)",
+              stream->m_info.GetPhysicalIndex());
+    return;
+  }
+
+  if (!m_timingStream)
+    m_timingStream = stream;
+
+  // Suspended before the playback start, the stream begins from its start position
+  if (!m_isDemuxStarted)
+    return;
+
+  // Seek without preceeding, the video continues from the next segment start
+  // that begins with a keyframe, the audio is not interrupted
+  const double elapsedSecs{static_cast<double>(GetElapsedTimeMs()) / 1000};
+  LOG::Log(LOGDEBUG, "Resume the stream (physical index %u) at %0.1lf secs",
+           stream->m_info.GetPhysicalIndex(), elapsedSecs);
+  SeekTime(elapsedSecs, stream->m_info.GetPhysicalIndex(), false);
+}
+
 uint64_t CSession::PTSToElapsed(uint64_t pts)
 {
   if (m_timingStream)
@@ -1103,6 +1202,37 @@ uint64_t CSession::PTSToElapsed(uint64_t pts)
     return pts;
 }
 
+std::vector<adaptive::TimedEvent> CSession::TakeDueTimedEvents(uint64_t pts)
+{
+  int64_t ptsDiff{0};
+  if (m_timingStream && m_timingStream->GetReader())
+    ptsDiff = m_timingStream->GetReader()->GetPTSDiff();
+
+  return m_adaptiveTree->GetTimedEvents().TakeDueEvents(pts, ptsDiff);
+}
+
+std::vector<PLAYLIST::ClosedCaption> CSession::GetClosedCaptions() const
+{
+  std::vector<PLAYLIST::ClosedCaption> closedCaptions;
+
+  for (const auto& adpSet : m_adaptiveTree->m_currentPeriod->GetAdaptationSets())
+  {
+    if (adpSet->GetStreamType() != StreamType::VIDEO)
+      continue;
+
+    for (const PLAYLIST::ClosedCaption& closedCaption : adpSet->GetClosedCaptions())
+    {
+      if (std::none_of(closedCaptions.begin(), closedCaptions.end(),
+                       [&](const PLAYLIST::ClosedCaption& item)
+                       { return item.m_instreamId == closedCaption.m_instreamId; }))
+      {
+        closedCaptions.emplace_back(closedCaption);
+      }
+    }
+  }
+  return closedCaptions;
+}
+
 uint64_t CSession::GetTimeshiftBufferStart()
 {
   if (m_timingStream)
@@ -1160,32 +1290,47 @@ void CSession::SetVideoResolution(int width, int height, int maxWidth, int maxHe
 
 bool CSession::GetNextSample(ISampleReader*& sampleReader)
 {
-  CStream* res{nullptr};
-  CStream* waiting{nullptr};
+  RefreshDecrypterCaps();
+
   CStream* timingStream{GetTimingStream()};
+  std::vector<CDemuxScheduler::StreamState> states(m_streams.size());
+  bool hasEssentialAudio{false};
 
-  for (auto& stream : m_streams)
+  for (size_t i{0}; i < m_streams.size(); ++i)
   {
+    CStream* stream{m_streams[i].get()};
     bool isStarted{false};
     ISampleReader* streamReader{stream->GetReader()};
     if (!streamReader)
       continue;
 
-    if (stream->m_isEnabled)
+    if (stream->m_isEnabled && !stream->m_isSuspended)
     {
+      CDemuxScheduler::StreamState& state = states[i];
+
+      // Video and the first audio stream are essential, subtitles and
+      // additional audio streams are allowed to lag behind
+      const StreamType streamType{stream->m_adStream.getAdaptationSet()->GetStreamType()};
+      if (streamType == StreamType::AUDIO)
+      {
+        state.m_isEssential = !hasEssentialAudio;
+        hasEssentialAudio = true;
+      }
+      else
+        state.m_isEssential = streamType == StreamType::VIDEO;
+
       // Advice is that VP does not want to wait longer than 10ms for a return from
       // DemuxRead() - here we ask to not wait at all and if ReadSample has not yet
-      // finished we return the dummy reader instead
+      // finished the stream is marked as waiting
       if (streamReader->IsReadSampleAsyncWorking())
       {
-        waiting = stream.get();
-        break;
+        state.m_status = CDemuxScheduler::StreamStatus::WAITING;
       }
       else if (!streamReader->EOS())
       {
         // Once the start PTS has been acquired for the timing stream, set this value
         // to the other stream readers
-        if (stream.get() != timingStream &&
+        if (stream != timingStream &&
             timingStream->GetReader()->GetStartPTS() != STREAM_NOPTS_VALUE &&
             streamReader->GetStartPTS() == STREAM_NOPTS_VALUE)
         {
@@ -1195,16 +1340,14 @@ bool CSession::GetNextSample(ISampleReader*& sampleReader)
         }
         if (AP4_SUCCEEDED(streamReader->Start(isStarted)))
         {
-          if (!res || streamReader->DTSorPTS() < res->GetReader()->DTSorPTS())
+          if (stream->m_adStream.waitingForSegment(true) || streamReader->IsWaitingLicense())
           {
-            if (stream->m_adStream.waitingForSegment(true))
-            {
-              waiting = stream.get();
-            }
-            else
-            {
-              res = stream.get();
-            }
+            state.m_status = CDemuxScheduler::StreamStatus::WAITING;
+          }
+          else
+          {
+            state.m_status = CDemuxScheduler::StreamStatus::READY;
+            state.m_time = streamReader->DTSorPTS();
           }
         }
       }
@@ -1214,12 +1357,15 @@ bool CSession::GetNextSample(ISampleReader*& sampleReader)
       m_changed = true;
   }
 
-  if (waiting)
+  const int selected{m_demuxScheduler.Select(states)};
+
+  if (selected == CDemuxScheduler::SELECT_WAIT)
   {
     return true;
   }
-  else if (res)
+  else if (selected != CDemuxScheduler::SELECT_NONE)
   {
+    CStream* res{m_streams[selected].get()};
     CheckFragmentDuration(*res);
     ISampleReader* sr{res->GetReader()};
     if (sr->GetInformation(res->m_info))
@@ -1228,6 +1374,7 @@ bool CSession::GetNextSample(ISampleReader*& sampleReader)
     if (sr->PTS() != STREAM_NOPTS_VALUE)
       m_elapsedTime = PTSToElapsed(sr->PTS()) + GetChapterStartTime();
 
+    m_isDemuxStarted = true;
     sampleReader = sr;
     return true;
   }
@@ -1242,6 +1389,8 @@ bool CSession::SeekTime(double seekTime, unsigned int streamId, bool preceeding)
   if (seekTime < 0)
     seekTime = 0;
 
+  m_demuxScheduler.Reset();
+
   // Check if we leave our current period
   double chapterTime{0};
   auto pi = m_adaptiveTree->m_periods.cbegin();
@@ -1277,7 +1426,8 @@ bool CSession::SeekTime(double seekTime, unsigned int streamId, bool preceeding)
     uint64_t maxTime{0};
     for (auto& stream : m_streams)
     {
-      if (stream->m_isEnabled && (curTime = stream->m_adStream.getMaxTimeMs()) && curTime > maxTime)
+      if (stream->m_isEnabled && !stream->m_isSuspended &&
+          (curTime = stream->m_adStream.getMaxTimeMs()) && curTime > maxTime)
       {
         maxTime = curTime;
       }
@@ -1324,7 +1474,8 @@ bool CSession::SeekTime(double seekTime, unsigned int streamId, bool preceeding)
       continue;
 
     streamReader->WaitReadSampleAsyncComplete();
-    if (stream->m_isEnabled && (streamId == 0 || stream->m_info.GetPhysicalIndex() == streamId))
+    if (stream->m_isEnabled && !stream->m_isSuspended &&
+        (streamId == 0 || stream->m_info.GetPhysicalIndex() == streamId))
     {
       bool reset{true};
       // all streams must be started before seeking to ensure cross chapter seeks
@@ -1385,6 +1536,26 @@ void CSession::OnSegmentChanged(adaptive::AdaptiveStream* adStream)
       break;
     }
   }
+
+  AcquireRotatedLicenses();
+}
+
+void CSession::AcquireRotatedLicenses()
+{
+  std::vector<CPeriod::PSSHSet> psshSets{m_adaptiveTree->TakeRotatedPsshSets()};
+  if (!m_keyRotation)
+    return;
+
+  for (const CPeriod::PSSHSet& psshSet : psshSets)
+  {
+    // Only the DASH manifests provide the PSSH of the key rotation
+    std::string initData{BASE64::Decode(psshSet.pssh_)};
+    std::vector<std::string> keyIds;
+    if (psshSet.defaultKID_.size() == 16)
+      keyIds.emplace_back(psshSet.defaultKID_);
+
+    m_keyRotation->AcquireLicense(initData, keyIds, psshSet.media_);
+  }
 }
 
 void CSession::OnStreamChange(adaptive::AdaptiveStream* adStream)
@@ -1457,16 +1628,23 @@ uint32_t CSession::GetIncludedStreamMask() const
 
 STREAM_CRYPTO_KEY_SYSTEM CSession::GetCryptoKeySystem() const
 {
-  if (m_kodiProps.m_licenseType == "com.widevine.alpha")
-    return STREAM_CRYPTO_KEY_SYSTEM_WIDEVINE;
+  const DRM::KeySystemInfo* keySystem{DRM::ResolveKeySystem(m_cdmKeySystem)};
+  if (!keySystem)
+    return STREAM_CRYPTO_KEY_SYSTEM_NONE;
+
+  switch (keySystem->m_keySystem)
+  {
+    case DRM::KeySystem::WIDEVINE:
+      return STREAM_CRYPTO_KEY_SYSTEM_WIDEVINE;
 #if STREAMCRYPTO_VERSION_LEVEL >= 1
-  else if (m_kodiProps.m_licenseType == "com.huawei.wiseplay")
-    return STREAM_CRYPTO_KEY_SYSTEM_WISEPLAY;
+    case DRM::KeySystem::WISEPLAY:
+      return STREAM_CRYPTO_KEY_SYSTEM_WISEPLAY;
 #endif
-  else if (m_kodiProps.m_licenseType == "com.microsoft.playready")
-    return STREAM_CRYPTO_KEY_SYSTEM_PLAYREADY;
-  else
-    return STREAM_CRYPTO_KEY_SYSTEM_NONE;
+    case DRM::KeySystem::PLAYREADY:
+      return STREAM_CRYPTO_KEY_SYSTEM_PLAYREADY;
+    default:
+      return STREAM_CRYPTO_KEY_SYSTEM_NONE;
+  }
 }
 
 int CSession::GetChapter() const
@@ -8,6 +8,9 @@
 
 #pragma once
 
+#include "CdmSessions.h"
+#include "DemuxScheduler.h"
+#include "KeyRotation.h"
 #include "KodiHost.h"
 #include "Stream.h"
 #include "common/AdaptiveStream.h"
@@ -39,10 +42,17 @@ public:
   bool Initialize();
 
   /*
-   * \brief Check HDCP parameters to remove unplayable representations
+   * \brief Check HDCP parameters to remove unplayable representations,
+   *        while playing they are excluded from the stream quality selection
    */
   void CheckHDCP();
 
+  /*
+   * \brief Check the video codecs supported by the decoders, declared with the
+   *        chooser properties, to remove the unplayable representations
+   */
+  void CheckVideoCodecs();
+
   /*! \brief Pre-Initialize the DRM
    *  \param challengeB64 [OUT] Provide the challenge data as base64
    *  \param sessionId [OUT] Provide the session ID
@@ -113,6 +123,22 @@ public:
    */
   void EnableStream(CStream* stream, bool enable);
 
+  /*! \brief Suspend the downloads of a video stream while in audio only mode.
+   *         The audio only mode is set by the Kodi properties when the session is
+   *         opened and kept for the whole playback. A video stream that carry the
+   *         audio is not suspended, the representation chooser take the lowest
+   *         quality instead.
+   *  \param stream The video stream to suspend
+   */
+  void SuspendStream(CStream* stream);
+
+  /*! \brief Resume a suspended stream, e.g. when a stream included in the video
+   *         stream is opened. When suspended during the playback the stream is
+   *         seeked to the playback position
+   *  \param stream The stream to resume
+   */
+  void ResumeStream(CStream* stream);
+
   /*! \brief Get the number of streams in the session
    *  \return The number of streams in the session
    */
@@ -158,6 +184,17 @@ public:
     return m_cdmSessions[index].m_decrypterCaps;
   };
 
+  /*! \brief Get the key rotation handler, to switch decrypter when the key
+   *         of the fragments change
+   *  \return The key rotation handler, nullptr for unencrypted contents
+   */
+  CKeyRotation* GetKeyRotation() { return m_keyRotation.get(); }
+
+  /*! \brief Get the adaptive tree of the manifest
+   *  \return The adaptive tree
+   */
+  adaptive::AdaptiveTree* GetAdaptiveTree() { return m_adaptiveTree; }
+
   /*! \brief Get the total time in ms of the stream
    *  \return The total time in ms of the stream
    */
@@ -174,6 +211,19 @@ public:
    */
   uint64_t PTSToElapsed(uint64_t pts);
 
+  /*! \brief Take the timed events (e.g. ad markers) due at the pts, the event
+   *       times in manifest timeline are converted with the timing stream reader
+   *  \param pts The pts value coming from the stream reader
+   *  \return The due events, ordered by time
+   */
+  std::vector<adaptive::TimedEvent> TakeDueTimedEvents(uint64_t pts);
+
+  /*! \brief Get the closed captions signalled in the manifest for the video
+   *       of the current period, carried in the video stream
+   *  \return The closed caption channels
+   */
+  std::vector<PLAYLIST::ClosedCaption> GetClosedCaptions() const;
+
   /*! \brief Get the start pts of the first segment in the timing stream
    *       with the difference in manifest time and reader time added
    *  \return The reader's timeshift buffer starting pts
@@ -341,10 +391,21 @@ protected:
   void CheckFragmentDuration(CStream& stream);
 
   /*! \brief Check for and load decrypter module matching the supplied key system
-   *  \param key_system [OUT] Will be assigned to if a decrypter is found matching
-   *                    the set license type
+   *  \param keySystems [OUT] The key systems of the license type supported by the
+   *                    decrypter found, sorted from the cheapest one
+   */
+  void SetSupportedDecrypterURN(std::vector<std::string>& keySystems);
+
+  /*! \brief Select the key system to be opened by the CDM
+   *  \param keySystem The key system, if not supported the cheapest supported one is used
+   *  \param licenseKey The license key property or the manifest license URL
+   *  \return The license request template of the key system, otherwise empty on failure
    */
-  void SetSupportedDecrypterURN(std::string& key_system);
+  std::string SelectCdmKeySystem(std::string_view keySystem, std::string_view licenseKey);
+
+  /*! \brief Request the licenses of the PSSH changed by the manifest updates
+   */
+  void AcquireRotatedLicenses();
 
   /*! \brief Destroy all CencSingleSampleDecrypter instances
    */
@@ -360,27 +421,37 @@ private:
   AP4_DataBuffer m_serverCertificate;
   std::unique_ptr<kodi::tools::CDllHelper> m_dllHelper;
   SSD::SSD_DECRYPTER* m_decrypter{nullptr};
+  std::string m_cdmKeySystem; // The key system opened by the CDM
 
-  struct CCdmSession
-  {
-    SSD::SSD_DECRYPTER::SSD_CAPS m_decrypterCaps;
-    Adaptive_CencSingleSampleDecrypter* m_cencSingleSampleDecrypter;
-    const char* m_cdmSessionStr = nullptr;
-    bool m_sharedCencSsd{false};
-  };
   std::vector<CCdmSession> m_cdmSessions;
 
+  /*! \brief Set the session string and the secure decoder of a secure path session
+   *  \param session The CDM session
+   */
+  void SetSecurePath(CCdmSession& session);
+
+  /*! \brief Update the decrypter capabilities refreshed after a deferred license,
+   *         the HDCP check and the chooser secure session are updated accordingly
+   */
+  void RefreshDecrypterCaps();
+
+  std::unique_ptr<CKeyRotation> m_keyRotation;
+
   adaptive::AdaptiveTree* m_adaptiveTree{nullptr};
   CHOOSER::IRepresentationChooser* m_reprChooser;
 
   std::vector<std::unique_ptr<CStream>> m_streams;
   CStream* m_timingStream{nullptr};
+  // Subtitles and secondary audio can lag behind other streams up to 2 secs
+  CDemuxScheduler m_demuxScheduler{2 * STREAM_TIME_BASE};
 
   bool m_changed{false};
   uint64_t m_elapsedTime{0};
   uint64_t m_chapterStartTime{0}; // In STREAM_TIME_BASE
   double m_chapterSeekTime{0.0}; // In seconds
   uint8_t m_mediaTypeMask{0};
+  bool m_isAudioOnly{false};
+  bool m_isDemuxStarted{false};
   uint8_t m_drmConfig{0};
   bool m_settingNoSecureDecoder{false};
   bool m_settingIsHdcpOverride{false};
@@ -27,6 +27,7 @@ void CStream::Disable()
 
     m_isEnabled = false;
     m_isEncrypted = false;
+    m_isSuspended = false;
   }
 }
 
@@ -42,3 +43,29 @@ void CStream::Reset()
     m_mainId = 0;
   }
 }
+
+void CStream::Suspend()
+{
+  if (m_isEnabled && !m_isSuspended)
+  {
+    m_adStream.Stop();
+    if (m_streamReader)
+      m_streamReader->WaitReadSampleAsyncComplete();
+    m_adStream.DisposeWorker();
+    m_adStream.ReleaseSegmentBuffers();
+
+    m_isSuspended = true;
+  }
+}
+
+bool CStream::Resume()
+{
+  if (!m_isSuspended)
+    return false;
+
+  if (!m_adStream.start_stream())
+    return false;
+
+  m_isSuspended = false;
+  return true;
+}
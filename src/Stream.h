@@ -13,7 +13,11 @@
 #include "samplereader/SampleReader.h"
 
 #include <bento4/Ap4.h>
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "test/KodiStubs.h"
+#else
 #include <kodi/addon-instance/Inputstream.h>
+#endif
 
 namespace SESSION
 {
@@ -30,7 +34,8 @@ public:
       m_mainId{0},
       m_adStream{tree, adp, initialRepr, kodiProps, chooseRep},
       m_hasSegmentChanged{false},
-      m_isValid{true} {};
+      m_isValid{true},
+      m_isSuspended{false} {};
 
 
   ~CStream() { Disable(); };
@@ -45,6 +50,19 @@ public:
    */
   void Reset();
 
+  /*!
+   * \brief Suspend the stream downloads and release the buffered segments,
+   *        the stream stay enabled and the reader is kept to resume the stream
+   */
+  void Suspend();
+
+  /*!
+   * \brief Start again the downloads of a suspended stream, the reader must then
+   *        be seeked to the playback position
+   * \return True if success, otherwise false
+   */
+  bool Resume();
+
   /*!
    * \brief Get the stream sample reader pointer
    * \return The sample reader, otherwise nullptr if not set
@@ -91,6 +109,7 @@ public:
   kodi::addon::InputstreamInfo m_info;
   bool m_hasSegmentChanged;
   bool m_isValid;
+  bool m_isSuspended;
 
 private:
   std::unique_ptr<ISampleReader> m_streamReader;
@@ -7,6 +7,9 @@
  */
 
 #include "TSReader.h"
+
+#include "utils/log.h"
+
 #include <bento4/Ap4ByteStream.h>
 #include <stdlib.h>
 
@@ -55,12 +58,18 @@ bool TSReader::StartStreaming(AP4_UI32 typeMask)
   // All streams are ON at this place
   for (auto &tsInfo : m_streamInfos)
   {
-    if (!(typeMask & (1 << tsInfo.m_streamType)))
-      m_AVContext->StopStreaming(tsInfo.m_stream->pid);
-    else
+    const bool isTypeEnabled = (typeMask & (1 << tsInfo.m_streamType)) != 0;
+    // Only one elementary stream is demuxed for each type
+    tsInfo.m_enabled = isTypeEnabled && GetSelectedStreamInfo(tsInfo.m_streamType) == &tsInfo;
+    if (tsInfo.m_enabled)
       m_AVContext->StartStreaming(tsInfo.m_stream->pid);
-    tsInfo.m_enabled = (typeMask & (1 << tsInfo.m_streamType)) != 0;
-    typeMask &= ~(1 << tsInfo.m_streamType);
+    else
+      m_AVContext->StopStreaming(tsInfo.m_stream->pid);
+  }
+  for (auto& tsInfo : m_streamInfos)
+  {
+    if (tsInfo.m_enabled)
+      typeMask &= ~(1 << tsInfo.m_streamType);
   }
   return typeMask == 0;
 }
@@ -71,9 +80,10 @@ bool TSReader::GetInformation(kodi::addon::InputstreamInfo& info)
     "unk", "mpeg1", "mpeg2", "mpeg1", "mpeg2", "aac", "aac", "aac", "h264", "hevc", "ac3", "eac3", "unk", "srt", "mpeg4", "vc1", "unk", "unk", "unk"
   };
 
+  TSINFO* selectedInfo = GetSelectedStreamInfo(info.GetStreamType());
   for (auto &tsInfo : m_streamInfos)
   {
-    if (tsInfo.m_streamType == info.GetStreamType())
+    if (&tsInfo == selectedInfo)
     {
       if (!tsInfo.m_changed)
         return false;
@@ -321,6 +331,39 @@ bool TSReader::HandleStreamChange(uint16_t pid)
   return ret;
 }
 
+TSReader::TSINFO* TSReader::GetSelectedStreamInfo(INPUTSTREAM_TYPE type)
+{
+  std::vector<TSINFO*> typeInfos;
+  for (auto& tsInfo : m_streamInfos)
+  {
+    if (tsInfo.m_streamType == type)
+      typeInfos.emplace_back(&tsInfo);
+  }
+  if (typeInfos.empty())
+    return nullptr;
+
+  auto itIndex = m_streamIndexes.find(type);
+  if (itIndex == m_streamIndexes.end())
+    return typeInfos[0];
+
+  StreamIndex& streamIndex = itIndex->second;
+  // The position is meaningful only when the elementary streams match the expected ones
+  if ((streamIndex.m_count > 0 && streamIndex.m_count != typeInfos.size()) ||
+      streamIndex.m_index >= typeInfos.size())
+  {
+    if (!streamIndex.m_isMismatchLogged)
+    {
+      LOG::LogF(LOGWARNING,
+                "Expected %zu elementary streams of type %i but found %zu, "
+                "fallback to the first one",
+                streamIndex.m_count, static_cast<int>(type), typeInfos.size());
+      streamIndex.m_isMismatchLogged = true;
+    }
+    return typeInfos[0];
+  }
+  return typeInfos[streamIndex.m_index];
+}
+
 const INPUTSTREAM_TYPE TSReader::GetStreamType() const
 {
   for (const auto &tsInfo : m_streamInfos)
@@ -8,11 +8,17 @@
 
 #pragma once
 
+#include <map>
 #include <stdint.h>
 #include <vector>
 #include "../lib/mpegts/tsDemuxer.h"
 #include <bento4/Ap4Types.h>
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "test/KodiStubs.h"
+#else
 #include <kodi/addon-instance/Inputstream.h>
+#endif
 
 class AP4_ByteStream;
 
@@ -28,6 +34,18 @@ public:
 
   void Reset(bool resetPackets = true);
   bool StartStreaming(AP4_UI32 typeMask);
+  /*!
+   * \brief Set the elementary stream to demux when several have the same type
+   *        (e.g. the audio languages), the first one is used if not available
+   *        or if the number of elementary streams differ from the expected one.
+   * \param type The stream type
+   * \param index The position among the elementary streams of the same type
+   * \param count The expected number of elementary streams of the same type, 0 if unknown
+   */
+  void SetStreamIndex(INPUTSTREAM_TYPE type, size_t index, size_t count)
+  {
+    m_streamIndexes[type] = {index, count};
+  }
   bool SeekTime(uint64_t timeInTs, bool preceeding);
 
   bool GetInformation(kodi::addon::InputstreamInfo& info);
@@ -39,7 +57,16 @@ public:
   uint64_t GetDuration() const { return m_pkt.duration; }
   const AP4_Byte *GetPacketData() const { return m_pkt.data; };
   const AP4_Size GetPacketSize() const { return m_pkt.size; };
+  // The closed caption cc_data of the current video packet, if any
+  const unsigned char* GetPacketCaptionData() const { return m_pkt.ccData; }
+  size_t GetPacketCaptionDataSize() const { return m_pkt.ccDataSize; }
   const INPUTSTREAM_TYPE GetStreamType() const;
+  TSDemux::ElementaryStream* GetPacketStream() const { return m_AVContext->GetStream(m_pkt.pid); }
+  // Get and remove the SCTE-35 splice info sections read
+  std::vector<std::vector<unsigned char>> TakeSpliceInfoSections()
+  {
+    return m_AVContext->TakeSpliceInfoSections();
+  }
 
 private:
   bool GetPacket();
@@ -64,5 +91,15 @@ private:
     bool m_needInfo, m_changed, m_enabled;
     INPUTSTREAM_TYPE m_streamType;
   };
+  // Get the elementary stream selected for the stream type, nullptr if none
+  TSINFO* GetSelectedStreamInfo(INPUTSTREAM_TYPE type);
+
   std::vector<TSINFO> m_streamInfos;
+  struct StreamIndex
+  {
+    size_t m_index{0};
+    size_t m_count{0};
+    bool m_isMismatchLogged{false};
+  };
+  std::map<INPUTSTREAM_TYPE, StreamIndex> m_streamIndexes;
 };
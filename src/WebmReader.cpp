@@ -257,6 +257,20 @@ webm::Status WebmReader::OnFrame(const webm::FrameMetadata& metadata, webm::Read
 
 webm::Status WebmReader::OnTrackEntry(const webm::ElementMetadata& metadata, const webm::TrackEntry& track_entry)
 {
+  if (track_entry.content_encodings.is_present())
+  {
+    for (const webm::Element<webm::ContentEncoding>& encoding : track_entry.content_encodings.value().encodings)
+    {
+      // Only the AES-CTR encryption of the WebM encryption spec is supported
+      if (encoding.value().type.value() == webm::ContentEncodingType::kEncryption &&
+          encoding.value().encryption.value().algorithm.value() == webm::ContentEncAlgo::kAes)
+      {
+        const std::vector<std::uint8_t>& keyId = encoding.value().encryption.value().key_id.value();
+        m_keyId.assign(keyId.begin(), keyId.end());
+      }
+    }
+  }
+
   if (track_entry.audio.is_present())
   {
     m_metadataChanged = true;
@@ -9,12 +9,17 @@
 #pragma once
 
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 #include <bento4/Ap4Types.h>
 #include <bento4/Ap4DataBuffer.h>
 
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "test/KodiStubs.h"
+#else
 #include <kodi/addon-instance/Inputstream.h>
+#endif
 #include <webm/callback.h>
 #include <webm/status.h>
 
@@ -62,6 +67,8 @@ public:
   const AP4_Byte *GetPacketData() const { return m_frameBuffer.GetData(); }
   AP4_Size GetPacketSize() const { return m_frameBuffer.GetDataSize(); }
   uint64_t GetCueOffset()  const { return m_cueOffset; }
+  // KID of the track encrypted with the WebM encryption (ContentEncryption), empty if clear
+  const std::string& GetKeyId() const { return m_keyId; }
 
 private:
   WebmAP4Reader *m_reader = nullptr;
@@ -72,6 +79,7 @@ private:
   uint64_t m_duration = 0;
   std::vector<CUEPOINT> *m_cuePoints = nullptr;
   AP4_DataBuffer m_frameBuffer, m_codecPrivate;
+  std::string m_keyId;
 
   //Video section
   uint32_t m_width = 0;
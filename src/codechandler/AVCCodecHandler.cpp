@@ -8,6 +8,75 @@
 
 #include "AVCCodecHandler.h"
 
+#include "cc/ClosedCaptions.h"
+
+namespace
+{
+/*!
+ * \brief Bit reader for escaped NAL unit payloads, emulation prevention bytes
+ *        are skipped while reading, so the NAL unit has not to be unescaped
+ *        in a copy before parsing the first fields of the slice header.
+ */
+class CEscapedBitReader
+{
+public:
+  CEscapedBitReader(const AP4_Byte* data, AP4_Size size) : m_data{data}, m_size{size} {}
+
+  bool ReadBit(unsigned int& bit)
+  {
+    if (m_bitsLeft == 0)
+    {
+      if (m_pos >= m_size)
+        return false;
+      // Skip the emulation prevention byte of a 0x000003 sequence
+      if (m_zeroCount >= 2 && m_data[m_pos] == 0x03)
+      {
+        m_zeroCount = 0;
+        if (++m_pos >= m_size)
+          return false;
+      }
+      m_currentByte = m_data[m_pos++];
+      m_zeroCount = m_currentByte == 0 ? m_zeroCount + 1 : 0;
+      m_bitsLeft = 8;
+    }
+    bit = (m_currentByte >> --m_bitsLeft) & 1;
+    return true;
+  }
+
+  bool ReadGolomb(unsigned int& value)
+  {
+    unsigned int leadingZeros{0};
+    unsigned int bit{0};
+    while (ReadBit(bit) && bit == 0)
+    {
+      // Slice header values read here never exceed 16 bits
+      if (++leadingZeros > 16)
+        return false;
+    }
+    if (bit == 0)
+      return false;
+
+    value = 0;
+    for (unsigned int i{0}; i < leadingZeros; ++i)
+    {
+      if (!ReadBit(bit))
+        return false;
+      value = (value << 1) | bit;
+    }
+    value += (1U << leadingZeros) - 1;
+    return true;
+  }
+
+private:
+  const AP4_Byte* m_data;
+  AP4_Size m_size;
+  AP4_Size m_pos{0};
+  unsigned int m_zeroCount{0};
+  unsigned int m_bitsLeft{0};
+  AP4_Byte m_currentByte{0};
+};
+} // unnamed namespace
+
 AVCCodecHandler::AVCCodecHandler(AP4_SampleDescription* sd)
   : CodecHandler{sd},
     m_countPictureSetIds{0},
@@ -102,7 +171,8 @@ void AVCCodecHandler::UpdatePPSId(AP4_DataBuffer const& buffer)
   if (!m_needSliceInfo)
     return;
 
-  //Search the Slice header NALU
+  // All slices of a picture refer to the same PPS, so only the slice header
+  // of the first VCL NAL unit is needed, the remaining NAL units are skipped
   const AP4_Byte* data(buffer.GetData());
   AP4_Size dataSize(buffer.GetDataSize());
   for (; dataSize;)
@@ -134,7 +204,7 @@ void AVCCodecHandler::UpdatePPSId(AP4_DataBuffer const& buffer)
         naluSize = 1;
         break;
     }
-    if (naluSize > dataSize)
+    if (naluSize > dataSize || naluSize == 0)
       break;
 
     // Stop further NALU processing
@@ -143,23 +213,23 @@ void AVCCodecHandler::UpdatePPSId(AP4_DataBuffer const& buffer)
 
     unsigned int nal_unit_type = *data & 0x1F;
 
-    if (
-        //nal_unit_type == AP4_AVC_NAL_UNIT_TYPE_CODED_SLICE_OF_NON_IDR_PICTURE ||
-        nal_unit_type == AP4_AVC_NAL_UNIT_TYPE_CODED_SLICE_OF_IDR_PICTURE //||
-        //nal_unit_type == AP4_AVC_NAL_UNIT_TYPE_CODED_SLICE_DATA_PARTITION_A ||
-        //nal_unit_type == AP4_AVC_NAL_UNIT_TYPE_CODED_SLICE_DATA_PARTITION_B ||
-        //nal_unit_type == AP4_AVC_NAL_UNIT_TYPE_CODED_SLICE_DATA_PARTITION_C
-    )
+    if (nal_unit_type >= AP4_AVC_NAL_UNIT_TYPE_CODED_SLICE_OF_NON_IDR_PICTURE &&
+        nal_unit_type <= AP4_AVC_NAL_UNIT_TYPE_CODED_SLICE_OF_IDR_PICTURE)
     {
-      AP4_DataBuffer unescaped(data, dataSize);
-      AP4_NalParser::Unescape(unescaped);
-      AP4_BitReader bits(unescaped.GetData(), unescaped.GetDataSize());
-
-      bits.SkipBits(8); // NAL Unit Type
-
-      AP4_AvcFrameParser::ReadGolomb(bits); // first_mb_in_slice
-      AP4_AvcFrameParser::ReadGolomb(bits); // slice_type
-      m_pictureId = AP4_AvcFrameParser::ReadGolomb(bits); //picture_set_id
+      if (nal_unit_type == AP4_AVC_NAL_UNIT_TYPE_CODED_SLICE_OF_IDR_PICTURE)
+      {
+        // Skip the NAL unit header byte
+        CEscapedBitReader bits(data + 1, naluSize - 1);
+        unsigned int firstMbInSlice;
+        unsigned int sliceType;
+        unsigned int ppsId;
+        if (bits.ReadGolomb(firstMbInSlice) && bits.ReadGolomb(sliceType) &&
+            bits.ReadGolomb(ppsId) && ppsId <= 255)
+        {
+          m_pictureId = static_cast<AP4_UI08>(ppsId);
+        }
+      }
+      break;
     }
     // move to the next NAL unit
     data += naluSize;
@@ -167,11 +237,13 @@ void AVCCodecHandler::UpdatePPSId(AP4_DataBuffer const& buffer)
   }
 }
 
-bool AVCCodecHandler::GetInformation(kodi::addon::InputstreamInfo& info)
+AP4_AvcSequenceParameterSet* AVCCodecHandler::GetSPSFromPPSId(AP4_UI08 ppsId)
 {
-  if (m_pictureId == m_pictureIdPrev)
-    return false;
-  m_pictureIdPrev = m_pictureId;
+  auto itSps = m_spsByPPSId.find(ppsId);
+  if (itSps != m_spsByPPSId.end())
+    return itSps->second ? &*itSps->second : nullptr;
+
+  std::optional<AP4_AvcSequenceParameterSet>& cachedSps = m_spsByPPSId[ppsId];
 
   if (AP4_AvcSampleDescription* avcSampleDescription =
           AP4_DYNAMIC_CAST(AP4_AvcSampleDescription, m_sampleDescription))
@@ -182,7 +254,7 @@ bool AVCCodecHandler::GetInformation(kodi::addon::InputstreamInfo& info)
     {
       AP4_AvcFrameParser fp;
       if (AP4_SUCCEEDED(fp.ParsePPS(ppsList[i].GetData(), ppsList[i].GetDataSize(), pps)) &&
-          pps.pic_parameter_set_id == m_pictureId)
+          pps.pic_parameter_set_id == ppsId)
       {
         AP4_Array<AP4_DataBuffer>& spsList = avcSampleDescription->GetSequenceParameters();
         AP4_AvcSequenceParameterSet sps;
@@ -191,27 +263,50 @@ bool AVCCodecHandler::GetInformation(kodi::addon::InputstreamInfo& info)
           if (AP4_SUCCEEDED(fp.ParseSPS(spsList[i].GetData(), spsList[i].GetDataSize(), sps)) &&
               sps.seq_parameter_set_id == pps.seq_parameter_set_id)
           {
-            unsigned int width = info.GetWidth();
-            unsigned int height = info.GetHeight();
-            unsigned int fps_ticks = info.GetFpsRate();
-            unsigned int fps_scale = info.GetFpsScale();
-            float aspect = info.GetAspect();
-            bool ret = sps.GetInfo(width, height);
-            ret = sps.GetVUIInfo(fps_ticks, fps_scale, aspect) || ret;
-            if (ret)
-            {
-              info.SetWidth(width);
-              info.SetHeight(height);
-              info.SetFpsRate(fps_ticks);
-              info.SetFpsScale(fps_scale);
-              info.SetAspect(aspect);
-            }
-            return ret;
+            cachedSps = sps;
+            return &*cachedSps;
           }
         }
         break;
       }
     }
   }
-  return false;
-};
+  return nullptr;
+}
+
+bool AVCCodecHandler::GetInformation(kodi::addon::InputstreamInfo& info)
+{
+  if (m_pictureId == m_pictureIdPrev)
+    return false;
+  m_pictureIdPrev = m_pictureId;
+
+  // Parameter sets are parsed only once for each PPS id, later changes
+  // between already known PPS ids are resolved from the cache
+  AP4_AvcSequenceParameterSet* sps = GetSPSFromPPSId(m_pictureId);
+  if (!sps)
+    return false;
+
+  unsigned int width = info.GetWidth();
+  unsigned int height = info.GetHeight();
+  unsigned int fps_ticks = info.GetFpsRate();
+  unsigned int fps_scale = info.GetFpsScale();
+  float aspect = info.GetAspect();
+  bool ret = sps->GetInfo(width, height);
+  ret = sps->GetVUIInfo(fps_ticks, fps_scale, aspect) || ret;
+  if (ret)
+  {
+    info.SetWidth(width);
+    info.SetHeight(height);
+    info.SetFpsRate(fps_ticks);
+    info.SetFpsScale(fps_scale);
+    info.SetAspect(aspect);
+  }
+  return ret;
+}
+
+bool AVCCodecHandler::ExtractCaptionData(const AP4_DataBuffer& buffer,
+                                         std::vector<uint8_t>& ccData)
+{
+  ::ExtractCaptionData(buffer.GetData(), buffer.GetDataSize(), m_naluLengthSize, false, ccData);
+  return true;
+}
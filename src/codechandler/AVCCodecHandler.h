@@ -10,6 +10,9 @@
 
 #include "CodecHandler.h"
 
+#include <map>
+#include <optional>
+
 class ATTR_DLL_LOCAL AVCCodecHandler : public CodecHandler
 {
 public:
@@ -17,10 +20,21 @@ public:
   bool ExtraDataToAnnexB() override;
   void UpdatePPSId(AP4_DataBuffer const& buffer) override;
   bool GetInformation(kodi::addon::InputstreamInfo& info) override;
+  bool ExtractCaptionData(const AP4_DataBuffer& buffer, std::vector<uint8_t>& ccData) override;
   STREAMCODEC_PROFILE GetProfile() override { return m_codecProfile; };
 
 private:
+  /*!
+   * \brief Get the SPS referenced by a PPS id, the parameter sets are parsed
+   *        only the first time a PPS id is seen, then the result is cached.
+   * \param ppsId The picture parameter set id
+   * \return The SPS if found, otherwise nullptr
+   */
+  AP4_AvcSequenceParameterSet* GetSPSFromPPSId(AP4_UI08 ppsId);
+
   unsigned int m_countPictureSetIds;
   STREAMCODEC_PROFILE m_codecProfile;
   bool m_needSliceInfo;
+  // Parsed SPS for each PPS id, std::nullopt when the PPS id cannot be resolved
+  std::map<AP4_UI08, std::optional<AP4_AvcSequenceParameterSet>> m_spsByPPSId;
 };
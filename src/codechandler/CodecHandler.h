@@ -17,6 +17,8 @@
 #include <kodi/addon-instance/Inputstream.h>
 #endif
 
+#include <vector>
+
 class ATTR_DLL_LOCAL CodecHandler
 {
 public:
@@ -36,6 +38,16 @@ public:
   virtual void SetPTSOffset(AP4_UI64 offset){};
   virtual bool TimeSeek(AP4_UI64 seekPos) { return true; };
   virtual void Reset(){};
+  /*!
+   * \brief Extract the closed captions data (CEA-608/708 cc_data) carried in a sample.
+   * \param buffer The sample data
+   * \param ccData [OUT] The cc_data triplets found are appended
+   * \return True if the codec can carry closed captions, otherwise false
+   */
+  virtual bool ExtractCaptionData(const AP4_DataBuffer& buffer, std::vector<uint8_t>& ccData)
+  {
+    return false;
+  }
 
   AP4_SampleDescription* m_sampleDescription;
   AP4_DataBuffer m_extraData;
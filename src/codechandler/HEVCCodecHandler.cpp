@@ -9,6 +9,7 @@
 #include "HEVCCodecHandler.h"
 
 #include "../utils/log.h"
+#include "cc/ClosedCaptions.h"
 
 HEVCCodecHandler::HEVCCodecHandler(AP4_SampleDescription* sd) : CodecHandler(sd)
 {
@@ -92,3 +93,10 @@ bool HEVCCodecHandler::GetInformation(kodi::addon::InputstreamInfo& info)
   }
   return false;
 }
+
+bool HEVCCodecHandler::ExtractCaptionData(const AP4_DataBuffer& buffer,
+                                          std::vector<uint8_t>& ccData)
+{
+  ::ExtractCaptionData(buffer.GetData(), buffer.GetDataSize(), m_naluLengthSize, true, ccData);
+  return true;
+}
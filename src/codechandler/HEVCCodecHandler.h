@@ -17,4 +17,5 @@ public:
 
   bool ExtraDataToAnnexB() override;
   bool GetInformation(kodi::addon::InputstreamInfo& info) override;
+  bool ExtractCaptionData(const AP4_DataBuffer& buffer, std::vector<uint8_t>& ccData) override;
 };
@@ -0,0 +1,131 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "CaptionDecoder.h"
+
+namespace
+{
+// Limit the cues kept when they are not taken, e.g. the channel is not enabled
+constexpr size_t MAX_CUES = 64;
+// A caption displayed longer is split in cues of this duration (5 secs in STREAM_TIME_BASE),
+// so that it is not held back until the text changes
+constexpr uint64_t MAX_CUE_DURATION = 5000000;
+
+void AppendUtf8(std::string& str, char32_t ch)
+{
+  if (ch < 0x80)
+  {
+    str += static_cast<char>(ch);
+  }
+  else if (ch < 0x800)
+  {
+    str += static_cast<char>(0xC0 | (ch >> 6));
+    str += static_cast<char>(0x80 | (ch & 0x3F));
+  }
+  else if (ch < 0x10000)
+  {
+    str += static_cast<char>(0xE0 | (ch >> 12));
+    str += static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
+    str += static_cast<char>(0x80 | (ch & 0x3F));
+  }
+  else
+  {
+    str += static_cast<char>(0xF0 | (ch >> 18));
+    str += static_cast<char>(0x80 | ((ch >> 12) & 0x3F));
+    str += static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
+    str += static_cast<char>(0x80 | (ch & 0x3F));
+  }
+}
+} // unnamed namespace
+
+void CCaptionDecoder::Decode(const uint8_t* ccData, size_t size, uint64_t pts)
+{
+  for (size_t i{0}; i + 3 <= size; i += 3)
+  {
+    // marker_bits (5) | cc_valid (1) | cc_type (2)
+    if (!(ccData[i] & 0x04))
+      continue;
+    ProcessPair(ccData[i] & 0x03, ccData[i + 1], ccData[i + 2]);
+  }
+
+  std::string text{GetDisplayedText()};
+  const bool isChanged{text != m_displayedText};
+
+  // The cue of the text displayed ends when the text changes
+  if (!m_displayedText.empty() && pts > m_displayedPts &&
+      (isChanged || pts - m_displayedPts >= MAX_CUE_DURATION))
+  {
+    AddCue(m_displayedPts, pts - m_displayedPts, m_displayedText);
+    m_displayedPts = pts;
+  }
+
+  if (isChanged)
+  {
+    m_displayedText = std::move(text);
+    m_displayedPts = pts;
+  }
+}
+
+void CCaptionDecoder::Reset()
+{
+  m_cues.clear();
+  m_displayedText.clear();
+  m_displayedPts = 0;
+}
+
+bool CCaptionDecoder::TakeCue(CaptionCue& cue)
+{
+  if (m_cues.empty())
+    return false;
+
+  cue = std::move(m_cues.front());
+  m_cues.pop_front();
+  return true;
+}
+
+void CCaptionDecoder::AddCue(uint64_t pts, uint64_t duration, const std::string& text)
+{
+  if (m_cues.size() >= MAX_CUES)
+    m_cues.pop_front();
+  m_cues.push_back({pts, duration, text});
+}
+
+std::string CCaptionDecoder::RenderRows(const std::vector<CaptionRow>& rows)
+{
+  std::string text;
+
+  for (const CaptionRow& row : rows)
+  {
+    // The text is between the first and the last non blank cells
+    size_t begin{0};
+    size_t end{row.size()};
+    while (begin < end && (row[begin].m_char == 0 || row[begin].m_char == U' '))
+      ++begin;
+    while (end > begin && (row[end - 1].m_char == 0 || row[end - 1].m_char == U' '))
+      --end;
+    if (begin == end)
+      continue;
+
+    if (!text.empty())
+      text += '\n';
+
+    bool isItalic{false};
+    for (size_t i{begin}; i < end; ++i)
+    {
+      if (row[i].m_isItalic != isItalic)
+      {
+        isItalic = row[i].m_isItalic;
+        text += isItalic ? "<i>" : "</i>";
+      }
+      AppendUtf8(text, row[i].m_char == 0 ? U' ' : row[i].m_char);
+    }
+    if (isItalic)
+      text += "</i>";
+  }
+  return text;
+}
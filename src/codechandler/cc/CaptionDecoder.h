@@ -0,0 +1,100 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "../../test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief A character cell of the caption memory, a zero character is an empty cell.
+ */
+struct CaptionCell
+{
+  char32_t m_char{0};
+  bool m_isItalic{false};
+};
+
+using CaptionRow = std::vector<CaptionCell>;
+
+/*!
+ * \brief The text displayed from a presentation time for a duration.
+ */
+struct CaptionCue
+{
+  uint64_t m_pts{0};
+  uint64_t m_duration{0};
+  std::string m_text;
+};
+
+/*!
+ * \brief Base class of the closed caption decoders, the decoders keep the
+ *        caption memory of a channel and create a cue each time the displayed
+ *        text changes. The cue is available once its duration is known, when the
+ *        text is changed or cleared, or when it is displayed for the max cue duration.
+ */
+class ATTR_DLL_LOCAL CCaptionDecoder
+{
+public:
+  virtual ~CCaptionDecoder() = default;
+
+  /*!
+   * \brief Decode the cc_data of a picture, the pictures must be decoded in
+   *        presentation order.
+   * \param ccData The cc_data triplets (marker / valid / type byte followed by two data bytes)
+   * \param size The data size
+   * \param pts The presentation time of the picture, in STREAM_TIME_BASE units
+   */
+  void Decode(const uint8_t* ccData, size_t size, uint64_t pts);
+
+  /*!
+   * \brief Clear the caption memory and the cues, e.g. after a seek.
+   */
+  virtual void Reset();
+
+  /*!
+   * \brief Get and remove the oldest cue.
+   * \param cue [OUT] The cue
+   * \return True if a cue was available, otherwise false
+   */
+  bool TakeCue(CaptionCue& cue);
+
+  /*!
+   * \brief Render the rows as subtitle text, the rows are separated by a new
+   *        line, the empty rows are skipped and the italic text is enclosed
+   *        in <i> tags.
+   */
+  static std::string RenderRows(const std::vector<CaptionRow>& rows);
+
+protected:
+  /*!
+   * \brief Process a triplet of the cc_data.
+   * \param type The cc_type: 0 / 1 the CEA-608 field 1 / 2 byte pair,
+   *        3 / 2 the start / continuation of a CEA-708 DTVCC packet
+   */
+  virtual void ProcessPair(uint8_t type, uint8_t data1, uint8_t data2) = 0;
+
+  // Text currently displayed by the caption memory
+  virtual std::string GetDisplayedText() const = 0;
+
+private:
+  void AddCue(uint64_t pts, uint64_t duration, const std::string& text);
+
+  std::deque<CaptionCue> m_cues;
+  std::string m_displayedText;
+  uint64_t m_displayedPts{0};
+};
@@ -0,0 +1,343 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "Cea608Decoder.h"
+
+#include <algorithm>
+
+namespace
+{
+constexpr int ROWS = 15;
+constexpr int COLUMNS = 32;
+
+// Row of the preamble address codes, indexed by the 4 row bits
+constexpr int PAC_ROWS[16] = {10, -1, 0, 1, 2, 3, 11, 12, 13, 14, 4, 5, 6, 7, 8, 9};
+
+// Special characters 0x11 0x30..0x3F, 0x39 is the transparent space
+constexpr char32_t SPECIAL_CHARS[16] = {0xAE, 0xB0, 0xBD, 0xBF, 0x2122, 0xA2, 0xA3, 0x266A,
+                                        0xE0, 0x20, 0xE8, 0xE2, 0xEA,   0xEE, 0xF4, 0xFB};
+
+// Extended characters 0x12 0x20..0x3F, Spanish, French and miscellaneous
+constexpr char32_t EXTENDED_CHARS_12[32] = {
+    0xC1, 0xC9, 0xD3, 0xDA, 0xDC, 0xFC, 0x2018, 0xA1, 0x2A, 0x2019, 0x2014,
+    0xA9, 0x2120, 0x2022, 0x201C, 0x201D, 0xC0, 0xC2, 0xC7, 0xC8, 0xCA, 0xCB,
+    0xEB, 0xCE, 0xCF, 0xEF, 0xD4, 0xD9, 0xF9, 0xDB, 0xAB, 0xBB};
+
+// Extended characters 0x13 0x20..0x3F, Portuguese, German and Danish
+constexpr char32_t EXTENDED_CHARS_13[32] = {
+    0xC3, 0xE3, 0xCD, 0xCC, 0xEC, 0xD2, 0xF2, 0xD5, 0xF5, 0x7B, 0x7D,
+    0x5C, 0x5E, 0x5F, 0x7C, 0x7E, 0xC4, 0xE4, 0xD6, 0xF6, 0xDF, 0xA5,
+    0xA4, 0xA6, 0xC5, 0xE5, 0xD8, 0xF8, 0x250C, 0x2510, 0x2514, 0x2518};
+
+// The basic characters are ASCII except a few
+char32_t GetBasicChar(uint8_t code)
+{
+  switch (code)
+  {
+    case 0x27:
+      return 0x2019;
+    case 0x2A:
+      return 0xE1;
+    case 0x5C:
+      return 0xE9;
+    case 0x5E:
+      return 0xED;
+    case 0x5F:
+      return 0xF3;
+    case 0x60:
+      return 0xFA;
+    case 0x7B:
+      return 0xE7;
+    case 0x7C:
+      return 0xF7;
+    case 0x7D:
+      return 0xD1;
+    case 0x7E:
+      return 0xF1;
+    case 0x7F:
+      return 0x2588;
+    default:
+      return code;
+  }
+}
+
+// The bytes are transmitted with odd parity
+bool HasOddParity(uint8_t byte)
+{
+  byte ^= byte >> 4;
+  byte ^= byte >> 2;
+  byte ^= byte >> 1;
+  return byte & 1;
+}
+} // unnamed namespace
+
+CCea608Decoder::CCea608Decoder(int channel)
+  : m_field{static_cast<uint8_t>(channel > 2 ? 1 : 0)},
+    m_dataChannel{(channel - 1) % 2},
+    m_displayedMemory(ROWS, CaptionRow(COLUMNS)),
+    m_nonDisplayedMemory(ROWS, CaptionRow(COLUMNS)),
+    m_row{ROWS - 1}
+{
+}
+
+void CCea608Decoder::Reset()
+{
+  CCaptionDecoder::Reset();
+  m_currentDataChannel = -1;
+  m_mode = Mode::NONE;
+  EraseRows(m_displayedMemory);
+  EraseRows(m_nonDisplayedMemory);
+  m_row = ROWS - 1;
+  m_column = 0;
+  m_rollUpRows = 2;
+  m_isItalic = false;
+  m_lastControl1 = 0;
+  m_lastControl2 = 0;
+}
+
+void CCea608Decoder::ProcessPair(uint8_t type, uint8_t data1, uint8_t data2)
+{
+  if (type != m_field)
+    return;
+
+  // Drop the pairs with transmission errors
+  if (!HasOddParity(data1) || !HasOddParity(data2))
+    return;
+
+  const uint8_t cc1 = data1 & 0x7F;
+  const uint8_t cc2 = data2 & 0x7F;
+
+  // Padding
+  if (cc1 == 0 && cc2 == 0)
+    return;
+
+  if (cc1 >= 0x10 && cc1 <= 0x1F)
+  {
+    // Skip the redundant transmission of the control code
+    if (cc1 == m_lastControl1 && cc2 == m_lastControl2)
+    {
+      m_lastControl1 = 0;
+      m_lastControl2 = 0;
+      return;
+    }
+    m_lastControl1 = cc1;
+    m_lastControl2 = cc2;
+
+    // The channel bit select the data channel of the following characters
+    m_currentDataChannel = (cc1 & 0x08) ? 1 : 0;
+    if (m_currentDataChannel == m_dataChannel)
+      ProcessControl(cc1 & 0xF7, cc2);
+    return;
+  }
+
+  m_lastControl1 = 0;
+  m_lastControl2 = 0;
+
+  if (cc1 < 0x10)
+  {
+    // Extended data services of the field 2, not caption data
+    m_currentDataChannel = -1;
+    return;
+  }
+
+  if (m_currentDataChannel != m_dataChannel)
+    return;
+
+  PutChar(GetBasicChar(cc1));
+  if (cc2 >= 0x20)
+    PutChar(GetBasicChar(cc2));
+}
+
+std::string CCea608Decoder::GetDisplayedText() const
+{
+  return RenderRows(m_displayedMemory);
+}
+
+void CCea608Decoder::ProcessControl(uint8_t cc1, uint8_t cc2)
+{
+  if ((cc1 == 0x14 || cc1 == 0x15) && cc2 >= 0x20 && cc2 <= 0x2F)
+  {
+    ProcessMiscCommand(cc2);
+  }
+  else if (cc1 == 0x17 && cc2 >= 0x21 && cc2 <= 0x23)
+  {
+    // Tab offset
+    m_column = std::min(m_column + (cc2 - 0x20), COLUMNS - 1);
+  }
+  else if (cc2 >= 0x40)
+  {
+    ProcessPreambleAddress(cc1, cc2);
+  }
+  else if (cc1 == 0x11 && cc2 >= 0x20 && cc2 <= 0x2F)
+  {
+    // Mid-row code, the attribute change is displayed as a space
+    PutChar(U' ');
+    m_isItalic = (cc2 & 0x0E) == 0x0E;
+  }
+  else if (cc1 == 0x11 && cc2 >= 0x30 && cc2 <= 0x3F)
+  {
+    PutChar(SPECIAL_CHARS[cc2 - 0x30]);
+  }
+  else if ((cc1 == 0x12 || cc1 == 0x13) && cc2 >= 0x20 && cc2 <= 0x3F)
+  {
+    // An extended character replace the basic character sent before it
+    Backspace();
+    PutChar(cc1 == 0x12 ? EXTENDED_CHARS_12[cc2 - 0x20] : EXTENDED_CHARS_13[cc2 - 0x20]);
+  }
+  // The background and foreground attribute codes are ignored
+}
+
+void CCea608Decoder::ProcessMiscCommand(uint8_t cc2)
+{
+  switch (cc2)
+  {
+    case 0x20: // RCL Resume Caption Loading
+      m_mode = Mode::POP_ON;
+      break;
+    case 0x21: // BS Backspace
+      Backspace();
+      break;
+    case 0x24: // DER Delete to End of Row
+    {
+      CaptionRow& row = GetWriteMemory()[m_row];
+      std::fill(row.begin() + m_column, row.end(), CaptionCell());
+      break;
+    }
+    case 0x25: // RU2 Roll-Up Captions 2 rows
+    case 0x26: // RU3
+    case 0x27: // RU4
+      if (m_mode != Mode::ROLL_UP)
+      {
+        EraseRows(m_displayedMemory);
+        EraseRows(m_nonDisplayedMemory);
+        m_row = ROWS - 1;
+      }
+      m_mode = Mode::ROLL_UP;
+      m_rollUpRows = cc2 - 0x23;
+      m_row = std::max(m_row, m_rollUpRows - 1);
+      m_column = 0;
+      // Remove the rows out of a smaller window
+      for (int row{0}; row <= m_row - m_rollUpRows; ++row)
+      {
+        m_displayedMemory[row].assign(COLUMNS, CaptionCell());
+      }
+      break;
+    case 0x29: // RDC Resume Direct Captioning
+      if (m_mode == Mode::ROLL_UP)
+        EraseRows(m_displayedMemory);
+      m_mode = Mode::PAINT_ON;
+      break;
+    case 0x2A: // TR Text Restart
+    case 0x2B: // RTD Resume Text Display
+      m_mode = Mode::TEXT;
+      break;
+    case 0x2C: // EDM Erase Displayed Memory
+      EraseRows(m_displayedMemory);
+      break;
+    case 0x2D: // CR Carriage Return
+      if (m_mode == Mode::ROLL_UP)
+        CarriageReturn();
+      break;
+    case 0x2E: // ENM Erase Non-Displayed Memory
+      EraseRows(m_nonDisplayedMemory);
+      break;
+    case 0x2F: // EOC End Of Caption, flip the memories
+      m_displayedMemory.swap(m_nonDisplayedMemory);
+      m_mode = Mode::POP_ON;
+      break;
+    default: // AOF, AON, FON are not used
+      break;
+  }
+}
+
+void CCea608Decoder::ProcessPreambleAddress(uint8_t cc1, uint8_t cc2)
+{
+  const int row = PAC_ROWS[((cc1 & 0x07) << 1) | ((cc2 & 0x20) >> 5)];
+  if (row < 0)
+    return;
+
+  if (m_mode == Mode::ROLL_UP)
+  {
+    // Move the roll-up window to the new base row
+    const int baseRow = std::max(row, m_rollUpRows - 1);
+    if (baseRow != m_row)
+    {
+      std::vector<CaptionRow> memory(ROWS, CaptionRow(COLUMNS));
+      for (int i{0}; i < m_rollUpRows && i <= m_row; ++i)
+      {
+        memory[baseRow - i] = m_displayedMemory[m_row - i];
+      }
+      m_displayedMemory.swap(memory);
+    }
+    m_row = baseRow;
+  }
+  else
+  {
+    m_row = row;
+  }
+
+  // The attributes are a color with italics, or an indent of 4 columns steps
+  const uint8_t attribute = cc2 & 0x1E;
+  if (attribute & 0x10)
+  {
+    m_column = ((attribute & 0x0E) >> 1) * 4;
+    m_isItalic = false;
+  }
+  else
+  {
+    m_column = 0;
+    m_isItalic = attribute == 0x0E;
+  }
+}
+
+void CCea608Decoder::PutChar(char32_t ch)
+{
+  if (m_mode == Mode::NONE || m_mode == Mode::TEXT)
+    return;
+
+  GetWriteMemory()[m_row][m_column] = {ch, m_isItalic};
+  // The characters after the last column replace the last character
+  if (m_column < COLUMNS - 1)
+    ++m_column;
+}
+
+void CCea608Decoder::Backspace()
+{
+  if (m_mode == Mode::NONE || m_mode == Mode::TEXT || m_column == 0)
+    return;
+
+  --m_column;
+  GetWriteMemory()[m_row][m_column] = CaptionCell();
+}
+
+void CCea608Decoder::CarriageReturn()
+{
+  const int topRow = m_row - m_rollUpRows + 1;
+  for (int row{0}; row < m_row; ++row)
+  {
+    if (row >= topRow)
+      m_displayedMemory[row] = m_displayedMemory[row + 1];
+    else
+      m_displayedMemory[row].assign(COLUMNS, CaptionCell());
+  }
+  m_displayedMemory[m_row].assign(COLUMNS, CaptionCell());
+  m_column = 0;
+}
+
+void CCea608Decoder::EraseRows(std::vector<CaptionRow>& memory)
+{
+  for (CaptionRow& row : memory)
+  {
+    row.assign(COLUMNS, CaptionCell());
+  }
+}
+
+std::vector<CaptionRow>& CCea608Decoder::GetWriteMemory()
+{
+  return m_mode == Mode::POP_ON ? m_nonDisplayedMemory : m_displayedMemory;
+}
@@ -0,0 +1,66 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include "CaptionDecoder.h"
+
+/*!
+ * \brief CEA-608 line 21 caption decoder for a data channel (CC1..CC4),
+ *        supports the pop-on, paint-on and roll-up caption modes.
+ *        The positioning is kept only to order the rows, the colors
+ *        and the text mode (T1..T4) are not supported.
+ */
+class ATTR_DLL_LOCAL CCea608Decoder : public CCaptionDecoder
+{
+public:
+  /*!
+   * \param channel The caption channel number, 1..4 for CC1..CC4
+   */
+  CCea608Decoder(int channel);
+
+  void Reset() override;
+
+protected:
+  void ProcessPair(uint8_t type, uint8_t data1, uint8_t data2) override;
+  std::string GetDisplayedText() const override;
+
+private:
+  enum class Mode
+  {
+    NONE,
+    POP_ON,
+    PAINT_ON,
+    ROLL_UP,
+    TEXT,
+  };
+
+  void ProcessControl(uint8_t cc1, uint8_t cc2);
+  void ProcessMiscCommand(uint8_t cc2);
+  void ProcessPreambleAddress(uint8_t cc1, uint8_t cc2);
+  void PutChar(char32_t ch);
+  void Backspace();
+  void CarriageReturn();
+  void EraseRows(std::vector<CaptionRow>& memory);
+  // The memory written by the current caption mode
+  std::vector<CaptionRow>& GetWriteMemory();
+
+  uint8_t m_field; // The cc_type of the field carrying the channel
+  int m_dataChannel; // The data channel in the field, 0 or 1
+  int m_currentDataChannel{-1}; // The data channel of the last control code received
+  Mode m_mode{Mode::NONE};
+  std::vector<CaptionRow> m_displayedMemory;
+  std::vector<CaptionRow> m_nonDisplayedMemory;
+  int m_row; // Cursor row, 0 based
+  int m_column{0}; // Cursor column, 0 based
+  int m_rollUpRows{2};
+  bool m_isItalic{false};
+  // The last control code, the control codes are sent twice for redundancy
+  uint8_t m_lastControl1{0};
+  uint8_t m_lastControl2{0};
+};
@@ -0,0 +1,398 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "Cea708Decoder.h"
+
+#include <algorithm>
+
+namespace
+{
+// The service blocks of the extended services have the service number 7
+constexpr int EXTENDED_SERVICE = 7;
+
+// Size of the C1 codes with their parameters, indexed by code - 0x80
+constexpr size_t C1_CODE_SIZES[32] = {1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 1, 1,
+                                      3, 4, 3, 1, 1, 1, 1, 5, 7, 7, 7, 7, 7, 7, 7, 7};
+
+// The G2 characters supported, other characters are ignored
+char32_t GetG2Char(uint8_t code)
+{
+  switch (code)
+  {
+    case 0x20: // Transparent space
+    case 0x21: // Non-breaking transparent space
+      return U' ';
+    case 0x25:
+      return 0x2026;
+    case 0x2A:
+      return 0x160;
+    case 0x2C:
+      return 0x152;
+    case 0x30:
+      return 0x2588;
+    case 0x31:
+      return 0x2018;
+    case 0x32:
+      return 0x2019;
+    case 0x33:
+      return 0x201C;
+    case 0x34:
+      return 0x201D;
+    case 0x35:
+      return 0x2022;
+    case 0x39:
+      return 0x2122;
+    case 0x3A:
+      return 0x161;
+    case 0x3C:
+      return 0x153;
+    case 0x3D:
+      return 0x2120;
+    case 0x3F:
+      return 0x178;
+    default:
+      return 0;
+  }
+}
+} // unnamed namespace
+
+CCea708Decoder::CCea708Decoder(int service) : m_service{service}
+{
+}
+
+void CCea708Decoder::Reset()
+{
+  CCaptionDecoder::Reset();
+  m_packet.clear();
+  m_packetSize = 0;
+  m_windows.fill(Window());
+  m_currentWindow = -1;
+}
+
+void CCea708Decoder::ProcessPair(uint8_t type, uint8_t data1, uint8_t data2)
+{
+  if (type == 3)
+  {
+    // Start of a DTVCC packet, the header has the sequence number and the packet size
+    if (!m_packet.empty())
+      ProcessPacket();
+
+    const uint8_t sizeCode = data1 & 0x3F;
+    m_packetSize = sizeCode == 0 ? 128 : sizeCode * 2;
+    m_packet.assign({data1, data2});
+  }
+  else if (type == 2)
+  {
+    if (m_packet.empty())
+      return;
+    m_packet.push_back(data1);
+    m_packet.push_back(data2);
+  }
+  else
+  {
+    return;
+  }
+
+  if (m_packet.size() >= m_packetSize)
+    ProcessPacket();
+}
+
+std::string CCea708Decoder::GetDisplayedText() const
+{
+  std::vector<const Window*> windows;
+  for (const Window& window : m_windows)
+  {
+    if (window.m_isDefined && window.m_isVisible)
+      windows.emplace_back(&window);
+  }
+  // Lower priority number is higher priority
+  std::stable_sort(windows.begin(), windows.end(), [](const Window* left, const Window* right)
+                   { return left->m_priority < right->m_priority; });
+
+  std::string text;
+  for (const Window* window : windows)
+  {
+    std::string windowText{RenderRows(window->m_rows)};
+    if (windowText.empty())
+      continue;
+    if (!text.empty())
+      text += '\n';
+    text += windowText;
+  }
+  return text;
+}
+
+void CCea708Decoder::ProcessPacket()
+{
+  // Skip the packet header, an incomplete packet is processed up to the data received
+  const uint8_t* data = m_packet.data() + 1;
+  const size_t size = std::min(m_packet.size(), m_packetSize) - 1;
+  size_t pos{0};
+
+  while (pos < size)
+  {
+    // service_number (3) | block_size (5)
+    int service = data[pos] >> 5;
+    const size_t blockSize = data[pos] & 0x1F;
+    ++pos;
+
+    // Null service block, the rest of the packet is padding
+    if (service == 0)
+      break;
+
+    if (service == EXTENDED_SERVICE)
+    {
+      if (pos >= size)
+        break;
+      service = data[pos++] & 0x3F;
+    }
+    if (pos + blockSize > size)
+      break;
+
+    if (service == m_service)
+      ProcessServiceBlock(data + pos, blockSize);
+    pos += blockSize;
+  }
+
+  m_packet.clear();
+  m_packetSize = 0;
+}
+
+void CCea708Decoder::ProcessServiceBlock(const uint8_t* data, size_t size)
+{
+  size_t pos{0};
+  while (pos < size)
+  {
+    const size_t codeSize = ProcessCode(data + pos, size - pos);
+    if (codeSize == 0)
+      break;
+    pos += codeSize;
+  }
+}
+
+size_t CCea708Decoder::ProcessCode(const uint8_t* data, size_t size)
+{
+  const uint8_t code = data[0];
+
+  if (code == 0x10) // EXT1
+  {
+    const size_t extSize = size > 1 ? ProcessExtendedCode(data + 1, size - 1) : 0;
+    return extSize > 0 ? extSize + 1 : 0;
+  }
+
+  if (code < 0x20) // C0 codes
+  {
+    const size_t codeSize = code >= 0x18 ? 3 : (code >= 0x11 ? 2 : 1);
+    if (codeSize > size)
+      return 0;
+
+    Window* window = GetCurrentWindow();
+    if (!window)
+      return codeSize;
+
+    switch (code)
+    {
+      case 0x08: // BS Backspace
+        if (window->m_column > 0)
+          window->m_rows[window->m_row][--window->m_column] = CaptionCell();
+        break;
+      case 0x0C: // FF Form Feed
+        ClearWindow(*window);
+        break;
+      case 0x0D: // CR Carriage Return
+        CarriageReturn();
+        break;
+      case 0x0E: // HCR Horizontal Carriage Return
+        window->m_rows[window->m_row].assign(window->m_columnCount, CaptionCell());
+        window->m_column = 0;
+        break;
+      default: // NUL, ETX and the P16 characters are ignored
+        break;
+    }
+    return codeSize;
+  }
+
+  if (code < 0x80) // G0 characters, ASCII except the music note
+  {
+    PutChar(code == 0x7F ? 0x266A : code);
+    return 1;
+  }
+
+  if (code < 0xA0) // C1 codes
+  {
+    const size_t codeSize = C1_CODE_SIZES[code - 0x80];
+    if (codeSize > size)
+      return 0;
+
+    if (code <= 0x87) // CW0..CW7 Set Current Window
+    {
+      if (m_windows[code - 0x80].m_isDefined)
+        m_currentWindow = code - 0x80;
+    }
+    else if (code <= 0x8C) // CLW, DSW, HDW, TGW, DLW
+    {
+      ProcessWindowsCommand(code, data[1]);
+    }
+    else if (code == 0x8F) // RST Reset
+    {
+      m_windows.fill(Window());
+      m_currentWindow = -1;
+    }
+    else if (code == 0x90) // SPA Set Pen Attributes
+    {
+      if (Window* window = GetCurrentWindow())
+        window->m_isItalic = data[2] & 0x80;
+    }
+    else if (code == 0x92) // SPL Set Pen Location
+    {
+      if (Window* window = GetCurrentWindow())
+      {
+        window->m_row = std::min<int>(data[1] & 0x0F, window->m_rowCount - 1);
+        window->m_column = std::min<int>(data[2] & 0x3F, window->m_columnCount - 1);
+      }
+    }
+    else if (code >= 0x98) // DF0..DF7 Define Window
+    {
+      DefineWindow(code - 0x98, data + 1);
+    }
+    // DLY, DLC, SPC, SWA and the reserved codes are ignored
+    return codeSize;
+  }
+
+  // G1 characters, ISO 8859-1
+  PutChar(code);
+  return 1;
+}
+
+size_t CCea708Decoder::ProcessExtendedCode(const uint8_t* data, size_t size)
+{
+  const uint8_t code = data[0];
+  size_t codeSize{1};
+
+  if (code < 0x20) // C2 codes, no command defined
+    codeSize = 1 + code / 8;
+  else if (code < 0x80) // G2 characters
+  {
+    const char32_t ch = GetG2Char(code);
+    if (ch != 0)
+      PutChar(ch);
+  }
+  else if (code < 0x88) // C3 codes
+    codeSize = 5;
+  else if (code < 0x90)
+    codeSize = 6;
+  else if (code < 0xA0) // Variable length codes
+    codeSize = size > 1 ? 2 + (data[1] & 0x3F) : 2;
+  // G3 characters, only the closed caption icon is defined
+
+  return codeSize <= size ? codeSize : 0;
+}
+
+void CCea708Decoder::ProcessWindowsCommand(uint8_t command, uint8_t windowsBitmap)
+{
+  for (int windowId{0}; windowId < static_cast<int>(m_windows.size()); ++windowId)
+  {
+    if (!(windowsBitmap & (1 << windowId)))
+      continue;
+
+    Window& window = m_windows[windowId];
+    switch (command)
+    {
+      case 0x88: // CLW Clear Windows
+        if (window.m_isDefined)
+          ClearWindow(window);
+        break;
+      case 0x89: // DSW Display Windows
+        window.m_isVisible = true;
+        break;
+      case 0x8A: // HDW Hide Windows
+        window.m_isVisible = false;
+        break;
+      case 0x8B: // TGW Toggle Windows
+        window.m_isVisible = !window.m_isVisible;
+        break;
+      case 0x8C: // DLW Delete Windows
+        window = Window();
+        if (m_currentWindow == windowId)
+          m_currentWindow = -1;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void CCea708Decoder::DefineWindow(int windowId, const uint8_t* params)
+{
+  // params: visible, row / column lock, priority | relative positioning, anchor vertical |
+  //         anchor horizontal | anchor point, row count | column count | window / pen styles
+  Window& window = m_windows[windowId];
+  window.m_isDefined = true;
+  window.m_isVisible = params[0] & 0x20;
+  window.m_priority = params[0] & 0x07;
+  window.m_rowCount = (params[3] & 0x0F) + 1;
+  window.m_columnCount = (params[4] & 0x3F) + 1;
+
+  // A window already defined keep its text
+  window.m_rows.resize(window.m_rowCount);
+  for (CaptionRow& row : window.m_rows)
+  {
+    row.resize(window.m_columnCount);
+  }
+  window.m_row = std::min(window.m_row, window.m_rowCount - 1);
+  window.m_column = std::min(window.m_column, window.m_columnCount - 1);
+
+  m_currentWindow = windowId;
+}
+
+void CCea708Decoder::PutChar(char32_t ch)
+{
+  Window* window = GetCurrentWindow();
+  if (!window)
+    return;
+
+  // Wrap the text exceeding the window width
+  if (window->m_column >= window->m_columnCount)
+    CarriageReturn();
+
+  window->m_rows[window->m_row][window->m_column++] = {ch, window->m_isItalic};
+}
+
+void CCea708Decoder::CarriageReturn()
+{
+  Window* window = GetCurrentWindow();
+  if (!window)
+    return;
+
+  window->m_column = 0;
+  if (window->m_row + 1 < window->m_rowCount)
+  {
+    ++window->m_row;
+    return;
+  }
+  // Scroll up the rows
+  window->m_rows.erase(window->m_rows.begin());
+  window->m_rows.emplace_back(window->m_columnCount);
+}
+
+void CCea708Decoder::ClearWindow(Window& window)
+{
+  for (CaptionRow& row : window.m_rows)
+  {
+    row.assign(window.m_columnCount, CaptionCell());
+  }
+  window.m_row = 0;
+  window.m_column = 0;
+}
+
+CCea708Decoder::Window* CCea708Decoder::GetCurrentWindow()
+{
+  if (m_currentWindow < 0 || !m_windows[m_currentWindow].m_isDefined)
+    return nullptr;
+  return &m_windows[m_currentWindow];
+}
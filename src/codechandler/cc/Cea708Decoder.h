@@ -0,0 +1,70 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include "CaptionDecoder.h"
+
+#include <array>
+
+/*!
+ * \brief CEA-708 DTVCC caption decoder for a caption service (1..63).
+ *        The windows are decoded as text grids shown / hidden by the window
+ *        commands, the window positions and the pen / window styles except
+ *        italics are not supported.
+ */
+class ATTR_DLL_LOCAL CCea708Decoder : public CCaptionDecoder
+{
+public:
+  /*!
+   * \param service The caption service number, 1..63
+   */
+  CCea708Decoder(int service);
+
+  void Reset() override;
+
+protected:
+  void ProcessPair(uint8_t type, uint8_t data1, uint8_t data2) override;
+  std::string GetDisplayedText() const override;
+
+private:
+  struct Window
+  {
+    bool m_isDefined{false};
+    bool m_isVisible{false};
+    int m_priority{0};
+    int m_rowCount{0};
+    int m_columnCount{0};
+    std::vector<CaptionRow> m_rows;
+    int m_row{0};
+    int m_column{0};
+    bool m_isItalic{false};
+  };
+
+  void ProcessPacket();
+  void ProcessServiceBlock(const uint8_t* data, size_t size);
+  /*!
+   * \brief Process a code of the service block.
+   * \return The size of the code with its parameters, or 0 when the code is
+   *         truncated
+   */
+  size_t ProcessCode(const uint8_t* data, size_t size);
+  size_t ProcessExtendedCode(const uint8_t* data, size_t size);
+  void ProcessWindowsCommand(uint8_t command, uint8_t windowsBitmap);
+  void DefineWindow(int windowId, const uint8_t* params);
+  void PutChar(char32_t ch);
+  void CarriageReturn();
+  void ClearWindow(Window& window);
+  Window* GetCurrentWindow();
+
+  int m_service;
+  std::vector<uint8_t> m_packet; // The DTVCC packet being assembled
+  size_t m_packetSize{0};
+  std::array<Window, 8> m_windows;
+  int m_currentWindow{-1};
+};
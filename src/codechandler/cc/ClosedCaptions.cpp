@@ -0,0 +1,282 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "ClosedCaptions.h"
+
+#include "../../utils/StringUtils.h"
+#include "../../utils/log.h"
+#include "Cea608Decoder.h"
+#include "Cea708Decoder.h"
+
+#include <algorithm>
+
+using namespace UTILS;
+
+namespace
+{
+// Maximum number of pictures reordered, the pictures are decoded in presentation
+// order once the number of pictures pending exceed the reorder depth
+constexpr size_t REORDER_DEPTH = 8;
+
+constexpr uint8_t SEI_USER_DATA_REGISTERED = 4;
+constexpr uint8_t AVC_NAL_SEI = 6;
+constexpr uint8_t HEVC_NAL_PREFIX_SEI = 39;
+constexpr uint8_t HEVC_NAL_SUFFIX_SEI = 40;
+
+// Parse the ATSC A/53 cc_data of a user_data_registered_itu_t_t35 SEI message
+void ParseUserDataRegistered(const uint8_t* data, size_t size, std::vector<uint8_t>& ccData)
+{
+  // itu_t_t35_country_code (USA), itu_t_t35_provider_code (ATSC), user_identifier "GA94"
+  // and user_data_type_code (cc_data)
+  static constexpr uint8_t ATSC_CC_HEADER[] = {0xB5, 0x00, 0x31, 'G', 'A', '9', '4', 0x03};
+  constexpr size_t headerSize = sizeof(ATSC_CC_HEADER);
+
+  if (size < headerSize + 2 || !std::equal(data, data + headerSize, ATSC_CC_HEADER))
+    return;
+
+  data += headerSize;
+  size -= headerSize;
+
+  // process_em_data_flag (1) | process_cc_data_flag (1) | additional_data_flag (1) | cc_count (5)
+  if (!(data[0] & 0x40))
+    return;
+  const size_t ccCount = data[0] & 0x1F;
+  // Skip em_data
+  data += 2;
+  size -= 2;
+
+  const size_t ccSize = std::min(ccCount * 3, size - size % 3);
+  ccData.insert(ccData.end(), data, data + ccSize);
+}
+
+// Remove the emulation prevention bytes of a NAL unit payload
+void Unescape(const uint8_t* data, size_t size, std::vector<uint8_t>& rbsp)
+{
+  rbsp.clear();
+  rbsp.reserve(size);
+  size_t zeroCount{0};
+  for (size_t i{0}; i < size; ++i)
+  {
+    if (zeroCount >= 2 && data[i] == 0x03)
+    {
+      zeroCount = 0;
+      continue;
+    }
+    zeroCount = data[i] == 0 ? zeroCount + 1 : 0;
+    rbsp.push_back(data[i]);
+  }
+}
+
+void ParseNalUnit(const uint8_t* nal,
+                  size_t size,
+                  bool isHevc,
+                  std::vector<uint8_t>& rbsp,
+                  std::vector<uint8_t>& ccData)
+{
+  const size_t headerSize = isHevc ? 2 : 1;
+  if (size <= headerSize)
+    return;
+
+  const uint8_t nalType = isHevc ? (nal[0] >> 1) & 0x3F : nal[0] & 0x1F;
+  const bool isSei = isHevc ? nalType == HEVC_NAL_PREFIX_SEI || nalType == HEVC_NAL_SUFFIX_SEI
+                            : nalType == AVC_NAL_SEI;
+  if (!isSei)
+    return;
+
+  Unescape(nal + headerSize, size - headerSize, rbsp);
+  ParseSEICaptionData(rbsp.data(), rbsp.size(), ccData);
+}
+} // unnamed namespace
+
+void ExtractCaptionData(const uint8_t* data,
+                        size_t size,
+                        uint8_t naluLengthSize,
+                        bool isHevc,
+                        std::vector<uint8_t>& ccData)
+{
+  std::vector<uint8_t> rbsp;
+
+  if (naluLengthSize > 0)
+  {
+    size_t pos{0};
+    while (pos + naluLengthSize <= size)
+    {
+      size_t nalSize{0};
+      for (uint8_t i{0}; i < naluLengthSize; ++i)
+      {
+        nalSize = (nalSize << 8) | data[pos++];
+      }
+      if (nalSize > size - pos)
+        break;
+
+      ParseNalUnit(data + pos, nalSize, isHevc, rbsp, ccData);
+      pos += nalSize;
+    }
+    return;
+  }
+
+  // Annex B, the NAL units are delimited by the 0x000001 start codes
+  size_t nalStart{0};
+  bool hasNal{false};
+  for (size_t pos{0}; pos + 3 <= size; ++pos)
+  {
+    if (data[pos] != 0 || data[pos + 1] != 0 || data[pos + 2] != 1)
+      continue;
+
+    if (hasNal)
+    {
+      // The trailing zero of a 4 bytes start code belongs to the next start code
+      size_t nalEnd{pos};
+      while (nalEnd > nalStart && data[nalEnd - 1] == 0)
+        --nalEnd;
+      ParseNalUnit(data + nalStart, nalEnd - nalStart, isHevc, rbsp, ccData);
+    }
+    nalStart = pos + 3;
+    hasNal = true;
+    pos += 2;
+  }
+  if (hasNal && nalStart < size)
+    ParseNalUnit(data + nalStart, size - nalStart, isHevc, rbsp, ccData);
+}
+
+void ParseSEICaptionData(const uint8_t* rbsp, size_t size, std::vector<uint8_t>& ccData)
+{
+  size_t pos{0};
+
+  // The last byte is the rbsp_trailing_bits
+  while (pos < size && !(pos + 1 == size && rbsp[pos] == 0x80))
+  {
+    size_t payloadType{0};
+    while (pos < size && rbsp[pos] == 0xFF)
+    {
+      payloadType += 255;
+      ++pos;
+    }
+    if (pos >= size)
+      return;
+    payloadType += rbsp[pos++];
+
+    size_t payloadSize{0};
+    while (pos < size && rbsp[pos] == 0xFF)
+    {
+      payloadSize += 255;
+      ++pos;
+    }
+    if (pos >= size)
+      return;
+    payloadSize += rbsp[pos++];
+
+    if (payloadSize > size - pos)
+      return;
+
+    if (payloadType == SEI_USER_DATA_REGISTERED)
+      ParseUserDataRegistered(rbsp + pos, payloadSize, ccData);
+
+    pos += payloadSize;
+  }
+}
+
+void CClosedCaptions::SetChannels(const std::vector<PLAYLIST::ClosedCaption>& channels)
+{
+  if (channels.size() == m_channels.size() &&
+      std::equal(channels.begin(), channels.end(), m_channels.begin(),
+                 [](const PLAYLIST::ClosedCaption& left, const Channel& right)
+                 { return left.m_instreamId == right.m_info.m_instreamId; }))
+  {
+    return;
+  }
+
+  m_channels.clear();
+  m_pendingPictures.clear();
+
+  for (const PLAYLIST::ClosedCaption& closedCaption : channels)
+  {
+    Channel channel;
+    channel.m_info = closedCaption;
+
+    const std::string& instreamId = closedCaption.m_instreamId;
+    if (STRING::StartsWith(instreamId, "CC"))
+    {
+      const int number = STRING::ToInt32(instreamId.substr(2));
+      if (number >= 1 && number <= 4)
+        channel.m_decoder = std::make_unique<CCea608Decoder>(number);
+    }
+    else if (STRING::StartsWith(instreamId, "SERVICE"))
+    {
+      const int number = STRING::ToInt32(instreamId.substr(7));
+      if (number >= 1 && number <= 63)
+        channel.m_decoder = std::make_unique<CCea708Decoder>(number);
+    }
+
+    if (!channel.m_decoder)
+    {
+      LOG::LogF(LOGWARNING, "Unsupported closed caption channel \"%s\"", instreamId.c_str());
+      continue;
+    }
+    m_channels.emplace_back(std::move(channel));
+  }
+}
+
+void CClosedCaptions::EnableChannel(size_t index, bool isEnabled)
+{
+  if (index >= m_channels.size() || m_channels[index].m_isEnabled == isEnabled)
+    return;
+
+  m_channels[index].m_isEnabled = isEnabled;
+  // The channels are decoded only while enabled, start again from a clean state
+  m_channels[index].m_decoder->Reset();
+}
+
+bool CClosedCaptions::IsEnabled() const
+{
+  return std::any_of(m_channels.begin(), m_channels.end(),
+                     [](const Channel& channel) { return channel.m_isEnabled; });
+}
+
+void CClosedCaptions::AddPicture(uint64_t pts, std::vector<uint8_t> ccData)
+{
+  m_pendingPictures.emplace(pts, std::move(ccData));
+
+  while (m_pendingPictures.size() > REORDER_DEPTH)
+  {
+    auto itPicture = m_pendingPictures.begin();
+    DecodePicture(itPicture->first, itPicture->second);
+    m_pendingPictures.erase(itPicture);
+  }
+}
+
+bool CClosedCaptions::TakeCue(size_t& index, CaptionCue& cue)
+{
+  for (size_t i{0}; i < m_channels.size(); ++i)
+  {
+    if (m_channels[i].m_isEnabled && m_channels[i].m_decoder->TakeCue(cue))
+    {
+      index = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+void CClosedCaptions::Reset()
+{
+  m_pendingPictures.clear();
+  for (Channel& channel : m_channels)
+  {
+    channel.m_decoder->Reset();
+  }
+}
+
+void CClosedCaptions::DecodePicture(uint64_t pts, const std::vector<uint8_t>& ccData)
+{
+  for (Channel& channel : m_channels)
+  {
+    if (channel.m_isEnabled)
+      channel.m_decoder->Decode(ccData.data(), ccData.size(), pts);
+  }
+}
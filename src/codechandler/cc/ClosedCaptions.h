@@ -0,0 +1,94 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include "../../common/AdaptiveUtils.h"
+#include "CaptionDecoder.h"
+
+#include <map>
+#include <memory>
+
+/*!
+ * \brief Extract the CEA-608/708 cc_data from the SEI NAL units of an AVC / HEVC
+ *        access unit, carried as ATSC A/53 user data (user_data_registered_itu_t_t35).
+ * \param data The access unit data
+ * \param size The data size
+ * \param naluLengthSize The size of the NAL unit length prefix, 0 for Annex B start codes
+ * \param isHevc True for HEVC NAL units, otherwise AVC
+ * \param ccData [OUT] The cc_data triplets found are appended
+ */
+void ExtractCaptionData(const uint8_t* data,
+                        size_t size,
+                        uint8_t naluLengthSize,
+                        bool isHevc,
+                        std::vector<uint8_t>& ccData);
+
+/*!
+ * \brief Parse the cc_data of a SEI message payload.
+ * \param rbsp The SEI RBSP, after the NAL unit header, without emulation prevention bytes
+ * \param size The RBSP size
+ * \param ccData [OUT] The cc_data triplets found are appended
+ */
+void ParseSEICaptionData(const uint8_t* rbsp, size_t size, std::vector<uint8_t>& ccData);
+
+/*!
+ * \brief Closed captions of the video stream, decode the cc_data of the
+ *        pictures into the cues of the caption channels signalled in the manifest.
+ */
+class ATTR_DLL_LOCAL CClosedCaptions
+{
+public:
+  /*!
+   * \brief Set the caption channels, the decoders are created again only
+   *        when the channels are changed.
+   */
+  void SetChannels(const std::vector<PLAYLIST::ClosedCaption>& channels);
+
+  size_t GetChannelCount() const { return m_channels.size(); }
+  const PLAYLIST::ClosedCaption& GetChannel(size_t index) const { return m_channels[index].m_info; }
+
+  void EnableChannel(size_t index, bool isEnabled);
+  // Check if at least a channel is enabled
+  bool IsEnabled() const;
+
+  /*!
+   * \brief Add the cc_data of a picture, the pictures are added in decode order
+   *        and are decoded in presentation order.
+   * \param pts The presentation time of the picture
+   * \param ccData The cc_data triplets, can be empty
+   */
+  void AddPicture(uint64_t pts, std::vector<uint8_t> ccData);
+
+  /*!
+   * \brief Get and remove the next cue of the enabled channels.
+   * \param index [OUT] The channel index
+   * \param cue [OUT] The cue
+   * \return True if a cue was available, otherwise false
+   */
+  bool TakeCue(size_t& index, CaptionCue& cue);
+
+  /*!
+   * \brief Clear the pictures pending and the decoders state, e.g. after a seek.
+   */
+  void Reset();
+
+private:
+  struct Channel
+  {
+    PLAYLIST::ClosedCaption m_info;
+    std::unique_ptr<CCaptionDecoder> m_decoder;
+    bool m_isEnabled{false};
+  };
+
+  void DecodePicture(uint64_t pts, const std::vector<uint8_t>& ccData);
+
+  std::vector<Channel> m_channels;
+  // Pictures waiting to be decoded in presentation order, by pts
+  std::multimap<uint64_t, std::vector<uint8_t>> m_pendingPictures;
+};
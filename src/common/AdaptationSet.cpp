@@ -54,6 +54,16 @@ std::vector<CRepresentation*> PLAYLIST::CAdaptationSet::GetRepresentationsPtr()
   return ptrReprs;
 }
 
+void PLAYLIST::CAdaptationSet::AddClosedCaption(const ClosedCaption& closedCaption)
+{
+  if (std::none_of(m_closedCaptions.begin(), m_closedCaptions.end(),
+                   [&closedCaption](const ClosedCaption& cc)
+                   { return cc.m_instreamId == closedCaption.m_instreamId; }))
+  {
+    m_closedCaptions.push_back(closedCaption);
+  }
+}
+
 void PLAYLIST::CAdaptationSet::CopyHLSData(const CAdaptationSet* other)
 {
   m_representations.reserve(other->m_representations.size());
@@ -79,6 +89,7 @@ void PLAYLIST::CAdaptationSet::CopyHLSData(const CAdaptationSet* other)
   m_group = other->m_group;
   m_codecs = other->m_codecs;
   m_name = other->m_name;
+  m_closedCaptions = other->m_closedCaptions;
 }
 
 bool PLAYLIST::CAdaptationSet::IsMergeable(const CAdaptationSet* other) const
@@ -102,6 +102,13 @@ public:
   bool IsForced() const { return m_isForced; }
   void SetIsForced(bool isForced) { m_isForced = isForced; }
 
+  /*!
+   * \brief Add a closed caption channel carried in the video of this adaptation set,
+   *        a channel already added with the same instream id is ignored.
+   */
+  void AddClosedCaption(const ClosedCaption& closedCaption);
+  const std::vector<ClosedCaption>& GetClosedCaptions() const { return m_closedCaptions; }
+
   void CopyHLSData(const CAdaptationSet* other);
 
   bool IsMergeable(const CAdaptationSet* other) const;
@@ -125,6 +132,7 @@ protected:
 
   std::string m_language;
   std::vector<std::string> m_switchingIds;
+  std::vector<ClosedCaption> m_closedCaptions;
 
   CSpinCache<uint32_t> m_segmentTimelineDuration;
 
@@ -8,48 +8,186 @@
 
 #include "AdaptiveCencSampleDecrypter.h"
 
+#include <algorithm>
+#include <limits>
+
 CAdaptiveCencSampleDecrypter::CAdaptiveCencSampleDecrypter(
     Adaptive_CencSingleSampleDecrypter* singleSampleDecrypter,
-    AP4_CencSampleInfoTable* sampleInfoTable)
-  : AP4_CencSampleDecrypter(singleSampleDecrypter, sampleInfoTable)
+    AP4_CencSampleInfoTable* sampleInfoTable,
+    const CCencSampleGroups* sampleGroups)
+  : AP4_CencSampleDecrypter(singleSampleDecrypter, sampleInfoTable), m_sampleGroups{sampleGroups}
 {
   m_decrypter = singleSampleDecrypter;
 }
 
+AP4_Result CAdaptiveCencSampleDecrypter::SetSampleIndex(AP4_Ordinal sampleIndex)
+{
+  if (m_SampleInfoTable)
+    return AP4_CencSampleDecrypter::SetSampleIndex(sampleIndex);
+
+  m_SampleCursor = sampleIndex;
+  return AP4_SUCCESS;
+}
+
 AP4_Result CAdaptiveCencSampleDecrypter::DecryptSampleData(AP4_UI32 poolid,
-                                       AP4_DataBuffer& data_in,
-                                       AP4_DataBuffer& data_out,
-                                       const AP4_UI08* iv)
+                                                           AP4_DataBuffer& data_in,
+                                                           AP4_DataBuffer& data_out,
+                                                           const AP4_UI08* iv)
+{
+  // increment the sample cursor
+  const unsigned int sample_cursor = m_SampleCursor++;
+
+  SampleParams params;
+  AP4_Result result{GetSampleParams(sample_cursor, iv, params)};
+  if (AP4_FAILED(result))
+    return result;
+
+  if (!params.m_isProtected)
+    return DecryptClearSample(poolid, data_in, data_out, params.m_keyInfo);
+
+  // decrypt the sample
+  return m_decrypter->DecryptSampleData(poolid, data_in, data_out, params.m_iv,
+                                        params.m_subsampleCount, params.m_clearBytes,
+                                        params.m_cipherBytes,
+                                        params.m_hasKeyInfo ? &params.m_keyInfo : nullptr);
+}
+
+AP4_Result CAdaptiveCencSampleDecrypter::DecryptSampleBatch(AP4_UI32 poolid,
+                                                            std::vector<AP4_DataBuffer>& dataIn,
+                                                            std::vector<AP4_DataBuffer>& dataOut,
+                                                            std::vector<AP4_Result>& results)
+{
+  const size_t count{dataIn.size()};
+  if (dataOut.size() != count)
+    return AP4_ERROR_INVALID_PARAMETERS;
+
+  // The descriptors point to the params, allocate all before fill them
+  m_batchParams.assign(count, SampleParams());
+  m_batchDescs.clear();
+  m_batchDescSamples.clear();
+  results.assign(count, AP4_SUCCESS);
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    SampleParams& params{m_batchParams[i]};
+    results[i] = GetSampleParams(m_SampleCursor++, nullptr, params);
+
+    // The unencrypted samples of the sample groups are passed one by one
+    if (AP4_SUCCEEDED(results[i]) && !params.m_isProtected)
+      results[i] = DecryptClearSample(poolid, dataIn[i], dataOut[i], params.m_keyInfo);
+    else if (AP4_SUCCEEDED(results[i]))
+    {
+      SampleDecryptDesc& desc{m_batchDescs.emplace_back()};
+      desc.m_dataIn = &dataIn[i];
+      desc.m_dataOut = &dataOut[i];
+      desc.m_iv = params.m_iv;
+      desc.m_subsampleCount = params.m_subsampleCount;
+      desc.m_clearBytes = params.m_clearBytes;
+      desc.m_cipherBytes = params.m_cipherBytes;
+      desc.m_keyInfo = params.m_hasKeyInfo ? &params.m_keyInfo : nullptr;
+      m_batchDescSamples.emplace_back(i);
+    }
+  }
+
+  if (!m_batchDescs.empty())
   {
-    // increment the sample cursor
-    unsigned int sample_cursor = m_SampleCursor++;
+    m_decrypter->DecryptSampleBatch(poolid, m_batchDescs.data(), m_batchDescs.size());
+    for (size_t i = 0; i < m_batchDescs.size(); ++i)
+      results[m_batchDescSamples[i]] = m_batchDescs[i].m_result;
+  }
 
-    // setup the IV
-    unsigned char iv_block[16];
-    if (!iv)
+  AP4_Result result{AP4_SUCCESS};
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (AP4_FAILED(results[i]))
     {
-      iv = m_SampleInfoTable->GetIv(sample_cursor);
+      dataOut[i].SetDataSize(0);
+      if (AP4_SUCCEEDED(result))
+        result = results[i];
     }
-    if (!iv)
-      return AP4_ERROR_INVALID_FORMAT;
-    unsigned int iv_size = m_SampleInfoTable->GetIvSize();
-    AP4_CopyMemory(iv_block, iv, iv_size);
-    if (iv_size != 16)
-      AP4_SetMemory(&iv_block[iv_size], 0, 16 - iv_size);
-
-    // get the subsample info for this sample if needed
-    unsigned int subsample_count = 0;
-    const AP4_UI16* bytes_of_cleartext_data = nullptr;
-    const AP4_UI32* bytes_of_encrypted_data = nullptr;
-    if (m_SampleInfoTable)
+  }
+  return result;
+}
+
+AP4_Result CAdaptiveCencSampleDecrypter::GetSampleParams(unsigned int sampleCursor,
+                                                         const AP4_UI08* iv,
+                                                         SampleParams& params)
+{
+  // the sample group of the sample can override the fragment key and pattern
+  const CCencSampleGroups::Entry* entry{
+      m_sampleGroups ? m_sampleGroups->GetEntry(sampleCursor) : nullptr};
+  if (entry)
+  {
+    params.m_keyInfo.m_keyId = entry->m_keyId;
+    params.m_keyInfo.m_cryptBlocks = entry->m_cryptBlocks;
+    params.m_keyInfo.m_skipBlocks = entry->m_skipBlocks;
+    params.m_hasKeyInfo = true;
+
+    if (!entry->m_isProtected)
     {
-      AP4_Result result = m_SampleInfoTable->GetSampleInfo(
-          sample_cursor, subsample_count, bytes_of_cleartext_data, bytes_of_encrypted_data);
-      if (AP4_FAILED(result))
-        return result;
+      params.m_isProtected = false;
+      return AP4_SUCCESS;
     }
+  }
+  else if (m_hasDefaultKeyInfo)
+  {
+    params.m_keyInfo = m_defaultKeyInfo;
+    params.m_hasKeyInfo = true;
+  }
 
-    // decrypt the sample
-    return m_decrypter->DecryptSampleData(poolid, data_in, data_out, iv_block, subsample_count,
-                                          bytes_of_cleartext_data, bytes_of_encrypted_data);
+  // with sample groups the IV size can change per sample, the info table
+  // of Bento4 cannot handle it, use the sample info parsed with the groups
+  const CCencSampleGroups::SampleInfo* sampleInfo{
+      m_sampleGroups ? m_sampleGroups->GetSampleInfo(sampleCursor) : nullptr};
+  if (sampleInfo)
+  {
+    AP4_CopyMemory(params.m_iv, sampleInfo->m_iv, 16);
+    params.m_subsampleCount = static_cast<unsigned int>(sampleInfo->m_clearBytes.size());
+    if (params.m_subsampleCount > 0)
+    {
+      params.m_clearBytes = sampleInfo->m_clearBytes.data();
+      params.m_cipherBytes = sampleInfo->m_cipherBytes.data();
+    }
+    return AP4_SUCCESS;
   }
+  if (!m_SampleInfoTable)
+    return AP4_ERROR_INVALID_FORMAT;
+
+  // setup the IV
+  if (!iv)
+    iv = m_SampleInfoTable->GetIv(sampleCursor);
+  if (!iv)
+    return AP4_ERROR_INVALID_FORMAT;
+  const unsigned int iv_size = m_SampleInfoTable->GetIvSize();
+  AP4_CopyMemory(params.m_iv, iv, iv_size);
+  if (iv_size != 16)
+    AP4_SetMemory(&params.m_iv[iv_size], 0, 16 - iv_size);
+
+  // get the subsample info for this sample if needed
+  return m_SampleInfoTable->GetSampleInfo(sampleCursor, params.m_subsampleCount,
+                                          params.m_clearBytes, params.m_cipherBytes);
+}
+
+AP4_Result CAdaptiveCencSampleDecrypter::DecryptClearSample(AP4_UI32 poolid,
+                                                            AP4_DataBuffer& data_in,
+                                                            AP4_DataBuffer& data_out,
+                                                            const SampleKeyInfo& keyInfo)
+{
+  // The sample is passed through the decrypter as clear sub-samples
+  // so that the secure path still receive a valid sample header
+  static const AP4_UI08 zeroIv[16]{};
+  m_clearBytes.clear();
+  m_cipherBytes.clear();
+  AP4_Size remaining{data_in.GetDataSize()};
+  do
+  {
+    const AP4_Size clearBytes{std::min<AP4_Size>(remaining, std::numeric_limits<AP4_UI16>::max())};
+    m_clearBytes.emplace_back(static_cast<AP4_UI16>(clearBytes));
+    m_cipherBytes.emplace_back(0);
+    remaining -= clearBytes;
+  } while (remaining > 0);
+
+  return m_decrypter->DecryptSampleData(poolid, data_in, data_out, zeroIv,
+                                        static_cast<unsigned int>(m_clearBytes.size()),
+                                        m_clearBytes.data(), m_cipherBytes.data(), &keyInfo);
+}
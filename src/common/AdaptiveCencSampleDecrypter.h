@@ -7,20 +7,102 @@
  */
 
 #include "AdaptiveDecrypter.h"
+#include "CencSampleGroups.h"
+
+#include <vector>
 
 #include <bento4/Ap4.h>
 
 class CAdaptiveCencSampleDecrypter : public AP4_CencSampleDecrypter
 {
 public:
+  /*!
+   * \param singleSampleDecrypter The decrypter
+   * \param sampleInfoTable [OPT] The sample info table, can be nullptr only when
+   *                        the sample groups provide the sample encryption info
+   * \param sampleGroups [OPT] The CENC sample groups of the fragment, they select
+   *                     per sample the key, the pattern and the unencrypted samples
+   */
   CAdaptiveCencSampleDecrypter(Adaptive_CencSingleSampleDecrypter* singleSampleDecrypter,
-                               AP4_CencSampleInfoTable* sampleInfoTable);
+                               AP4_CencSampleInfoTable* sampleInfoTable,
+                               const CCencSampleGroups* sampleGroups = nullptr);
 
   virtual AP4_Result DecryptSampleData(AP4_UI32 poolid,
                                        AP4_DataBuffer& data_in,
                                        AP4_DataBuffer& data_out,
                                        const AP4_UI08* iv);
 
+  /*!
+   * \brief Decrypt a batch of consecutive samples of the fragment, starting from
+   *        the sample cursor, with a single request to the decrypter.
+   * \param poolid The fragment pool
+   * \param dataIn The encrypted samples
+   * \param dataOut [OUT] The decrypted samples, must have the same size of dataIn
+   * \param results [OUT] The decryption result of each sample
+   * \return AP4_SUCCESS if all samples are decrypted, otherwise the first failure
+   */
+  AP4_Result DecryptSampleBatch(AP4_UI32 poolid,
+                                std::vector<AP4_DataBuffer>& dataIn,
+                                std::vector<AP4_DataBuffer>& dataOut,
+                                std::vector<AP4_Result>& results);
+
+  AP4_Result SetSampleIndex(AP4_Ordinal sampleIndex);
+
+  /*!
+   * \brief Set the key and the pattern of the samples not mapped to a sample
+   *        group, when they differ from the fragment info of the decrypter.
+   * \param keyInfo The key info, the KID must remain valid for the fragment
+   */
+  void SetDefaultKeyInfo(const SampleKeyInfo& keyInfo)
+  {
+    m_defaultKeyInfo = keyInfo;
+    m_hasDefaultKeyInfo = true;
+  }
+
+  /*!
+   * \brief Replace the decrypter, used when the key of the next samples
+   *        is provided by a different license (key rotation).
+   */
+  void SetSingleSampleDecrypter(Adaptive_CencSingleSampleDecrypter* singleSampleDecrypter)
+  {
+    m_decrypter = singleSampleDecrypter;
+  }
+
+  /*!
+   * \brief Get the index of the next sample to be decrypted.
+   */
+  AP4_Ordinal GetSampleCursor() const { return m_SampleCursor; }
+
 protected:
+  struct SampleParams
+  {
+    SampleKeyInfo m_keyInfo;
+    bool m_hasKeyInfo{false}; // The sample group override the fragment key and pattern
+    bool m_isProtected{true};
+    AP4_UI08 m_iv[16]{};
+    unsigned int m_subsampleCount{0};
+    const AP4_UI16* m_clearBytes{nullptr};
+    const AP4_UI32* m_cipherBytes{nullptr};
+  };
+
+  /*!
+   * \brief Get the encryption parameters of a sample, from the sample groups
+   *        or from the sample info table.
+   */
+  AP4_Result GetSampleParams(unsigned int sampleCursor, const AP4_UI08* iv, SampleParams& params);
+
+  AP4_Result DecryptClearSample(AP4_UI32 poolid,
+                                AP4_DataBuffer& data_in,
+                                AP4_DataBuffer& data_out,
+                                const SampleKeyInfo& keyInfo);
+
   Adaptive_CencSingleSampleDecrypter* m_decrypter;
+  const CCencSampleGroups* m_sampleGroups;
+  SampleKeyInfo m_defaultKeyInfo{};
+  bool m_hasDefaultKeyInfo{false};
+  std::vector<AP4_UI16> m_clearBytes; // Sub-samples of the unencrypted samples
+  std::vector<AP4_UI32> m_cipherBytes;
+  std::vector<SampleParams> m_batchParams;
+  std::vector<SampleDecryptDesc> m_batchDescs;
+  std::vector<size_t> m_batchDescSamples; // The sample index of each descriptor
 };
@@ -10,11 +10,110 @@
 
 #include "../utils/CryptoUtils.h"
 
+#include <cstring>
 #include <stdexcept>
 #include <string_view>
 
 #include <bento4/Ap4.h>
 
+/*!
+ * \brief Encryption parameters of a single sample, they override the ones of the
+ *        fragment set by SetFragmentInfo, e.g. from a 'seig' sample group.
+ */
+struct SampleKeyInfo
+{
+  const AP4_UI08* m_keyId{nullptr}; // The KID (16 bytes)
+  uint8_t m_cryptBlocks{0};
+  uint8_t m_skipBlocks{0};
+};
+
+/*!
+ * \brief Scatter-gather descriptor of a sample decrypted in a batch, the input and
+ *        the output are separate buffers per sample, the encryption info are the
+ *        same of DecryptSampleData.
+ */
+struct SampleDecryptDesc
+{
+  AP4_DataBuffer* m_dataIn{nullptr};
+  AP4_DataBuffer* m_dataOut{nullptr};
+  const AP4_UI08* m_iv{nullptr}; // Always 16 bytes
+  unsigned int m_subsampleCount{0};
+  const AP4_UI16* m_clearBytes{nullptr};
+  const AP4_UI32* m_cipherBytes{nullptr};
+  const SampleKeyInfo* m_keyInfo{nullptr}; // [OPT] nullptr to use the fragment key and pattern
+  AP4_Result m_result{AP4_SUCCESS}; // [OUT] The decryption result of the sample
+};
+
+/*!
+ * \brief Get the size of the encrypted data of a sample, all the sample
+ *        is encrypted when it has no subsamples.
+ */
+inline AP4_UI64 GetEncryptedSize(const SampleDecryptDesc& sample)
+{
+  if (sample.m_subsampleCount == 0)
+    return sample.m_dataIn->GetDataSize();
+
+  AP4_UI64 size{0};
+  for (unsigned int i = 0; i < sample.m_subsampleCount; ++i)
+    size += sample.m_cipherBytes[i];
+  return size;
+}
+
+/*!
+ * \brief Check that the subsamples of a sample do not exceed the sample data.
+ */
+inline bool HasValidSubsamples(const SampleDecryptDesc& sample)
+{
+  AP4_UI64 size{0};
+  for (unsigned int i = 0; i < sample.m_subsampleCount; ++i)
+    size += sample.m_clearBytes[i] + sample.m_cipherBytes[i];
+  return size <= sample.m_dataIn->GetDataSize();
+}
+
+/*!
+ * \brief Get the number of consecutive samples, from the first one, whose encrypted data
+ *        are a single AES-CTR stream ('cenc' scheme): they use the same key and the IV
+ *        of each sample continue the counter of the previous one, e.g. as packaged with
+ *        16 bytes IVs. These samples can be decrypted with a single request.
+ * \param samples The sample descriptors
+ * \param count The number of samples
+ * \return The number of samples of the run, at least 1 if count is not 0
+ */
+inline size_t GetCtrSampleRun(const SampleDecryptDesc* samples, size_t count)
+{
+  if (count == 0)
+    return 0;
+
+  size_t run{1};
+  for (; run < count; ++run)
+  {
+    const SampleDecryptDesc& prev{samples[run - 1]};
+    const SampleDecryptDesc& next{samples[run]};
+    if (!prev.m_iv || !next.m_iv || !HasValidSubsamples(prev) || !HasValidSubsamples(next))
+      break;
+
+    // The key override must be the same, nullptr is the fragment key
+    const AP4_UI08* prevKeyId{prev.m_keyInfo ? prev.m_keyInfo->m_keyId : nullptr};
+    const AP4_UI08* nextKeyId{next.m_keyInfo ? next.m_keyInfo->m_keyId : nullptr};
+    if ((prevKeyId == nullptr) != (nextKeyId == nullptr) ||
+        (prevKeyId && std::memcmp(prevKeyId, nextKeyId, 16) != 0))
+      break;
+
+    // A partial last block would discard the rest of its key stream
+    const AP4_UI64 size{GetEncryptedSize(prev)};
+    if (size % 16 != 0)
+      break;
+
+    // The block counter is the low 64 bits of the IV, it must not wrap
+    const AP4_UI64 counter{AP4_BytesToUInt64BE(prev.m_iv + 8)};
+    const AP4_UI64 nextCounter{counter + size / 16};
+    if (nextCounter < counter || std::memcmp(prev.m_iv, next.m_iv, 8) != 0 ||
+        AP4_BytesToUInt64BE(next.m_iv + 8) != nextCounter)
+      break;
+  }
+  return run;
+}
+
 class Adaptive_CencSingleSampleDecrypter : public AP4_CencSingleSampleDecrypter
 {
 public:
@@ -49,7 +148,37 @@ public:
                                        const AP4_UI08* iv,
                                        unsigned int subsample_count,
                                        const AP4_UI16* bytes_of_cleartext_data,
-                                       const AP4_UI32* bytes_of_encrypted_data) = 0;
+                                       const AP4_UI32* bytes_of_encrypted_data,
+                                       const SampleKeyInfo* sampleKeyInfo) = 0;
+
+  /*! \brief Decrypt a batch of samples of the same fragment and pool, to reduce the
+   *         overhead of a decryption request per sample e.g. for short audio frames.
+   *         The default implementation decrypt the samples one by one.
+   *  \param poolId The fragment pool
+   *  \param samples The sample descriptors, the result is set to each descriptor
+   *  \param count The number of samples
+   *  \return AP4_SUCCESS if all samples are decrypted, otherwise the first failure
+   */
+  virtual AP4_Result DecryptSampleBatch(AP4_UI32 poolId, SampleDecryptDesc* samples, size_t count)
+  {
+    AP4_Result result{AP4_SUCCESS};
+    for (size_t i = 0; i < count; ++i)
+    {
+      SampleDecryptDesc& sample{samples[i]};
+      sample.m_result = DecryptSampleData(poolId, *sample.m_dataIn, *sample.m_dataOut, sample.m_iv,
+                                          sample.m_subsampleCount, sample.m_clearBytes,
+                                          sample.m_cipherBytes, sample.m_keyInfo);
+      if (AP4_FAILED(sample.m_result) && AP4_SUCCEEDED(result))
+        result = sample.m_result;
+    }
+    return result;
+  }
+
+  /*! \brief Send the license request left pending when the decrypter has been
+   *         created with skipSessionMessage, it blocks until the license is received.
+   *  \return True if the decrypter have the keys, otherwise false
+   */
+  virtual bool AcquirePendingLicense() { return true; }
 
   virtual AP4_UI32 AddPool() { return 0; }
   virtual void RemovePool(AP4_UI32 poolid) {}
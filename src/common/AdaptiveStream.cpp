@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 
@@ -31,6 +32,19 @@ using namespace kodi::tools;
 using namespace PLAYLIST;
 using namespace UTILS;
 
+namespace
+{
+// The key of the init segment cache, the same url can be downloaded with different byte ranges
+std::string GetInitSegmentKey(const std::string& url,
+                              const std::map<std::string, std::string>& headers)
+{
+  auto itRange = headers.find("Range");
+  if (itRange == headers.end())
+    return url;
+  return url + "|" + itRange->second;
+}
+} // unnamed namespace
+
 uint32_t AdaptiveStream::globalClsId = 0;
 
 AdaptiveStream::AdaptiveStream(AdaptiveTree& tree,
@@ -105,6 +119,21 @@ void adaptive::AdaptiveStream::DeallocateSegmentBuffers()
   }
 }
 
+void adaptive::AdaptiveStream::ReleaseSegmentBuffers()
+{
+  if (thread_data_)
+  {
+    LOG::LogF(LOGERROR, "[AS-%u] Cannot release the segment buffers, the worker is running.",
+              clsId);
+    return;
+  }
+  DeallocateSegmentBuffers();
+  valid_segment_buffers_ = 0;
+  available_segment_buffers_ = 0;
+  absolute_position_ = 0;
+  segment_read_pos_ = 0;
+}
+
 bool adaptive::AdaptiveStream::Download(const DownloadInfo& downloadInfo, std::string& data)
 {
   return DownloadImpl(downloadInfo, &data);
@@ -224,6 +253,84 @@ bool adaptive::AdaptiveStream::DownloadImpl(const DownloadInfo& downloadInfo,
   return false;
 }
 
+bool AdaptiveStream::DownloadInitSegment(const DownloadInfo& downloadInfo)
+{
+  SEGMENTBUFFER* segBuffer = downloadInfo.m_segmentBuffer;
+  if (!segBuffer)
+  {
+    LOG::LogF(LOGERROR, "[AS-%u] Download failed, no segment buffer", clsId);
+    return false;
+  }
+
+  CInitSegmentCache& cache = tree_.GetInitSegmentCache();
+  const std::string key = GetInitSegmentKey(downloadInfo.m_url, downloadInfo.m_addHeaders);
+  std::string data;
+
+  if (cache.Get(segBuffer->rep, key, data))
+  {
+    LOG::Log(LOGDEBUG, "[AS-%u] Initialization segment from cache: %s", clsId, key.c_str());
+    {
+      std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
+      segBuffer->buffer = std::move(data);
+    }
+    thread_data_->signal_rw_.notify_all();
+    return true;
+  }
+
+  if (!DownloadSegment(downloadInfo))
+    return false;
+
+  {
+    std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
+    data = segBuffer->buffer;
+  }
+  cache.Put(segBuffer->rep, key, data);
+  return true;
+}
+
+bool AdaptiveStream::GetInitSegmentData(std::string& data)
+{
+  if (!current_rep_)
+    return false;
+
+  if (!current_rep_->IsPrepared())
+    tree_.prepareRepresentation(current_period_, current_adp_, current_rep_, false);
+
+  // The initialization segment range can be known only after parse the index
+  if (!ResolveSegmentBase(current_rep_, false))
+    return false;
+
+  const CSegment* initSegment = current_rep_->get_initialization();
+  if (!initSegment)
+  {
+    LOG::LogF(LOGERROR, "[AS-%u] No initialization segment in representation id: %s", clsId,
+              current_rep_->GetId().data());
+    return false;
+  }
+
+  DownloadInfo downloadInfo;
+  if (!PrepareDownload(current_rep_, *initSegment, SEGMENT_NO_NUMBER, downloadInfo))
+    return false;
+
+  CInitSegmentCache& cache = tree_.GetInitSegmentCache();
+  const std::string key = GetInitSegmentKey(downloadInfo.m_url, downloadInfo.m_addHeaders);
+
+  if (cache.Get(current_rep_, key, data))
+    return true;
+
+  std::string downloadData;
+  if (!Download(downloadInfo, downloadData))
+    return false;
+
+  // Allow the manifest parser to process the data, as done for the segment buffers
+  data.clear();
+  tree_.OnDataArrived(SEGMENT_NO_NUMBER, initSegment->pssh_set_, m_decrypterIv,
+                      downloadData.data(), downloadData.size(), data, 0, true);
+
+  cache.Put(current_rep_, key, data);
+  return true;
+}
+
 bool AdaptiveStream::PrepareNextDownload(DownloadInfo& downloadInfo)
 {
   // We assume, that we find the next segment to load in the next valid_segment_buffers_
@@ -408,12 +515,21 @@ void AdaptiveStream::worker()
       lckdl.unlock();
 
       bool isLive = tree_.has_timeshift_buffer_;
+      SEGMENTBUFFER* segBuffer = downloadInfo.m_segmentBuffer;
 
-      //! @todo: for live content we should calculate max attempts and sleep timing
-      //! based on segment duration / playlist updates timing
       size_t maxAttempts = isLive ? 10 : 6;
       std::chrono::milliseconds msSleep = isLive ? 1000ms : 500ms;
 
+      // A lost live segment must not stall the stream for more than its own duration,
+      // the segments already buffered cover the time spent to retry
+      if (isLive && segBuffer->segment.m_duration > 0 && segBuffer->rep->GetTimescale() > 0)
+      {
+        const uint64_t durationMs{segBuffer->segment.m_duration * 1000 /
+                                  segBuffer->rep->GetTimescale()};
+        maxAttempts = std::clamp<size_t>(static_cast<size_t>(durationMs / msSleep.count()), 2,
+                                         maxAttempts);
+      }
+
       //! @todo: Some streaming software offers subtitle tracks with missing fragments, usually live tv
       //! When a programme is broadcasted that has subtitles, subtitles fragments are offered,
       //! Ensure we continue with the next segment after one retry on errors
@@ -423,9 +539,17 @@ void AdaptiveStream::worker()
       size_t downloadAttempts = 1;
       bool isSegmentDownloaded = false;
 
+      if (segBuffer->segment.m_isGap)
+      {
+        // The segment buffer is left empty, the reader move on to the next segment
+        LOG::Log(LOGDEBUG, "[AS-%u] Skipped gap segment no. %llu", clsId,
+                 segBuffer->segment_number);
+        isSegmentDownloaded = true;
+      }
+
       // Download errors may occur e.g. due to unstable connection, server overloading, ...
       // then we try downloading the segment more times before aborting playback
-      while (state_ != STOPPED)
+      while (!isSegmentDownloaded && state_ != STOPPED)
       {
         isSegmentDownloaded = DownloadSegment(downloadInfo);
         if (isSegmentDownloaded || downloadAttempts == maxAttempts || state_ == STOPPED)
@@ -438,6 +562,20 @@ void AdaptiveStream::worker()
         LOG::Log(LOGWARNING, "[AS-%u] Segment download failed, attempt %zu...", clsId, downloadAttempts);
       }
 
+      if (isSegmentDownloaded)
+      {
+        m_missingSegments = 0;
+        if (!segBuffer->segment.m_isGap)
+          tree_.AddSegmentFetch(downloadInfo.m_url);
+      }
+      else if (state_ != STOPPED)
+      {
+        // The segment could be lost only from this representation (e.g. encoder failover),
+        // otherwise a live segment is skipped to continue with the next one
+        isSegmentDownloaded = DownloadSegmentFromOtherRep(downloadInfo) ||
+                              (isLive && SkipMissingSegment(segBuffer));
+      }
+
       lckdl.lock();
 
       if (!isSegmentDownloaded)
@@ -457,6 +595,109 @@ void AdaptiveStream::worker()
   lckdl.unlock();
 }
 
+bool AdaptiveStream::DownloadSegmentFromOtherRep(const DownloadInfo& downloadInfo)
+{
+  SEGMENTBUFFER* segBuffer = downloadInfo.m_segmentBuffer;
+
+  // As for the representation chooser, only the video stream can switch the representation
+  if (current_adp_->GetStreamType() != StreamType::VIDEO ||
+      segBuffer->segment_number == SEGMENT_NO_NUMBER)
+    return false;
+
+  CRepresentation* failedRep = segBuffer->rep;
+  const CSegment failedSegment{segBuffer->segment};
+  std::vector<CRepresentation*> reps;
+  for (auto& rep : current_adp_->GetRepresentations())
+  {
+    if (rep.get() != failedRep && rep->IsHdcpCompliant())
+      reps.emplace_back(rep.get());
+  }
+
+  // Try first the representations with the nearest bandwidth
+  const int64_t bandwidth{failedRep->GetBandwidth()};
+  std::sort(reps.begin(), reps.end(),
+            [bandwidth](const CRepresentation* left, const CRepresentation* right) {
+              return std::abs(left->GetBandwidth() - bandwidth) <
+                     std::abs(right->GetBandwidth() - bandwidth);
+            });
+  if (reps.size() > MAX_ALTERNATIVE_REPS)
+    reps.resize(MAX_ALTERNATIVE_REPS);
+
+  for (CRepresentation* rep : reps)
+  {
+    CSegment segment;
+    {
+      // Segments are aligned between the representations by segment number,
+      // as for the representation switching
+      std::lock_guard<adaptive::AdaptiveTree::TreeUpdateThread> lckUpdTree(
+          tree_.GetTreeUpdMutex());
+
+      if (segBuffer->segment_number < rep->GetStartNumber())
+        continue;
+
+      const size_t segPos{static_cast<size_t>(segBuffer->segment_number - rep->GetStartNumber())};
+      if (segPos >= rep->SegmentTimeline().GetSize())
+        continue;
+
+      segment = *rep->get_segment(segPos);
+    }
+
+    DownloadInfo repDownloadInfo;
+    if (!PrepareDownload(rep, segment, segBuffer->segment_number, repDownloadInfo))
+      continue;
+    repDownloadInfo.m_segmentBuffer = segBuffer;
+
+    {
+      std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
+      // Once the reader has reached the segment its representation cannot be changed anymore
+      if (segBuffer == segment_buffers_[0] || !segBuffer->buffer.empty())
+        return false;
+
+      segBuffer->rep = rep;
+      segBuffer->segment = segment;
+    }
+
+    LOG::Log(LOGWARNING,
+             "[AS-%u] Segment no. %llu missing, download it from representation id: %s", clsId,
+             segBuffer->segment_number, rep->GetId().data());
+
+    if (DownloadSegment(repDownloadInfo))
+    {
+      m_missingSegments = 0;
+      return true;
+    }
+  }
+
+  // Restore the representation, to avoid a stream change for a missing segment
+  std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
+  if (segBuffer->rep != failedRep && segBuffer != segment_buffers_[0])
+  {
+    segBuffer->rep = failedRep;
+    segBuffer->segment = failedSegment;
+  }
+  return false;
+}
+
+bool AdaptiveStream::SkipMissingSegment(SEGMENTBUFFER* segBuffer)
+{
+  if (segBuffer->segment_number == SEGMENT_NO_NUMBER || m_missingSegments >= MAX_MISSING_SEGMENTS)
+    return false;
+
+  {
+    std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
+    // Partial data cannot be discarded, the reader could have already read it
+    if (!segBuffer->buffer.empty())
+      return false;
+
+    segBuffer->segment.m_isGap = true;
+  }
+
+  ++m_missingSegments;
+  LOG::Log(LOGWARNING, "[AS-%u] Segment no. %llu missing, skipped", clsId,
+           segBuffer->segment_number);
+  return true;
+}
+
 int AdaptiveStream::SecondsSinceUpdate() const
 {
   const std::chrono::time_point<std::chrono::system_clock>& tPoint(
@@ -468,7 +709,6 @@ int AdaptiveStream::SecondsSinceUpdate() const
 
 bool AdaptiveStream::parseIndexRange(PLAYLIST::CRepresentation* rep, const std::string& buffer)
 {
-#ifndef INPUTSTREAM_TEST_BUILD
   LOG::Log(LOGDEBUG, "[AS-%u] Build segments from SIDX atom...", clsId);
   AP4_MemoryByteStream byteStream{reinterpret_cast<const AP4_Byte*>(buffer.data()),
                                   static_cast<AP4_Size>(buffer.size())};
@@ -477,6 +717,7 @@ bool AdaptiveStream::parseIndexRange(PLAYLIST::CRepresentation* rep, const std::
 
   if (rep->GetContainerType() == ContainerType::WEBM)
   {
+#ifndef INPUTSTREAM_TEST_BUILD
     if (!rep->m_segBaseIndexRangeMin)
       return false;
 
@@ -509,6 +750,7 @@ bool AdaptiveStream::parseIndexRange(PLAYLIST::CRepresentation* rep, const std::
       }
       return true;
     }
+#endif
   }
   else if (rep->GetContainerType() == ContainerType::MP4)
   {
@@ -556,6 +798,12 @@ bool AdaptiveStream::parseIndexRange(PLAYLIST::CRepresentation* rep, const std::
       }
 
       AP4_SidxAtom* sidx(AP4_DYNAMIC_CAST(AP4_SidxAtom, atom));
+      if (!sidx || sidx->GetReferences().ItemCount() == 0)
+      {
+        LOG::Log(LOGERROR, "[AS-%u] SIDX atom without references", clsId);
+        delete atom;
+        return false;
+      }
       const AP4_Array<AP4_SidxAtom::Reference>& refs(sidx->GetReferences());
 
       if (refs[0].m_ReferenceType == 1)
@@ -594,7 +842,6 @@ bool AdaptiveStream::parseIndexRange(PLAYLIST::CRepresentation* rep, const std::
 
     return true;
   }
-#endif
   return false;
 }
 
@@ -606,7 +853,9 @@ bool AdaptiveStream::start_stream()
   if (choose_rep_)
   {
     choose_rep_ = false;
-    current_rep_ = tree_.GetRepChooser()->GetRepresentation(current_adp_);
+    // The stream info has been set from the initial representation, choose again
+    // by keeping the same codec
+    current_rep_ = tree_.GetRepChooser()->GetNextRepresentation(current_adp_, current_rep_);
   }
 
   if (!current_rep_->IsPrepared())
@@ -743,7 +992,7 @@ bool AdaptiveStream::start_stream()
     valid_segment_buffers_ = 0;
 
     DownloadInfo downloadInfo;
-    if (!PrepareNextDownload(downloadInfo) || !DownloadSegment(downloadInfo))
+    if (!PrepareNextDownload(downloadInfo) || !DownloadInitSegment(downloadInfo))
       state_ = STOPPED;
 
     valid_segment_buffers_ = valid_segment_buffers + 1;
@@ -1011,6 +1260,20 @@ NEXTSEGMENT:
   return 0;
 }
 
+bool AdaptiveStream::GetSampleAesKey(std::string& key, uint8_t* iv)
+{
+  if (state_ == STOPPED)
+    return false;
+
+  std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
+
+  if (segment_buffers_.empty() || !segment_buffers_[0])
+    return false;
+
+  const SEGMENTBUFFER* segBuffer{segment_buffers_[0]};
+  return tree_.GetSampleAesKey(segBuffer->segment.pssh_set_, segBuffer->segment_number, key, iv);
+}
+
 bool AdaptiveStream::seek(uint64_t const pos)
 {
   if (state_ == STOPPED)
@@ -52,6 +52,12 @@ class AdaptiveStream;
      *        downloads must be already stopped with Stop() before call this method.
      */
     void DisposeWorker();
+    /*!
+     * \brief Release the buffered segments, the current segment position is kept
+     *        and the next segments are downloaded again when the stream is started,
+     *        the worker must be already disposed with DisposeWorker().
+     */
+    void ReleaseSegmentBuffers();
     uint64_t getMaxTimeMs();
 
     /*!
@@ -88,6 +94,24 @@ class AdaptiveStream;
     void SetSegmentFileOffset(uint64_t offset) { m_segmentFileOffset = offset; };
     bool StreamChanged() { return stream_changed_; }
 
+    /*!
+     * \brief Get the initialization segment data of the current representation
+     *        without start the stream, e.g. to read the PSSH atoms for the DRM.
+     *        The data is shared with the stream start through the tree init segment cache.
+     * \param data [OUT] The initialization segment data
+     * \return Return true if success, otherwise false
+     */
+    bool GetInitSegmentData(std::string& data);
+
+    /*!
+     * \brief Get the key and the IV of the segment currently read, when encrypted
+     *        with HLS SAMPLE-AES, to decrypt the samples after demux.
+     * \param key [OUT] The AES-128 key
+     * \param iv [OUT] The IV, 16 bytes
+     * \return Return true if the segment samples are encrypted, otherwise false
+     */
+    bool GetSampleAesKey(std::string& key, uint8_t* iv);
+
   protected:
     virtual bool parseIndexRange(PLAYLIST::CRepresentation* rep, const std::string& buffer);
 
@@ -153,6 +177,15 @@ class AdaptiveStream;
     */
     bool DownloadImpl(const DownloadInfo& downloadInfo, std::string* data);
 
+   /*!
+    * \brief Fill the segment buffer with the initialization segment, the data is
+    *        taken from the tree init segment cache if available, otherwise downloaded
+    *        and then added to the cache.
+    * \param downloadInfo The info about the file to download, its mandatory provide the segment buffer
+    * \return Return true if success, otherwise false
+    */
+    bool DownloadInitSegment(const DownloadInfo& downloadInfo);
+
     bool PrepareNextDownload(DownloadInfo& downloadInfo);
     bool PrepareDownload(const PLAYLIST::CRepresentation* rep,
                          const PLAYLIST::CSegment& seg,
@@ -172,6 +205,22 @@ class AdaptiveStream;
     void WaitWorker();
     void worker();
 
+    /*!
+     * \brief Download a segment that cannot be downloaded, from an other representation
+     *        of the adaptation set that provide the same segment number.
+     * \param downloadInfo The info of the failed download
+     * \return True if the segment has been downloaded, otherwise false
+     */
+    bool DownloadSegmentFromOtherRep(const DownloadInfo& downloadInfo);
+
+    /*!
+     * \brief Mark a live segment that cannot be downloaded as gap, so that the reader
+     *        continue with the next segment, up to MAX_MISSING_SEGMENTS consecutive segments.
+     * \param segBuffer The segment buffer of the failed download
+     * \return True if the segment has been skipped, otherwise false
+     */
+    bool SkipMissingSegment(SEGMENTBUFFER* segBuffer);
+
     int SecondsSinceUpdate() const;
     static void ReplacePlaceholder(std::string& url, const std::string placeholder, uint64_t value);
     bool ResolveSegmentBase(PLAYLIST::CRepresentation* rep, bool stopWorker);
@@ -241,6 +290,12 @@ class AdaptiveStream;
     bool stream_changed_ = false;
     bool choose_rep_;
 
+    // Max number of other representations tried to download a missing segment
+    static constexpr size_t MAX_ALTERNATIVE_REPS = 2;
+    // Max number of consecutive missing segments that can be skipped before stop the stream
+    static constexpr size_t MAX_MISSING_SEGMENTS = 3;
+    size_t m_missingSegments{0};
+
     // Class ID for debug log purpose, allow the LOG prints of each AdaptiveStream to be distinguished
     uint32_t clsId;
     static uint32_t globalClsId; // Incremental value for each new class created
@@ -29,6 +29,14 @@
 using namespace PLAYLIST;
 using namespace UTILS;
 
+namespace
+{
+// Max number of recent segments for the download accounting
+constexpr size_t MAX_SEGMENT_FETCHES = 512;
+// The manifest updates repeat only the PSSH of the recent key rotations
+constexpr size_t MAX_ROTATED_PSSH_KEYS = 16;
+} // unnamed namespace
+
 namespace adaptive
 {
   AdaptiveTree::AdaptiveTree(CHOOSER::IRepresentationChooser* reprChooser)
@@ -41,7 +49,7 @@ namespace adaptive
     m_manifestParams = left.m_manifestParams;
     m_manifestHeaders = left.m_manifestHeaders;
     m_settings = left.m_settings;
-    m_supportedKeySystem = left.m_supportedKeySystem;
+    m_supportedKeySystems = left.m_supportedKeySystems;
   }
 
   void AdaptiveTree::Configure(const UTILS::PROPERTIES::KodiProperties& kodiProps)
@@ -91,6 +99,51 @@ namespace adaptive
     repr->current_segment_ = nullptr;
   }
 
+  size_t AdaptiveTree::PruneSegments(CPeriod* period,
+                                     CRepresentation* repr,
+                                     uint64_t windowDuration)
+  {
+    CSpinCache<CSegment>& timeline = repr->SegmentTimeline();
+    const size_t size = timeline.GetSize();
+    if (windowDuration == 0 || size < 2 || repr->GetTimescale() == 0)
+      return 0;
+
+    const uint64_t window = windowDuration * repr->GetTimescale() / 1000;
+    const uint64_t lastPts = timeline.Get(size - 1)->startPTS_;
+    if (lastPts == NO_PTS_VALUE || lastPts <= window)
+      return 0;
+    const uint64_t windowStartPts = lastPts - window;
+
+    // A segment is out of the window when the next segment starts before the window
+    size_t count{0};
+    while (count + 1 < size && timeline.Get(count + 1)->startPTS_ <= windowStartPts)
+    {
+      count++;
+    }
+    // Never remove the segment played
+    const size_t currentPos = repr->getCurrentSegmentPos();
+    if (currentPos != SEGMENT_NO_POS)
+      count = std::min(count, currentPos);
+
+    if (count == 0 || count <= (size - count) / 2)
+      return 0;
+
+    for (size_t pos{0}; pos < count; pos++)
+    {
+      period->DecrasePSSHSetUsageCount(timeline.Get(pos)->pssh_set_);
+    }
+
+    timeline.EraseFront(count);
+    repr->SetStartNumber(repr->GetStartNumber() + count);
+    repr->expired_segments_ -= std::min(repr->expired_segments_, count);
+    if (currentPos != SEGMENT_NO_POS)
+      repr->current_segment_ = repr->get_segment(currentPos - count);
+
+    LOG::LogF(LOGDEBUG, "Removed %zu segments out of the time shift buffer (repr. id: %s)", count,
+              repr->GetId().data());
+    return count;
+  }
+
   void AdaptiveTree::SetFragmentDuration(PLAYLIST::CPeriod* period,
                                          PLAYLIST::CAdaptationSet* adpSet,
                                          PLAYLIST::CRepresentation* repr,
@@ -175,7 +228,8 @@ namespace adaptive
                                        PLAYLIST::CAdaptationSet* adp,
                                        std::string_view pssh,
                                        std::string_view defaultKID,
-                                       std::string_view iv /* = "" */)
+                                       std::string_view iv /* = "" */,
+                                       std::string_view keySystem /* = "" */)
   {
     if (!pssh.empty())
     {
@@ -184,6 +238,7 @@ namespace adaptive
       psshSet.defaultKID_ = defaultKID;
       psshSet.iv = iv;
       psshSet.m_cryptoMode = m_cryptoMode;
+      psshSet.m_keySystem = keySystem;
       psshSet.adaptation_set_ = adp;
 
       if (streamType == StreamType::VIDEO)
@@ -201,6 +256,56 @@ namespace adaptive
       return period->InsertPSSHSet(nullptr);
   }
 
+  void AdaptiveTree::AddRotatedPsshSet(const PLAYLIST::CPeriod::PSSHSet& psshSet)
+  {
+    std::lock_guard<std::mutex> lock(m_rotatedPsshMutex);
+    // Each manifest update can provide the same changed PSSH
+    const std::string psshKey{psshSet.pssh_ + psshSet.defaultKID_};
+    if (std::find(m_rotatedPsshKeys.begin(), m_rotatedPsshKeys.end(), psshKey) !=
+        m_rotatedPsshKeys.end())
+      return;
+
+    m_rotatedPsshKeys.emplace_back(psshKey);
+    if (m_rotatedPsshKeys.size() > MAX_ROTATED_PSSH_KEYS)
+      m_rotatedPsshKeys.pop_front();
+    m_rotatedPsshSets.emplace_back(psshSet);
+  }
+
+  std::vector<PLAYLIST::CPeriod::PSSHSet> AdaptiveTree::TakeRotatedPsshSets()
+  {
+    std::vector<PLAYLIST::CPeriod::PSSHSet> psshSets;
+    std::lock_guard<std::mutex> lock(m_rotatedPsshMutex);
+    psshSets.swap(m_rotatedPsshSets);
+    return psshSets;
+  }
+
+  uint32_t AdaptiveTree::AddSegmentFetch(const std::string& url)
+  {
+    std::lock_guard<std::mutex> lock(m_segmentFetchesMutex);
+    uint32_t& count = m_segmentFetches[url];
+    if (++count == 1)
+    {
+      m_segmentFetchesOrder.emplace_back(url);
+      if (m_segmentFetchesOrder.size() > MAX_SEGMENT_FETCHES)
+      {
+        m_segmentFetches.erase(m_segmentFetchesOrder.front());
+        m_segmentFetchesOrder.pop_front();
+      }
+    }
+    else
+    {
+      LOG::Log(LOGDEBUG, "Segment downloaded %u times: %s", count, url.c_str());
+    }
+    return count;
+  }
+
+  uint32_t AdaptiveTree::GetSegmentFetchCount(const std::string& url) const
+  {
+    std::lock_guard<std::mutex> lock(m_segmentFetchesMutex);
+    auto itFetch = m_segmentFetches.find(url);
+    return itFetch != m_segmentFetches.end() ? itFetch->second : 0;
+  }
+
   bool AdaptiveTree::PreparePaths(const std::string &url)
   {
     if (!URL::IsValidUrl(url))
@@ -216,9 +321,78 @@ namespace adaptive
   std::string AdaptiveTree::BuildDownloadUrl(const std::string& url) const
   {
     if (URL::IsUrlAbsolute(url))
-      return url;
+      return m_contentSteering.ResolveUrl(url);
+
+    return m_contentSteering.ResolveUrl(URL::Join(base_url_, url));
+  }
+
+  void AdaptiveTree::UpdateContentSteering()
+  {
+    if (!m_contentSteering.IsUpdateDue())
+      return;
 
-    return URL::Join(base_url_, url);
+    const std::string url{m_contentSteering.GetManifestUrl()};
+    std::string data;
+    HTTPRespHeaders respHeaders;
+
+    if (Download(url, m_manifestHeaders, data, respHeaders))
+    {
+      m_contentSteering.ApplyManifest(
+          data, respHeaders.m_effectiveUrl.empty() ? url : respHeaders.m_effectiveUrl);
+    }
+    else
+    {
+      LOG::LogF(LOGERROR, "Cannot download the steering manifest from: %s", url.c_str());
+      m_contentSteering.OnManifestFailed();
+    }
+  }
+
+  bool AdaptiveTree::GetThumbnailTile(uint64_t timeMs, int maxWidth, ThumbnailTile& tile)
+  {
+    std::lock_guard<TreeUpdateThread> lckUpdTree(GetTreeUpdMutex());
+
+    // The last period started before the time
+    CPeriod* period{nullptr};
+    for (auto& p : m_periods)
+    {
+      if (period && p->GetStart() > timeMs)
+        break;
+      period = p.get();
+    }
+    if (!period)
+      return false;
+
+    // The greatest resolution that fit the max width, otherwise the smallest one
+    CThumbnailTrack* track{nullptr};
+    for (auto& thumbTrack : period->GetThumbnailTracks())
+    {
+      const int width{thumbTrack->GetThumbnailWidth()};
+      if (!track)
+        track = thumbTrack.get();
+      else if (maxWidth > 0 && track->GetThumbnailWidth() > maxWidth)
+      {
+        if (width < track->GetThumbnailWidth())
+          track = thumbTrack.get();
+      }
+      else if (width > track->GetThumbnailWidth() && (maxWidth <= 0 || width <= maxWidth))
+        track = thumbTrack.get();
+    }
+    if (!track)
+      return false;
+
+    if (!track->IsPrepared())
+    {
+      track->SetIsPrepared(true);
+      if (!PrepareThumbnailTrack(track))
+        LOG::LogF(LOGERROR, "Cannot prepare the thumbnail track \"%s\"", track->GetId().data());
+    }
+
+    const uint64_t periodStartMs{period->GetStart() == NO_PTS_VALUE ? 0 : period->GetStart()};
+    if (!track->GetTile(timeMs > periodStartMs ? timeMs - periodStartMs : 0, tile))
+      return false;
+
+    tile.m_startMs += periodStartMs;
+    return true;
   }
 
   void AdaptiveTree::SortTree()
@@ -275,7 +449,7 @@ namespace adaptive
 
   void AdaptiveTree::StartUpdateThread()
   {
-    if (HasManifestUpdates())
+    if (HasManifestUpdates() || m_contentSteering.IsEnabled())
       m_updThread.Initialize(this);
   }
 
@@ -420,11 +594,49 @@ namespace adaptive
   void AdaptiveTree::TreeUpdateThread::Worker()
   {
     std::unique_lock<std::mutex> updLck(m_updMutex);
+    auto nextManifestUpdate = std::chrono::steady_clock::now() +
+                              std::chrono::milliseconds(m_tree->m_updateInterval);
 
-    while (~m_tree->m_updateInterval && !m_threadStop)
+    // The same thread reload the content steering manifest, at each TTL
+    while ((~m_tree->m_updateInterval || m_tree->m_contentSteering.IsEnabled()) && !m_threadStop)
     {
-      if (m_cvUpdInterval.wait_for(updLck, std::chrono::milliseconds(m_tree->m_updateInterval)) ==
-          std::cv_status::timeout)
+      const bool hasManifestUpdates{~m_tree->m_updateInterval != 0};
+
+      // An update requested by RefreshNow is done without wait the interval
+      bool isUpdateDue{m_isRefreshRequested.exchange(false)};
+      if (!isUpdateDue)
+      {
+        auto waitUntil = hasManifestUpdates ? nextManifestUpdate
+                                            : std::chrono::steady_clock::time_point::max();
+        if (m_tree->m_contentSteering.IsEnabled())
+          waitUntil = std::min(waitUntil, m_tree->m_contentSteering.GetNextUpdateTime());
+
+        m_cvUpdInterval.wait_until(updLck, waitUntil);
+        const auto now = std::chrono::steady_clock::now();
+        // The wait can be also interrupted by the steering manifest reload or
+        // spuriously, only ResetStartTime restart the timeout
+        const bool isResetRequested{m_isResetRequested.exchange(false)};
+
+        if (hasManifestUpdates && now >= nextManifestUpdate)
+          isUpdateDue = true;
+        else if (isResetRequested)
+          nextManifestUpdate = now + std::chrono::milliseconds(m_tree->m_updateInterval);
+        if (m_isRefreshRequested.exchange(false))
+          isUpdateDue = true;
+      }
+
+      if (m_threadStop)
+        break;
+
+      if (m_tree->m_contentSteering.IsUpdateDue())
+      {
+        // The steering manifest does not change the tree, the updates can be paused meantime
+        updLck.unlock();
+        m_tree->UpdateContentSteering();
+        updLck.lock();
+      }
+
+      if (isUpdateDue && hasManifestUpdates && !m_threadStop)
       {
         updLck.unlock();
         // If paused, wait until last "Resume" will be called
@@ -433,10 +645,18 @@ namespace adaptive
 
         updLck.lock();
         m_tree->RefreshLiveSegments();
+        nextManifestUpdate = std::chrono::steady_clock::now() +
+                             std::chrono::milliseconds(m_tree->m_updateInterval);
       }
     }
   }
 
+  void AdaptiveTree::TreeUpdateThread::RefreshNow()
+  {
+    m_isRefreshRequested = true;
+    m_cvUpdInterval.notify_all();
+  }
+
   void AdaptiveTree::TreeUpdateThread::Pause()
   {
     // If an update is already in progress the wait until its finished
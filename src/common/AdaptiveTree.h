@@ -11,12 +11,16 @@
 #include "../utils/CryptoUtils.h"
 #include "../utils/PropertiesUtils.h"
 #include "AdaptationSet.h"
+#include "ContentSteering.h"
+#include "InitSegmentCache.h"
 #include "Period.h"
 #include "Representation.h"
+#include "TimedEvents.h"
 
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -74,8 +78,10 @@ public:
   uint64_t base_time_{0}; // SmoothTree only, the lower start PTS time between all StreamIndex tags
   uint64_t m_liveDelay{0}; // Apply a delay in seconds from the live edge
   bool has_timeshift_buffer_{false}; // Returns true when there is timeshift buffer for live content
+  uint64_t m_timeShiftBufferDepth{0}; // The time shift buffer depth in ms, 0 if not limited
   
-  std::string m_supportedKeySystem;
+  // The key systems supported by the decrypter, from the cheapest one
+  std::vector<std::string> m_supportedKeySystems;
   std::string location_;
 
   CryptoMode m_cryptoMode{CryptoMode::NONE};
@@ -122,6 +128,20 @@ public:
                              size_t segBufferSize,
                              bool isLastChunk);
 
+  /*!
+   * \brief Get the key and the IV to decrypt the samples of a segment encrypted
+   *        with HLS SAMPLE-AES, the key must be already downloaded.
+   * \param psshSet The PSSH set position of the segment
+   * \param segNum The segment number
+   * \param key [OUT] The AES-128 key
+   * \param iv [OUT] The IV, 16 bytes
+   * \return True if the segment samples are encrypted and the key is available, otherwise false
+   */
+  virtual bool GetSampleAesKey(uint16_t psshSet, uint64_t segNum, std::string& key, uint8_t* iv)
+  {
+    return false;
+  }
+
   virtual void RefreshSegments(PLAYLIST::CPeriod* period,
                                PLAYLIST::CAdaptationSet* adp,
                                PLAYLIST::CRepresentation* rep,
@@ -131,6 +151,21 @@ public:
 
   void FreeSegments(PLAYLIST::CPeriod* period, PLAYLIST::CRepresentation* repr);
 
+  /*!
+   * \brief Remove the segments of a live timeline that are out of the time shift
+   *        buffer window, the current segment and the following ones are always kept.
+   *        The segments are removed in batches, only when the segments out of the
+   *        window are more than half of those in the window, to have a constant
+   *        amortized cost on long running live streams.
+   * \param period The period of the representation
+   * \param repr The representation
+   * \param windowDuration The window duration in ms, from the last segment
+   * \return The number of segments removed
+   */
+  size_t PruneSegments(PLAYLIST::CPeriod* period,
+                       PLAYLIST::CRepresentation* repr,
+                       uint64_t windowDuration);
+
   void SetFragmentDuration(PLAYLIST::CPeriod* period,
                            PLAYLIST::CAdaptationSet* adpSet,
                            PLAYLIST::CRepresentation* repr,
@@ -145,7 +180,8 @@ public:
                          PLAYLIST::CAdaptationSet* adp,
                          std::string_view pssh,
                          std::string_view defaultKID,
-                         std::string_view iv = "");
+                         std::string_view iv = "",
+                         std::string_view keySystem = "");
 
   PLAYLIST::CAdaptationSet* GetAdaptationSet(size_t pos) const
   {
@@ -154,8 +190,51 @@ public:
                : nullptr;
   }
 
+  /*!
+   * \brief Build the url to download a file, relative urls are resolved from the
+   *        manifest base url, with content steering the url is resolved to the current pathway.
+   * \param url The url
+   * \return The url to download
+   */
   std::string BuildDownloadUrl(const std::string& url) const;
 
+  CContentSteering& GetContentSteering() { return m_contentSteering; }
+
+  /*!
+   * \brief Download the content steering manifest when its TTL is expired, the new
+   *        pathway apply to the next downloads. Called from the manifest update thread.
+   */
+  void UpdateContentSteering();
+
+  /*!
+   * \brief Get the thumbnail preview at a time, from the thumbnail track of
+   *        the period with the greatest resolution that fit the max width.
+   *        The HLS image playlist of the track is parsed on first use, the
+   *        tile images are not downloaded.
+   * \param timeMs The time from the start of the stream
+   * \param maxWidth The max thumbnail width, 0 for the greatest resolution
+   * \param tile [OUT] The thumbnail area and the url of the tile image
+   * \return True if success, otherwise false
+   */
+  bool GetThumbnailTile(uint64_t timeMs, int maxWidth, PLAYLIST::ThumbnailTile& tile);
+
+  /*!
+   * \brief Called when an in-band event (e.g. DASH emsg box, SCTE-35 section)
+   *        is found in a segment, the parser can handle the events signalled
+   *        in the manifest, the other events are queued as timed events.
+   *        Can be called from the demux thread.
+   * \param event The event, the same event can be repeated by each segment and stream
+   */
+  virtual void OnInbandEvent(const TimedEvent& event) { m_timedEvents.Add(event); }
+
+  /*!
+   * \brief Get the timed events (e.g. ad markers) waiting to be delivered,
+   *        from the manifest and from the segments.
+   */
+  CTimedEventQueue& GetTimedEvents() { return m_timedEvents; }
+
+  uint32_t GetUpdateInterval() const { return m_updateInterval; }
+
   bool HasManifestUpdates() const
   {
     return ~m_updateInterval && m_updateInterval > 0 && has_timeshift_buffer_ &&
@@ -166,6 +245,24 @@ public:
 
   CHOOSER::IRepresentationChooser* GetRepChooser() { return m_reprChooser; }
 
+  CInitSegmentCache& GetInitSegmentCache() { return m_initSegmentCache; }
+
+  /*!
+   * \brief Account a media segment download of the streams, a segment downloaded
+   *        more than once is logged (e.g. a rendition multiplexed in the variant
+   *        stream that is downloaded again). The most recent segments are kept only.
+   * \param url The segment url
+   * \return The number of downloads of the segment
+   */
+  uint32_t AddSegmentFetch(const std::string& url);
+
+  /*!
+   * \brief Get the number of downloads of a recent media segment.
+   * \param url The segment url
+   * \return The number of downloads, 0 if not downloaded
+   */
+  uint32_t GetSegmentFetchCount(const std::string& url) const;
+
   int SecondsSinceRepUpdate(PLAYLIST::CRepresentation* rep)
   {
     return static_cast<int>(
@@ -200,7 +297,15 @@ public:
     void Initialize(AdaptiveTree* tree);
 
     // \brief Reset start time (make exit the condition variable m_cvUpdInterval and re-start the timeout)
-    void ResetStartTime() { m_cvUpdInterval.notify_all(); }
+    void ResetStartTime()
+    {
+      m_isResetRequested = true;
+      m_cvUpdInterval.notify_all();
+    }
+
+    // \brief Make an update as soon as possible, without wait the update interval
+    //        (e.g. the manifest has been signalled as expired by an in-band event).
+    void RefreshNow();
 
     // \brief As "std::mutex" lock, but put in pause the manifest updates (support std::lock_guard).
     //        If an update is in progress, block the code until the update is finished.
@@ -228,6 +333,8 @@ public:
     std::mutex m_waitMutex;
     std::condition_variable m_cvWait;
     bool m_threadStop{false};
+    std::atomic<bool> m_isRefreshRequested{false};
+    std::atomic<bool> m_isResetRequested{false};
   };
 
   /*!
@@ -245,6 +352,19 @@ public:
    */
   std::string_view GetLicenseUrl() { return m_licenseUrl; }
 
+  /*!
+   * \brief Add a PSSH changed by a manifest update (key rotation), the license
+   *        will be acquired by the session. Can be called from the update thread.
+   * \param psshSet The new PSSHSet
+   */
+  void AddRotatedPsshSet(const PLAYLIST::CPeriod::PSSHSet& psshSet);
+
+  /*!
+   * \brief Get and clear the PSSH changed by the manifest updates.
+   * \return The new PSSHSet's
+   */
+  std::vector<PLAYLIST::CPeriod::PSSHSet> TakeRotatedPsshSets();
+
 protected:
   /*!
    * \brief Download a file.
@@ -302,6 +422,15 @@ protected:
   // Live segment update section
   virtual void StartUpdateThread();
   virtual void RefreshLiveSegments() { lastUpdated_ = std::chrono::system_clock::now(); }
+
+  /*!
+   * \brief Add the tile images of a thumbnail track provided by a separate
+   *        playlist (e.g. HLS image media playlist), called on first use.
+   * \param track The thumbnail track
+   * \return True if success, otherwise false
+   */
+  virtual bool PrepareThumbnailTrack(PLAYLIST::CThumbnailTrack* track) { return true; }
+
   std::atomic<uint32_t> m_updateInterval{~0U};
   TreeUpdateThread m_updThread;
   std::atomic<std::chrono::time_point<std::chrono::system_clock>> lastUpdated_{std::chrono::system_clock::now()};
@@ -309,11 +438,25 @@ protected:
   std::string m_manifestParams;
   std::map<std::string, std::string> m_manifestHeaders;
   CHOOSER::IRepresentationChooser* m_reprChooser{nullptr};
+  CInitSegmentCache m_initSegmentCache;
 
   // Provide the path where the manifests will be saved, if debug enabled
   std::string m_pathSaveManifest;
 
   std::string m_licenseUrl;
+
+  // Download count of the most recent media segments, by url
+  std::map<std::string, uint32_t> m_segmentFetches;
+  std::deque<std::string> m_segmentFetchesOrder;
+  mutable std::mutex m_segmentFetchesMutex;
+
+  std::mutex m_rotatedPsshMutex;
+  std::vector<PLAYLIST::CPeriod::PSSHSet> m_rotatedPsshSets;
+  std::deque<std::string> m_rotatedPsshKeys; // The most recent PSSH already added
+
+  CTimedEventQueue m_timedEvents;
+
+  CContentSteering m_contentSteering;
 };
 
 } // namespace adaptive
@@ -10,6 +10,7 @@
 
 #include <algorithm>
 #include <limits>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -48,7 +49,9 @@ enum class EncryptionType
   NOT_SUPPORTED,
   CLEAR,
   AES128,
-  WIDEVINE,
+  SAMPLE_AES, // HLS SAMPLE-AES with identity key, MPEG-2 stream encryption format
+  DRM, // Encrypted with a DRM key system
+  DRM_SKIPPED, // Supported DRM key system, but a cheaper one of the same segments is used
   UNKNOWN,
 };
 
@@ -81,6 +84,18 @@ enum class StreamType
   VIDEO_AUDIO,
 };
 
+/*!
+ * \brief A CEA-608/708 closed caption channel carried in the video SEI.
+ */
+struct ClosedCaption
+{
+  // The CEA-608 channel "CC1".."CC4" or the CEA-708 service "SERVICE1".."SERVICE63"
+  std::string m_instreamId;
+  std::string m_language;
+  std::string m_name;
+  bool m_isDefault{false};
+};
+
 /*!
  * \brief Convert StreamType enum value into a human readable string.
  * \param streamType The stream type to convert
@@ -189,6 +204,25 @@ public:
       m_basePos = 0;
   }
 
+  /*!
+   * \brief Remove <T> values from the front (the oldest values).
+   *        The pointers to the remaining values are invalidated.
+   * \param count The number of values to remove
+   */
+  void EraseFront(size_t count)
+  {
+    count = std::min(count, m_data.size());
+    if (count == 0)
+      return;
+    // Restore the insertion order, so that the front values are at the vector begin
+    if (m_basePos > 0)
+    {
+      std::rotate(m_data.begin(), m_data.begin() + m_basePos, m_data.end());
+      m_basePos = 0;
+    }
+    m_data.erase(m_data.begin(), m_data.begin() + count);
+  }
+
   void Swap(CSpinCache<T>& other)
   {
     m_data.swap(other.m_data);
@@ -0,0 +1,308 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "CencSampleGroups.h"
+
+#include "../utils/log.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+constexpr AP4_UI32 GROUPING_TYPE_SEIG = AP4_ATOM_TYPE('s', 'e', 'i', 'g');
+// Sample group description indexes from this value refer to the track fragment sgpd
+constexpr AP4_UI32 FRAGMENT_GROUP_INDEX_BASE = 0x10000;
+// reserved(8) + crypt/skip byte block(8) + isProtected(8) + Per_Sample_IV_Size(8) + KID(128)
+constexpr AP4_Size SEIG_ENTRY_MIN_SIZE = 20;
+// 'senc' flags
+constexpr AP4_UI32 SENC_FLAG_OVERRIDE_TRACK_ENCRYPTION = 0x1;
+constexpr AP4_UI32 SENC_FLAG_USE_SUBSAMPLE_ENCRYPTION = 0x2;
+// Protect from damaged data, a sample cannot have so many sub-samples
+constexpr AP4_UI32 MAX_SAMPLE_COUNT = 1000000;
+
+AP4_SgpdAtom* FindSeigDescription(AP4_ContainerAtom* container)
+{
+  if (!container)
+    return nullptr;
+
+  AP4_Atom* atom{nullptr};
+  for (AP4_Ordinal i{0}; (atom = container->GetChild(AP4_ATOM_TYPE_SGPD, i)) != nullptr; ++i)
+  {
+    AP4_SgpdAtom* sgpd{AP4_DYNAMIC_CAST(AP4_SgpdAtom, atom)};
+    if (sgpd && sgpd->GetGroupingType() == GROUPING_TYPE_SEIG)
+      return sgpd;
+  }
+  return nullptr;
+}
+
+AP4_SbgpAtom* FindSeigSampleToGroup(AP4_ContainerAtom* container)
+{
+  AP4_Atom* atom{nullptr};
+  for (AP4_Ordinal i{0}; (atom = container->GetChild(AP4_ATOM_TYPE_SBGP, i)) != nullptr; ++i)
+  {
+    AP4_SbgpAtom* sbgp{AP4_DYNAMIC_CAST(AP4_SbgpAtom, atom)};
+    if (sbgp && sbgp->GetGroupingType() == GROUPING_TYPE_SEIG)
+      return sbgp;
+  }
+  return nullptr;
+}
+
+// Read sequentially big endian values, with bounds check
+class CReader
+{
+public:
+  CReader(const AP4_UI08* data, AP4_Size size) : m_data{data}, m_size{size} {}
+
+  bool Read(AP4_UI32& value, unsigned int bytes)
+  {
+    if (m_size - m_pos < bytes)
+      return false;
+    value = 0;
+    for (unsigned int i{0}; i < bytes; ++i)
+      value = (value << 8) | m_data[m_pos++];
+    return true;
+  }
+
+  bool Read(AP4_UI08* buffer, AP4_Size bytes)
+  {
+    if (m_size - m_pos < bytes)
+      return false;
+    std::memcpy(buffer, m_data + m_pos, bytes);
+    m_pos += bytes;
+    return true;
+  }
+
+private:
+  const AP4_UI08* m_data;
+  AP4_Size m_size;
+  AP4_Size m_pos{0};
+};
+} // unnamed namespace
+
+bool CCencSampleGroups::Parse(AP4_ContainerAtom* traf,
+                              AP4_Track* track,
+                              AP4_UI08 defaultIvSize,
+                              const AP4_UI08* defaultConstantIv)
+{
+  Clear();
+
+  AP4_SbgpAtom* sbgp{traf ? FindSeigSampleToGroup(traf) : nullptr};
+  if (!sbgp)
+    return false;
+
+  AP4_DataBuffer* entryData{nullptr};
+  AP4_SgpdAtom* sgpd{FindSeigDescription(traf)};
+  for (AP4_Ordinal i{0}; sgpd && AP4_SUCCEEDED(sgpd->GetEntries().Get(i, entryData)); ++i)
+  {
+    if (!AddEntry(entryData->GetData(), entryData->GetDataSize(), true))
+      LOG::LogF(LOGWARNING, "Invalid 'seig' sample group entry in the track fragment");
+  }
+
+  if (track && track->GetTrakAtom())
+  {
+    sgpd = FindSeigDescription(AP4_DYNAMIC_CAST(
+        AP4_ContainerAtom, track->GetTrakAtom()->FindChild("mdia/minf/stbl")));
+    for (AP4_Ordinal i{0}; sgpd && AP4_SUCCEEDED(sgpd->GetEntries().Get(i, entryData)); ++i)
+    {
+      if (!AddEntry(entryData->GetData(), entryData->GetDataSize(), false))
+        LOG::LogF(LOGWARNING, "Invalid 'seig' sample group entry in the sample table");
+    }
+  }
+
+  for (AP4_Ordinal i{0}; i < sbgp->GetEntries().ItemCount(); ++i)
+  {
+    const AP4_SbgpAtom::Entry& run{sbgp->GetEntries()[i]};
+    AddSampleRun(run.sample_count, run.group_description_index);
+  }
+
+  // The 'senc' atom is parsed from his serialized data, because the size
+  // of each sample IV depends on the sample group of the sample
+  AP4_Atom* senc{traf->GetChild(AP4_ATOM_TYPE_SENC, 0)};
+  if (senc)
+  {
+    AP4_MemoryByteStream stream;
+    if (AP4_SUCCEEDED(senc->Write(stream)))
+    {
+      const AP4_UI08* data{stream.GetData()};
+      AP4_Size headerSize{AP4_BytesToUInt32BE(data) == 1 ? 16U : 8U};
+      if (stream.GetDataSize() < headerSize ||
+          !ParseSampleEncryption(data + headerSize, stream.GetDataSize() - headerSize,
+                                 defaultIvSize, defaultConstantIv))
+      {
+        LOG::LogF(LOGWARNING, "Cannot parse the 'senc' atom data");
+        m_sampleInfos.clear();
+      }
+    }
+  }
+  return true;
+}
+
+void CCencSampleGroups::Clear()
+{
+  m_fragmentEntries.clear();
+  m_trackEntries.clear();
+  m_sampleGroups.clear();
+  m_sampleInfos.clear();
+}
+
+bool CCencSampleGroups::AddEntry(const AP4_UI08* data, AP4_Size size, bool isFragmentEntry)
+{
+  Entry entry;
+  if (size < SEIG_ENTRY_MIN_SIZE)
+    return false;
+
+  entry.m_cryptBlocks = data[1] >> 4;
+  entry.m_skipBlocks = data[1] & 0x0F;
+  entry.m_isProtected = data[2] != 0;
+  entry.m_ivSize = data[3];
+  std::memcpy(entry.m_keyId, data + 4, 16);
+
+  if (entry.m_isProtected && entry.m_ivSize == 0)
+  {
+    // constant_IV_size(8) + constant_IV
+    if (size < SEIG_ENTRY_MIN_SIZE + 1)
+      return false;
+    const AP4_UI08 constantIvSize{data[SEIG_ENTRY_MIN_SIZE]};
+    if (constantIvSize > 16 || size < SEIG_ENTRY_MIN_SIZE + 1 + constantIvSize)
+      return false;
+    std::memcpy(entry.m_constantIv, data + SEIG_ENTRY_MIN_SIZE + 1, constantIvSize);
+  }
+  else if (entry.m_ivSize != 0 && entry.m_ivSize != 8 && entry.m_ivSize != 16)
+    return false;
+
+  if (isFragmentEntry)
+    m_fragmentEntries.emplace_back(entry);
+  else
+    m_trackEntries.emplace_back(entry);
+  return true;
+}
+
+void CCencSampleGroups::AddSampleRun(AP4_UI32 sampleCount, AP4_UI32 groupIndex)
+{
+  if (sampleCount > MAX_SAMPLE_COUNT - m_sampleGroups.size())
+    sampleCount = static_cast<AP4_UI32>(MAX_SAMPLE_COUNT - m_sampleGroups.size());
+
+  m_sampleGroups.insert(m_sampleGroups.end(), sampleCount, groupIndex);
+}
+
+bool CCencSampleGroups::ParseSampleEncryption(const AP4_UI08* data,
+                                              AP4_Size size,
+                                              AP4_UI08 defaultIvSize,
+                                              const AP4_UI08* defaultConstantIv)
+{
+  m_sampleInfos.clear();
+
+  CReader reader{data, size};
+  AP4_UI32 flags;
+  AP4_UI32 sampleCount;
+  if (!reader.Read(flags, 4))
+    return false;
+  flags &= 0x00FFFFFF; // Remove the version
+
+  if (flags & SENC_FLAG_OVERRIDE_TRACK_ENCRYPTION)
+  {
+    AP4_UI32 algorithmId;
+    AP4_UI32 ivSize;
+    AP4_UI08 keyId[16];
+    if (!reader.Read(algorithmId, 3) || !reader.Read(ivSize, 1) || !reader.Read(keyId, 16))
+      return false;
+    defaultIvSize = static_cast<AP4_UI08>(ivSize);
+  }
+
+  if (!reader.Read(sampleCount, 4) || sampleCount > MAX_SAMPLE_COUNT)
+    return false;
+
+  m_sampleInfos.resize(sampleCount);
+
+  for (AP4_UI32 index{0}; index < sampleCount; ++index)
+  {
+    SampleInfo& info{m_sampleInfos[index]};
+    const Entry* entry{GetEntry(index)};
+
+    AP4_UI08 ivSize{defaultIvSize};
+    const AP4_UI08* constantIv{defaultConstantIv};
+    if (entry)
+    {
+      ivSize = entry->m_isProtected ? entry->m_ivSize : 0;
+      constantIv = entry->m_constantIv;
+    }
+
+    if (ivSize > 16 || !reader.Read(info.m_iv, ivSize))
+      return false;
+    if (ivSize == 0 && constantIv)
+      std::memcpy(info.m_iv, constantIv, 16);
+
+    if (flags & SENC_FLAG_USE_SUBSAMPLE_ENCRYPTION)
+    {
+      AP4_UI32 subsampleCount;
+      if (!reader.Read(subsampleCount, 2))
+        return false;
+
+      info.m_clearBytes.resize(subsampleCount);
+      info.m_cipherBytes.resize(subsampleCount);
+      for (AP4_UI32 i{0}; i < subsampleCount; ++i)
+      {
+        AP4_UI32 clearBytes;
+        if (!reader.Read(clearBytes, 2) || !reader.Read(info.m_cipherBytes[i], 4))
+          return false;
+        info.m_clearBytes[i] = static_cast<AP4_UI16>(clearBytes);
+      }
+    }
+  }
+  return true;
+}
+
+const CCencSampleGroups::Entry* CCencSampleGroups::GetEntry(AP4_UI32 sampleIndex) const
+{
+  if (sampleIndex >= m_sampleGroups.size())
+    return nullptr;
+
+  // Index 0 means that the sample is not member of a group, the track defaults apply
+  AP4_UI32 groupIndex{m_sampleGroups[sampleIndex]};
+  if (groupIndex > FRAGMENT_GROUP_INDEX_BASE)
+  {
+    groupIndex -= FRAGMENT_GROUP_INDEX_BASE;
+    return groupIndex <= m_fragmentEntries.size() ? &m_fragmentEntries[groupIndex - 1] : nullptr;
+  }
+  else if (groupIndex > 0)
+    return groupIndex <= m_trackEntries.size() ? &m_trackEntries[groupIndex - 1] : nullptr;
+
+  return nullptr;
+}
+
+std::vector<const AP4_UI08*> CCencSampleGroups::GetKeyIds(AP4_UI32 sampleCount,
+                                                          bool& hasDefaultKeySamples) const
+{
+  std::vector<const AP4_UI08*> keyIds;
+  hasDefaultKeySamples = false;
+
+  for (AP4_UI32 index{0}; index < sampleCount; ++index)
+  {
+    const Entry* entry{GetEntry(index)};
+    if (!entry)
+    {
+      hasDefaultKeySamples = true;
+      continue;
+    }
+    if (!entry->m_isProtected)
+      continue;
+
+    if (std::none_of(keyIds.begin(), keyIds.end(), [entry](const AP4_UI08* keyId)
+                     { return std::memcmp(keyId, entry->m_keyId, 16) == 0; }))
+    {
+      keyIds.emplace_back(entry->m_keyId);
+    }
+  }
+  return keyIds;
+}
+
+const CCencSampleGroups::SampleInfo* CCencSampleGroups::GetSampleInfo(AP4_UI32 sampleIndex) const
+{
+  return sampleIndex < m_sampleInfos.size() ? &m_sampleInfos[sampleIndex] : nullptr;
+}
@@ -0,0 +1,114 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <bento4/Ap4.h>
+
+/*!
+ * \brief The CENC sample groups ('seig' sgpd / sbgp atoms) of a track fragment,
+ *        they allow each sample to use his own KID, IV size, pattern or to be
+ *        unencrypted. Since the per-sample IV size can change within the
+ *        fragment, the sample encryption info ('senc' atom) is parsed here too.
+ */
+class CCencSampleGroups
+{
+public:
+  // CencSampleEncryptionInformationGroupEntry
+  struct Entry
+  {
+    bool m_isProtected{false};
+    AP4_UI08 m_cryptBlocks{0};
+    AP4_UI08 m_skipBlocks{0};
+    AP4_UI08 m_ivSize{0}; // Per_Sample_IV_Size, 0 when the constant IV is used
+    AP4_UI08 m_keyId[16]{};
+    AP4_UI08 m_constantIv[16]{};
+  };
+
+  struct SampleInfo
+  {
+    AP4_UI08 m_iv[16]{};
+    std::vector<AP4_UI16> m_clearBytes;
+    std::vector<AP4_UI32> m_cipherBytes;
+  };
+
+  /*!
+   * \brief Parse the sample groups and the sample encryption info of a track fragment.
+   * \param traf The track fragment
+   * \param track [OPT] The track, to resolve the sample group descriptions of the sample table
+   * \param defaultIvSize The default per-sample IV size of the track ('tenc' atom)
+   * \param defaultConstantIv [OPT] The default constant IV (16 bytes) of the track
+   * \return True if the fragment use 'seig' sample groups, otherwise false
+   */
+  bool Parse(AP4_ContainerAtom* traf,
+             AP4_Track* track,
+             AP4_UI08 defaultIvSize,
+             const AP4_UI08* defaultConstantIv);
+
+  void Clear();
+
+  /*!
+   * \brief Add a sample group description entry, from the raw 'seig' entry data.
+   * \param data The entry data
+   * \param size The entry data size
+   * \param isFragmentEntry True for an entry of the track fragment,
+   *                        false for an entry of the sample table
+   * \return True if success, otherwise false
+   */
+  bool AddEntry(const AP4_UI08* data, AP4_Size size, bool isFragmentEntry);
+
+  /*!
+   * \brief Add a run of samples mapped to the same group ('sbgp' entry).
+   * \param sampleCount The number of samples
+   * \param groupIndex The group description index, 0 for no group, from 0x10001
+   *                   the entries of the track fragment, otherwise of the sample table
+   */
+  void AddSampleRun(AP4_UI32 sampleCount, AP4_UI32 groupIndex);
+
+  /*!
+   * \brief Parse the sample encryption info ('senc' atom payload, after the atom header),
+   *        the sample groups must be already added.
+   * \return True if success, otherwise false
+   */
+  bool ParseSampleEncryption(const AP4_UI08* data,
+                             AP4_Size size,
+                             AP4_UI08 defaultIvSize,
+                             const AP4_UI08* defaultConstantIv);
+
+  bool IsEmpty() const { return m_sampleGroups.empty(); }
+
+  /*!
+   * \brief Get the sample group entry of a sample.
+   * \return The entry, otherwise nullptr when the sample is not member of a group
+   */
+  const Entry* GetEntry(AP4_UI32 sampleIndex) const;
+
+  /*!
+   * \brief Get the KIDs of the protected sample groups of the samples, each KID once.
+   * \param sampleCount The number of samples of the fragment
+   * \param hasDefaultKeySamples [OUT] True if some protected sample is not member
+   *                             of a group, so it use the default KID of the track
+   * \return The KIDs (16 bytes each), valid until the groups are cleared
+   */
+  std::vector<const AP4_UI08*> GetKeyIds(AP4_UI32 sampleCount, bool& hasDefaultKeySamples) const;
+
+  /*!
+   * \brief Get the encryption info of a sample.
+   * \return The sample info, otherwise nullptr if not available
+   */
+  const SampleInfo* GetSampleInfo(AP4_UI32 sampleIndex) const;
+
+private:
+  std::vector<Entry> m_fragmentEntries;
+  std::vector<Entry> m_trackEntries; // The entries of the sample table
+  std::vector<AP4_UI32> m_sampleGroups; // The group description index of each sample
+  std::vector<SampleInfo> m_sampleInfos;
+};
@@ -65,6 +65,7 @@ IRepresentationChooser* CHOOSER::CreateRepresentationChooser(
     reprChooser = new CRepresentationChooserDefault();
 
   reprChooser->Initialize(kodiProps.m_chooserProps);
+  reprChooser->SetAudioOnly(kodiProps.m_isAudioOnly);
 
   return reprChooser;
 }
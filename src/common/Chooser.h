@@ -77,6 +77,14 @@ public:
    */
   virtual void SetSecureSession(const bool isSecureSession) { m_isSecureSession = isSecureSession; }
 
+  /*!
+   * \brief Set the audio only mode, the video is not played but a video
+   *        stream that carry the audio must still be downloaded, then the
+   *        video selection is skipped and the lowest bandwidth is taken
+   * \param isAudioOnly Set true when only the audio is played
+   */
+  void SetAudioOnly(const bool isAudioOnly) { m_isAudioOnly = isAudioOnly; }
+
   /*!
    * \brief Get the representation from an adaptation set
    * \param adp The adaptation set where choose the representation
@@ -107,6 +115,7 @@ protected:
                   PLAYLIST::CRepresentation* nextRep);
 
   bool m_isSecureSession{false};
+  bool m_isAudioOnly{false};
 
   // Current screen width resolution (this value is auto-updated by Kodi)
   int m_screenCurrentWidth{0};
@@ -9,6 +9,7 @@
 #include "ChooserDefault.h"
 
 #include "../utils/SettingsUtils.h"
+#include "../utils/Utils.h"
 #include "../utils/log.h"
 #include "ReprSelector.h"
 
@@ -26,6 +27,34 @@ namespace
 
 constexpr const long long SCREEN_RES_REFRESH_SECS = 10;
 
+// Get the bitrate needed by the video codec for the same quality, relative to H.264
+double GetCodecEfficiency(const CRepresentation* rep)
+{
+  const std::string codecFamily{GetVideoCodecFamily(rep->GetFirstCodec())};
+  if (codecFamily == "hevc")
+    return 0.6;
+  if (codecFamily == "vp9")
+    return 0.65;
+  if (codecFamily == "av1")
+    return 0.5;
+  return 1.0;
+}
+
+// Get the lowest bandwidth representation, of the codec family if not empty
+CRepresentation* GetLowestBandwidth(CAdaptationSet* adp, std::string_view codecFamily)
+{
+  CRepresentation* lowestRep{nullptr};
+  for (auto& rep : adp->GetRepresentations())
+  {
+    if (!codecFamily.empty() && GetVideoCodecFamily(rep->GetFirstCodec()) != codecFamily)
+      continue;
+
+    if (rep->IsHdcpCompliant() && (!lowestRep || rep->GetBandwidth() < lowestRep->GetBandwidth()))
+      lowestRep = rep.get();
+  }
+  return lowestRep;
+}
+
 } // unnamed namespace
 
 CRepresentationChooserDefault::CRepresentationChooserDefault()
@@ -149,6 +178,23 @@ void CRepresentationChooserDefault::RefreshResolution()
   m_screenResLastUpdate = std::chrono::steady_clock::now();
 }
 
+void CRepresentationChooserDefault::SetSecureSession(const bool isSecureSession)
+{
+  if (m_isSecureSession == isSecureSession)
+    return;
+
+  m_isSecureSession = isSecureSession;
+
+  // Apply now the resolution limit of the new session type,
+  // it can change while playing when the license is deferred
+  if (m_screenWidth != 0)
+  {
+    m_screenWidth = 0;
+    m_screenResLastUpdate.reset();
+    RefreshResolution();
+  }
+}
+
 void CRepresentationChooserDefault::SetDownloadSpeed(const double speed)
 {
   m_downloadSpeedChron.push_back(speed);
@@ -179,6 +225,18 @@ void CRepresentationChooserDefault::SetDownloadSpeed(const double speed)
 PLAYLIST::CRepresentation* CRepresentationChooserDefault::GetNextRepresentation(
     PLAYLIST::CAdaptationSet* adp, PLAYLIST::CRepresentation* currentRep)
 {
+  // In audio only mode the video is not played, it is downloaded only for the
+  // audio muxed in it, then the video selection is skipped
+  if (m_isAudioOnly && adp->GetStreamType() == StreamType::VIDEO)
+  {
+    const std::string codecFamily{currentRep ? GetVideoCodecFamily(currentRep->GetFirstCodec())
+                                             : ""};
+    CRepresentation* lowestRep{GetLowestBandwidth(adp, codecFamily)};
+    if (!lowestRep)
+      lowestRep = CRepresentationSelector(m_screenWidth, m_screenHeight).Lowest(adp);
+    return lowestRep;
+  }
+
   if (!m_ignoreScreenRes && !m_ignoreScreenResChange)
     RefreshResolution();
 
@@ -198,11 +256,27 @@ PLAYLIST::CRepresentation* CRepresentationChooserDefault::GetNextRepresentation(
              m_bandwidthCurrent, bandwidth);
   }
 
+  // Adaptation sets merged by the adaptation set switching can have representations
+  // of different codecs, the codec can be changed only at the start of the stream
+  // or of a period, while playing the representations must have the same codec
+  const std::string currentCodec{currentRep ? GetVideoCodecFamily(currentRep->GetFirstCodec())
+                                            : ""};
+
   CRepresentation* nextRep{nullptr};
+  CRepresentation* lowestRep{nullptr};
   int bestScore{-1};
 
   for (auto& rep : adp->GetRepresentations())
   {
+    if (currentRep && GetVideoCodecFamily(rep->GetFirstCodec()) != currentCodec)
+      continue;
+
+    if (!rep->IsHdcpCompliant())
+      continue;
+
+    if (!lowestRep || rep->GetBandwidth() < lowestRep->GetBandwidth())
+      lowestRep = rep.get();
+
     int score{std::abs(rep->GetWidth() * rep->GetHeight() - m_screenWidth * m_screenHeight)};
 
     if (!m_isForceStartsMaxRes)
@@ -210,10 +284,16 @@ PLAYLIST::CRepresentation* CRepresentationChooserDefault::GetNextRepresentation(
       if (rep->GetBandwidth() > bandwidth)
         continue;
 
-      score += static_cast<int>(std::sqrt(bandwidth - rep->GetBandwidth()));
+      // A more efficient codec gives a better quality with the same bandwidth,
+      // so the bandwidth is compared as H.264 equivalent bandwidth
+      const double equivalentBw{
+          std::min<double>(bandwidth, rep->GetBandwidth() / GetCodecEfficiency(rep.get()))};
+      score += static_cast<int>(std::sqrt(bandwidth - equivalentBw));
     }
 
-    if (bestScore == -1 || score < bestScore)
+    // On equal score prefer the lower bandwidth e.g. the more efficient codec
+    if (bestScore == -1 || score < bestScore ||
+        (score == bestScore && rep->GetBandwidth() < nextRep->GetBandwidth()))
     {
       bestScore = score;
       nextRep = rep.get();
@@ -221,7 +301,7 @@ PLAYLIST::CRepresentation* CRepresentationChooserDefault::GetNextRepresentation(
   }
 
   if (!nextRep)
-    nextRep = selector.Lowest(adp);
+    nextRep = lowestRep ? lowestRep : selector.Lowest(adp);
 
   if (adp->GetStreamType() == StreamType::VIDEO)
     LogDetails(currentRep, nextRep);
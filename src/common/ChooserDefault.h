@@ -30,6 +30,8 @@ public:
   virtual void Initialize(const UTILS::PROPERTIES::ChooserProps& props) override;
   virtual void PostInit() override;
 
+  void SetSecureSession(const bool isSecureSession) override;
+
   void SetDownloadSpeed(const double speed) override;
 
   PLAYLIST::CRepresentation* GetNextRepresentation(PLAYLIST::CAdaptationSet* adp,
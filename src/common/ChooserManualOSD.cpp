@@ -50,6 +50,14 @@ void CRepresentationChooserManualOSD::Initialize(const UTILS::PROPERTIES::Choose
            m_screenResSecureMax.first, m_screenResSecureMax.second);
 }
 
+void CRepresentationChooserManualOSD::SetSecureSession(const bool isSecureSession)
+{
+  m_isSecureSession = isSecureSession;
+  // The resolution limit can change while playing when the license is deferred
+  if (m_screenWidth != 0)
+    RefreshResolution();
+}
+
 void CRepresentationChooserManualOSD::RefreshResolution()
 {
   m_screenWidth = m_screenCurrentWidth;
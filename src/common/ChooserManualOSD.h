@@ -26,6 +26,8 @@ public:
 
   virtual void PostInit() override;
 
+  void SetSecureSession(const bool isSecureSession) override;
+
   virtual UTILS::SETTINGS::StreamSelection GetStreamSelectionMode() override
   {
     return m_streamSelectionMode;
@@ -0,0 +1,337 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "ContentSteering.h"
+
+#include "../utils/JsonUtils.h"
+#include "../utils/UrlUtils.h"
+#include "../utils/log.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace adaptive;
+using namespace UTILS;
+
+namespace
+{
+constexpr uint32_t MIN_TTL = 1;
+constexpr uint32_t MAX_TTL = 86400;
+
+// Replace the host (and port) of an absolute url
+std::string ReplaceHost(const std::string& url, std::string_view host)
+{
+  const size_t hostPos{url.find("://")};
+  if (hostPos == std::string::npos)
+    return url;
+
+  const size_t pathPos{url.find('/', hostPos + 3)};
+  std::string newUrl{url.substr(0, hostPos + 3)};
+  newUrl += host;
+  if (pathPos != std::string::npos)
+    newUrl += url.substr(pathPos);
+  return newUrl;
+}
+
+bool StartsWith(std::string_view str, std::string_view prefix)
+{
+  return str.substr(0, prefix.size()) == prefix;
+}
+} // unnamed namespace
+
+void CContentSteering::Initialize(Protocol protocol,
+                                  std::string_view serverUrl,
+                                  std::string_view defaultPathway)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_protocol = protocol;
+  m_serverUrl = serverUrl;
+  m_reloadUrl.clear();
+  m_defaultPathway = defaultPathway;
+  m_pathway = defaultPathway;
+  m_nextUpdate = std::chrono::steady_clock::now();
+}
+
+bool CContentSteering::IsEnabled() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return !m_serverUrl.empty();
+}
+
+std::string CContentSteering::GetPathway() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_pathway;
+}
+
+std::string CContentSteering::GetDefaultPathway() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_defaultPathway;
+}
+
+void CContentSteering::AddPathwayUrl(std::string_view pathwayId,
+                                     std::string_view url,
+                                     std::string_view defaultUrl)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if (pathwayId == m_defaultPathway)
+  {
+    m_defaultUrls.emplace(defaultUrl);
+    return;
+  }
+
+  // Remove the path in common, so the prefixes apply also to the other urls below them
+  size_t suffixLen{0};
+  while (suffixLen < url.size() && suffixLen < defaultUrl.size() &&
+         url[url.size() - suffixLen - 1] == defaultUrl[defaultUrl.size() - suffixLen - 1])
+  {
+    ++suffixLen;
+  }
+  // The prefix must keep at least the scheme and the host
+  const size_t schemePos{url.find("://")};
+  const size_t slashPos{url.find('/', url.size() - suffixLen)};
+  if (schemePos != std::string_view::npos && slashPos != std::string_view::npos &&
+      slashPos > schemePos + 3)
+  {
+    suffixLen = url.size() - slashPos;
+    url.remove_suffix(suffixLen);
+    defaultUrl.remove_suffix(suffixLen);
+  }
+
+  m_defaultUrls.emplace(defaultUrl);
+
+  auto& urls = m_pathways[std::string(pathwayId)].m_urls;
+  for (const auto& [pathwayDefaultUrl, pathwayUrl] : urls)
+  {
+    if (pathwayDefaultUrl == defaultUrl)
+      return;
+  }
+  urls.emplace_back(defaultUrl, url);
+}
+
+bool CContentSteering::HasPathway(std::string_view pathwayId) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return pathwayId == m_defaultPathway || m_pathways.find(pathwayId) != m_pathways.end();
+}
+
+std::string CContentSteering::ResolveUrl(std::string_view url) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  std::string defaultUrl{url};
+  if (m_serverUrl.empty() || m_pathways.empty())
+    return defaultUrl;
+
+  // Urls from the playlists of other pathways (e.g. HLS segments) go back to the default
+  // pathway, the longest prefix is the most specific
+  const std::pair<std::string, std::string>* match{nullptr};
+  for (const auto& [id, pathway] : m_pathways)
+  {
+    for (const auto& urls : pathway.m_urls)
+    {
+      if (StartsWith(url, urls.second) && (!match || urls.second.size() > match->second.size()))
+        match = &urls;
+    }
+  }
+  if (match)
+    defaultUrl = match->first + defaultUrl.substr(match->second.size());
+
+  if (m_pathway == m_defaultPathway)
+    return defaultUrl;
+
+  auto itPathway = m_pathways.find(m_pathway);
+  if (itPathway == m_pathways.end())
+    return defaultUrl;
+
+  match = nullptr;
+  for (const auto& urls : itPathway->second.m_urls)
+  {
+    if (StartsWith(defaultUrl, urls.first) && (!match || urls.first.size() > match->first.size()))
+      match = &urls;
+  }
+  // Without an equivalent url the default pathway is kept
+  if (!match)
+    return defaultUrl;
+
+  std::string pathwayUrl{match->second + defaultUrl.substr(match->first.size())};
+  const std::string& params = itPathway->second.m_params;
+  if (!params.empty() && pathwayUrl.find(params) == std::string::npos)
+    URL::AppendParameters(pathwayUrl, params);
+  return pathwayUrl;
+}
+
+bool CContentSteering::IsUpdateDue() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return !m_serverUrl.empty() && std::chrono::steady_clock::now() >= m_nextUpdate;
+}
+
+std::chrono::steady_clock::time_point CContentSteering::GetNextUpdateTime() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_nextUpdate;
+}
+
+std::string CContentSteering::GetManifestUrl() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  std::string url{m_reloadUrl.empty() ? m_serverUrl : m_reloadUrl};
+  const char* pathwayParam{m_protocol == Protocol::DASH ? "_DASH_pathway=" : "_HLS_pathway="};
+  URL::AppendParameters(url, pathwayParam + m_pathway);
+  return url;
+}
+
+bool CContentSteering::ApplyManifest(std::string_view data, std::string_view manifestUrl)
+{
+  JSON::Value manifest;
+  if (!JSON::Parse(data, manifest) || manifest.m_type != JSON::ValueType::OBJECT)
+  {
+    LOG::LogF(LOGERROR, "Malformed steering manifest");
+    OnManifestFailed();
+    return false;
+  }
+
+  if (manifest.GetNumber("VERSION") != 1)
+  {
+    LOG::LogF(LOGERROR, "Steering manifest version %.0f not supported",
+              manifest.GetNumber("VERSION"));
+    OnManifestFailed();
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  const JSON::Value* clones{manifest.Get("PATHWAY-CLONES")};
+  if (clones && clones->m_type == JSON::ValueType::ARRAY)
+  {
+    for (const JSON::Value& clone : clones->m_array)
+    {
+      const std::string baseId{clone.GetString("BASE-ID")};
+      const std::string id{clone.GetString("ID")};
+      const JSON::Value* uriReplacement{clone.Get("URI-REPLACEMENT")};
+      if (baseId.empty() || id.empty() || !uriReplacement)
+        continue;
+
+      if (uriReplacement->Get("PER-VARIANT-URIS") || uriReplacement->Get("PER-RENDITION-URIS"))
+        LOG::LogF(LOGDEBUG, "Per variant/rendition URIs of pathway clone \"%s\" not supported",
+                  id.c_str());
+
+      std::string params;
+      const JSON::Value* paramsValue{uriReplacement->Get("PARAMS")};
+      if (paramsValue && paramsValue->m_type == JSON::ValueType::OBJECT)
+      {
+        for (const auto& [name, value] : paramsValue->m_object)
+        {
+          if (value.m_type != JSON::ValueType::STRING)
+            continue;
+          if (!params.empty())
+            params += '&';
+          params += name + '=' + value.m_string;
+        }
+      }
+      ClonePathway(baseId, id, uriReplacement->GetString("HOST"), params);
+    }
+  }
+
+  // DASH name the pathways as service locations
+  const JSON::Value* priority{manifest.Get("PATHWAY-PRIORITY")};
+  if (!priority)
+    priority = manifest.Get("SERVICE-LOCATION-PRIORITY");
+
+  if (priority && priority->m_type == JSON::ValueType::ARRAY)
+  {
+    for (const JSON::Value& pathwayId : priority->m_array)
+    {
+      if (pathwayId.m_type != JSON::ValueType::STRING)
+        continue;
+
+      if (pathwayId.m_string == m_defaultPathway ||
+          m_pathways.find(pathwayId.m_string) != m_pathways.end())
+      {
+        if (m_pathway != pathwayId.m_string)
+        {
+          LOG::Log(LOGINFO, "Content steering: switch pathway from \"%s\" to \"%s\"",
+                   m_pathway.c_str(), pathwayId.m_string.c_str());
+          m_pathway = pathwayId.m_string;
+        }
+        break;
+      }
+    }
+  }
+
+  const std::string reloadUri{manifest.GetString("RELOAD-URI")};
+  if (!reloadUri.empty())
+  {
+    m_reloadUrl = URL::IsUrlAbsolute(reloadUri)
+                      ? reloadUri
+                      : URL::Join(URL::RemoveParameters(std::string(manifestUrl)), reloadUri);
+  }
+
+  // The TTL is provided by the steering server, a value out of range cannot be casted
+  double ttlSecs{manifest.GetNumber("TTL", DEFAULT_TTL)};
+  if (!std::isfinite(ttlSecs))
+    ttlSecs = DEFAULT_TTL;
+  ScheduleUpdate(static_cast<uint32_t>(std::clamp<double>(ttlSecs, MIN_TTL, MAX_TTL)));
+  return true;
+}
+
+void CContentSteering::OnManifestFailed()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  ScheduleUpdate(DEFAULT_TTL);
+}
+
+void CContentSteering::ClonePathway(const std::string& baseId,
+                                    const std::string& id,
+                                    const std::string& host,
+                                    const std::string& params)
+{
+  if (id == m_defaultPathway || m_pathways.find(id) != m_pathways.end())
+    return; // Clones cannot replace existing pathways
+
+  Pathway clone;
+  clone.m_params = params;
+
+  if (baseId == m_defaultPathway)
+  {
+    for (const std::string& defaultUrl : m_defaultUrls)
+    {
+      clone.m_urls.emplace_back(defaultUrl,
+                                host.empty() ? defaultUrl : ReplaceHost(defaultUrl, host));
+    }
+  }
+  else
+  {
+    auto itBase = m_pathways.find(baseId);
+    if (itBase == m_pathways.end())
+    {
+      LOG::LogF(LOGWARNING, "Cannot clone pathway \"%s\", base pathway \"%s\" not found",
+                id.c_str(), baseId.c_str());
+      return;
+    }
+    for (const auto& [defaultUrl, baseUrl] : itBase->second.m_urls)
+      clone.m_urls.emplace_back(defaultUrl, host.empty() ? baseUrl : ReplaceHost(baseUrl, host));
+
+    if (clone.m_params.empty())
+      clone.m_params = itBase->second.m_params;
+  }
+
+  LOG::Log(LOGDEBUG, "Content steering: added pathway \"%s\" cloned from \"%s\"", id.c_str(),
+           baseId.c_str());
+  m_pathways.emplace(id, std::move(clone));
+}
+
+void CContentSteering::ScheduleUpdate(uint32_t ttlSecs)
+{
+  m_nextUpdate =
+      std::chrono::steady_clock::now() + std::chrono::seconds(std::max(ttlSecs, MIN_TTL));
+}
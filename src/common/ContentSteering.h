@@ -0,0 +1,146 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "../test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace adaptive
+{
+
+/*!
+ * \brief Content steering, the steering server select the pathway (e.g. the CDN)
+ *        where download the playlists and the segments, by a steering manifest
+ *        refreshed at each TTL (HLS EXT-X-CONTENT-STEERING, DASH <ContentSteering>).
+ *        The manifest urls are parsed from the default pathway, the urls
+ *        of the other pathways are resolved by replacing the url prefixes
+ *        of the default pathway with the equivalent prefixes of the pathway.
+ *        Thread safe.
+ */
+class ATTR_DLL_LOCAL CContentSteering
+{
+public:
+  enum class Protocol
+  {
+    HLS,
+    DASH,
+  };
+
+  // Default steering manifest reload time, in seconds
+  static constexpr uint32_t DEFAULT_TTL = 300;
+
+  /*!
+   * \brief Enable the content steering.
+   * \param protocol The protocol, that define the steering request parameter names
+   * \param serverUrl The steering server url
+   * \param defaultPathway The pathway used until the first steering manifest
+   */
+  void Initialize(Protocol protocol, std::string_view serverUrl, std::string_view defaultPathway);
+
+  bool IsEnabled() const;
+
+  /*!
+   * \brief Get the current pathway.
+   */
+  std::string GetPathway() const;
+
+  std::string GetDefaultPathway() const;
+
+  /*!
+   * \brief Add an url of a pathway, equivalent to an url of the default pathway,
+   *        the path in common is removed so the prefixes apply to all the urls below them.
+   *        For the default pathway the url is kept as is, as base for the pathway clones.
+   * \param pathwayId The pathway id
+   * \param url The url of the pathway
+   * \param defaultUrl The equivalent url of the default pathway
+   */
+  void AddPathwayUrl(std::string_view pathwayId, std::string_view url, std::string_view defaultUrl);
+
+  /*!
+   * \brief Check if the pathway is known, from the manifest or cloned.
+   */
+  bool HasPathway(std::string_view pathwayId) const;
+
+  /*!
+   * \brief Resolve an url (of any pathway) to the current pathway.
+   * \param url The absolute url
+   * \return The url of the current pathway, or the url unchanged if it has
+   *         no equivalent url on the current pathway
+   */
+  std::string ResolveUrl(std::string_view url) const;
+
+  /*!
+   * \brief Check if the steering manifest must be (re)loaded.
+   */
+  bool IsUpdateDue() const;
+
+  /*!
+   * \brief Get the time when the steering manifest must be (re)loaded.
+   */
+  std::chrono::steady_clock::time_point GetNextUpdateTime() const;
+
+  /*!
+   * \brief Get the url to request the steering manifest, with the current pathway
+   *        as query parameter.
+   */
+  std::string GetManifestUrl() const;
+
+  /*!
+   * \brief Apply a steering manifest: pathway clones, pathway priority, reload url and TTL.
+   *        The current pathway become the first pathway of the priority that is known.
+   * \param data The steering manifest JSON data
+   * \param manifestUrl The url of the steering manifest, to resolve the relative reload url
+   * \return True if success, otherwise false
+   */
+  bool ApplyManifest(std::string_view data, std::string_view manifestUrl);
+
+  /*!
+   * \brief Schedule the steering manifest reload after a failed request.
+   */
+  void OnManifestFailed();
+
+private:
+  struct Pathway
+  {
+    // Pairs of default pathway url prefix and the equivalent url prefix of the pathway
+    std::vector<std::pair<std::string, std::string>> m_urls;
+    std::string m_params; // Query parameters to add to the urls, from pathway clone
+  };
+
+  void ClonePathway(const std::string& baseId,
+                    const std::string& id,
+                    const std::string& host,
+                    const std::string& params);
+  void ScheduleUpdate(uint32_t ttlSecs);
+
+  mutable std::mutex m_mutex;
+  Protocol m_protocol{Protocol::HLS};
+  std::string m_serverUrl;
+  std::string m_reloadUrl;
+  std::string m_defaultPathway;
+  std::string m_pathway;
+  std::map<std::string, Pathway, std::less<>> m_pathways;
+  std::set<std::string> m_defaultUrls;
+  std::chrono::steady_clock::time_point m_nextUpdate;
+};
+
+} // namespace adaptive
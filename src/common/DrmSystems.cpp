@@ -0,0 +1,142 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "DrmSystems.h"
+
+#include "../utils/StringUtils.h"
+
+#include <array>
+#include <cctype>
+#include <cstring>
+
+using namespace DRM;
+using namespace UTILS;
+
+namespace
+{
+constexpr std::string_view URN_UUID_PREFIX = "urn:uuid:";
+
+constexpr std::array<KeySystemInfo, 4> KEY_SYSTEMS{{
+    {KeySystem::WIDEVINE, "com.widevine.alpha", "EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED", ""},
+    {KeySystem::PLAYREADY, "com.microsoft.playready", "9A04F079-9840-4286-AB92-E65BE0885F95",
+     ""},
+    {KeySystem::WISEPLAY, "com.huawei.wiseplay", "3D5E6D35-9B9A-41E8-B843-DD3C6E72C42C", ""},
+    // DASH-IF ClearKey system id, the W3C common PSSH system id is used as alternative
+    {KeySystem::CLEARKEY, "org.w3.clearkey", "E2719D58-A985-B3C9-781A-B030AF78D30E",
+     "1077EFEC-C0B2-4D02-ACE3-3C1E52E2FB4B"},
+}};
+
+bool IsSameSystemId(std::string_view identifier, std::string_view uuid)
+{
+  if (uuid.empty())
+    return false;
+
+  uint8_t systemId[16];
+  uint8_t uuidSystemId[16];
+  return ParseSystemId(identifier, systemId) && ParseSystemId(uuid, uuidSystemId) &&
+         std::memcmp(systemId, uuidSystemId, 16) == 0;
+}
+} // unnamed namespace
+
+const KeySystemInfo* DRM::GetKeySystem(KeySystem keySystem)
+{
+  for (const KeySystemInfo& info : KEY_SYSTEMS)
+  {
+    if (info.m_keySystem == keySystem)
+      return &info;
+  }
+  return nullptr;
+}
+
+const KeySystemInfo* DRM::ResolveKeySystem(std::string_view identifier)
+{
+  if (identifier.empty())
+    return nullptr;
+
+  for (const KeySystemInfo& info : KEY_SYSTEMS)
+  {
+    if (identifier == info.m_name || IsSameSystemId(identifier, info.m_uuid) ||
+        IsSameSystemId(identifier, info.m_altUuid))
+      return &info;
+  }
+  return nullptr;
+}
+
+const KeySystemInfo* DRM::ResolveKeySystem(const uint8_t* systemId)
+{
+  if (!systemId)
+    return nullptr;
+
+  uint8_t infoSystemId[16];
+  for (const KeySystemInfo& info : KEY_SYSTEMS)
+  {
+    if ((ParseSystemId(info.m_uuid, infoSystemId) &&
+         std::memcmp(systemId, infoSystemId, 16) == 0) ||
+        (ParseSystemId(info.m_altUuid, infoSystemId) &&
+         std::memcmp(systemId, infoSystemId, 16) == 0))
+      return &info;
+  }
+  return nullptr;
+}
+
+bool DRM::IsKeySystem(std::string_view identifier, KeySystem keySystem)
+{
+  const KeySystemInfo* info{ResolveKeySystem(identifier)};
+  return info && info->m_keySystem == keySystem;
+}
+
+bool DRM::IsSameKeySystem(std::string_view identifier1, std::string_view identifier2)
+{
+  if (identifier1.empty() || identifier2.empty())
+    return false;
+
+  const KeySystemInfo* info1{ResolveKeySystem(identifier1)};
+  const KeySystemInfo* info2{ResolveKeySystem(identifier2)};
+  if (info1 || info2)
+    return info1 == info2;
+
+  return STRING::CompareNoCase(identifier1, identifier2);
+}
+
+std::string DRM::GetUrn(KeySystem keySystem)
+{
+  const KeySystemInfo* info{GetKeySystem(keySystem)};
+  if (!info)
+    return "";
+
+  std::string urn{URN_UUID_PREFIX};
+  urn += info->m_uuid;
+  return urn;
+}
+
+bool DRM::ParseSystemId(std::string_view identifier, uint8_t* systemId)
+{
+  if (identifier.size() >= URN_UUID_PREFIX.size() &&
+      STRING::CompareNoCase(identifier.substr(0, URN_UUID_PREFIX.size()), URN_UUID_PREFIX))
+  {
+    identifier.remove_prefix(URN_UUID_PREFIX.size());
+  }
+
+  size_t index{0};
+  for (size_t pos{0}; pos < identifier.size(); ++pos)
+  {
+    const char ch{identifier[pos]};
+    if (ch == '-' || ch == '{' || ch == '}')
+      continue;
+    if (!std::isxdigit(static_cast<unsigned char>(ch)) || index >= 32)
+      return false;
+
+    const unsigned char nibble{STRING::ToHexNibble(ch)};
+    if (index % 2 == 0)
+      systemId[index / 2] = nibble << 4;
+    else
+      systemId[index / 2] |= nibble;
+    ++index;
+  }
+  return index == 32;
+}
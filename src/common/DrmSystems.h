@@ -0,0 +1,91 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*!
+ * \brief Registry of the DRM key systems known, used to resolve the key system
+ *        identifiers of the manifests (DASH ContentProtection schemeIdUri,
+ *        HLS EXT-X-KEY KEYFORMAT, Smooth ProtectionHeader SystemID), of the
+ *        PSSH system ids and of the license type property in a single place.
+ */
+namespace DRM
+{
+enum class KeySystem
+{
+  NONE,
+  WIDEVINE,
+  PLAYREADY,
+  WISEPLAY,
+  CLEARKEY,
+};
+
+struct KeySystemInfo
+{
+  KeySystem m_keySystem;
+  std::string_view m_name; // The key system name, as used by the "license_type" property
+  std::string_view m_uuid; // The system id as UUID string
+  std::string_view m_altUuid; // [OPT] Alternative system id used by manifests
+};
+
+/*!
+ * \brief Get the info of a key system.
+ * \return The key system info, otherwise nullptr for KeySystem::NONE
+ */
+const KeySystemInfo* GetKeySystem(KeySystem keySystem);
+
+/*!
+ * \brief Resolve a key system identifier.
+ * \param identifier The identifier, can be an URN (e.g. "urn:uuid:<UUID>"),
+ *                   a bare UUID or a key system name (e.g. "com.widevine.alpha")
+ * \return The key system info, otherwise nullptr if unknown
+ */
+const KeySystemInfo* ResolveKeySystem(std::string_view identifier);
+
+/*!
+ * \brief Resolve a key system from the binary system id of a PSSH.
+ * \param systemId The system id, 16 bytes
+ * \return The key system info, otherwise nullptr if unknown
+ */
+const KeySystemInfo* ResolveKeySystem(const uint8_t* systemId);
+
+/*!
+ * \brief Check if an identifier refers to the specified key system.
+ * \param identifier The identifier, as for ResolveKeySystem
+ * \param keySystem The key system
+ * \return True if the identifier refer to the key system, otherwise false
+ */
+bool IsKeySystem(std::string_view identifier, KeySystem keySystem);
+
+/*!
+ * \brief Check if two identifiers refers to the same key system, e.g. to match
+ *        a manifest key system with the one supported by the decrypter.
+ *        Identifiers of unknown key systems are compared as case insensitive URN.
+ * \return True if the identifiers refer to the same key system, otherwise false
+ */
+bool IsSameKeySystem(std::string_view identifier1, std::string_view identifier2);
+
+/*!
+ * \brief Get the URN of a key system.
+ * \return The URN (e.g. "urn:uuid:EDEF8BA9-..."), otherwise empty string for KeySystem::NONE
+ */
+std::string GetUrn(KeySystem keySystem);
+
+/*!
+ * \brief Parse the system id of an URN or UUID string.
+ * \param identifier The URN, or UUID, with or without dashes or braces
+ * \param systemId [OUT] The system id, 16 bytes
+ * \return True if success, otherwise false
+ */
+bool ParseSystemId(std::string_view identifier, uint8_t* systemId);
+
+} // namespace DRM
@@ -0,0 +1,93 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "InitSegmentCache.h"
+
+bool adaptive::CInitSegmentCache::Get(const PLAYLIST::CRepresentation* repr,
+                                      const std::string& key,
+                                      std::string& data)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+  {
+    if (it->m_repr == repr && it->m_key == key)
+    {
+      // Move to the front as most recently used
+      m_entries.splice(m_entries.begin(), m_entries, it);
+      data = m_entries.front().m_data;
+      return true;
+    }
+  }
+  return false;
+}
+
+void adaptive::CInitSegmentCache::Put(const PLAYLIST::CRepresentation* repr,
+                                      const std::string& key,
+                                      const std::string& data)
+{
+  // Dont fill the cache with data that would be discarded immediately
+  if (data.empty() || data.size() > m_maxSize)
+    return;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+  {
+    if (it->m_repr == repr && it->m_key == key)
+    {
+      m_size -= it->m_data.size();
+      m_entries.erase(it);
+      break;
+    }
+  }
+
+  m_entries.push_front({repr, key, data});
+  m_size += data.size();
+
+  while (m_size > m_maxSize)
+  {
+    m_size -= m_entries.back().m_data.size();
+    m_entries.pop_back();
+  }
+}
+
+void adaptive::CInitSegmentCache::Remove(const PLAYLIST::CRepresentation* repr)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  for (auto it = m_entries.begin(); it != m_entries.end();)
+  {
+    if (it->m_repr == repr)
+    {
+      m_size -= it->m_data.size();
+      it = m_entries.erase(it);
+    }
+    else
+      ++it;
+  }
+}
+
+void adaptive::CInitSegmentCache::Clear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_entries.clear();
+  m_size = 0;
+}
+
+size_t adaptive::CInitSegmentCache::GetSize() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_size;
+}
+
+size_t adaptive::CInitSegmentCache::GetCount() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_entries.size();
+}
@@ -0,0 +1,88 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "../test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+
+namespace PLAYLIST
+{
+// Forward
+class CRepresentation;
+} // namespace PLAYLIST
+
+namespace adaptive
+{
+/*!
+ * \brief Session cache of the downloaded initialization segments, allow to
+ *        reuse the same data for DRM discovery, stream (re)start, representation
+ *        switches and period changes without download it again.
+ *        The entries are identified by representation and download url
+ *        (byte range included), the least recently used are discarded
+ *        when the max size is exceeded. Thread safe.
+ */
+class ATTR_DLL_LOCAL CInitSegmentCache
+{
+public:
+  static constexpr size_t DEFAULT_MAX_SIZE = 8 * 1024 * 1024; // 8 MiB
+
+  CInitSegmentCache(size_t maxSize = DEFAULT_MAX_SIZE) : m_maxSize{maxSize} {}
+
+  /*!
+   * \brief Get the data of an initialization segment.
+   * \param repr The representation
+   * \param key The download url, followed by the byte range when used
+   * \param data [OUT] The segment data
+   * \return True if found, otherwise false
+   */
+  bool Get(const PLAYLIST::CRepresentation* repr, const std::string& key, std::string& data);
+
+  /*!
+   * \brief Add or replace the data of an initialization segment.
+   * \param repr The representation
+   * \param key The download url, followed by the byte range when used
+   * \param data The segment data
+   */
+  void Put(const PLAYLIST::CRepresentation* repr, const std::string& key, const std::string& data);
+
+  /*!
+   * \brief Remove all entries of a representation, to be called when the
+   *        representation is deleted.
+   */
+  void Remove(const PLAYLIST::CRepresentation* repr);
+
+  void Clear();
+
+  size_t GetSize() const;
+  size_t GetCount() const;
+
+private:
+  struct Entry
+  {
+    const PLAYLIST::CRepresentation* m_repr;
+    std::string m_key;
+    std::string m_data;
+  };
+
+  // Most recently used first
+  std::list<Entry> m_entries;
+  size_t m_size{0};
+  size_t m_maxSize;
+  mutable std::mutex m_mutex;
+};
+
+} // namespace adaptive
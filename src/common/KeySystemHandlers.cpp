@@ -0,0 +1,321 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "KeySystemHandlers.h"
+
+#include "AdaptiveDecrypter.h"
+#include "../utils/Base64Utils.h"
+#include "../utils/PropertiesUtils.h"
+#include "../utils/Utils.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <bento4/Ap4.h>
+
+using namespace DRM;
+using namespace PLAYLIST;
+using namespace UTILS;
+
+namespace
+{
+constexpr size_t PSSH_HEADER_SIZE = 28; // Size, type, version, flags, system id
+
+// Get the KIDs and the data of a PSSH box
+bool ParsePsshBox(std::string_view pssh, std::vector<std::string_view>& keyIds,
+                  std::string_view& data)
+{
+  if (pssh.size() < PSSH_HEADER_SIZE + 4 || pssh.substr(4, 4) != "pssh")
+    return false;
+
+  const AP4_UI08* box{reinterpret_cast<const AP4_UI08*>(pssh.data())};
+  size_t pos{PSSH_HEADER_SIZE};
+  if (box[8] > 0)
+  {
+    const AP4_UI32 count{AP4_BytesToUInt32BE(box + pos)};
+    pos += 4;
+    if (count > (pssh.size() - pos) / 16)
+      return false;
+    for (AP4_UI32 i = 0; i < count; ++i, pos += 16)
+      keyIds.emplace_back(pssh.substr(pos, 16));
+  }
+  if (pssh.size() < pos + 4)
+    return false;
+
+  const AP4_UI32 dataSize{AP4_BytesToUInt32BE(box + pos)};
+  pos += 4;
+  if (dataSize > pssh.size() - pos)
+    return false;
+
+  data = pssh.substr(pos, dataSize);
+  return true;
+}
+
+bool ReadVarint(std::string_view data, size_t& pos, uint64_t& value)
+{
+  value = 0;
+  for (unsigned int shift = 0; pos < data.size() && shift < 64; shift += 7)
+  {
+    const uint8_t byte{static_cast<uint8_t>(data[pos++])};
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+class CWidevineHandler : public IKeySystemHandler
+{
+public:
+  KeySystem GetKeySystem() const override { return KeySystem::WIDEVINE; }
+  int GetCost() const override { return 1; }
+
+  std::string GetDefaultKid(std::string_view pssh) const override
+  {
+    std::string keyId{IKeySystemHandler::GetDefaultKid(pssh)};
+    std::vector<std::string_view> keyIds;
+    std::string_view data;
+    if (!keyId.empty() || !ParsePsshBox(pssh, keyIds, data))
+      return keyId;
+
+    // The "key_id" field (2) of the WidevinePsshData protobuf message
+    size_t pos{0};
+    uint64_t key;
+    while (ReadVarint(data, pos, key))
+    {
+      uint64_t value;
+      if ((key & 0x07) == 0)
+      {
+        if (!ReadVarint(data, pos, value))
+          break;
+      }
+      else if ((key & 0x07) == 2)
+      {
+        if (!ReadVarint(data, pos, value) || value > data.size() - pos)
+          break;
+        if ((key >> 3) == 2 && value == 16)
+          return std::string(data.substr(pos, 16));
+        pos += static_cast<size_t>(value);
+      }
+      else
+        break;
+    }
+    return "";
+  }
+
+  bool GetInitData(const CPeriod::PSSHSet& psshSet,
+                   const PROPERTIES::KodiProperties& kodiProps,
+                   std::vector<uint8_t>& initData,
+                   const char*& optionalKeyParameter) const override
+  {
+    if (kodiProps.m_manifestType != PROPERTIES::ManifestType::ISM)
+      return IKeySystemHandler::GetInitData(psshSet, kodiProps, initData, optionalKeyParameter);
+
+    // The Smooth Streaming manifests have the PlayReady header only
+    optionalKeyParameter = nullptr;
+    std::string licenseData{kodiProps.m_licenseData};
+    if (licenseData.empty())
+      licenseData = "e0tJRH0="; // {KID}
+    return CreateISMlicense(psshSet.defaultKID_, licenseData, initData);
+  }
+
+protected:
+  std::string_view GetLicenseRequestHeaders() const override
+  {
+    return "Content-Type=application%2Foctet-stream";
+  }
+};
+
+class CPlayReadyHandler : public IKeySystemHandler
+{
+public:
+  KeySystem GetKeySystem() const override { return KeySystem::PLAYREADY; }
+  // The SOAP license request and response are the biggest ones
+  int GetCost() const override { return 3; }
+
+  bool GetInitData(const CPeriod::PSSHSet& psshSet,
+                   const PROPERTIES::KodiProperties& kodiProps,
+                   std::vector<uint8_t>& initData,
+                   const char*& optionalKeyParameter) const override
+  {
+    if (kodiProps.m_manifestType != PROPERTIES::ManifestType::ISM)
+      return IKeySystemHandler::GetInitData(psshSet, kodiProps, initData, optionalKeyParameter);
+
+    // The Smooth Streaming ProtectionHeader is provided as is
+    initData.assign(psshSet.pssh_.begin(), psshSet.pssh_.end());
+    optionalKeyParameter =
+        kodiProps.m_licenseData.empty() ? nullptr : kodiProps.m_licenseData.c_str();
+    return true;
+  }
+
+protected:
+  std::string_view GetLicenseRequestHeaders() const override
+  {
+    return "Content-Type=text%2Fxml&SOAPAction=http%3A%2F%2Fschemas.microsoft.com%2FDRM%2F2007%"
+           "2F03%2Fprotocols%2FAcquireLicense";
+  }
+};
+
+class CWisePlayHandler : public IKeySystemHandler
+{
+public:
+  KeySystem GetKeySystem() const override { return KeySystem::WISEPLAY; }
+  int GetCost() const override { return 2; }
+
+protected:
+  std::string_view GetLicenseRequestHeaders() const override
+  {
+    return "Content-Type=application%2Fjson";
+  }
+};
+
+class CClearKeyHandler : public IKeySystemHandler
+{
+public:
+  KeySystem GetKeySystem() const override { return KeySystem::CLEARKEY; }
+  // The keys are in the license, the samples are decrypted in software
+  int GetCost() const override { return 0; }
+
+  void GetCapabilities(SSD::SSD_DECRYPTER& decrypter,
+                       Adaptive_CencSingleSampleDecrypter* ssd,
+                       const uint8_t* keyId,
+                       uint32_t media,
+                       SSD::SSD_DECRYPTER::SSD_CAPS& caps) const override
+  {
+    IKeySystemHandler::GetCapabilities(decrypter, ssd, keyId, media, caps);
+    // No secure path, the keys are not protected by the CDM
+    caps.flags &= ~(SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SECURE_PATH |
+                    SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SECURE_DECODER);
+  }
+
+protected:
+  std::string_view GetLicenseRequestHeaders() const override
+  {
+    return "Content-Type=application%2Fjson";
+  }
+};
+
+const CWidevineHandler WIDEVINE_HANDLER;
+const CPlayReadyHandler PLAYREADY_HANDLER;
+const CWisePlayHandler WISEPLAY_HANDLER;
+const CClearKeyHandler CLEARKEY_HANDLER;
+
+const IKeySystemHandler* const HANDLERS[]{&WIDEVINE_HANDLER, &PLAYREADY_HANDLER,
+                                          &WISEPLAY_HANDLER, &CLEARKEY_HANDLER};
+
+int GetCost(std::string_view identifier)
+{
+  const IKeySystemHandler* handler{GetHandler(identifier)};
+  return handler ? handler->GetCost() : std::numeric_limits<int>::max();
+}
+} // unnamed namespace
+
+const KeySystemInfo& IKeySystemHandler::GetInfo() const
+{
+  return *DRM::GetKeySystem(GetKeySystem());
+}
+
+std::string IKeySystemHandler::GetDefaultKid(std::string_view pssh) const
+{
+  std::vector<std::string_view> keyIds;
+  std::string_view data;
+  if (ParsePsshBox(pssh, keyIds, data) && !keyIds.empty())
+    return std::string(keyIds.front());
+  return "";
+}
+
+bool IKeySystemHandler::GetInitData(const CPeriod::PSSHSet& psshSet,
+                                    const PROPERTIES::KodiProperties& kodiProps,
+                                    std::vector<uint8_t>& initData,
+                                    const char*& optionalKeyParameter) const
+{
+  optionalKeyParameter = nullptr;
+  const std::string decPssh{BASE64::Decode(psshSet.pssh_)};
+  initData.assign(decPssh.begin(), decPssh.end());
+  return !initData.empty();
+}
+
+std::string IKeySystemHandler::GetLicenseRequestTemplate(std::string_view licenseUrl) const
+{
+  std::string licenseTemplate{licenseUrl};
+  if (!licenseTemplate.empty() && licenseTemplate.find('|') == std::string::npos)
+  {
+    licenseTemplate += '|';
+    licenseTemplate += GetLicenseRequestHeaders();
+    licenseTemplate += "|R{SSM}|";
+  }
+  return licenseTemplate;
+}
+
+void IKeySystemHandler::GetCapabilities(SSD::SSD_DECRYPTER& decrypter,
+                                        Adaptive_CencSingleSampleDecrypter* ssd,
+                                        const uint8_t* keyId,
+                                        uint32_t media,
+                                        SSD::SSD_DECRYPTER::SSD_CAPS& caps) const
+{
+  decrypter.GetCapabilities(ssd, keyId, media, caps);
+}
+
+Adaptive_CencSingleSampleDecrypter* IKeySystemHandler::CreateDecrypter(
+    SSD::SSD_DECRYPTER& decrypter,
+    AP4_DataBuffer& initData,
+    const char* optionalKeyParameter,
+    std::string_view defaultKid,
+    bool isLicenseDeferred,
+    CryptoMode cryptoMode) const
+{
+  return decrypter.CreateSingleSampleDecrypter(
+      initData, optionalKeyParameter, defaultKid, isLicenseDeferred,
+      cryptoMode == CryptoMode::NONE ? CryptoMode::AES_CTR : cryptoMode);
+}
+
+const IKeySystemHandler* DRM::GetHandler(KeySystem keySystem)
+{
+  for (const IKeySystemHandler* handler : HANDLERS)
+  {
+    if (handler->GetKeySystem() == keySystem)
+      return handler;
+  }
+  return nullptr;
+}
+
+const IKeySystemHandler* DRM::GetHandler(std::string_view identifier)
+{
+  const KeySystemInfo* info{ResolveKeySystem(identifier)};
+  return info ? GetHandler(info->m_keySystem) : nullptr;
+}
+
+std::string_view DRM::SelectKeySystem(const std::vector<std::string_view>& offered,
+                                      const std::vector<std::string>& supported)
+{
+  std::string_view selected;
+  int selectedCost{0};
+  for (std::string_view identifier : offered)
+  {
+    const bool isSupported{
+        std::any_of(supported.begin(), supported.end(), [identifier](const std::string& other)
+                    { return IsSameKeySystem(identifier, other); })};
+    if (!isSupported)
+      continue;
+
+    const int cost{GetCost(identifier)};
+    if (selected.empty() || cost < selectedCost)
+    {
+      selected = identifier;
+      selectedCost = cost;
+    }
+  }
+  return selected;
+}
+
+void DRM::SortKeySystems(std::vector<std::string>& keySystems)
+{
+  std::stable_sort(keySystems.begin(), keySystems.end(),
+                   [](const std::string& left, const std::string& right)
+                   { return GetCost(left) < GetCost(right); });
+}
@@ -0,0 +1,157 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include "../SSD_dll.h"
+#include "DrmSystems.h"
+#include "Period.h"
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "../test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Adaptive_CencSingleSampleDecrypter;
+class AP4_DataBuffer;
+
+namespace UTILS
+{
+namespace PROPERTIES
+{
+struct KodiProperties;
+} // namespace PROPERTIES
+} // namespace UTILS
+
+namespace DRM
+{
+/*!
+ * \brief Handler of a key system, it owns what differs between the key
+ *        systems: the parsing of the PSSH data, the default license request,
+ *        the capability queries and the creation of the decrypters.
+ *        The handlers are registered by key system, see GetHandler.
+ */
+class ATTR_DLL_LOCAL IKeySystemHandler
+{
+public:
+  virtual ~IKeySystemHandler() = default;
+
+  virtual KeySystem GetKeySystem() const = 0;
+
+  /*!
+   * \brief Get the info of the key system of the handler.
+   */
+  const KeySystemInfo& GetInfo() const;
+
+  /*!
+   * \brief Get the cost of the key system, as the license request / response
+   *        sizes and round trips and the decrypt overhead of the CDM. When a
+   *        stream is protected with several supported key systems the cheapest
+   *        one is used.
+   * \return The cost, lower is cheaper
+   */
+  virtual int GetCost() const = 0;
+
+  /*!
+   * \brief Get the default KID from the PSSH data.
+   * \param pssh The PSSH box
+   * \return The default KID (16 bytes), otherwise empty string if not found
+   */
+  virtual std::string GetDefaultKid(std::string_view pssh) const;
+
+  /*!
+   * \brief Get the init data of the CDM session of a PSSH set provided by the manifest.
+   * \param psshSet The PSSH set
+   * \param kodiProps The Kodi properties
+   * \param initData [OUT] The init data
+   * \param optionalKeyParameter [OUT] The optional key parameter of the decrypter
+   * \return True if success, otherwise false
+   */
+  virtual bool GetInitData(const PLAYLIST::CPeriod::PSSHSet& psshSet,
+                           const UTILS::PROPERTIES::KodiProperties& kodiProps,
+                           std::vector<uint8_t>& initData,
+                           const char*& optionalKeyParameter) const;
+
+  /*!
+   * \brief Get the license request template of a license URL, a bare URL is
+   *        completed with the default headers and body of the key system.
+   * \param licenseUrl The license URL, or the license request template
+   * \return The license request template
+   */
+  std::string GetLicenseRequestTemplate(std::string_view licenseUrl) const;
+
+  /*!
+   * \brief Get the capabilities of a decrypter for a KID.
+   */
+  virtual void GetCapabilities(SSD::SSD_DECRYPTER& decrypter,
+                               Adaptive_CencSingleSampleDecrypter* ssd,
+                               const uint8_t* keyId,
+                               uint32_t media,
+                               SSD::SSD_DECRYPTER::SSD_CAPS& caps) const;
+
+  /*!
+   * \brief Create the decrypter of a CDM session.
+   * \param decrypter The DRM decrypter, opened with the key system
+   * \param initData The init data of the CDM session
+   * \param optionalKeyParameter The optional key parameter, can be nullptr
+   * \param defaultKid The default KID, can be empty
+   * \param isLicenseDeferred True to create the session without the license request
+   * \param cryptoMode The crypto mode of the samples, NONE for the default one
+   * \return The decrypter, otherwise nullptr on failure
+   */
+  virtual Adaptive_CencSingleSampleDecrypter* CreateDecrypter(SSD::SSD_DECRYPTER& decrypter,
+                                                              AP4_DataBuffer& initData,
+                                                              const char* optionalKeyParameter,
+                                                              std::string_view defaultKid,
+                                                              bool isLicenseDeferred,
+                                                              CryptoMode cryptoMode) const;
+
+protected:
+  /*!
+   * \brief Get the default HTTP headers of the license requests, URL encoded.
+   */
+  virtual std::string_view GetLicenseRequestHeaders() const = 0;
+};
+
+/*!
+ * \brief Get the handler of a key system.
+ * \return The handler, otherwise nullptr for KeySystem::NONE
+ */
+const IKeySystemHandler* GetHandler(KeySystem keySystem);
+
+/*!
+ * \brief Get the handler of a key system identifier.
+ * \param identifier The identifier, as for ResolveKeySystem
+ * \return The handler, otherwise nullptr if unknown
+ */
+const IKeySystemHandler* GetHandler(std::string_view identifier);
+
+/*!
+ * \brief Select the key system to use for a stream.
+ * \param offered The key system identifiers that protect the stream, e.g. the
+ *                DASH ContentProtection schemeIdUri or the HLS KEYFORMAT
+ * \param supported The key system identifiers supported by the decrypter
+ * \return The offered identifier of the cheapest supported key system, the
+ *         key systems unknown to the registry are the most expensive ones,
+ *         otherwise empty string if none is supported
+ */
+std::string_view SelectKeySystem(const std::vector<std::string_view>& offered,
+                                 const std::vector<std::string>& supported);
+
+/*!
+ * \brief Sort the key system identifiers from the cheapest key system.
+ */
+void SortKeySystems(std::vector<std::string>& keySystems);
+
+} // namespace DRM
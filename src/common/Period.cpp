@@ -92,3 +92,8 @@ void PLAYLIST::CPeriod::AddAdaptationSet(std::unique_ptr<CAdaptationSet>& adapta
 {
   m_adaptationSets.push_back(std::move(adaptationSet));
 }
+
+void PLAYLIST::CPeriod::AddThumbnailTrack(std::unique_ptr<CThumbnailTrack>& track)
+{
+  m_thumbnailTracks.push_back(std::move(track));
+}
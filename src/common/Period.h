@@ -12,6 +12,7 @@
 #include "CommonSegAttribs.h"
 #include "SegTemplate.h"
 #include "SegmentList.h"
+#include "ThumbnailTrack.h"
 #include "../utils/CryptoUtils.h"
 
 #ifdef INPUTSTREAM_TEST_BUILD
@@ -85,6 +86,9 @@ public:
   void AddAdaptationSet(std::unique_ptr<CAdaptationSet>& adaptationSet);
   std::vector<std::unique_ptr<CAdaptationSet>>& GetAdaptationSets() { return m_adaptationSets; }
 
+  void AddThumbnailTrack(std::unique_ptr<CThumbnailTrack>& track);
+  std::vector<std::unique_ptr<CThumbnailTrack>>& GetThumbnailTracks() { return m_thumbnailTracks; }
+
   struct ATTR_DLL_LOCAL PSSHSet
   {
     static constexpr uint32_t MEDIA_UNSPECIFIED = 0;
@@ -95,7 +99,9 @@ public:
     bool operator==(const PSSHSet& other) const
     {
       return m_usageCount == 0 || (media_ == other.media_ && pssh_ == other.pssh_ &&
-                                   defaultKID_ == other.defaultKID_ && iv == other.iv);
+                                   defaultKID_ == other.defaultKID_ && iv == other.iv &&
+                                   m_cryptoMode == other.m_cryptoMode &&
+                                   m_keySystem == other.m_keySystem);
     }
 
     //! @todo: create getter/setters
@@ -106,13 +112,18 @@ public:
     // Specify how many times the same PSSH is used between AdaptationSets or Representations
     uint32_t m_usageCount{0};
     CryptoMode m_cryptoMode{CryptoMode::NONE};
+    std::string m_keySystem; // The key system identifier selected by the manifest, if any
     CAdaptationSet* adaptation_set_{nullptr};
   };
 
   uint16_t InsertPSSHSet(PSSHSet* pssh);
   void InsertPSSHSet(uint16_t pssh_set) { m_psshSets[pssh_set].m_usageCount++; }
   void RemovePSSHSet(uint16_t pssh_set);
-  void DecrasePSSHSetUsageCount(uint16_t pssh_set) { m_psshSets[pssh_set].m_usageCount--; }
+  void DecrasePSSHSetUsageCount(uint16_t pssh_set)
+  {
+    if (m_psshSets[pssh_set].m_usageCount > 0)
+      m_psshSets[pssh_set].m_usageCount--;
+  }
   std::vector<PSSHSet>& GetPSSHSets() { return m_psshSets; }
 
   // Make use of PLAYLIST::StreamType flags
@@ -120,6 +131,7 @@ public:
 
 protected:
   std::vector<std::unique_ptr<CAdaptationSet>> m_adaptationSets;
+  std::vector<std::unique_ptr<CThumbnailTrack>> m_thumbnailTracks;
   
   std::vector<PSSHSet> m_psshSets;
 
@@ -73,6 +73,8 @@ void PLAYLIST::CRepresentation::CopyHLSData(const CRepresentation* other)
 
   m_hasInitialization = other->m_hasInitialization;
   m_isIncludedStream = other->m_isIncludedStream;
+  m_includedStreamIndex = other->m_includedStreamIndex;
+  m_includedStreamCount = other->m_includedStreamCount;
   m_hasSegmentsUrl = other->m_hasSegmentsUrl;
   m_isEnabled = other->m_isEnabled;
   m_isWaitForSegment = other->m_isWaitForSegment;
@@ -141,10 +141,28 @@ public:
   bool IsWaitForSegment() const { return m_isWaitForSegment; }
   void SetIsWaitForSegment(bool isWaitForSegment) { m_isWaitForSegment = isWaitForSegment; }
 
+  // Define if it can be selected, the HDCP limits of the license can be known only while playing
+  bool IsHdcpCompliant() const { return m_isHdcpCompliant; }
+  void SetIsHdcpCompliant(bool isHdcpCompliant) { m_isHdcpCompliant = isHdcpCompliant; }
+
   // Define if it is a dummy representation for audio stream, that is embedded on the video stream
   bool IsIncludedStream() const { return m_isIncludedStream; }
   void SetIsIncludedStream(bool isIncludedStream) { m_isIncludedStream = isIncludedStream; }
 
+  /*!
+   * \brief The position of the elementary stream, among those of the same type
+   *        multiplexed in the main stream, that is demuxed for an included stream.
+   */
+  size_t GetIncludedStreamIndex() const { return m_includedStreamIndex; }
+  void SetIncludedStreamIndex(size_t index) { m_includedStreamIndex = index; }
+
+  /*!
+   * \brief The number of included streams of the same type that are expected
+   *        multiplexed in the main stream, 0 if unknown.
+   */
+  size_t GetIncludedStreamCount() const { return m_includedStreamCount; }
+  void SetIncludedStreamCount(size_t count) { m_includedStreamCount = count; }
+
   void CopyHLSData(const CRepresentation* other);
 
   static bool CompareBandwidth(std::unique_ptr<CRepresentation>& left,
@@ -297,8 +315,11 @@ protected:
   bool m_isPrepared{false};
   bool m_isEnabled{false};
   bool m_isWaitForSegment{false};
+  bool m_isHdcpCompliant{true};
 
   bool m_isIncludedStream{false};
+  size_t m_includedStreamIndex{0};
+  size_t m_includedStreamCount{0};
 };
 
 } // namespace PLAYLIST
@@ -0,0 +1,242 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "SampleAesDecrypter.h"
+
+#include "../utils/log.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+constexpr size_t CIPHER_BLOCK_SIZE = 16;
+// NAL units with a size up to this value are not encrypted
+constexpr size_t NAL_MIN_ENCRYPTED_SIZE = 48;
+// NAL unit type byte + 31 bytes
+constexpr size_t NAL_CLEAR_LEADER_SIZE = 32;
+// After each encrypted block, 9 blocks are left unencrypted
+constexpr size_t NAL_CLEAR_BLOCKS_SIZE = 9 * CIPHER_BLOCK_SIZE;
+constexpr size_t AUDIO_CLEAR_LEADER_SIZE = 16;
+
+// AC-3 bit rates in kbit/s, indexed by frmsizecod / 2
+constexpr uint32_t AC3_BITRATES[19]{32,  40,  48,  56,  64,  80,  96,  112, 128, 160,
+                                    192, 224, 256, 320, 384, 448, 512, 576, 640};
+
+// Find the position of the next start code (0x000001), otherwise return the size
+size_t FindStartCode(const uint8_t* data, size_t size, size_t pos)
+{
+  for (; pos + 3 <= size; ++pos)
+  {
+    if (data[pos] == 0 && data[pos + 1] == 0 && data[pos + 2] == 1)
+      return pos;
+  }
+  return size;
+}
+} // unnamed namespace
+
+CSampleAesDecrypter::~CSampleAesDecrypter()
+{
+  delete m_cipher;
+}
+
+bool CSampleAesDecrypter::SetKey(std::string_view key, const uint8_t* iv)
+{
+  if (key.size() != CIPHER_BLOCK_SIZE)
+  {
+    delete m_cipher;
+    m_cipher = nullptr;
+    m_key.clear();
+    return false;
+  }
+
+  std::memcpy(m_iv, iv, CIPHER_BLOCK_SIZE);
+
+  if (m_cipher && key == m_key)
+    return true;
+
+  delete m_cipher;
+  m_cipher = nullptr;
+  m_key = key;
+
+  if (AP4_FAILED(AP4_DefaultBlockCipherFactory::Instance.CreateCipher(
+          AP4_BlockCipher::AES_128, AP4_BlockCipher::DECRYPT, AP4_BlockCipher::CBC, nullptr,
+          reinterpret_cast<const AP4_UI08*>(m_key.data()), CIPHER_BLOCK_SIZE, m_cipher)))
+  {
+    LOG::LogF(LOGERROR, "Cannot create the AES-128 CBC cipher");
+    m_cipher = nullptr;
+    m_key.clear();
+    return false;
+  }
+  return true;
+}
+
+bool CSampleAesDecrypter::DecryptSample(Codec codec, uint8_t* data, size_t& size)
+{
+  if (!m_cipher)
+    return false;
+
+  if (codec == Codec::AAC)
+    return DecryptAdtsFrames(data, size);
+  if (codec == Codec::AC3)
+    return DecryptAc3Frames(data, size);
+
+  // H.264 access unit in Annex B format, the data is moved backwards
+  // when the emulation prevention bytes are removed
+  size_t pos{FindStartCode(data, size, 0)};
+  size_t writePos{pos};
+
+  while (pos < size)
+  {
+    const size_t nalPos{pos + 3};
+    const size_t nextPos{FindStartCode(data, size, nalPos)};
+    size_t nalEnd{nextPos};
+    // The zero byte of a 4 bytes start code is not part of the NAL unit
+    if (nextPos < size && nalEnd > nalPos && data[nalEnd - 1] == 0)
+      nalEnd--;
+
+    std::memmove(data + writePos, data + pos, nalPos - pos);
+    writePos += nalPos - pos;
+
+    size_t nalSize{nalEnd - nalPos};
+    std::memmove(data + writePos, data + nalPos, nalSize);
+    const uint8_t nalType{static_cast<uint8_t>(nalSize > 0 ? data[writePos] & 0x1F : 0)};
+    // Only the coded slices are encrypted (non-IDR and IDR)
+    if (nalSize > NAL_MIN_ENCRYPTED_SIZE && (nalType == 1 || nalType == 5))
+      nalSize = DecryptNalUnit(data + writePos, nalSize);
+    writePos += nalSize;
+
+    std::memmove(data + writePos, data + nalEnd, nextPos - nalEnd);
+    writePos += nextPos - nalEnd;
+    pos = nextPos;
+  }
+
+  size = writePos;
+  return true;
+}
+
+size_t CSampleAesDecrypter::DecryptNalUnit(uint8_t* nal, size_t size)
+{
+  // Remove the emulation prevention bytes, inserted after the encryption
+  size_t newSize{0};
+  size_t zeroCount{0};
+  for (size_t i{0}; i < size; ++i)
+  {
+    if (zeroCount >= 2 && nal[i] == 0x03)
+    {
+      zeroCount = 0;
+      continue;
+    }
+    zeroCount = nal[i] == 0 ? zeroCount + 1 : 0;
+    nal[newSize++] = nal[i];
+  }
+
+  uint8_t iv[CIPHER_BLOCK_SIZE];
+  std::memcpy(iv, m_iv, CIPHER_BLOCK_SIZE);
+
+  uint8_t* data{nal + NAL_CLEAR_LEADER_SIZE};
+  size_t remaining{newSize > NAL_CLEAR_LEADER_SIZE ? newSize - NAL_CLEAR_LEADER_SIZE : 0};
+  while (remaining > 0)
+  {
+    if (remaining > CIPHER_BLOCK_SIZE)
+    {
+      DecryptBlocks(data, 1, iv);
+      data += CIPHER_BLOCK_SIZE;
+      remaining -= CIPHER_BLOCK_SIZE;
+    }
+    const size_t clearSize{std::min(NAL_CLEAR_BLOCKS_SIZE, remaining)};
+    data += clearSize;
+    remaining -= clearSize;
+  }
+  return newSize;
+}
+
+bool CSampleAesDecrypter::DecryptAdtsFrames(uint8_t* data, size_t size)
+{
+  size_t pos{0};
+  while (pos + 7 <= size)
+  {
+    const uint8_t* header{data + pos};
+    if (header[0] != 0xFF || (header[1] & 0xF6) != 0xF0)
+      return false;
+
+    const size_t headerSize{(header[1] & 0x01) ? 7U : 9U}; // Without or with CRC
+    const size_t frameSize{static_cast<size_t>(((header[3] & 0x03) << 11) | (header[4] << 3) |
+                                               (header[5] >> 5))};
+    if (frameSize < headerSize || pos + frameSize > size)
+      return false;
+
+    const size_t leaderSize{headerSize + AUDIO_CLEAR_LEADER_SIZE};
+    if (frameSize > leaderSize)
+    {
+      uint8_t iv[CIPHER_BLOCK_SIZE];
+      std::memcpy(iv, m_iv, CIPHER_BLOCK_SIZE);
+      DecryptBlocks(data + pos + leaderSize, (frameSize - leaderSize) / CIPHER_BLOCK_SIZE, iv);
+    }
+    pos += frameSize;
+  }
+  return true;
+}
+
+bool CSampleAesDecrypter::DecryptAc3Frames(uint8_t* data, size_t size)
+{
+  size_t pos{0};
+  while (pos + 6 <= size)
+  {
+    const uint8_t* header{data + pos};
+    if (header[0] != 0x0B || header[1] != 0x77)
+      return false;
+
+    size_t frameSize{0};
+    const uint8_t bsid{static_cast<uint8_t>(header[5] >> 3)};
+    if (bsid <= 10) // AC-3
+    {
+      const uint8_t fscod{static_cast<uint8_t>(header[4] >> 6)};
+      const uint8_t frmsizecod{static_cast<uint8_t>(header[4] & 0x3F)};
+      if (fscod == 3 || frmsizecod > 37)
+        return false;
+
+      const uint32_t bitrate{AC3_BITRATES[frmsizecod >> 1]};
+      // Frame size in 16 bit words
+      if (fscod == 0) // 48 kHz
+        frameSize = bitrate * 2;
+      else if (fscod == 1) // 44.1 kHz
+        frameSize = bitrate * 320 / 147 + (frmsizecod & 1);
+      else // 32 kHz
+        frameSize = bitrate * 3;
+      frameSize *= 2;
+    }
+    else // E-AC-3
+      frameSize = ((((header[2] & 0x07) << 8) | header[3]) + 1) * 2;
+
+    if (pos + frameSize > size)
+      return false;
+
+    if (frameSize > AUDIO_CLEAR_LEADER_SIZE)
+    {
+      uint8_t iv[CIPHER_BLOCK_SIZE];
+      std::memcpy(iv, m_iv, CIPHER_BLOCK_SIZE);
+      DecryptBlocks(data + pos + AUDIO_CLEAR_LEADER_SIZE,
+                    (frameSize - AUDIO_CLEAR_LEADER_SIZE) / CIPHER_BLOCK_SIZE, iv);
+    }
+    pos += frameSize;
+  }
+  return true;
+}
+
+void CSampleAesDecrypter::DecryptBlocks(uint8_t* data, size_t blocks, uint8_t* iv)
+{
+  // The cipher cannot process in place, the CBC chain is kept in the IV
+  uint8_t cipherBlock[CIPHER_BLOCK_SIZE];
+  for (size_t i{0}; i < blocks; ++i, data += CIPHER_BLOCK_SIZE)
+  {
+    std::memcpy(cipherBlock, data, CIPHER_BLOCK_SIZE);
+    m_cipher->Process(cipherBlock, CIPHER_BLOCK_SIZE, data, iv);
+    std::memcpy(iv, cipherBlock, CIPHER_BLOCK_SIZE);
+  }
+}
@@ -0,0 +1,80 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "../test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <bento4/Ap4.h>
+
+/*!
+ * \brief Decrypter of the samples encrypted with HLS SAMPLE-AES (MPEG-2 stream
+ *        encryption format), used by MPEG-TS and packed audio segments.
+ *        Only the payload of the samples is encrypted with AES-128 CBC,
+ *        the headers are left unencrypted so the stream can be demuxed:
+ *        - H.264: the slice NAL units larger than 48 bytes, after a 32 bytes clear
+ *          leader one 16 bytes block on ten is encrypted, emulation prevention
+ *          bytes are inserted after the encryption
+ *        - AAC (ADTS) / AC-3 / E-AC-3: each frame after a 16 bytes clear leader
+ *        The IV is reset on each NAL unit or audio frame.
+ */
+class ATTR_DLL_LOCAL CSampleAesDecrypter
+{
+public:
+  enum class Codec
+  {
+    H264,
+    AAC, // ADTS frames
+    AC3, // AC-3 or E-AC-3 sync frames
+  };
+
+  CSampleAesDecrypter() = default;
+  ~CSampleAesDecrypter();
+
+  CSampleAesDecrypter(const CSampleAesDecrypter&) = delete;
+  CSampleAesDecrypter& operator=(const CSampleAesDecrypter&) = delete;
+
+  /*!
+   * \brief Set the key and the IV, the AES context is created again only when the key change.
+   * \param key The AES-128 key, 16 bytes
+   * \param iv The IV, 16 bytes
+   * \return True if success, otherwise false
+   */
+  bool SetKey(std::string_view key, const uint8_t* iv);
+
+  bool IsKeySet() const { return m_cipher != nullptr; }
+
+  /*!
+   * \brief Decrypt in place a sample.
+   * \param codec The codec of the sample
+   * \param data The sample data
+   * \param size [IN/OUT] The sample size, for H.264 can be reduced
+   *                      due to the removal of emulation prevention bytes
+   * \return True if success, otherwise false
+   */
+  bool DecryptSample(Codec codec, uint8_t* data, size_t& size);
+
+private:
+  size_t DecryptNalUnit(uint8_t* nal, size_t size);
+  bool DecryptAdtsFrames(uint8_t* data, size_t size);
+  bool DecryptAc3Frames(uint8_t* data, size_t size);
+  void DecryptBlocks(uint8_t* data, size_t blocks, uint8_t* iv);
+
+  AP4_BlockCipher* m_cipher{nullptr};
+  std::string m_key;
+  uint8_t m_iv[16]{};
+};
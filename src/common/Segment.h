@@ -41,6 +41,7 @@ public:
   uint64_t startPTS_ = NO_PTS_VALUE;
   uint64_t m_duration = 0; // If available gives the media duration of a segment (depends on type of stream e.g. HLS)
   uint16_t pssh_set_ = PSSHSET_POS_DEFAULT;
+  bool m_isGap = false; // The segment has no media data (e.g. HLS EXT-X-GAP), to be skipped
 
   void Copy(const CSegment* src);
 };
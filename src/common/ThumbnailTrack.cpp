@@ -0,0 +1,127 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "ThumbnailTrack.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace PLAYLIST;
+
+namespace
+{
+// Replace a template placeholder, e.g. $Number$ or with width format $Number%05d$
+void ReplacePlaceholder(std::string& url, std::string_view name, uint64_t value)
+{
+  const std::string placeholder{"$" + std::string(name)};
+  size_t pos{url.find(placeholder)};
+
+  while (pos != std::string::npos)
+  {
+    const size_t fmtPos{pos + placeholder.size()};
+    const size_t endPos{url.find('$', fmtPos)};
+    if (endPos == std::string::npos)
+      return;
+
+    std::string valueStr{std::to_string(value)};
+    const std::string_view format{std::string_view(url).substr(fmtPos, endPos - fmtPos)};
+    if (format.size() > 3 && format.substr(0, 2) == "%0" && format.back() == 'd')
+    {
+      const size_t width{static_cast<size_t>(std::atoi(std::string(format.substr(2)).c_str()))};
+      if (valueStr.size() < width)
+        valueStr.insert(0, width - valueStr.size(), '0');
+    }
+
+    url.replace(pos, endPos - pos + 1, valueStr);
+    pos = url.find(placeholder, pos + valueStr.size());
+  }
+}
+} // unnamed namespace
+
+void CThumbnailTrack::SetLayout(uint32_t columns, uint32_t rows)
+{
+  m_columns = std::max(columns, 1U);
+  m_rows = std::max(rows, 1U);
+}
+
+void CThumbnailTrack::SetThumbnailSize(int width, int height)
+{
+  m_thumbWidth = width;
+  m_thumbHeight = height;
+}
+
+void CThumbnailTrack::SetTemplate(std::string_view mediaUrl,
+                                  uint32_t timescale,
+                                  uint64_t startNumber,
+                                  uint64_t duration)
+{
+  m_templateUrl = mediaUrl;
+  m_templateTimescale = std::max(timescale, 1U);
+  m_templateStartNumber = startNumber;
+  m_templateDuration = duration;
+}
+
+void CThumbnailTrack::AddImage(uint64_t startMs,
+                               uint64_t durationMs,
+                               std::string_view url,
+                               uint64_t number,
+                               uint64_t time)
+{
+  std::string imageUrl{url};
+  ReplacePlaceholder(imageUrl, "Number", number);
+  ReplacePlaceholder(imageUrl, "Time", time);
+  m_images.push_back({startMs, durationMs, imageUrl});
+}
+
+bool CThumbnailTrack::GetTile(uint64_t timeMs, ThumbnailTile& tile) const
+{
+  uint64_t imageStartMs{0};
+  uint64_t imageDurationMs{0};
+
+  if (!m_images.empty())
+  {
+    // The last image that start before the time
+    auto itImage = std::upper_bound(m_images.begin(), m_images.end(), timeMs,
+                                    [](uint64_t time, const Image& image)
+                                    { return time < image.m_startMs; });
+    if (itImage != m_images.begin())
+      --itImage;
+
+    imageStartMs = itImage->m_startMs;
+    imageDurationMs = itImage->m_durationMs;
+    tile.m_url = itImage->m_url;
+  }
+  else if (m_templateDuration > 0)
+  {
+    const uint64_t imageIndex{timeMs * m_templateTimescale / 1000 / m_templateDuration};
+    imageStartMs = imageIndex * m_templateDuration * 1000 / m_templateTimescale;
+    imageDurationMs = m_templateDuration * 1000 / m_templateTimescale;
+
+    tile.m_url = m_templateUrl;
+    ReplacePlaceholder(tile.m_url, "Number", m_templateStartNumber + imageIndex);
+  }
+  else
+    return false;
+
+  const uint64_t thumbCount{static_cast<uint64_t>(m_columns) * m_rows};
+  uint64_t thumbDurationMs{m_thumbDurationMs > 0 ? m_thumbDurationMs
+                                                 : imageDurationMs / thumbCount};
+  if (thumbDurationMs == 0)
+    thumbDurationMs = 1;
+
+  const uint64_t offsetMs{timeMs > imageStartMs ? timeMs - imageStartMs : 0};
+  const uint64_t thumbIndex{std::min(offsetMs / thumbDurationMs, thumbCount - 1)};
+
+  tile.m_startMs = imageStartMs + thumbIndex * thumbDurationMs;
+  tile.m_durationMs = thumbDurationMs;
+  tile.m_width = m_thumbWidth;
+  tile.m_height = m_thumbHeight;
+  tile.m_x = static_cast<int>(thumbIndex % m_columns) * m_thumbWidth;
+  tile.m_y = static_cast<int>(thumbIndex / m_columns) * m_thumbHeight;
+  return true;
+}
@@ -0,0 +1,157 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "../test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace PLAYLIST
+{
+
+/*!
+ * \brief A thumbnail, the area of a tile image (a grid of thumbnails)
+ *        that preview the content at a time.
+ */
+struct ThumbnailTile
+{
+  std::string m_url; // The url of the tile image
+  uint64_t m_startMs{0}; // Start time of the thumbnail, from the period start
+  uint64_t m_durationMs{0};
+  // Area of the thumbnail in the tile image
+  int m_x{0};
+  int m_y{0};
+  int m_width{0};
+  int m_height{0};
+};
+
+/*!
+ * \brief Thumbnail track for scrubbing previews, the DASH image adaptation sets
+ *        (DASH-IF thumbnail tiles) and the HLS image streams (EXT-X-IMAGE-STREAM-INF).
+ *        The tile images are addressed by an explicit list, or by a number based
+ *        segment template.
+ */
+class ATTR_DLL_LOCAL CThumbnailTrack
+{
+public:
+  static std::unique_ptr<CThumbnailTrack> MakeUniquePtr()
+  {
+    return std::make_unique<CThumbnailTrack>();
+  }
+
+  std::string_view GetId() const { return m_id; }
+  void SetId(std::string_view id) { m_id = id; }
+
+  uint32_t GetBandwidth() const { return m_bandwidth; }
+  void SetBandwidth(uint32_t bandwidth) { m_bandwidth = bandwidth; }
+
+  std::string_view GetMimeType() const { return m_mimeType; }
+  void SetMimeType(std::string_view mimeType) { m_mimeType = mimeType; }
+
+  // The url of the HLS image playlist, the images are added on demand
+  std::string_view GetSourceUrl() const { return m_sourceUrl; }
+  void SetSourceUrl(std::string_view url) { m_sourceUrl = url; }
+
+  bool IsPrepared() const { return m_isPrepared; }
+  void SetIsPrepared(bool isPrepared) { m_isPrepared = isPrepared; }
+
+  /*!
+   * \brief Set the grid of the tile images.
+   * \param columns The number of thumbnails on each row
+   * \param rows The number of thumbnails on each column
+   */
+  void SetLayout(uint32_t columns, uint32_t rows);
+  uint32_t GetColumns() const { return m_columns; }
+  uint32_t GetRows() const { return m_rows; }
+
+  // Resolution of a single thumbnail
+  void SetThumbnailSize(int width, int height);
+  int GetThumbnailWidth() const { return m_thumbWidth; }
+  int GetThumbnailHeight() const { return m_thumbHeight; }
+
+  /*!
+   * \brief Set the duration of each thumbnail, by default the tile image
+   *        duration is divided by the number of thumbnails.
+   */
+  void SetThumbnailDuration(uint64_t durationMs) { m_thumbDurationMs = durationMs; }
+
+  /*!
+   * \brief Set the segment template that address the tile images by number.
+   * \param mediaUrl The absolute url with the $Number$ placeholder
+   * \param timescale The timescale of the durations
+   * \param startNumber The number of the first tile image
+   * \param duration The duration of each tile image
+   */
+  void SetTemplate(std::string_view mediaUrl,
+                   uint32_t timescale,
+                   uint64_t startNumber,
+                   uint64_t duration);
+
+  /*!
+   * \brief Add a tile image, the images must be added ordered by time.
+   * \param startMs Start time from the period start
+   * \param durationMs The duration
+   * \param url The absolute url, the $Number$ and $Time$ template
+   *        placeholders are replaced by the values given
+   */
+  void AddImage(uint64_t startMs,
+                uint64_t durationMs,
+                std::string_view url,
+                uint64_t number = 0,
+                uint64_t time = 0);
+
+  size_t GetImageCount() const { return m_images.size(); }
+  bool HasImages() const { return !m_images.empty() || m_templateDuration > 0; }
+
+  /*!
+   * \brief Get the thumbnail at a time, the times out of the track are
+   *        clamped to the first or last image.
+   * \param timeMs The time from the period start
+   * \param tile [OUT] The thumbnail
+   * \return True if found, otherwise false
+   */
+  bool GetTile(uint64_t timeMs, ThumbnailTile& tile) const;
+
+private:
+  struct Image
+  {
+    uint64_t m_startMs;
+    uint64_t m_durationMs;
+    std::string m_url;
+  };
+
+  std::string m_id;
+  uint32_t m_bandwidth{0};
+  std::string m_mimeType;
+  std::string m_sourceUrl;
+  bool m_isPrepared{false};
+
+  uint32_t m_columns{1};
+  uint32_t m_rows{1};
+  int m_thumbWidth{0};
+  int m_thumbHeight{0};
+  uint64_t m_thumbDurationMs{0};
+
+  std::vector<Image> m_images;
+
+  std::string m_templateUrl;
+  uint32_t m_templateTimescale{1};
+  uint64_t m_templateStartNumber{1};
+  uint64_t m_templateDuration{0};
+};
+
+} // namespace PLAYLIST
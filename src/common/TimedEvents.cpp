@@ -0,0 +1,184 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "TimedEvents.h"
+
+#include "../utils/Scte35Utils.h"
+
+#include <algorithm>
+
+using namespace adaptive;
+
+namespace
+{
+constexpr size_t ID3_HEADER_SIZE = 10;
+
+std::string GetEventKey(const TimedEvent& event)
+{
+  return event.m_schemeIdUri + '\n' + event.m_id;
+}
+
+// Append a 28 bit size as ID3v2.4 synchsafe integer
+void AppendSynchsafe(std::string& data, size_t size)
+{
+  data.push_back(static_cast<char>((size >> 21) & 0x7F));
+  data.push_back(static_cast<char>((size >> 14) & 0x7F));
+  data.push_back(static_cast<char>((size >> 7) & 0x7F));
+  data.push_back(static_cast<char>(size & 0x7F));
+}
+
+void AppendID3Frame(std::string& data, std::string_view frameId, const std::string& payload)
+{
+  data.append(frameId);
+  AppendSynchsafe(data, payload.size());
+  data.append(2, '\0'); // Flags
+  data.append(payload);
+}
+
+void AppendID3TextFrame(std::string& data, std::string_view description, std::string_view value)
+{
+  std::string payload{'\x03'}; // UTF-8 encoding
+  payload.append(description);
+  payload.push_back('\0');
+  payload.append(value);
+  AppendID3Frame(data, "TXXX", payload);
+}
+
+std::string_view GetEventTypeName(TimedEventType type)
+{
+  switch (type)
+  {
+    case TimedEventType::AD_START:
+      return "ad_start";
+    case TimedEventType::AD_END:
+      return "ad_end";
+    default:
+      return "metadata";
+  }
+}
+} // unnamed namespace
+
+bool adaptive::ApplySpliceInfo(TimedEvent& event, std::string_view section)
+{
+  UTILS::SCTE35::SpliceInfo info;
+  if (!UTILS::SCTE35::ParseSpliceInfoSection(reinterpret_cast<const uint8_t*>(section.data()),
+                                             section.size(), info))
+    return false;
+
+  if (UTILS::SCTE35::IsAdStart(info))
+  {
+    event.m_type = TimedEventType::AD_START;
+    const uint64_t duration{UTILS::SCTE35::GetAdDuration(info)};
+    if (duration > 0)
+      event.m_duration = ToStreamTime(duration, 90000);
+  }
+  else if (UTILS::SCTE35::IsAdEnd(info))
+  {
+    event.m_type = TimedEventType::AD_END;
+  }
+  return true;
+}
+
+std::string adaptive::CreateID3Tag(const TimedEvent& event)
+{
+  std::string frames;
+  AppendID3TextFrame(frames, "scheme_id_uri", event.m_schemeIdUri);
+  AppendID3TextFrame(frames, "value", event.m_value);
+  AppendID3TextFrame(frames, "id", event.m_id);
+  AppendID3TextFrame(frames, "type", GetEventTypeName(event.m_type));
+  if (event.m_duration > 0)
+    AppendID3TextFrame(frames, "duration", std::to_string(event.m_duration / 1000));
+  if (!event.m_messageData.empty())
+    AppendID3Frame(frames, "PRIV", event.m_schemeIdUri + '\0' + event.m_messageData);
+
+  std::string tag{"ID3\x04\x00\x00", 6}; // Version 2.4.0, no flags
+  tag.reserve(ID3_HEADER_SIZE + frames.size());
+  AppendSynchsafe(tag, frames.size());
+  tag.append(frames);
+  return tag;
+}
+
+bool CTimedEventQueue::Add(const TimedEvent& event)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  const std::string key{GetEventKey(event)};
+  if (IsDelivered(key))
+    return false;
+
+  if (std::any_of(m_events.cbegin(), m_events.cend(),
+                  [&key](const TimedEvent& pending) { return GetEventKey(pending) == key; }))
+    return false;
+
+  m_events.emplace_back(event);
+  return true;
+}
+
+std::vector<TimedEvent> CTimedEventQueue::TakeDueEvents(uint64_t time, int64_t ptsDiff)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  std::vector<TimedEvent> dueEvents;
+
+  for (auto it = m_events.begin(); it != m_events.end();)
+  {
+    TimedEvent& event = *it;
+    int64_t eventTime{static_cast<int64_t>(event.m_time)};
+    if (event.m_isManifestTime)
+      eventTime += ptsDiff;
+
+    if (eventTime > static_cast<int64_t>(time))
+    {
+      ++it;
+      continue;
+    }
+
+    m_deliveredKeys.emplace_back(GetEventKey(event));
+    if (m_deliveredKeys.size() > MAX_DELIVERED_KEYS)
+      m_deliveredKeys.pop_front();
+
+    // Discard events that are ended long ago, e.g. skipped by a seek
+    if (eventTime + static_cast<int64_t>(event.m_duration + MAX_LATENESS) >=
+        static_cast<int64_t>(time))
+    {
+      event.m_time = static_cast<uint64_t>(std::max<int64_t>(eventTime, 0));
+      event.m_isManifestTime = false;
+      dueEvents.emplace_back(std::move(event));
+    }
+    it = m_events.erase(it);
+  }
+
+  std::sort(dueEvents.begin(), dueEvents.end(),
+            [](const TimedEvent& a, const TimedEvent& b) { return a.m_time < b.m_time; });
+  return dueEvents;
+}
+
+std::vector<TimedEvent> CTimedEventQueue::GetEvents() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_events;
+}
+
+void CTimedEventQueue::Clear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_events.clear();
+  m_deliveredKeys.clear();
+}
+
+size_t CTimedEventQueue::GetCount() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_events.size();
+}
+
+bool CTimedEventQueue::IsDelivered(const std::string& key) const
+{
+  return std::find(m_deliveredKeys.cbegin(), m_deliveredKeys.cend(), key) !=
+         m_deliveredKeys.cend();
+}
@@ -0,0 +1,130 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "../test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace adaptive
+{
+// SCTE-35 splice_info_section in binary format (e.g. emsg message data)
+constexpr std::string_view SCHEME_SCTE35_BIN = "urn:scte:scte35:2013:bin";
+// SCTE-35 in XML, with the splice_info_section base64 encoded in the Signal/Binary element
+constexpr std::string_view SCHEME_SCTE35_XML_BIN = "urn:scte:scte35:2014:xml+bin";
+
+enum class TimedEventType
+{
+  METADATA,
+  AD_START, // Start of an ad break (e.g. SCTE-35 out of network, EXT-X-CUE-OUT)
+  AD_END, // End of an ad break (e.g. SCTE-35 return to network, EXT-X-CUE-IN)
+};
+
+/*!
+ * \brief A timed event of the presentation, from the manifest (DASH EventStream,
+ *        HLS EXT-X-DATERANGE / EXT-X-CUE-OUT / EXT-X-CUE-IN) or the segments
+ *        (emsg boxes, SCTE-35 sections of MPEG-TS).
+ */
+struct ATTR_DLL_LOCAL TimedEvent
+{
+  TimedEventType m_type{TimedEventType::METADATA};
+  std::string m_schemeIdUri; // The DASH scheme, or the HLS tag name
+  std::string m_value;
+  std::string m_id; // Identify the same event repeated by manifest updates or segments
+  // The presentation time in STREAM_TIME_BASE units, in the timeline of the stream PTS
+  // or when m_isManifestTime is set, in the timeline of the manifest segments
+  uint64_t m_time{0};
+  bool m_isManifestTime{false};
+  uint64_t m_duration{0}; // STREAM_TIME_BASE units, 0 when unknown
+  std::string m_messageData;
+};
+
+/*!
+ * \brief Convert a time from a timescale to STREAM_TIME_BASE units,
+ *        without overflow of large times (e.g. wall clock based).
+ */
+constexpr uint64_t ToStreamTime(uint64_t time, uint64_t timescale)
+{
+  return (time / timescale) * STREAM_TIME_BASE + (time % timescale) * STREAM_TIME_BASE / timescale;
+}
+
+/*!
+ * \brief Set the event type and duration from a SCTE-35 splice_info_section.
+ * \param event The event to update
+ * \param section The splice_info_section data
+ * \return True if the section has been parsed, otherwise false
+ */
+bool ApplySpliceInfo(TimedEvent& event, std::string_view section);
+
+/*!
+ * \brief Create an ID3v2.4 tag of the event, to be delivered as timed metadata.
+ *        The event fields are stored as TXXX frames with the descriptions
+ *        "scheme_id_uri", "value", "id", "type" ("metadata", "ad_start", "ad_end")
+ *        and "duration" (milliseconds), the message data as PRIV frame owned by
+ *        the scheme id uri.
+ * \param event The event
+ * \return The ID3 tag data
+ */
+std::string CreateID3Tag(const TimedEvent& event);
+
+/*!
+ * \brief Queue of the timed events waiting to be delivered at their presentation
+ *        time. An event is delivered once, also when it is added again by
+ *        a manifest update or by the segments of other streams. Thread safe.
+ */
+class ATTR_DLL_LOCAL CTimedEventQueue
+{
+public:
+  // Events that are late more than this time (and ended) are discarded, e.g. after a seek
+  static constexpr uint64_t MAX_LATENESS = 2 * STREAM_TIME_BASE;
+
+  /*!
+   * \brief Add an event, ignored if the same event (scheme and id) is pending
+   *        or has been delivered.
+   * \return True if the event has been added, otherwise false
+   */
+  bool Add(const TimedEvent& event);
+
+  /*!
+   * \brief Take the events due at the presentation time, ordered by time.
+   * \param time The presentation time in the stream PTS timeline (STREAM_TIME_BASE units)
+   * \param ptsDiff The difference between the stream PTS and the manifest timeline,
+   *                used to convert the time of the events from the manifest
+   * \return The due events
+   */
+  std::vector<TimedEvent> TakeDueEvents(uint64_t time, int64_t ptsDiff);
+
+  /*!
+   * \brief Get a copy of the pending events.
+   */
+  std::vector<TimedEvent> GetEvents() const;
+
+  void Clear();
+  size_t GetCount() const;
+
+private:
+  bool IsDelivered(const std::string& key) const;
+
+  // Max number of delivered event keys remembered
+  static constexpr size_t MAX_DELIVERED_KEYS = 256;
+
+  mutable std::mutex m_mutex;
+  std::vector<TimedEvent> m_events;
+  std::deque<std::string> m_deliveredKeys;
+};
+} // namespace adaptive
@@ -26,6 +26,15 @@ using namespace PLAYLIST;
 using namespace SESSION;
 using namespace UTILS;
 
+namespace
+{
+// Stream id of the timed metadata stream, in the stream ids of the period
+constexpr unsigned int TIMED_METADATA_SID = 999;
+// Stream id of the first closed captions stream, in the stream ids of the period
+constexpr unsigned int CLOSED_CAPTIONS_SID = 990;
+constexpr size_t MAX_CLOSED_CAPTIONS = 8;
+} // unnamed namespace
+
 CInputStreamAdaptive::CInputStreamAdaptive(const kodi::addon::IInstanceInfo& instance)
   : CInstanceInputStream(instance)
 {
@@ -127,6 +136,20 @@ bool CInputStreamAdaptive::GetStreamIds(std::vector<unsigned int>& ids)
         ids.emplace_back(id);
       }
     }
+
+    if (m_kodiProps.m_isTimedMetadata)
+      ids.emplace_back(TIMED_METADATA_SID + period_id * 1000);
+
+    // The closed captions carried in the video stream are exposed as subtitle streams
+    if (m_session->GetMediaTypeMask() &
+        static_cast<uint8_t>(1) << static_cast<int>(StreamType::VIDEO))
+    {
+      m_closedCaptions.SetChannels(m_session->GetClosedCaptions());
+      for (size_t i{0}; i < m_closedCaptions.GetChannelCount() && i < MAX_CLOSED_CAPTIONS; ++i)
+      {
+        ids.emplace_back(CLOSED_CAPTIONS_SID + static_cast<unsigned int>(i) + period_id * 1000);
+      }
+    }
   }
 
   return !ids.empty();
@@ -148,6 +171,33 @@ bool CInputStreamAdaptive::GetStream(int streamid, kodi::addon::InputstreamInfo&
 {
   LOG::Log(LOGDEBUG, "GetStream(%d)", streamid);
 
+  if (streamid - m_session->GetPeriodId() * 1000 == TIMED_METADATA_SID)
+  {
+    info.SetStreamType(INPUTSTREAM_TYPE_ID3);
+    info.SetCodecName("id3");
+    info.SetPhysicalIndex(TIMED_METADATA_SID);
+    return true;
+  }
+
+  const int ccIndex = GetClosedCaptionIndex(streamid);
+  if (ccIndex >= 0)
+  {
+    const ClosedCaption& closedCaption = m_closedCaptions.GetChannel(ccIndex);
+    uint32_t flags{INPUTSTREAM_FLAG_HEARING_IMPAIRED};
+    if (closedCaption.m_isDefault)
+      flags |= INPUTSTREAM_FLAG_DEFAULT;
+
+    info.SetStreamType(INPUTSTREAM_TYPE_SUBTITLE);
+    // Plain text with duration, as the closed captions demuxed by Kodi
+    info.SetCodecName("text");
+    info.SetLanguage(closedCaption.m_language);
+    info.SetName(closedCaption.m_name.empty() ? closedCaption.m_instreamId
+                                              : closedCaption.m_name);
+    info.SetFlags(flags);
+    info.SetPhysicalIndex(CLOSED_CAPTIONS_SID + ccIndex);
+    return true;
+  }
+
   CStream* stream(m_session->GetStream(streamid - m_session->GetPeriodId() * 1000));
 
   if (stream)
@@ -160,7 +210,11 @@ bool CInputStreamAdaptive::GetStream(int streamid, kodi::addon::InputstreamInfo&
       LOG::Log(LOGDEBUG, "GetStream(%d): initalizing crypto session", streamid);
       cryptoSession.SetKeySystem(m_session->GetCryptoKeySystem());
 
-      const char* sessionId(m_session->GetCDMSession(cdmId));
+      // The reader can decrypt with the session of a rotated key
+      const char* sessionId{stream->GetReader() ? stream->GetReader()->GetCryptoSessionId()
+                                                : nullptr};
+      if (!sessionId)
+        sessionId = m_session->GetCDMSession(cdmId);
       cryptoSession.SetSessionId(sessionId);
 
       if (m_session->GetDecrypterCaps(cdmId).flags &
@@ -205,6 +259,19 @@ void CInputStreamAdaptive::EnableStream(int streamid, bool enable)
   if (!m_session)
     return;
 
+  if (streamid - m_session->GetPeriodId() * 1000 == TIMED_METADATA_SID)
+  {
+    m_isTimedMetadataOpen = enable;
+    return;
+  }
+
+  const int ccIndex = GetClosedCaptionIndex(streamid);
+  if (ccIndex >= 0)
+  {
+    m_closedCaptions.EnableChannel(ccIndex, enable);
+    return;
+  }
+
   CStream* stream(m_session->GetStream(streamid - m_session->GetPeriodId() * 1000));
 
   if (!enable && stream && stream->m_isEnabled)
@@ -223,6 +290,19 @@ bool CInputStreamAdaptive::OpenStream(int streamid)
   if (!m_session)
     return false;
 
+  if (streamid - m_session->GetPeriodId() * 1000 == TIMED_METADATA_SID)
+  {
+    m_isTimedMetadataOpen = true;
+    return false;
+  }
+
+  const int ccIndex = GetClosedCaptionIndex(streamid);
+  if (ccIndex >= 0)
+  {
+    m_closedCaptions.EnableChannel(ccIndex, true);
+    return false;
+  }
+
   CStream* stream(m_session->GetStream(streamid - m_session->GetPeriodId() * 1000));
 
   if (!stream)
@@ -256,6 +336,9 @@ bool CInputStreamAdaptive::OpenStream(int streamid)
         break;
     if (mainStream)
     {
+      // The included stream is demuxed from the video download
+      if (mainStream->m_isSuspended)
+        m_session->ResumeStream(mainStream);
       ISampleReader* mainReader = mainStream->GetReader();
       if (!mainReader)
       {
@@ -263,7 +346,8 @@ bool CInputStreamAdaptive::OpenStream(int streamid)
       }
       else
       {
-        mainReader->AddStreamType(stream->m_info.GetStreamType(), streamid);
+        mainReader->AddStreamType(stream->m_info.GetStreamType(), streamid,
+                                  rep->GetIncludedStreamIndex(), rep->GetIncludedStreamCount());
         mainReader->GetInformation(stream->m_info);
       }
     }
@@ -302,8 +386,10 @@ bool CInputStreamAdaptive::OpenStream(int streamid)
     stream->SetAdByteStream(std::make_unique<CAdaptiveByteStream>(&stream->m_adStream));
 
     uint32_t mask{(1U << stream->m_info.GetStreamType()) | m_session->GetIncludedStreamMask()};
-    stream->SetReader(std::make_unique<CTSSampleReader>(
-        stream->GetAdByteStream(), stream->m_info.GetStreamType(), streamid, mask));
+    auto reader = std::make_unique<CTSSampleReader>(
+        stream->GetAdByteStream(), stream->m_info.GetStreamType(), streamid, mask);
+    reader->SetAdaptiveTree(m_session->GetAdaptiveTree());
+    stream->SetReader(std::move(reader));
 
     if (!stream->GetReader()->Initialize())
     {
@@ -320,7 +406,10 @@ bool CInputStreamAdaptive::OpenStream(int streamid)
   else if (reprContainerType == ContainerType::WEBM)
   {
     stream->SetAdByteStream(std::make_unique<CAdaptiveByteStream>(&stream->m_adStream));
-    stream->SetReader(std::make_unique<CWebmSampleReader>(stream->GetAdByteStream(), streamid));
+    auto reader = std::make_unique<CWebmSampleReader>(stream->GetAdByteStream(), streamid);
+    reader->SetDecrypter(
+        m_session->GetSingleSampleDecryptor(stream->m_adStream.getRepresentation()->m_psshSetPos));
+    stream->SetReader(std::move(reader));
     if (!stream->GetReader()->Initialize())
     {
       stream->Disable();
@@ -366,8 +455,11 @@ bool CInputStreamAdaptive::OpenStream(int streamid)
         m_session->GetSingleSampleDecryptor(stream->m_adStream.getRepresentation()->m_psshSetPos);
     auto caps = m_session->GetDecrypterCaps(stream->m_adStream.getRepresentation()->m_psshSetPos);
 
-    stream->SetReader(std::make_unique<CFragmentedSampleReader>(
-        stream->GetAdByteStream(), movie, track, streamid, sampleDecrypter, caps));
+    auto reader = std::make_unique<CFragmentedSampleReader>(
+        stream->GetAdByteStream(), movie, track, streamid, sampleDecrypter, caps);
+    reader->SetKeyRotation(m_session->GetKeyRotation());
+    reader->SetAdaptiveTree(m_session->GetAdaptiveTree());
+    stream->SetReader(std::move(reader));
   }
   else
   {
@@ -380,23 +472,32 @@ bool CInputStreamAdaptive::OpenStream(int streamid)
   {
     for (auto& [streamType, id] : m_IncludedStreams)
     {
-      stream->GetReader()->AddStreamType(streamType, id);
-
       unsigned int sid = id - m_session->GetPeriodId() * 1000;
 
       CStream* incStream = m_session->GetStream(sid);
       if (!incStream)
       {
         LOG::LogF(LOGERROR, "Cannot get the stream from sid %u", sid);
+        stream->GetReader()->AddStreamType(streamType, id, 0, 0);
       }
       else
       {
+        // The included streams are demuxed from the video stream download
+        const CRepresentation* incRep = incStream->m_adStream.getRepresentation();
+        stream->GetReader()->AddStreamType(streamType, id, incRep->GetIncludedStreamIndex(),
+                                           incRep->GetIncludedStreamCount());
         stream->GetReader()->GetInformation(incStream->m_info);
       }
     }
   }
   m_session->EnableStream(stream, true);
-  return stream->GetReader()->GetInformation(stream->m_info) || needRefetch;
+  const bool isInfoChanged{stream->GetReader()->GetInformation(stream->m_info)};
+
+  // In audio only mode the video downloads are suspended until the mode is disabled
+  if (stream->m_info.GetStreamType() == INPUTSTREAM_TYPE_VIDEO)
+    m_session->SuspendStream(stream);
+
+  return isInfoChanged || needRefetch;
 }
 
 
@@ -436,6 +537,18 @@ DEMUX_PACKET* CInputStreamAdaptive::DemuxRead(void)
       return p;
     }
 
+    if (sr && m_isTimedMetadataOpen && sr->PTS() != STREAM_NOPTS_VALUE)
+    {
+      // The sample is kept to be read on next call
+      p = CreateTimedMetadataPacket(sr->PTS());
+      if (p)
+        return p;
+    }
+
+    p = CreateClosedCaptionPacket();
+    if (p)
+      return p;
+
     if (sr)
     {
       AP4_Size iSize(sr->GetSampleDataSize());
@@ -479,6 +592,13 @@ DEMUX_PACKET* CInputStreamAdaptive::DemuxRead(void)
 
       //LOG::Log(LOGDEBUG, "DTS: %0.4f, PTS:%0.4f, ID: %u SZ: %d", p->dts, p->pts, p->iStreamId, p->iSize);
 
+      std::vector<uint8_t> ccData;
+      if (srHaveData && m_closedCaptions.IsEnabled() && sr->PTS() != STREAM_NOPTS_VALUE &&
+          sr->GetCaptionData(ccData))
+      {
+        m_closedCaptions.AddPicture(sr->PTS(), std::move(ccData));
+      }
+
       // Start reading the next sample
       sr->ReadSampleAsync();
     }
@@ -505,6 +625,68 @@ DEMUX_PACKET* CInputStreamAdaptive::DemuxRead(void)
   return NULL;
 }
 
+DEMUX_PACKET* CInputStreamAdaptive::CreateTimedMetadataPacket(uint64_t pts)
+{
+  if (m_dueTimedEvents.empty())
+  {
+    for (adaptive::TimedEvent& event : m_session->TakeDueTimedEvents(pts))
+    {
+      m_dueTimedEvents.emplace_back(std::move(event));
+    }
+    if (m_dueTimedEvents.empty())
+      return nullptr;
+  }
+
+  const adaptive::TimedEvent& event = m_dueTimedEvents.front();
+  LOG::Log(LOGDEBUG, "Timed event (scheme: %s, id: %s) delivered at PTS %llu",
+           event.m_schemeIdUri.c_str(), event.m_id.c_str(), event.m_time);
+
+  const std::string tag{adaptive::CreateID3Tag(event)};
+  DEMUX_PACKET* p = AllocateDemuxPacket(static_cast<int>(tag.size()));
+  p->dts = static_cast<double>(event.m_time);
+  p->pts = static_cast<double>(event.m_time);
+  p->duration = static_cast<double>(event.m_duration);
+  p->iStreamId = TIMED_METADATA_SID + m_session->GetPeriodId() * 1000;
+  p->iGroupId = 0;
+  p->iSize = static_cast<int>(tag.size());
+  std::memcpy(p->pData, tag.data(), tag.size());
+
+  m_dueTimedEvents.pop_front();
+  return p;
+}
+
+DEMUX_PACKET* CInputStreamAdaptive::CreateClosedCaptionPacket()
+{
+  size_t index{0};
+  CaptionCue cue;
+  if (!m_closedCaptions.TakeCue(index, cue))
+    return nullptr;
+
+  DEMUX_PACKET* p = AllocateDemuxPacket(static_cast<int>(cue.m_text.size()));
+  p->dts = static_cast<double>(cue.m_pts);
+  p->pts = static_cast<double>(cue.m_pts);
+  p->duration = static_cast<double>(cue.m_duration);
+  p->iStreamId =
+      CLOSED_CAPTIONS_SID + static_cast<unsigned int>(index) + m_session->GetPeriodId() * 1000;
+  p->iGroupId = 0;
+  p->iSize = static_cast<int>(cue.m_text.size());
+  std::memcpy(p->pData, cue.m_text.data(), cue.m_text.size());
+  return p;
+}
+
+int CInputStreamAdaptive::GetClosedCaptionIndex(int streamid) const
+{
+  const int sid = streamid - m_session->GetPeriodId() * 1000;
+  const int channelCount =
+      static_cast<int>(std::min(m_closedCaptions.GetChannelCount(), MAX_CLOSED_CAPTIONS));
+  if (sid < static_cast<int>(CLOSED_CAPTIONS_SID) ||
+      sid >= static_cast<int>(CLOSED_CAPTIONS_SID) + channelCount)
+  {
+    return -1;
+  }
+  return sid - static_cast<int>(CLOSED_CAPTIONS_SID);
+}
+
 // Accurate search (PTS based)
 bool CInputStreamAdaptive::DemuxSeekTime(double time, bool backwards, double& startpts)
 {
@@ -537,6 +719,8 @@ bool CInputStreamAdaptive::PosTime(int ms)
 
   bool ret = m_session->SeekTime(static_cast<double>(ms) * 0.001f, 0, false);
   m_failedSeekTime = ret ? ~0 : ms;
+  m_dueTimedEvents.clear();
+  m_closedCaptions.Reset();
 
   return ret;
 }
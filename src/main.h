@@ -9,11 +9,14 @@
 #pragma once
 
 #include "Session.h"
+#include "codechandler/cc/ClosedCaptions.h"
 #include "utils/PropertiesUtils.h"
 
 #include <kodi/addon-instance/Inputstream.h>
 #include <kodi/addon-instance/VideoCodec.h>
 
+#include <deque>
+
 /*******************************************************/
 /*                     InputStream                     */
 /*******************************************************/
@@ -64,8 +67,29 @@ private:
   bool m_checkChapterSeek = false;
   int m_failedSeekTime = ~0;
   std::string m_chapterName;
+  bool m_isTimedMetadataOpen{false};
+  std::deque<adaptive::TimedEvent> m_dueTimedEvents;
+  CClosedCaptions m_closedCaptions;
 
   void UnlinkIncludedStreams(SESSION::CStream* stream);
+  /*!
+   * \brief Create the packet of the next timed event due at the pts, as ID3 tag
+   *        of the timed metadata stream.
+   * \param pts The pts of the next sample to be demuxed
+   * \return The packet, or nullptr if there are no events due
+   */
+  DEMUX_PACKET* CreateTimedMetadataPacket(uint64_t pts);
+  /*!
+   * \brief Create the packet of the next closed caption cue decoded, as text
+   *        of the closed captions stream.
+   * \return The packet, or nullptr if there are no cues
+   */
+  DEMUX_PACKET* CreateClosedCaptionPacket();
+  /*!
+   * \brief Get the closed caption channel index of a stream id.
+   * \return The channel index, or -1 if the stream is not a closed captions stream
+   */
+  int GetClosedCaptionIndex(int streamid) const;
 };
 
 /*******************************************************/
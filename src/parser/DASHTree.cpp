@@ -8,7 +8,9 @@
 
 #include "DASHTree.h"
 
+#include "../common/KeySystemHandlers.h"
 #include "../oscompat.h"
+#include "../utils/Base64Utils.h"
 #include "../utils/StringUtils.h"
 #include "../utils/UrlUtils.h"
 #include "../utils/Utils.h"
@@ -31,6 +33,11 @@ using namespace UTILS;
 
 namespace
 {
+// In-band event scheme that signal the expiration of the MPD validity
+constexpr std::string_view SCHEME_MPD_EVENT = "urn:mpeg:dash:event:2012";
+// Update interval used as fallback when the MPD expiration is signalled by in-band events
+constexpr uint32_t INBAND_EVENTS_UPDATE_INTERVAL = 60000;
+
 std::string ReplacePlaceHolders(std::string str, const std::string_view id, uint32_t bandwidth)
 {
   STRING::ReplaceAll(str, "$RepresentationID$", id);
@@ -80,6 +87,62 @@ std::string DetectCodecFromMimeType(std::string_view mimeType)
   return "";
 }
 
+/*!
+ * \brief Add the CEA-608/708 closed captions signalled by an Accessibility descriptor,
+ *        the value is a list of channels with their language e.g. "CC1=eng;CC3=deu"
+ *        for CEA-608, "1=lang:eng;2=lang:deu,war:1" for CEA-708, the channel
+ *        numbers can be omitted and then are assigned by list order.
+ */
+void AddClosedCaptions(std::string_view schemeIdUri,
+                       std::string_view value,
+                       CAdaptationSet* adpSet)
+{
+  const bool isCea608{schemeIdUri == "urn:scte:dash:cc:cea-608:2015"};
+  uint32_t number{1};
+
+  for (std::string entry : StringUtils::Split(std::string(value), ';'))
+  {
+    StringUtils::Trim(entry);
+    if (entry.empty())
+      continue;
+
+    std::string language{entry};
+    const size_t eqPos{entry.find('=')};
+    if (eqPos != std::string::npos)
+    {
+      std::string_view channel{std::string_view(entry).substr(0, eqPos)};
+      if (isCea608 && STRING::StartsWith(channel, "CC"))
+        channel.remove_prefix(2);
+      number = STRING::ToUint32(channel);
+      language = entry.substr(eqPos + 1);
+    }
+
+    // CEA-708 services have a list of attributes e.g. "lang:eng,war:1,er:1"
+    if (!isCea608 && language.find(':') != std::string::npos)
+    {
+      std::string serviceLang;
+      for (const std::string& attrib : StringUtils::Split(language, ','))
+      {
+        if (STRING::StartsWith(attrib, "lang:"))
+          serviceLang = attrib.substr(5);
+      }
+      language = serviceLang;
+    }
+
+    if (number < 1 || number > (isCea608 ? 4 : 63))
+    {
+      LOG::LogF(LOGWARNING, "Ignored closed caption channel \"%s\"", entry.c_str());
+      continue;
+    }
+
+    ClosedCaption closedCaption;
+    closedCaption.m_instreamId = (isCea608 ? "CC" : "SERVICE") + std::to_string(number);
+    closedCaption.m_language = language;
+    adpSet->AddClosedCaption(closedCaption);
+    number++;
+  }
+}
+
 } // unnamed namespace
 
 
@@ -155,25 +218,43 @@ bool adaptive::CDashTree::ParseManifest(std::string& data)
   if (!locationText.empty() && URL::IsValidUrl(locationText.data()))
     location_ = locationText;
 
-  // Parse <MPD> <BaseURL> tag (just first, multi BaseURL not supported yet)
-  std::string mpdUrl = base_url_;
-  std::string baseUrl = nodeMPD.child("BaseURL").child_value();
-  if (!baseUrl.empty())
+  // Parse <MPD> <ContentSteering> tag
+  xml_node nodeSteering = nodeMPD.child("ContentSteering");
+  if (nodeSteering && !m_contentSteering.IsEnabled())
   {
-    URL::EnsureEndingBackslash(baseUrl);
+    std::string serverUrl = nodeSteering.child_value();
+    StringUtils::Trim(serverUrl);
+    std::string_view defaultPathway = XML::GetAttrib(nodeSteering, "defaultServiceLocation");
+    // Without default service location, the first base url is the default one
+    if (defaultPathway.empty())
+    {
+      xml_node nodeBaseUrl = nodeMPD.child("BaseURL");
+      defaultPathway = XML::GetAttrib(nodeBaseUrl, "serviceLocation");
+    }
 
-    if (URL::IsUrlAbsolute(baseUrl))
-      mpdUrl = baseUrl;
-    else
-      mpdUrl = URL::Join(mpdUrl, baseUrl);
+    if (!serverUrl.empty())
+    {
+      if (!URL::IsUrlAbsolute(serverUrl))
+        serverUrl = URL::Join(base_url_, serverUrl);
+
+      m_contentSteering.Initialize(CContentSteering::Protocol::DASH, serverUrl, defaultPathway);
+    }
   }
 
+  // Parse <MPD> <BaseURL> tags
+  std::string mpdUrl = ParseTagBaseURL(nodeMPD, base_url_);
+
   // Parse <MPD> <Period> tags
   for (xml_node node : nodeMPD.children("Period"))
   {
     ParseTagPeriod(node, mpdUrl);
   }
 
+  // When the segments carry the MPD events the manifest is updated as soon as an event
+  // signal its expiration, the periodic updates are kept only in case of missed events
+  if (m_hasInbandMpdEvents && ~m_updateInterval)
+    m_updateInterval = std::max(m_updateInterval.load(), INBAND_EVENTS_UPDATE_INTERVAL);
+
   // Cleanup periods
   bool hasTotalTimeSecs = m_totalTimeSecs > 0;
 
@@ -225,6 +306,7 @@ void adaptive::CDashTree::ParseTagMPDAttribs(pugi::xml_node nodeMPD)
   if (XML::QueryAttrib(nodeMPD, "timeShiftBufferDepth", timeShiftBufferDepthStr))
   {
     timeShiftBufferDepth = XML::ParseDuration(timeShiftBufferDepthStr);
+    m_timeShiftBufferDepth = static_cast<uint64_t>(timeShiftBufferDepth * 1000);
     has_timeshift_buffer_ = true;
   }
 
@@ -254,6 +336,59 @@ void adaptive::CDashTree::ParseTagMPDAttribs(pugi::xml_node nodeMPD)
     m_totalTimeSecs = static_cast<uint64_t>(mediaPresDuration);
 }
 
+std::string adaptive::CDashTree::ParseTagBaseURL(pugi::xml_node node,
+                                                 std::string_view parentUrl,
+                                                 bool isDirectory)
+{
+  const bool isSteeringEnabled{m_contentSteering.IsEnabled()};
+  const std::string defaultPathway{m_contentSteering.GetDefaultPathway()};
+
+  // Pairs of service location and base url
+  std::vector<std::pair<std::string_view, std::string>> baseUrls;
+
+  for (xml_node nodeBaseUrl : node.children("BaseURL"))
+  {
+    std::string url = nodeBaseUrl.child_value();
+    StringUtils::Trim(url);
+    if (url.empty())
+      continue;
+
+    if (isDirectory)
+      URL::EnsureEndingBackslash(url);
+
+    if (!URL::IsUrlAbsolute(url))
+      url = URL::Join(std::string(parentUrl), url);
+
+    baseUrls.emplace_back(XML::GetAttrib(nodeBaseUrl, "serviceLocation"), url);
+
+    if (!isSteeringEnabled)
+      break;
+  }
+
+  if (baseUrls.empty())
+    return std::string(parentUrl);
+
+  auto itDefault = std::find_if(baseUrls.begin(), baseUrls.end(),
+                                [&defaultPathway](const auto& baseUrl)
+                                { return baseUrl.first == defaultPathway; });
+  if (itDefault == baseUrls.end())
+    itDefault = baseUrls.begin();
+
+  if (isSteeringEnabled)
+  {
+    m_contentSteering.AddPathwayUrl(defaultPathway, URL::GetDomainUrl(itDefault->second),
+                                    URL::GetDomainUrl(itDefault->second));
+
+    for (const auto& [serviceLocation, url] : baseUrls)
+    {
+      if (!serviceLocation.empty() && serviceLocation != defaultPathway)
+        m_contentSteering.AddPathwayUrl(serviceLocation, url, itDefault->second);
+    }
+  }
+
+  return itDefault->second;
+}
+
 void adaptive::CDashTree::ParseTagPeriod(pugi::xml_node nodePeriod, std::string_view mpdUrl)
 {
   std::unique_ptr<CPeriod> period = CPeriod::MakeUniquePtr();
@@ -267,21 +402,8 @@ void adaptive::CDashTree::ParseTagPeriod(pugi::xml_node nodePeriod, std::string_
   period->SetDuration(
       static_cast<uint64_t>(XML::ParseDuration(XML::GetAttrib(nodePeriod, "duration")) * 1000));
 
-  // Parse <BaseURL> tag (just first, multi BaseURL not supported yet)
-  std::string baseUrl = nodePeriod.child("BaseURL").child_value();
-  if (baseUrl.empty())
-  {
-    period->SetBaseUrl(mpdUrl);
-  }
-  else
-  {
-    URL::EnsureEndingBackslash(baseUrl);
-
-    if (URL::IsUrlAbsolute(baseUrl))
-      period->SetBaseUrl(baseUrl);
-    else
-      period->SetBaseUrl(URL::Join(mpdUrl.data(), baseUrl));
-  }
+  // Parse <BaseURL> tags
+  period->SetBaseUrl(ParseTagBaseURL(nodePeriod, mpdUrl));
 
   // Parse <SegmentTemplate> tag
   xml_node nodeSegTpl = nodePeriod.child("SegmentTemplate");
@@ -340,6 +462,9 @@ void adaptive::CDashTree::ParseTagPeriod(pugi::xml_node nodePeriod, std::string_
     period->SetSegmentList(segList);
   }
 
+  // Parse <EventStream> tags
+  ParseTagEventStream(nodePeriod);
+
   // Parse <AdaptationSet> tags
   for (xml_node node : nodePeriod.children("AdaptationSet"))
   {
@@ -387,9 +512,8 @@ void adaptive::CDashTree::ParseTagAdaptationSet(pugi::xml_node nodeAdp, PLAYLIST
     }
   }
 
-  // Parse <Accessibility> child tag
-  xml_node nodeAcc = nodeAdp.child("Accessibility");
-  if (nodeAcc)
+  // Parse <Accessibility> child tags
+  for (xml_node nodeAcc : nodeAdp.children("Accessibility"))
   {
     std::string_view schemeIdUri = XML::GetAttrib(nodeAcc, "schemeIdUri");
     std::string_view value = XML::GetAttrib(nodeAcc, "value");
@@ -399,6 +523,11 @@ void adaptive::CDashTree::ParseTagAdaptationSet(pugi::xml_node nodeAdp, PLAYLIST
       if (value == "caption")
         adpSet->SetIsImpaired(true);
     }
+    else if (schemeIdUri == "urn:scte:dash:cc:cea-608:2015" ||
+             schemeIdUri == "urn:scte:dash:cc:cea-708:2015")
+    {
+      AddClosedCaptions(schemeIdUri, value, adpSet.get());
+    }
   }
 
   if (contentType.empty())
@@ -406,6 +535,13 @@ void adaptive::CDashTree::ParseTagAdaptationSet(pugi::xml_node nodeAdp, PLAYLIST
 
   adpSet->SetMimeType(XML::GetAttrib(nodeAdp, "mimeType"));
 
+  // Image adaptation sets provide the thumbnails for scrubbing previews
+  if (contentType == "image" || STRING::StartsWith(adpSet->GetMimeType(), "image/"))
+  {
+    ParseTagThumbnails(nodeAdp, period);
+    return;
+  }
+
   adpSet->SetStreamType(DetectStreamType(contentType, adpSet->GetMimeType()));
   adpSet->SetContainerType(DetectContainerType(adpSet->GetMimeType()));
 
@@ -469,21 +605,11 @@ void adaptive::CDashTree::ParseTagAdaptationSet(pugi::xml_node nodeAdp, PLAYLIST
       adpSet->AddSwitchingIds(value);
   }
 
-  // Parse <BaseURL> tag (just first, multi BaseURL not supported yet)
-  std::string baseUrlText = nodeAdp.child("BaseURL").child_value();
-  if (baseUrlText.empty())
-  {
-    adpSet->SetBaseUrl(period->GetBaseUrl());
-  }
-  else
-  {
-    URL::EnsureEndingBackslash(baseUrlText);
+  // Parse <InbandEventStream> child tags
+  ParseTagInbandEventStream(nodeAdp);
 
-    if (URL::IsUrlAbsolute(baseUrlText))
-      adpSet->SetBaseUrl(baseUrlText);
-    else
-      adpSet->SetBaseUrl(URL::Join(period->GetBaseUrl(), baseUrlText));
-  }
+  // Parse <BaseURL> tags
+  adpSet->SetBaseUrl(ParseTagBaseURL(nodeAdp, period->GetBaseUrl()));
 
   // Parse <SegmentDurations> tag
   // No dash spec, looks like a custom Amazon video service implementation
@@ -600,13 +726,15 @@ void adaptive::CDashTree::ParseTagAdaptationSet(pugi::xml_node nodeAdp, PLAYLIST
     uint16_t currentPsshSetPos{PSSHSET_POS_DEFAULT};
     std::string currentPssh{PSSH_FROM_FILE};
     std::string currentDefaultKID;
+    std::string currentKeySystem;
     bool isSecureDecoderNeeded{false};
 
-    if (ParseTagContentProtection(nodeAdp, currentPssh, currentDefaultKID, isSecureDecoderNeeded))
+    if (ParseTagContentProtection(nodeAdp, currentPssh, currentDefaultKID, currentKeySystem,
+                                  isSecureDecoderNeeded))
     {
       period->SetEncryptionState(EncryptionState::ENCRYPTED_SUPPORTED);
       currentPsshSetPos = InsertPsshSet(adpSet->GetStreamType(), period, adpSet.get(), currentPssh,
-                                        currentDefaultKID);
+                                        currentDefaultKID, "", currentKeySystem);
     }
     if (currentPsshSetPos == PSSHSET_POS_INVALID)
     {
@@ -727,10 +855,9 @@ void adaptive::CDashTree::ParseTagRepresentation(pugi::xml_node nodeRepr,
   if (XML::QueryAttrib(nodeRepr, "hdcp", hdcp))
     repr->SetHdcpVersion(static_cast<uint16_t>(hdcp));
 
-  // Parse <BaseURL> tag
-  std::string_view baseUrl = nodeRepr.child("BaseURL").child_value();
-  //! @TODO: Multi BaseURL tag is not supported/implemented yet.
-  //! There are two cases:
+  // Parse <BaseURL> tags
+  //! @TODO: Multi BaseURL tag is supported only with content steering (serviceLocation).
+  //! Without it, there are two cases:
   //! 1) BaseURL without properties
   //!  <BaseURL>https://cdnurl1/</BaseURL>
   //!  the player must select the first base url by default and fallback
@@ -738,17 +865,7 @@ void adaptive::CDashTree::ParseTagRepresentation(pugi::xml_node nodeRepr,
   //! 2) BaseURL with DVB properties (ETSI TS 103 285 - DVB)
   //!  <BaseURL dvb:priority="1" dvb:weight="10" serviceLocation="A" >https://cdnurl1/</BaseURL>
   //!  where these properties affect the behaviour of the url selection.
-  if (baseUrl.empty())
-  {
-    repr->SetBaseUrl(adpSet->GetBaseUrl());
-  }
-  else
-  {
-    if (URL::IsUrlAbsolute(baseUrl))
-      repr->SetBaseUrl(baseUrl);
-    else
-      repr->SetBaseUrl(URL::Join(adpSet->GetBaseUrl().data(), baseUrl.data()));
-  }
+  repr->SetBaseUrl(ParseTagBaseURL(nodeRepr, adpSet->GetBaseUrl(), false));
 
   // Parse <SegmentBase> tag
   xml_node nodeSegBase = nodeRepr.child("SegmentBase");
@@ -1003,13 +1120,15 @@ void adaptive::CDashTree::ParseTagRepresentation(pugi::xml_node nodeRepr,
     uint16_t currentPsshSetPos{PSSHSET_POS_DEFAULT};
     std::string currentDefaultKID;
     std::string currentPssh{PSSH_FROM_FILE};
+    std::string currentKeySystem;
     bool isSecureDecoderNeeded{false};
 
-    if (ParseTagContentProtection(nodeRepr, currentPssh, currentDefaultKID, isSecureDecoderNeeded))
+    if (ParseTagContentProtection(nodeRepr, currentPssh, currentDefaultKID, currentKeySystem,
+                                  isSecureDecoderNeeded))
     {
       period->SetEncryptionState(EncryptionState::ENCRYPTED_SUPPORTED);
-      currentPsshSetPos =
-          InsertPsshSet(adpSet->GetStreamType(), period, adpSet, currentPssh, currentDefaultKID);
+      currentPsshSetPos = InsertPsshSet(adpSet->GetStreamType(), period, adpSet, currentPssh,
+                                        currentDefaultKID, "", currentKeySystem);
 
       repr->m_psshSetPos = currentPsshSetPos;
       hasReprURN = true;
@@ -1034,6 +1153,9 @@ void adaptive::CDashTree::ParseTagRepresentation(pugi::xml_node nodeRepr,
   else if (adpSet->GetStreamType() == StreamType::AUDIO && repr->GetAudioChannels() == 0)
     repr->SetAudioChannels(2); // Fallback to 2 channels when no value is set
 
+  // Parse <InbandEventStream> tags
+  ParseTagInbandEventStream(nodeRepr);
+
   // Generate timeline segments
   if (!repr->HasSegmentTimeline() && repr->HasSegmentTemplate())
   {
@@ -1246,7 +1368,15 @@ uint64_t adaptive::CDashTree::ParseTagSegmentTimeline(xml_node nodeSegTL,
   uint64_t nextPts{0};
   for (xml_node node : nodeSegTL.children("S"))
   {
+    const uint64_t expectedPts{nextPts};
     XML::QueryAttrib(node, "t", nextPts);
+    // A hole in the timeline has no segments to download, the next segment keep its own
+    // start time so the streams stay aligned and the player resync on the time jump
+    if (!SCTimeline.IsEmpty() && nextPts > expectedPts)
+    {
+      LOG::LogF(LOGDEBUG, "Gap of %llu (timescale %u) in <SegmentTimeline> at time %llu",
+                nextPts - expectedPts, timescale, expectedPts);
+    }
     uint32_t duration = XML::GetAttribUint32(node, "d");
     uint32_t repeat = XML::GetAttribUint32(node, "r");
     repeat += 1;
@@ -1294,6 +1424,125 @@ uint64_t adaptive::CDashTree::ParseTagSegmentTimeline(xml_node nodeSegTL,
   return startPts;
 }
 
+void adaptive::CDashTree::ParseTagThumbnails(pugi::xml_node nodeAdp, PLAYLIST::CPeriod* period)
+{
+  // Get the tile grid from the DASH-IF thumbnail property, e.g. value="10x20"
+  auto parseTileLayout = [](xml_node node, uint32_t& columns, uint32_t& rows)
+  {
+    for (xml_node nodeProp : node.children("EssentialProperty"))
+    {
+      std::string_view schemeIdUri = XML::GetAttrib(nodeProp, "schemeIdUri");
+      if (schemeIdUri == "http://dashif.org/thumbnail_tile" ||
+          schemeIdUri == "http://dashif.org/guidelines/thumbnail_tile")
+      {
+        return std::sscanf(XML::GetAttrib(nodeProp, "value").data(), "%" SCNu32 "x%" SCNu32,
+                           &columns, &rows) == 2;
+      }
+    }
+    return false;
+  };
+
+  uint32_t adpColumns{1};
+  uint32_t adpRows{1};
+  parseTileLayout(nodeAdp, adpColumns, adpRows);
+
+  const std::string adpBaseUrl{ParseTagBaseURL(nodeAdp, period->GetBaseUrl())};
+
+  CSegmentTemplate adpSegTemplate;
+  if (period->HasSegmentTemplate())
+    adpSegTemplate = *period->GetSegmentTemplate();
+
+  xml_node nodeAdpSegTpl = nodeAdp.child("SegmentTemplate");
+  if (nodeAdpSegTpl)
+    ParseSegmentTemplate(nodeAdpSegTpl, &adpSegTemplate);
+
+  for (xml_node nodeRepr : nodeAdp.children("Representation"))
+  {
+    auto track = CThumbnailTrack::MakeUniquePtr();
+    track->SetId(XML::GetAttrib(nodeRepr, "id"));
+    track->SetBandwidth(XML::GetAttribUint32(nodeRepr, "bandwidth"));
+
+    std::string mimeType;
+    if (!XML::QueryAttrib(nodeRepr, "mimeType", mimeType))
+      mimeType = XML::GetAttrib(nodeAdp, "mimeType");
+    track->SetMimeType(mimeType);
+
+    uint32_t columns{adpColumns};
+    uint32_t rows{adpRows};
+    parseTileLayout(nodeRepr, columns, rows);
+    track->SetLayout(columns, rows);
+
+    // The resolution of the representation is the tile image one
+    int width{XML::GetAttribInt(nodeRepr, "width", XML::GetAttribInt(nodeAdp, "width"))};
+    int height{XML::GetAttribInt(nodeRepr, "height", XML::GetAttribInt(nodeAdp, "height"))};
+    track->SetThumbnailSize(width / static_cast<int>(track->GetColumns()),
+                            height / static_cast<int>(track->GetRows()));
+
+    const std::string baseUrl{ParseTagBaseURL(nodeRepr, adpBaseUrl, false)};
+
+    CSegmentTemplate segTemplate{adpSegTemplate};
+    xml_node nodeSegTpl = nodeRepr.child("SegmentTemplate");
+    if (nodeSegTpl)
+      ParseSegmentTemplate(nodeSegTpl, &segTemplate);
+    else
+      nodeSegTpl = nodeAdpSegTpl;
+
+    if (segTemplate.GetMedia().empty())
+    {
+      LOG::LogF(LOGWARNING, "Skipped thumbnails representation with id: \"%s\", "
+                "segment template not specified.", track->GetId().data());
+      continue;
+    }
+
+    std::string mediaUrl{
+        ReplacePlaceHolders(std::string(segTemplate.GetMedia()), track->GetId(),
+                            track->GetBandwidth())};
+    if (URL::IsUrlRelative(mediaUrl))
+      mediaUrl = URL::Join(baseUrl, mediaUrl);
+
+    const uint32_t timescale{segTemplate.GetTimescale() > 0 ? segTemplate.GetTimescale() : 1};
+
+    xml_node nodeSegTL = nodeSegTpl.child("SegmentTimeline");
+    if (nodeSegTL)
+    {
+      const uint64_t pto{XML::GetAttribUint64(nodeSegTpl, "presentationTimeOffset")};
+      uint64_t number{segTemplate.GetStartNumber()};
+      uint64_t time{0};
+
+      // Parse <S> tags - e.g. <S t="0" d="100000" r="2"/>
+      for (xml_node node : nodeSegTL.children("S"))
+      {
+        XML::QueryAttrib(node, "t", time);
+        const uint64_t duration{XML::GetAttribUint64(node, "d")};
+        if (duration == 0)
+          continue;
+
+        for (uint32_t repeat = XML::GetAttribUint32(node, "r") + 1; repeat > 0; --repeat)
+        {
+          const uint64_t startMs{time > pto ? (time - pto) * 1000 / timescale : 0};
+          track->AddImage(startMs, duration * 1000 / timescale, mediaUrl, number, time);
+          number++;
+          time += duration;
+        }
+      }
+    }
+    else
+    {
+      track->SetTemplate(mediaUrl, timescale, segTemplate.GetStartNumber(),
+                         segTemplate.GetDuration());
+    }
+
+    if (!track->HasImages())
+    {
+      LOG::LogF(LOGWARNING, "Skipped thumbnails representation with id: \"%s\", "
+                "no images found.", track->GetId().data());
+      continue;
+    }
+
+    period->AddThumbnailTrack(track);
+  }
+}
+
 void adaptive::CDashTree::ParseSegmentTemplate(pugi::xml_node node, CSegmentTemplate* segTpl)
 {
   uint32_t timescale;
@@ -1323,8 +1572,19 @@ void adaptive::CDashTree::ParseSegmentTemplate(pugi::xml_node node, CSegmentTemp
 bool adaptive::CDashTree::ParseTagContentProtection(pugi::xml_node nodeParent,
                                                     std::string& currentPssh,
                                                     std::string& currentDefaultKID,
+                                                    std::string& currentKeySystem,
                                                     bool& isSecureDecoderNeeded)
 {
+  // When the stream is protected by several supported key systems the cheapest one is used
+  std::vector<std::string_view> offeredKeySystems;
+  for (xml_node nodeCP : nodeParent.children("ContentProtection"))
+  {
+    offeredKeySystems.emplace_back(XML::GetAttrib(nodeCP, "schemeIdUri"));
+  }
+  const std::string_view selectedKeySystem{
+      DRM::SelectKeySystem(offeredKeySystems, m_supportedKeySystems)};
+  currentKeySystem = selectedKeySystem;
+
   // Parse <ContentProtection> tags to find "default_KID" attribute
   // We try read "default_KID" attribute on every ContentProtection type
   const char* defaultKID{nullptr};
@@ -1337,7 +1597,7 @@ bool adaptive::CDashTree::ParseTagContentProtection(pugi::xml_node nodeParent,
     std::string_view schemeIdUri = XML::GetAttrib(nodeCP, "schemeIdUri");
 
     if (schemeIdUri == "urn:mpeg:dash:mp4protection:2011" ||
-        STRING::CompareNoCase(schemeIdUri, m_supportedKeySystem))
+        DRM::IsSameKeySystem(schemeIdUri, selectedKeySystem))
     {
       // Parse first attribute that end with "... default_KID"
       // e.g. cenc:default_KID="01004b6f-0835-b807-9098-c070dc30a6c7"
@@ -1368,7 +1628,7 @@ bool adaptive::CDashTree::ParseTagContentProtection(pugi::xml_node nodeParent,
       isUrnProtectionFound = true;
 
     // Find Content protection compatible with current systemid
-    if (!STRING::CompareNoCase(schemeIdUri, m_supportedKeySystem))
+    if (!DRM::IsSameKeySystem(schemeIdUri, selectedKeySystem))
       continue;
 
     isUrnSchemeFound = true;
@@ -1386,6 +1646,15 @@ bool adaptive::CDashTree::ParseTagContentProtection(pugi::xml_node nodeParent,
       {
         playReadyPro = node.child_value();
       }
+      else if (StringUtils::EndsWith(childName, "Laurl")) // e.g. <dashif:Laurl> or <clearkey:Laurl>
+      {
+        // License acquisition URL, used when the license URL is not provided by the properties
+        if (m_licenseUrl.empty())
+        {
+          m_licenseUrl = node.child_value();
+          StringUtils::Trim(m_licenseUrl);
+        }
+      }
       else if (childName == "widevine:license")
       {
         // <widevine:license robustness_level="HW_SECURE_CODECS_REQUIRED"> Custom ISA tag
@@ -1412,7 +1681,11 @@ bool adaptive::CDashTree::ParseTagContentProtection(pugi::xml_node nodeParent,
 
     PRProtectionParser parser;
     if (parser.ParseHeader(playReadyPro))
+    {
       currentDefaultKID = parser.GetKID();
+      if (m_licenseUrl.empty())
+        m_licenseUrl = parser.GetLicenseURL();
+    }
   }
   else
   {
@@ -1436,6 +1709,90 @@ bool adaptive::CDashTree::ParseTagContentProtection(pugi::xml_node nodeParent,
   return isUrnSchemeFound;
 }
 
+void adaptive::CDashTree::ParseTagInbandEventStream(pugi::xml_node nodeParent)
+{
+  for (xml_node node : nodeParent.children("InbandEventStream"))
+  {
+    if (XML::GetAttrib(node, "schemeIdUri") == SCHEME_MPD_EVENT)
+      m_hasInbandMpdEvents = true;
+  }
+}
+
+void adaptive::CDashTree::ParseTagEventStream(pugi::xml_node nodePeriod)
+{
+  for (xml_node nodeEvStream : nodePeriod.children("EventStream"))
+  {
+    const std::string schemeIdUri{XML::GetAttrib(nodeEvStream, "schemeIdUri")};
+    const std::string value{XML::GetAttrib(nodeEvStream, "value")};
+    uint64_t timescale = XML::GetAttribUint64(nodeEvStream, "timescale", 1);
+    if (timescale == 0)
+      timescale = 1;
+
+    for (xml_node nodeEvent : nodeEvStream.children("Event"))
+    {
+      TimedEvent event;
+      event.m_schemeIdUri = schemeIdUri;
+      event.m_value = value;
+      event.m_id = XML::GetAttrib(nodeEvent, "id");
+      // The presentation time is relative to the period and the segment times include
+      // the presentationTimeOffset, the event stream is expected to use the same offset
+      event.m_time =
+          ToStreamTime(XML::GetAttribUint64(nodeEvent, "presentationTime"), timescale);
+      event.m_isManifestTime = true;
+      event.m_duration = ToStreamTime(XML::GetAttribUint64(nodeEvent, "duration"), timescale);
+
+      if (event.m_id.empty())
+        event.m_id = std::to_string(event.m_time);
+
+      if (schemeIdUri == SCHEME_SCTE35_XML_BIN)
+      {
+        // <Event><scte35:Signal><scte35:Binary>base64 splice_info_section</scte35:Binary>
+        xml_node nodeBinary = XML::FirstChildNoPrefix(XML::FirstChildNoPrefix(nodeEvent, "Signal"),
+                                                      "Binary");
+        event.m_messageData = BASE64::Decode(nodeBinary.child_value());
+        if (!ApplySpliceInfo(event, event.m_messageData))
+        {
+          LOG::LogF(LOGWARNING, "Cannot parse the SCTE-35 data of event id \"%s\"",
+                    event.m_id.c_str());
+        }
+      }
+      else
+      {
+        const char* messageData = XML::GetAttrib(nodeEvent, "messageData").data();
+        event.m_messageData = *messageData ? messageData : nodeEvent.child_value();
+      }
+
+      m_timedEvents.Add(event);
+    }
+  }
+}
+
+void adaptive::CDashTree::OnInbandEvent(const TimedEvent& event)
+{
+  if (event.m_schemeIdUri != SCHEME_MPD_EVENT)
+  {
+    AdaptiveTree::OnInbandEvent(event);
+    return;
+  }
+
+  if (!HasManifestUpdates())
+    return;
+
+  {
+    // The event is repeated by the segments of each stream until the manifest is updated
+    std::lock_guard<std::mutex> lock(m_mpdEventMutex);
+    if (m_lastMpdEventId == event.m_id)
+      return;
+    m_lastMpdEventId = event.m_id;
+  }
+
+  // Values: 1 MPD validity expiration, 2 MPD patch, 3 MPD update in the message,
+  // a full manifest update is done in all cases
+  LOG::Log(LOGDEBUG, "MPD event (value \"%s\", id %s), manifest update requested",
+           event.m_value.c_str(), event.m_id.c_str());
+  m_updThread.RefreshNow();
+}
+
 uint32_t adaptive::CDashTree::ParseAudioChannelConfig(pugi::xml_node node)
 {
   std::string_view schemeIdUri = XML::GetAttrib(node, "schemeIdUri");
@@ -1568,15 +1925,37 @@ void adaptive::CDashTree::RefreshLiveSegments()
   {
     m_manifestRespHeaders = updateTree->m_manifestRespHeaders;
     location_ = updateTree->location_;
+    m_timeShiftBufferDepth = updateTree->m_timeShiftBufferDepth;
+
+    // Add the new events, those already known are ignored
+    for (const TimedEvent& event : updateTree->m_timedEvents.GetEvents())
+    {
+      m_timedEvents.Add(event);
+    }
 
     // Youtube returns last smallest number in case the requested data is not available
     if (urlHaveStartNumber && updateTree->m_firstStartNumber < nextStartNumber)
       return;
 
+    // The periods removed are remembered until the manifest updates no longer provide them
+    m_prunedPeriods.erase(
+        std::remove_if(m_prunedPeriods.begin(), m_prunedPeriods.end(),
+                       [&updateTree](const PrunedPeriod& pruned)
+                       {
+                         return std::none_of(updateTree->m_periods.begin(),
+                                             updateTree->m_periods.end(),
+                                             [&pruned](const std::unique_ptr<CPeriod>& updPeriod)
+                                             { return pruned.IsSamePeriod(*updPeriod); });
+                       }),
+        m_prunedPeriods.end());
+
     for (size_t index{0}; index < updateTree->m_periods.size(); index++)
     {
       auto& updPeriod = updateTree->m_periods[index];
 
+      if (IsPrunedPeriod(*updPeriod))
+        continue;
+
       // find matching period based on ID
       auto itPeriod =
           std::find_if(m_periods.begin(), m_periods.end(),
@@ -1598,6 +1977,11 @@ void adaptive::CDashTree::RefreshLiveSegments()
 
       if (!period && updPeriod->GetId().empty() && updPeriod->GetStart() == 0)
       {
+        // The positions no longer match after the periods have been removed,
+        // a period without id and start cannot be identified then is ignored
+        if (m_hasPrunedPeriods)
+          continue;
+
         // not found, fallback match based on position
         if (index < m_periods.size())
           period = m_periods[index].get();
@@ -1650,6 +2034,23 @@ void adaptive::CDashTree::RefreshLiveSegments()
             {
               auto repr = (*itRepr).get();
 
+              // Key rotation, the DRM init data of the representation has been changed
+              if (repr->m_psshSetPos != PSSHSET_POS_DEFAULT &&
+                  updRepr->m_psshSetPos != PSSHSET_POS_DEFAULT)
+              {
+                const CPeriod::PSSHSet& psshSet = period->GetPSSHSets()[repr->m_psshSetPos];
+                const CPeriod::PSSHSet& updPsshSet =
+                    updPeriod->GetPSSHSets()[updRepr->m_psshSetPos];
+
+                if (updPsshSet.pssh_ != "FILE" && (updPsshSet.pssh_ != psshSet.pssh_ ||
+                                                   updPsshSet.defaultKID_ != psshSet.defaultKID_))
+                {
+                  LOG::LogF(LOGDEBUG, "PSSH changed on representation id: %s",
+                            repr->GetId().data());
+                  AddRotatedPsshSet(updPsshSet);
+                }
+              }
+
               if (!repr->SegmentTimeline().IsEmpty())
               {
                 if (urlHaveStartNumber) // Partitial update
@@ -1809,13 +2210,70 @@ void adaptive::CDashTree::RefreshLiveSegments()
                             updRepr->GetId().data(), repr->GetStartNumber());
                   m_totalTimeSecs = updateTree->m_totalTimeSecs;
                 }
+
+                // Some servers keep all the segments since the live start,
+                // limit the timeline to the time shift buffer depth
+                PruneSegments(period, repr, m_timeShiftBufferDepth);
               }
             }
           }
         }
       }
     }
+
+    PrunePeriods();
+  }
+}
+
+void adaptive::CDashTree::PrunePeriods()
+{
+  if (m_timeShiftBufferDepth == 0 || !m_currentPeriod)
+    return;
+
+  // Time shift buffer start (ms), relative to the availability start time as the periods start
+  const uint64_t nowTime = GetTimestamp() * 1000;
+  const uint64_t availableTime = available_time_ * 1000;
+  if (nowTime < availableTime + m_timeShiftBufferDepth)
+    return;
+  const uint64_t windowStart = nowTime - availableTime - m_timeShiftBufferDepth;
+
+  auto itCurrent = std::find_if(m_periods.begin(), m_periods.end(),
+                                [this](const std::unique_ptr<CPeriod>& period)
+                                { return period.get() == m_currentPeriod; });
+  if (itCurrent == m_periods.end())
+    return;
+
+  // Remove the periods played that ended before the time shift buffer start
+  auto itPeriod = m_periods.begin();
+  for (; itPeriod != itCurrent; itPeriod++)
+  {
+    const uint64_t nextStart = (*(itPeriod + 1))->GetStart();
+    if (nextStart == NO_PTS_VALUE || nextStart > windowStart)
+      break;
+
+    for (auto& adpSet : (*itPeriod)->GetAdaptationSets())
+    {
+      for (auto& repr : adpSet->GetRepresentations())
+      {
+        m_initSegmentCache.Remove(repr.get());
+      }
+    }
+    m_prunedPeriods.push_back({std::string((*itPeriod)->GetId()), (*itPeriod)->GetStart()});
+    m_hasPrunedPeriods = true;
   }
+
+  if (itPeriod != m_periods.begin())
+  {
+    LOG::LogF(LOGDEBUG, "Removed %zu periods out of the time shift buffer",
+              static_cast<size_t>(itPeriod - m_periods.begin()));
+    m_periods.erase(m_periods.begin(), itPeriod);
+  }
+}
+
+bool adaptive::CDashTree::IsPrunedPeriod(const PLAYLIST::CPeriod& period) const
+{
+  return std::any_of(m_prunedPeriods.begin(), m_prunedPeriods.end(),
+                     [&period](const PrunedPeriod& pruned) { return pruned.IsSamePeriod(period); });
 }
 
 uint64_t adaptive::CDashTree::GetTimestamp()
@@ -14,6 +14,8 @@
 #include "../common/Period.h"
 #include "../common/SegTemplate.h"
 
+#include <mutex>
+#include <optional>
 #include <string_view>
 
 // Forward
@@ -48,14 +50,45 @@ public:
    */
   virtual void SetManifestUpdateParam(std::string& manifestUrl, std::string_view param) override;
 
+  /*!
+   * \brief Request a manifest update when an MPD event (urn:mpeg:dash:event:2012)
+   *        signal the expiration of the manifest, the other events are queued.
+   */
+  void OnInbandEvent(const TimedEvent& event) override;
+
+  /*!
+   * \brief Check if the manifest declare MPD events carried in the segments (emsg).
+   */
+  bool HasInbandMpdEvents() const { return m_hasInbandMpdEvents; }
+
 protected:
   virtual CDashTree* Clone() const override { return new CDashTree{*this}; }
 
   virtual bool ParseManifest(std::string& data);
 
   void ParseTagMPDAttribs(pugi::xml_node NodeMPD);
+
+  /*!
+   * \brief Parse the <BaseURL> tags of a node, with content steering the base url
+   *        of the default service location is selected, the others are added as
+   *        pathway urls, otherwise the first one is selected.
+   * \param node The parent node of <BaseURL> tags
+   * \param parentUrl The base url of the parent node
+   * \param isDirectory Ensure that the base url ends with backslash
+   * \return The base url selected, or the parent url if there are no <BaseURL> tags
+   */
+  std::string ParseTagBaseURL(pugi::xml_node node,
+                              std::string_view parentUrl,
+                              bool isDirectory = true);
   void ParseTagPeriod(pugi::xml_node nodePeriod, std::string_view mpdUrl);
   void ParseTagAdaptationSet(pugi::xml_node nodeAdp, PLAYLIST::CPeriod* period);
+
+  /*!
+   * \brief Parse an image adaptation set (DASH-IF thumbnail tiles), each
+   *        representation is added to the period as thumbnail track.
+   */
+  void ParseTagThumbnails(pugi::xml_node nodeAdp, PLAYLIST::CPeriod* period);
+
   void ParseTagRepresentation(pugi::xml_node nodeRepr,
                               PLAYLIST::CAdaptationSet* adpSet,
                               PLAYLIST::CPeriod* period,
@@ -75,10 +108,18 @@ protected:
   bool ParseTagContentProtection(pugi::xml_node nodeCP,
                                  std::string& currentPssh,
                                  std::string& currentDefaultKID,
+                                 std::string& currentKeySystem,
                                  bool& isSecureDecoderNeeded);
 
   uint32_t ParseAudioChannelConfig(pugi::xml_node node);
 
+  void ParseTagInbandEventStream(pugi::xml_node nodeParent);
+
+  /*!
+   * \brief Parse the <EventStream> tags of the period, the events are queued as timed events.
+   */
+  void ParseTagEventStream(pugi::xml_node nodePeriod);
+
   /*
    * \brief Estimate the count of segments on the period duration
    */
@@ -91,6 +132,12 @@ protected:
 
   virtual void RefreshLiveSegments() override;
 
+  // Remove the periods played that are out of the time shift buffer
+  void PrunePeriods();
+
+  // Check if a period of the manifest update has been removed by PrunePeriods
+  bool IsPrunedPeriod(const PLAYLIST::CPeriod& period) const;
+
   /*
    * \brief Get the current timestamp, overridable method for test project
    */
@@ -105,5 +152,29 @@ protected:
 
   // Period sequence incremented to every new period added
   uint32_t m_periodCurrentSeq{0};
+
+  // The segments signal the MPD expiration with in-band events
+  bool m_hasInbandMpdEvents{false};
+  // Id of the last MPD event handled
+  std::mutex m_mpdEventMutex;
+  std::optional<std::string> m_lastMpdEventId;
+
+  struct PrunedPeriod
+  {
+    // Periods are matched by id, or by start when they have no id
+    bool IsSamePeriod(const PLAYLIST::CPeriod& period) const
+    {
+      if (!m_id.empty() || !period.GetId().empty())
+        return m_id == period.GetId();
+      return m_start != 0 && m_start == period.GetStart();
+    }
+
+    std::string m_id;
+    uint64_t m_start{0};
+  };
+  // The periods removed by PrunePeriods that the manifest updates still provide,
+  // they must not be added again
+  std::vector<PrunedPeriod> m_prunedPeriods;
+  bool m_hasPrunedPeriods{false};
 };
 } // namespace adaptive
@@ -9,14 +9,19 @@
 #include "HLSTree.h"
 
 #include "../aes_decrypter.h"
+#include "../common/KeySystemHandlers.h"
 #include "../utils/Base64Utils.h"
 #include "../utils/StringUtils.h"
 #include "../utils/UrlUtils.h"
 #include "../utils/Utils.h"
+#include "../utils/XMLUtils.h"
 #include "../utils/log.h"
 #include "kodi/tools/StringUtils.h"
 
+#include <algorithm> // max
+#include <limits>
 #include <optional>
+#include <set>
 #include <sstream>
 
 using namespace PLAYLIST;
@@ -76,6 +81,45 @@ std::map<std::string, std::string> ParseTagAttributes(const std::string& tagValu
   return tagAttribs;
 }
 
+// \brief Parse an ISO 8601 date time with optional fraction of seconds,
+//        e.g. 2023-01-01T10:00:05.250Z, to milliseconds
+std::optional<uint64_t> ParseDateTimeMs(std::string_view dateTime)
+{
+  const uint64_t secs = XML::ParseDate(dateTime);
+  if (secs == std::numeric_limits<uint64_t>::max())
+    return std::nullopt;
+
+  uint64_t ms{0};
+  const size_t fractionPos = dateTime.find('.');
+  if (fractionPos != std::string_view::npos)
+  {
+    uint64_t multiplier{100};
+    for (size_t i = fractionPos + 1; i < dateTime.size() && multiplier > 0; ++i)
+    {
+      if (dateTime[i] < '0' || dateTime[i] > '9')
+        break;
+      ms += (dateTime[i] - '0') * multiplier;
+      multiplier /= 10;
+    }
+  }
+  return secs * 1000 + ms;
+}
+
+// \brief Convert an hexadecimal string (e.g. 0xFC30...) to bytes
+std::string HexToBytes(std::string_view hex)
+{
+  if (hex.size() >= 2 && hex[0] == '0' && (hex[1] == 'x' || hex[1] == 'X'))
+    hex.remove_prefix(2);
+
+  std::string bytes;
+  for (size_t i = 0; i + 1 < hex.size(); i += 2)
+  {
+    bytes.push_back(
+        static_cast<char>((STRING::ToHexNibble(hex[i]) << 4) | STRING::ToHexNibble(hex[i + 1])));
+  }
+  return bytes;
+}
+
 void ParseResolution(int& width, int& height, std::string_view val)
 {
   size_t pos = val.find('x');
@@ -203,7 +247,8 @@ PLAYLIST::PrepareRepStatus adaptive::CHLSTree::prepareRepresentation(PLAYLIST::C
   {
     // do nothing
   }
-  else if (DownloadManifest(rep->GetSourceUrl(), {}, data, respHeaders))
+  // With content steering the playlist is downloaded from the current pathway
+  else if (DownloadManifest(BuildDownloadUrl(rep->GetSourceUrl()), {}, data, respHeaders))
   {
     // Parse child playlist
 
@@ -212,6 +257,11 @@ PLAYLIST::PrepareRepStatus adaptive::CHLSTree::prepareRepresentation(PLAYLIST::C
     std::string baseUrl = URL::RemoveParameters(respHeaders.m_effectiveUrl);
 
     EncryptionType currentEncryptionType = EncryptionType::CLEAR;
+    // Multiple keys can apply to the same segments (e.g. one for each DRM),
+    // the segments are not playable only when none of them is supported
+    bool hasKeyNotSupported{false};
+    bool hasKeySupported{false};
+    m_hasDrmKey = false;
 
     uint64_t currentSegStartPts{0};
     uint64_t newStartNumber{0};
@@ -219,6 +269,7 @@ PLAYLIST::PrepareRepStatus adaptive::CHLSTree::prepareRepresentation(PLAYLIST::C
     CSpinCache<CSegment> newSegments;
     std::optional<CSegment> newSegment;
     bool segmentHasByteRange{false};
+    bool isGapSegment{false}; // EXT-X-GAP apply to the next segment
     // Pssh set used between segments
     uint16_t psshSetPos = PSSHSET_POS_DEFAULT;
 
@@ -228,6 +279,10 @@ PLAYLIST::PrepareRepStatus adaptive::CHLSTree::prepareRepresentation(PLAYLIST::C
 
     uint32_t discontCount{0};
 
+    // Wall clock time (ms) of EXT-X-PROGRAM-DATE-TIME and the start pts of its segment
+    std::optional<uint64_t> programDateTime;
+    uint64_t programDateTimePts{0};
+
     bool isExtM3Uformat{false};
 
     std::stringstream streamData{data};
@@ -254,21 +309,31 @@ PLAYLIST::PrepareRepStatus adaptive::CHLSTree::prepareRepresentation(PLAYLIST::C
       {
         auto attribs = ParseTagAttributes(tagValue);
 
-        switch (ProcessEncryption(base_url_, attribs))
+        const bool hasDrmKey{m_hasDrmKey};
+        const EncryptionType encryptionType = ProcessEncryption(base_url_, attribs);
+        if (encryptionType == EncryptionType::NOT_SUPPORTED)
+          hasKeyNotSupported = true;
+        else if (encryptionType != EncryptionType::UNKNOWN)
+          hasKeySupported = true;
+
+        switch (encryptionType)
         {
-          case EncryptionType::NOT_SUPPORTED:
-            period->SetEncryptionState(EncryptionState::ENCRYPTED);
-            return PrepareRepStatus::FAILURE;
           case EncryptionType::AES128:
-            currentEncryptionType = EncryptionType::AES128;
+          case EncryptionType::SAMPLE_AES:
+            currentEncryptionType = encryptionType;
             psshSetPos = PSSHSET_POS_DEFAULT;
             break;
-          case EncryptionType::WIDEVINE:
-            currentEncryptionType = EncryptionType::WIDEVINE;
+          case EncryptionType::DRM:
+            currentEncryptionType = EncryptionType::DRM;
             period->SetEncryptionState(EncryptionState::ENCRYPTED_SUPPORTED);
 
+            // The key replace the one of a more expensive key system
+            if (hasDrmKey)
+              period->DecrasePSSHSetUsageCount(rep->m_psshSetPos);
+
             rep->m_psshSetPos = InsertPsshSet(adp->GetStreamType(), period, adp, m_currentPssh,
-                                              m_currentDefaultKID, m_currentIV);
+                                              m_currentDefaultKID, m_currentIV,
+                                              m_currentKeySystem);
             if (period->GetPSSHSets()[rep->GetPsshSetPos()].m_usageCount == 1 ||
                 prepareStatus == PrepareRepStatus::DRMCHANGED)
             {
@@ -337,6 +402,15 @@ PLAYLIST::PrepareRepStatus adaptive::CHLSTree::prepareRepresentation(PLAYLIST::C
       }
       else if (tagName == "#EXTINF")
       {
+        if (hasKeyNotSupported && !hasKeySupported)
+        {
+          period->SetEncryptionState(EncryptionState::ENCRYPTED);
+          return PrepareRepStatus::FAILURE;
+        }
+        hasKeyNotSupported = false;
+        hasKeySupported = false;
+        m_hasDrmKey = false;
+
         // Make a new segment
         newSegment = CSegment();
         newSegment->startPTS_ = currentSegStartPts;
@@ -347,6 +421,92 @@ PLAYLIST::PrepareRepStatus adaptive::CHLSTree::prepareRepresentation(PLAYLIST::C
 
         currentSegStartPts += duration;
       }
+      else if (tagName == "#EXT-X-PROGRAM-DATE-TIME")
+      {
+        programDateTime = ParseDateTimeMs(tagValue);
+        programDateTimePts = currentSegStartPts;
+      }
+      else if (tagName == "#EXT-X-DATERANGE")
+      {
+        auto attribs = ParseTagAttributes(tagValue);
+
+        TimedEvent event;
+        event.m_schemeIdUri = tagName;
+        event.m_value = attribs["CLASS"];
+        event.m_id = attribs["ID"];
+        event.m_isManifestTime = true;
+
+        // Place the date range on the timeline from the program date time, when missing
+        // the date range is expected to start with the next segment
+        uint64_t startPts{currentSegStartPts};
+        const std::optional<uint64_t> startDate = ParseDateTimeMs(attribs["START-DATE"]);
+        if (programDateTime.has_value() && startDate.has_value())
+        {
+          const int64_t offset{(static_cast<int64_t>(*startDate) -
+                                static_cast<int64_t>(*programDateTime)) *
+                               static_cast<int64_t>(rep->GetTimescale()) / 1000};
+          startPts = static_cast<uint64_t>(
+              std::max<int64_t>(static_cast<int64_t>(programDateTimePts) + offset, 0));
+        }
+        event.m_time = ToStreamTime(startPts, rep->GetTimescale());
+
+        std::string duration = attribs["DURATION"];
+        if (duration.empty())
+          duration = attribs["PLANNED-DURATION"];
+        if (!duration.empty())
+          event.m_duration = static_cast<uint64_t>(STRING::ToDouble(duration) * STREAM_TIME_BASE);
+
+        if (STRING::KeyExists(attribs, "SCTE35-OUT"))
+        {
+          event.m_messageData = HexToBytes(attribs["SCTE35-OUT"]);
+          ApplySpliceInfo(event, event.m_messageData);
+          event.m_type = TimedEventType::AD_START;
+        }
+        else if (STRING::KeyExists(attribs, "SCTE35-IN"))
+        {
+          event.m_messageData = HexToBytes(attribs["SCTE35-IN"]);
+          ApplySpliceInfo(event, event.m_messageData);
+          event.m_type = TimedEventType::AD_END;
+        }
+        else if (STRING::KeyExists(attribs, "SCTE35-CMD"))
+        {
+          event.m_messageData = HexToBytes(attribs["SCTE35-CMD"]);
+          ApplySpliceInfo(event, event.m_messageData);
+        }
+
+        if (event.m_id.empty())
+          LOG::LogF(LOGWARNING, "Ignored EXT-X-DATERANGE without ID attribute");
+        else
+          m_timedEvents.Add(event);
+      }
+      else if (tagName == "#EXT-X-CUE-OUT" || tagName == "#EXT-X-CUE-IN")
+      {
+        // Ad break markers, the tag apply to the next segment
+        TimedEvent event;
+        event.m_schemeIdUri = tagName;
+        event.m_value = tagValue;
+        event.m_id = std::to_string(newStartNumber + newSegments.GetSize());
+        event.m_time = ToStreamTime(currentSegStartPts, rep->GetTimescale());
+        event.m_isManifestTime = true;
+
+        if (tagName == "#EXT-X-CUE-OUT")
+        {
+          event.m_type = TimedEventType::AD_START;
+          // The duration can be set as value or attribute, e.g. "30" or "DURATION=30"
+          std::string duration = tagValue;
+          if (duration.find('=') != std::string::npos)
+            duration = ParseTagAttributes(tagValue)["DURATION"];
+          if (!duration.empty())
+          {
+            event.m_duration =
+                static_cast<uint64_t>(STRING::ToDouble(duration) * STREAM_TIME_BASE);
+          }
+        }
+        else
+          event.m_type = TimedEventType::AD_END;
+
+        m_timedEvents.Add(event);
+      }
       else if (tagName == "#EXT-X-BYTERANGE" && newSegment.has_value())
       {
         ParseRangeValues(tagValue, newSegment->range_end_, newSegment->range_begin_);
@@ -435,21 +595,36 @@ PLAYLIST::PrepareRepStatus adaptive::CHLSTree::prepareRepresentation(PLAYLIST::C
             rep->SetUrl(url);
         }
 
-        if (currentEncryptionType == EncryptionType::AES128)
+        if (currentEncryptionType == EncryptionType::AES128 ||
+            currentEncryptionType == EncryptionType::SAMPLE_AES)
         {
           if (psshSetPos == PSSHSET_POS_DEFAULT)
           {
+            // The crypto mode of the PSSH set tell to the segment download if the
+            // whole segment must be decrypted (AES-128) or only the samples (SAMPLE-AES)
+            const CryptoMode cryptoMode{m_cryptoMode};
+            m_cryptoMode = currentEncryptionType == EncryptionType::SAMPLE_AES
+                               ? CryptoMode::AES_CBC
+                               : CryptoMode::NONE;
             psshSetPos = InsertPsshSet(StreamType::NOTYPE, period, adp, m_currentPssh,
                                        m_currentDefaultKID, m_currentIV);
+            m_cryptoMode = cryptoMode;
             newSegment->pssh_set_ = psshSetPos;
           }
           else
             period->InsertPSSHSet(newSegment->pssh_set_);
         }
 
+        newSegment->m_isGap = isGapSegment;
+        isGapSegment = false;
+
         newSegments.GetData().emplace_back(*newSegment);
         newSegment.reset();
       }
+      else if (tagName == "#EXT-X-GAP")
+      {
+        isGapSegment = true;
+      }
       else if (tagName == "#EXT-X-DISCONTINUITY-SEQUENCE")
       {
         m_discontSeq = STRING::ToUint32(tagValue);
@@ -467,6 +642,11 @@ PLAYLIST::PrepareRepStatus adaptive::CHLSTree::prepareRepresentation(PLAYLIST::C
           {
             if ((*itPeriod).get() != m_currentPeriod)
             {
+              for (auto& adpSet : (*itPeriod)->GetAdaptationSets())
+              {
+                for (auto& repr : adpSet->GetRepresentations())
+                  m_initSegmentCache.Remove(repr.get());
+              }
               itPeriod = m_periods.erase(itPeriod);
             }
             else
@@ -534,11 +714,12 @@ PLAYLIST::PrepareRepStatus adaptive::CHLSTree::prepareRepresentation(PLAYLIST::C
         rep = adp->GetRepresentations()[reprPos].get();
 
         currentSegStartPts = 0;
+        programDateTime.reset();
 
-        if (currentEncryptionType == EncryptionType::WIDEVINE)
+        if (currentEncryptionType == EncryptionType::DRM)
         {
           rep->m_psshSetPos = InsertPsshSet(adp->GetStreamType(), period, adp, m_currentPssh,
-                                            m_currentDefaultKID, m_currentIV);
+                                            m_currentDefaultKID, m_currentIV, m_currentKeySystem);
           period->SetEncryptionState(EncryptionState::ENCRYPTED_SUPPORTED);
         }
 
@@ -723,6 +904,12 @@ void adaptive::CHLSTree::OnDataArrived(uint64_t segNum,
       segBuffer.insert(segBufferSize, srcDataSize, 0);
       return;
     }
+    else if (pssh.m_cryptoMode == CryptoMode::AES_CBC)
+    {
+      // SAMPLE-AES, the samples are decrypted by the sample reader after demux
+      segBuffer.append(srcData, srcDataSize);
+      return;
+    }
     else if (!segBufferSize)
     {
       if (pssh.iv.empty())
@@ -748,6 +935,35 @@ void adaptive::CHLSTree::OnDataArrived(uint64_t segNum,
                                 isLastChunk);
 }
 
+bool adaptive::CHLSTree::GetSampleAesKey(uint16_t psshSet,
+                                         uint64_t segNum,
+                                         std::string& key,
+                                         uint8_t* iv)
+{
+  if (!psshSet)
+    return false;
+
+  std::lock_guard<TreeUpdateThread> lckUpdTree(GetTreeUpdMutex());
+
+  const std::vector<CPeriod::PSSHSet>& psshSets = m_currentPeriod->GetPSSHSets();
+  if (psshSet >= psshSets.size())
+    return false;
+
+  const CPeriod::PSSHSet& pssh = psshSets[psshSet];
+  if (pssh.m_cryptoMode != CryptoMode::AES_CBC || pssh.defaultKID_.size() != 16)
+    return false;
+
+  key = pssh.defaultKID_;
+  if (pssh.iv.empty())
+    m_decrypter->ivFromSequence(iv, segNum);
+  else
+  {
+    memset(iv, 0, 16);
+    memcpy(iv, pssh.iv.data(), pssh.iv.size() < 16 ? pssh.iv.size() : 16);
+  }
+  return true;
+}
+
 //Called each time before we switch to a new segment
 void adaptive::CHLSTree::RefreshSegments(PLAYLIST::CPeriod* period,
                                          PLAYLIST::CAdaptationSet* adp,
@@ -789,6 +1005,80 @@ void adaptive::CHLSTree::RefreshLiveSegments()
   }
 }
 
+bool adaptive::CHLSTree::PrepareThumbnailTrack(PLAYLIST::CThumbnailTrack* track)
+{
+  std::string data;
+  HTTPRespHeaders respHeaders;
+
+  if (!DownloadManifest(BuildDownloadUrl(std::string(track->GetSourceUrl())), {}, data,
+                        respHeaders))
+    return false;
+
+  const std::string baseUrl{URL::RemoveParameters(respHeaders.m_effectiveUrl)};
+  bool isExtM3Uformat{false};
+  uint64_t startMs{0};
+  uint64_t durationMs{0};
+
+  std::stringstream streamData{data};
+
+  for (std::string line; STRING::GetLine(streamData, line);)
+  {
+    std::string tagName;
+    std::string tagValue;
+    ParseTagNameValue(line, tagName, tagValue);
+
+    // Find the extended M3U file initialization tag
+    if (!isExtM3Uformat)
+    {
+      if (tagName == "#EXTM3U")
+        isExtM3Uformat = true;
+      continue;
+    }
+
+    if (tagName == "#EXTINF")
+    {
+      durationMs = static_cast<uint64_t>(STRING::ToFloat(tagValue) * 1000);
+    }
+    else if (tagName == "#EXT-X-TILES")
+    {
+      // #EXT-X-TILES:RESOLUTION=320x180,LAYOUT=5x4,DURATION=2.002
+      auto attribs = ParseTagAttributes(tagValue);
+
+      int width{track->GetThumbnailWidth()};
+      int height{track->GetThumbnailHeight()};
+      ParseResolution(width, height, attribs["RESOLUTION"]);
+      track->SetThumbnailSize(width, height);
+
+      int columns{1};
+      int rows{1};
+      ParseResolution(columns, rows, attribs["LAYOUT"]);
+      track->SetLayout(static_cast<uint32_t>(std::max(columns, 1)),
+                       static_cast<uint32_t>(std::max(rows, 1)));
+
+      if (STRING::KeyExists(attribs, "DURATION"))
+        track->SetThumbnailDuration(
+            static_cast<uint64_t>(STRING::ToFloat(attribs["DURATION"]) * 1000));
+    }
+    else if (!line.empty() && line[0] != '#')
+    {
+      std::string url{line};
+      if (URL::IsUrlRelative(url))
+        url = URL::Join(baseUrl, url);
+
+      track->AddImage(startMs, durationMs, url);
+      startMs += durationMs;
+      durationMs = 0;
+    }
+  }
+
+  if (!isExtM3Uformat)
+  {
+    LOG::LogF(LOGERROR, "Non-compliant HLS image playlist, #EXTM3U tag not found.");
+    return false;
+  }
+  return track->HasImages();
+}
+
 bool adaptive::CHLSTree::ParseManifest(const std::string& data)
 {
   // Parse master playlist
@@ -798,6 +1088,22 @@ bool adaptive::CHLSTree::ParseManifest(const std::string& data)
   // Determine if is needed create a dummy audio representation for audio stream embedded on video stream
   bool createDummyAudioRepr{false};
 
+  // The session keys are not supported only when none of them is supported (e.g. one for each DRM)
+  bool hasSessionKeyNotSupported{false};
+  bool hasSessionKeySupported{false};
+
+  // Content steering, the variants of other pathways are not added as representations
+  std::string steeringServerUrl;
+  std::string defaultPathway;
+  std::vector<PathwayVariant> pathwayVariants;
+
+  // Closed captions by group id, and the groups referenced by the variant streams
+  std::map<std::string, std::vector<ClosedCaption>> closedCaptionGroups;
+  std::set<std::string> variantClosedCaptions;
+
+  // Playlist urls of the video variants, by the rendition group ids they reference
+  std::map<std::string, std::set<std::string>> groupVariantUrls;
+
   std::unique_ptr<CPeriod> period = CPeriod::MakeUniquePtr();
   period->SetTimescale(1000000);
 
@@ -821,10 +1127,41 @@ bool adaptive::CHLSTree::ParseManifest(const std::string& data)
       continue;
     }
 
-    if (tagName == "#EXT-X-MEDIA")
+    if (tagName == "#EXT-X-CONTENT-STEERING")
+    {
+      auto attribs = ParseTagAttributes(tagValue);
+
+      if (!attribs["SERVER-URI"].empty())
+      {
+        steeringServerUrl = URL::IsUrlAbsolute(attribs["SERVER-URI"])
+                                ? attribs["SERVER-URI"]
+                                : URL::Join(base_url_, attribs["SERVER-URI"]);
+        defaultPathway = attribs["PATHWAY-ID"];
+      }
+    }
+    else if (tagName == "#EXT-X-MEDIA")
     {
       auto attribs = ParseTagAttributes(tagValue);
 
+      if (attribs["TYPE"] == "CLOSED-CAPTIONS")
+      {
+        // Captions carried in the video SEI, the INSTREAM-ID is CC1..CC4 or SERVICE1..SERVICE63
+        const std::string& instreamId = attribs["INSTREAM-ID"];
+        if (!STRING::StartsWith(instreamId, "CC") && !STRING::StartsWith(instreamId, "SERVICE"))
+        {
+          LOG::LogF(LOGWARNING, "Skipped CLOSED-CAPTIONS with unsupported INSTREAM-ID (%s)",
+                    tagValue.c_str());
+          continue;
+        }
+        ClosedCaption closedCaption;
+        closedCaption.m_instreamId = instreamId;
+        closedCaption.m_language = attribs["LANGUAGE"];
+        closedCaption.m_name = attribs["NAME"];
+        closedCaption.m_isDefault = attribs["DEFAULT"] == "YES";
+        closedCaptionGroups[attribs["GROUP-ID"]].push_back(closedCaption);
+        continue;
+      }
+
       StreamType streamType = StreamType::NOTYPE;
       if (attribs["TYPE"] == "AUDIO")
         streamType = StreamType::AUDIO;
@@ -935,6 +1272,10 @@ bool adaptive::CHLSTree::ParseManifest(const std::string& data)
         createDummyAudioRepr = true;
       }
 
+      // The enumerated value NONE signal that there are no closed captions
+      if (STRING::KeyExists(attribs, "CLOSED-CAPTIONS") && attribs["CLOSED-CAPTIONS"] != "NONE")
+        variantClosedCaptions.insert(attribs["CLOSED-CAPTIONS"]);
+
       if (STRING::KeyExists(attribs, "FRAME-RATE"))
       {
         double frameRate = STRING::ToFloat(attribs["FRAME-RATE"]);
@@ -957,6 +1298,33 @@ bool adaptive::CHLSTree::ParseManifest(const std::string& data)
       {
         std::string sourceUrl = BuildDownloadUrl(line);
 
+        if (!steeringServerUrl.empty())
+        {
+          // Variants without PATHWAY-ID belong to the "." pathway
+          std::string pathwayId = attribs["PATHWAY-ID"].empty() ? "." : attribs["PATHWAY-ID"];
+          if (defaultPathway.empty())
+            defaultPathway = pathwayId;
+
+          pathwayVariants.push_back({pathwayId, sourceUrl, repr->GetBandwidth(), repr->GetWidth(),
+                                     repr->GetHeight(), attribs["AUDIO"], attribs["SUBTITLES"]});
+          if (pathwayId != defaultPathway)
+            continue;
+        }
+
+        // An audio only variant (e.g. a fallback that reuse a rendition playlist)
+        // does not carry the renditions of the groups referenced
+        const bool isVideoVariant{!STRING::KeyExists(attribs, "CODECS") ||
+                                  STRING::KeyExists(attribs, "RESOLUTION") ||
+                                  !GetVideoCodecFamily(attribs["CODECS"]).empty()};
+        if (isVideoVariant)
+        {
+          for (const char* groupAttrib : {"AUDIO", "SUBTITLES"})
+          {
+            if (STRING::KeyExists(attribs, groupAttrib))
+              groupVariantUrls[attribs[groupAttrib]].emplace(sourceUrl);
+          }
+        }
+
         // Ensure that we do not add duplicate URLs / representations
         auto itRepr =
             std::find_if(adpSet->GetRepresentations().begin(), adpSet->GetRepresentations().end(),
@@ -975,6 +1343,35 @@ bool adaptive::CHLSTree::ParseManifest(const std::string& data)
         streamData.seekg(currentStreamPos);
       }
     }
+    else if (tagName == "#EXT-X-IMAGE-STREAM-INF")
+    {
+      // #EXT-X-IMAGE-STREAM-INF:BANDWIDTH=16460,RESOLUTION=320x180,CODECS="jpeg",URI="thumbs.m3u8"
+      auto attribs = ParseTagAttributes(tagValue);
+
+      if (attribs["URI"].empty())
+      {
+        LOG::LogF(LOGERROR, "Skipped EXT-X-IMAGE-STREAM-INF due to missing uri attribute (%s)",
+                  tagValue.c_str());
+        continue;
+      }
+      // With content steering the image playlist of the default pathway is used
+      if (!steeringServerUrl.empty() && !attribs["PATHWAY-ID"].empty() &&
+          !defaultPathway.empty() && attribs["PATHWAY-ID"] != defaultPathway)
+        continue;
+
+      auto track = CThumbnailTrack::MakeUniquePtr();
+      track->SetId(std::to_string(period->GetThumbnailTracks().size()));
+      track->SetBandwidth(STRING::ToUint32(attribs["BANDWIDTH"]));
+      track->SetMimeType(attribs["CODECS"] == "png" ? "image/png" : "image/jpeg");
+      track->SetSourceUrl(BuildDownloadUrl(attribs["URI"]));
+
+      int width{0};
+      int height{0};
+      ParseResolution(width, height, attribs["RESOLUTION"]);
+      track->SetThumbnailSize(width, height);
+
+      period->AddThumbnailTrack(track);
+    }
     else if (tagName == "#EXTINF")
     {
       // This is not a multi - bitrate playlist
@@ -1006,12 +1403,16 @@ bool adaptive::CHLSTree::ParseManifest(const std::string& data)
       switch (ProcessEncryption(base_url_, attribs))
       {
         case EncryptionType::NOT_SUPPORTED:
-          return false;
+          hasSessionKeyNotSupported = true;
+          break;
         case EncryptionType::AES128:
-        case EncryptionType::WIDEVINE:
+        case EncryptionType::SAMPLE_AES:
+        case EncryptionType::DRM:
+        case EncryptionType::DRM_SKIPPED:
           // #EXT-X-SESSION-KEY is meant for preparing DRM without
           // loading sub-playlist. As long our workflow is serial, we
           // don't profite and therefore do not any action.
+          hasSessionKeySupported = true;
           break;
         case EncryptionType::UNKNOWN:
           LOG::LogF(LOGWARNING, "Unknown encryption type");
@@ -1028,6 +1429,25 @@ bool adaptive::CHLSTree::ParseManifest(const std::string& data)
     return false;
   }
 
+  if (hasSessionKeyNotSupported && !hasSessionKeySupported)
+  {
+    LOG::LogF(LOGERROR, "None of the #EXT-X-SESSION-KEY key formats is supported");
+    return false;
+  }
+
+  // Closed captions of the variant streams, carried in the video
+  if (!variantClosedCaptions.empty() && !period->GetAdaptationSets().empty())
+  {
+    CAdaptationSet* adpSet = period->GetAdaptationSets()[0].get();
+    for (const std::string& groupId : variantClosedCaptions)
+    {
+      for (const ClosedCaption& closedCaption : closedCaptionGroups[groupId])
+      {
+        adpSet->AddClosedCaption(closedCaption);
+      }
+    }
+  }
+
   if (createDummyAudioRepr)
   {
     // We may need to create the Default / Dummy audio representation
@@ -1062,13 +1482,50 @@ bool adaptive::CHLSTree::ParseManifest(const std::string& data)
     period->AddAdaptationSet(newAdpSet);
   }
 
+  if (!steeringServerUrl.empty() && !m_contentSteering.IsEnabled())
+  {
+    m_contentSteering.Initialize(CContentSteering::Protocol::HLS, steeringServerUrl,
+                                 defaultPathway);
+    AddSteeringPathways(pathwayVariants);
+  }
+
   // Add adaptation sets from groups
   for (auto& group : m_extGroups)
   {
+    // A rendition with the same playlist of the video variants that reference
+    // its group is multiplexed in the variant stream
+    const std::set<std::string>& variantUrls = groupVariantUrls[group.first];
+
+    // Renditions included in the variant are demuxed from the same download,
+    // each one from the elementary stream at the same position of the rendition
+    std::map<StreamType, size_t> includedCount;
+    std::vector<std::pair<CRepresentation*, StreamType>> includedReprs;
+
     for (auto& adpSet : group.second.m_adpSets)
     {
+      CRepresentation* repr = adpSet->GetRepresentations()[0].get();
+      if (!repr->IsIncludedStream() && variantUrls.count(repr->GetSourceUrl()) > 0)
+      {
+        LOG::LogF(LOGDEBUG, "Rendition \"%s\" is multiplexed in the variant stream",
+                  adpSet->GetName().c_str());
+        repr->SetSourceUrl("");
+        repr->SetIsIncludedStream(true);
+        period->m_includedStreamType |= 1U << static_cast<int>(adpSet->GetStreamType());
+      }
+      if (repr->IsIncludedStream())
+      {
+        repr->SetIncludedStreamIndex(includedCount[adpSet->GetStreamType()]++);
+        includedReprs.emplace_back(repr, adpSet->GetStreamType());
+      }
+
       period->AddAdaptationSet(adpSet);
     }
+
+    // The demuxer check the number of elementary streams before to trust the positions
+    for (auto& [repr, streamType] : includedReprs)
+    {
+      repr->SetIncludedStreamCount(includedCount[streamType]);
+    }
   }
   m_extGroups.clear();
 
@@ -1081,6 +1538,96 @@ bool adaptive::CHLSTree::ParseManifest(const std::string& data)
   return true;
 }
 
+void adaptive::CHLSTree::AddSteeringPathways(const std::vector<PathwayVariant>& variants)
+{
+  const std::string defaultPathway{m_contentSteering.GetDefaultPathway()};
+  std::set<std::string> defaultGroupIds;
+
+  for (const PathwayVariant& variant : variants)
+  {
+    if (variant.m_pathwayId != defaultPathway)
+      continue;
+
+    // The domains are the base urls of the pathway clones
+    const std::string domainUrl{URL::GetDomainUrl(variant.m_url)};
+    m_contentSteering.AddPathwayUrl(defaultPathway, domainUrl, domainUrl);
+    defaultGroupIds.emplace(variant.m_audioGroupId);
+    defaultGroupIds.emplace(variant.m_subtitlesGroupId);
+  }
+
+  for (const PathwayVariant& variant : variants)
+  {
+    if (variant.m_pathwayId == defaultPathway)
+      continue;
+
+    // The equivalent variant of the default pathway has the same bandwidth and resolution
+    auto itDefault = std::find_if(variants.begin(), variants.end(),
+                                  [&](const PathwayVariant& defVariant)
+                                  {
+                                    return defVariant.m_pathwayId == defaultPathway &&
+                                           defVariant.m_bandwidth == variant.m_bandwidth &&
+                                           defVariant.m_width == variant.m_width &&
+                                           defVariant.m_height == variant.m_height;
+                                  });
+    if (itDefault == variants.end())
+    {
+      LOG::LogF(LOGDEBUG, "No variant of pathway \"%s\" equivalent to: %s",
+                defaultPathway.c_str(), variant.m_url.c_str());
+      continue;
+    }
+    m_contentSteering.AddPathwayUrl(variant.m_pathwayId, variant.m_url, itDefault->m_url);
+
+    // Renditions of the pathway groups, matched by name with the default pathway groups
+    const std::pair<std::string_view, std::string_view> groupIds[] = {
+        {variant.m_audioGroupId, itDefault->m_audioGroupId},
+        {variant.m_subtitlesGroupId, itDefault->m_subtitlesGroupId}};
+
+    for (const auto& [groupId, defaultGroupId] : groupIds)
+    {
+      if (groupId == defaultGroupId)
+        continue;
+
+      auto itGroup = m_extGroups.find(std::string(groupId));
+      auto itDefaultGroup = m_extGroups.find(std::string(defaultGroupId));
+      if (itGroup == m_extGroups.end() || itDefaultGroup == m_extGroups.end())
+        continue;
+
+      for (const auto& adpSet : itGroup->second.m_adpSets)
+      {
+        for (const auto& defaultAdpSet : itDefaultGroup->second.m_adpSets)
+        {
+          const std::string& url = adpSet->GetRepresentations()[0]->GetSourceUrl();
+          const std::string& defaultUrl = defaultAdpSet->GetRepresentations()[0]->GetSourceUrl();
+
+          if (adpSet->GetName() == defaultAdpSet->GetName() && !url.empty() &&
+              !defaultUrl.empty())
+          {
+            m_contentSteering.AddPathwayUrl(variant.m_pathwayId, url, defaultUrl);
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  // Remove the groups used only by the other pathways
+  for (auto itGroup = m_extGroups.begin(); itGroup != m_extGroups.end();)
+  {
+    const bool isOtherPathwayGroup =
+        defaultGroupIds.find(itGroup->first) == defaultGroupIds.end() &&
+        std::any_of(variants.begin(), variants.end(),
+                    [&](const PathwayVariant& variant)
+                    {
+                      return variant.m_audioGroupId == itGroup->first ||
+                             variant.m_subtitlesGroupId == itGroup->first;
+                    });
+    if (isOtherPathwayGroup)
+      itGroup = m_extGroups.erase(itGroup);
+    else
+      itGroup++;
+  }
+}
+
 PLAYLIST::EncryptionType adaptive::CHLSTree::ProcessEncryption(
     std::string_view baseUrl, std::map<std::string, std::string>& attribs)
 {
@@ -1106,11 +1653,39 @@ PLAYLIST::EncryptionType adaptive::CHLSTree::ProcessEncryption(
     return EncryptionType::AES128;
   }
 
-  // WIDEVINE
-  if (STRING::CompareNoCase(attribs["KEYFORMAT"],
-                            "urn:uuid:edef8ba9-79d6-4ace-a3c8-27dcd51d21ed") &&
-      !attribs["URI"].empty())
+  // SAMPLE-AES with identity key, the key is downloaded from the URI as for AES-128
+  if (encryptMethod == "SAMPLE-AES" && !attribs["URI"].empty() &&
+      (attribs["KEYFORMAT"].empty() || attribs["KEYFORMAT"] == "identity"))
+  {
+    m_currentPssh = attribs["URI"];
+    if (URL::IsUrlRelative(m_currentPssh))
+      m_currentPssh = URL::Join(baseUrl.data(), m_currentPssh);
+
+    m_currentIV = m_decrypter->convertIV(attribs["IV"]);
+
+    return EncryptionType::SAMPLE_AES;
+  }
+
+  // DRM KEY SYSTEM, e.g. Widevine
+  // the KEYFORMAT can be the system id URN or the key system name
+  const std::string_view keySystem{
+      DRM::SelectKeySystem({attribs["KEYFORMAT"]}, m_supportedKeySystems)};
+  if (!keySystem.empty() && !attribs["URI"].empty())
   {
+    // The segments can be protected by several key systems, the cheapest one is used
+    if (m_hasDrmKey &&
+        DRM::SelectKeySystem({m_currentKeySystem, keySystem}, m_supportedKeySystems) ==
+            m_currentKeySystem)
+    {
+      LOG::LogF(LOGDEBUG, "Keyformat %s skipped, the key system %s is used",
+                attribs["KEYFORMAT"].c_str(), m_currentKeySystem.c_str());
+      return EncryptionType::DRM_SKIPPED;
+    }
+    const DRM::IKeySystemHandler* handler{DRM::GetHandler(keySystem)};
+    m_currentKeySystem = keySystem;
+    m_currentDefaultKID.clear();
+    m_hasDrmKey = true;
+
     if (!attribs["KEYID"].empty())
     {
       std::string keyid = attribs["KEYID"].substr(2);
@@ -1125,24 +1700,25 @@ PLAYLIST::EncryptionType adaptive::CHLSTree::ProcessEncryption(
       }
     }
 
-    m_currentPssh = attribs["URI"].substr(23);
-    // Try to get KID from pssh, we assume len+'pssh'+version(0)+systemid+lenkid+kid
-    if (m_currentDefaultKID.empty() && m_currentPssh.size() == 68)
-    {
-      std::string decPssh{BASE64::Decode(m_currentPssh)};
-      if (decPssh.size() == 50)
-        m_currentDefaultKID = decPssh.substr(34, 16);
-    }
+    // The URI is a data URI with base64 encoded PSSH, e.g. "data:text/plain;base64,..."
+    const std::string& uri = attribs["URI"];
+    const size_t dataPos = uri.find("base64,");
+    m_currentPssh = dataPos != std::string::npos ? uri.substr(dataPos + 7) : uri;
+    // Try to get the KID from the PSSH data
+    if (m_currentDefaultKID.empty() && handler)
+      m_currentDefaultKID = handler->GetDefaultKid(BASE64::Decode(m_currentPssh));
+
     if (encryptMethod == "SAMPLE-AES-CTR")
       m_cryptoMode = CryptoMode::AES_CTR;
     else if (encryptMethod == "SAMPLE-AES")
       m_cryptoMode = CryptoMode::AES_CBC;
 
-    return EncryptionType::WIDEVINE;
+    return EncryptionType::DRM;
   }
 
   // KNOWN UNSUPPORTED
-  if (STRING::CompareNoCase(attribs["KEYFORMAT"], "com.apple.streamingkeydelivery"))
+  if (STRING::CompareNoCase(attribs["KEYFORMAT"], "com.apple.streamingkeydelivery") ||
+      DRM::ResolveKeySystem(attribs["KEYFORMAT"]))
   {
     LOG::LogF(LOGDEBUG, "Keyformat %s not supported", attribs["KEYFORMAT"].c_str());
     return EncryptionType::NOT_SUPPORTED;
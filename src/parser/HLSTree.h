@@ -46,6 +46,8 @@ public:
                              size_t segBufferSize,
                              bool isLastChunk) override;
 
+  bool GetSampleAesKey(uint16_t psshSet, uint64_t segNum, std::string& key, uint8_t* iv) override;
+
   virtual void RefreshSegments(PLAYLIST::CPeriod* period,
                                PLAYLIST::CAdaptationSet* adp,
                                PLAYLIST::CRepresentation* rep,
@@ -56,6 +58,12 @@ protected:
 
   virtual bool ParseManifest(const std::string& stream);
 
+  /*!
+   * \brief Download the image media playlist of the thumbnail track
+   *        (EXT-X-IMAGE-STREAM-INF) and add its tile images.
+   */
+  virtual bool PrepareThumbnailTrack(PLAYLIST::CThumbnailTrack* track) override;
+
   PLAYLIST::EncryptionType ProcessEncryption(std::string_view baseUrl,
                                              std::map<std::string, std::string>& attribs);
 
@@ -66,6 +74,26 @@ protected:
   std::unique_ptr<IAESDecrypter> m_decrypter;
 
 private:
+  // Variant of a content steering pathway
+  struct PathwayVariant
+  {
+    std::string m_pathwayId;
+    std::string m_url;
+    uint32_t m_bandwidth{0};
+    int m_width{0};
+    int m_height{0};
+    std::string m_audioGroupId;
+    std::string m_subtitlesGroupId;
+  };
+
+  /*!
+   * \brief Add the urls of the content steering pathways, from the variants of
+   *        the other pathways, that are not added as representations,
+   *        the rendition groups used only by the other pathways are removed.
+   * \param variants The variants of all pathways
+   */
+  void AddSteeringPathways(const std::vector<PathwayVariant>& variants);
+
   struct ExtGroup
   {
     std::string m_codecs;
@@ -94,6 +122,8 @@ private:
   std::string m_currentPssh; // Last processed encryption URI
   std::string m_currentDefaultKID; // Last processed encryption KID
   std::string m_currentIV; // Last processed encryption IV
+  std::string m_currentKeySystem; // Last processed encryption key system
+  bool m_hasDrmKey{false}; // A DRM key of the next segments is already processed
 };
 
 } // namespace
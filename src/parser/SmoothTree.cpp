@@ -8,6 +8,7 @@
 
 #include "SmoothTree.h"
 
+#include "../common/DrmSystems.h"
 #include "../utils/StringUtils.h"
 #include "../utils/UrlUtils.h"
 #include "../utils/Utils.h"
@@ -110,8 +111,7 @@ bool adaptive::CSmoothTree::ParseManifest(std::string& data)
     pugi::xml_node nodeProtHead = nodeProt.child("ProtectionHeader");
     if (nodeProtHead)
     {
-      if (STRING::CompareNoCase(XML::GetAttrib(nodeProtHead, "SystemID"),
-                                "9A04F079-9840-4286-AB92-E65BE0885F95"))
+      if (DRM::IsKeySystem(XML::GetAttrib(nodeProtHead, "SystemID"), DRM::KeySystem::PLAYREADY))
       {
         if (protParser.ParseHeader(nodeProtHead.child_value()))
         {
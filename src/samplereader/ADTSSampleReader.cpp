@@ -8,6 +8,8 @@
 
 #include "ADTSSampleReader.h"
 
+#include "../utils/log.h"
+
 CADTSSampleReader::CADTSSampleReader(AP4_ByteStream* input, AP4_UI32 streamId)
   : ADTSReader{input},
     m_streamId{streamId},
@@ -40,6 +42,7 @@ AP4_Result CADTSSampleReader::ReadSample()
       m_ptsDiff = m_pts - m_ptsOffs;
       m_ptsOffs = ~0ULL;
     }
+    DecryptSampleAes();
     return AP4_SUCCESS;
   }
   if (!m_adByteStream || !m_adByteStream->waitingForSegment())
@@ -65,3 +68,26 @@ bool CADTSSampleReader::TimeSeek(uint64_t pts, bool preceeding)
   }
   return AP4_ERROR_EOS;
 }
+
+void CADTSSampleReader::DecryptSampleAes()
+{
+  m_isSampleDecrypted = false;
+
+  std::string key;
+  uint8_t iv[16];
+  if (!m_adByteStream || !m_adByteStream->GetSampleAesKey(key, iv))
+    return;
+
+  if (!m_sampleAesDecrypter.SetKey(key, iv))
+    return;
+
+  m_sampleData.assign(GetPacketData(), GetPacketData() + GetPacketSize());
+  size_t size{m_sampleData.size()};
+  if (!m_sampleAesDecrypter.DecryptSample(CSampleAesDecrypter::Codec::AAC, m_sampleData.data(),
+                                          size))
+  {
+    LOG::LogF(LOGERROR, "Cannot decrypt the SAMPLE-AES frame");
+    return;
+  }
+  m_isSampleDecrypted = true;
+}
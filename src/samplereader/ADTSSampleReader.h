@@ -9,8 +9,11 @@
 #include "../ADTSReader.h"
 #include "../AdaptiveByteStream.h"
 #include "../TSReader.h"
+#include "../common/SampleAesDecrypter.h"
 #include "SampleReader.h"
 
+#include <vector>
+
 class ATTR_DLL_LOCAL CADTSSampleReader : public ISampleReader, public ADTSReader
 {
 public:
@@ -35,12 +38,23 @@ public:
   bool GetNextFragmentInfo(uint64_t& ts, uint64_t& dur) override { return false; }
   uint32_t GetTimeScale() const override { return 90000; }
   AP4_UI32 GetStreamId() const override { return m_streamId; }
-  AP4_Size GetSampleDataSize() const override { return GetPacketSize(); }
-  const AP4_Byte* GetSampleData() const override { return GetPacketData(); }
+  AP4_Size GetSampleDataSize() const override
+  {
+    return m_isSampleDecrypted ? static_cast<AP4_Size>(m_sampleData.size()) : GetPacketSize();
+  }
+  const AP4_Byte* GetSampleData() const override
+  {
+    return m_isSampleDecrypted ? m_sampleData.data() : GetPacketData();
+  }
   uint64_t GetDuration() const override { return (ADTSReader::GetDuration() * 100) / 9; }
   bool IsEncrypted() const override { return false; }
 
 private:
+  /*!
+   * \brief Decrypt the current frame when the segment is encrypted with SAMPLE-AES.
+   */
+  void DecryptSampleAes();
+
   bool m_eos{false};
   bool m_started{false};
   AP4_UI32 m_streamId;
@@ -49,4 +63,7 @@ private:
   uint64_t m_ptsOffs{~0ULL};
   uint64_t m_startPts{STREAM_NOPTS_VALUE};
   CAdaptiveByteStream* m_adByteStream;
+  CSampleAesDecrypter m_sampleAesDecrypter;
+  std::vector<AP4_Byte> m_sampleData; // The decrypted frame data
+  bool m_isSampleDecrypted{false};
 };
@@ -0,0 +1,80 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "EventMessage.h"
+
+#include <cstring>
+
+namespace
+{
+constexpr const char* SCHEME_MPD_EVENT = "urn:mpeg:dash:event:2012";
+
+// Read a null terminated string, return false if the terminator is missing
+bool ReadString(const AP4_UI08* data, AP4_Size size, AP4_Size& pos, std::string& str)
+{
+  const void* end{std::memchr(data + pos, '\0', size - pos)};
+  if (!end)
+    return false;
+
+  const AP4_Size length{static_cast<AP4_Size>(static_cast<const AP4_UI08*>(end) - (data + pos))};
+  str.assign(reinterpret_cast<const char*>(data + pos), length);
+  pos += length + 1;
+  return true;
+}
+} // unnamed namespace
+
+bool CEventMessage::Parse(const AP4_UI08* data, AP4_Size size)
+{
+  // version(8) + flags(24)
+  if (size < 4)
+    return false;
+
+  m_version = data[0];
+  AP4_Size pos{4};
+
+  if (m_version == 0)
+  {
+    // scheme_id_uri + value + timescale(32) + presentation_time_delta(32) +
+    // event_duration(32) + id(32)
+    if (!ReadString(data, size, pos, m_schemeIdUri) || !ReadString(data, size, pos, m_value) ||
+        size - pos < 16)
+      return false;
+
+    m_timescale = AP4_BytesToUInt32BE(data + pos);
+    m_presentationTime = AP4_BytesToUInt32BE(data + pos + 4);
+    m_eventDuration = AP4_BytesToUInt32BE(data + pos + 8);
+    m_id = AP4_BytesToUInt32BE(data + pos + 12);
+    pos += 16;
+  }
+  else if (m_version == 1)
+  {
+    // timescale(32) + presentation_time(64) + event_duration(32) + id(32) +
+    // scheme_id_uri + value
+    if (size - pos < 20)
+      return false;
+
+    m_timescale = AP4_BytesToUInt32BE(data + pos);
+    m_presentationTime = AP4_BytesToUInt64BE(data + pos + 4);
+    m_eventDuration = AP4_BytesToUInt32BE(data + pos + 12);
+    m_id = AP4_BytesToUInt32BE(data + pos + 16);
+    pos += 20;
+
+    if (!ReadString(data, size, pos, m_schemeIdUri) || !ReadString(data, size, pos, m_value))
+      return false;
+  }
+  else
+    return false;
+
+  m_messageData.assign(reinterpret_cast<const char*>(data + pos), size - pos);
+  return true;
+}
+
+bool CEventMessage::IsMpdEvent() const
+{
+  return m_schemeIdUri == SCHEME_MPD_EVENT;
+}
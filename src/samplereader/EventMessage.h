@@ -0,0 +1,64 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include <bento4/Ap4.h>
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "../test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+#include <string>
+
+/*!
+ * \brief DASH in-band event message box (emsg) version 0 and 1,
+ *        as defined by ISO/IEC 23009-1 section 5.10.3.3.
+ */
+class ATTR_DLL_LOCAL CEventMessage
+{
+public:
+  /*!
+   * \brief Parse the emsg box.
+   * \param data The box data that follow the box header (from the version field)
+   * \param size The data size
+   * \return True if success, false on malformed box or unsupported version
+   */
+  bool Parse(const AP4_UI08* data, AP4_Size size);
+
+  /*!
+   * \brief Check if it is an MPD event (scheme "urn:mpeg:dash:event:2012"),
+   *        that signal the expiration of the current MPD validity.
+   */
+  bool IsMpdEvent() const;
+
+  AP4_UI08 GetVersion() const { return m_version; }
+  const std::string& GetSchemeIdUri() const { return m_schemeIdUri; }
+  const std::string& GetValue() const { return m_value; }
+  AP4_UI32 GetTimescale() const { return m_timescale; }
+  /*!
+   * \brief Get the presentation time, on version 0 box it is the delta from
+   *        the earliest presentation time of the segment.
+   */
+  AP4_UI64 GetPresentationTime() const { return m_presentationTime; }
+  AP4_UI32 GetEventDuration() const { return m_eventDuration; }
+  AP4_UI32 GetId() const { return m_id; }
+  const std::string& GetMessageData() const { return m_messageData; }
+
+private:
+  AP4_UI08 m_version{0};
+  std::string m_schemeIdUri;
+  std::string m_value;
+  AP4_UI32 m_timescale{0};
+  AP4_UI64 m_presentationTime{0};
+  AP4_UI32 m_eventDuration{0};
+  AP4_UI32 m_id{0};
+  std::string m_messageData;
+};
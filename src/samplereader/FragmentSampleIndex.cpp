@@ -0,0 +1,152 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "FragmentSampleIndex.h"
+
+#include <algorithm>
+
+namespace
+{
+// ISO/IEC 14496-12 tfhd / trun box flags
+constexpr AP4_UI32 TFHD_DEFAULT_SAMPLE_DURATION_PRESENT = 0x000008;
+constexpr AP4_UI32 TFHD_DEFAULT_SAMPLE_FLAGS_PRESENT = 0x000020;
+constexpr AP4_UI32 TRUN_FIRST_SAMPLE_FLAGS_PRESENT = 0x000004;
+constexpr AP4_UI32 TRUN_SAMPLE_DURATION_PRESENT = 0x000100;
+constexpr AP4_UI32 TRUN_SAMPLE_FLAGS_PRESENT = 0x000400;
+constexpr AP4_UI32 TRUN_SAMPLE_CTS_OFFSET_PRESENT = 0x000800;
+
+// Sample flags, "sample_is_non_sync_sample" bit
+constexpr AP4_UI32 SAMPLE_FLAG_NON_SYNC = 0x00010000;
+// Sample dependency table, "sample_depends_on" value of an I picture
+constexpr AP4_UI08 SDTP_NOT_DEPENDS_ON_OTHERS = 2;
+
+bool IsNotDependingSample(AP4_SdtpAtom* sdtp, size_t index)
+{
+  if (!sdtp || index >= sdtp->GetEntries().ItemCount())
+    return false;
+
+  return ((sdtp->GetEntries()[static_cast<AP4_Ordinal>(index)] >> 4) & 0x03) ==
+         SDTP_NOT_DEPENDS_ON_OTHERS;
+}
+} // unnamed namespace
+
+bool CFragmentSampleIndex::Build(AP4_ContainerAtom* traf, AP4_TrexAtom* trex, AP4_UI64 baseDts)
+{
+  Clear();
+
+  if (!traf)
+    return false;
+
+  AP4_TfhdAtom* tfhd = AP4_DYNAMIC_CAST(AP4_TfhdAtom, traf->GetChild(AP4_ATOM_TYPE_TFHD, 0));
+  if (!tfhd)
+    return false;
+
+  AP4_UI32 defaultDuration{trex ? trex->GetDefaultSampleDuration() : 0};
+  AP4_UI32 defaultFlags{trex ? trex->GetDefaultSampleFlags() : 0};
+  if (tfhd->GetFlags() & TFHD_DEFAULT_SAMPLE_DURATION_PRESENT)
+    defaultDuration = tfhd->GetDefaultSampleDuration();
+  if (tfhd->GetFlags() & TFHD_DEFAULT_SAMPLE_FLAGS_PRESENT)
+    defaultFlags = tfhd->GetDefaultSampleFlags();
+
+  AP4_SdtpAtom* sdtp = AP4_DYNAMIC_CAST(AP4_SdtpAtom, traf->GetChild(AP4_ATOM_TYPE_SDTP, 0));
+
+  AP4_UI64 dts{baseDts};
+
+  // The samples of multiple track runs are sequential, in the same order of the sample table
+  for (AP4_List<AP4_Atom>::Item* item = traf->GetChildren().FirstItem(); item;
+       item = item->GetNext())
+  {
+    AP4_TrunAtom* trun = AP4_DYNAMIC_CAST(AP4_TrunAtom, item->GetData());
+    if (!trun)
+      continue;
+
+    const AP4_UI32 trunFlags{trun->GetFlags()};
+    const AP4_Array<AP4_TrunAtom::Entry>& entries = trun->GetEntries();
+    m_samples.reserve(m_samples.size() + entries.ItemCount());
+
+    for (AP4_Ordinal i{0}; i < entries.ItemCount(); ++i)
+    {
+      const AP4_TrunAtom::Entry& entry = entries[i];
+      Sample sample;
+      sample.m_dts = dts;
+      sample.m_duration =
+          (trunFlags & TRUN_SAMPLE_DURATION_PRESENT) ? entry.sample_duration : defaultDuration;
+
+      sample.m_cts = dts;
+      if (trunFlags & TRUN_SAMPLE_CTS_OFFSET_PRESENT)
+      {
+        // Version 1 allow negative offsets
+        if (trun->GetVersion() == 0)
+          sample.m_cts += entry.sample_composition_time_offset;
+        else
+          sample.m_cts += static_cast<AP4_SI32>(entry.sample_composition_time_offset);
+      }
+
+      AP4_UI32 sampleFlags{defaultFlags};
+      if (trunFlags & TRUN_SAMPLE_FLAGS_PRESENT)
+        sampleFlags = entry.sample_flags;
+      else if (i == 0 && (trunFlags & TRUN_FIRST_SAMPLE_FLAGS_PRESENT))
+        sampleFlags = trun->GetFirstSampleFlags();
+
+      sample.m_isSync = (sampleFlags & SAMPLE_FLAG_NON_SYNC) == 0 ||
+                        IsNotDependingSample(sdtp, m_samples.size());
+
+      if (sample.m_isSync)
+        m_syncSamples.emplace_back(static_cast<AP4_Ordinal>(m_samples.size()));
+
+      m_samples.emplace_back(sample);
+      dts += sample.m_duration;
+    }
+  }
+
+  return !m_samples.empty();
+}
+
+void CFragmentSampleIndex::Clear()
+{
+  m_samples.clear();
+  m_syncSamples.clear();
+}
+
+AP4_UI64 CFragmentSampleIndex::GetStartDts() const
+{
+  return m_samples.empty() ? 0 : m_samples.front().m_dts;
+}
+
+AP4_UI64 CFragmentSampleIndex::GetEndDts() const
+{
+  return m_samples.empty() ? 0 : m_samples.back().m_dts + m_samples.back().m_duration;
+}
+
+bool CFragmentSampleIndex::FindSyncSample(AP4_UI64 dts, bool preceding, AP4_Ordinal& index) const
+{
+  if (m_syncSamples.empty() || dts < GetStartDts() || dts >= GetEndDts())
+    return false;
+
+  // Sample that contains the decode time, the last one that start at or before it
+  auto itSample = std::upper_bound(m_samples.cbegin(), m_samples.cend(), dts,
+                                   [](AP4_UI64 value, const Sample& sample)
+                                   { return value < sample.m_dts; });
+  const AP4_Ordinal sampleIndex = static_cast<AP4_Ordinal>(itSample - m_samples.cbegin() - 1);
+
+  if (preceding)
+  {
+    auto itSync = std::upper_bound(m_syncSamples.cbegin(), m_syncSamples.cend(), sampleIndex);
+    if (itSync == m_syncSamples.cbegin())
+      return false;
+    index = *(itSync - 1);
+  }
+  else
+  {
+    auto itSync = std::lower_bound(m_syncSamples.cbegin(), m_syncSamples.cend(), sampleIndex);
+    if (itSync == m_syncSamples.cend())
+      return false;
+    index = *itSync;
+  }
+  return true;
+}
@@ -0,0 +1,77 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include <bento4/Ap4.h>
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "../test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+#include <vector>
+
+/*!
+ * \brief Timing and sync flags of the samples of a movie fragment, built from
+ *        the track run (trun) entries and the sample dependency (sdtp) table
+ *        when the moof is processed. Allow to locate the sync sample to seek
+ *        to without go through the sample table or read the samples data.
+ */
+class ATTR_DLL_LOCAL CFragmentSampleIndex
+{
+public:
+  struct Sample
+  {
+    AP4_UI64 m_dts{0};
+    AP4_UI64 m_cts{0};
+    AP4_UI32 m_duration{0};
+    bool m_isSync{false};
+  };
+
+  /*!
+   * \brief Build the index from the track fragment.
+   * \param traf The track fragment box
+   * \param trex The track extends box with the sample defaults, can be nullptr
+   * \param baseDts The decode time of the first sample of the fragment
+   * \return True if the fragment contains at least one sample, otherwise false
+   */
+  bool Build(AP4_ContainerAtom* traf, AP4_TrexAtom* trex, AP4_UI64 baseDts);
+
+  void Clear();
+
+  bool IsEmpty() const { return m_samples.empty(); }
+  size_t GetSampleCount() const { return m_samples.size(); }
+  const Sample& GetSample(size_t index) const { return m_samples[index]; }
+
+  /*!
+   * \brief Get the decode time where the fragment start.
+   */
+  AP4_UI64 GetStartDts() const;
+
+  /*!
+   * \brief Get the decode time where the fragment end (excluded).
+   */
+  AP4_UI64 GetEndDts() const;
+
+  /*!
+   * \brief Find the sync sample to start playback from for the specified
+   *        decode time, the time must fall within the fragment.
+   * \param dts The decode time to seek
+   * \param preceding If true get the sync sample at or before the sample
+   *                  that contains the time, otherwise the sync sample at or after
+   * \param index[OUT] The index of the sync sample in the fragment
+   * \return True if found, otherwise false
+   */
+  bool FindSyncSample(AP4_UI64 dts, bool preceding, AP4_Ordinal& index) const;
+
+private:
+  std::vector<Sample> m_samples;
+  std::vector<AP4_Ordinal> m_syncSamples;
+};
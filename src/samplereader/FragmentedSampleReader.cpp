@@ -9,6 +9,8 @@
 #include "FragmentedSampleReader.h"
 
 #include "../AdaptiveByteStream.h"
+#include "../KeyRotation.h"
+#include "../common/AdaptiveTree.h"
 #include "../codechandler/AV1CodecHandler.h"
 #include "../codechandler/AVCCodecHandler.h"
 #include "../codechandler/HEVCCodecHandler.h"
@@ -18,10 +20,56 @@
 #include "../codechandler/WebVTTCodecHandler.h"
 #include "../utils/log.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include <kodi/tools/StringUtils.h>
+
+using namespace kodi::tools;
+
 namespace
 {
+// Max number of audio samples of a fragment decrypted with a single request
+constexpr size_t MAX_BATCH_SAMPLES = 16;
+
+constexpr AP4_UI32 ATOM_TYPE_EMSG = AP4_ATOM_TYPE('e', 'm', 's', 'g');
+// Larger event message boxes are ignored
+constexpr AP4_UI64 MAX_EMSG_SIZE = 65536;
+
 constexpr uint8_t SMOOTHSTREAM_TFRFBOX_UUID[] = {0xd4, 0x80, 0x7e, 0xf2, 0xca, 0x39, 0x46, 0x95,
                                                  0x8e, 0x54, 0x26, 0xcb, 0x9e, 0x46, 0xa7, 0x9f};
+
+AP4_ContainerAtom* FindTrackFragment(AP4_ContainerAtom* moof, AP4_UI32 trackId)
+{
+  AP4_Atom* atom{nullptr};
+  for (AP4_Ordinal i{0}; (atom = moof->GetChild(AP4_ATOM_TYPE_TRAF, i)) != nullptr; ++i)
+  {
+    AP4_ContainerAtom* traf{AP4_DYNAMIC_CAST(AP4_ContainerAtom, atom)};
+    AP4_TfhdAtom* tfhd{
+        traf ? AP4_DYNAMIC_CAST(AP4_TfhdAtom, traf->GetChild(AP4_ATOM_TYPE_TFHD, 0)) : nullptr};
+    if (tfhd && tfhd->GetTrackId() == trackId)
+      return traf;
+  }
+  return nullptr;
+}
+
+AP4_TrexAtom* FindTrackExtends(AP4_Movie& movie, AP4_UI32 trackId)
+{
+  AP4_MoovAtom* moov{movie.GetMoovAtom()};
+  AP4_ContainerAtom* mvex{
+      moov ? AP4_DYNAMIC_CAST(AP4_ContainerAtom, moov->GetChild(AP4_ATOM_TYPE_MVEX, 0)) : nullptr};
+  if (!mvex)
+    return nullptr;
+
+  AP4_Atom* atom{nullptr};
+  for (AP4_Ordinal i{0}; (atom = mvex->GetChild(AP4_ATOM_TYPE_TREX, i)) != nullptr; ++i)
+  {
+    AP4_TrexAtom* trex{AP4_DYNAMIC_CAST(AP4_TrexAtom, atom)};
+    if (trex && trex->GetTrackId() == trackId)
+      return trex;
+  }
+  return nullptr;
+}
 } // unnamed namespace
 
 
@@ -39,26 +87,14 @@ CFragmentedSampleReader::CFragmentedSampleReader(AP4_ByteStream* input,
 {
   EnableTrack(m_track->GetId());
 
+  // The first fragment follows the initialization data
+  input->Tell(m_fragmentEndPos);
+
   AP4_SampleDescription* desc{m_track->GetSampleDescription(0)};
   if (desc->GetType() == AP4_SampleDescription::TYPE_PROTECTED)
   {
     m_protectedDesc = static_cast<AP4_ProtectedSampleDescription*>(desc);
-
-    AP4_ContainerAtom* schi;
-    if (m_protectedDesc->GetSchemeInfo() &&
-        (schi = m_protectedDesc->GetSchemeInfo()->GetSchiAtom()))
-    {
-      AP4_TencAtom* tenc(AP4_DYNAMIC_CAST(AP4_TencAtom, schi->GetChild(AP4_ATOM_TYPE_TENC, 0)));
-      if (tenc)
-        m_defaultKey = tenc->GetDefaultKid();
-      else
-      {
-        AP4_PiffTrackEncryptionAtom* piff(AP4_DYNAMIC_CAST(
-            AP4_PiffTrackEncryptionAtom, schi->GetChild(AP4_UUID_PIFF_TRACK_ENCRYPTION_ATOM, 0)));
-        if (piff)
-          m_defaultKey = piff->GetDefaultKid();
-      }
-    }
+    UpdateDefaultKey();
   }
 
   if (m_singleSampleDecryptor)
@@ -92,6 +128,8 @@ CFragmentedSampleReader::~CFragmentedSampleReader()
 {
   if (m_singleSampleDecryptor)
     m_singleSampleDecryptor->RemovePool(m_poolId);
+  if (m_isRotatedDecrypter)
+    m_keyRotation->ReleaseDecrypter(m_singleSampleDecryptor);
   delete m_decrypter;
   delete m_codecHandler;
 }
@@ -112,13 +150,40 @@ AP4_Result CFragmentedSampleReader::ReadSample()
   AP4_Result result;
   if (!m_codecHandler || !m_codecHandler->ReadNextSample(m_sample, m_sampleData))
   {
+    if (m_batchPos < m_batchSamples.size())
+    {
+      // Sample already read and decrypted with the batch
+      m_sample = m_batchSamples[m_batchPos];
+      const AP4_DataBuffer& batchData{m_batchDecrypted[m_batchPos]};
+      m_sampleData.SetData(batchData.GetData(), batchData.GetDataSize());
+      UpdateSampleCryptoInfo(m_batchSampleIndex + static_cast<AP4_Ordinal>(m_batchPos));
+      result = m_batchResults[m_batchPos];
+      m_batchPos++;
+
+      if (!HandleDecryptResult(result))
+        return result;
+
+      if (m_codecHandler->Transform(m_sample.GetDts(), m_sample.GetDuration(), m_sampleData,
+                                    m_track->GetMediaTimeScale()))
+      {
+        m_codecHandler->ReadNextSample(m_sample, m_sampleData);
+      }
+      return ReadSampleDone();
+    }
+
     bool useDecryptingDecoder =
         m_protectedDesc &&
         (m_decrypterCaps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SECURE_PATH) != 0;
     bool decrypterPresent{m_decrypter != nullptr};
-    if (AP4_FAILED(result = ReadNextSample(m_track->GetId(), m_sample,
-                                           (m_decrypter || useDecryptingDecoder) ? m_encrypted
-                                                                                 : m_sampleData)))
+    if (m_isSampleHeld)
+    {
+      // The sample has been already read, it was waiting the license of its key
+      m_isSampleHeld = false;
+    }
+    else if (AP4_FAILED(result = ReadNextSample(m_track->GetId(), m_sample,
+                                                (m_decrypter || useDecryptingDecoder)
+                                                    ? m_encrypted
+                                                    : m_sampleData)))
     {
       if (result == AP4_ERROR_EOS)
       {
@@ -154,34 +219,35 @@ AP4_Result CFragmentedSampleReader::ReadSample()
 
     if (m_decrypter)
     {
+      // The license of the sample key can be still pending, the sample is held
+      // without data until the license is acquired, see IsWaitingLicense
+      if (!PrepareSampleDecrypter())
+      {
+        m_isSampleHeld = true;
+        m_sampleData.SetDataSize(0);
+        return ReadSampleDone();
+      }
+
+      UpdateSampleCryptoInfo(m_decrypter->GetSampleCursor());
+
       // Make sure that the decrypter is NOT allocating memory!
       // If decrypter and addon are compiled with different DEBUG / RELEASE
       // options freeing HEAP memory will fail.
       m_sampleData.Reserve(m_encrypted.GetDataSize() + 4096);
-      if (AP4_FAILED(result =
-                         m_decrypter->DecryptSampleData(m_poolId, m_encrypted, m_sampleData, NULL)))
-      {
-        LOG::Log(LOGERROR, "Decrypt Sample returns failure!");
-        if (++m_failCount > 50)
-        {
-          Reset(true);
-          return result;
-        }
-        else
-        {
-          m_sampleData.SetDataSize(0);
-        }
-      }
+      // The batch cannot switch the decrypter between the samples
+      if (m_track->GetType() == AP4_Track::TYPE_AUDIO && !m_hasSampleKeys)
+        result = DecryptSampleBatch();
       else
-      {
-        m_failCount = 0;
-      }
+        result = m_decrypter->DecryptSampleData(m_poolId, m_encrypted, m_sampleData, NULL);
+
+      if (!HandleDecryptResult(result))
+        return result;
     }
     else if (useDecryptingDecoder)
     {
       m_sampleData.Reserve(m_encrypted.GetDataSize() + 1024);
       m_singleSampleDecryptor->DecryptSampleData(m_poolId, m_encrypted, m_sampleData, nullptr, 0,
-                                                 nullptr, nullptr);
+                                                 nullptr, nullptr, nullptr);
     }
 
     if (m_codecHandler->Transform(m_sample.GetDts(), m_sample.GetDuration(), m_sampleData,
@@ -190,7 +256,11 @@ AP4_Result CFragmentedSampleReader::ReadSample()
       m_codecHandler->ReadNextSample(m_sample, m_sampleData);
     }
   }
+  return ReadSampleDone();
+}
 
+AP4_Result CFragmentedSampleReader::ReadSampleDone()
+{
   m_dts = (m_sample.GetDts() * m_timeBaseExt) / m_timeBaseInt;
   m_pts = (m_sample.GetCts() * m_timeBaseExt) / m_timeBaseInt;
   
@@ -202,9 +272,72 @@ AP4_Result CFragmentedSampleReader::ReadSample()
   return AP4_SUCCESS;
 }
 
+bool CFragmentedSampleReader::HandleDecryptResult(AP4_Result result)
+{
+  if (AP4_SUCCEEDED(result))
+  {
+    m_failCount = 0;
+    return true;
+  }
+
+  LOG::Log(LOGERROR, "Decrypt Sample returns failure!");
+  if (++m_failCount > 50)
+  {
+    Reset(true);
+    return false;
+  }
+  m_sampleData.SetDataSize(0);
+  return true;
+}
+
+AP4_Result CFragmentedSampleReader::DecryptSampleBatch()
+{
+  // Read in advance the next samples of the current fragment only, reading over
+  // the fragment end would process the next moof that can change the decrypter
+  Tracker* tracker{FindTracker(m_track->GetId())};
+  size_t count{1};
+  if (tracker && tracker->m_SampleTable &&
+      tracker->m_SampleTable->GetSampleCount() > tracker->m_NextSampleIndex)
+  {
+    count += std::min<size_t>(tracker->m_SampleTable->GetSampleCount() -
+                                  tracker->m_NextSampleIndex,
+                              MAX_BATCH_SAMPLES - 1);
+  }
+
+  m_batchSampleIndex = m_decrypter->GetSampleCursor();
+  m_batchSamples.resize(count);
+  m_batchEncrypted.resize(count);
+  m_batchEncrypted[0].SetData(m_encrypted.GetData(), m_encrypted.GetDataSize());
+  for (size_t i = 1; i < count; ++i)
+  {
+    if (AP4_FAILED(ReadNextSample(m_track->GetId(), m_batchSamples[i], m_batchEncrypted[i])))
+    {
+      count = i;
+      break;
+    }
+  }
+  m_batchSamples.resize(count);
+  m_batchEncrypted.resize(count);
+  m_batchDecrypted.resize(count);
+  for (size_t i = 0; i < count; ++i)
+    m_batchDecrypted[i].Reserve(m_batchEncrypted[i].GetDataSize() + 4096);
+
+  m_decrypter->DecryptSampleBatch(m_poolId, m_batchEncrypted, m_batchDecrypted, m_batchResults);
+
+  // The first sample is the current one, the others are returned by the next reads
+  // each with its own decryption result
+  m_sampleData.SetData(m_batchDecrypted[0].GetData(), m_batchDecrypted[0].GetDataSize());
+  m_batchPos = 1;
+  return m_batchResults[0];
+}
+
 void CFragmentedSampleReader::Reset(bool bEOS)
 {
   AP4_LinearReader::Reset();
+  m_batchSamples.clear();
+  m_batchPos = 0;
+  m_isSampleHeld = false;
+  m_fragmentIndex.Clear();
   m_eos = bEOS;
   if (m_codecHandler)
     m_codecHandler->Reset();
@@ -221,6 +354,15 @@ bool CFragmentedSampleReader::IsEncrypted() const
          m_decrypter != nullptr;
 }
 
+bool CFragmentedSampleReader::GetCaptionData(std::vector<uint8_t>& ccData)
+{
+  // On the secure path the sample data are encrypted
+  if (!m_codecHandler || IsEncrypted() || m_sampleData.GetDataSize() == 0)
+    return false;
+
+  return m_codecHandler->ExtractCaptionData(m_sampleData, ccData);
+}
+
 bool CFragmentedSampleReader::GetInformation(kodi::addon::InputstreamInfo& info)
 {
   if (!m_codecHandler)
@@ -264,18 +406,60 @@ bool CFragmentedSampleReader::GetInformation(kodi::addon::InputstreamInfo& info)
 
   m_bSampleDescChanged = false;
 
+  // The decoder must be opened again with the DRM session of the new decrypter
+  if (m_isCryptoSessionChanged)
+  {
+    m_isCryptoSessionChanged = false;
+    edChanged = true;
+  }
+
   if (m_codecHandler->GetInformation(info))
     return true;
 
   return edChanged;
 }
 
+bool CFragmentedSampleReader::IsWaitingLicense()
+{
+  if (!m_isSampleHeld)
+    return false;
+
+  // Once the license is acquired (or failed) read again the held sample
+  if (!m_keyRotation->IsKeyPending(m_missingKeyId))
+    ReadSampleAsync();
+
+  return true;
+}
+
+const char* CFragmentedSampleReader::GetCryptoSessionId() const
+{
+  if (!m_isRotatedDecrypter ||
+      !(m_decrypterCaps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SECURE_PATH))
+    return nullptr;
+
+  return m_singleSampleDecryptor->GetSessionId();
+}
+
 bool CFragmentedSampleReader::TimeSeek(uint64_t pts, bool preceeding)
 {
   AP4_Ordinal sampleIndex;
   AP4_UI64 seekPos(static_cast<AP4_UI64>((pts * m_timeBaseInt) / m_timeBaseExt));
-  if (AP4_SUCCEEDED(SeekSample(m_track->GetId(), seekPos, sampleIndex, preceeding)))
+  AP4_Result result;
+
+  // When the position falls within the current fragment jump straight to the
+  // sync sample from the trun index, the skipped samples are never read
+  if (m_fragmentIndex.FindSyncSample(seekPos, preceeding, sampleIndex))
+    result = SetSampleIndex(m_track->GetId(), sampleIndex);
+  else
+    result = SeekSample(m_track->GetId(), seekPos, sampleIndex, preceeding);
+
+  if (AP4_SUCCEEDED(result))
   {
+    // The samples read in advance are no longer valid
+    m_batchSamples.clear();
+    m_batchPos = 0;
+    m_isSampleHeld = false;
+
     if (m_decrypter)
       m_decrypter->SetSampleIndex(sampleIndex);
 
@@ -322,11 +506,100 @@ bool CFragmentedSampleReader::GetNextFragmentInfo(uint64_t& ts, uint64_t& dur)
   return true;
 }
 
+std::vector<CEventMessage> CFragmentedSampleReader::ParseEventMessages(AP4_Position moofOffset)
+{
+  std::vector<CEventMessage> eventMessages;
+  AP4_Position boxPos{m_fragmentEndPos};
+  AP4_Position currentPos{0};
+  if (!m_adaptiveTree || boxPos >= moofOffset || AP4_FAILED(m_FragmentStream->Tell(currentPos)))
+    return eventMessages;
+
+  // The stream can only seek within the current segment, after a seek the
+  // previous fragment could be in an other segment and the events are lost
+  if (AP4_FAILED(m_FragmentStream->Seek(boxPos)))
+    return eventMessages;
+
+  while (boxPos + AP4_ATOM_HEADER_SIZE <= moofOffset)
+  {
+    AP4_UI32 boxSize32{0};
+    AP4_UI32 boxType{0};
+    if (AP4_FAILED(m_FragmentStream->ReadUI32(boxSize32)) ||
+        AP4_FAILED(m_FragmentStream->ReadUI32(boxType)))
+      break;
+
+    AP4_UI64 boxSize{boxSize32};
+    AP4_UI32 headerSize{AP4_ATOM_HEADER_SIZE};
+    if (boxSize32 == 1) // 64 bit box size
+    {
+      if (AP4_FAILED(m_FragmentStream->ReadUI64(boxSize)))
+        break;
+      headerSize += 8;
+    }
+    if (boxSize < headerSize || boxPos + boxSize > moofOffset)
+      break;
+
+    if (boxType == ATOM_TYPE_EMSG && boxSize <= MAX_EMSG_SIZE)
+    {
+      AP4_DataBuffer payload;
+      payload.SetDataSize(static_cast<AP4_Size>(boxSize - headerSize));
+      CEventMessage eventMessage;
+      if (AP4_SUCCEEDED(m_FragmentStream->Read(payload.UseData(), payload.GetDataSize())) &&
+          eventMessage.Parse(payload.GetData(), payload.GetDataSize()))
+      {
+        LOG::Log(LOGDEBUG, "Event message found (scheme: %s, value: %s, id: %u)",
+                 eventMessage.GetSchemeIdUri().c_str(), eventMessage.GetValue().c_str(),
+                 eventMessage.GetId());
+        eventMessages.emplace_back(eventMessage);
+      }
+    }
+
+    boxPos += boxSize;
+    if (AP4_FAILED(m_FragmentStream->Seek(boxPos)))
+      break;
+  }
+
+  m_FragmentStream->Seek(currentPos);
+  return eventMessages;
+}
+
+void CFragmentedSampleReader::SendEventMessages(const std::vector<CEventMessage>& eventMessages,
+                                                uint64_t fragmentStartPts)
+{
+  for (const CEventMessage& eventMessage : eventMessages)
+  {
+    if (eventMessage.GetTimescale() == 0)
+      continue;
+
+    adaptive::TimedEvent event;
+    event.m_schemeIdUri = eventMessage.GetSchemeIdUri();
+    event.m_value = eventMessage.GetValue();
+    event.m_id = std::to_string(eventMessage.GetId());
+    event.m_time =
+        adaptive::ToStreamTime(eventMessage.GetPresentationTime(), eventMessage.GetTimescale());
+    if (eventMessage.GetVersion() == 0)
+      event.m_time += fragmentStartPts;
+    if (eventMessage.GetEventDuration() != 0xFFFFFFFF) // Unknown duration
+    {
+      event.m_duration =
+          adaptive::ToStreamTime(eventMessage.GetEventDuration(), eventMessage.GetTimescale());
+    }
+    event.m_messageData = eventMessage.GetMessageData();
+
+    if (event.m_schemeIdUri == adaptive::SCHEME_SCTE35_BIN)
+      adaptive::ApplySpliceInfo(event, event.m_messageData);
+
+    m_adaptiveTree->OnInbandEvent(event);
+  }
+}
+
 AP4_Result CFragmentedSampleReader::ProcessMoof(AP4_ContainerAtom* moof,
                                                 AP4_Position moof_offset,
                                                 AP4_Position mdat_payload_offset,
                                                 AP4_UI64 mdat_payload_size)
 {
+  const std::vector<CEventMessage> eventMessages{ParseEventMessages(moof_offset)};
+  m_fragmentEndPos = mdat_payload_offset + mdat_payload_size;
+
   AP4_MovieFragment fragment =
       AP4_MovieFragment(AP4_DYNAMIC_CAST(AP4_ContainerAtom, moof->Clone()));
   AP4_Array<AP4_UI32> ids;
@@ -387,8 +660,24 @@ AP4_Result CFragmentedSampleReader::ProcessMoof(AP4_ContainerAtom* moof,
       UpdateSampleDescription();
     }
 
-    //Correct PTS
+    //Index the samples of the fragment for the seek
     AP4_Sample sample;
+    m_fragmentIndex.Clear();
+    Tracker* tracker{FindTracker(m_track->GetId())};
+    if (tracker && tracker->m_SampleTable &&
+        AP4_SUCCEEDED(GetSample(m_track->GetId(), sample, 0)) &&
+        m_fragmentIndex.Build(FindTrackFragment(moof, m_track->GetId()),
+                              FindTrackExtends(m_Movie, m_track->GetId()), sample.GetDts()) &&
+        m_fragmentIndex.GetSampleCount() != tracker->m_SampleTable->GetSampleCount())
+    {
+      LOG::LogF(LOGDEBUG, "Fragment index does not match the sample table, ignored");
+      m_fragmentIndex.Clear();
+    }
+
+    if (!eventMessages.empty() && AP4_SUCCEEDED(GetSample(m_track->GetId(), sample, 0)))
+      SendEventMessages(eventMessages, (sample.GetCts() * m_timeBaseExt) / m_timeBaseInt);
+
+    //Correct PTS
     if (~m_ptsOffs)
     {
       if (AP4_SUCCEEDED(GetSample(m_track->GetId(), sample, 0)))
@@ -414,17 +703,46 @@ AP4_Result CFragmentedSampleReader::ProcessMoof(AP4_ContainerAtom* moof,
       if (!m_protectedDesc || !traf)
         return AP4_ERROR_INVALID_FORMAT;
 
+      // The key can be changed by the sample group of the fragment (key rotation),
+      // the samples can also be unencrypted or use different keys within the fragment
+      m_fragmentKey = m_defaultKey;
+      if (m_sampleGroups.Parse(traf, m_track, m_defaultIvSize, m_defaultConstantIv))
+      {
+        const CCencSampleGroups::Entry* entry{m_sampleGroups.GetEntry(0)};
+        if (entry)
+        {
+          std::memcpy(m_sampleGroupKey, entry->m_keyId, 16);
+          m_fragmentKey = m_sampleGroupKey;
+        }
+      }
+
+      if (m_keyRotation)
+      {
+        CheckFragmentPssh(moof);
+        m_hasSampleKeys = HasSampleKeys();
+      }
+
       bool reset_iv(false);
       if (AP4_FAILED(result = AP4_CencSampleInfoTable::Create(m_protectedDesc, traf, algorithm_id,
                                                               reset_iv, *m_FragmentStream,
                                                               moof_offset, sample_table)))
-        // we assume unencrypted fragment here
-        goto SUCCESS;
+      {
+        // When the IV size change per sample group Bento4 cannot parse the table
+        if (!m_sampleGroups.GetSampleInfo(0))
+          // we assume unencrypted fragment here
+          goto SUCCESS;
+        sample_table = nullptr;
+      }
+
+      // The capabilities are updated once a deferred license has been acquired
+      if (m_keyRotation && m_singleSampleDecryptor)
+        m_keyRotation->GetCaps(m_singleSampleDecryptor, m_decrypterCaps);
 
       if (!m_singleSampleDecryptor)
         return AP4_ERROR_INVALID_PARAMETERS;
 
-      m_decrypter = new CAdaptiveCencSampleDecrypter(m_singleSampleDecryptor, sample_table);
+      m_decrypter =
+          new CAdaptiveCencSampleDecrypter(m_singleSampleDecryptor, sample_table, &m_sampleGroups);
 
       // Inform decrypter of pattern decryption (CBCS)
       AP4_UI32 schemeType = m_protectedDesc->GetSchemeType();
@@ -432,8 +750,11 @@ AP4_Result CFragmentedSampleReader::ProcessMoof(AP4_ContainerAtom* moof,
           schemeType == AP4_PROTECTION_SCHEME_TYPE_PIFF ||
           schemeType == AP4_PROTECTION_SCHEME_TYPE_CBCS)
       {
-        m_readerCryptoInfo.m_cryptBlocks = sample_table->GetCryptByteBlock();
-        m_readerCryptoInfo.m_skipBlocks = sample_table->GetSkipByteBlock();
+        if (sample_table)
+        {
+          m_readerCryptoInfo.m_cryptBlocks = sample_table->GetCryptByteBlock();
+          m_readerCryptoInfo.m_skipBlocks = sample_table->GetSkipByteBlock();
+        }
 
         if (schemeType == AP4_PROTECTION_SCHEME_TYPE_CENC ||
             schemeType == AP4_PROTECTION_SCHEME_TYPE_PIFF)
@@ -446,16 +767,30 @@ AP4_Result CFragmentedSampleReader::ProcessMoof(AP4_ContainerAtom* moof,
       {
         LOG::LogF(LOGERROR, "Protection scheme %u not implemented.", schemeType);
       }
+      m_fragmentCryptoInfo = m_readerCryptoInfo;
+
+      // The fragment key is the key of the first sample, the samples that are
+      // not mapped to a sample group must use the default key of the track
+      if (m_defaultKey && m_fragmentKey != m_defaultKey)
+      {
+        m_decrypter->SetDefaultKeyInfo({m_defaultKey, m_readerCryptoInfo.m_cryptBlocks,
+                                        m_readerCryptoInfo.m_skipBlocks});
+      }
     }
   }
 SUCCESS:
+  SetFragmentInfo();
+  return AP4_SUCCESS;
+}
+
+void CFragmentedSampleReader::SetFragmentInfo()
+{
   if (m_singleSampleDecryptor && m_codecHandler)
   {
-     m_singleSampleDecryptor->SetFragmentInfo(
-        m_poolId, m_defaultKey, m_codecHandler->m_naluLengthSize, m_codecHandler->m_extraData,
+    m_singleSampleDecryptor->SetFragmentInfo(
+        m_poolId, m_fragmentKey, m_codecHandler->m_naluLengthSize, m_codecHandler->m_extraData,
         m_decrypterCaps.flags, m_readerCryptoInfo);
   }
-  return AP4_SUCCESS;
 }
 
 void CFragmentedSampleReader::UpdateSampleDescription()
@@ -469,6 +804,8 @@ void CFragmentedSampleReader::UpdateSampleDescription()
   if (desc->GetType() == AP4_SampleDescription::TYPE_PROTECTED)
   {
     m_protectedDesc = static_cast<AP4_ProtectedSampleDescription*>(desc);
+    // Each sample description can have a different default KID
+    UpdateDefaultKey();
     desc = m_protectedDesc->GetOriginalSampleDescription();
   }
   LOG::Log(LOGDEBUG, "UpdateSampleDescription: codec %d", desc->GetFormat());
@@ -509,3 +846,190 @@ void CFragmentedSampleReader::UpdateSampleDescription()
   if ((m_decrypterCaps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_ANNEXB_REQUIRED) != 0)
     m_codecHandler->ExtraDataToAnnexB();
 }
+
+void CFragmentedSampleReader::UpdateDefaultKey()
+{
+  AP4_ContainerAtom* schi;
+  if (!m_protectedDesc->GetSchemeInfo() ||
+      !(schi = m_protectedDesc->GetSchemeInfo()->GetSchiAtom()))
+    return;
+
+  AP4_TencAtom* tenc(AP4_DYNAMIC_CAST(AP4_TencAtom, schi->GetChild(AP4_ATOM_TYPE_TENC, 0)));
+  if (tenc)
+  {
+    m_defaultKey = tenc->GetDefaultKid();
+    m_defaultIvSize = tenc->GetDefaultPerSampleIvSize();
+    m_defaultConstantIv = m_defaultIvSize == 0 ? tenc->GetDefaultConstantIv() : nullptr;
+  }
+  else
+  {
+    AP4_PiffTrackEncryptionAtom* piff(AP4_DYNAMIC_CAST(
+        AP4_PiffTrackEncryptionAtom, schi->GetChild(AP4_UUID_PIFF_TRACK_ENCRYPTION_ATOM, 0)));
+    if (piff)
+    {
+      m_defaultKey = piff->GetDefaultKid();
+      m_defaultIvSize = piff->GetDefaultIvSize();
+      m_defaultConstantIv = nullptr;
+    }
+  }
+  m_fragmentKey = m_defaultKey;
+}
+
+void CFragmentedSampleReader::UpdateSampleCryptoInfo(AP4_Ordinal sampleIndex)
+{
+  if (m_sampleGroups.IsEmpty())
+    return;
+
+  const CCencSampleGroups::Entry* entry{m_sampleGroups.GetEntry(sampleIndex)};
+  if (entry && entry->m_isProtected)
+  {
+    m_readerCryptoInfo.m_cryptBlocks = entry->m_cryptBlocks;
+    m_readerCryptoInfo.m_skipBlocks = entry->m_skipBlocks;
+  }
+  else
+  {
+    m_readerCryptoInfo.m_cryptBlocks = m_fragmentCryptoInfo.m_cryptBlocks;
+    m_readerCryptoInfo.m_skipBlocks = m_fragmentCryptoInfo.m_skipBlocks;
+  }
+}
+
+void CFragmentedSampleReader::CheckFragmentPssh(AP4_ContainerAtom* moof)
+{
+  const uint32_t media{m_track->GetType() == AP4_Track::TYPE_VIDEO
+                           ? SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_VIDEO
+                           : SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_AUDIO};
+  AP4_Atom* atom{nullptr};
+
+  for (AP4_Ordinal i{0}; (atom = moof->GetChild(AP4_ATOM_TYPE_PSSH, i)) != nullptr; ++i)
+  {
+    AP4_PsshAtom* pssh{AP4_DYNAMIC_CAST(AP4_PsshAtom, atom)};
+    if (!pssh || std::memcmp(pssh->GetSystemId(), m_keyRotation->GetSystemId(), 16) != 0)
+      continue;
+
+    // The whole box is passed, the payload alone does not tell the key system
+    AP4_MemoryByteStream psshStream;
+    if (AP4_FAILED(pssh->Write(psshStream)))
+      continue;
+
+    std::string_view initData{reinterpret_cast<const char*>(psshStream.GetData()),
+                              psshStream.GetDataSize()};
+    if (initData == m_lastPssh)
+      continue;
+
+    std::vector<std::string> keyIds;
+    for (AP4_UI32 kidIndex{0}; kidIndex < pssh->GetKidCount(); ++kidIndex)
+    {
+      if (pssh->GetKid(kidIndex))
+        keyIds.emplace_back(reinterpret_cast<const char*>(pssh->GetKid(kidIndex)), 16);
+    }
+
+    // Without KIDs we cannot know if the first PSSH found has been already licensed
+    // by the session, this is assumed when the current decrypter have the fragment key
+    if (!m_lastPssh.empty() || !keyIds.empty() || !m_fragmentKey ||
+        !m_keyRotation->HasKey(m_singleSampleDecryptor, m_fragmentKey))
+    {
+      m_keyRotation->AcquireLicense(initData, keyIds, media);
+    }
+    m_lastPssh = initData;
+  }
+}
+
+bool CFragmentedSampleReader::HasSampleKeys()
+{
+  std::vector<const AP4_UI08*> keyIds;
+  bool hasDefaultKeySamples{true};
+
+  Tracker* tracker{FindTracker(m_track->GetId())};
+  if (!m_sampleGroups.IsEmpty() && tracker && tracker->m_SampleTable)
+    keyIds = m_sampleGroups.GetKeyIds(tracker->m_SampleTable->GetSampleCount(),
+                                      hasDefaultKeySamples);
+  if (hasDefaultKeySamples && m_defaultKey)
+    keyIds.emplace_back(m_defaultKey);
+
+  return std::any_of(keyIds.begin(), keyIds.end(), [this](const AP4_UI08* keyId)
+                     { return !m_keyRotation->HasKey(m_singleSampleDecryptor, keyId); });
+}
+
+bool CFragmentedSampleReader::PrepareSampleDecrypter()
+{
+  if (!m_hasSampleKeys)
+    return true;
+
+  // The samples not mapped to a sample group use the default key of the track
+  const AP4_UI08* keyId{m_defaultKey};
+  const CCencSampleGroups::Entry* entry{m_sampleGroups.GetEntry(m_decrypter->GetSampleCursor())};
+  if (entry)
+    keyId = entry->m_isProtected ? entry->m_keyId : nullptr;
+
+  // Unencrypted samples (e.g. clear lead) dont need the key, so dont wait for its license
+  if (!keyId)
+    return true;
+
+  Adaptive_CencSingleSampleDecrypter* currentSsd{m_singleSampleDecryptor};
+  if (!SwitchDecrypter(keyId))
+    return false;
+
+  if (m_singleSampleDecryptor != currentSsd)
+  {
+    m_decrypter->SetSingleSampleDecrypter(m_singleSampleDecryptor);
+    SetFragmentInfo();
+  }
+  return true;
+}
+
+bool CFragmentedSampleReader::SwitchDecrypter(const AP4_UI08* keyId)
+{
+  if (!m_singleSampleDecryptor || m_keyRotation->HasKey(m_singleSampleDecryptor, keyId))
+    return true;
+
+  const std::string hexKid{
+      StringUtils::ToHexadecimal(std::string(reinterpret_cast<const char*>(keyId), 16))};
+
+  Adaptive_CencSingleSampleDecrypter* ssd{nullptr};
+  SSD::SSD_DECRYPTER::SSD_CAPS caps{};
+  const SESSION::CKeyRotation::KeyStatus status{m_keyRotation->GetDecrypter(keyId, ssd, caps)};
+  // Each sample can look up the key, so log the failures once per key
+  const bool isNewMissingKey{std::memcmp(m_missingKeyId, keyId, 16) != 0};
+  std::memcpy(m_missingKeyId, keyId, 16);
+
+  if (status == SESSION::CKeyRotation::KeyStatus::PENDING)
+    return false;
+
+  if (status == SESSION::CKeyRotation::KeyStatus::NOT_AVAILABLE)
+  {
+    if (isNewMissingKey)
+      LOG::LogF(LOGERROR, "No license available for the KID %s", hexKid.c_str());
+    return true;
+  }
+
+  // The secure decoder cannot decode the samples of a non-secure decrypter and vice versa,
+  // between two secure decrypters the decoder is opened again with the new DRM session
+  const bool isSecurePath{(m_decrypterCaps.flags &
+                           SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SECURE_PATH) != 0};
+  if (isSecurePath != ((caps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SECURE_PATH) != 0))
+  {
+    if (isNewMissingKey)
+    {
+      LOG::LogF(LOGERROR, "Cannot switch decrypter for KID %s, the secure path differ",
+                hexKid.c_str());
+    }
+    m_keyRotation->ReleaseDecrypter(ssd);
+    return true;
+  }
+
+  // The samples already decrypted dont use the pool anymore
+  m_singleSampleDecryptor->RemovePool(m_poolId);
+  if (m_isRotatedDecrypter)
+    m_keyRotation->ReleaseDecrypter(m_singleSampleDecryptor);
+
+  m_singleSampleDecryptor = ssd;
+  m_isRotatedDecrypter = true;
+  m_poolId = m_singleSampleDecryptor->AddPool();
+  m_decrypterCaps = caps;
+  std::memset(m_missingKeyId, 0, 16);
+  if (isSecurePath)
+    m_isCryptoSessionChanged = true;
+
+  LOG::LogF(LOGDEBUG, "Decrypter switched for KID %s", hexKid.c_str());
+  return true;
+}
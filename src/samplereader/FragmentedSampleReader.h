@@ -12,9 +12,25 @@
 #include "../codechandler/CodecHandler.h"
 #include "../common/AdaptiveDecrypter.h"
 #include "../common/AdaptiveCencSampleDecrypter.h"
+#include "../common/CencSampleGroups.h"
 #include "../utils/log.h"
+#include "EventMessage.h"
+#include "FragmentSampleIndex.h"
 #include "SampleReader.h"
 
+#include <string>
+#include <vector>
+
+namespace SESSION
+{
+class CKeyRotation;
+}
+
+namespace adaptive
+{
+class AdaptiveTree;
+}
+
 class ATTR_DLL_LOCAL CFragmentedSampleReader : public ISampleReader, public AP4_LinearReader
 {
 public:
@@ -48,6 +64,23 @@ public:
   bool GetNextFragmentInfo(uint64_t& ts, uint64_t& dur) override;
   uint32_t GetTimeScale() const override { return m_track->GetMediaTimeScale(); }
   CryptoInfo GetReaderCryptoInfo() const override { return m_readerCryptoInfo; }
+  bool GetCaptionData(std::vector<uint8_t>& ccData) override;
+  bool IsWaitingLicense() override;
+  const char* GetCryptoSessionId() const override;
+
+  /*!
+   * \brief Set the key rotation handler, used to switch decrypter when the key
+   *        of the samples change.
+   * \param keyRotation The key rotation handler, can be nullptr
+   */
+  void SetKeyRotation(SESSION::CKeyRotation* keyRotation) { m_keyRotation = keyRotation; }
+
+  /*!
+   * \brief Set the tree that handle the in-band events (emsg) of the fragments,
+   *        e.g. to update the manifest when an MPD event signal its expiration.
+   * \param adaptiveTree The adaptive tree, can be nullptr
+   */
+  void SetAdaptiveTree(adaptive::AdaptiveTree* adaptiveTree) { m_adaptiveTree = adaptiveTree; }
 
   static const AP4_UI32 TRACKID_UNKNOWN = -1;
 
@@ -58,7 +91,65 @@ protected:
                          AP4_UI64 mdat_payload_size) override;
 
 private:
+  /*!
+   * \brief Set the timestamps of the sample read.
+   */
+  AP4_Result ReadSampleDone();
+  /*!
+   * \brief Decrypt the current sample together with the next samples of the
+   *        fragment, the next samples are returned by the next ReadSample calls.
+   */
+  AP4_Result DecryptSampleBatch();
+  /*!
+   * \brief Account the decryption result of the current sample, the data of
+   *        a failed sample are dropped.
+   * \return False when too many consecutive samples failed, the reader is reset
+   */
+  bool HandleDecryptResult(AP4_Result result);
   void UpdateSampleDescription();
+  void UpdateDefaultKey();
+  /*!
+   * \brief Update the pattern of the reader crypto info for a sample of the
+   *        fragment, the sample group of the sample can override it.
+   * \param sampleIndex The index of the sample in the fragment
+   */
+  void UpdateSampleCryptoInfo(AP4_Ordinal sampleIndex);
+  /*!
+   * \brief Request the licenses of new PSSH found in the fragment.
+   */
+  void CheckFragmentPssh(AP4_ContainerAtom* moof);
+  /*!
+   * \brief Parse the event message boxes (emsg) between the previous fragment and
+   *        the moof, the linear reader skip all boxes that are not a moof.
+   */
+  std::vector<CEventMessage> ParseEventMessages(AP4_Position moofOffset);
+  /*!
+   * \brief Send the event messages to the adaptive tree as timed events.
+   * \param eventMessages The event messages found before the moof
+   * \param fragmentStartPts The PTS of the first sample of the fragment, used
+   *                         as the base time of the version 0 boxes
+   */
+  void SendEventMessages(const std::vector<CEventMessage>& eventMessages,
+                         uint64_t fragmentStartPts);
+  /*!
+   * \brief Set the fragment info to the pool of the current decrypter.
+   */
+  void SetFragmentInfo();
+  /*!
+   * \brief Check if some sample of the fragment use a key that the current
+   *        decrypter dont have.
+   */
+  bool HasSampleKeys();
+  /*!
+   * \brief Switch to the decrypter that own the key of the current sample, if needed.
+   * \return False if the license of the key is still pending, otherwise true
+   */
+  bool PrepareSampleDecrypter();
+  /*!
+   * \brief Switch to the decrypter that own the key, if the current one dont have it.
+   * \return False if the license of the key is still pending, otherwise true
+   */
+  bool SwitchDecrypter(const AP4_UI08* keyId);
 
   AP4_Track* m_track;
   AP4_UI32 m_poolId{0};
@@ -81,10 +172,33 @@ private:
   AP4_DataBuffer m_sampleData;
   CodecHandler* m_codecHandler{nullptr};
   const AP4_UI08* m_defaultKey{nullptr};
+  AP4_UI08 m_defaultIvSize{0};
+  const AP4_UI08* m_defaultConstantIv{nullptr};
+  const AP4_UI08* m_fragmentKey{nullptr}; // Points to m_defaultKey or m_sampleGroupKey
+  AP4_UI08 m_sampleGroupKey[16]{};
+  CCencSampleGroups m_sampleGroups;
+  SESSION::CKeyRotation* m_keyRotation{nullptr};
+  bool m_isRotatedDecrypter{false}; // The decrypter is in use from the key rotation
+  bool m_hasSampleKeys{false}; // The decrypter can change between the samples of the fragment
+  bool m_isSampleHeld{false}; // The current sample wait the license of its key
+  AP4_UI08 m_missingKeyId[16]{}; // The last key not available, pending or failed
+  bool m_isCryptoSessionChanged{false};
+  adaptive::AdaptiveTree* m_adaptiveTree{nullptr};
+  AP4_Position m_fragmentEndPos{0}; // Stream position where the previous fragment end
+  std::string m_lastPssh; // The last PSSH box found in the fragments
   AP4_ProtectedSampleDescription* m_protectedDesc{nullptr};
   Adaptive_CencSingleSampleDecrypter* m_singleSampleDecryptor;
   CAdaptiveCencSampleDecrypter* m_decrypter{nullptr};
   uint64_t m_nextDuration{0};
   uint64_t m_nextTimestamp{0};
+  CFragmentSampleIndex m_fragmentIndex;
   CryptoInfo m_readerCryptoInfo{};
+  CryptoInfo m_fragmentCryptoInfo{};
+  // Audio samples read in advance and decrypted in batch
+  std::vector<AP4_Sample> m_batchSamples;
+  std::vector<AP4_DataBuffer> m_batchEncrypted;
+  std::vector<AP4_DataBuffer> m_batchDecrypted;
+  std::vector<AP4_Result> m_batchResults;
+  AP4_Ordinal m_batchSampleIndex{0}; // Fragment index of the first sample of the batch
+  size_t m_batchPos{0};
 };
@@ -21,6 +21,7 @@
 #endif
 
 #include <future>
+#include <vector>
 
 // Forward namespace/class
 namespace SESSION
@@ -53,11 +54,38 @@ public:
   virtual const AP4_Byte* GetSampleData() const = 0;
   virtual uint64_t GetDuration() const = 0;
   virtual bool IsEncrypted() const = 0;
-  virtual void AddStreamType(INPUTSTREAM_TYPE type, uint32_t sid) {};
+  /*!
+   * \brief Demux also a stream of another type multiplexed in the same container.
+   * \param type The stream type
+   * \param sid The stream id
+   * \param esIndex The position of the elementary stream among those of the same type
+   * \param esCount The expected number of elementary streams of the same type, 0 if unknown
+   */
+  virtual void AddStreamType(INPUTSTREAM_TYPE type, uint32_t sid, size_t esIndex, size_t esCount)
+  {
+  }
   virtual void SetStreamType(INPUTSTREAM_TYPE type, uint32_t sid) {};
   virtual bool RemoveStreamType(INPUTSTREAM_TYPE type) { return true; };
   virtual bool IsStarted() const = 0;
   virtual CryptoInfo GetReaderCryptoInfo() const { return CryptoInfo(); }
+  /*!
+   * \brief Get the closed captions data (CEA-608/708 cc_data) of the current sample.
+   * \param ccData [OUT] The cc_data triplets, empty when the picture has no captions
+   * \return True if the current sample is a picture that can carry closed captions
+   */
+  virtual bool GetCaptionData(std::vector<uint8_t>& ccData) { return false; }
+  /*!
+   * \brief Check if the current sample is waiting the license of its key,
+   *        once the license is acquired the sample is read again asynchronously.
+   * \return True if waiting, otherwise false
+   */
+  virtual bool IsWaitingLicense() { return false; }
+  /*!
+   * \brief Get the DRM session of the samples, when it differ from the session
+   *        of the stream (e.g. a rotated key decrypted on the secure path).
+   * \return The session id, otherwise nullptr
+   */
+  virtual const char* GetCryptoSessionId() const { return nullptr; }
 
   /*!
    * \brief Read the sample asynchronously
@@ -8,6 +8,34 @@
 
 #include "TSSampleReader.h"
 
+#include "../common/AdaptiveTree.h"
+#include "../utils/Scte35Utils.h"
+#include "../utils/log.h"
+
+#include <cstring>
+
+namespace
+{
+constexpr size_t TS_PACKET_SIZE = 188;
+// Limit the keys stored for PIDs of streams not demuxed
+constexpr size_t MAX_SAMPLE_AES_KEYS = 32;
+
+CSampleAesDecrypter::Codec GetSampleAesCodec(TSDemux::STREAM_TYPE streamType)
+{
+  switch (streamType)
+  {
+    case TSDemux::STREAM_TYPE_AUDIO_AAC:
+    case TSDemux::STREAM_TYPE_AUDIO_AAC_ADTS:
+      return CSampleAesDecrypter::Codec::AAC;
+    case TSDemux::STREAM_TYPE_AUDIO_AC3:
+    case TSDemux::STREAM_TYPE_AUDIO_EAC3:
+      return CSampleAesDecrypter::Codec::AC3;
+    default:
+      return CSampleAesDecrypter::Codec::H264;
+  }
+}
+} // unnamed namespace
+
 CTSSampleReader::CTSSampleReader(AP4_ByteStream* input,
                                INPUTSTREAM_TYPE type,
                                AP4_UI32 streamId,
@@ -30,9 +58,13 @@ bool CTSSampleReader::Initialize()
   return false;
 }
 
-void CTSSampleReader::AddStreamType(INPUTSTREAM_TYPE type, uint32_t sid)
+void CTSSampleReader::AddStreamType(INPUTSTREAM_TYPE type,
+                                    uint32_t sid,
+                                    size_t esIndex,
+                                    size_t esCount)
 {
   m_typeMap[type] = sid;
+  SetStreamIndex(type, esIndex, esCount);
   m_typeMask |= (1 << type);
   if (m_started)
     StartStreaming(m_typeMask);
@@ -80,6 +112,8 @@ AP4_Result CTSSampleReader::ReadSample()
       m_ptsDiff = m_pts - m_ptsOffs;
       m_ptsOffs = ~0ULL;
     }
+    DecryptSampleAes();
+    SendSpliceInfoSections();
     return AP4_SUCCESS;
   }
   if (!m_adByteStream || !m_adByteStream->waitingForSegment())
@@ -91,6 +125,7 @@ void CTSSampleReader::Reset(bool bEOS)
 {
   TSReader::Reset();
   m_eos = bEOS;
+  m_sampleAesKeys.clear();
 }
 
 bool CTSSampleReader::TimeSeek(uint64_t pts, bool preceeding)
@@ -98,6 +133,8 @@ bool CTSSampleReader::TimeSeek(uint64_t pts, bool preceeding)
   if (!StartStreaming(m_typeMask))
     return false;
 
+  m_sampleAesKeys.clear();
+
   AP4_UI64 seekPos((pts * 9) / 100);
   if (TSReader::SeekTime(seekPos, preceeding))
   {
@@ -106,3 +143,140 @@ bool CTSSampleReader::TimeSeek(uint64_t pts, bool preceeding)
   }
   return AP4_ERROR_EOS;
 }
+
+bool CTSSampleReader::GetCaptionData(std::vector<uint8_t>& ccData)
+{
+  if (GetStreamType() != INPUTSTREAM_TYPE_VIDEO)
+    return false;
+
+  // The cc_data is parsed by the elementary stream parser from the SEI NAL units
+  const unsigned char* data = GetPacketCaptionData();
+  if (data)
+    ccData.assign(data, data + GetPacketCaptionDataSize());
+  else
+    ccData.clear();
+  return true;
+}
+
+bool CTSSampleReader::ReadAV(uint64_t pos, unsigned char* data, size_t len)
+{
+  if (!TSReader::ReadAV(pos, data, len))
+    return false;
+
+  // Packets can have a prefix e.g. the timecode of M2TS packets
+  if (m_adByteStream && len >= TS_PACKET_SIZE && data[len - TS_PACKET_SIZE] == 0x47)
+    TrackSampleAesKey(data + (len - TS_PACKET_SIZE));
+
+  return true;
+}
+
+void CTSSampleReader::TrackSampleAesKey(const unsigned char* packet)
+{
+  // Only the packets with the payload unit start indicator begin a PES packet
+  if (!(packet[1] & 0x40))
+    return;
+
+  const uint16_t pid = static_cast<uint16_t>(((packet[1] & 0x1F) << 8) | packet[2]);
+  const uint8_t adaptationControl = (packet[3] >> 4) & 0x03;
+  if (!(adaptationControl & 0x01)) // No payload
+    return;
+
+  size_t payloadPos{4};
+  if (adaptationControl & 0x02)
+    payloadPos += 1 + packet[4];
+
+  // PES header with PTS
+  const unsigned char* pes{packet + payloadPos};
+  if (payloadPos + 14 > TS_PACKET_SIZE || pes[0] != 0 || pes[1] != 0 || pes[2] != 1 ||
+      !(pes[7] & 0x80))
+    return;
+
+  SampleAesKey sampleAesKey;
+  if (!m_adByteStream->GetSampleAesKey(sampleAesKey.m_key, sampleAesKey.m_iv))
+    return;
+
+  sampleAesKey.m_pts = (static_cast<uint64_t>(pes[9] & 0x0E) << 29) |
+                       (static_cast<uint64_t>(pes[10]) << 22) |
+                       (static_cast<uint64_t>(pes[11] & 0xFE) << 14) |
+                       (static_cast<uint64_t>(pes[12]) << 7) | (pes[13] >> 1);
+
+  std::deque<SampleAesKey>& keys = m_sampleAesKeys[pid];
+  if (!keys.empty() && keys.back().m_key == sampleAesKey.m_key &&
+      std::memcmp(keys.back().m_iv, sampleAesKey.m_iv, 16) == 0)
+    return;
+
+  keys.emplace_back(sampleAesKey);
+  if (keys.size() > MAX_SAMPLE_AES_KEYS)
+    keys.pop_front();
+}
+
+void CTSSampleReader::DecryptSampleAes()
+{
+  m_isSampleDecrypted = false;
+
+  const TSDemux::ElementaryStream* stream{GetPacketStream()};
+  if (!stream || !stream->is_sample_aes)
+    return;
+
+  auto itKeys = m_sampleAesKeys.find(stream->pid);
+  if (itKeys == m_sampleAesKeys.end() || itKeys->second.empty())
+  {
+    LOG::LogF(LOGERROR, "No SAMPLE-AES key available for PID %u", stream->pid);
+    return;
+  }
+
+  // Use the key of the last PES packet started before the sample, the keys
+  // of the previous PES packets are no longer needed
+  std::deque<SampleAesKey>& keys = itKeys->second;
+  const uint64_t pts{GetPts()};
+  if (pts != PTS_UNSET)
+  {
+    while (keys.size() > 1 && keys[1].m_pts <= pts)
+      keys.pop_front();
+  }
+  const SampleAesKey& sampleAesKey = keys.front();
+
+  if (!m_sampleAesDecrypter.SetKey(sampleAesKey.m_key, sampleAesKey.m_iv))
+    return;
+
+  m_sampleData.assign(GetPacketData(), GetPacketData() + GetPacketSize());
+  size_t size{m_sampleData.size()};
+  if (!m_sampleAesDecrypter.DecryptSample(GetSampleAesCodec(stream->stream_type),
+                                          m_sampleData.data(), size))
+  {
+    LOG::LogF(LOGERROR, "Cannot decrypt the SAMPLE-AES sample of PID %u", stream->pid);
+    return;
+  }
+  m_sampleData.resize(size);
+  m_isSampleDecrypted = true;
+}
+
+void CTSSampleReader::SendSpliceInfoSections()
+{
+  for (const std::vector<unsigned char>& section : TakeSpliceInfoSections())
+  {
+    UTILS::SCTE35::SpliceInfo info;
+    if (!m_adaptiveTree ||
+        !UTILS::SCTE35::ParseSpliceInfoSection(section.data(), section.size(), info) ||
+        info.m_isEncrypted || info.m_commandType == UTILS::SCTE35::CommandType::SPLICE_NULL)
+      continue;
+
+    adaptive::TimedEvent event;
+    event.m_schemeIdUri = adaptive::SCHEME_SCTE35_BIN;
+    // Splices without time (e.g. splice_insert immediate) apply to the current sample
+    event.m_time = info.m_ptsTime ? (*info.m_ptsTime * 100) / 9 : m_pts;
+    event.m_messageData.assign(section.begin(), section.end());
+    adaptive::ApplySpliceInfo(event, event.m_messageData);
+
+    // The same splice is usually repeated before the splice time
+    uint32_t eventId{info.m_eventId};
+    if (info.m_commandType != UTILS::SCTE35::CommandType::SPLICE_INSERT &&
+        !info.m_segmentations.empty())
+      eventId = info.m_segmentations.front().m_eventId;
+    event.m_id = std::to_string(eventId) + ":" + std::to_string(event.m_time);
+
+    LOG::Log(LOGDEBUG, "SCTE-35 splice info found (command type: %u, event id: %u)",
+             static_cast<unsigned int>(info.m_commandType), eventId);
+    m_adaptiveTree->OnInbandEvent(event);
+  }
+}
@@ -8,8 +8,19 @@
 
 #include "../AdaptiveByteStream.h"
 #include "../TSReader.h"
+#include "../common/SampleAesDecrypter.h"
 #include "SampleReader.h"
 
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace adaptive
+{
+class AdaptiveTree;
+}
+
 class ATTR_DLL_LOCAL CTSSampleReader : public ISampleReader, public TSReader
 {
 public:
@@ -19,7 +30,10 @@ public:
                   uint32_t requiredMask);
 
   bool Initialize() override;
-  void AddStreamType(INPUTSTREAM_TYPE type, uint32_t sid) override;
+  void AddStreamType(INPUTSTREAM_TYPE type,
+                     uint32_t sid,
+                     size_t esIndex,
+                     size_t esCount) override;
   void SetStreamType(INPUTSTREAM_TYPE type, uint32_t sid) override;
   bool RemoveStreamType(INPUTSTREAM_TYPE type) override;
   bool IsStarted() const override { return m_started; }
@@ -41,12 +55,49 @@ public:
   bool GetNextFragmentInfo(uint64_t& ts, uint64_t& dur) override { return false; }
   uint32_t GetTimeScale() const override { return 90000; }
   AP4_UI32 GetStreamId() const override { return m_typeMap[GetStreamType()]; }
-  AP4_Size GetSampleDataSize() const override { return GetPacketSize(); }
-  const AP4_Byte* GetSampleData() const override { return GetPacketData(); }
+  AP4_Size GetSampleDataSize() const override
+  {
+    return m_isSampleDecrypted ? static_cast<AP4_Size>(m_sampleData.size()) : GetPacketSize();
+  }
+  const AP4_Byte* GetSampleData() const override
+  {
+    return m_isSampleDecrypted ? m_sampleData.data() : GetPacketData();
+  }
   uint64_t GetDuration() const override { return (TSReader::GetDuration() * 100) / 9; }
   bool IsEncrypted() const override { return false; }
+  bool GetCaptionData(std::vector<uint8_t>& ccData) override;
+
+  bool ReadAV(uint64_t pos, unsigned char* data, size_t len) override;
+
+  void SetAdaptiveTree(adaptive::AdaptiveTree* adaptiveTree) { m_adaptiveTree = adaptiveTree; }
 
 private:
+  /*!
+   * \brief Send the SCTE-35 splice info sections read to the adaptive tree as timed events.
+   */
+  void SendSpliceInfoSections();
+  /*!
+   * \brief Store the SAMPLE-AES key of the segment currently read, for the PES
+   *        packet started by the TS packet, when the key differs from the last one.
+   */
+  void TrackSampleAesKey(const unsigned char* packet);
+  /*!
+   * \brief Decrypt the current packet when the stream is encrypted with SAMPLE-AES.
+   */
+  void DecryptSampleAes();
+
+  struct SampleAesKey
+  {
+    uint64_t m_pts;
+    std::string m_key;
+    uint8_t m_iv[16];
+  };
+  // SAMPLE-AES keys by PID, in the order of the PES packets read
+  std::map<uint16_t, std::deque<SampleAesKey>> m_sampleAesKeys;
+  CSampleAesDecrypter m_sampleAesDecrypter;
+  std::vector<AP4_Byte> m_sampleData; // The decrypted sample data
+  bool m_isSampleDecrypted{false};
+
   uint32_t m_typeMask; //Bit representation of INPUTSTREAM_TYPES
   uint32_t m_typeMap[16];
   uint64_t m_pts{0};
@@ -57,4 +108,5 @@ private:
   bool m_eos{false};
   bool m_started{false};
   CAdaptiveByteStream* m_adByteStream;
+  adaptive::AdaptiveTree* m_adaptiveTree{nullptr};
 };
@@ -8,11 +8,41 @@
 
 #include "WebmSampleReader.h"
 
+#include "../common/AdaptiveDecrypter.h"
+#include "../utils/log.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+// Signal byte flags of the WebM encryption spec
+constexpr AP4_UI08 SIGNAL_ENCRYPTED = 0x01;
+constexpr AP4_UI08 SIGNAL_PARTITIONED = 0x02;
+constexpr AP4_Size IV_SIZE = 8;
+} // unnamed namespace
+
 CWebmSampleReader::CWebmSampleReader(AP4_ByteStream* input, AP4_UI32 streamId)
   : WebmReader{input},
     m_streamId{streamId},
     m_adByteStream{dynamic_cast<CAdaptiveByteStream*>(input)} {};
 
+CWebmSampleReader::~CWebmSampleReader()
+{
+  if (m_decrypter)
+    m_decrypter->RemovePool(m_poolId);
+}
+
+void CWebmSampleReader::SetDecrypter(Adaptive_CencSingleSampleDecrypter* ssd)
+{
+  if (m_decrypter)
+    m_decrypter->RemovePool(m_poolId);
+
+  m_decrypter = ssd;
+  if (m_decrypter)
+    m_poolId = m_decrypter->AddPool();
+}
+
 bool CWebmSampleReader::Initialize()
 {
   m_adByteStream->FixateInitialization(true);
@@ -36,6 +66,14 @@ AP4_Result CWebmSampleReader::ReadSample()
 {
   if (ReadPacket())
   {
+    m_isSampleDecrypted = false;
+    if (!GetKeyId().empty() && !DecryptPacket())
+    {
+      // Do not send the encrypted data to the decoder
+      m_sampleData.SetDataSize(0);
+      m_isSampleDecrypted = true;
+    }
+
     m_dts = GetDts() * 1000;
     m_pts = GetPts() * 1000;
 
@@ -67,3 +105,99 @@ bool CWebmSampleReader::TimeSeek(uint64_t pts, bool preceeding)
   }
   return AP4_ERROR_EOS;
 }
+
+bool CWebmSampleReader::DecryptPacket()
+{
+  const AP4_Byte* data{GetPacketData()};
+  AP4_Size size{GetPacketSize()};
+  if (size == 0)
+    return true;
+
+  const AP4_UI08 signal{data[0]};
+  data++, size--;
+
+  if (!(signal & SIGNAL_ENCRYPTED))
+  {
+    m_sampleData.SetData(data, size);
+    m_isSampleDecrypted = true;
+    return true;
+  }
+
+  if (!m_decrypter || GetKeyId().size() != 16)
+  {
+    LOG::LogF(LOGERROR, "No decrypter available for the encrypted WebM block");
+    return false;
+  }
+  if (size < IV_SIZE)
+  {
+    LOG::LogF(LOGERROR, "Invalid encrypted WebM block");
+    return false;
+  }
+
+  // The 8 bytes IV is the high part of the AES-CTR counter block
+  AP4_UI08 iv[16]{};
+  std::memcpy(iv, data, IV_SIZE);
+  data += IV_SIZE, size -= IV_SIZE;
+
+  // Partitions alternate clear and encrypted data, starting with clear data,
+  // a block not partitioned is a single encrypted partition
+  std::vector<AP4_UI32> offsets{0};
+  if (signal & SIGNAL_PARTITIONED)
+  {
+    if (size < 1 || size < 1 + data[0] * 4U)
+    {
+      LOG::LogF(LOGERROR, "Invalid partitioned WebM block");
+      return false;
+    }
+    const AP4_UI08 count{data[0]};
+    data++, size--;
+    for (AP4_UI08 i = 0; i < count; ++i, data += 4, size -= 4)
+      offsets.emplace_back(AP4_BytesToUInt32BE(data));
+  }
+  else
+    offsets.emplace_back(0);
+  offsets.emplace_back(size);
+
+  for (size_t i = 1; i < offsets.size(); ++i)
+  {
+    if (offsets[i] < offsets[i - 1] || offsets[i] > size)
+    {
+      LOG::LogF(LOGERROR, "Invalid partition offsets of WebM block");
+      return false;
+    }
+  }
+
+  std::vector<AP4_UI16> clearBytes;
+  std::vector<AP4_UI32> cipherBytes;
+  for (size_t i = 0; i + 1 < offsets.size(); i += 2)
+  {
+    AP4_UI32 clearSize{offsets[i + 1] - offsets[i]};
+    const AP4_UI32 cipherEnd{i + 2 < offsets.size() ? offsets[i + 2] : offsets[i + 1]};
+    // Split the clear data exceeding the subsample clear bytes range
+    while (clearSize > 0xFFFF)
+    {
+      clearBytes.emplace_back(0xFFFF);
+      cipherBytes.emplace_back(0);
+      clearSize -= 0xFFFF;
+    }
+    clearBytes.emplace_back(static_cast<AP4_UI16>(clearSize));
+    cipherBytes.emplace_back(cipherEnd - offsets[i + 1]);
+  }
+
+  // The key is set for each block as the tracks are parsed while reading
+  AP4_DataBuffer spsPps;
+  m_decrypter->SetFragmentInfo(m_poolId, reinterpret_cast<const AP4_UI08*>(GetKeyId().data()),
+                               0, spsPps, 0, {0, 0, CryptoMode::AES_CTR});
+
+  AP4_DataBuffer dataIn{data, size};
+  m_sampleData.SetDataSize(0);
+  if (AP4_FAILED(m_decrypter->DecryptSampleData(
+          m_poolId, dataIn, m_sampleData, iv, static_cast<unsigned int>(clearBytes.size()),
+          clearBytes.data(), cipherBytes.data(), nullptr)))
+  {
+    LOG::LogF(LOGERROR, "Cannot decrypt the WebM block");
+    return false;
+  }
+  m_isSampleDecrypted = true;
+  return true;
+}
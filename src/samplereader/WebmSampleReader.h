@@ -10,10 +10,13 @@
 #include "../WebmReader.h"
 #include "SampleReader.h"
 
+class Adaptive_CencSingleSampleDecrypter;
+
 class ATTR_DLL_LOCAL CWebmSampleReader : public ISampleReader, public WebmReader
 {
 public:
   CWebmSampleReader(AP4_ByteStream* input, AP4_UI32 streamId);
+  ~CWebmSampleReader() override;
 
   bool IsStarted() const override { return m_started; }
   bool EOS() const override { return m_eos; }
@@ -35,12 +38,32 @@ public:
   bool GetNextFragmentInfo(uint64_t& ts, uint64_t& dur) override { return false; }
   uint32_t GetTimeScale() const override { return 1000; }
   AP4_UI32 GetStreamId() const override { return m_streamId; }
-  AP4_Size GetSampleDataSize() const override { return GetPacketSize(); }
-  const AP4_Byte* GetSampleData() const override { return GetPacketData(); }
+  AP4_Size GetSampleDataSize() const override
+  {
+    return m_isSampleDecrypted ? m_sampleData.GetDataSize() : GetPacketSize();
+  }
+  const AP4_Byte* GetSampleData() const override
+  {
+    return m_isSampleDecrypted ? m_sampleData.GetData() : GetPacketData();
+  }
   uint64_t GetDuration() const override { return WebmReader::GetDuration() * 1000; }
   bool IsEncrypted() const override { return false; }
 
+  /*!
+   * \brief Set the decrypter of the blocks encrypted with the WebM encryption,
+   *        the blocks are decrypted in software, the secure path is not supported.
+   * \param ssd The decrypter, can be nullptr for clear streams
+   */
+  void SetDecrypter(Adaptive_CencSingleSampleDecrypter* ssd);
+
 private:
+  /*!
+   * \brief Remove the signal byte of the block read and decrypt it if encrypted,
+   *        the block is as specified by the WebM encryption spec.
+   * \return True if success, otherwise false
+   */
+  bool DecryptPacket();
+
   AP4_UI32 m_streamId;
   uint64_t m_pts{0};
   uint64_t m_dts{0};
@@ -50,4 +73,8 @@ private:
   bool m_eos{false};
   bool m_started{false};
   CAdaptiveByteStream* m_adByteStream;
+  Adaptive_CencSingleSampleDecrypter* m_decrypter{nullptr};
+  AP4_UI32 m_poolId{0};
+  AP4_DataBuffer m_sampleData;
+  bool m_isSampleDecrypted{false};
 };
@@ -0,0 +1,695 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "ClearKeyDecrypter.h"
+
+#include "LicenseServerStub.h"
+#include "../utils/Base64Utils.h"
+#include "../utils/log.h"
+#include "../../wvdecrypter/LicenseExchange.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+using namespace UTILS;
+
+namespace
+{
+constexpr size_t CIPHER_BLOCK_SIZE = 16;
+// The service certificate request sent by the Widevine CDM in privacy mode
+const std::string SERVICE_CERTIFICATE_REQUEST{"\x08\x04", 2};
+
+// Get the KIDs of a PSSH box version 1, or of a list of KIDs
+void ParsePsshKeyIds(std::string_view pssh, std::vector<std::string>& keyIds)
+{
+  if (pssh.size() >= 32 && pssh.substr(4, 4) == "pssh" && pssh[8] == 1)
+  {
+    const uint32_t count{
+        AP4_BytesToUInt32BE(reinterpret_cast<const AP4_UI08*>(pssh.data()) + 28)};
+    for (uint32_t i = 0; i < count && 32 + (i + 1) * 16 <= pssh.size(); ++i)
+      keyIds.emplace_back(pssh.substr(32 + i * 16, 16));
+  }
+  else if (!pssh.empty() && pssh.size() % 16 == 0)
+  {
+    for (size_t pos = 0; pos < pssh.size(); pos += 16)
+      keyIds.emplace_back(pssh.substr(pos, 16));
+  }
+}
+
+std::string_view GetJsonString(std::string_view json, std::string_view field)
+{
+  const std::string key{"\"" + std::string(field) + "\":\""};
+  const size_t pos{json.find(key)};
+  if (pos == std::string_view::npos)
+    return {};
+
+  const size_t valuePos{pos + key.size()};
+  return json.substr(valuePos, json.find('"', valuePos) - valuePos);
+}
+
+bool CreateCipher(const std::string& key,
+                  AP4_BlockCipher::CipherMode mode,
+                  std::unique_ptr<AP4_BlockCipher>& cipher)
+{
+  AP4_BlockCipher::CtrParams ctrParams;
+  ctrParams.counter_size = 8;
+  AP4_BlockCipher* blockCipher{nullptr};
+  if (AP4_FAILED(AP4_DefaultBlockCipherFactory::Instance.CreateCipher(
+          AP4_BlockCipher::AES_128, AP4_BlockCipher::DECRYPT, mode,
+          mode == AP4_BlockCipher::CTR ? &ctrParams : nullptr,
+          reinterpret_cast<const AP4_UI08*>(key.data()), 16, blockCipher)))
+  {
+    return false;
+  }
+  cipher.reset(blockCipher);
+  return true;
+}
+} // unnamed namespace
+
+CClearKeySingleSampleDecrypter::CClearKeySingleSampleDecrypter(CClearKeyDecrypter& drm,
+                                                               AP4_DataBuffer& pssh,
+                                                               std::string_view defaultKeyId,
+                                                               bool skipSessionMessage,
+                                                               CryptoMode cryptoMode)
+  : m_drm{drm},
+    m_pssh{reinterpret_cast<const char*>(pssh.GetData()), pssh.GetDataSize()},
+    m_defaultKeyId{defaultKeyId},
+    m_cryptoMode{cryptoMode}
+{
+  ParsePsshKeyIds(m_pssh, m_keyIds);
+  if (m_defaultKeyId.size() == 16)
+    AddKeyId(m_defaultKeyId);
+
+  if (m_keyIds.empty())
+  {
+    LOG::LogF(LOGERROR, "No KID found in the PSSH init data");
+    return;
+  }
+
+  m_sessionId = m_drm.CreateSessionId();
+  GenerateRequest();
+
+  if (skipSessionMessage)
+    return;
+
+  while (!GetChallengeData().empty() && SendSessionMessage())
+    ;
+
+  if (!HasKeys())
+  {
+    LOG::LogF(LOGERROR, "License update not successful (no keys)");
+    CloseSessionId();
+  }
+}
+
+void CClearKeySingleSampleDecrypter::AddKeyId(std::string_view keyId)
+{
+  if (std::find(m_keyIds.begin(), m_keyIds.end(), keyId) == m_keyIds.end())
+    m_keyIds.emplace_back(keyId);
+}
+
+void CClearKeySingleSampleDecrypter::SetDefaultKeyId(std::string_view keyId)
+{
+  m_defaultKeyId = keyId;
+}
+
+AP4_Result CClearKeySingleSampleDecrypter::SetFragmentInfo(AP4_UI32 pool_id,
+                                                           const AP4_UI08* key,
+                                                           const AP4_UI08 nal_length_size,
+                                                           AP4_DataBuffer& annexb_sps_pps,
+                                                           AP4_UI32 flags,
+                                                           CryptoInfo cryptoInfo)
+{
+  if (pool_id >= m_fragmentPool.size())
+    return AP4_ERROR_OUT_OF_RANGE;
+
+  m_fragmentPool[pool_id].m_key = key;
+  m_fragmentPool[pool_id].m_cryptoInfo = cryptoInfo;
+  return AP4_SUCCESS;
+}
+
+AP4_Result CClearKeySingleSampleDecrypter::DecryptSampleData(
+    AP4_UI32 poolid,
+    AP4_DataBuffer& data_in,
+    AP4_DataBuffer& data_out,
+    const AP4_UI08* iv,
+    unsigned int subsample_count,
+    const AP4_UI16* bytes_of_cleartext_data,
+    const AP4_UI32* bytes_of_encrypted_data,
+    const SampleKeyInfo* sampleKeyInfo)
+{
+  if (poolid >= m_fragmentPool.size())
+    return AP4_ERROR_OUT_OF_RANGE;
+
+  // On batch decrypt the renewal is checked once for all the samples
+  if (!m_isBatchDecrypt)
+    CheckLicenseRenewal();
+
+  const FINFO& fragInfo{m_fragmentPool[poolid]};
+  const AP4_UI08* keyId{fragInfo.m_key};
+  CryptoInfo cryptoInfo{fragInfo.m_cryptoInfo};
+  if (sampleKeyInfo)
+  {
+    if (sampleKeyInfo->m_keyId)
+      keyId = sampleKeyInfo->m_keyId;
+    cryptoInfo.m_cryptBlocks = sampleKeyInfo->m_cryptBlocks;
+    cryptoInfo.m_skipBlocks = sampleKeyInfo->m_skipBlocks;
+  }
+  if (cryptoInfo.m_mode == CryptoMode::NONE)
+    cryptoInfo.m_mode = m_cryptoMode;
+
+  data_out.SetData(data_in.GetData(), data_in.GetDataSize());
+  if (!iv)
+    return AP4_SUCCESS;
+
+  std::string key;
+  if (!keyId || !GetKey(keyId, key))
+  {
+    LOG::LogF(LOGERROR, "The license have not the key of the sample");
+    return AP4_ERROR_INVALID_PARAMETERS;
+  }
+
+  const AP4_UI16 clearBytes{0};
+  const AP4_UI32 cipherBytes{data_in.GetDataSize()};
+  if (subsample_count == 0)
+  {
+    subsample_count = 1;
+    bytes_of_cleartext_data = &clearBytes;
+    bytes_of_encrypted_data = &cipherBytes;
+  }
+
+  size_t sampleSize{0};
+  for (unsigned int i = 0; i < subsample_count; ++i)
+    sampleSize += bytes_of_cleartext_data[i] + bytes_of_encrypted_data[i];
+  if (sampleSize > data_in.GetDataSize())
+  {
+    LOG::LogF(LOGERROR, "The subsamples exceed the sample size");
+    return AP4_ERROR_INVALID_PARAMETERS;
+  }
+
+  m_decryptRequestCount++;
+  std::unique_ptr<AP4_BlockCipher> cipher;
+  const bool isCbc{cryptoInfo.m_mode == CryptoMode::AES_CBC};
+  if (!CreateCipher(key, isCbc ? AP4_BlockCipher::CBC : AP4_BlockCipher::CTR, cipher))
+    return AP4_ERROR_INVALID_PARAMETERS;
+
+  const AP4_UI08* dataIn{data_in.GetData()};
+  AP4_UI08* dataOut{data_out.UseData()};
+
+  if (!isCbc)
+  {
+    // 'cenc' scheme, the counter continue between the subsamples
+    std::vector<AP4_UI08> encrypted;
+    size_t pos{0};
+    for (unsigned int i = 0; i < subsample_count; ++i)
+    {
+      pos += bytes_of_cleartext_data[i];
+      encrypted.insert(encrypted.end(), dataIn + pos, dataIn + pos + bytes_of_encrypted_data[i]);
+      pos += bytes_of_encrypted_data[i];
+    }
+
+    std::vector<AP4_UI08> decrypted(encrypted.size());
+    cipher->Process(encrypted.data(), static_cast<AP4_Size>(encrypted.size()), decrypted.data(),
+                    iv);
+
+    pos = 0;
+    size_t cipherPos{0};
+    for (unsigned int i = 0; i < subsample_count; ++i)
+    {
+      pos += bytes_of_cleartext_data[i];
+      std::memcpy(dataOut + pos, decrypted.data() + cipherPos, bytes_of_encrypted_data[i]);
+      pos += bytes_of_encrypted_data[i];
+      cipherPos += bytes_of_encrypted_data[i];
+    }
+    return AP4_SUCCESS;
+  }
+
+  // 'cbcs' scheme, the IV is reset to each subsample, the CBC chain skips the clear blocks
+  const size_t cryptBlocks{cryptoInfo.m_cryptBlocks};
+  const size_t skipBlocks{cryptoInfo.m_skipBlocks};
+  size_t pos{0};
+  for (unsigned int i = 0; i < subsample_count; ++i)
+  {
+    pos += bytes_of_cleartext_data[i];
+    AP4_UI08 chainIv[CIPHER_BLOCK_SIZE];
+    std::memcpy(chainIv, iv, CIPHER_BLOCK_SIZE);
+
+    size_t blocks{bytes_of_encrypted_data[i] / CIPHER_BLOCK_SIZE};
+    size_t blockPos{pos};
+    while (blocks > 0)
+    {
+      const size_t runBlocks{cryptBlocks == 0 ? blocks : std::min(cryptBlocks, blocks)};
+      const size_t runSize{runBlocks * CIPHER_BLOCK_SIZE};
+      cipher->Process(dataIn + blockPos, static_cast<AP4_Size>(runSize), dataOut + blockPos,
+                      chainIv);
+      std::memcpy(chainIv, dataIn + blockPos + runSize - CIPHER_BLOCK_SIZE, CIPHER_BLOCK_SIZE);
+
+      blocks -= runBlocks;
+      const size_t clearBlocks{std::min(skipBlocks, blocks)};
+      blocks -= clearBlocks;
+      blockPos += runSize + clearBlocks * CIPHER_BLOCK_SIZE;
+    }
+    pos += bytes_of_encrypted_data[i];
+  }
+  return AP4_SUCCESS;
+}
+
+AP4_Result CClearKeySingleSampleDecrypter::DecryptSampleBatch(AP4_UI32 poolId,
+                                                              SampleDecryptDesc* samples,
+                                                              size_t count)
+{
+  if (poolId >= m_fragmentPool.size())
+    return AP4_ERROR_OUT_OF_RANGE;
+
+  CheckLicenseRenewal();
+
+  CryptoMode mode{m_fragmentPool[poolId].m_cryptoInfo.m_mode};
+  if (mode == CryptoMode::NONE)
+    mode = m_cryptoMode;
+
+  m_isBatchDecrypt = true;
+  AP4_Result result{AP4_SUCCESS};
+  for (size_t i = 0; i < count;)
+  {
+    const size_t run{mode == CryptoMode::AES_CTR ? GetCtrSampleRun(samples + i, count - i) : 1};
+    if (run > 1)
+      DecryptCtrSampleRun(poolId, samples + i, run);
+    else
+    {
+      SampleDecryptDesc& sample{samples[i]};
+      sample.m_result = DecryptSampleData(poolId, *sample.m_dataIn, *sample.m_dataOut,
+                                          sample.m_iv, sample.m_subsampleCount,
+                                          sample.m_clearBytes, sample.m_cipherBytes,
+                                          sample.m_keyInfo);
+    }
+
+    for (size_t end{i + run}; i < end; ++i)
+    {
+      if (AP4_FAILED(samples[i].m_result) && AP4_SUCCEEDED(result))
+        result = samples[i].m_result;
+    }
+  }
+  m_isBatchDecrypt = false;
+  return result;
+}
+
+void CClearKeySingleSampleDecrypter::DecryptCtrSampleRun(AP4_UI32 poolId,
+                                                         SampleDecryptDesc* samples,
+                                                         size_t count)
+{
+  const AP4_UI08* keyId{samples[0].m_keyInfo && samples[0].m_keyInfo->m_keyId
+                            ? samples[0].m_keyInfo->m_keyId
+                            : m_fragmentPool[poolId].m_key};
+  std::string key;
+  std::unique_ptr<AP4_BlockCipher> cipher;
+  if (!keyId || !GetKey(keyId, key) || !CreateCipher(key, AP4_BlockCipher::CTR, cipher))
+  {
+    LOG::LogF(LOGERROR, "The license have not the key of the samples");
+    for (size_t i = 0; i < count; ++i)
+      samples[i].m_result = AP4_ERROR_INVALID_PARAMETERS;
+    return;
+  }
+
+  // Join the encrypted data of all the samples in a single AES-CTR stream
+  std::vector<AP4_UI08> encrypted;
+  for (size_t i = 0; i < count; ++i)
+  {
+    const SampleDecryptDesc& sample{samples[i]};
+    const AP4_UI08* dataIn{sample.m_dataIn->GetData()};
+    if (sample.m_subsampleCount == 0)
+    {
+      encrypted.insert(encrypted.end(), dataIn, dataIn + sample.m_dataIn->GetDataSize());
+      continue;
+    }
+    size_t pos{0};
+    for (unsigned int j = 0; j < sample.m_subsampleCount; ++j)
+    {
+      pos += sample.m_clearBytes[j];
+      encrypted.insert(encrypted.end(), dataIn + pos, dataIn + pos + sample.m_cipherBytes[j]);
+      pos += sample.m_cipherBytes[j];
+    }
+  }
+
+  m_decryptRequestCount++;
+  std::vector<AP4_UI08> decrypted(encrypted.size());
+  cipher->Process(encrypted.data(), static_cast<AP4_Size>(encrypted.size()), decrypted.data(),
+                  samples[0].m_iv);
+
+  // Split the decrypted stream back to the samples
+  size_t cipherPos{0};
+  for (size_t i = 0; i < count; ++i)
+  {
+    SampleDecryptDesc& sample{samples[i]};
+    sample.m_dataOut->SetData(sample.m_dataIn->GetData(), sample.m_dataIn->GetDataSize());
+    AP4_UI08* dataOut{sample.m_dataOut->UseData()};
+    if (sample.m_subsampleCount == 0)
+    {
+      std::memcpy(dataOut, decrypted.data() + cipherPos, sample.m_dataIn->GetDataSize());
+      cipherPos += sample.m_dataIn->GetDataSize();
+    }
+    else
+    {
+      size_t pos{0};
+      for (unsigned int j = 0; j < sample.m_subsampleCount; ++j)
+      {
+        pos += sample.m_clearBytes[j];
+        std::memcpy(dataOut + pos, decrypted.data() + cipherPos, sample.m_cipherBytes[j]);
+        pos += sample.m_cipherBytes[j];
+        cipherPos += sample.m_cipherBytes[j];
+      }
+    }
+    sample.m_result = AP4_SUCCESS;
+  }
+}
+
+bool CClearKeySingleSampleDecrypter::AcquirePendingLicense()
+{
+  CheckLicenseRenewal();
+  return HasKeys();
+}
+
+AP4_UI32 CClearKeySingleSampleDecrypter::AddPool()
+{
+  for (size_t i = 0; i < m_fragmentPool.size(); ++i)
+  {
+    if (!m_fragmentPool[i].m_isUsed)
+    {
+      m_fragmentPool[i] = {};
+      m_fragmentPool[i].m_isUsed = true;
+      return static_cast<AP4_UI32>(i);
+    }
+  }
+  m_fragmentPool.emplace_back().m_isUsed = true;
+  return static_cast<AP4_UI32>(m_fragmentPool.size() - 1);
+}
+
+void CClearKeySingleSampleDecrypter::RemovePool(AP4_UI32 poolid)
+{
+  if (poolid < m_fragmentPool.size())
+    m_fragmentPool[poolid] = {};
+}
+
+const char* CClearKeySingleSampleDecrypter::GetSessionId()
+{
+  return m_sessionId.empty() ? nullptr : m_sessionId.c_str();
+}
+
+bool CClearKeySingleSampleDecrypter::HasKeyId(const uint8_t* keyId)
+{
+  std::string key;
+  return keyId && GetKey(keyId, key);
+}
+
+bool CClearKeySingleSampleDecrypter::HasKeys()
+{
+  std::lock_guard<std::mutex> lock(m_keysMutex);
+  return !m_keys.empty();
+}
+
+void CClearKeySingleSampleDecrypter::CloseSessionId()
+{
+  if (!m_sessionId.empty())
+  {
+    LOG::LogF(LOGDEBUG, "Closing ClearKey session ID: %s", m_sessionId.c_str());
+    m_sessionId.clear();
+  }
+}
+
+std::string CClearKeySingleSampleDecrypter::GetChallengeData()
+{
+  std::lock_guard<std::mutex> lock(m_renewalMutex);
+  return m_challenge;
+}
+
+void CClearKeySingleSampleDecrypter::RequestRenewal()
+{
+  GenerateRequest();
+}
+
+void CClearKeySingleSampleDecrypter::GenerateRequest()
+{
+  std::string request;
+  if (m_drm.IsPrivacyMode() && m_drm.GetServerCertificate().empty())
+  {
+    request = SERVICE_CERTIFICATE_REQUEST;
+  }
+  else
+  {
+    // W3C ClearKey license request
+    std::string kids;
+    for (const std::string& keyId : m_keyIds)
+    {
+      if (!kids.empty())
+        kids += ",";
+      kids += "\"" + CLicenseServerStub::ToBase64Url(keyId) + "\"";
+    }
+    request = "{\"kids\":[" + kids + "],\"type\":\"temporary\"}";
+  }
+
+  std::lock_guard<std::mutex> lock(m_renewalMutex);
+  m_challenge = request;
+}
+
+void CClearKeySingleSampleDecrypter::CheckLicenseRenewal()
+{
+  std::lock_guard<std::mutex> requestLock(m_licenseRequestMutex);
+  {
+    std::lock_guard<std::mutex> lock(m_renewalMutex);
+    if (m_challenge.empty())
+      return;
+  }
+  SendSessionMessage();
+}
+
+bool CClearKeySingleSampleDecrypter::SendSessionMessage()
+{
+  const CLicenseRequestTemplate& licenseTemplate{m_drm.GetLicenseTemplate()};
+
+  if (!licenseTemplate.IsValid())
+  {
+    LOG::LogF(LOGERROR, "%s", licenseTemplate.GetError().c_str());
+    return false;
+  }
+
+  std::string challenge;
+  {
+    std::lock_guard<std::mutex> lock(m_renewalMutex);
+    challenge.swap(m_challenge);
+  }
+
+  CLicenseRequestTemplate::RequestData requestData;
+  requestData.m_challenge = challenge;
+  requestData.m_sessionId = m_sessionId;
+  requestData.m_defaultKeyId = m_defaultKeyId;
+  requestData.m_pssh = m_pssh;
+
+  CLicenseExchange exchange{m_drm.GetHost(), licenseTemplate};
+  bool isSent{false};
+
+  for (int attempt = 1; attempt <= CClearKeyDecrypter::MAX_LICENSE_ATTEMPTS; ++attempt)
+  {
+    isSent = exchange.Send(requestData);
+    if (isSent)
+      break;
+
+    LOG::Log(LOGWARNING, "%s (attempt %i of %i)", exchange.GetError().c_str(), attempt,
+             CClearKeyDecrypter::MAX_LICENSE_ATTEMPTS);
+  }
+
+  if (!isSent)
+  {
+    LOG::LogF(LOGERROR, "License request failed");
+    // Keep the request to retry it on the next license acquisition
+    std::lock_guard<std::mutex> lock(m_renewalMutex);
+    if (m_challenge.empty())
+      m_challenge = challenge;
+    return false;
+  }
+
+  const bool isServerCertRequest{challenge == SERVICE_CERTIFICATE_REQUEST};
+  std::string response;
+  if (!exchange.GetLicense(isServerCertRequest, response, m_hdcpLimit))
+  {
+    LOG::LogF(LOGERROR, "%s", exchange.GetError().c_str());
+    return false;
+  }
+
+  if (isServerCertRequest && exchange.IsBinaryResponse())
+  {
+    m_drm.SetServerCertificate(response);
+    m_drm.GetLicenseStore().SaveServiceCertificate(response, CLicenseStore::Now());
+    // As the CDM, once the certificate is set the license request follows
+    GenerateRequest();
+    return true;
+  }
+
+  if (exchange.GetResolutionLimit() > 0)
+    m_resolutionLimit = exchange.GetResolutionLimit();
+
+  if (!UpdateSession(response))
+  {
+    LOG::LogF(LOGERROR, "License update not successful (no keys)");
+    return false;
+  }
+
+  LOG::Log(LOGDEBUG, "License update successful");
+  return true;
+}
+
+bool CClearKeySingleSampleDecrypter::UpdateSession(std::string_view license)
+{
+  // JWK set {"keys":[{"kty":"oct","kid":"...","k":"..."}, ...]}
+  bool isUpdated{false};
+  size_t pos{license.find("\"keys\"")};
+  while (pos != std::string_view::npos && (pos = license.find('{', pos)) != std::string_view::npos)
+  {
+    const size_t endPos{license.find('}', pos)};
+    const std::string_view jwk{license.substr(pos, endPos - pos)};
+    const std::string keyId{CLicenseServerStub::FromBase64Url(GetJsonString(jwk, "kid"))};
+    const std::string key{CLicenseServerStub::FromBase64Url(GetJsonString(jwk, "k"))};
+    if (keyId.size() == 16 && key.size() == 16)
+    {
+      std::lock_guard<std::mutex> lock(m_keysMutex);
+      m_keys[keyId] = key;
+      isUpdated = true;
+    }
+    pos = endPos;
+  }
+  return isUpdated;
+}
+
+bool CClearKeySingleSampleDecrypter::GetKey(const AP4_UI08* keyId, std::string& key)
+{
+  std::lock_guard<std::mutex> lock(m_keysMutex);
+  auto keyIt{m_keys.find({reinterpret_cast<const char*>(keyId), 16})};
+  if (keyIt == m_keys.end())
+    return false;
+
+  key = keyIt->second;
+  return true;
+}
+
+const char* CClearKeyDecrypter::SelectKeySytem(const char* keySystem)
+{
+  if (std::strcmp(keySystem, "org.w3.clearkey"))
+    return nullptr;
+
+  return "urn:uuid:E2719D58-A985-B3C9-781A-B030AF78D30E";
+}
+
+bool CClearKeyDecrypter::OpenDRMSystem(const char* licenseURL,
+                                       const AP4_DataBuffer& serverCertificate,
+                                       const uint8_t config)
+{
+  // The default headers of a bare URL are added by the key system handler
+  if (!m_licenseTemplate.Compile(licenseURL))
+  {
+    LOG::Log(LOGERROR, "License URL: %s", m_licenseTemplate.GetError().c_str());
+    return false;
+  }
+
+  const std::string profilePath{m_host.GetProfilePath()};
+  if (!profilePath.empty())
+    m_licenseStore.SetBasePath(profilePath);
+
+  if (serverCertificate.GetDataSize() > 0)
+  {
+    SetServerCertificate({reinterpret_cast<const char*>(serverCertificate.GetData()),
+                          serverCertificate.GetDataSize()});
+  }
+  else
+  {
+    // Avoid the service certificate request to the license server
+    std::string storedCert;
+    if (m_licenseStore.LoadServiceCertificate(storedCert, CLicenseStore::Now()))
+      SetServerCertificate(storedCert);
+  }
+
+  m_isOpened = true;
+  return true;
+}
+
+Adaptive_CencSingleSampleDecrypter* CClearKeyDecrypter::CreateSingleSampleDecrypter(
+    AP4_DataBuffer& pssh,
+    const char* optionalKeyParameter,
+    std::string_view defaultkeyid,
+    bool skipSessionMessage,
+    CryptoMode cryptoMode)
+{
+  CClearKeySingleSampleDecrypter* decrypter{new CClearKeySingleSampleDecrypter(
+      *this, pssh, defaultkeyid, skipSessionMessage, cryptoMode)};
+  if (!decrypter->GetSessionId())
+  {
+    delete decrypter;
+    decrypter = nullptr;
+  }
+  return decrypter;
+}
+
+void CClearKeyDecrypter::DestroySingleSampleDecrypter(
+    Adaptive_CencSingleSampleDecrypter* decrypter)
+{
+  if (decrypter)
+  {
+    static_cast<CClearKeySingleSampleDecrypter*>(decrypter)->CloseSessionId();
+    delete static_cast<CClearKeySingleSampleDecrypter*>(decrypter);
+  }
+}
+
+void CClearKeyDecrypter::GetCapabilities(Adaptive_CencSingleSampleDecrypter* decrypter,
+                                         const uint8_t* keyid,
+                                         uint32_t media,
+                                         SSD_DECRYPTER::SSD_CAPS& caps)
+{
+  caps = {0, 0, 0};
+  if (!decrypter)
+    return;
+
+  auto ssd{static_cast<CClearKeySingleSampleDecrypter*>(decrypter)};
+  caps.flags = SSD_DECRYPTER::SSD_CAPS::SSD_SUPPORTS_DECODING;
+  // As the Widevine CDM, the license HDCP limit take precedence over the resolution limit
+  caps.hdcpLimit = ssd->GetHdcpLimit() ? ssd->GetHdcpLimit() : ssd->GetResolutionLimit();
+  // Software decryption only, available once the license have the key
+  if (keyid ? ssd->HasKeyId(keyid) : ssd->HasKeys())
+    caps.flags |= SSD_DECRYPTER::SSD_CAPS::SSD_SINGLE_DECRYPT;
+}
+
+bool CClearKeyDecrypter::HasLicenseKey(Adaptive_CencSingleSampleDecrypter* decrypter,
+                                       const uint8_t* keyid)
+{
+  if (decrypter)
+    return static_cast<CClearKeySingleSampleDecrypter*>(decrypter)->HasKeyId(keyid);
+  return false;
+}
+
+std::string CClearKeyDecrypter::GetChallengeB64Data(Adaptive_CencSingleSampleDecrypter* decrypter)
+{
+  if (!decrypter)
+    return "";
+
+  auto ssd{static_cast<CClearKeySingleSampleDecrypter*>(decrypter)};
+  return BASE64::Encode(ssd->GetChallengeData());
+}
+
+std::string CClearKeyDecrypter::GetServerCertificate()
+{
+  std::lock_guard<std::mutex> lock(m_certificateMutex);
+  return m_serverCertificate;
+}
+
+void CClearKeyDecrypter::SetServerCertificate(std::string_view certificate)
+{
+  std::lock_guard<std::mutex> lock(m_certificateMutex);
+  m_serverCertificate = certificate;
+}
+
+std::string CClearKeyDecrypter::CreateSessionId()
+{
+  return "clearkey-session-" + std::to_string(++m_sessionCount);
+}
@@ -0,0 +1,203 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include "../SSD_dll.h"
+#include "../common/AdaptiveDecrypter.h"
+#include "../../wvdecrypter/LicenseRequestTemplate.h"
+#include "../../wvdecrypter/LicenseStore.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class CClearKeyDecrypter;
+
+/*!
+ * \brief Test only ClearKey CDM session, it follows the license flow of the
+ *        Widevine decrypter (session message loop, service certificate request,
+ *        renewal on decrypt) with the W3C ClearKey license format, and decrypts
+ *        the CENC samples ('cenc' and 'cbcs' schemes) in software.
+ */
+class CClearKeySingleSampleDecrypter : public Adaptive_CencSingleSampleDecrypter
+{
+public:
+  CClearKeySingleSampleDecrypter(CClearKeyDecrypter& drm,
+                                 AP4_DataBuffer& pssh,
+                                 std::string_view defaultKeyId,
+                                 bool skipSessionMessage,
+                                 CryptoMode cryptoMode);
+
+  void AddKeyId(std::string_view keyId) override;
+  void SetDefaultKeyId(std::string_view keyId) override;
+
+  AP4_Result SetFragmentInfo(AP4_UI32 pool_id,
+                             const AP4_UI08* key,
+                             const AP4_UI08 nal_length_size,
+                             AP4_DataBuffer& annexb_sps_pps,
+                             AP4_UI32 flags,
+                             CryptoInfo cryptoInfo) override;
+
+  AP4_Result DecryptSampleData(AP4_UI32 poolid,
+                               AP4_DataBuffer& data_in,
+                               AP4_DataBuffer& data_out,
+                               const AP4_UI08* iv,
+                               unsigned int subsample_count,
+                               const AP4_UI16* bytes_of_cleartext_data,
+                               const AP4_UI32* bytes_of_encrypted_data,
+                               const SampleKeyInfo* sampleKeyInfo) override;
+
+  AP4_Result DecryptSampleBatch(AP4_UI32 poolId,
+                                SampleDecryptDesc* samples,
+                                size_t count) override;
+
+  bool AcquirePendingLicense() override;
+
+  AP4_UI32 AddPool() override;
+  void RemovePool(AP4_UI32 poolid) override;
+  const char* GetSessionId() override;
+
+  bool HasKeyId(const uint8_t* keyId);
+  bool HasKeys();
+  void CloseSessionId();
+  std::string GetChallengeData();
+
+  /*!
+   * \brief Emulate a license renewal message of the CDM, the renewal request
+   *        is sent to the license server by the next decrypt.
+   */
+  void RequestRenewal();
+
+  /*!
+   * \brief Get the number of decryption requests, a batch of samples decrypted
+   *        as a single AES-CTR stream is a single request.
+   */
+  size_t GetDecryptRequestCount() const { return m_decryptRequestCount; }
+
+  /*!
+   * \brief Get the HDCP limit of the license response, 0 if not set.
+   */
+  int GetHdcpLimit() const { return m_hdcpLimit; }
+
+  /*!
+   * \brief Get the resolution limit of the license server response headers, 0 if not set.
+   */
+  int GetResolutionLimit() const { return m_resolutionLimit; }
+
+private:
+  struct FINFO
+  {
+    const AP4_UI08* m_key{nullptr};
+    CryptoInfo m_cryptoInfo;
+    bool m_isUsed{false};
+  };
+
+  void GenerateRequest();
+  void DecryptCtrSampleRun(AP4_UI32 poolId, SampleDecryptDesc* samples, size_t count);
+  void CheckLicenseRenewal();
+  bool SendSessionMessage();
+  bool UpdateSession(std::string_view license);
+  bool GetKey(const AP4_UI08* keyId, std::string& key);
+
+  CClearKeyDecrypter& m_drm;
+  std::string m_pssh;
+  std::string m_defaultKeyId;
+  std::vector<std::string> m_keyIds; // The KIDs of the license request
+  CryptoMode m_cryptoMode;
+  std::string m_sessionId;
+  std::mutex m_renewalMutex; // Protect the challenge
+  std::mutex m_licenseRequestMutex;
+  std::string m_challenge;
+  std::mutex m_keysMutex;
+  std::map<std::string, std::string> m_keys; // KID, key
+  std::vector<FINFO> m_fragmentPool;
+  bool m_isBatchDecrypt{false};
+  std::atomic<size_t> m_decryptRequestCount{0};
+  int m_hdcpLimit{0};
+  int m_resolutionLimit{0};
+};
+
+/*!
+ * \brief Test only ClearKey decrypter, the license requests are sent through
+ *        the CURL interface of the SSD host, e.g. to an in-process license server.
+ */
+class CClearKeyDecrypter : public SSD::SSD_DECRYPTER
+{
+public:
+  // Max attempts to send a license request when the license server fails
+  static constexpr int MAX_LICENSE_ATTEMPTS = 3;
+
+  explicit CClearKeyDecrypter(SSD::SSD_HOST& host) : m_host{host} {}
+
+  const char* SelectKeySytem(const char* keySystem) override;
+  bool OpenDRMSystem(const char* licenseURL,
+                     const AP4_DataBuffer& serverCertificate,
+                     const uint8_t config) override;
+  Adaptive_CencSingleSampleDecrypter* CreateSingleSampleDecrypter(
+      AP4_DataBuffer& pssh,
+      const char* optionalKeyParameter,
+      std::string_view defaultkeyid,
+      bool skipSessionMessage,
+      CryptoMode cryptoMode) override;
+  void DestroySingleSampleDecrypter(Adaptive_CencSingleSampleDecrypter* decrypter) override;
+
+  void GetCapabilities(Adaptive_CencSingleSampleDecrypter* decrypter,
+                       const uint8_t* keyid,
+                       uint32_t media,
+                       SSD_DECRYPTER::SSD_CAPS& caps) override;
+  bool HasLicenseKey(Adaptive_CencSingleSampleDecrypter* decrypter, const uint8_t* keyid) override;
+  bool HasCdmSession() override { return m_isOpened; }
+  std::string GetChallengeB64Data(Adaptive_CencSingleSampleDecrypter* decrypter) override;
+
+  bool OpenVideoDecoder(Adaptive_CencSingleSampleDecrypter* decrypter,
+                        const SSD::SSD_VIDEOINITDATA* initData) override
+  {
+    return false;
+  }
+  SSD::SSD_DECODE_RETVAL DecryptAndDecodeVideo(void* hostInstance,
+                                               SSD::SSD_SAMPLE* sample) override
+  {
+    return SSD::VC_ERROR;
+  }
+  SSD::SSD_DECODE_RETVAL VideoFrameDataToPicture(void* hostInstance,
+                                                 SSD::SSD_PICTURE* picture) override
+  {
+    return SSD::VC_ERROR;
+  }
+  void ResetVideo() override {}
+
+  /*!
+   * \brief Set the privacy mode, like the Widevine CDM when enabled a service
+   *        certificate is requested to the license server if not already set.
+   */
+  void SetPrivacyMode(bool isPrivacyMode) { m_isPrivacyMode = isPrivacyMode; }
+  bool IsPrivacyMode() const { return m_isPrivacyMode; }
+
+  SSD::SSD_HOST& GetHost() { return m_host; }
+  const CLicenseRequestTemplate& GetLicenseTemplate() const { return m_licenseTemplate; }
+  const CLicenseStore& GetLicenseStore() const { return m_licenseStore; }
+
+  std::string GetServerCertificate();
+  void SetServerCertificate(std::string_view certificate);
+
+  std::string CreateSessionId();
+
+private:
+  SSD::SSD_HOST& m_host;
+  bool m_isOpened{false};
+  bool m_isPrivacyMode{false};
+  CLicenseRequestTemplate m_licenseTemplate;
+  CLicenseStore m_licenseStore;
+  std::mutex m_certificateMutex;
+  std::string m_serverCertificate;
+  std::atomic<int> m_sessionCount{0};
+};
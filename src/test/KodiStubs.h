@@ -10,6 +10,9 @@
 
  // Kodi interface stubs
 
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -60,6 +63,40 @@ typedef enum OpenFileFlags
   ADDON_READ_REOPEN = 0x100
 } OpenFileFlags;
 
+#define STREAM_TIME_BASE 1000000
+#define STREAM_NOPTS_VALUE 0xFFF0000000000000
+
+enum INPUTSTREAM_TYPE
+{
+  INPUTSTREAM_TYPE_NONE = 0,
+  INPUTSTREAM_TYPE_VIDEO,
+  INPUTSTREAM_TYPE_AUDIO,
+  INPUTSTREAM_TYPE_SUBTITLE,
+  INPUTSTREAM_TYPE_TELETEXT,
+  INPUTSTREAM_TYPE_RDS,
+  INPUTSTREAM_TYPE_ID3,
+};
+
+enum STREAMCODEC_PROFILE
+{
+  CodecProfileUnknown = 0,
+  CodecProfileNotNeeded,
+  H264CodecProfileBaseline,
+  H264CodecProfileMain,
+  H264CodecProfileExtended,
+  H264CodecProfileHigh,
+  H264CodecProfileHigh10,
+  H264CodecProfileHigh422,
+  H264CodecProfileHigh444Predictive,
+  VP9CodecProfile0 = 20,
+  VP9CodecProfile1,
+  VP9CodecProfile2,
+  VP9CodecProfile3,
+  AV1CodecProfileMain,
+  AV1CodecProfileHigh,
+  AV1CodecProfileProfessional,
+};
+
 enum AdjustRefreshRateStatus
 {
   ADJUST_REFRESHRATE_STATUS_OFF = 0,
@@ -98,6 +135,72 @@ inline std::string GetUserPath(const std::string& append = "")
   return "C:\\isa_stub_test\\" + append;
 }
 
+class InputstreamInfo
+{
+public:
+  INPUTSTREAM_TYPE GetStreamType() const { return m_streamType; }
+  void SetStreamType(INPUTSTREAM_TYPE streamType) { m_streamType = streamType; }
+
+  std::string GetCodecName() const { return m_codecName; }
+  void SetCodecName(const std::string& codecName) { m_codecName = codecName; }
+
+  STREAMCODEC_PROFILE GetCodecProfile() const { return m_codecProfile; }
+  void SetCodecProfile(STREAMCODEC_PROFILE codecProfile) { m_codecProfile = codecProfile; }
+
+  std::string GetLanguage() const { return m_language; }
+  void SetLanguage(const std::string& language) { m_language = language; }
+
+  const std::vector<uint8_t>& GetExtraData() const { return m_extraData; }
+  void SetExtraData(const uint8_t* extraData, size_t extraDataSize)
+  {
+    m_extraData.assign(extraData, extraData + extraDataSize);
+  }
+  bool CompareExtraData(const uint8_t* extraData, size_t extraDataSize) const
+  {
+    return m_extraData.size() == extraDataSize &&
+           (extraDataSize == 0 || std::memcmp(m_extraData.data(), extraData, extraDataSize) == 0);
+  }
+
+  uint32_t GetWidth() const { return m_width; }
+  void SetWidth(uint32_t width) { m_width = width; }
+  uint32_t GetHeight() const { return m_height; }
+  void SetHeight(uint32_t height) { m_height = height; }
+  uint32_t GetFpsRate() const { return m_fpsRate; }
+  void SetFpsRate(uint32_t fpsRate) { m_fpsRate = fpsRate; }
+  uint32_t GetFpsScale() const { return m_fpsScale; }
+  void SetFpsScale(uint32_t fpsScale) { m_fpsScale = fpsScale; }
+  float GetAspect() const { return m_aspect; }
+  void SetAspect(float aspect) { m_aspect = aspect; }
+
+  uint32_t GetChannels() const { return m_channels; }
+  void SetChannels(uint32_t channels) { m_channels = channels; }
+  uint32_t GetSampleRate() const { return m_sampleRate; }
+  void SetSampleRate(uint32_t sampleRate) { m_sampleRate = sampleRate; }
+  uint32_t GetBitRate() const { return m_bitRate; }
+  void SetBitRate(uint32_t bitRate) { m_bitRate = bitRate; }
+  uint32_t GetBitsPerSample() const { return m_bitsPerSample; }
+  void SetBitsPerSample(uint32_t bitsPerSample) { m_bitsPerSample = bitsPerSample; }
+  uint32_t GetBlockAlign() const { return m_blockAlign; }
+  void SetBlockAlign(uint32_t blockAlign) { m_blockAlign = blockAlign; }
+
+private:
+  INPUTSTREAM_TYPE m_streamType{INPUTSTREAM_TYPE_NONE};
+  std::string m_codecName;
+  STREAMCODEC_PROFILE m_codecProfile{CodecProfileUnknown};
+  std::string m_language;
+  std::vector<uint8_t> m_extraData;
+  uint32_t m_width{0};
+  uint32_t m_height{0};
+  uint32_t m_fpsRate{0};
+  uint32_t m_fpsScale{0};
+  float m_aspect{0.0f};
+  uint32_t m_channels{0};
+  uint32_t m_sampleRate{0};
+  uint32_t m_bitRate{0};
+  uint32_t m_bitsPerSample{0};
+  uint32_t m_blockAlign{0};
+};
+
 } // namespace addon
 
 namespace vfs
@@ -111,18 +214,44 @@ public:
 
   bool OpenFileForWrite(const std::string& filename, bool overwrite = false) { return false; }
 
-  bool IsOpen() const { return false; }
-  void Close() {}
+  bool IsOpen() const { return m_localFile != nullptr; }
+  void Close()
+  {
+    if (m_localFile)
+    {
+      std::fclose(m_localFile);
+      m_localFile = nullptr;
+    }
+  }
 
-  bool CURLCreate(const std::string& url) { return false; }
+  // Only the local files can be opened, e.g. the sample files of the tests
+  bool CURLCreate(const std::string& url)
+  {
+    if (url.find("://") != std::string::npos && url.compare(0, 7, "file://") != 0)
+      return false;
+    m_localPath = url.compare(0, 7, "file://") == 0 ? url.substr(7) : url;
+    return true;
+  }
   bool CURLAddOption(CURLOptiontype type, const std::string& name, const std::string& value)
   {
     return false;
   }
 
-  bool CURLOpen(unsigned int flags = 0) { return false; }
+  bool CURLOpen(unsigned int flags = 0)
+  {
+    Close();
+    if (!m_localPath.empty())
+      m_localFile = std::fopen(m_localPath.c_str(), "rb");
+    return m_localFile != nullptr;
+  }
 
-  ssize_t Read(void* ptr, size_t size) { return 0; }
+  ssize_t Read(void* ptr, size_t size)
+  {
+    if (!m_localFile)
+      return 0;
+    const size_t readSize = std::fread(ptr, 1, size, m_localFile);
+    return std::ferror(m_localFile) ? -1 : static_cast<ssize_t>(readSize);
+  }
 
   bool ReadLine(std::string& line) { return false; }
 
@@ -138,7 +267,7 @@ public:
 
   int64_t GetLength() const { return 0; }
 
-  bool AtEnd() const { return true; }
+  bool AtEnd() const { return !m_localFile || std::feof(m_localFile); }
 
   int GetChunkSize() const { return 0; }
 
@@ -152,6 +281,8 @@ public:
 
   const std::string GetPropertyValue(FilePropertyTypes type, const std::string& name) const
   {
+    if (m_localFile && type == ADDON_FILE_PROPERTY_RESPONSE_PROTOCOL)
+      return "HTTP/1.1 200 OK";
     return "";
   }
 
@@ -162,6 +293,10 @@ public:
   }
 
   double GetFileDownloadSpeed() const { return 0.0; }
+
+private:
+  std::string m_localPath;
+  std::FILE* m_localFile{nullptr};
 };
 
 inline bool FileExists(const std::string& filename, bool usecache = false)
@@ -0,0 +1,220 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "LicenseServerStub.h"
+
+#include "../utils/Base64Utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace UTILS;
+
+namespace
+{
+constexpr std::string_view KEY_PATH{"/key/"};
+
+std::string FromHex(std::string_view hex)
+{
+  std::string data;
+  for (size_t i = 0; i + 1 < hex.size(); i += 2)
+    data += static_cast<char>(std::stoi(std::string(hex.substr(i, 2)), nullptr, 16));
+  return data;
+}
+
+// Get the string value of a JSON field, the JSON data is trusted (from our own CDM)
+std::string_view GetJsonString(std::string_view json, std::string_view field)
+{
+  const std::string key{"\"" + std::string(field) + "\":\""};
+  const size_t pos{json.find(key)};
+  if (pos == std::string_view::npos)
+    return {};
+
+  const size_t valuePos{pos + key.size()};
+  const size_t endPos{json.find('"', valuePos)};
+  if (endPos == std::string_view::npos)
+    return {};
+
+  return json.substr(valuePos, endPos - valuePos);
+}
+
+// Get the string values of a JSON array field
+std::vector<std::string_view> GetJsonStringArray(std::string_view json, std::string_view field)
+{
+  std::vector<std::string_view> values;
+  const size_t pos{json.find("\"" + std::string(field) + "\":[")};
+  if (pos == std::string_view::npos)
+    return values;
+
+  const size_t endPos{json.find(']', pos)};
+  size_t valuePos{json.find('"', pos + field.size() + 3)};
+  while (valuePos < endPos)
+  {
+    const size_t valueEndPos{json.find('"', valuePos + 1)};
+    values.emplace_back(json.substr(valuePos + 1, valueEndPos - valuePos - 1));
+    valuePos = json.find('"', valueEndPos + 1);
+  }
+  return values;
+}
+} // unnamed namespace
+
+void CLicenseServerStub::AddKey(std::string_view keyId, std::string_view key)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_keys[std::string(keyId)] = key;
+}
+
+void CLicenseServerStub::SetResponseHeader(std::string_view name, std::string_view value)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_responseHeaders[std::string(name)] = value;
+}
+
+bool CLicenseServerStub::HandleRequest(const Request& request,
+                                       std::string& response,
+                                       std::map<std::string, std::string>& responseHeaders)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_requests.emplace_back(request);
+
+  if (m_failCount > 0)
+  {
+    m_failCount--;
+    return false;
+  }
+
+  // HLS AES key request, the url end with the hexadecimal KID
+  const size_t keyPathPos{request.m_url.rfind(KEY_PATH)};
+  if (request.m_body.empty() && keyPathPos != std::string::npos)
+  {
+    auto keyIt{m_keys.find(FromHex(request.m_url.substr(keyPathPos + KEY_PATH.size())))};
+    if (keyIt == m_keys.end())
+      return false;
+
+    response = keyIt->second;
+    responseHeaders["Content-Type"] = "application/octet-stream";
+    return true;
+  }
+
+  std::string challenge{request.m_body};
+  if (!m_challengeField.empty())
+    challenge = BASE64::Decode(GetJsonString(request.m_body, m_challengeField));
+
+  // Service certificate request
+  if (challenge.size() == 2)
+  {
+    if (m_certificate.empty())
+      return false;
+
+    response = m_certificate;
+    responseHeaders["Content-Type"] = "application/octet-stream";
+    return true;
+  }
+
+  std::string keys;
+  for (std::string_view keyIdB64 : GetJsonStringArray(challenge, "kids"))
+  {
+    auto keyIt{m_keys.find(FromBase64Url(keyIdB64))};
+    if (keyIt == m_keys.end())
+      continue;
+
+    if (!keys.empty())
+      keys += ",";
+    keys += "{\"kty\":\"oct\",\"kid\":\"" + std::string(keyIdB64) + "\",\"k\":\"" +
+            ToBase64Url(keyIt->second) + "\"}";
+  }
+  response = "{\"keys\":[" + keys + "],\"type\":\"temporary\"}";
+  responseHeaders = m_responseHeaders;
+  responseHeaders["Content-Type"] = "application/json";
+
+  if (!m_licenseField.empty())
+    response = "{\"" + m_licenseField + "\":\"" + BASE64::Encode(response) + "\"}";
+
+  return true;
+}
+
+std::vector<CLicenseServerStub::Request> CLicenseServerStub::GetRequests() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_requests;
+}
+
+size_t CLicenseServerStub::GetRequestCount() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_requests.size();
+}
+
+std::string CLicenseServerStub::ToBase64Url(std::string_view data)
+{
+  std::string b64{BASE64::Encode(data.data(), data.size())};
+  std::replace(b64.begin(), b64.end(), '+', '-');
+  std::replace(b64.begin(), b64.end(), '/', '_');
+  b64.erase(std::find(b64.begin(), b64.end(), '='), b64.end());
+  return b64;
+}
+
+std::string CLicenseServerStub::FromBase64Url(std::string_view data)
+{
+  std::string b64{data};
+  std::replace(b64.begin(), b64.end(), '-', '+');
+  std::replace(b64.begin(), b64.end(), '_', '/');
+  b64.append((4 - b64.size() % 4) % 4, '=');
+  return BASE64::Decode(b64);
+}
+
+void* CTestSsdHost::CURLCreate(const char* strURL)
+{
+  File* file{new File};
+  file->m_request.m_url = strURL;
+  return file;
+}
+
+bool CTestSsdHost::CURLAddOption(void* file,
+                                 CURLOPTIONS opt,
+                                 const char* name,
+                                 const char* value)
+{
+  File* curlFile{static_cast<File*>(file)};
+  // As Kodi CURL, the post data is base64 encoded
+  if (std::strcmp(name, "postdata") == 0)
+    curlFile->m_request.m_body = BASE64::Decode(value);
+  else
+    curlFile->m_request.m_headers[name] = value;
+  return true;
+}
+
+const char* CTestSsdHost::CURLGetProperty(void* file, CURLPROPERTY prop, const char* name)
+{
+  File* curlFile{static_cast<File*>(file)};
+  auto headerIt{curlFile->m_responseHeaders.find(name)};
+  if (headerIt == curlFile->m_responseHeaders.end())
+    return "";
+  return headerIt->second.c_str();
+}
+
+bool CTestSsdHost::CURLOpen(void* file)
+{
+  File* curlFile{static_cast<File*>(file)};
+  return m_server.HandleRequest(curlFile->m_request, curlFile->m_response,
+                                curlFile->m_responseHeaders);
+}
+
+size_t CTestSsdHost::ReadFile(void* file, void* lpBuf, size_t uiBufSize)
+{
+  File* curlFile{static_cast<File*>(file)};
+  const size_t size{std::min(uiBufSize, curlFile->m_response.size() - curlFile->m_readPos)};
+  std::memcpy(lpBuf, curlFile->m_response.data() + curlFile->m_readPos, size);
+  curlFile->m_readPos += size;
+  return size;
+}
+
+void CTestSsdHost::CloseFile(void* file)
+{
+  delete static_cast<File*>(file);
+}
@@ -0,0 +1,142 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include "../SSD_dll.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*!
+ * \brief In-process ClearKey license server, it answers to the W3C ClearKey
+ *        license requests {"kids":[...]} with the JWK set of the known keys.
+ *        A 2 bytes request is a service certificate request (as sent by the
+ *        Widevine CDM) and it is answered with the server certificate.
+ *        A request without body to an url ending with "/key/<hex KID>" is an
+ *        HLS AES key request, it is answered with the raw key.
+ */
+class CLicenseServerStub
+{
+public:
+  struct Request
+  {
+    std::string m_url;
+    std::map<std::string, std::string> m_headers;
+    std::string m_body;
+  };
+
+  /*!
+   * \brief Add a key served by the licenses.
+   * \param keyId The KID (16 bytes)
+   * \param key The key (16 bytes)
+   */
+  void AddKey(std::string_view keyId, std::string_view key);
+
+  /*!
+   * \brief Set the number of next requests that fail with an HTTP error.
+   */
+  void SetFailCount(int failCount) { m_failCount = failCount; }
+
+  /*!
+   * \brief Set the certificate returned to the service certificate requests,
+   *        when empty these requests fail.
+   */
+  void SetServerCertificate(std::string_view certificate) { m_certificate = certificate; }
+
+  /*!
+   * \brief Set the body field that contains the base64 encoded challenge,
+   *        when empty the challenge is the raw body.
+   */
+  void SetChallengeField(std::string_view field) { m_challengeField = field; }
+
+  /*!
+   * \brief Set the JSON field where wrap the base64 encoded license,
+   *        when empty the license is returned as is.
+   */
+  void SetLicenseField(std::string_view field) { m_licenseField = field; }
+
+  /*!
+   * \brief Set an HTTP header added to the license responses, e.g. "X-Limit-Video".
+   */
+  void SetResponseHeader(std::string_view name, std::string_view value);
+
+  /*!
+   * \brief Handle a license request.
+   * \param request The request
+   * \param response [OUT] The response data
+   * \param responseHeaders [OUT] The HTTP headers of the response
+   * \return True if success, false on HTTP error
+   */
+  bool HandleRequest(const Request& request,
+                     std::string& response,
+                     std::map<std::string, std::string>& responseHeaders);
+
+  std::vector<Request> GetRequests() const;
+  size_t GetRequestCount() const;
+
+  static std::string ToBase64Url(std::string_view data);
+  static std::string FromBase64Url(std::string_view data);
+
+private:
+  mutable std::mutex m_mutex;
+  std::map<std::string, std::string> m_keys;
+  std::vector<Request> m_requests;
+  int m_failCount{0};
+  std::string m_certificate;
+  std::string m_challengeField;
+  std::string m_licenseField;
+  std::map<std::string, std::string> m_responseHeaders;
+};
+
+/*!
+ * \brief Test host of the SSD decrypters, the CURL file requests are
+ *        handled by the license server stub.
+ */
+class CTestSsdHost : public SSD::SSD_HOST
+{
+public:
+  explicit CTestSsdHost(CLicenseServerStub& server) : m_server{server} {}
+
+#if defined(ANDROID)
+  void* GetJNIEnv() override { return nullptr; }
+  int GetSDKVersion() override { return 0; }
+  const char* GetClassName() override { return ""; }
+#endif
+  const char* GetLibraryPath() const override { return ""; }
+  const char* GetProfilePath() const override { return m_profilePath.c_str(); }
+  void* CURLCreate(const char* strURL) override;
+  bool CURLAddOption(void* file, CURLOPTIONS opt, const char* name, const char* value) override;
+  const char* CURLGetProperty(void* file, CURLPROPERTY prop, const char* name) override;
+  bool CURLOpen(void* file) override;
+  size_t ReadFile(void* file, void* lpBuf, size_t uiBufSize) override;
+  void CloseFile(void* file) override;
+  bool CreateDir(const char* dir) override { return true; }
+  bool GetBuffer(void* instance, SSD::SSD_PICTURE& picture) override { return false; }
+  void ReleaseBuffer(void* instance, void* buffer) override {}
+  void LogVA(const SSD::SSDLogLevel level, const char* format, va_list args) override {}
+  void SetDebugSaveLicense(bool isDebugSaveLicense) override {}
+  bool IsDebugSaveLicense() override { return false; }
+
+  void SetProfilePath(std::string_view profilePath) { m_profilePath = profilePath; }
+
+private:
+  struct File
+  {
+    CLicenseServerStub::Request m_request;
+    std::string m_response;
+    std::map<std::string, std::string> m_responseHeaders;
+    size_t m_readPos{0};
+  };
+
+  CLicenseServerStub& m_server;
+  std::string m_profilePath;
+};
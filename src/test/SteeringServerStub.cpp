@@ -0,0 +1,76 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "SteeringServerStub.h"
+
+void CSteeringServerStub::SetManifest(std::string_view manifest)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_manifest = manifest;
+}
+
+void CSteeringServerStub::SetFailCount(int failCount)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_failCount = failCount;
+}
+
+bool CSteeringServerStub::IsServerUrl(std::string_view url) const
+{
+  return url.substr(0, m_serverUrl.size()) == m_serverUrl;
+}
+
+bool CSteeringServerStub::HandleRequest(std::string_view url, std::string& response)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_requests.emplace_back(url);
+
+  if (m_failCount > 0)
+  {
+    m_failCount--;
+    return false;
+  }
+
+  response = m_manifest;
+  return true;
+}
+
+std::vector<std::string> CSteeringServerStub::GetRequests() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_requests;
+}
+
+size_t CSteeringServerStub::GetRequestCount() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_requests.size();
+}
+
+std::string CSteeringServerStub::GetParameter(std::string_view url, std::string_view name)
+{
+  const size_t queryPos{url.find('?')};
+  if (queryPos == std::string_view::npos)
+    return {};
+
+  std::string_view query{url.substr(queryPos + 1)};
+  while (!query.empty())
+  {
+    const size_t endPos{query.find('&')};
+    const std::string_view param{query.substr(0, endPos)};
+    const size_t eqPos{param.find('=')};
+
+    if (param.substr(0, eqPos) == name)
+      return eqPos == std::string_view::npos ? "" : std::string(param.substr(eqPos + 1));
+
+    if (endPos == std::string_view::npos)
+      break;
+    query.remove_prefix(endPos + 1);
+  }
+  return {};
+}
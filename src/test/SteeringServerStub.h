@@ -0,0 +1,62 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*!
+ * \brief In-process content steering server, it answers to the requests of
+ *        the urls starting with the server url with the steering manifest set.
+ */
+class CSteeringServerStub
+{
+public:
+  explicit CSteeringServerStub(std::string_view serverUrl) : m_serverUrl{serverUrl} {}
+
+  /*!
+   * \brief Set the steering manifest (JSON) returned to the next requests.
+   */
+  void SetManifest(std::string_view manifest);
+
+  /*!
+   * \brief Set the number of next requests that fail with an HTTP error.
+   */
+  void SetFailCount(int failCount);
+
+  /*!
+   * \brief Check if the url is handled by this server.
+   */
+  bool IsServerUrl(std::string_view url) const;
+
+  /*!
+   * \brief Handle a steering manifest request.
+   * \param url The request url
+   * \param response [OUT] The steering manifest
+   * \return True if success, false on HTTP error
+   */
+  bool HandleRequest(std::string_view url, std::string& response);
+
+  std::vector<std::string> GetRequests() const;
+  size_t GetRequestCount() const;
+
+  /*!
+   * \brief Get a query parameter value of an url (e.g. "_HLS_pathway").
+   */
+  static std::string GetParameter(std::string_view url, std::string_view name);
+
+private:
+  mutable std::mutex m_mutex;
+  std::string m_serverUrl;
+  std::string m_manifest;
+  std::vector<std::string> m_requests;
+  int m_failCount{0};
+};
@@ -0,0 +1,136 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../common/AdaptiveDecrypter.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+// Decrypt by XOR of the data with the first IV byte, an empty sample fails
+class XorSingleSampleDecrypter : public Adaptive_CencSingleSampleDecrypter
+{
+public:
+  AP4_Result SetFragmentInfo(AP4_UI32 pool_id,
+                             const AP4_UI08* key,
+                             const AP4_UI08 nal_length_size,
+                             AP4_DataBuffer& annexb_sps_pps,
+                             AP4_UI32 flags,
+                             CryptoInfo cryptoInfo) override
+  {
+    return AP4_SUCCESS;
+  }
+
+  AP4_Result DecryptSampleData(AP4_UI32 poolid,
+                               AP4_DataBuffer& data_in,
+                               AP4_DataBuffer& data_out,
+                               const AP4_UI08* iv,
+                               unsigned int subsample_count,
+                               const AP4_UI16* bytes_of_cleartext_data,
+                               const AP4_UI32* bytes_of_encrypted_data,
+                               const SampleKeyInfo* sampleKeyInfo) override
+  {
+    m_callCount++;
+    if (data_in.GetDataSize() == 0)
+      return AP4_ERROR_INVALID_PARAMETERS;
+
+    std::vector<AP4_UI08> data(data_in.GetData(), data_in.GetData() + data_in.GetDataSize());
+    for (AP4_UI08& byte : data)
+      byte ^= iv[0];
+    data_out.SetData(data.data(), static_cast<AP4_Size>(data.size()));
+    return AP4_SUCCESS;
+  }
+
+  int m_callCount{0};
+};
+} // unnamed namespace
+
+TEST(AdaptiveDecrypterTest, DecryptSampleBatchFallback)
+{
+  const AP4_UI08 iv1[16]{0x01};
+  const AP4_UI08 iv2[16]{0x02};
+  const AP4_UI08 data[3]{0x10, 0x20, 0x30};
+
+  std::vector<AP4_DataBuffer> dataIn(3);
+  std::vector<AP4_DataBuffer> dataOut(3);
+  dataIn[0].SetData(data, 3);
+  dataIn[2].SetData(data, 2);
+
+  std::vector<SampleDecryptDesc> samples(3);
+  for (size_t i = 0; i < samples.size(); ++i)
+  {
+    samples[i].m_dataIn = &dataIn[i];
+    samples[i].m_dataOut = &dataOut[i];
+    samples[i].m_iv = i == 2 ? iv2 : iv1;
+  }
+
+  XorSingleSampleDecrypter decrypter;
+  // The failure of a sample dont stop the decryption of the next ones
+  EXPECT_EQ(decrypter.DecryptSampleBatch(0, samples.data(), samples.size()),
+            AP4_ERROR_INVALID_PARAMETERS);
+  EXPECT_EQ(decrypter.m_callCount, 3);
+
+  EXPECT_EQ(samples[0].m_result, AP4_SUCCESS);
+  ASSERT_EQ(dataOut[0].GetDataSize(), 3U);
+  EXPECT_EQ(dataOut[0].GetData()[0], 0x11);
+  EXPECT_EQ(dataOut[0].GetData()[2], 0x31);
+
+  EXPECT_EQ(samples[1].m_result, AP4_ERROR_INVALID_PARAMETERS);
+
+  EXPECT_EQ(samples[2].m_result, AP4_SUCCESS);
+  ASSERT_EQ(dataOut[2].GetDataSize(), 2U);
+  EXPECT_EQ(dataOut[2].GetData()[1], 0x22);
+}
+
+TEST(AdaptiveDecrypterTest, CtrSampleRun)
+{
+  // 16 bytes IVs, each continue the block counter of the previous sample
+  const AP4_UI08 iv1[16]{0xca, 0xfe, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x10};
+  const AP4_UI08 iv2[16]{0xca, 0xfe, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x12};
+  const AP4_UI08 iv3[16]{0xca, 0xfe, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x14};
+  const AP4_UI08 iv4[16]{0xca, 0xfe, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x16};
+  const AP4_UI08 keyId[16]{0x01};
+  const SampleKeyInfo keyInfo{keyId, 0, 0};
+  const std::vector<AP4_UI08> data(48);
+  const AP4_UI16 clearBytes[2]{5, 0};
+  const AP4_UI32 cipherBytes[2]{16, 16};
+
+  std::vector<AP4_DataBuffer> dataIn(4);
+  dataIn[0].SetData(data.data(), 32);
+  dataIn[1].SetData(data.data(), 37); // Two subsamples of 16 bytes
+  dataIn[2].SetData(data.data(), 20); // Not block aligned
+  dataIn[3].SetData(data.data(), 16);
+
+  std::vector<SampleDecryptDesc> samples(4);
+  for (size_t i = 0; i < samples.size(); ++i)
+    samples[i].m_dataIn = &dataIn[i];
+  samples[0].m_iv = iv1;
+  samples[1].m_iv = iv2;
+  samples[1].m_subsampleCount = 2;
+  samples[1].m_clearBytes = clearBytes;
+  samples[1].m_cipherBytes = cipherBytes;
+  samples[2].m_iv = iv3;
+  samples[3].m_iv = iv4;
+
+  EXPECT_EQ(GetCtrSampleRun(samples.data(), 0), 0);
+  // The run stops after the sample that is not block aligned
+  EXPECT_EQ(GetCtrSampleRun(samples.data(), samples.size()), 3);
+  EXPECT_EQ(GetCtrSampleRun(samples.data() + 3, 1), 1);
+
+  // A different key override ends the run
+  samples[1].m_keyInfo = &keyInfo;
+  EXPECT_EQ(GetCtrSampleRun(samples.data(), samples.size()), 1);
+  EXPECT_EQ(GetCtrSampleRun(samples.data() + 1, samples.size() - 1), 1);
+  samples[1].m_keyInfo = nullptr;
+
+  // The IV does not continue the counter
+  samples[2].m_iv = iv4;
+  EXPECT_EQ(GetCtrSampleRun(samples.data(), samples.size()), 2);
+}
@@ -0,0 +1,176 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../common/CencSampleGroups.h"
+
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+// 'seig' entry: reserved, crypt/skip byte block, isProtected, Per_Sample_IV_Size, KID
+std::vector<AP4_UI08> MakeEntry(AP4_UI08 pattern,
+                                AP4_UI08 isProtected,
+                                AP4_UI08 ivSize,
+                                AP4_UI08 kid)
+{
+  std::vector<AP4_UI08> entry{0, pattern, isProtected, ivSize};
+  entry.insert(entry.end(), 16, kid);
+  return entry;
+}
+} // unnamed namespace
+
+class CencSampleGroupsTest : public ::testing::Test
+{
+protected:
+  bool AddEntry(const std::vector<AP4_UI08>& entry, bool isFragmentEntry)
+  {
+    return m_groups.AddEntry(entry.data(), static_cast<AP4_Size>(entry.size()), isFragmentEntry);
+  }
+
+  CCencSampleGroups m_groups;
+};
+
+TEST_F(CencSampleGroupsTest, Entries)
+{
+  EXPECT_FALSE(AddEntry({0, 0, 1, 8}, true));
+  // Only IV sizes 0, 8 and 16 are allowed
+  EXPECT_FALSE(AddEntry(MakeEntry(0, 1, 4, 0x01), true));
+  // Constant IV declared but missing
+  EXPECT_FALSE(AddEntry(MakeEntry(0x19, 1, 0, 0x02), true));
+
+  ASSERT_TRUE(AddEntry(MakeEntry(0, 1, 8, 0x01), false));
+  ASSERT_TRUE(AddEntry(MakeEntry(0, 0, 0, 0x00), true));
+  std::vector<AP4_UI08> cbcsEntry{MakeEntry(0x19, 1, 0, 0x02)};
+  cbcsEntry.push_back(16);
+  cbcsEntry.insert(cbcsEntry.end(), 16, 0xAA);
+  ASSERT_TRUE(AddEntry(cbcsEntry, true));
+
+  m_groups.AddSampleRun(2, 1);
+  m_groups.AddSampleRun(1, 0);
+  m_groups.AddSampleRun(1, 0x10001);
+  m_groups.AddSampleRun(1, 0x10002);
+  m_groups.AddSampleRun(1, 0x10003); // Not existing entry
+  EXPECT_FALSE(m_groups.IsEmpty());
+
+  const CCencSampleGroups::Entry* entry{m_groups.GetEntry(1)};
+  ASSERT_NE(entry, nullptr);
+  EXPECT_TRUE(entry->m_isProtected);
+  EXPECT_EQ(entry->m_ivSize, 8);
+  EXPECT_EQ(entry->m_keyId[15], 0x01);
+
+  EXPECT_EQ(m_groups.GetEntry(2), nullptr);
+
+  entry = m_groups.GetEntry(3);
+  ASSERT_NE(entry, nullptr);
+  EXPECT_FALSE(entry->m_isProtected);
+
+  entry = m_groups.GetEntry(4);
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->m_cryptBlocks, 1);
+  EXPECT_EQ(entry->m_skipBlocks, 9);
+  EXPECT_EQ(entry->m_keyId[0], 0x02);
+  EXPECT_EQ(entry->m_constantIv[15], 0xAA);
+
+  EXPECT_EQ(m_groups.GetEntry(5), nullptr);
+  EXPECT_EQ(m_groups.GetEntry(6), nullptr);
+
+  m_groups.Clear();
+  EXPECT_TRUE(m_groups.IsEmpty());
+}
+
+TEST_F(CencSampleGroupsTest, KeyIds)
+{
+  ASSERT_TRUE(AddEntry(MakeEntry(0, 1, 8, 0x01), false));
+  ASSERT_TRUE(AddEntry(MakeEntry(0, 1, 8, 0x02), true));
+  ASSERT_TRUE(AddEntry(MakeEntry(0, 0, 0, 0x03), true));
+
+  m_groups.AddSampleRun(2, 0x10001);
+  m_groups.AddSampleRun(1, 1);
+  m_groups.AddSampleRun(1, 0x10002);
+  m_groups.AddSampleRun(1, 0x10001);
+
+  bool hasDefaultKeySamples{true};
+  std::vector<const AP4_UI08*> keyIds{m_groups.GetKeyIds(5, hasDefaultKeySamples)};
+  ASSERT_EQ(keyIds.size(), 2);
+  EXPECT_EQ(keyIds[0][0], 0x02);
+  EXPECT_EQ(keyIds[1][0], 0x01);
+  EXPECT_FALSE(hasDefaultKeySamples);
+
+  // Samples after the sample runs use the default KID
+  keyIds = m_groups.GetKeyIds(6, hasDefaultKeySamples);
+  EXPECT_EQ(keyIds.size(), 2);
+  EXPECT_TRUE(hasDefaultKeySamples);
+}
+
+TEST_F(CencSampleGroupsTest, SampleEncryptionPerGroupIvSize)
+{
+  const AP4_UI08 defaultConstantIv[16]{0x11, 0x22};
+  ASSERT_TRUE(AddEntry(MakeEntry(0, 1, 16, 0x01), true));
+  ASSERT_TRUE(AddEntry(MakeEntry(0, 0, 0, 0x00), true));
+  m_groups.AddSampleRun(1, 0);
+  m_groups.AddSampleRun(1, 0x10001);
+  m_groups.AddSampleRun(1, 0x10002);
+
+  // version/flags (subsamples), sample count
+  std::vector<AP4_UI08> senc{0, 0, 0, 2, 0, 0, 0, 3};
+  // Sample 0, track defaults: 8 bytes IV, 1 subsample
+  senc.insert(senc.end(), {1, 2, 3, 4, 5, 6, 7, 8, 0, 1, 0, 5, 0, 0, 0, 100});
+  // Sample 1, sample group: 16 bytes IV, 2 subsamples
+  senc.insert(senc.end(), 16, 0xCC);
+  senc.insert(senc.end(), {0, 2, 0, 7, 0, 0, 0, 16, 0, 3, 0, 0, 0, 32});
+  // Sample 2, unencrypted: no IV
+  senc.insert(senc.end(), {0, 1, 0, 50, 0, 0, 0, 0});
+
+  ASSERT_TRUE(m_groups.ParseSampleEncryption(senc.data(), static_cast<AP4_Size>(senc.size()), 8,
+                                             defaultConstantIv));
+
+  const CCencSampleGroups::SampleInfo* info{m_groups.GetSampleInfo(0)};
+  ASSERT_NE(info, nullptr);
+  EXPECT_EQ(info->m_iv[7], 8);
+  EXPECT_EQ(info->m_iv[8], 0);
+  ASSERT_EQ(info->m_clearBytes.size(), 1);
+  EXPECT_EQ(info->m_clearBytes[0], 5);
+  EXPECT_EQ(info->m_cipherBytes[0], 100);
+
+  info = m_groups.GetSampleInfo(1);
+  ASSERT_NE(info, nullptr);
+  EXPECT_EQ(info->m_iv[15], 0xCC);
+  ASSERT_EQ(info->m_clearBytes.size(), 2);
+  EXPECT_EQ(info->m_clearBytes[1], 3);
+  EXPECT_EQ(info->m_cipherBytes[1], 32);
+
+  info = m_groups.GetSampleInfo(2);
+  ASSERT_NE(info, nullptr);
+  ASSERT_EQ(info->m_clearBytes.size(), 1);
+  EXPECT_EQ(info->m_clearBytes[0], 50);
+
+  EXPECT_EQ(m_groups.GetSampleInfo(3), nullptr);
+
+  // Truncated data
+  EXPECT_FALSE(m_groups.ParseSampleEncryption(senc.data(),
+                                              static_cast<AP4_Size>(senc.size() - 1), 8,
+                                              defaultConstantIv));
+}
+
+TEST_F(CencSampleGroupsTest, SampleEncryptionConstantIv)
+{
+  const AP4_UI08 defaultConstantIv[16]{0x11, 0x22};
+  // version/flags (no subsamples), sample count, no IVs for constant IV
+  const std::vector<AP4_UI08> senc{0, 0, 0, 0, 0, 0, 0, 2};
+
+  ASSERT_TRUE(m_groups.ParseSampleEncryption(senc.data(), static_cast<AP4_Size>(senc.size()), 0,
+                                             defaultConstantIv));
+  const CCencSampleGroups::SampleInfo* info{m_groups.GetSampleInfo(1)};
+  ASSERT_NE(info, nullptr);
+  EXPECT_EQ(info->m_iv[0], 0x11);
+  EXPECT_EQ(info->m_iv[1], 0x22);
+  EXPECT_TRUE(info->m_clearBytes.empty());
+}
@@ -0,0 +1,400 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "TestHelper.h"
+
+#include "../codechandler/cc/Cea608Decoder.h"
+#include "../codechandler/cc/Cea708Decoder.h"
+#include "../codechandler/cc/ClosedCaptions.h"
+
+#include <fstream>
+#include <iterator>
+
+#include <bento4/Ap4.h>
+#include <gtest/gtest.h>
+
+namespace
+{
+// The CEA-608 bytes are transmitted with odd parity
+uint8_t AddParity(uint8_t byte)
+{
+  uint8_t ones{0};
+  for (uint8_t bits = byte; bits; bits >>= 1)
+  {
+    ones += bits & 1;
+  }
+  return ones % 2 ? byte : byte | 0x80;
+}
+
+// Append a CEA-608 byte pair of the field 1 as cc_data triplet
+void Add608(std::vector<uint8_t>& ccData, uint8_t data1, uint8_t data2)
+{
+  ccData.insert(ccData.end(), {0xFC, AddParity(data1), AddParity(data2)});
+}
+
+void Add608Text(std::vector<uint8_t>& ccData, const std::string& text)
+{
+  for (size_t i{0}; i < text.size(); i += 2)
+  {
+    Add608(ccData, text[i], i + 1 < text.size() ? text[i + 1] : 0);
+  }
+}
+
+// Append a CEA-708 DTVCC packet of a single service block as cc_data triplets
+void Add708Packet(std::vector<uint8_t>& ccData, uint8_t service, std::vector<uint8_t> block)
+{
+  std::vector<uint8_t> packet{static_cast<uint8_t>(service << 5 | block.size())};
+  packet.insert(packet.end(), block.begin(), block.end());
+  // The packet size include the header and is a multiple of 2
+  if (packet.size() % 2 == 0)
+    packet.push_back(0);
+
+  ccData.insert(ccData.end(), {0xFF, static_cast<uint8_t>((packet.size() + 1) / 2), packet[0]});
+  for (size_t i{1}; i < packet.size(); i += 2)
+  {
+    ccData.insert(ccData.end(), {0xFE, packet[i], packet[i + 1]});
+  }
+}
+
+std::vector<CaptionCue> Decode(CCaptionDecoder& decoder,
+                               const std::vector<uint8_t>& ccData,
+                               uint64_t pts)
+{
+  decoder.Decode(ccData.data(), ccData.size(), pts);
+  std::vector<CaptionCue> cues;
+  CaptionCue cue;
+  while (decoder.TakeCue(cue))
+  {
+    cues.emplace_back(cue);
+  }
+  return cues;
+}
+
+// SEI RBSP of a user_data_registered_itu_t_t35 message with ATSC A/53 cc_data
+std::vector<uint8_t> CreateSEI(const std::vector<uint8_t>& ccData)
+{
+  std::vector<uint8_t> payload{0xB5, 0x00, 0x31, 'G', 'A', '9', '4', 0x03};
+  payload.push_back(static_cast<uint8_t>(0x40 | ccData.size() / 3));
+  payload.push_back(0xFF); // em_data
+  payload.insert(payload.end(), ccData.begin(), ccData.end());
+  payload.push_back(0xFF); // marker_bits
+
+  std::vector<uint8_t> sei{0x04, static_cast<uint8_t>(payload.size())};
+  sei.insert(sei.end(), payload.begin(), payload.end());
+  sei.push_back(0x80); // rbsp_trailing_bits
+  return sei;
+}
+} // unnamed namespace
+
+TEST(ClosedCaptionsTest, ExtractLengthPrefixedAvc)
+{
+  std::vector<uint8_t> ccData;
+  Add608(ccData, 0x14, 0x20);
+  const std::vector<uint8_t> sei{CreateSEI(ccData)};
+
+  // Access unit of an AUD, a SEI and a slice NAL unit, with 4 bytes length prefix
+  std::vector<uint8_t> data{0, 0, 0, 2, 0x09, 0xF0};
+  data.insert(data.end(), {0, 0, 0, static_cast<uint8_t>(sei.size() + 1), 0x06});
+  data.insert(data.end(), sei.begin(), sei.end());
+  data.insert(data.end(), {0, 0, 0, 3, 0x65, 0x88, 0x84});
+
+  std::vector<uint8_t> extracted;
+  ExtractCaptionData(data.data(), data.size(), 4, false, extracted);
+  EXPECT_EQ(extracted, ccData);
+}
+
+TEST(ClosedCaptionsTest, ExtractAnnexBHevc)
+{
+  std::vector<uint8_t> ccData;
+  Add608(ccData, 0x14, 0x2C);
+  ccData.insert(ccData.end(), {0xFA, 0x00, 0x00}); // Invalid padding triplet
+  const std::vector<uint8_t> sei{CreateSEI(ccData)};
+
+  // Prefix SEI NAL unit followed by an IDR slice, with start codes
+  std::vector<uint8_t> data{0, 0, 0, 1, 39 << 1, 0x01};
+  data.insert(data.end(), sei.begin(), sei.end());
+  data.insert(data.end(), {0, 0, 1, 19 << 1, 0x01, 0xAF});
+
+  std::vector<uint8_t> extracted;
+  ExtractCaptionData(data.data(), data.size(), 0, true, extracted);
+  EXPECT_EQ(extracted, ccData);
+
+  // The AVC SEI NAL unit type differ
+  extracted.clear();
+  ExtractCaptionData(data.data(), data.size(), 0, false, extracted);
+  EXPECT_TRUE(extracted.empty());
+}
+
+TEST(ClosedCaptionsTest, ParseSEIWithoutCaptions)
+{
+  // Recovery point SEI message only
+  const std::vector<uint8_t> sei{0x06, 0x01, 0xC4, 0x80};
+  std::vector<uint8_t> extracted;
+  ParseSEICaptionData(sei.data(), sei.size(), extracted);
+  EXPECT_TRUE(extracted.empty());
+}
+
+TEST(ClosedCaptionsTest, Cea608PopOn)
+{
+  CCea608Decoder decoder(1);
+
+  std::vector<uint8_t> ccData;
+  // RCL sent twice, the redundant control code is skipped
+  Add608(ccData, 0x14, 0x20);
+  Add608(ccData, 0x14, 0x20);
+  Add608(ccData, 0x14, 0x70); // PAC row 15
+  Add608Text(ccData, "HELLO");
+  // The text is loaded in the non displayed memory
+  EXPECT_TRUE(Decode(decoder, ccData, 1000).empty());
+
+  ccData.clear();
+  Add608(ccData, 0x14, 0x2F); // EOC
+  // The cue duration is known when the caption is cleared
+  EXPECT_TRUE(Decode(decoder, ccData, 2000).empty());
+
+  ccData.clear();
+  Add608(ccData, 0x14, 0x2C); // EDM
+  std::vector<CaptionCue> cues{Decode(decoder, ccData, 3500)};
+  ASSERT_EQ(cues.size(), 1);
+  EXPECT_EQ(cues[0].m_text, "HELLO");
+  EXPECT_EQ(cues[0].m_pts, 2000);
+  EXPECT_EQ(cues[0].m_duration, 1500);
+}
+
+TEST(ClosedCaptionsTest, Cea608RollUp)
+{
+  CCea608Decoder decoder(1);
+
+  std::vector<uint8_t> ccData;
+  Add608(ccData, 0x14, 0x25); // RU2
+  Add608(ccData, 0x14, 0x2D); // CR
+  Add608Text(ccData, "ONE");
+  Add608(ccData, 0x14, 0x2D);
+  Add608Text(ccData, "TWO");
+  Add608(ccData, 0x14, 0x2D);
+  Add608Text(ccData, "THREE");
+
+  EXPECT_TRUE(Decode(decoder, ccData, 1000).empty());
+
+  // Two rows are kept displayed, until the next line
+  ccData.clear();
+  Add608(ccData, 0x14, 0x2D);
+  Add608Text(ccData, "FOUR");
+  std::vector<CaptionCue> cues{Decode(decoder, ccData, 2000)};
+  ASSERT_EQ(cues.size(), 1);
+  EXPECT_EQ(cues[0].m_text, "TWO\nTHREE");
+  EXPECT_EQ(cues[0].m_duration, 1000);
+}
+
+TEST(ClosedCaptionsTest, Cea608Characters)
+{
+  CCea608Decoder decoder(1);
+
+  std::vector<uint8_t> ccData;
+  Add608(ccData, 0x14, 0x29); // RDC
+  Add608(ccData, 0x14, 0x4E); // PAC row 14, italics
+  Add608(ccData, 0x11, 0x37); // Music note
+  Add608Text(ccData, "A");
+  Add608(ccData, 0x12, 0x20); // Replace the A with an accented A
+  Add608Text(ccData, "\x2A"); // Basic character difference
+  EXPECT_TRUE(Decode(decoder, ccData, 1000).empty());
+
+  ccData.clear();
+  Add608(ccData, 0x14, 0x2C); // EDM
+  std::vector<CaptionCue> cues{Decode(decoder, ccData, 2000)};
+  ASSERT_EQ(cues.size(), 1);
+  EXPECT_EQ(cues[0].m_text, "<i>♪Áá</i>");
+}
+
+TEST(ClosedCaptionsTest, Cea608DataChannel)
+{
+  CCea608Decoder decoderCC1(1);
+  CCea608Decoder decoderCC2(2);
+
+  // Control codes of the data channel 2 have the channel bit set
+  std::vector<uint8_t> ccData;
+  Add608(ccData, 0x1C, 0x29); // RDC
+  Add608(ccData, 0x1C, 0x70);
+  Add608Text(ccData, "CC2");
+  EXPECT_TRUE(Decode(decoderCC1, ccData, 1000).empty());
+  EXPECT_TRUE(Decode(decoderCC2, ccData, 1000).empty());
+
+  ccData.clear();
+  Add608(ccData, 0x1C, 0x2C); // EDM
+  EXPECT_TRUE(Decode(decoderCC1, ccData, 2000).empty());
+  std::vector<CaptionCue> cues{Decode(decoderCC2, ccData, 2000)};
+  ASSERT_EQ(cues.size(), 1);
+  EXPECT_EQ(cues[0].m_text, "CC2");
+}
+
+TEST(ClosedCaptionsTest, Cea708Window)
+{
+  CCea708Decoder decoder(1);
+  CCea708Decoder decoderService2(2);
+
+  // DF0 visible window of 1 row and 32 columns, followed by the text
+  std::vector<uint8_t> ccData;
+  Add708Packet(ccData, 1, {0x98, 0x20, 0x00, 0x00, 0x00, 0x1F, 0x00, 'H', 'I', 0x7F});
+
+  EXPECT_TRUE(Decode(decoder, ccData, 1000).empty());
+  EXPECT_TRUE(Decode(decoderService2, ccData, 1000).empty());
+
+  // HDW hide the window 0
+  ccData.clear();
+  Add708Packet(ccData, 1, {0x8A, 0x01});
+  std::vector<CaptionCue> cues{Decode(decoder, ccData, 3000)};
+  ASSERT_EQ(cues.size(), 1);
+  EXPECT_EQ(cues[0].m_text, "HI♪");
+  EXPECT_EQ(cues[0].m_pts, 1000);
+  EXPECT_EQ(cues[0].m_duration, 2000);
+  EXPECT_TRUE(Decode(decoderService2, ccData, 3000).empty());
+}
+
+TEST(ClosedCaptionsTest, MaxCueDuration)
+{
+  CCea608Decoder decoder(1);
+
+  std::vector<uint8_t> ccData;
+  Add608(ccData, 0x14, 0x29); // RDC
+  Add608(ccData, 0x14, 0x70);
+  Add608Text(ccData, "LONG");
+  EXPECT_TRUE(Decode(decoder, ccData, 0).empty());
+
+  // A caption displayed for a long time is sent in 5 secs cues
+  EXPECT_TRUE(Decode(decoder, {}, 4000000).empty());
+  std::vector<CaptionCue> cues{Decode(decoder, {}, 5000000)};
+  ASSERT_EQ(cues.size(), 1);
+  EXPECT_EQ(cues[0].m_text, "LONG");
+  EXPECT_EQ(cues[0].m_pts, 0);
+  EXPECT_EQ(cues[0].m_duration, 5000000);
+
+  ccData.clear();
+  Add608(ccData, 0x14, 0x2C); // EDM
+  cues = Decode(decoder, ccData, 6000000);
+  ASSERT_EQ(cues.size(), 1);
+  EXPECT_EQ(cues[0].m_text, "LONG");
+  EXPECT_EQ(cues[0].m_pts, 5000000);
+  EXPECT_EQ(cues[0].m_duration, 1000000);
+}
+
+TEST(ClosedCaptionsTest, ReorderPictures)
+{
+  CClosedCaptions closedCaptions;
+  closedCaptions.SetChannels({{"CC1", "eng", "English"}, {"SERVICE1"}, {"TEXT1"}});
+  // The unsupported channel is not added
+  ASSERT_EQ(closedCaptions.GetChannelCount(), 2);
+  EXPECT_EQ(closedCaptions.GetChannel(0).m_language, "eng");
+  EXPECT_FALSE(closedCaptions.IsEnabled());
+  closedCaptions.EnableChannel(0, true);
+  EXPECT_TRUE(closedCaptions.IsEnabled());
+
+  std::vector<uint8_t> loadCaption;
+  Add608(loadCaption, 0x14, 0x20);
+  Add608(loadCaption, 0x14, 0x70);
+  Add608Text(loadCaption, "HI");
+  std::vector<uint8_t> endOfCaption;
+  Add608(endOfCaption, 0x14, 0x2F);
+
+  // In decode order the picture with the end of caption is before the caption loaded
+  closedCaptions.AddPicture(200, endOfCaption);
+  closedCaptions.AddPicture(100, loadCaption);
+
+  size_t index{0};
+  CaptionCue cue;
+  EXPECT_FALSE(closedCaptions.TakeCue(index, cue));
+
+  std::vector<uint8_t> eraseDisplayed;
+  Add608(eraseDisplayed, 0x14, 0x2C);
+  for (uint64_t pts = 300; pts < 1600; pts += 100)
+  {
+    closedCaptions.AddPicture(pts, pts == 600 ? eraseDisplayed : std::vector<uint8_t>{});
+  }
+  ASSERT_TRUE(closedCaptions.TakeCue(index, cue));
+  EXPECT_EQ(index, 0);
+  EXPECT_EQ(cue.m_pts, 200);
+  EXPECT_EQ(cue.m_duration, 400);
+  EXPECT_EQ(cue.m_text, "HI");
+  EXPECT_FALSE(closedCaptions.TakeCue(index, cue));
+
+  // Same channels, the decoders are kept
+  closedCaptions.SetChannels({{"CC1", "eng", "English"}, {"SERVICE1"}});
+  EXPECT_TRUE(closedCaptions.IsEnabled());
+}
+
+TEST(ClosedCaptionsTest, FragmentedAvcSamples)
+{
+  // Fragment of 34 AVC samples at 25 fps (timescale 90000), in decode order with
+  // B-frames. As an encoder output, each picture SEI carry 10 cc_data triplets:
+  // a CEA-608 pop-on caption with doubled control codes on CC1, a CEA-708 window
+  // on SERVICE1 and the padding, with emulation prevention bytes
+  std::ifstream file(GetEnv("SAMPLESDIR") + "/closed_captions.m4s", std::ios::binary);
+  ASSERT_TRUE(file.good());
+  const std::string data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+  AP4_MemoryByteStream* stream = new AP4_MemoryByteStream(
+      reinterpret_cast<const AP4_UI08*>(data.data()), static_cast<AP4_Size>(data.size()));
+  AP4_Atom* atom{nullptr};
+  const AP4_Result result = AP4_DefaultAtomFactory::Instance_.CreateAtomFromStream(*stream, atom);
+  stream->Release();
+  ASSERT_TRUE(AP4_SUCCEEDED(result));
+  std::unique_ptr<AP4_Atom> moof{atom};
+
+  AP4_ContainerAtom* moofContainer = AP4_DYNAMIC_CAST(AP4_ContainerAtom, atom);
+  ASSERT_NE(moofContainer, nullptr);
+  AP4_ContainerAtom* traf =
+      AP4_DYNAMIC_CAST(AP4_ContainerAtom, moofContainer->GetChild(AP4_ATOM_TYPE_TRAF));
+  ASSERT_NE(traf, nullptr);
+  AP4_TrunAtom* trun = AP4_DYNAMIC_CAST(AP4_TrunAtom, traf->GetChild(AP4_ATOM_TYPE_TRUN));
+  ASSERT_NE(trun, nullptr);
+
+  CClosedCaptions closedCaptions;
+  closedCaptions.SetChannels({{"CC1"}, {"SERVICE1"}});
+  closedCaptions.EnableChannel(0, true);
+  closedCaptions.EnableChannel(1, true);
+
+  // The sample data offset is relative to the moof start
+  size_t offset = static_cast<size_t>(trun->GetDataOffset());
+  uint64_t dts{0};
+  for (AP4_Cardinal i{0}; i < trun->GetEntries().ItemCount(); ++i)
+  {
+    const AP4_TrunAtom::Entry& entry = trun->GetEntries()[i];
+    ASSERT_LE(offset + entry.sample_size, data.size());
+
+    std::vector<uint8_t> ccData;
+    ExtractCaptionData(reinterpret_cast<const uint8_t*>(data.data()) + offset, entry.sample_size,
+                       4, false, ccData);
+    EXPECT_EQ(ccData.size(), 30) << "sample " << i;
+
+    // Presentation time in STREAM_TIME_BASE (us)
+    closedCaptions.AddPicture((dts + entry.sample_composition_time_offset) * 1000000 / 90000,
+                              std::move(ccData));
+    offset += entry.sample_size;
+    dts += entry.sample_duration;
+  }
+
+  std::vector<std::pair<size_t, CaptionCue>> cues;
+  size_t index{0};
+  CaptionCue cue;
+  while (closedCaptions.TakeCue(index, cue))
+  {
+    cues.emplace_back(index, cue);
+  }
+
+  // The EOC of the pop-on caption is on the 11th picture, the EDM on the 21st
+  ASSERT_EQ(cues.size(), 2);
+  EXPECT_EQ(cues[0].first, 0);
+  EXPECT_EQ(cues[0].second.m_text, "HELLO WORLD");
+  EXPECT_EQ(cues[0].second.m_pts, 440000);
+  EXPECT_EQ(cues[0].second.m_duration, 400000);
+
+  // The window is defined on the 5th picture and hidden on the 21st
+  EXPECT_EQ(cues[1].first, 1);
+  EXPECT_EQ(cues[1].second.m_text, "HI");
+  EXPECT_EQ(cues[1].second.m_pts, 200000);
+  EXPECT_EQ(cues[1].second.m_duration, 640000);
+}
@@ -0,0 +1,185 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../common/ContentSteering.h"
+#include "../utils/JsonUtils.h"
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+using namespace adaptive;
+using namespace UTILS;
+
+class ContentSteeringTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_steering.Initialize(CContentSteering::Protocol::HLS, "https://steering.foo.bar/hls.json",
+                          "CDN-A");
+    m_steering.AddPathwayUrl("CDN-A", "https://cdn-a.foo.bar", "https://cdn-a.foo.bar");
+    m_steering.AddPathwayUrl("CDN-B", "https://cdn-b.foo.bar/content/live/stream_1/out.m3u8",
+                             "https://cdn-a.foo.bar/live/stream_1/out.m3u8");
+  }
+
+  CContentSteering m_steering;
+};
+
+TEST(JsonUtilsTest, ParseDocument)
+{
+  JSON::Value value;
+  ASSERT_TRUE(JSON::Parse(R"( {"VERSION": 1, "TTL": 2.5e1, "RELOAD-URI": "a\/bè",
+                              "LIST": ["x", true, null, {"K": -3}]} )",
+                          value));
+  EXPECT_EQ(value.m_type, JSON::ValueType::OBJECT);
+  EXPECT_EQ(value.GetNumber("VERSION"), 1);
+  EXPECT_EQ(value.GetNumber("TTL"), 25);
+  EXPECT_EQ(value.GetString("RELOAD-URI"), "a/b\xC3\xA8");
+  EXPECT_EQ(value.GetNumber("MISSING", 300), 300);
+
+  const JSON::Value* list{value.Get("LIST")};
+  ASSERT_NE(list, nullptr);
+  ASSERT_EQ(list->m_array.size(), 4);
+  EXPECT_EQ(list->m_array[0].m_string, "x");
+  EXPECT_TRUE(list->m_array[1].m_boolean);
+  EXPECT_EQ(list->m_array[2].m_type, JSON::ValueType::NUL);
+  EXPECT_EQ(list->m_array[3].GetNumber("K"), -3);
+}
+
+TEST(JsonUtilsTest, ParseMalformed)
+{
+  JSON::Value value;
+  EXPECT_FALSE(JSON::Parse("", value));
+  EXPECT_FALSE(JSON::Parse(R"({"A": 1,})", value));
+  EXPECT_FALSE(JSON::Parse(R"({"A": "unterminated})", value));
+  EXPECT_FALSE(JSON::Parse(R"({"A": 1} trailing)", value));
+  EXPECT_FALSE(JSON::Parse(std::string(100, '['), value));
+
+  // Data after the root value can be allowed
+  EXPECT_TRUE(JSON::Parse(R"({"A": 1} trailing)", value, true));
+  EXPECT_EQ(value.GetNumber("A"), 1);
+}
+
+TEST(JsonUtilsTest, FindAndPath)
+{
+  JSON::Value value;
+  ASSERT_TRUE(JSON::Parse(R"({"b": {"key": "first"}, "a": [{"key": "second"}], "key": "last"})",
+                          value));
+
+  // Members are searched in document order, at any depth
+  const JSON::Value* found{value.Find("key")};
+  ASSERT_NE(found, nullptr);
+  EXPECT_EQ(found->m_string, "first");
+  EXPECT_EQ(value.m_object[0].first, "b");
+  EXPECT_EQ(value.Find("missing"), nullptr);
+
+  found = value.GetPath("a/0/key");
+  ASSERT_NE(found, nullptr);
+  EXPECT_EQ(found->m_string, "second");
+  EXPECT_EQ(value.GetPath("a/1/key"), nullptr);
+  EXPECT_EQ(value.GetPath("a/x"), nullptr);
+}
+
+TEST_F(ContentSteeringTest, ResolveUrl)
+{
+  const std::string url{"https://cdn-a.foo.bar/live/stream_1/out.m3u8"};
+  // The default pathway is used until the first steering manifest
+  EXPECT_EQ(m_steering.ResolveUrl(url), url);
+
+  ASSERT_TRUE(m_steering.ApplyManifest(
+      R"({"VERSION":1,"TTL":10,"PATHWAY-PRIORITY":["CDN-C","CDN-B","CDN-A"]})",
+      "https://steering.foo.bar/hls.json"));
+  // Unknown pathways are ignored
+  EXPECT_EQ(m_steering.GetPathway(), "CDN-B");
+
+  EXPECT_EQ(m_steering.ResolveUrl(url), "https://cdn-b.foo.bar/content/live/stream_1/out.m3u8");
+  EXPECT_EQ(m_steering.ResolveUrl("https://cdn-a.foo.bar/live/stream_2/seg.ts"),
+            "https://cdn-b.foo.bar/content/live/stream_2/seg.ts");
+  // Urls of the pathway playlists are kept
+  EXPECT_EQ(m_steering.ResolveUrl("https://cdn-b.foo.bar/content/live/stream_1/seg.ts"),
+            "https://cdn-b.foo.bar/content/live/stream_1/seg.ts");
+  // Without equivalent url on the pathway, the url is unchanged
+  EXPECT_EQ(m_steering.ResolveUrl("https://other.foo.bar/key.bin"),
+            "https://other.foo.bar/key.bin");
+
+  // Back to the default pathway, also the urls of the other pathway are resolved
+  ASSERT_TRUE(m_steering.ApplyManifest(R"({"VERSION":1,"PATHWAY-PRIORITY":["CDN-A"]})",
+                                       "https://steering.foo.bar/hls.json"));
+  EXPECT_EQ(m_steering.ResolveUrl("https://cdn-b.foo.bar/content/live/stream_1/seg.ts"),
+            "https://cdn-a.foo.bar/live/stream_1/seg.ts");
+}
+
+TEST_F(ContentSteeringTest, PathwayClone)
+{
+  ASSERT_TRUE(m_steering.ApplyManifest(
+      R"({"VERSION":1,"TTL":10,"PATHWAY-PRIORITY":["CDN-C","CDN-A"],
+          "PATHWAY-CLONES":[
+            {"BASE-ID":"CDN-A","ID":"CDN-C",
+             "URI-REPLACEMENT":{"HOST":"cdn-c.foo.bar","PARAMS":{"token":"abc"}}},
+            {"BASE-ID":"CDN-B","ID":"CDN-D","URI-REPLACEMENT":{"HOST":"cdn-d.foo.bar"}}]})",
+      "https://steering.foo.bar/hls.json"));
+
+  EXPECT_TRUE(m_steering.HasPathway("CDN-C"));
+  EXPECT_TRUE(m_steering.HasPathway("CDN-D"));
+  EXPECT_EQ(m_steering.GetPathway(), "CDN-C");
+  EXPECT_EQ(m_steering.ResolveUrl("https://cdn-a.foo.bar/live/stream_1/seg.ts"),
+            "https://cdn-c.foo.bar/live/stream_1/seg.ts?token=abc");
+
+  ASSERT_TRUE(m_steering.ApplyManifest(R"({"VERSION":1,"PATHWAY-PRIORITY":["CDN-D"]})",
+                                       "https://steering.foo.bar/hls.json"));
+  // The clone keep the path of the base pathway
+  EXPECT_EQ(m_steering.ResolveUrl("https://cdn-a.foo.bar/live/stream_1/seg.ts"),
+            "https://cdn-d.foo.bar/content/live/stream_1/seg.ts");
+}
+
+TEST_F(ContentSteeringTest, ManifestReload)
+{
+  EXPECT_TRUE(m_steering.IsUpdateDue());
+  EXPECT_EQ(m_steering.GetManifestUrl(), "https://steering.foo.bar/hls.json?_HLS_pathway=CDN-A");
+
+  ASSERT_TRUE(m_steering.ApplyManifest(
+      R"({"VERSION":1,"TTL":300,"RELOAD-URI":"next.json?session=1","PATHWAY-PRIORITY":["CDN-B"]})",
+      "https://steering.foo.bar/hls.json"));
+  EXPECT_FALSE(m_steering.IsUpdateDue());
+  EXPECT_EQ(m_steering.GetManifestUrl(),
+            "https://steering.foo.bar/next.json?session=1&_HLS_pathway=CDN-B");
+
+  // Unsupported versions are rejected, the current pathway is kept
+  EXPECT_FALSE(m_steering.ApplyManifest(R"({"VERSION":2,"PATHWAY-PRIORITY":["CDN-A"]})",
+                                        "https://steering.foo.bar/hls.json"));
+  EXPECT_EQ(m_steering.GetPathway(), "CDN-B");
+}
+
+TEST_F(ContentSteeringTest, ManifestInvalidTtl)
+{
+  const auto secondsToUpdate = [this]
+  {
+    return std::chrono::duration_cast<std::chrono::seconds>(m_steering.GetNextUpdateTime() -
+                                                            std::chrono::steady_clock::now())
+        .count();
+  };
+
+  // The TTL provided by the server is clamped
+  ASSERT_TRUE(m_steering.ApplyManifest(R"({"VERSION":1,"TTL":-5,"PATHWAY-PRIORITY":["CDN-B"]})",
+                                       "https://steering.foo.bar/hls.json"));
+  EXPECT_LE(secondsToUpdate(), 1);
+
+  ASSERT_TRUE(m_steering.ApplyManifest(
+      R"({"VERSION":1,"TTL":1e12,"PATHWAY-PRIORITY":["CDN-B"]})",
+      "https://steering.foo.bar/hls.json"));
+  EXPECT_GE(secondsToUpdate(), 86399);
+  EXPECT_LE(secondsToUpdate(), 86400);
+
+  // A non finite TTL falls back to the default one
+  ASSERT_TRUE(m_steering.ApplyManifest(
+      R"({"VERSION":1,"TTL":1e400,"PATHWAY-PRIORITY":["CDN-B"]})",
+      "https://steering.foo.bar/hls.json"));
+  EXPECT_GE(secondsToUpdate(), CContentSteering::DEFAULT_TTL - 1);
+  EXPECT_LE(secondsToUpdate(), CContentSteering::DEFAULT_TTL);
+}
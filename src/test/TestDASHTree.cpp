@@ -11,6 +11,8 @@
 #include "../utils/PropertiesUtils.h"
 #include "../utils/UrlUtils.h"
 
+#include <algorithm>
+
 #include <gtest/gtest.h>
 
 
@@ -26,12 +28,14 @@ protected:
 
     tree = new DASHTestTree(m_reprChooser);
     tree->Configure(kodiProps);
-    tree->m_supportedKeySystem = "urn:uuid:EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED";
+    tree->m_supportedKeySystems = {"urn:uuid:EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED"};
   }
 
   void TearDown() override
   {
     testHelper::effectiveUrl.clear();
+    testHelper::missingUrls.clear();
+    testHelper::steeringServer = nullptr;
     delete tree;
     tree = nullptr;
     delete m_reprChooser;
@@ -336,12 +340,187 @@ TEST_F(DASHTreeAdaptiveStreamTest, replacePlaceHolders)
   EXPECT_EQ(testHelper::downloadList[4], "https://foo.bar/videosd-400x224/segment.m4s");
 }
 
+TEST_F(DASHTreeAdaptiveStreamTest, InitSegmentCacheShared)
+{
+  OpenTestFile("mpd/placeholders.mpd", "https://foo.bar/placeholders.mpd");
+  tree->has_timeshift_buffer_ = false;
+  PLAYLIST::CAdaptationSet* adpSet = tree->m_periods[0]->GetAdaptationSets()[0].get();
+
+  // As the DRM discovery, read the init segment without start the stream
+  SetTestStream(NewStream(adpSet));
+  std::string initData;
+  ASSERT_TRUE(testStream->GetInitSegmentData(initData));
+  EXPECT_EQ(initData, "Sixteen bytes!!!");
+  EXPECT_EQ(tree->GetInitSegmentCache().GetCount(), 1);
+
+  // The playback stream must reuse the cached init segment
+  SetTestStream(NewStream(adpSet));
+  testStream->start_stream();
+  ReadSegments(testStream, 16, 5);
+  EXPECT_EQ(testHelper::downloadList[0], "https://foo.bar/videosd-400x224/segment_487050.m4s");
+  EXPECT_EQ(testHelper::downloadList[3], "https://foo.bar/videosd-400x224/segment_487053.m4s");
+
+  // Restart the same representation, e.g. after a stream switch
+  SetTestStream(NewStream(adpSet));
+  testStream->start_stream();
+  ReadSegments(testStream, 16, 2);
+  EXPECT_EQ(testHelper::downloadList[0], "https://foo.bar/videosd-400x224/segment_487050.m4s");
+  EXPECT_EQ(tree->GetInitSegmentCache().GetCount(), 1);
+}
+
+TEST_F(DASHTreeAdaptiveStreamTest, MissingSegmentFromOtherRepresentation)
+{
+  OpenTestFile("mpd/segtimeline_live_multirep.mpd", "https://foo.bar/segtimeline.mpd");
+  SetTestStream(NewStream(tree->m_periods[0]->GetAdaptationSets()[0].get()));
+
+  const std::string repId{testStream->getRepresentation()->GetId()};
+  const std::string otherRepId{repId == "video1" ? "video2" : "video1"};
+  // The segment is lost only from the representation played
+  testHelper::missingUrls.emplace("https://foo.bar/" + repId + "/segment_3.m4s");
+
+  testStream->start_stream();
+  ReadSegments(testStream, 16, 1);
+  // Wait the download retries, while the missing segment is still ahead of the reader
+  ASSERT_TRUE(WaitFor([&otherRepId]
+                      { return testHelper::IsDownloaded(otherRepId + "/segment_3.m4s"); },
+                      std::chrono::seconds(10)));
+  // The representation change interrupt the reads
+  ReadSegments(testStream, 16, 4);
+  ReadSegments(testStream, 16, 4);
+
+  const auto& urls = testHelper::downloadList;
+  EXPECT_NE(std::find(urls.begin(), urls.end(),
+                      "https://foo.bar/" + otherRepId + "/segment_3.m4s"),
+            urls.end());
+  // Then continue with the next segments
+  EXPECT_TRUE(std::any_of(urls.begin(), urls.end(), [](const std::string& url) {
+    return url.find("/segment_4.m4s") != std::string::npos;
+  }));
+}
+
+TEST_F(DASHTreeAdaptiveStreamTest, MissingSegmentSkipped)
+{
+  OpenTestFile("mpd/segtimeline_live_multirep.mpd", "https://foo.bar/segtimeline.mpd");
+  SetTestStream(NewStream(tree->m_periods[0]->GetAdaptationSets()[0].get()));
+
+  // The segment is lost from all representations
+  testHelper::missingUrls.emplace("https://foo.bar/video1/segment_3.m4s");
+  testHelper::missingUrls.emplace("https://foo.bar/video2/segment_3.m4s");
+
+  testStream->start_stream();
+  ReadSegments(testStream, 16, 1);
+  // The download of the next segment follow the skipped one
+  ASSERT_TRUE(
+      WaitFor([] { return testHelper::IsDownloaded("/segment_4.m4s"); }, std::chrono::seconds(10)));
+  ReadSegments(testStream, 16, 4);
+  ReadSegments(testStream, 16, 4);
+
+  // Playback continue with the next segments
+  const auto& urls = testHelper::downloadList;
+  EXPECT_TRUE(std::none_of(urls.begin(), urls.end(), [](const std::string& url) {
+    return url.find("/segment_3.m4s") != std::string::npos;
+  }));
+  EXPECT_TRUE(std::any_of(urls.begin(), urls.end(), [](const std::string& url) {
+    return url.find("/segment_5.m4s") != std::string::npos;
+  }));
+  EXPECT_EQ(testStream->read(&buf, 16), 16);
+}
+
+TEST_F(DASHTreeAdaptiveStreamTest, MissingSegmentStopsVod)
+{
+  OpenTestFile("mpd/segtimeline_vod_multirep.mpd", "https://foo.bar/segtimeline.mpd");
+  SetTestStream(NewStream(tree->m_periods[0]->GetAdaptationSets()[0].get()));
+
+  testHelper::missingUrls.emplace("https://foo.bar/video1/segment_3.m4s");
+  testHelper::missingUrls.emplace("https://foo.bar/video2/segment_3.m4s");
+
+  testStream->start_stream();
+  ReadSegments(testStream, 16, 2);
+  // The VOD segments are not skipped, the stream ends with an error
+  EXPECT_EQ(testStream->read(&buf, 16), 0);
+  EXPECT_FALSE(testHelper::IsDownloaded("/segment_4.m4s"));
+}
+
+TEST_F(DASHTreeAdaptiveStreamTest, ContentSteeringSwitchPathway)
+{
+  CSteeringServerStub server{"https://steering.foo.bar/"};
+  server.SetManifest(R"({"VERSION":1,"TTL":300,"SERVICE-LOCATION-PRIORITY":["beta","alpha"]})");
+  testHelper::steeringServer = &server;
+
+  OpenTestFile("mpd/segtimeline_vod_steering.mpd", "https://foo.bar/segtimeline.mpd");
+  tree->PostOpen(UTILS::PROPERTIES::KodiProperties{});
+  EXPECT_EQ(tree->GetContentSteering().GetDefaultPathway(), "alpha");
+  EXPECT_EQ(tree->m_periods[0]->GetBaseUrl(), "https://cdn-a.foo.bar/dash/");
+
+  // The steering manifest is downloaded by the manifest update thread,
+  // without wait for the stream segment downloads
+  ASSERT_TRUE(WaitFor([this] { return tree->GetContentSteering().GetPathway() == "beta"; }));
+  ASSERT_EQ(server.GetRequestCount(), 1);
+  EXPECT_EQ(CSteeringServerStub::GetParameter(server.GetRequests()[0], "_DASH_pathway"), "alpha");
+
+  SetTestStream(NewStream(tree->m_periods[0]->GetAdaptationSets()[0].get()));
+  testStream->start_stream();
+  ReadSegments(testStream, 16, 4);
+
+  // All the segments are downloaded from the pathway selected
+  const auto& urls = testHelper::downloadList;
+  ASSERT_FALSE(urls.empty());
+  EXPECT_EQ(urls[0], "https://cdn-b.foo.bar/dash/video1/segment_1.m4s");
+  EXPECT_EQ(urls.back().rfind("https://cdn-b.foo.bar/dash/video1/segment_", 0), 0);
+  EXPECT_EQ(server.GetRequestCount(), 1);
+}
+
+TEST(InitSegmentCacheTest, LeastRecentlyUsedEviction)
+{
+  adaptive::CInitSegmentCache cache{10};
+  const PLAYLIST::CRepresentation* repr1 = reinterpret_cast<const PLAYLIST::CRepresentation*>(1);
+  const PLAYLIST::CRepresentation* repr2 = reinterpret_cast<const PLAYLIST::CRepresentation*>(2);
+  std::string data;
+
+  cache.Put(repr1, "init.mp4", "1234");
+  cache.Put(repr2, "init.mp4", "5678");
+  EXPECT_FALSE(cache.Get(repr1, "init.mp4|bytes=0-99", data));
+  ASSERT_TRUE(cache.Get(repr1, "init.mp4", data));
+  EXPECT_EQ(data, "1234");
+
+  // The repr2 entry is the least recently used
+  cache.Put(repr1, "other.mp4", "abcd");
+  EXPECT_EQ(cache.GetCount(), 2);
+  EXPECT_EQ(cache.GetSize(), 8);
+  EXPECT_FALSE(cache.Get(repr2, "init.mp4", data));
+  EXPECT_TRUE(cache.Get(repr1, "init.mp4", data));
+
+  // Data bigger than the cache size is not stored
+  cache.Put(repr2, "big.mp4", "0123456789abc");
+  EXPECT_FALSE(cache.Get(repr2, "big.mp4", data));
+
+  cache.Remove(repr1);
+  EXPECT_EQ(cache.GetCount(), 0);
+  EXPECT_EQ(cache.GetSize(), 0);
+}
+
 TEST_F(DASHTreeTest, updateParameterLiveSegmentTimeline)
 {
   OpenTestFile("mpd/segtimeline_live_pd.mpd");
   EXPECT_EQ(tree->m_manifestUpdateParam, "full");
 }
 
+TEST_F(DASHTreeTest, InbandMpdEventsExtendUpdateInterval)
+{
+  // minimumUpdatePeriod of 6 secs, the updates are triggered by the MPD events
+  // of the segments, the periodic updates are a fallback
+  OpenTestFile("mpd/segtimeline_live_inband_events.mpd");
+  EXPECT_TRUE(tree->HasInbandMpdEvents());
+  EXPECT_EQ(tree->GetUpdateInterval(), 60000);
+}
+
+TEST_F(DASHTreeTest, NoInbandMpdEventsUpdateInterval)
+{
+  OpenTestFile("mpd/segtimeline_live_pd.mpd");
+  EXPECT_FALSE(tree->HasInbandMpdEvents());
+  EXPECT_EQ(tree->GetUpdateInterval(), 9000);
+}
+
 TEST_F(DASHTreeTest, updateParameterVODSegmentStartNumber)
 {
   OpenTestFile("mpd/segtimeline_vod.mpd", "https://foo.bar/dash.mpd?foo=bar&baz=qux&start_seq=$START_NUMBER$");
@@ -386,6 +565,34 @@ TEST_F(DASHTreeTest, CalculatePsshDefaultKid)
   EXPECT_EQ(tree->m_periods[0]->GetPSSHSets()[2].defaultKID_.length(), 16);
 }
 
+TEST_F(DASHTreeTest, MultiDrmSelectCheapestKeySystem)
+{
+  // PlayReady is listed first by the manifest, but Widevine is cheaper
+  tree->m_supportedKeySystems = {"urn:uuid:9A04F079-9840-4286-AB92-E65BE0885F95",
+                                 "urn:uuid:EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED"};
+  tree->SetNowTime(1617229334L);
+  OpenTestFile("mpd/segtpl_old_publish_time.mpd");
+
+  auto& psshSets = tree->m_periods[0]->GetPSSHSets();
+  ASSERT_EQ(psshSets.size(), 3);
+  EXPECT_EQ(psshSets[1].m_keySystem, "urn:uuid:edef8ba9-79d6-4ace-a3c8-27dcd51d21ed");
+  EXPECT_EQ(psshSets[1].pssh_.substr(0, 16), "AAAAYXBzc2gAAAAA");
+  EXPECT_EQ(psshSets[1].defaultKID_.length(), 16);
+  EXPECT_EQ(psshSets[2].m_keySystem, "urn:uuid:edef8ba9-79d6-4ace-a3c8-27dcd51d21ed");
+}
+
+TEST_F(DASHTreeTest, MultiDrmSelectSupportedKeySystem)
+{
+  tree->m_supportedKeySystems = {"urn:uuid:9A04F079-9840-4286-AB92-E65BE0885F95"};
+  tree->SetNowTime(1617229334L);
+  OpenTestFile("mpd/segtpl_old_publish_time.mpd");
+
+  auto& psshSets = tree->m_periods[0]->GetPSSHSets();
+  ASSERT_GE(psshSets.size(), 2);
+  EXPECT_EQ(psshSets[1].m_keySystem, "urn:uuid:9a04f079-9840-4286-ab92-e65be0885f95");
+  EXPECT_EQ(psshSets[1].pssh_.substr(0, 16), "AAAEMHBzc2gAAAAA");
+}
+
 TEST_F(DASHTreeAdaptiveStreamTest, subtitles)
 {
   OpenTestFile("mpd/subtitles.mpd", "https://foo.bar/subtitles.mpd");
@@ -572,8 +779,267 @@ TEST_F(DASHTreeTest, AdaptionSetSwitching)
   EXPECT_EQ(STR(adpSets[4]->GetRepresentations()[0]->GetId()), "8");
 }
 
+TEST_F(DASHTreeTest, AdaptationSetSwitchingMultiCodec)
+{
+  OpenTestFile("mpd/multi_codec_switching.mpd", "https://foo.bar/mpd/stream.mpd");
+
+  // The switchable adaptation sets of different codecs are merged as a single ladder
+  auto& adpSets = tree->m_periods[0]->GetAdaptationSets();
+  ASSERT_EQ(adpSets.size(), 1);
+  ASSERT_EQ(adpSets[0]->GetRepresentations().size(), 3);
+
+  // With 4 Mbit/s of bandwidth, the HEVC 1080p fits while the H.264 1080p does not
+  m_reprChooser->SetScreenResolution(1920, 1080, 1920, 1080);
+  PLAYLIST::CRepresentation* rep = m_reprChooser->GetRepresentation(adpSets[0].get());
+  ASSERT_NE(rep, nullptr);
+  EXPECT_EQ(STR(rep->GetId()), "hevc_1080");
+
+  // While playing the codec is kept
+  PLAYLIST::CRepresentation* avcRep = adpSets[0]->GetRepresentations()[0].get();
+  ASSERT_EQ(STR(avcRep->GetId()), "avc_720");
+  rep = m_reprChooser->GetNextRepresentation(adpSets[0].get(), avcRep);
+  EXPECT_EQ(STR(rep->GetId()), "avc_720");
+}
+
+TEST_F(DASHTreeTest, AudioOnlyChoosesLowestVideo)
+{
+  OpenTestFile("mpd/multi_codec_switching.mpd", "https://foo.bar/mpd/stream.mpd");
+
+  auto& adpSets = tree->m_periods[0]->GetAdaptationSets();
+  ASSERT_EQ(adpSets.size(), 1);
+
+  // The video is downloaded only for the audio carried, the lowest bandwidth is taken
+  m_reprChooser->SetScreenResolution(1920, 1080, 1920, 1080);
+  m_reprChooser->SetAudioOnly(true);
+  PLAYLIST::CRepresentation* rep = m_reprChooser->GetRepresentation(adpSets[0].get());
+  ASSERT_NE(rep, nullptr);
+  EXPECT_EQ(STR(rep->GetId()), "avc_720");
+
+  // While playing the codec is kept
+  PLAYLIST::CRepresentation* hevcRep = adpSets[0]->GetRepresentations()[1].get();
+  ASSERT_EQ(STR(hevcRep->GetId()), "hevc_1080");
+  rep = m_reprChooser->GetNextRepresentation(adpSets[0].get(), hevcRep);
+  EXPECT_EQ(STR(rep->GetId()), "hevc_1080");
+
+  m_reprChooser->SetAudioOnly(false);
+  rep = m_reprChooser->GetRepresentation(adpSets[0].get());
+  EXPECT_EQ(STR(rep->GetId()), "hevc_1080");
+}
+
+TEST_F(DASHTreeAdaptiveStreamTest, SuspendResumeStream)
+{
+  OpenTestFile("mpd/segtimeline_vod_multirep.mpd", "https://foo.bar/segtimeline.mpd");
+  SetTestStream(NewStream(tree->m_periods[0]->GetAdaptationSets()[0].get()));
+  const std::string repId{testStream->getRepresentation()->GetId()};
+
+  testStream->start_stream();
+  ReadSegments(testStream, 16, 3);
+  EXPECT_GT(testStream->GetSegmentBuffersCount(), 0);
+
+  // Suspend as in audio only mode, the buffered segments are released
+  testStream->Stop();
+  testStream->DisposeWorker();
+  testStream->ReleaseSegmentBuffers();
+  EXPECT_EQ(testStream->GetSegmentBuffersCount(), 0);
+
+  // Resume at the playback position of 13 secs, the video continues
+  // from the next segment start
+  testHelper::downloadList.clear();
+  ASSERT_TRUE(testStream->start_stream());
+  EXPECT_GT(testStream->GetSegmentBuffersCount(), 0);
+  bool needReset{false};
+  ASSERT_TRUE(testStream->seek_time(13.0, false, needReset));
+  EXPECT_TRUE(needReset);
+  // The next segment downloaded start at 16 secs
+  PLAYLIST::CRepresentation* rep{testStream->getRepresentation()};
+  const PLAYLIST::CSegment* nextSeg{rep->get_next_segment(rep->current_segment_)};
+  ASSERT_NE(nextSeg, nullptr);
+  EXPECT_EQ(nextSeg->startPTS_, 1440000U);
+
+  ReadSegments(testStream, 16, 2);
+  const auto& urls = testHelper::downloadList;
+  EXPECT_NE(std::find(urls.begin(), urls.end(), "https://foo.bar/" + repId + "/segment_5.m4s"),
+            urls.end());
+}
+
 TEST_F(DASHTreeTest, SuggestedPresentationDelay)
 {
   OpenTestFile("mpd/segtpl_spd.mpd", "https://foo.bar/segtpl_spd.mpd");
   EXPECT_EQ(tree->m_liveDelay, 32);
 }
+
+TEST_F(DASHTreeTest, PruneSegmentsLongRunningLive)
+{
+  // Synthetic live timeline of 7 days with segments of 2 secs, a segment is added
+  // at each update, the playback follows the live edge
+  constexpr uint64_t segDuration{2000};
+  constexpr size_t segmentsCount{7 * 24 * 3600 / 2};
+  constexpr uint64_t timeShiftBufferDepth{300000}; // 150 segments
+
+  auto period = PLAYLIST::CPeriod::MakeUniquePtr();
+  auto adpSet = PLAYLIST::CAdaptationSet::MakeUniquePtr(period.get());
+  auto repr = PLAYLIST::CRepresentation::MakeUniquePtr(adpSet.get());
+  repr->SetTimescale(1000);
+  repr->SetStartNumber(1);
+
+  PLAYLIST::CPeriod::PSSHSet psshSet;
+  psshSet.pssh_ = "PSSH";
+  const uint16_t psshSetPos = period->InsertPSSHSet(&psshSet);
+
+  size_t capacity{0};
+  for (size_t number{1}; number <= segmentsCount; number++)
+  {
+    PLAYLIST::CSegment segment;
+    segment.startPTS_ = (number - 1) * segDuration;
+    segment.url = "segment_" + std::to_string(number) + ".m4s";
+    segment.pssh_set_ = psshSetPos;
+    period->InsertPSSHSet(psshSetPos);
+    repr->SegmentTimeline().GetData().emplace_back(segment);
+
+    // Playing the segment before the last one
+    repr->current_segment_ = repr->get_segment(repr->SegmentTimeline().GetSize() - 2);
+
+    tree->PruneSegments(period.get(), repr.get(), timeShiftBufferDepth);
+
+    ASSERT_LE(repr->SegmentTimeline().GetSize(), 230);
+    // After the first day the memory used must not grow
+    if (number == segmentsCount / 7)
+      capacity = repr->SegmentTimeline().GetData().capacity();
+  }
+
+  EXPECT_EQ(repr->SegmentTimeline().GetData().capacity(), capacity);
+  EXPECT_GE(repr->SegmentTimeline().GetSize(), 150);
+  EXPECT_EQ(repr->GetStartNumber() + repr->SegmentTimeline().GetSize() - 1, segmentsCount);
+
+  // The current segment is kept consistent
+  ASSERT_NE(repr->current_segment_, nullptr);
+  EXPECT_EQ(repr->getCurrentSegmentNumber(), segmentsCount - 1);
+  EXPECT_EQ(repr->current_segment_->url, "segment_" + std::to_string(segmentsCount - 1) + ".m4s");
+
+  // The PSSH set is used by the segments in the timeline only, plus the representation
+  EXPECT_EQ(period->GetPSSHSets()[psshSetPos].m_usageCount,
+            repr->SegmentTimeline().GetSize() + 1);
+}
+
+TEST_F(DASHTreeTest, PrunePeriodsOnManifestUpdate)
+{
+  // Time shift buffer of 60 secs, the window start at 140 secs from the availability start
+  tree->SetNowTime(210);
+  OpenTestFile("mpd/segtimeline_live_periods.mpd", "https://foo.bar/live.mpd");
+  ASSERT_EQ(tree->m_periods.size(), 3);
+  tree->m_currentPeriod = tree->m_periods[2].get();
+
+  auto getPeriodIds = [this]
+  {
+    std::vector<std::string> ids;
+    for (auto& period : tree->m_periods)
+      ids.emplace_back(period->GetId());
+    return ids;
+  };
+
+  // The update adds the period p4, the periods played ended before the window are removed
+  SetFileName(testHelper::testFile, "mpd/segtimeline_live_periods_update.mpd");
+  tree->RefreshLiveSegments();
+  EXPECT_EQ(getPeriodIds(), std::vector<std::string>({"p3", "p4"}));
+  EXPECT_EQ(tree->m_currentPeriod, tree->m_periods[0].get());
+
+  // The next updates still provide the periods removed, they must not be added again
+  tree->RefreshLiveSegments();
+  tree->RefreshLiveSegments();
+  EXPECT_EQ(getPeriodIds(), std::vector<std::string>({"p3", "p4"}));
+  EXPECT_EQ(tree->m_periods[1]->GetSequence(), 3);
+}
+
+TEST_F(DASHTreeTest, EventStream)
+{
+  OpenTestFile("mpd/segtimeline_vod_event_stream.mpd");
+
+  const std::vector<adaptive::TimedEvent> events = tree->GetTimedEvents().GetEvents();
+  ASSERT_EQ(events.size(), 3);
+
+  EXPECT_EQ(events[0].m_schemeIdUri, "urn:scte:scte35:2014:xml+bin");
+  EXPECT_EQ(events[0].m_id, "1001");
+  EXPECT_EQ(events[0].m_type, adaptive::TimedEventType::AD_START);
+  EXPECT_TRUE(events[0].m_isManifestTime);
+  EXPECT_EQ(events[0].m_time, 10000000);
+  // The splice_insert break duration takes precedence over the event duration
+  EXPECT_EQ(events[0].m_duration, 60293566);
+
+  EXPECT_EQ(events[1].m_schemeIdUri, "urn:example:custom");
+  EXPECT_EQ(events[1].m_value, "info");
+  EXPECT_EQ(events[1].m_id, "a");
+  EXPECT_EQ(events[1].m_type, adaptive::TimedEventType::METADATA);
+  EXPECT_EQ(events[1].m_time, 5000000);
+  EXPECT_EQ(events[1].m_duration, 1500000);
+  EXPECT_EQ(events[1].m_messageData, "hello");
+
+  EXPECT_EQ(events[2].m_id, "b");
+  EXPECT_EQ(events[2].m_time, 45000000);
+  EXPECT_EQ(events[2].m_messageData, "world");
+}
+
+TEST_F(DASHTreeTest, ThumbnailTracks)
+{
+  OpenTestFile("mpd/segtpl_thumbnails.mpd", "https://foo.bar/mpd/stream.mpd");
+
+  // The image adaptation set is not added as stream
+  auto& period = tree->m_periods[0];
+  EXPECT_EQ(period->GetAdaptationSets().size(), 1);
+
+  auto& tracks = period->GetThumbnailTracks();
+  ASSERT_EQ(tracks.size(), 2);
+  EXPECT_EQ(tracks[0]->GetId(), "thumbs_320");
+  EXPECT_EQ(tracks[0]->GetMimeType(), "image/jpeg");
+  EXPECT_EQ(tracks[0]->GetColumns(), 5);
+  EXPECT_EQ(tracks[0]->GetRows(), 5);
+  EXPECT_EQ(tracks[0]->GetThumbnailWidth(), 320);
+  EXPECT_EQ(tracks[0]->GetThumbnailHeight(), 180);
+
+  // Tile images of 20 secs by number template, thumbnails of 0.8 secs
+  PLAYLIST::ThumbnailTile tile;
+  ASSERT_TRUE(tracks[0]->GetTile(45000, tile));
+  EXPECT_EQ(tile.m_url, "https://foo.bar/content/thumbs_320/tile_003.jpg");
+  EXPECT_EQ(tile.m_startMs, 44800);
+  EXPECT_EQ(tile.m_durationMs, 800);
+  EXPECT_EQ(tile.m_x, 320);
+  EXPECT_EQ(tile.m_y, 180);
+
+  // Tile images of 30 secs by segment timeline
+  ASSERT_EQ(tracks[1]->GetImageCount(), 2);
+  ASSERT_TRUE(tracks[1]->GetTile(31000, tile));
+  EXPECT_EQ(tile.m_url, "https://foo.bar/content/small/tile_30000.jpg");
+  EXPECT_EQ(tile.m_x, 0);
+  EXPECT_EQ(tile.m_y, 0);
+  EXPECT_EQ(tile.m_width, 160);
+  // Times after the end are clamped to the last thumbnail
+  ASSERT_TRUE(tracks[1]->GetTile(90000, tile));
+  EXPECT_EQ(tile.m_x, 640);
+  EXPECT_EQ(tile.m_y, 360);
+
+  // The track is selected by max width
+  ASSERT_TRUE(tree->GetThumbnailTile(45000, 200, tile));
+  EXPECT_EQ(tile.m_width, 160);
+
+  ASSERT_TRUE(tree->GetThumbnailTile(45000, 0, tile));
+  EXPECT_EQ(tile.m_url, "https://foo.bar/content/thumbs_320/tile_003.jpg");
+}
+
+TEST_F(DASHTreeTest, ClosedCaptionsAccessibility)
+{
+  OpenTestFile("mpd/cea608_accessibility.mpd", "https://foo.bar/mpd/stream.mpd");
+
+  auto& adpSets = tree->m_periods[0]->GetAdaptationSets();
+  ASSERT_EQ(adpSets.size(), 1);
+
+  // The CC7 channel out of the CEA-608 range is ignored
+  auto& closedCaptions = adpSets[0]->GetClosedCaptions();
+  ASSERT_EQ(closedCaptions.size(), 4);
+  EXPECT_EQ(closedCaptions[0].m_instreamId, "CC1");
+  EXPECT_EQ(closedCaptions[0].m_language, "eng");
+  EXPECT_EQ(closedCaptions[1].m_instreamId, "CC3");
+  EXPECT_EQ(closedCaptions[1].m_language, "spa");
+  EXPECT_EQ(closedCaptions[2].m_instreamId, "SERVICE1");
+  EXPECT_EQ(closedCaptions[2].m_language, "eng");
+  EXPECT_EQ(closedCaptions[3].m_instreamId, "SERVICE2");
+  EXPECT_EQ(closedCaptions[3].m_language, "deu");
+}
@@ -0,0 +1,216 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../DemuxScheduler.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace SESSION;
+
+namespace
+{
+constexpr uint64_t MAX_SKEW = 2000000;
+
+// Simulated stream, deliver samples at a fixed interval and can be set
+// as waiting (e.g. segment download in progress) for some simulation steps
+struct SimStream
+{
+  bool m_isEssential{true};
+  uint64_t m_interval{0};
+  uint64_t m_nextTime{0};
+  size_t m_demuxed{0};
+  std::function<bool(size_t)> m_isWaitingAtStep{[](size_t) { return false; }};
+};
+
+class SimPlayer
+{
+public:
+  SimPlayer() : m_scheduler{MAX_SKEW} {}
+
+  size_t AddStream(bool isEssential, uint64_t interval)
+  {
+    SimStream stream;
+    stream.m_isEssential = isEssential;
+    stream.m_interval = interval;
+    m_streams.emplace_back(stream);
+    return m_streams.size() - 1;
+  }
+
+  SimStream& GetStream(size_t index) { return m_streams[index]; }
+  CDemuxScheduler& GetScheduler() { return m_scheduler; }
+
+  // Run one demux step, return the demuxed stream index or the scheduler select code
+  int Step()
+  {
+    std::vector<CDemuxScheduler::StreamState> states(m_streams.size());
+    for (size_t i{0}; i < m_streams.size(); ++i)
+    {
+      states[i].m_isEssential = m_streams[i].m_isEssential;
+      if (m_streams[i].m_isWaitingAtStep(m_step))
+        states[i].m_status = CDemuxScheduler::StreamStatus::WAITING;
+      else
+      {
+        states[i].m_status = CDemuxScheduler::StreamStatus::READY;
+        states[i].m_time = m_streams[i].m_nextTime;
+      }
+    }
+    ++m_step;
+
+    const int selected = m_scheduler.Select(states);
+    if (selected >= 0)
+    {
+      SimStream& stream = m_streams[selected];
+      m_demuxed.emplace_back(stream.m_nextTime);
+      stream.m_nextTime += stream.m_interval;
+      stream.m_demuxed++;
+    }
+    return selected;
+  }
+
+  void Run(size_t steps)
+  {
+    for (size_t i{0}; i < steps; ++i)
+      Step();
+  }
+
+  const std::vector<uint64_t>& GetDemuxedTimes() const { return m_demuxed; }
+
+private:
+  CDemuxScheduler m_scheduler;
+  std::vector<SimStream> m_streams;
+  std::vector<uint64_t> m_demuxed;
+  size_t m_step{0};
+};
+} // unnamed namespace
+
+class DemuxSchedulerTest : public ::testing::Test
+{
+protected:
+  SimPlayer m_player;
+};
+
+TEST_F(DemuxSchedulerTest, InterleaveByTimestamp)
+{
+  m_player.AddStream(true, 40000); // video 25fps
+  m_player.AddStream(true, 21333); // audio 1024 samples at 48kHz
+  m_player.AddStream(false, 1000000); // subtitles
+
+  m_player.Run(500);
+
+  const std::vector<uint64_t>& times = m_player.GetDemuxedTimes();
+  ASSERT_EQ(times.size(), 500);
+  EXPECT_TRUE(std::is_sorted(times.begin(), times.end()));
+}
+
+TEST_F(DemuxSchedulerTest, NoStreamsToDemux)
+{
+  EXPECT_EQ(m_player.GetScheduler().Select({}), CDemuxScheduler::SELECT_NONE);
+
+  std::vector<CDemuxScheduler::StreamState> states(2);
+  EXPECT_EQ(m_player.GetScheduler().Select(states), CDemuxScheduler::SELECT_NONE);
+}
+
+TEST_F(DemuxSchedulerTest, LaggingSubtitleDoesNotStallVideo)
+{
+  const size_t video = m_player.AddStream(true, 40000);
+  const size_t subtitle = m_player.AddStream(false, 1000000);
+
+  // The subtitle stream has a first sample ready at the start, then its reader
+  // is stuck (e.g. waiting for a segment) before it can be demuxed
+  m_player.GetStream(subtitle).m_isWaitingAtStep = [](size_t step) { return step > 0; };
+
+  m_player.Run(200);
+
+  // Video go ahead until the subtitle lag reach the maximum skew, then wait for it
+  const SimStream& videoStream = m_player.GetStream(video);
+  EXPECT_EQ(m_player.GetStream(subtitle).m_demuxed, 0);
+  EXPECT_EQ(videoStream.m_demuxed, MAX_SKEW / 40000 + 1);
+  EXPECT_GT(m_player.GetScheduler().GetSkipCount(subtitle), 0);
+  EXPECT_GT(m_player.GetScheduler().GetWaitCount(subtitle), 0);
+  EXPECT_EQ(m_player.GetScheduler().GetWaitCount(video), 0);
+}
+
+TEST_F(DemuxSchedulerTest, LaggingSecondaryAudioRecovers)
+{
+  const size_t video = m_player.AddStream(true, 40000);
+  const size_t audio = m_player.AddStream(true, 20000);
+  const size_t audio2 = m_player.AddStream(false, 20000);
+
+  // The secondary audio is blocked for a while, less than the max skew
+  m_player.GetStream(audio2).m_isWaitingAtStep = [](size_t step)
+  { return step >= 10 && step < 60; };
+
+  m_player.Run(60);
+  // All the blocked steps have been used to demux the other streams
+  EXPECT_EQ(m_player.GetScheduler().GetWaitCount(audio2), 0);
+  EXPECT_EQ(m_player.GetStream(video).m_demuxed + m_player.GetStream(audio).m_demuxed +
+                m_player.GetStream(audio2).m_demuxed,
+            60);
+
+  // Once unblocked, the lagging stream is demuxed first to catch up
+  const uint64_t audio2Time = m_player.GetStream(audio2).m_nextTime;
+  EXPECT_EQ(m_player.Step(), static_cast<int>(audio2));
+  EXPECT_EQ(m_player.GetDemuxedTimes().back(), audio2Time);
+}
+
+TEST_F(DemuxSchedulerTest, WaitingEssentialStreamHoldsLaterSamples)
+{
+  const size_t video = m_player.AddStream(true, 40000);
+  const size_t audio = m_player.AddStream(true, 20000);
+
+  m_player.Run(10);
+  m_player.GetStream(video).m_isWaitingAtStep = [](size_t step) { return step >= 10; };
+
+  // The next video sample time is unknown until read, the last demuxed one is
+  // its lower bound: audio samples that come before are still demuxed,
+  // then audio wait for the video stream
+  m_player.Run(20);
+  const uint64_t lastVideoTime = m_player.GetStream(video).m_nextTime - 40000;
+  EXPECT_EQ(m_player.GetStream(audio).m_nextTime, lastVideoTime);
+  EXPECT_GT(m_player.GetScheduler().GetWaitCount(video), 0);
+  EXPECT_EQ(m_player.GetScheduler().GetWaitCount(audio), 0);
+}
+
+TEST_F(DemuxSchedulerTest, NotStartedStreamWait)
+{
+  std::vector<CDemuxScheduler::StreamState> states(2);
+  states[0].m_status = CDemuxScheduler::StreamStatus::READY;
+  states[0].m_time = 5000000;
+  states[1].m_status = CDemuxScheduler::StreamStatus::WAITING;
+
+  // A non-essential stream without known position can't stall the others
+  states[1].m_isEssential = false;
+  EXPECT_EQ(m_player.GetScheduler().Select(states), 0);
+
+  // An essential stream must start before the others
+  states[1].m_isEssential = true;
+  EXPECT_EQ(m_player.GetScheduler().Select(states), CDemuxScheduler::SELECT_WAIT);
+}
+
+TEST_F(DemuxSchedulerTest, ResetForgetPositions)
+{
+  std::vector<CDemuxScheduler::StreamState> states(2);
+  states[0].m_status = CDemuxScheduler::StreamStatus::READY;
+  states[0].m_time = 10000000;
+  states[1].m_isEssential = false;
+  states[1].m_status = CDemuxScheduler::StreamStatus::READY;
+  states[1].m_time = 1000000;
+  EXPECT_EQ(m_player.GetScheduler().Select(states), 1);
+
+  // Subtitle is waiting and lag too much
+  states[1].m_status = CDemuxScheduler::StreamStatus::WAITING;
+  EXPECT_EQ(m_player.GetScheduler().Select(states), CDemuxScheduler::SELECT_WAIT);
+
+  // After a seek the old position must not be considered
+  m_player.GetScheduler().Reset();
+  EXPECT_EQ(m_player.GetScheduler().Select(states), 0);
+}
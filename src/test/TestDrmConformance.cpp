@@ -0,0 +1,731 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "ClearKeyDecrypter.h"
+#include "LicenseServerStub.h"
+#include "../CdmSessions.h"
+#include "../KeyRotation.h"
+#include "../common/AdaptationSet.h"
+#include "../common/KeySystemHandlers.h"
+#include "../common/Period.h"
+#include "../common/SampleAesDecrypter.h"
+#include "../utils/Base64Utils.h"
+#include "../../wvdecrypter/LicenseExchange.h"
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace SESSION;
+using namespace UTILS;
+
+namespace
+{
+// W3C common PSSH system id
+constexpr uint8_t COMMON_SYSTEM_ID[16]{0x10, 0x77, 0xef, 0xec, 0xc0, 0xb2, 0x4d, 0x02,
+                                       0xac, 0xe3, 0x3c, 0x1e, 0x52, 0xe2, 0xfb, 0x4b};
+
+const std::string KID_VIDEO(16, '\x11');
+const std::string KID_AUDIO(16, '\x22');
+const std::string KID_ROTATED(16, '\x33');
+const std::string KID_UNKNOWN(16, '\x44');
+
+const std::string LICENSE_URL{"https://license.test/clearkey"};
+
+// The license request template of the URL as opened by the session
+std::string GetLicenseTemplate()
+{
+  return DRM::GetHandler(DRM::KeySystem::CLEARKEY)->GetLicenseRequestTemplate(LICENSE_URL);
+}
+
+std::string FromHex(std::string_view hex)
+{
+  std::string data;
+  for (size_t i = 0; i + 1 < hex.size(); i += 2)
+    data += static_cast<char>(std::stoi(std::string(hex.substr(i, 2)), nullptr, 16));
+  return data;
+}
+
+// Encrypted fixtures from the NIST SP 800-38A AES-128 test vectors
+const std::string NIST_KEY{FromHex("2b7e151628aed2a6abf7158809cf4f3c")};
+const std::string OTHER_KEY{FromHex("000102030405060708090a0b0c0d0e0f")};
+const std::string PLAIN_BLOCKS{
+    FromHex("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51")};
+const std::string CTR_IV{FromHex("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff")};
+const std::string CTR_BLOCKS{
+    FromHex("874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff")};
+const std::string CBC_IV{FromHex("000102030405060708090a0b0c0d0e0f")};
+const std::string CBC_BLOCKS{
+    FromHex("7649abac8119b246cee98e9b12e9197d5086cb9b507219ee95db113a917678b2")};
+
+// Make a PSSH box version 1, with the KIDs and without data
+std::string MakePsshBox(const std::vector<std::string>& keyIds)
+{
+  const uint32_t size{static_cast<uint32_t>(36 + keyIds.size() * 16)};
+  std::string box{static_cast<char>(size >> 24), static_cast<char>(size >> 16),
+                  static_cast<char>(size >> 8), static_cast<char>(size)};
+  box += "pssh";
+  box += std::string("\x01\x00\x00\x00", 4);
+  box.append(reinterpret_cast<const char*>(COMMON_SYSTEM_ID), 16);
+  box += std::string("\x00\x00\x00", 3) + static_cast<char>(keyIds.size());
+  for (const std::string& keyId : keyIds)
+    box += keyId;
+  box += std::string(4, '\0');
+  return box;
+}
+
+std::string MakeBox(std::string_view type, const std::string& payload)
+{
+  const uint32_t size{static_cast<uint32_t>(8 + payload.size())};
+  std::string box{static_cast<char>(size >> 24), static_cast<char>(size >> 16),
+                  static_cast<char>(size >> 8), static_cast<char>(size)};
+  box += type;
+  return box + payload;
+}
+
+// Make an init segment with a 'moov' of a 'mvhd' and a PSSH box version 1,
+// the PSSH data are the KIDs, as accepted by the ClearKey test CDM
+std::string MakeInitSegment(const std::vector<std::string>& keyIds)
+{
+  std::string mvhd(100, '\0');
+  mvhd[15] = '\x01'; // Timescale
+  mvhd[99] = '\x02'; // Next track id
+  std::string pssh{std::string("\x01\x00\x00\x00", 4) +
+                   std::string(reinterpret_cast<const char*>(COMMON_SYSTEM_ID), 16) +
+                   std::string("\x00\x00\x00", 3) + static_cast<char>(keyIds.size())};
+  std::string data;
+  for (const std::string& keyId : keyIds)
+    data += keyId;
+  pssh += data;
+  pssh += std::string("\x00\x00\x00", 3) + static_cast<char>(data.size()) + data;
+  return MakeBox("moov", MakeBox("mvhd", mvhd) + MakeBox("pssh", pssh));
+}
+
+const uint8_t* ToKeyId(const std::string& keyId)
+{
+  return reinterpret_cast<const uint8_t*>(keyId.data());
+}
+
+struct CmafSample
+{
+  std::string m_data;
+  std::vector<AP4_UI16> m_clearBytes;
+  std::vector<AP4_UI32> m_cipherBytes;
+};
+
+// CMAF 'cenc' sample of two subsamples, the encrypted bytes are the NIST CTR blocks
+CmafSample MakeCencSample(std::string& clearData)
+{
+  CmafSample sample;
+  const std::string header{"\x00\x00\x00\x0b\x65", 5};
+  sample.m_data = header + CTR_BLOCKS.substr(0, 10) + "\x41\x9a\x01" +
+                  CTR_BLOCKS.substr(10);
+  sample.m_clearBytes = {5, 3};
+  sample.m_cipherBytes = {10, 22};
+  clearData = header + PLAIN_BLOCKS.substr(0, 10) + "\x41\x9a\x01" +
+              PLAIN_BLOCKS.substr(10);
+  return sample;
+}
+
+// CMAF 'cbcs' sample with a 1:9 pattern, the encrypted blocks are the NIST CBC blocks
+CmafSample MakeCbcsSample(std::string& clearData)
+{
+  const std::string skipped(9 * 16, '\x5a');
+  const std::string trailing(5, '\x7b');
+  CmafSample sample;
+  const std::string header{"\x00\x00\x00\xbd", 4};
+  sample.m_data = header + CBC_BLOCKS.substr(0, 16) + skipped +
+                  CBC_BLOCKS.substr(16) + trailing;
+  sample.m_clearBytes = {4};
+  sample.m_cipherBytes = {11 * 16 + 5};
+  clearData = header + PLAIN_BLOCKS.substr(0, 16) + skipped +
+              PLAIN_BLOCKS.substr(16) + trailing;
+  return sample;
+}
+
+bool DecryptSample(Adaptive_CencSingleSampleDecrypter* ssd,
+                   const std::string& keyId,
+                   CryptoInfo cryptoInfo,
+                   const std::string& iv,
+                   const CmafSample& sample,
+                   std::string& clearData)
+{
+  const AP4_UI32 poolId{ssd->AddPool()};
+  AP4_DataBuffer spsPps;
+  ssd->SetFragmentInfo(poolId, ToKeyId(keyId), 4, spsPps, 0, cryptoInfo);
+
+  AP4_DataBuffer dataIn{sample.m_data.data(), static_cast<AP4_Size>(sample.m_data.size())};
+  AP4_DataBuffer dataOut;
+  const AP4_Result result{ssd->DecryptSampleData(
+      poolId, dataIn, dataOut, reinterpret_cast<const AP4_UI08*>(iv.data()),
+      static_cast<unsigned int>(sample.m_clearBytes.size()), sample.m_clearBytes.data(),
+      sample.m_cipherBytes.data(), nullptr)};
+  ssd->RemovePool(poolId);
+
+  clearData.assign(reinterpret_cast<const char*>(dataOut.GetData()), dataOut.GetDataSize());
+  return AP4_SUCCEEDED(result);
+}
+} // unnamed namespace
+
+class DrmConformanceTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_server.AddKey(KID_VIDEO, NIST_KEY);
+    m_server.AddKey(KID_AUDIO, OTHER_KEY);
+    m_server.AddKey(KID_ROTATED, NIST_KEY);
+    ASSERT_TRUE(m_decrypter.OpenDRMSystem(GetLicenseTemplate().c_str(), {}, 0));
+  }
+
+  void TearDown() override
+  {
+    for (Adaptive_CencSingleSampleDecrypter* ssd : m_ssds)
+      m_decrypter.DestroySingleSampleDecrypter(ssd);
+  }
+
+  Adaptive_CencSingleSampleDecrypter* CreateDecrypter(const std::vector<std::string>& keyIds,
+                                                      bool skipSessionMessage = false)
+  {
+    const std::string pssh{MakePsshBox(keyIds)};
+    AP4_DataBuffer psshData{pssh.data(), static_cast<AP4_Size>(pssh.size())};
+    Adaptive_CencSingleSampleDecrypter* ssd{m_decrypter.CreateSingleSampleDecrypter(
+        psshData, nullptr, keyIds.front(), skipSessionMessage, CryptoMode::AES_CTR)};
+    if (ssd)
+      m_ssds.emplace_back(ssd);
+    return ssd;
+  }
+
+  CLicenseServerStub m_server;
+  CTestSsdHost m_host{m_server};
+  CClearKeyDecrypter m_decrypter{m_host};
+  std::vector<Adaptive_CencSingleSampleDecrypter*> m_ssds;
+};
+
+TEST_F(DrmConformanceTest, SelectKeySystem)
+{
+  EXPECT_STREQ(m_decrypter.SelectKeySytem("org.w3.clearkey"),
+               "urn:uuid:E2719D58-A985-B3C9-781A-B030AF78D30E");
+  EXPECT_EQ(m_decrypter.SelectKeySytem("com.widevine.alpha"), nullptr);
+  EXPECT_TRUE(m_decrypter.HasCdmSession());
+}
+
+TEST_F(DrmConformanceTest, DecryptCmafCencSample)
+{
+  Adaptive_CencSingleSampleDecrypter* ssd{CreateDecrypter({KID_VIDEO})};
+  ASSERT_NE(ssd, nullptr);
+  EXPECT_EQ(m_server.GetRequestCount(), 1U);
+
+  std::string expectedData;
+  const CmafSample sample{MakeCencSample(expectedData)};
+  std::string clearData;
+  ASSERT_TRUE(DecryptSample(ssd, KID_VIDEO, {0, 0, CryptoMode::AES_CTR}, CTR_IV, sample,
+                            clearData));
+  EXPECT_EQ(clearData, expectedData);
+
+  // The license have not the key
+  EXPECT_FALSE(DecryptSample(ssd, KID_AUDIO, {0, 0, CryptoMode::AES_CTR}, CTR_IV, sample,
+                             clearData));
+}
+
+TEST_F(DrmConformanceTest, DecryptCmafCbcsSample)
+{
+  Adaptive_CencSingleSampleDecrypter* ssd{CreateDecrypter({KID_VIDEO})};
+  ASSERT_NE(ssd, nullptr);
+
+  std::string expectedData;
+  const CmafSample sample{MakeCbcsSample(expectedData)};
+  std::string clearData;
+  ASSERT_TRUE(DecryptSample(ssd, KID_VIDEO, {1, 9, CryptoMode::AES_CBC}, CBC_IV, sample,
+                            clearData));
+  EXPECT_EQ(clearData, expectedData);
+}
+
+TEST_F(DrmConformanceTest, DecryptTsSampleAes)
+{
+  // The HLS key is downloaded through the SSD host, as the license
+  void* file{m_host.CURLCreate("https://license.test/key/11111111111111111111111111111111")};
+  ASSERT_TRUE(m_host.CURLOpen(file));
+  char key[32];
+  const size_t keySize{m_host.ReadFile(file, key, sizeof(key))};
+  m_host.CloseFile(file);
+  ASSERT_EQ(keySize, 16U);
+
+  // ADTS frame of a packed audio / TS stream, 16 bytes clear leader then the NIST CBC blocks
+  const size_t frameSize{7 + 16 + 32};
+  std::string frame{"\xFF\xF1\x50", 3};
+  frame += static_cast<char>(0x80 | (frameSize >> 11));
+  frame += static_cast<char>(frameSize >> 3);
+  frame += static_cast<char>(((frameSize & 0x07) << 5) | 0x1F);
+  frame += '\xFC';
+  frame += std::string(16, '\x21');
+  const std::string clearFrame{frame + PLAIN_BLOCKS};
+  frame += CBC_BLOCKS;
+
+  CSampleAesDecrypter decrypter;
+  ASSERT_TRUE(decrypter.SetKey({key, keySize}, reinterpret_cast<const uint8_t*>(CBC_IV.data())));
+  size_t size{frame.size()};
+  ASSERT_TRUE(decrypter.DecryptSample(CSampleAesDecrypter::Codec::AAC,
+                                      reinterpret_cast<uint8_t*>(frame.data()), size));
+  EXPECT_EQ(frame.substr(0, size), clearFrame);
+}
+
+TEST_F(DrmConformanceTest, LicenseUrlTemplate)
+{
+  ASSERT_TRUE(m_decrypter.OpenDRMSystem(
+      "https://license.test/clearkey?hash={HASH}|Content-Type=application%2Fjson&X-Token=abc|"
+      "{\"session\":\"R{SID}\",\"challenge\":\"b{SSM}\"}|JBlicense",
+      {}, 0));
+  m_server.SetChallengeField("challenge");
+  m_server.SetLicenseField("license");
+
+  Adaptive_CencSingleSampleDecrypter* ssd{CreateDecrypter({KID_VIDEO})};
+  ASSERT_NE(ssd, nullptr);
+  EXPECT_TRUE(m_decrypter.HasLicenseKey(ssd, ToKeyId(KID_VIDEO)));
+
+  const std::vector<CLicenseServerStub::Request> requests{m_server.GetRequests()};
+  ASSERT_EQ(requests.size(), 1U);
+  const CLicenseServerStub::Request& request{requests[0]};
+  // The MD5 of the challenge
+  EXPECT_EQ(request.m_url.size(), std::string("https://license.test/clearkey?hash=").size() + 32);
+  EXPECT_EQ(request.m_headers.at("Content-Type"), "application/json");
+  EXPECT_EQ(request.m_headers.at("X-Token"), "abc");
+  EXPECT_NE(request.m_body.find("\"session\":\"" + std::string(ssd->GetSessionId()) + "\""),
+            std::string::npos);
+
+  std::string expectedData;
+  const CmafSample sample{MakeCencSample(expectedData)};
+  std::string clearData;
+  ASSERT_TRUE(DecryptSample(ssd, KID_VIDEO, {0, 0, CryptoMode::AES_CTR}, CTR_IV, sample,
+                            clearData));
+  EXPECT_EQ(clearData, expectedData);
+}
+
+TEST_F(DrmConformanceTest, MultiSessionPsshSets)
+{
+  Adaptive_CencSingleSampleDecrypter* videoSsd{CreateDecrypter({KID_VIDEO})};
+  Adaptive_CencSingleSampleDecrypter* audioSsd{CreateDecrypter({KID_AUDIO})};
+  ASSERT_NE(videoSsd, nullptr);
+  ASSERT_NE(audioSsd, nullptr);
+  EXPECT_STRNE(videoSsd->GetSessionId(), audioSsd->GetSessionId());
+
+  // Each session request only the KIDs of his PSSH
+  const std::vector<CLicenseServerStub::Request> requests{m_server.GetRequests()};
+  ASSERT_EQ(requests.size(), 2U);
+  EXPECT_NE(requests[0].m_body.find(CLicenseServerStub::ToBase64Url(KID_VIDEO)),
+            std::string::npos);
+  EXPECT_EQ(requests[0].m_body.find(CLicenseServerStub::ToBase64Url(KID_AUDIO)),
+            std::string::npos);
+
+  EXPECT_TRUE(m_decrypter.HasLicenseKey(videoSsd, ToKeyId(KID_VIDEO)));
+  EXPECT_FALSE(m_decrypter.HasLicenseKey(videoSsd, ToKeyId(KID_AUDIO)));
+  EXPECT_TRUE(m_decrypter.HasLicenseKey(audioSsd, ToKeyId(KID_AUDIO)));
+
+  SSD::SSD_DECRYPTER::SSD_CAPS caps{};
+  m_decrypter.GetCapabilities(audioSsd, ToKeyId(KID_AUDIO),
+                              SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_AUDIO, caps);
+  EXPECT_NE(caps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SINGLE_DECRYPT, 0);
+  m_decrypter.GetCapabilities(audioSsd, ToKeyId(KID_VIDEO),
+                              SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_VIDEO, caps);
+  EXPECT_EQ(caps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SINGLE_DECRYPT, 0);
+
+  // A PSSH with a KID unknown to the license server
+  EXPECT_EQ(CreateDecrypter({KID_UNKNOWN}), nullptr);
+}
+
+TEST_F(DrmConformanceTest, LicenseRenewal)
+{
+  auto ssd{static_cast<CClearKeySingleSampleDecrypter*>(CreateDecrypter({KID_VIDEO}))};
+  ASSERT_NE(ssd, nullptr);
+
+  std::string expectedData;
+  const CmafSample sample{MakeCencSample(expectedData)};
+  std::string clearData;
+
+  // The renewal is sent on decrypt
+  ssd->RequestRenewal();
+  EXPECT_EQ(m_server.GetRequestCount(), 1U);
+  ASSERT_TRUE(DecryptSample(ssd, KID_VIDEO, {0, 0, CryptoMode::AES_CTR}, CTR_IV, sample,
+                            clearData));
+  EXPECT_EQ(m_server.GetRequestCount(), 2U);
+  EXPECT_EQ(clearData, expectedData);
+
+  // A failed renewal keep the current keys, and it is retried on next decrypt
+  m_server.SetFailCount(CClearKeyDecrypter::MAX_LICENSE_ATTEMPTS);
+  ssd->RequestRenewal();
+  ASSERT_TRUE(DecryptSample(ssd, KID_VIDEO, {0, 0, CryptoMode::AES_CTR}, CTR_IV, sample,
+                            clearData));
+  EXPECT_EQ(m_server.GetRequestCount(), 2U + CClearKeyDecrypter::MAX_LICENSE_ATTEMPTS);
+  EXPECT_FALSE(ssd->GetChallengeData().empty());
+
+  ASSERT_TRUE(DecryptSample(ssd, KID_VIDEO, {0, 0, CryptoMode::AES_CTR}, CTR_IV, sample,
+                            clearData));
+  EXPECT_EQ(m_server.GetRequestCount(), 3U + CClearKeyDecrypter::MAX_LICENSE_ATTEMPTS);
+  EXPECT_TRUE(ssd->GetChallengeData().empty());
+}
+
+TEST_F(DrmConformanceTest, ServerCertificateRequest)
+{
+  const std::filesystem::path path{std::filesystem::temp_directory_path() /
+                                   "isa_drm_conformance_cert"};
+  std::filesystem::remove_all(path);
+  std::filesystem::create_directories(path);
+  m_host.SetProfilePath((path / "").string());
+  m_server.SetServerCertificate("SERVICE-CERTIFICATE");
+
+  m_decrypter.SetPrivacyMode(true);
+  ASSERT_TRUE(m_decrypter.OpenDRMSystem(GetLicenseTemplate().c_str(), {}, 0));
+  ASSERT_NE(CreateDecrypter({KID_VIDEO}), nullptr);
+
+  // The certificate request is followed by the license request
+  const std::vector<CLicenseServerStub::Request> requests{m_server.GetRequests()};
+  ASSERT_EQ(requests.size(), 2U);
+  EXPECT_EQ(requests[0].m_body, std::string("\x08\x04", 2));
+  EXPECT_EQ(m_decrypter.GetServerCertificate(), "SERVICE-CERTIFICATE");
+
+  // A new DRM session use the stored certificate
+  {
+    CClearKeyDecrypter decrypter{m_host};
+    decrypter.SetPrivacyMode(true);
+    ASSERT_TRUE(decrypter.OpenDRMSystem(GetLicenseTemplate().c_str(), {}, 0));
+    EXPECT_EQ(decrypter.GetServerCertificate(), "SERVICE-CERTIFICATE");
+
+    const std::string pssh{MakePsshBox({KID_AUDIO})};
+    AP4_DataBuffer psshData{pssh.data(), static_cast<AP4_Size>(pssh.size())};
+    Adaptive_CencSingleSampleDecrypter* ssd{decrypter.CreateSingleSampleDecrypter(
+        psshData, nullptr, KID_AUDIO, false, CryptoMode::AES_CTR)};
+    ASSERT_NE(ssd, nullptr);
+    EXPECT_EQ(m_server.GetRequestCount(), 3U);
+    decrypter.DestroySingleSampleDecrypter(ssd);
+  }
+  std::filesystem::remove_all(path);
+}
+
+TEST_F(DrmConformanceTest, LicenseFailureAndRetry)
+{
+  // Transient failures are retried
+  m_server.SetFailCount(CClearKeyDecrypter::MAX_LICENSE_ATTEMPTS - 1);
+  EXPECT_NE(CreateDecrypter({KID_VIDEO}), nullptr);
+  EXPECT_EQ(m_server.GetRequestCount(), CClearKeyDecrypter::MAX_LICENSE_ATTEMPTS);
+
+  // License server not available
+  m_server.SetFailCount(CClearKeyDecrypter::MAX_LICENSE_ATTEMPTS);
+  EXPECT_EQ(CreateDecrypter({KID_AUDIO}), nullptr);
+
+  // Deferred license, the request can be sent again after a failure
+  Adaptive_CencSingleSampleDecrypter* ssd{CreateDecrypter({KID_AUDIO}, true)};
+  ASSERT_NE(ssd, nullptr);
+  EXPECT_FALSE(m_decrypter.HasLicenseKey(ssd, ToKeyId(KID_AUDIO)));
+  m_server.SetFailCount(CClearKeyDecrypter::MAX_LICENSE_ATTEMPTS);
+  EXPECT_FALSE(ssd->AcquirePendingLicense());
+  EXPECT_TRUE(ssd->AcquirePendingLicense());
+  EXPECT_TRUE(m_decrypter.HasLicenseKey(ssd, ToKeyId(KID_AUDIO)));
+}
+
+TEST_F(DrmConformanceTest, KeyRotation)
+{
+  Adaptive_CencSingleSampleDecrypter* initialSsd{CreateDecrypter({KID_AUDIO})};
+  ASSERT_NE(initialSsd, nullptr);
+  SSD::SSD_DECRYPTER::SSD_CAPS caps{};
+  m_decrypter.GetCapabilities(initialSsd, nullptr, SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_VIDEO,
+                              caps);
+
+  auto keyRotation{
+      std::make_unique<CKeyRotation>(&m_decrypter, COMMON_SYSTEM_ID, CryptoMode::AES_CTR)};
+  keyRotation->AddDecrypter(initialSsd, caps);
+
+  // New PSSH found in a fragment
+  keyRotation->AcquireLicense(MakePsshBox({KID_ROTATED}), {KID_ROTATED},
+                              SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_VIDEO);
+
+  // As the readers, poll the key status until the license is no longer pending
+  Adaptive_CencSingleSampleDecrypter* ssd{nullptr};
+  const auto endTime = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  CKeyRotation::KeyStatus status;
+  while ((status = keyRotation->GetDecrypter(ToKeyId(KID_ROTATED), ssd, caps)) ==
+             CKeyRotation::KeyStatus::PENDING &&
+         std::chrono::steady_clock::now() < endTime)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  ASSERT_EQ(status, CKeyRotation::KeyStatus::AVAILABLE);
+  EXPECT_NE(ssd, initialSsd);
+  EXPECT_NE(caps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SINGLE_DECRYPT, 0);
+
+  std::string expectedData;
+  const CmafSample sample{MakeCencSample(expectedData)};
+  std::string clearData;
+  ASSERT_TRUE(DecryptSample(ssd, KID_ROTATED, {0, 0, CryptoMode::AES_CTR}, CTR_IV, sample,
+                            clearData));
+  EXPECT_EQ(clearData, expectedData);
+
+  EXPECT_EQ(m_server.GetRequestCount(), 2U);
+  keyRotation->ReleaseDecrypter(ssd);
+  keyRotation.reset();
+}
+
+TEST_F(DrmConformanceTest, LicenseExchangeRequest)
+{
+  CLicenseRequestTemplate licenseTemplate;
+  ASSERT_TRUE(licenseTemplate.Compile(
+      "https://license.test/clearkey?hash={HASH}|X-Token=abc|{\"challenge\":\"b{SSM}\"}|"));
+  m_server.SetChallengeField("challenge");
+  m_server.SetResponseHeader("X-Limit-Video", "max=720");
+
+  const std::string challenge{"{\"kids\":[\"" + CLicenseServerStub::ToBase64Url(KID_VIDEO) +
+                              "\"],\"type\":\"temporary\"}"};
+  const CLicenseRequestTemplate::RequestData requestData{challenge, "session", KID_VIDEO, ""};
+
+  CLicenseExchange exchange{m_host, licenseTemplate};
+  ASSERT_TRUE(exchange.Send(requestData));
+  EXPECT_EQ(exchange.GetResolutionLimit(), 720);
+  EXPECT_FALSE(exchange.IsBinaryResponse());
+
+  // The raw response is the license when the response is not wrapped
+  std::string license;
+  int hdcpLimit{0};
+  ASSERT_TRUE(exchange.GetLicense(false, license, hdcpLimit));
+  EXPECT_EQ(license, exchange.GetResponse());
+  EXPECT_NE(license.find(CLicenseServerStub::ToBase64Url(NIST_KEY)), std::string::npos);
+
+  std::vector<CLicenseServerStub::Request> requests{m_server.GetRequests()};
+  ASSERT_EQ(requests.size(), 1U);
+  EXPECT_EQ(requests[0].m_url.find("https://license.test/clearkey?hash="), 0U);
+  EXPECT_EQ(requests[0].m_headers.at("X-Token"), "abc");
+  EXPECT_EQ(requests[0].m_headers.at("acceptencoding"), "gzip, deflate");
+  EXPECT_EQ(requests[0].m_headers.at("seekable"), "0");
+  EXPECT_EQ(requests[0].m_headers.count("Expect"), 1U);
+  EXPECT_EQ(requests[0].m_body, exchange.GetRequestBody());
+  EXPECT_EQ(requests[0].m_body, "{\"challenge\":\"" + BASE64::Encode(challenge) + "\"}");
+
+  // As the Android decrypter, keep the default CURL behaviour
+  CLicenseExchange androidExchange{m_host, licenseTemplate};
+  androidExchange.DisableExpectHeader();
+  ASSERT_TRUE(androidExchange.Send(requestData));
+  requests = m_server.GetRequests();
+  ASSERT_EQ(requests.size(), 2U);
+  EXPECT_EQ(requests[1].m_headers.count("Expect"), 0U);
+}
+
+TEST_F(DrmConformanceTest, LicenseExchangeResponse)
+{
+  CLicenseRequestTemplate licenseTemplate;
+  ASSERT_TRUE(licenseTemplate.Compile("https://license.test/clearkey|||JBlicense"));
+  m_server.SetLicenseField("license");
+  m_server.SetServerCertificate("SERVICE-CERTIFICATE");
+
+  // The binary service certificate response is not unwrapped
+  const std::string certRequest{"\x08\x04", 2};
+  CLicenseExchange exchange{m_host, licenseTemplate};
+  ASSERT_TRUE(exchange.Send({certRequest, "", KID_VIDEO, ""}));
+  EXPECT_TRUE(exchange.IsBinaryResponse());
+  std::string license;
+  int hdcpLimit{0};
+  ASSERT_TRUE(exchange.GetLicense(true, license, hdcpLimit));
+  EXPECT_EQ(license, "SERVICE-CERTIFICATE");
+
+  // The JSON license response is unwrapped
+  const std::string challenge{"{\"kids\":[\"" + CLicenseServerStub::ToBase64Url(KID_VIDEO) +
+                              "\"]}"};
+  ASSERT_TRUE(exchange.Send({challenge, "", KID_VIDEO, ""}));
+  EXPECT_EQ(exchange.GetResolutionLimit(), 0);
+  ASSERT_TRUE(exchange.GetLicense(false, license, hdcpLimit));
+  EXPECT_EQ(license.find("{\"keys\":["), 0U);
+
+  // HTTP error of the license server
+  m_server.SetFailCount(1);
+  EXPECT_FALSE(exchange.Send({challenge, "", KID_VIDEO, ""}));
+  EXPECT_EQ(exchange.GetError(), "License server returned failure");
+  EXPECT_TRUE(exchange.GetResponse().empty());
+
+  // Invalid license URL template
+  CLicenseRequestTemplate invalidTemplate;
+  EXPECT_FALSE(invalidTemplate.Compile(""));
+  CLicenseExchange invalidExchange{m_host, invalidTemplate};
+  EXPECT_FALSE(invalidExchange.Send({challenge, "", KID_VIDEO, ""}));
+  EXPECT_FALSE(invalidExchange.GetError().empty());
+  EXPECT_EQ(m_server.GetRequestCount(), 3U);
+}
+
+TEST_F(DrmConformanceTest, LicenseResolutionLimitCaps)
+{
+  // The "X-Limit-Video" header of the license response limits the resolution
+  m_server.SetResponseHeader("X-Limit-Video", "max=480");
+  Adaptive_CencSingleSampleDecrypter* ssd{CreateDecrypter({KID_VIDEO})};
+  ASSERT_NE(ssd, nullptr);
+
+  SSD::SSD_DECRYPTER::SSD_CAPS caps{};
+  m_decrypter.GetCapabilities(ssd, ToKeyId(KID_VIDEO),
+                              SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_VIDEO, caps);
+  EXPECT_EQ(caps.hdcpLimit, 480);
+}
+
+class CdmSessionsTest : public DrmConformanceTest
+{
+protected:
+  void SetUp() override
+  {
+    DrmConformanceTest::SetUp();
+    m_period = PLAYLIST::CPeriod::MakeUniquePtr();
+    m_adpSet = PLAYLIST::CAdaptationSet::MakeUniquePtr(m_period.get());
+  }
+
+  void TearDown() override
+  {
+    for (const CCdmSession& session : m_sessions)
+    {
+      if (!session.m_sharedCencSsd)
+        m_decrypter.DestroySingleSampleDecrypter(session.m_cencSingleSampleDecrypter);
+    }
+    DrmConformanceTest::TearDown();
+  }
+
+  uint16_t AddPsshSet(const std::string& pssh, const std::string& defaultKid, uint32_t media)
+  {
+    PLAYLIST::CPeriod::PSSHSet psshSet;
+    psshSet.pssh_ = pssh;
+    psshSet.defaultKID_ = defaultKid;
+    psshSet.media_ = media;
+    psshSet.adaptation_set_ = m_adpSet.get();
+    return m_period->InsertPSSHSet(&psshSet);
+  }
+
+  // As CSession::InitializeDRM, a CDM session for each PSSH set of the period
+  bool CreateSessions(bool isLicenseDeferred)
+  {
+    m_sessions.resize(m_period->GetPSSHSets().size());
+    CCdmSessionFactory factory{
+        m_decrypter, *DRM::GetHandler(DRM::KeySystem::CLEARKEY), m_kodiProps,
+        [this](PLAYLIST::CAdaptationSet* adp, std::string& initSegment, int& trackType)
+        {
+          m_initSegmentRequests++;
+          if (adp != m_adpSet.get() || m_initSegment.empty())
+            return false;
+          initSegment = m_initSegment;
+          trackType = AP4_Track::TYPE_VIDEO;
+          return true;
+        }};
+    return factory.CreateSessions(*m_period, COMMON_SYSTEM_ID, false, isLicenseDeferred,
+                                  m_sessions);
+  }
+
+  PROPERTIES::KodiProperties m_kodiProps;
+  std::unique_ptr<PLAYLIST::CPeriod> m_period;
+  std::unique_ptr<PLAYLIST::CAdaptationSet> m_adpSet;
+  std::string m_initSegment;
+  int m_initSegmentRequests{0};
+  std::vector<CCdmSession> m_sessions;
+};
+
+TEST_F(CdmSessionsTest, SharedSessions)
+{
+  using PSSHSet = PLAYLIST::CPeriod::PSSHSet;
+  const std::string videoPssh{BASE64::Encode(MakePsshBox({KID_VIDEO}))};
+  const std::string audioPssh{BASE64::Encode(MakePsshBox({KID_AUDIO}))};
+  AddPsshSet(videoPssh, KID_VIDEO, PSSHSet::MEDIA_VIDEO);
+  // The KID is licensed by the session of the video PSSH
+  AddPsshSet(BASE64::Encode(MakePsshBox({KID_VIDEO, KID_AUDIO})), KID_VIDEO,
+             PSSHSet::MEDIA_AUDIO);
+  // Without the default KID the session is shared by the same PSSH
+  AddPsshSet(audioPssh, "", PSSHSet::MEDIA_VIDEO);
+  AddPsshSet(audioPssh, "", PSSHSet::MEDIA_AUDIO);
+
+  ASSERT_TRUE(CreateSessions(false));
+  ASSERT_EQ(m_sessions.size(), 5U);
+  EXPECT_EQ(m_server.GetRequestCount(), 2U);
+  EXPECT_EQ(m_initSegmentRequests, 0);
+
+  EXPECT_FALSE(m_sessions[1].m_sharedCencSsd);
+  EXPECT_TRUE(m_sessions[2].m_sharedCencSsd);
+  EXPECT_EQ(m_sessions[2].m_cencSingleSampleDecrypter, m_sessions[1].m_cencSingleSampleDecrypter);
+  EXPECT_FALSE(m_sessions[3].m_sharedCencSsd);
+  EXPECT_NE(m_sessions[3].m_cencSingleSampleDecrypter, m_sessions[1].m_cencSingleSampleDecrypter);
+  EXPECT_TRUE(m_sessions[4].m_sharedCencSsd);
+  EXPECT_EQ(m_sessions[4].m_cencSingleSampleDecrypter, m_sessions[3].m_cencSingleSampleDecrypter);
+
+  EXPECT_NE(m_sessions[1].m_decrypterCaps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SINGLE_DECRYPT,
+            0);
+  EXPECT_TRUE(m_decrypter.HasLicenseKey(m_sessions[4].m_cencSingleSampleDecrypter,
+                                        ToKeyId(KID_AUDIO)));
+}
+
+TEST_F(CdmSessionsTest, PsshFromInitSegment)
+{
+  // The manifest has not the PSSH, the default KID is taken from the init segment PSSH
+  m_initSegment = MakeInitSegment({KID_AUDIO});
+  const uint16_t psshSetPos{
+      AddPsshSet("FILE", "", PLAYLIST::CPeriod::PSSHSet::MEDIA_VIDEO)};
+
+  ASSERT_TRUE(CreateSessions(false));
+  EXPECT_EQ(m_initSegmentRequests, 1);
+  EXPECT_EQ(m_period->GetPSSHSets()[psshSetPos].defaultKID_, KID_AUDIO);
+  ASSERT_NE(m_sessions[psshSetPos].m_cencSingleSampleDecrypter, nullptr);
+  EXPECT_TRUE(m_decrypter.HasLicenseKey(m_sessions[psshSetPos].m_cencSingleSampleDecrypter,
+                                        ToKeyId(KID_AUDIO)));
+}
+
+TEST_F(CdmSessionsTest, PsshFromLicenseData)
+{
+  // The license data property is the init data, with the default KID placeholder
+  m_kodiProps.m_licenseData = BASE64::Encode("{KID}");
+  const uint16_t psshSetPos{
+      AddPsshSet("FILE", KID_VIDEO, PLAYLIST::CPeriod::PSSHSet::MEDIA_VIDEO)};
+
+  ASSERT_TRUE(CreateSessions(false));
+  EXPECT_EQ(m_initSegmentRequests, 0);
+  ASSERT_NE(m_sessions[psshSetPos].m_cencSingleSampleDecrypter, nullptr);
+  EXPECT_TRUE(m_decrypter.HasLicenseKey(m_sessions[psshSetPos].m_cencSingleSampleDecrypter,
+                                        ToKeyId(KID_VIDEO)));
+}
+
+TEST_F(CdmSessionsTest, DeferredLicense)
+{
+  const uint16_t psshSetPos{AddPsshSet(BASE64::Encode(MakePsshBox({KID_VIDEO})), KID_VIDEO,
+                                       PLAYLIST::CPeriod::PSSHSet::MEDIA_VIDEO)};
+
+  ASSERT_TRUE(CreateSessions(true));
+  EXPECT_EQ(m_server.GetRequestCount(), 0U);
+  const CCdmSession& session{m_sessions[psshSetPos]};
+  ASSERT_NE(session.m_cencSingleSampleDecrypter, nullptr);
+  EXPECT_EQ(session.m_decrypterCaps.flags & SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SINGLE_DECRYPT, 0);
+
+  EXPECT_TRUE(session.m_cencSingleSampleDecrypter->AcquirePendingLicense());
+  EXPECT_EQ(m_server.GetRequestCount(), 1U);
+  EXPECT_TRUE(m_decrypter.HasLicenseKey(session.m_cencSingleSampleDecrypter, ToKeyId(KID_VIDEO)));
+}
+
+TEST_F(CdmSessionsTest, SessionFailure)
+{
+  using PSSHSet = PLAYLIST::CPeriod::PSSHSet;
+  AddPsshSet(BASE64::Encode(MakePsshBox({KID_VIDEO})), KID_VIDEO, PSSHSet::MEDIA_VIDEO);
+  // A KID unknown to the license server
+  AddPsshSet(BASE64::Encode(MakePsshBox({KID_UNKNOWN})), KID_UNKNOWN, PSSHSet::MEDIA_AUDIO);
+  AddPsshSet(BASE64::Encode(MakePsshBox({KID_AUDIO})), KID_AUDIO, PSSHSet::MEDIA_AUDIO);
+
+  EXPECT_FALSE(CreateSessions(false));
+  EXPECT_NE(m_sessions[1].m_cencSingleSampleDecrypter, nullptr);
+  EXPECT_EQ(m_sessions[2].m_cencSingleSampleDecrypter, nullptr);
+  EXPECT_EQ(m_sessions[3].m_cencSingleSampleDecrypter, nullptr);
+
+  // Without the init segment the PSSH cannot be found
+  m_period = PLAYLIST::CPeriod::MakeUniquePtr();
+  AddPsshSet("FILE", "", PSSHSet::MEDIA_VIDEO);
+  for (CCdmSession& session : m_sessions)
+  {
+    if (!session.m_sharedCencSsd)
+      m_decrypter.DestroySingleSampleDecrypter(session.m_cencSingleSampleDecrypter);
+  }
+  m_sessions.clear();
+  EXPECT_FALSE(CreateSessions(false));
+  EXPECT_EQ(m_initSegmentRequests, 1);
+}
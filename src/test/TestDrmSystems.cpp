@@ -0,0 +1,204 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../common/DrmSystems.h"
+#include "../common/KeySystemHandlers.h"
+#include "../utils/Base64Utils.h"
+#include "../utils/PropertiesUtils.h"
+
+#include <gtest/gtest.h>
+
+using namespace DRM;
+
+TEST(DrmSystemsTest, ResolveKeySystem)
+{
+  const KeySystemInfo* info{ResolveKeySystem("urn:uuid:edef8ba9-79d6-4ace-a3c8-27dcd51d21ed")};
+  ASSERT_NE(info, nullptr);
+  EXPECT_EQ(info->m_keySystem, KeySystem::WIDEVINE);
+  EXPECT_EQ(info->m_name, "com.widevine.alpha");
+
+  // Smooth Streaming SystemID
+  EXPECT_EQ(ResolveKeySystem("9A04F079-9840-4286-AB92-E65BE0885F95"),
+            GetKeySystem(KeySystem::PLAYREADY));
+  EXPECT_EQ(ResolveKeySystem("{9A04F079-9840-4286-AB92-E65BE0885F95}"),
+            GetKeySystem(KeySystem::PLAYREADY));
+  // HLS KEYFORMAT
+  EXPECT_EQ(ResolveKeySystem("com.microsoft.playready"), GetKeySystem(KeySystem::PLAYREADY));
+  // ClearKey, DASH-IF and W3C common PSSH system ids
+  EXPECT_TRUE(IsKeySystem("urn:uuid:e2719d58-a985-b3c9-781a-b030af78d30e", KeySystem::CLEARKEY));
+  EXPECT_TRUE(IsKeySystem("urn:uuid:1077efec-c0b2-4d02-ace3-3c1e52e2fb4b", KeySystem::CLEARKEY));
+
+  const uint8_t systemId[16]{0x3d, 0x5e, 0x6d, 0x35, 0x9b, 0x9a, 0x41, 0xe8,
+                             0xb8, 0x43, 0xdd, 0x3c, 0x6e, 0x72, 0xc4, 0x2c};
+  EXPECT_EQ(ResolveKeySystem(systemId), GetKeySystem(KeySystem::WISEPLAY));
+
+  EXPECT_EQ(ResolveKeySystem(""), nullptr);
+  EXPECT_EQ(ResolveKeySystem("com.apple.streamingkeydelivery"), nullptr);
+  EXPECT_EQ(ResolveKeySystem("urn:mpeg:dash:mp4protection:2011"), nullptr);
+  EXPECT_EQ(GetKeySystem(KeySystem::NONE), nullptr);
+}
+
+TEST(DrmSystemsTest, IsSameKeySystem)
+{
+  const std::string supportedUrn{GetUrn(KeySystem::WIDEVINE)};
+  EXPECT_EQ(supportedUrn, "urn:uuid:EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED");
+
+  EXPECT_TRUE(IsSameKeySystem("urn:uuid:edef8ba9-79d6-4ace-a3c8-27dcd51d21ed", supportedUrn));
+  EXPECT_TRUE(IsSameKeySystem("com.widevine.alpha", supportedUrn));
+  EXPECT_FALSE(IsSameKeySystem("com.microsoft.playready", supportedUrn));
+  EXPECT_FALSE(IsSameKeySystem("urn:mpeg:dash:mp4protection:2011", supportedUrn));
+  EXPECT_FALSE(IsSameKeySystem("", supportedUrn));
+  EXPECT_FALSE(IsSameKeySystem("urn:uuid:edef8ba9-79d6-4ace-a3c8-27dcd51d21ed", ""));
+  // Unknown key systems are compared as URN
+  EXPECT_TRUE(IsSameKeySystem("urn:uuid:00000000-0000-0000-0000-000000000001",
+                              "URN:UUID:00000000-0000-0000-0000-000000000001"));
+}
+
+TEST(DrmSystemsTest, ParseSystemId)
+{
+  uint8_t systemId[16]{};
+  ASSERT_TRUE(ParseSystemId("urn:uuid:EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED", systemId));
+  EXPECT_EQ(systemId[0], 0xED);
+  EXPECT_EQ(systemId[15], 0xED);
+  EXPECT_TRUE(ParseSystemId("edef8ba979d64acea3c827dcd51d21ed", systemId));
+
+  EXPECT_FALSE(ParseSystemId("urn:uuid:EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21", systemId));
+  EXPECT_FALSE(ParseSystemId("urn:uuid:EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED00", systemId));
+  EXPECT_FALSE(ParseSystemId("urn:uuid:XDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED", systemId));
+  EXPECT_FALSE(ParseSystemId("", systemId));
+}
+
+TEST(KeySystemHandlersTest, GetHandler)
+{
+  const IKeySystemHandler* handler{GetHandler("urn:uuid:9a04f079-9840-4286-ab92-e65be0885f95")};
+  ASSERT_NE(handler, nullptr);
+  EXPECT_EQ(handler->GetKeySystem(), KeySystem::PLAYREADY);
+  EXPECT_EQ(handler->GetInfo().m_name, "com.microsoft.playready");
+  EXPECT_EQ(GetHandler("com.widevine.alpha"), GetHandler(KeySystem::WIDEVINE));
+  EXPECT_EQ(GetHandler("urn:uuid:1077efec-c0b2-4d02-ace3-3c1e52e2fb4b"),
+            GetHandler(KeySystem::CLEARKEY));
+
+  EXPECT_EQ(GetHandler(KeySystem::NONE), nullptr);
+  EXPECT_EQ(GetHandler("com.apple.streamingkeydelivery"), nullptr);
+}
+
+TEST(KeySystemHandlersTest, SelectKeySystem)
+{
+  const std::vector<std::string> supported{"urn:uuid:9A04F079-9840-4286-AB92-E65BE0885F95",
+                                           "urn:uuid:EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED"};
+
+  // The cheapest supported key system, whatever the manifest order
+  EXPECT_EQ(SelectKeySystem({"urn:mpeg:dash:mp4protection:2011",
+                             "urn:uuid:9a04f079-9840-4286-ab92-e65be0885f95",
+                             "urn:uuid:edef8ba9-79d6-4ace-a3c8-27dcd51d21ed"},
+                            supported),
+            "urn:uuid:edef8ba9-79d6-4ace-a3c8-27dcd51d21ed");
+  // A cheaper key system not supported by the decrypter is not selected
+  EXPECT_EQ(SelectKeySystem({"org.w3.clearkey", "com.microsoft.playready"}, supported),
+            "com.microsoft.playready");
+  // On same key system the first one offered is used
+  EXPECT_EQ(SelectKeySystem({"com.widevine.alpha", "urn:uuid:edef8ba9-79d6-4ace-a3c8-27dcd51d21ed"},
+                            supported),
+            "com.widevine.alpha");
+
+  EXPECT_EQ(SelectKeySystem({"com.apple.streamingkeydelivery"}, supported), "");
+  EXPECT_EQ(SelectKeySystem({}, supported), "");
+  EXPECT_EQ(SelectKeySystem({"com.widevine.alpha"}, {}), "");
+
+  // The key systems unknown to the registry are the most expensive ones
+  const std::string unknownUrn{"urn:uuid:00000000-0000-0000-0000-000000000001"};
+  EXPECT_EQ(SelectKeySystem({unknownUrn, "com.microsoft.playready"},
+                            {unknownUrn, "com.microsoft.playready"}),
+            "com.microsoft.playready");
+  EXPECT_EQ(SelectKeySystem({unknownUrn}, {unknownUrn}), unknownUrn);
+}
+
+TEST(KeySystemHandlersTest, SortKeySystems)
+{
+  std::vector<std::string> keySystems{"urn:uuid:00000000-0000-0000-0000-000000000001",
+                                      GetUrn(KeySystem::PLAYREADY), GetUrn(KeySystem::WISEPLAY),
+                                      GetUrn(KeySystem::WIDEVINE), GetUrn(KeySystem::CLEARKEY)};
+  SortKeySystems(keySystems);
+
+  EXPECT_EQ(keySystems[0], GetUrn(KeySystem::CLEARKEY));
+  EXPECT_EQ(keySystems[1], GetUrn(KeySystem::WIDEVINE));
+  EXPECT_EQ(keySystems[2], GetUrn(KeySystem::WISEPLAY));
+  EXPECT_EQ(keySystems[3], GetUrn(KeySystem::PLAYREADY));
+  EXPECT_EQ(keySystems[4], "urn:uuid:00000000-0000-0000-0000-000000000001");
+}
+
+TEST(KeySystemHandlersTest, LicenseRequestTemplate)
+{
+  EXPECT_EQ(GetHandler(KeySystem::WIDEVINE)->GetLicenseRequestTemplate("https://foo.bar/wv"),
+            "https://foo.bar/wv|Content-Type=application%2Foctet-stream|R{SSM}|");
+  EXPECT_EQ(GetHandler(KeySystem::PLAYREADY)->GetLicenseRequestTemplate("https://foo.bar/pr"),
+            "https://foo.bar/pr|Content-Type=text%2Fxml&SOAPAction=http%3A%2F%2Fschemas."
+            "microsoft.com%2FDRM%2F2007%2F03%2Fprotocols%2FAcquireLicense|R{SSM}|");
+  EXPECT_EQ(GetHandler(KeySystem::CLEARKEY)->GetLicenseRequestTemplate("https://foo.bar/ck"),
+            "https://foo.bar/ck|Content-Type=application%2Fjson|R{SSM}|");
+
+  // The templates are kept as is
+  const IKeySystemHandler* handler{GetHandler(KeySystem::WIDEVINE)};
+  EXPECT_EQ(handler->GetLicenseRequestTemplate("https://foo.bar/wv||R{SSM}|"),
+            "https://foo.bar/wv||R{SSM}|");
+  EXPECT_EQ(handler->GetLicenseRequestTemplate(""), "");
+}
+
+TEST(KeySystemHandlersTest, GetDefaultKid)
+{
+  const std::string kid(16, '\x01');
+  // Widevine PSSH v0, the KID is in the "key_id" field of the PSSH data
+  const std::string wvPssh{UTILS::BASE64::Decode(
+      "AAAANHBzc2gAAAAA7e+LqXnWSs6jyCfc1R0h7QAAABQIARIQAQEBAQEBAQEBAQEBAQEBAQ==")};
+  EXPECT_EQ(GetHandler(KeySystem::WIDEVINE)->GetDefaultKid(wvPssh), kid);
+  EXPECT_EQ(GetHandler(KeySystem::PLAYREADY)->GetDefaultKid(wvPssh), "");
+
+  // PSSH v1, the KIDs are in the box
+  std::string psshV1{"\x00\x00\x00\x34pssh\x01\x00\x00\x00", 12};
+  psshV1 += std::string(16, '\x10'); // System id
+  psshV1 += std::string{"\x00\x00\x00\x01", 4} + kid;
+  psshV1 += std::string(4, '\x00'); // Data size
+  EXPECT_EQ(GetHandler(KeySystem::CLEARKEY)->GetDefaultKid(psshV1), kid);
+  EXPECT_EQ(GetHandler(KeySystem::WIDEVINE)->GetDefaultKid(psshV1), kid);
+
+  // Truncated box
+  EXPECT_EQ(GetHandler(KeySystem::CLEARKEY)->GetDefaultKid(psshV1.substr(0, 40)), "");
+  EXPECT_EQ(GetHandler(KeySystem::WIDEVINE)->GetDefaultKid(wvPssh.substr(0, 50)), "");
+}
+
+TEST(KeySystemHandlersTest, GetInitData)
+{
+  UTILS::PROPERTIES::KodiProperties kodiProps;
+  PLAYLIST::CPeriod::PSSHSet psshSet;
+  psshSet.pssh_ = UTILS::BASE64::Encode("PSSH");
+  psshSet.defaultKID_ = std::string(16, '\x01');
+
+  std::vector<uint8_t> initData;
+  const char* optionalKeyParameter{nullptr};
+  ASSERT_TRUE(GetHandler(KeySystem::WIDEVINE)
+                  ->GetInitData(psshSet, kodiProps, initData, optionalKeyParameter));
+  EXPECT_EQ(std::string(initData.begin(), initData.end()), "PSSH");
+  EXPECT_EQ(optionalKeyParameter, nullptr);
+
+  // Smooth Streaming, the PlayReady ProtectionHeader is provided as is
+  kodiProps.m_manifestType = UTILS::PROPERTIES::ManifestType::ISM;
+  kodiProps.m_licenseData = "custom";
+  psshSet.pssh_ = "HEADER";
+  ASSERT_TRUE(GetHandler(KeySystem::PLAYREADY)
+                  ->GetInitData(psshSet, kodiProps, initData, optionalKeyParameter));
+  EXPECT_EQ(std::string(initData.begin(), initData.end()), "HEADER");
+  EXPECT_STREQ(optionalKeyParameter, "custom");
+
+  // Smooth Streaming with Widevine, the init data are built from the default KID
+  kodiProps.m_licenseData.clear();
+  ASSERT_TRUE(GetHandler(KeySystem::WIDEVINE)
+                  ->GetInitData(psshSet, kodiProps, initData, optionalKeyParameter));
+  EXPECT_NE(std::string(initData.begin(), initData.end()), "HEADER");
+  EXPECT_FALSE(initData.empty());
+  EXPECT_EQ(optionalKeyParameter, nullptr);
+}
@@ -8,8 +8,13 @@
 
 #include "TestHelper.h"
 
+#include "../common/DrmSystems.h"
 #include "../utils/PropertiesUtils.h"
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
 #include <gtest/gtest.h>
 
 
@@ -25,12 +30,13 @@ protected:
 
     tree = new HLSTestTree(m_reprChooser);
     tree->Configure(kodiProps);
-    tree->m_supportedKeySystem = "urn:uuid:EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED";
+    tree->m_supportedKeySystems = {"urn:uuid:EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED"};
   }
 
   void TearDown() override
   {
     testHelper::effectiveUrl.clear();
+    testHelper::steeringServer = nullptr;
     delete tree;
     tree = nullptr;
     delete m_reprChooser;
@@ -252,6 +258,25 @@ TEST_F(HLSTreeTest, ParseKeyUriRelative)
   EXPECT_EQ(pssh_url, "https://foo.bar/hls/key/key.php?stream=stream_name");
 }
 
+TEST_F(HLSTreeTest, ParseSampleAesIdentityKey)
+{
+  OpenTestFileMaster("hls/1v_master.m3u8", "https://foo.bar/master.m3u8");
+
+  PLAYLIST::PrepareRepStatus res = OpenTestFileVariant(
+      "hls/ts_sampleaes_stream_0.m3u8", "https://foo.bar/stream_0.m3u8", tree->m_currentPeriod,
+      tree->m_currentAdpSet, tree->m_currentRepr);
+
+  EXPECT_EQ(res, PLAYLIST::PrepareRepStatus::OK);
+  EXPECT_EQ(tree->m_currentPeriod->GetEncryptionState(), PLAYLIST::EncryptionState::UNENCRYPTED);
+
+  auto& psshSets = tree->m_currentPeriod->GetPSSHSets();
+  ASSERT_EQ(psshSets.size(), 3);
+  EXPECT_EQ(tree->BuildDownloadUrl(psshSets[1].pssh_), "https://foo.bar/key.bin");
+  // Only the samples are encrypted, the segments are not decrypted on download
+  EXPECT_EQ(psshSets[1].m_cryptoMode, CryptoMode::AES_CBC);
+  EXPECT_EQ(psshSets[2].m_cryptoMode, CryptoMode::NONE);
+}
+
 TEST_F(HLSTreeTest, ParseKeyUriRelativeFromRedirect)
 {
   testHelper::effectiveUrl = "https://foo.bar/hls/video/stream_name/master.m3u8";
@@ -302,3 +327,269 @@ TEST_F(HLSTreeTest, PtsSetInMultiPeriod)
   EXPECT_EQ(res, PLAYLIST::PrepareRepStatus::OK);
   EXPECT_EQ(pts, 0);
 }
+
+TEST_F(HLSTreeTest, MultipleKeyFormatsSelectSupported)
+{
+  OpenTestFileMaster("hls/1v_master.m3u8", "https://foo.bar/master.m3u8");
+
+  PLAYLIST::PrepareRepStatus res = OpenTestFileVariant(
+      "hls/fmp4_multidrm_v_stream_1.m3u8", "https://foo.bar/stream_1.m3u8",
+      tree->m_currentPeriod, tree->m_currentAdpSet, tree->m_currentRepr);
+
+  EXPECT_EQ(res, PLAYLIST::PrepareRepStatus::DRMCHANGED);
+  ASSERT_EQ(tree->m_currentPeriod->GetPSSHSets().size(), 2);
+  auto& psshSet = tree->m_currentPeriod->GetPSSHSets()[1];
+  EXPECT_EQ(psshSet.pssh_,
+            "AAAANHBzc2gAAAAA7e+LqXnWSs6jyCfc1R0h7QAAABQIARIQAQEBAQEBAQEBAQEBAQEBAQ==");
+  EXPECT_EQ(psshSet.defaultKID_, std::string(16, '\x01'));
+}
+
+TEST_F(HLSTreeTest, MultipleKeyFormatsSelectCheapest)
+{
+  tree->m_supportedKeySystems = {"urn:uuid:9A04F079-9840-4286-AB92-E65BE0885F95",
+                                 "urn:uuid:EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED"};
+  OpenTestFileMaster("hls/1v_master.m3u8", "https://foo.bar/master.m3u8");
+
+  PLAYLIST::PrepareRepStatus res = OpenTestFileVariant(
+      "hls/fmp4_multidrm_v_stream_1.m3u8", "https://foo.bar/stream_1.m3u8",
+      tree->m_currentPeriod, tree->m_currentAdpSet, tree->m_currentRepr);
+
+  EXPECT_EQ(res, PLAYLIST::PrepareRepStatus::DRMCHANGED);
+  // The PlayReady key is replaced by the cheaper Widevine one that follow
+  ASSERT_EQ(tree->m_currentPeriod->GetPSSHSets().size(), 2);
+  EXPECT_EQ(tree->m_currentRepr->GetPsshSetPos(), 1);
+  auto& psshSet = tree->m_currentPeriod->GetPSSHSets()[1];
+  EXPECT_TRUE(DRM::IsKeySystem(psshSet.m_keySystem, DRM::KeySystem::WIDEVINE));
+  EXPECT_EQ(psshSet.pssh_,
+            "AAAANHBzc2gAAAAA7e+LqXnWSs6jyCfc1R0h7QAAABQIARIQAQEBAQEBAQEBAQEBAQEBAQ==");
+  EXPECT_EQ(psshSet.defaultKID_, std::string(16, '\x01'));
+  EXPECT_EQ(psshSet.m_usageCount, 1);
+}
+
+TEST_F(HLSTreeTest, KeyFormatNotSupported)
+{
+  OpenTestFileMaster("hls/1v_master.m3u8", "https://foo.bar/master.m3u8");
+
+  PLAYLIST::PrepareRepStatus res = OpenTestFileVariant(
+      "hls/fmp4_fairplay_v_stream_1.m3u8", "https://foo.bar/stream_1.m3u8",
+      tree->m_currentPeriod, tree->m_currentAdpSet, tree->m_currentRepr);
+
+  EXPECT_EQ(res, PLAYLIST::PrepareRepStatus::FAILURE);
+}
+
+TEST_F(HLSTreeTest, ParseAdMarkers)
+{
+  OpenTestFileMaster("hls/1v_master.m3u8", "https://foo.bar/master.m3u8");
+
+  PLAYLIST::PrepareRepStatus res = OpenTestFileVariant(
+      "hls/ts_ad_markers_stream_0.m3u8", "https://foo.bar/stream_0.m3u8",
+      tree->m_currentPeriod, tree->m_currentAdpSet, tree->m_currentRepr);
+
+  EXPECT_EQ(res, PLAYLIST::PrepareRepStatus::OK);
+
+  const std::vector<adaptive::TimedEvent> events = tree->GetTimedEvents().GetEvents();
+  ASSERT_EQ(events.size(), 3);
+
+  EXPECT_EQ(events[0].m_schemeIdUri, "#EXT-X-DATERANGE");
+  EXPECT_EQ(events[0].m_id, "ad-1");
+  EXPECT_EQ(events[0].m_value, "com.example.ad");
+  EXPECT_EQ(events[0].m_type, adaptive::TimedEventType::AD_START);
+  EXPECT_TRUE(events[0].m_isManifestTime);
+  // Placed from the program date time
+  EXPECT_EQ(events[0].m_time, 15500000);
+  EXPECT_FALSE(events[0].m_messageData.empty());
+
+  EXPECT_EQ(events[1].m_schemeIdUri, "#EXT-X-CUE-OUT");
+  EXPECT_EQ(events[1].m_id, "102");
+  EXPECT_EQ(events[1].m_type, adaptive::TimedEventType::AD_START);
+  EXPECT_EQ(events[1].m_time, 20000000);
+  EXPECT_EQ(events[1].m_duration, 20000000);
+
+  EXPECT_EQ(events[2].m_schemeIdUri, "#EXT-X-CUE-IN");
+  EXPECT_EQ(events[2].m_id, "104");
+  EXPECT_EQ(events[2].m_type, adaptive::TimedEventType::AD_END);
+  EXPECT_EQ(events[2].m_time, 40000000);
+}
+
+TEST_F(HLSTreeTest, ParseGapSegments)
+{
+  OpenTestFileMaster("hls/1v_master.m3u8", "https://foo.bar/master.m3u8");
+
+  PLAYLIST::PrepareRepStatus res = OpenTestFileVariant(
+      "hls/ts_gap_stream_0.m3u8", "https://foo.bar/stream_0.m3u8",
+      tree->m_currentPeriod, tree->m_currentAdpSet, tree->m_currentRepr);
+
+  EXPECT_EQ(res, PLAYLIST::PrepareRepStatus::OK);
+
+  auto& segments = tree->m_currentRepr->SegmentTimeline();
+  ASSERT_EQ(segments.GetSize(), 5);
+  EXPECT_FALSE(segments.Get(0)->m_isGap);
+  EXPECT_TRUE(segments.Get(1)->m_isGap);
+  EXPECT_FALSE(segments.Get(2)->m_isGap);
+  EXPECT_TRUE(segments.Get(3)->m_isGap);
+  EXPECT_FALSE(segments.Get(4)->m_isGap);
+}
+
+TEST_F(HLSTreeTest, ContentSteeringPathways)
+{
+  CSteeringServerStub server{"https://steering.foo.bar/"};
+  server.SetManifest(R"({"VERSION":1,"TTL":300,"PATHWAY-PRIORITY":["CDN-B","CDN-A"]})");
+  testHelper::steeringServer = &server;
+
+  OpenTestFileMaster("hls/content_steering_master.m3u8", "https://cdn-a.foo.bar/live/master.m3u8");
+  tree->PostOpen(UTILS::PROPERTIES::KodiProperties{});
+
+  // Only the variants and the renditions of the default pathway are added
+  auto& adpSets = tree->m_periods[0]->GetAdaptationSets();
+  ASSERT_EQ(adpSets.size(), 2);
+  EXPECT_EQ(adpSets[0]->GetRepresentations().size(), 2);
+  EXPECT_EQ(adpSets[1]->GetRepresentations()[0]->GetSourceUrl(),
+            "https://cdn-a.foo.bar/live/audio/out.m3u8");
+  EXPECT_EQ(tree->GetContentSteering().GetDefaultPathway(), "CDN-A");
+
+  // The steering manifest is downloaded by the manifest update thread
+  ASSERT_TRUE(WaitFor([this] { return tree->GetContentSteering().GetPathway() == "CDN-B"; }));
+  ASSERT_EQ(server.GetRequestCount(), 1);
+  EXPECT_EQ(CSteeringServerStub::GetParameter(server.GetRequests()[0], "_HLS_pathway"), "CDN-A");
+  EXPECT_EQ(tree->GetContentSteering().GetPathway(), "CDN-B");
+
+  EXPECT_EQ(tree->BuildDownloadUrl("https://cdn-a.foo.bar/live/stream_1/out.m3u8"),
+            "https://cdn-b.foo.bar/content/live/stream_1/out.m3u8");
+  EXPECT_EQ(tree->BuildDownloadUrl("https://cdn-a.foo.bar/live/audio/out.m3u8"),
+            "https://cdn-b.foo.bar/content/live/audio/out.m3u8");
+
+  // The manifest is not reloaded before the TTL
+  tree->UpdateContentSteering();
+  EXPECT_EQ(server.GetRequestCount(), 1);
+}
+
+TEST_F(HLSTreeTest, ThumbnailTracks)
+{
+  OpenTestFileMaster("hls/thumbnails_master.m3u8", "https://foo.bar/hls/master.m3u8");
+
+  auto& tracks = tree->m_periods[0]->GetThumbnailTracks();
+  ASSERT_EQ(tracks.size(), 2);
+  EXPECT_EQ(tracks[0]->GetSourceUrl(), "https://foo.bar/hls/thumbs/320.m3u8");
+  EXPECT_EQ(tracks[0]->GetThumbnailWidth(), 320);
+  EXPECT_EQ(tracks[1]->GetThumbnailWidth(), 160);
+  EXPECT_FALSE(tracks[0]->IsPrepared());
+
+  // The image playlist is downloaded on first use
+  SetFileName(testHelper::testFile, "hls/thumbnails_images_320.m3u8");
+  PLAYLIST::ThumbnailTile tile;
+  ASSERT_TRUE(tree->GetThumbnailTile(45000, 0, tile));
+
+  EXPECT_TRUE(tracks[0]->IsPrepared());
+  EXPECT_EQ(tracks[0]->GetImageCount(), 2);
+  EXPECT_EQ(tracks[0]->GetColumns(), 4);
+  EXPECT_EQ(tracks[0]->GetRows(), 5);
+
+  EXPECT_EQ(tile.m_url, "https://foo.bar/hls/thumbs/tile_2.jpg");
+  EXPECT_EQ(tile.m_startMs, 44000);
+  EXPECT_EQ(tile.m_durationMs, 2000);
+  EXPECT_EQ(tile.m_x, 640);
+  EXPECT_EQ(tile.m_y, 0);
+  EXPECT_EQ(tile.m_width, 320);
+  EXPECT_EQ(tile.m_height, 180);
+}
+
+TEST_F(HLSTreeTest, ClosedCaptionsMedia)
+{
+  OpenTestFileMaster("hls/closed_captions_master.m3u8", "https://foo.bar/hls/master.m3u8");
+
+  // The closed captions are not streams, they are carried in the video stream
+  auto& adpSets = tree->m_periods[0]->GetAdaptationSets();
+  ASSERT_FALSE(adpSets.empty());
+  EXPECT_EQ(adpSets[0]->GetStreamType(), PLAYLIST::StreamType::VIDEO);
+
+  // The unsupported INSTREAM-ID is skipped
+  auto& closedCaptions = adpSets[0]->GetClosedCaptions();
+  ASSERT_EQ(closedCaptions.size(), 2);
+  EXPECT_EQ(closedCaptions[0].m_instreamId, "CC1");
+  EXPECT_EQ(closedCaptions[0].m_language, "en");
+  EXPECT_EQ(closedCaptions[0].m_name, "English");
+  EXPECT_TRUE(closedCaptions[0].m_isDefault);
+  EXPECT_EQ(closedCaptions[1].m_instreamId, "SERVICE2");
+  EXPECT_FALSE(closedCaptions[1].m_isDefault);
+}
+
+TEST_F(HLSTreeTest, MuxedAudioRenditions)
+{
+  OpenTestFileMaster("hls/muxed_audio_master.m3u8", "https://foo.bar/hls/master.m3u8");
+
+  auto& adpSets = tree->m_periods[0]->GetAdaptationSets();
+  auto getRepr = [&adpSets](std::string_view language) -> PLAYLIST::CRepresentation*
+  {
+    for (auto& adpSet : adpSets)
+    {
+      if (adpSet->GetStreamType() == PLAYLIST::StreamType::AUDIO &&
+          adpSet->GetLanguage() == language)
+        return adpSet->GetRepresentations()[0].get();
+    }
+    return nullptr;
+  };
+
+  // The renditions without URI or with the variant playlist are demuxed from
+  // the variant stream download, each one from its own elementary stream
+  PLAYLIST::CRepresentation* reprEn = getRepr("en");
+  ASSERT_NE(reprEn, nullptr);
+  EXPECT_TRUE(reprEn->IsIncludedStream());
+  EXPECT_EQ(reprEn->GetIncludedStreamIndex(), 0);
+
+  PLAYLIST::CRepresentation* reprDe = getRepr("de");
+  ASSERT_NE(reprDe, nullptr);
+  EXPECT_TRUE(reprDe->IsIncludedStream());
+  EXPECT_TRUE(reprDe->GetSourceUrl().empty());
+  EXPECT_EQ(reprDe->GetIncludedStreamIndex(), 1);
+
+  // An alternate rendition with its own playlist is downloaded separately
+  PLAYLIST::CRepresentation* reprFr = getRepr("fr");
+  ASSERT_NE(reprFr, nullptr);
+  EXPECT_FALSE(reprFr->IsIncludedStream());
+  EXPECT_EQ(reprFr->GetSourceUrl(), "https://foo.bar/hls/audio/fr.m3u8");
+
+  // The audio only variant that reuse the rendition playlist does not make it muxed
+  EXPECT_EQ(reprEn->GetIncludedStreamCount(), 2);
+  EXPECT_EQ(reprDe->GetIncludedStreamCount(), 2);
+}
+
+TEST_F(HLSTreeTest, MuxedAudioSingleFetch)
+{
+  OpenTestFileMaster("hls/muxed_audio_master.m3u8", "https://foo.bar/hls/master.m3u8");
+
+  PLAYLIST::CAdaptationSet* adp = tree->m_currentAdpSet;
+  PLAYLIST::CRepresentation* repr = tree->m_currentRepr;
+  ASSERT_EQ(repr->GetSourceUrl(), "https://foo.bar/hls/video/stream.m3u8");
+
+  auto respVariant = OpenTestFileVariant("hls/muxed_audio_stream.m3u8", "",
+                                         tree->m_periods[0].get(), adp, repr);
+  EXPECT_EQ(respVariant, PLAYLIST::PrepareRepStatus::OK);
+
+  UTILS::PROPERTIES::KodiProperties kodiProps;
+  testHelper::downloadList.clear();
+  auto stream = std::make_unique<TestAdaptiveStream>(*tree, adp, repr, kodiProps, false);
+  ASSERT_TRUE(stream->start_stream());
+
+  char buf[16];
+  for (size_t i = 0; i < 5; i++)
+  {
+    if (!stream->read(buf, sizeof(buf)))
+      break;
+    // prevent race condition leading to deadlock
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  stream->Stop();
+  stream->DisposeWorker();
+
+  // The included audio renditions are demuxed from the video segments,
+  // so each segment is downloaded once only
+  ASSERT_GE(testHelper::downloadList.size(), 5);
+  for (size_t i = 0; i < 5; i++)
+  {
+    const std::string url{"https://foo.bar/hls/video/segment_" + std::to_string(i) + ".ts"};
+    EXPECT_EQ(std::count(testHelper::downloadList.begin(), testHelper::downloadList.end(), url),
+              1);
+    EXPECT_EQ(tree->GetSegmentFetchCount(url), 1U);
+  }
+  testHelper::downloadList.clear();
+}
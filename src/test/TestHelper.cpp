@@ -8,9 +8,15 @@
 
 #include "TestHelper.h"
 
+#include <algorithm>
+#include <thread>
+
 std::string testHelper::testFile;
 std::string testHelper::effectiveUrl;
 std::vector<std::string> testHelper::downloadList;
+std::mutex testHelper::downloadListMutex;
+std::set<std::string> testHelper::missingUrls;
+CSteeringServerStub* testHelper::steeringServer{nullptr};
 
 std::string GetEnv(const std::string& var)
 {
@@ -26,9 +32,28 @@ void SetFileName(std::string& file, std::string name)
   file = GetEnv("DATADIR") + "/" + name;
 }
 
+bool testHelper::IsDownloaded(std::string_view urlPart)
+{
+  std::lock_guard<std::mutex> lock(downloadListMutex);
+  return std::any_of(downloadList.begin(), downloadList.end(), [urlPart](const std::string& url)
+                     { return url.find(urlPart) != std::string::npos; });
+}
+
+bool WaitFor(const std::function<bool()>& condition, std::chrono::milliseconds timeout)
+{
+  const auto endTime = std::chrono::steady_clock::now() + timeout;
+  while (!condition())
+  {
+    if (std::chrono::steady_clock::now() >= endTime)
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return true;
+}
+
 bool TestAdaptiveStream::DownloadSegment(const DownloadInfo& downloadInfo)
 {
-  if (downloadInfo.m_url.empty())
+  if (downloadInfo.m_url.empty() || testHelper::missingUrls.count(downloadInfo.m_url) > 0)
     return false;
 
   std::string& segmentBuffer = downloadInfo.m_segmentBuffer->buffer;
@@ -70,7 +95,10 @@ bool TestAdaptiveStream::DownloadSegment(const DownloadInfo& downloadInfo)
     return false;
   }
 
-  testHelper::downloadList.push_back(downloadInfo.m_url);
+  {
+    std::lock_guard<std::mutex> lock(testHelper::downloadListMutex);
+    testHelper::downloadList.push_back(downloadInfo.m_url);
+  }
 
   thread_data_->signal_rw_.notify_all();
   return true;
@@ -139,11 +167,29 @@ bool DownloadFile(std::string_view url,
   return true;
 }
 
+// Return true when the url is a steering server url, with the download result
+static bool DownloadSteeringManifest(std::string_view url,
+                                     std::string& data,
+                                     adaptive::HTTPRespHeaders& respHeaders,
+                                     bool& isDownloaded)
+{
+  if (!testHelper::steeringServer || !testHelper::steeringServer->IsServerUrl(url))
+    return false;
+
+  respHeaders.m_effectiveUrl = url;
+  isDownloaded = testHelper::steeringServer->HandleRequest(url, data);
+  return true;
+}
+
 bool DASHTestTree::Download(std::string_view url,
                             const std::map<std::string, std::string>& addHeaders,
                             std::string& data,
                             adaptive::HTTPRespHeaders& respHeaders)
 {
+  bool isDownloaded{false};
+  if (DownloadSteeringManifest(url, data, respHeaders, isDownloaded))
+    return isDownloaded;
+
   if (DownloadFile(url, addHeaders, data, respHeaders))
   {
     return true;
@@ -177,6 +223,10 @@ bool HLSTestTree::Download(std::string_view url,
                            std::string& data,
                            adaptive::HTTPRespHeaders& respHeaders)
 {
+  bool isDownloaded{false};
+  if (DownloadSteeringManifest(url, data, respHeaders, isDownloaded))
+    return isDownloaded;
+
   if (DownloadFile(url, addHeaders, data, respHeaders))
   {
     return true;
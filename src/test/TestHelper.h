@@ -17,7 +17,12 @@
 #include "../parser/SmoothTree.h"
 #include "../utils/log.h"
 #include "../utils/PropertiesUtils.h"
+#include "SteeringServerStub.h"
 
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <set>
 #include <string_view>
 
 // \brief Current version of gtest dont support compare std::string_view values
@@ -27,6 +32,10 @@ using STR = std::string;
 std::string GetEnv(const std::string& var);
 void SetFileName(std::string& file, const std::string name);
 
+// \brief Wait until the condition is true, to check the work of background threads
+bool WaitFor(const std::function<bool()>& condition,
+             std::chrono::milliseconds timeout = std::chrono::milliseconds(2000));
+
 static bool DownloadFile(std::string_view url,
                          const std::map<std::string, std::string>& reqHeaders,
                          std::stringstream& data,
@@ -38,6 +47,12 @@ public:
   static std::string testFile;
   static std::string effectiveUrl;
   static std::vector<std::string> downloadList;
+  static std::mutex downloadListMutex; // The segments are downloaded by the stream worker
+  static std::set<std::string> missingUrls; // Segment downloads that fails, as HTTP 404
+  static CSteeringServerStub* steeringServer; // Handle the steering manifest downloads
+
+  // \brief Check if an url that contains the text has been downloaded
+  static bool IsDownloaded(std::string_view urlPart);
 };
 
 class CTestRepresentationChooserDefault : public CHOOSER::CRepresentationChooserDefault
@@ -69,6 +84,7 @@ public:
     lastUpdated_ = tm;
   }
   virtual bool DownloadSegment(const DownloadInfo& downloadInfo) override;
+  size_t GetSegmentBuffersCount() const { return segment_buffers_.size(); }
 
 protected:
   virtual bool Download(const DownloadInfo& downloadInfo, std::string& data) override;
@@ -104,6 +120,7 @@ public:
   void SetNowTime(uint64_t time) { m_mockTime = time; }
   void SetLastUpdated(const std::chrono::system_clock::time_point tm) { lastUpdated_ = tm; }
   std::chrono::system_clock::time_point GetNowTimeChrono() { return m_mock_time_chrono; };
+  using CDashTree::RefreshLiveSegments;
 
 private:
   bool Download(std::string_view url,
@@ -0,0 +1,346 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../KeyRotation.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace SESSION;
+
+namespace
+{
+constexpr uint8_t SYSTEM_ID[16]{0xed, 0xef, 0x8b, 0xa9, 0x79, 0xd6, 0x4a, 0xce,
+                                0xa3, 0xc8, 0x27, 0xdc, 0xd5, 0x1d, 0x21, 0xed};
+
+const std::string KID_1(16, '\x01');
+const std::string KID_2(16, '\x02');
+const std::string KID_3(16, '\x03');
+
+class FakeSingleSampleDecrypter : public Adaptive_CencSingleSampleDecrypter
+{
+public:
+  explicit FakeSingleSampleDecrypter(std::string keyId) : m_keyId{std::move(keyId)} {}
+
+  AP4_Result SetFragmentInfo(AP4_UI32 pool_id,
+                             const AP4_UI08* key,
+                             const AP4_UI08 nal_length_size,
+                             AP4_DataBuffer& annexb_sps_pps,
+                             AP4_UI32 flags,
+                             CryptoInfo cryptoInfo) override
+  {
+    return AP4_SUCCESS;
+  }
+
+  AP4_Result DecryptSampleData(AP4_UI32 poolid,
+                               AP4_DataBuffer& data_in,
+                               AP4_DataBuffer& data_out,
+                               const AP4_UI08* iv,
+                               unsigned int subsample_count,
+                               const AP4_UI16* bytes_of_cleartext_data,
+                               const AP4_UI32* bytes_of_encrypted_data,
+                               const SampleKeyInfo* sampleKeyInfo) override
+  {
+    return AP4_SUCCESS;
+  }
+
+  bool AcquirePendingLicense() override
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    m_isLicensed = true;
+    return true;
+  }
+
+  std::string m_keyId;
+  std::atomic<bool> m_isLicensed{true};
+};
+
+// The license of the PSSH init data provide the key with the same value as KID
+class FakeDecrypter : public SSD::SSD_DECRYPTER
+{
+public:
+  const char* SelectKeySytem(const char* keySystem) override { return keySystem; }
+  bool OpenDRMSystem(const char* licenseURL,
+                     const AP4_DataBuffer& serverCertificate,
+                     const uint8_t config) override
+  {
+    return true;
+  }
+  Adaptive_CencSingleSampleDecrypter* CreateSingleSampleDecrypter(
+      AP4_DataBuffer& pssh,
+      const char* optionalKeyParameter,
+      std::string_view defaultkeyid,
+      bool skipSessionMessage,
+      CryptoMode cryptoMode) override
+  {
+    m_createCount++;
+    std::this_thread::sleep_for(m_licenseDelay);
+    return new FakeSingleSampleDecrypter(
+        {reinterpret_cast<const char*>(pssh.GetData()), pssh.GetDataSize()});
+  }
+  void DestroySingleSampleDecrypter(Adaptive_CencSingleSampleDecrypter* decrypter) override
+  {
+    m_destroyCount++;
+    delete decrypter;
+  }
+  void GetCapabilities(Adaptive_CencSingleSampleDecrypter* decrypter,
+                       const uint8_t* keyid,
+                       uint32_t media,
+                       SSD_DECRYPTER::SSD_CAPS& caps) override
+  {
+    caps = {SSD_DECRYPTER::SSD_CAPS::SSD_SUPPORTS_DECODING, 0, 0};
+    // As the CDM, the limits are known only once licensed
+    auto ssd = static_cast<FakeSingleSampleDecrypter*>(decrypter);
+    if (ssd && ssd->m_isLicensed && keyid && std::memcmp(ssd->m_keyId.data(), keyid, 16) == 0)
+      caps.hdcpLimit = 1920 * 1080;
+  }
+  bool HasLicenseKey(Adaptive_CencSingleSampleDecrypter* decrypter, const uint8_t* keyid) override
+  {
+    std::this_thread::sleep_for(m_keyLookupDelay);
+    auto ssd = static_cast<FakeSingleSampleDecrypter*>(decrypter);
+    return ssd && ssd->m_isLicensed && std::memcmp(ssd->m_keyId.data(), keyid, 16) == 0;
+  }
+  bool HasCdmSession() override { return true; }
+  std::string GetChallengeB64Data(Adaptive_CencSingleSampleDecrypter* decrypter) override
+  {
+    return "";
+  }
+  bool OpenVideoDecoder(Adaptive_CencSingleSampleDecrypter* decrypter,
+                        const SSD::SSD_VIDEOINITDATA* initData) override
+  {
+    return false;
+  }
+  SSD::SSD_DECODE_RETVAL DecryptAndDecodeVideo(void* hostInstance,
+                                               SSD::SSD_SAMPLE* sample) override
+  {
+    return SSD::VC_ERROR;
+  }
+  SSD::SSD_DECODE_RETVAL VideoFrameDataToPicture(void* hostInstance,
+                                                 SSD::SSD_PICTURE* picture) override
+  {
+    return SSD::VC_ERROR;
+  }
+  void ResetVideo() override {}
+
+  std::atomic<int> m_createCount{0};
+  std::atomic<int> m_destroyCount{0};
+  std::chrono::milliseconds m_licenseDelay{0};
+  std::chrono::milliseconds m_keyLookupDelay{0};
+};
+
+const uint8_t* ToKeyId(const std::string& keyId)
+{
+  return reinterpret_cast<const uint8_t*>(keyId.data());
+}
+} // unnamed namespace
+
+class KeyRotationTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_keyRotation = std::make_unique<CKeyRotation>(&m_decrypter, SYSTEM_ID, CryptoMode::AES_CTR);
+    m_keyRotation->AddDecrypter(&m_initialSsd, m_caps);
+  }
+
+  // As the readers, poll the key status until the license is no longer pending
+  CKeyRotation::KeyStatus WaitDecrypter(const std::string& keyId,
+                                        Adaptive_CencSingleSampleDecrypter*& ssd,
+                                        SSD::SSD_DECRYPTER::SSD_CAPS& caps)
+  {
+    const auto endTime = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    CKeyRotation::KeyStatus status;
+    while ((status = m_keyRotation->GetDecrypter(ToKeyId(keyId), ssd, caps)) ==
+               CKeyRotation::KeyStatus::PENDING &&
+           std::chrono::steady_clock::now() < endTime)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return status;
+  }
+
+  FakeDecrypter m_decrypter;
+  FakeSingleSampleDecrypter m_initialSsd{KID_1};
+  SSD::SSD_DECRYPTER::SSD_CAPS m_caps{SSD::SSD_DECRYPTER::SSD_CAPS::SSD_SUPPORTS_DECODING, 0, 0};
+  std::unique_ptr<CKeyRotation> m_keyRotation;
+};
+
+TEST_F(KeyRotationTest, InitialDecrypter)
+{
+  // Already added by a previous DRM initialization
+  EXPECT_FALSE(m_keyRotation->AddDecrypter(&m_initialSsd, m_caps));
+
+  Adaptive_CencSingleSampleDecrypter* ssd{nullptr};
+  SSD::SSD_DECRYPTER::SSD_CAPS caps{};
+  EXPECT_EQ(m_keyRotation->GetDecrypter(ToKeyId(KID_1), ssd, caps),
+            CKeyRotation::KeyStatus::AVAILABLE);
+  EXPECT_EQ(ssd, &m_initialSsd);
+  // Nothing pending
+  EXPECT_EQ(m_keyRotation->GetDecrypter(ToKeyId(KID_2), ssd, caps),
+            CKeyRotation::KeyStatus::NOT_AVAILABLE);
+  EXPECT_FALSE(m_keyRotation->IsKeyPending(ToKeyId(KID_2)));
+
+  // The PSSH list only licensed keys
+  m_keyRotation->AcquireLicense(KID_2, {KID_1}, SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_VIDEO);
+  m_keyRotation.reset();
+  EXPECT_EQ(m_decrypter.m_createCount, 0);
+}
+
+TEST_F(KeyRotationTest, AcquireAheadOfUse)
+{
+  m_decrypter.m_licenseDelay = std::chrono::milliseconds(50);
+  m_keyRotation->AcquireLicense(KID_2, {}, SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_VIDEO);
+  // Same PSSH found on other fragments or by other streams
+  m_keyRotation->AcquireLicense(KID_2, {}, SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_AUDIO);
+  m_keyRotation->AcquireLicense(KID_3, {KID_3}, SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_VIDEO);
+
+  Adaptive_CencSingleSampleDecrypter* ssd{nullptr};
+  SSD::SSD_DECRYPTER::SSD_CAPS caps{};
+  ASSERT_EQ(WaitDecrypter(KID_3, ssd, caps), CKeyRotation::KeyStatus::AVAILABLE);
+  EXPECT_TRUE(m_keyRotation->HasKey(ssd, ToKeyId(KID_3)));
+  EXPECT_FALSE(m_keyRotation->HasKey(ssd, ToKeyId(KID_2)));
+  EXPECT_EQ(caps.flags, m_caps.flags);
+
+  ASSERT_EQ(m_keyRotation->GetDecrypter(ToKeyId(KID_2), ssd, caps),
+            CKeyRotation::KeyStatus::AVAILABLE);
+  EXPECT_EQ(m_decrypter.m_createCount, 2);
+
+  // Only the decrypters created by the key rotation are destroyed
+  m_keyRotation.reset();
+  EXPECT_EQ(m_decrypter.m_destroyCount, 2);
+}
+
+TEST_F(KeyRotationTest, Pending)
+{
+  m_decrypter.m_licenseDelay = std::chrono::milliseconds(500);
+  m_keyRotation->AcquireLicense(KID_2, {}, SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_VIDEO);
+
+  // The readers are not blocked while the license is acquired
+  Adaptive_CencSingleSampleDecrypter* ssd{nullptr};
+  SSD::SSD_DECRYPTER::SSD_CAPS caps{};
+  EXPECT_EQ(m_keyRotation->GetDecrypter(ToKeyId(KID_2), ssd, caps),
+            CKeyRotation::KeyStatus::PENDING);
+  EXPECT_EQ(ssd, nullptr);
+  EXPECT_TRUE(m_keyRotation->IsKeyPending(ToKeyId(KID_2)));
+  EXPECT_FALSE(m_keyRotation->IsKeyPending(ToKeyId(KID_1)));
+
+  // The destruction waits the acquisition in progress
+  const auto endTime = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (m_decrypter.m_createCount == 0 && std::chrono::steady_clock::now() < endTime)
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+  m_keyRotation.reset();
+  EXPECT_EQ(m_decrypter.m_createCount, 1);
+  EXPECT_EQ(m_decrypter.m_destroyCount, 1);
+}
+
+TEST_F(KeyRotationTest, EvictLeastRecentlyUsed)
+{
+  Adaptive_CencSingleSampleDecrypter* inUseSsd{nullptr};
+  Adaptive_CencSingleSampleDecrypter* ssd{nullptr};
+  SSD::SSD_DECRYPTER::SSD_CAPS caps{};
+
+  m_keyRotation->AcquireLicense(KID_2, {}, SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_VIDEO);
+  ASSERT_EQ(WaitDecrypter(KID_2, inUseSsd, caps), CKeyRotation::KeyStatus::AVAILABLE);
+
+  // A live stream that rotate the key on each period
+  std::vector<std::string> keyIds;
+  for (char kid{3}; kid < 8; ++kid)
+  {
+    keyIds.emplace_back(16, kid);
+    m_keyRotation->AcquireLicense(keyIds.back(), {}, SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_VIDEO);
+  }
+  ASSERT_EQ(WaitDecrypter(keyIds.back(), ssd, caps), CKeyRotation::KeyStatus::AVAILABLE);
+  m_keyRotation->ReleaseDecrypter(ssd);
+
+  // The two least recently used not in use have been released
+  EXPECT_EQ(m_keyRotation->GetDecrypter(ToKeyId(keyIds[0]), ssd, caps),
+            CKeyRotation::KeyStatus::NOT_AVAILABLE);
+  EXPECT_EQ(m_keyRotation->GetDecrypter(ToKeyId(keyIds[1]), ssd, caps),
+            CKeyRotation::KeyStatus::NOT_AVAILABLE);
+  ASSERT_EQ(m_keyRotation->GetDecrypter(ToKeyId(KID_2), ssd, caps),
+            CKeyRotation::KeyStatus::AVAILABLE);
+  EXPECT_EQ(ssd, inUseSsd);
+  m_keyRotation->ReleaseDecrypter(ssd);
+
+  // The license of a released key can be requested again
+  m_keyRotation->AcquireLicense(keyIds[0], {}, SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_VIDEO);
+  ASSERT_EQ(WaitDecrypter(keyIds[0], ssd, caps), CKeyRotation::KeyStatus::AVAILABLE);
+  m_keyRotation->ReleaseDecrypter(ssd);
+  EXPECT_EQ(m_keyRotation->GetDecrypter(ToKeyId(keyIds[2]), ssd, caps),
+            CKeyRotation::KeyStatus::NOT_AVAILABLE);
+  EXPECT_EQ(m_keyRotation->GetDecrypter(ToKeyId(KID_2), ssd, caps),
+            CKeyRotation::KeyStatus::AVAILABLE);
+
+  m_keyRotation.reset();
+  EXPECT_EQ(m_decrypter.m_createCount, 7);
+  EXPECT_EQ(m_decrypter.m_destroyCount, 7);
+}
+
+TEST_F(KeyRotationTest, DeferredLicense)
+{
+  FakeSingleSampleDecrypter deferredSsd{KID_2};
+  deferredSsd.m_isLicensed = false;
+  EXPECT_TRUE(m_keyRotation->AddDecrypter(&deferredSsd, m_caps));
+  m_keyRotation->AcquirePendingLicense(&deferredSsd, KID_2,
+                                       SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_VIDEO);
+
+  // While pending the decrypter is assumed to have the keys, no switch is needed
+  EXPECT_TRUE(m_keyRotation->HasKey(&deferredSsd, ToKeyId(KID_2)));
+  EXPECT_TRUE(m_keyRotation->HasKey(&deferredSsd, ToKeyId(KID_3)));
+  // A PSSH listing the pending key is not requested once the license is acquired
+  m_keyRotation->AcquireLicense(KID_3, {KID_2}, SSD::SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_VIDEO);
+
+  Adaptive_CencSingleSampleDecrypter* ssd{nullptr};
+  SSD::SSD_DECRYPTER::SSD_CAPS caps{};
+  ASSERT_EQ(WaitDecrypter(KID_2, ssd, caps), CKeyRotation::KeyStatus::AVAILABLE);
+  EXPECT_EQ(ssd, &deferredSsd);
+  EXPECT_TRUE(deferredSsd.m_isLicensed);
+  EXPECT_FALSE(m_keyRotation->HasKey(&deferredSsd, ToKeyId(KID_3)));
+
+  // The capabilities are queried again with the license
+  const auto endTime = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!m_keyRotation->TakeUpdatedCaps() && std::chrono::steady_clock::now() < endTime)
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+  ASSERT_TRUE(m_keyRotation->GetCaps(&deferredSsd, caps));
+  EXPECT_EQ(caps.hdcpLimit, 1920 * 1080);
+  EXPECT_FALSE(m_keyRotation->TakeUpdatedCaps());
+  // The capabilities of the other decrypters are unchanged
+  ASSERT_TRUE(m_keyRotation->GetCaps(&m_initialSsd, caps));
+  EXPECT_EQ(caps.hdcpLimit, 0);
+
+  m_keyRotation.reset();
+  EXPECT_EQ(m_decrypter.m_createCount, 0);
+}
+
+TEST_F(KeyRotationTest, SlowKeyLookup)
+{
+  m_decrypter.m_keyLookupDelay = std::chrono::milliseconds(500);
+
+  // The decrypter is queried without hold the lock, the other threads are not blocked
+  Adaptive_CencSingleSampleDecrypter* ssd{nullptr};
+  SSD::SSD_DECRYPTER::SSD_CAPS caps{};
+  std::thread reader([&] { m_keyRotation->GetDecrypter(ToKeyId(KID_1), ssd, caps); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  const auto startTime = std::chrono::steady_clock::now();
+  SSD::SSD_DECRYPTER::SSD_CAPS initialCaps{};
+  EXPECT_TRUE(m_keyRotation->GetCaps(&m_initialSsd, initialCaps));
+  EXPECT_LT(std::chrono::steady_clock::now() - startTime, std::chrono::milliseconds(250));
+
+  reader.join();
+  EXPECT_EQ(ssd, &m_initialSsd);
+}
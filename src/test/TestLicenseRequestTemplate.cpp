@@ -0,0 +1,227 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../../wvdecrypter/LicenseRequestTemplate.h"
+#include "../utils/Base64Utils.h"
+#include "../utils/StringUtils.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+using namespace UTILS;
+
+class LicenseRequestTemplateTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_data.m_challenge = m_challenge;
+    m_data.m_sessionId = m_sessionId;
+    m_data.m_defaultKeyId = m_keyId;
+    m_data.m_pssh = m_pssh;
+  }
+
+  // Simulate the license server response to the compiled template
+  bool Unwrap(std::string_view response, std::string& license)
+  {
+    std::string error;
+    return m_template.UnwrapResponse(response, license, m_hdcpLimit, error);
+  }
+
+  const std::string m_challenge{"\x08\x04\xff\x10", 4};
+  const std::string m_sessionId{"session1"};
+  const std::string m_keyId{"\x00\x11\x22\x33\x44\x55\x66\x77\x88\x99\xaa\xbb\xcc\xdd\xee\xff", 16};
+  const std::string m_pssh{"pssh\x01\x02", 6};
+  CLicenseRequestTemplate::RequestData m_data;
+  CLicenseRequestTemplate m_template;
+  int m_hdcpLimit{0};
+};
+
+TEST_F(LicenseRequestTemplateTest, WrongBlocks)
+{
+  EXPECT_FALSE(m_template.Compile("https://license.com/wv"));
+  EXPECT_FALSE(m_template.IsValid());
+  EXPECT_FALSE(m_template.GetError().empty());
+
+  EXPECT_FALSE(m_template.Compile("https://license.com/wv|a=b|R{SSM}|J|extra"));
+}
+
+TEST_F(LicenseRequestTemplateTest, UrlPlaceholders)
+{
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv?c=B{SSM}&h={HASH}||R{SSM}|"));
+  EXPECT_EQ(m_template.BuildUrl(m_data),
+            "https://license.com/wv?c=" + STRING::URLEncode(BASE64::Encode(m_challenge)) +
+                "&h=ba0a0039141056ffe74f3773a2ad3352");
+  EXPECT_TRUE(m_template.GetHeaders().empty());
+
+  EXPECT_FALSE(m_template.Compile("https://license.com/wv?c={SSM}||R{SSM}|"));
+  EXPECT_EQ(m_template.GetError(), "Unsupported License request template (command)");
+}
+
+TEST_F(LicenseRequestTemplateTest, Headers)
+{
+  ASSERT_TRUE(m_template.Compile(
+      "https://license.com/wv| Content-Type = application%2Fjson &X-Empty&=skipped&Token=a=b||"));
+
+  const auto& headers = m_template.GetHeaders();
+  ASSERT_EQ(headers.size(), 3);
+  EXPECT_EQ(headers[0].first, "Content-Type");
+  EXPECT_EQ(headers[0].second, "application/json");
+  EXPECT_EQ(headers[1].first, "X-Empty");
+  EXPECT_EQ(headers[1].second, "");
+  EXPECT_EQ(headers[2].first, "Token");
+  EXPECT_EQ(headers[2].second, "a");
+  EXPECT_FALSE(m_template.HasBody());
+}
+
+TEST_F(LicenseRequestTemplateTest, BodyWithoutPlaceholders)
+{
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||%7B%22a%22%3A1%7D|"));
+  EXPECT_TRUE(m_template.HasBody());
+  EXPECT_FALSE(m_template.HasBodyPlaceholders());
+  EXPECT_EQ(m_template.BuildBody(m_data), "{\"a\":1}");
+}
+
+TEST_F(LicenseRequestTemplateTest, BodyChallengeEncodings)
+{
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||R{SSM}|"));
+  EXPECT_EQ(m_template.BuildBody(m_data), m_challenge);
+
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||c=b{SSM}|"));
+  EXPECT_EQ(m_template.BuildBody(m_data), "c=" + BASE64::Encode(m_challenge));
+
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||c=B{SSM}|"));
+  EXPECT_EQ(m_template.BuildBody(m_data),
+            "c=" + STRING::URLEncode(BASE64::Encode(m_challenge)));
+
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||[D{SSM}]|"));
+  EXPECT_EQ(m_template.BuildBody(m_data), "[8,4,255,16]");
+
+  EXPECT_FALSE(m_template.Compile("https://license.com/wv||{SSM}|"));
+  EXPECT_EQ(m_template.GetError(), "Unsupported License request template (body / ?{SSM})");
+}
+
+TEST_F(LicenseRequestTemplateTest, BodySessionKeyIdPssh)
+{
+  ASSERT_TRUE(m_template.Compile(
+      "https://license.com/wv||{\"c\":\"b{SSM}\",\"s\":\"b{SID}\","
+      "\"u\":\"{KID}\",\"p\":\"B{PSSH}\"}|"));
+  EXPECT_TRUE(m_template.HasBodyPlaceholders());
+  EXPECT_EQ(m_template.BuildBody(m_data),
+            "{\"c\":\"" + BASE64::Encode(m_challenge) + "\",\"s\":\"" +
+                BASE64::Encode(m_sessionId) +
+                "\",\"u\":\"00112233-4455-6677-8899-aabbccddeeff\",\"p\":\"" +
+                STRING::URLEncode(BASE64::Encode(m_pssh)) + "\"}");
+
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||R{SSM}&sid=R{SID}&pssh=x{PSSH}|"));
+  EXPECT_EQ(m_template.BuildBody(m_data),
+            m_challenge + "&sid=" + m_sessionId + "&pssh=" + BASE64::Encode(m_pssh));
+
+  // Placeholders in sequence, the prefix of the second one belong to the first
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||R{SSM}H{KID}{PSSH}|"));
+  EXPECT_EQ(m_template.BuildBody(m_data),
+            m_challenge + "00112233445566778899aabbccddeeff" + BASE64::Encode(m_pssh));
+
+  EXPECT_FALSE(m_template.Compile("https://license.com/wv||{SID}R{SSM}|"));
+  EXPECT_EQ(m_template.GetError(), "Unsupported License request template (body / ?{SID})");
+}
+
+TEST_F(LicenseRequestTemplateTest, BodyFullEncoding)
+{
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||b{c=R{SSM}&s=R{SID}}|"));
+  EXPECT_EQ(m_template.BuildBody(m_data),
+            BASE64::Encode("c=" + m_challenge + "&s=" + m_sessionId));
+
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||B{c=R{SSM}}|"));
+  EXPECT_EQ(m_template.BuildBody(m_data),
+            STRING::URLEncode(BASE64::Encode("c=" + m_challenge)));
+}
+
+TEST_F(LicenseRequestTemplateTest, ResponseRawAndBase64)
+{
+  std::string license;
+
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||R{SSM}|"));
+  EXPECT_FALSE(m_template.HasResponseWrapper());
+
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||R{SSM}|B"));
+  EXPECT_TRUE(m_template.HasResponseWrapper());
+  ASSERT_TRUE(Unwrap(BASE64::Encode("license"), license));
+  EXPECT_EQ(license, "license");
+
+  EXPECT_FALSE(m_template.Compile("https://license.com/wv||R{SSM}|X"));
+  EXPECT_EQ(m_template.GetError(), "Unsupported License request template (response)");
+}
+
+TEST_F(LicenseRequestTemplateTest, ResponseHttpPayload)
+{
+  std::string license;
+
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||R{SSM}|HB"));
+  ASSERT_TRUE(Unwrap("HTTP/1.1 200 OK\r\nContent-Length: 7\r\n\r\nlicense", license));
+  EXPECT_EQ(license, "license");
+  EXPECT_FALSE(Unwrap("no payload", license));
+
+  EXPECT_FALSE(m_template.Compile("https://license.com/wv||R{SSM}|HJ"));
+  EXPECT_EQ(m_template.GetError(), "Unsupported HTTP payload data type definition");
+}
+
+TEST_F(LicenseRequestTemplateTest, ResponseJson)
+{
+  std::string license;
+
+  // Key at any depth, base64 value, HDCP limit
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||R{SSM}|JBlicense;hdcp"));
+  ASSERT_TRUE(Unwrap("{\"status\":\"OK\",\"data\":{\"hdcp\":2,\"license\":[\"" +
+                         BASE64::Encode("license") + "\"]}}",
+                     license));
+  EXPECT_EQ(license, "license");
+  EXPECT_EQ(m_hdcpLimit, 2);
+
+  // Whole response base64 encoded, raw value with escapes
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||R{SSM}|BJNlicense"));
+  ASSERT_TRUE(Unwrap(BASE64::Encode("{\"license\":\"a\\/b\\u0041\\n\"}"), license));
+  EXPECT_EQ(license, "a/bA\n");
+
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||R{SSM}|JNmissing"));
+  EXPECT_FALSE(Unwrap("{\"license\":\"data\"}", license));
+  EXPECT_FALSE(Unwrap("{\"license\":", license));
+}
+
+TEST_F(LicenseRequestTemplateTest, ResponseJsonPath)
+{
+  std::string license;
+  const std::string response{"{\"license\":\"wrong\",\"data\":{\"licenses\":[{\"license\":\"first\"},"
+                             "{\"license\":\"second\"}]}}"};
+
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||R{SSM}|JNdata/licenses/1/license"));
+  ASSERT_TRUE(Unwrap(response, license));
+  EXPECT_EQ(license, "second");
+
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||R{SSM}|JNdata/licenses/2/license"));
+  EXPECT_FALSE(Unwrap(response, license));
+}
+
+TEST_F(LicenseRequestTemplateTest, ResponseJsonLarge)
+{
+  // More values than the fixed token array used by the previous parser
+  std::string response{"{\"keys\":["};
+  for (int i{0}; i < 1000; ++i)
+    response += "{\"kid\":\"" + std::to_string(i) + "\",\"type\":\"CONTENT\"},";
+  response += "{}],\"license\":\"last\"}";
+
+  std::string license;
+  ASSERT_TRUE(m_template.Compile("https://license.com/wv||R{SSM}|JNlicense"));
+  ASSERT_TRUE(Unwrap(response, license));
+  EXPECT_EQ(license, "last");
+
+  // Too deep nesting is rejected
+  const std::string deep(100000, '[');
+  EXPECT_FALSE(Unwrap(deep, license));
+}
@@ -0,0 +1,125 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../../wvdecrypter/LicenseStore.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+#include <gtest/gtest.h>
+
+class LicenseStoreTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_path = std::filesystem::temp_directory_path() /
+             ("isa_license_store_" +
+              std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()));
+    std::filesystem::remove_all(m_path);
+    std::filesystem::create_directories(m_path);
+    m_store.SetBasePath((m_path / "").string());
+    m_key = CLicenseStore::MakeKey("https://license.com/wv|Token=abc|R{SSM}|", m_keyId, m_pssh);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(m_path); }
+
+  const std::string m_keyId{"\x00\x11\x22\x33\x44\x55\x66\x77\x88\x99\xaa\xbb\xcc\xdd\xee\xff", 16};
+  const std::string m_pssh{"pssh\x01\x02", 6};
+  const uint64_t m_now{1700000000};
+  std::filesystem::path m_path;
+  std::string m_key;
+  CLicenseStore m_store;
+};
+
+TEST_F(LicenseStoreTest, MakeKey)
+{
+  EXPECT_EQ(m_key.size(), 32);
+  // The headers part of the license url dont affect the key
+  EXPECT_EQ(m_key,
+            CLicenseStore::MakeKey("https://license.com/wv|Token=xyz|R{SSM}|", m_keyId, m_pssh));
+  EXPECT_EQ(m_key, CLicenseStore::MakeKey("https://license.com/wv", m_keyId, m_pssh));
+  EXPECT_NE(m_key, CLicenseStore::MakeKey("https://license2.com/wv", m_keyId, m_pssh));
+  EXPECT_NE(m_key, CLicenseStore::MakeKey("https://license.com/wv", m_keyId.substr(1), m_pssh));
+  EXPECT_NE(m_key, CLicenseStore::MakeKey("https://license.com/wv", m_keyId, "pssh"));
+}
+
+TEST_F(LicenseStoreTest, SaveLoadRemove)
+{
+  CLicenseStore::Entry entry;
+  EXPECT_FALSE(m_store.Load(m_key, entry, m_now));
+
+  entry.m_storeTime = m_now;
+  entry.m_sessionId = std::string{"session\x00\x01", 9};
+  ASSERT_TRUE(m_store.Save(m_key, entry));
+
+  CLicenseStore::Entry loaded;
+  ASSERT_TRUE(m_store.Load(m_key, loaded, m_now + 10));
+  EXPECT_EQ(loaded.m_storeTime, m_now);
+  EXPECT_EQ(loaded.m_expireTime, 0);
+  EXPECT_EQ(loaded.m_sessionId, entry.m_sessionId);
+
+  m_store.Remove(m_key);
+  EXPECT_FALSE(m_store.Load(m_key, loaded, m_now + 10));
+
+  // Disabled store
+  CLicenseStore disabledStore;
+  EXPECT_FALSE(disabledStore.Save(m_key, entry));
+  EXPECT_FALSE(disabledStore.Load(m_key, loaded, m_now));
+}
+
+TEST_F(LicenseStoreTest, Expiration)
+{
+  CLicenseStore::Entry entry;
+  entry.m_storeTime = m_now;
+  entry.m_expireTime = m_now + 100;
+  entry.m_sessionId = "session";
+  ASSERT_TRUE(m_store.Save(m_key, entry));
+
+  CLicenseStore::Entry loaded;
+  EXPECT_TRUE(m_store.Load(m_key, loaded, m_now + 99));
+  EXPECT_FALSE(m_store.Load(m_key, loaded, m_now + 100));
+  // The expired license has been deleted
+  EXPECT_FALSE(std::filesystem::exists(m_path / ("license_" + m_key)));
+
+  // Without expiration time the max age is applied
+  entry.m_expireTime = 0;
+  ASSERT_TRUE(m_store.Save(m_key, entry));
+  EXPECT_TRUE(m_store.Load(m_key, loaded, m_now + CLicenseStore::LICENSE_MAX_AGE - 1));
+  EXPECT_FALSE(m_store.Load(m_key, loaded, m_now + CLicenseStore::LICENSE_MAX_AGE));
+}
+
+TEST_F(LicenseStoreTest, DamagedFile)
+{
+  const std::string filePath{(m_path / ("license_" + m_key)).string()};
+  FILE* f = std::fopen(filePath.c_str(), "wb");
+  ASSERT_NE(f, nullptr);
+  std::fwrite("ISAL\x01\x02", 1, 6, f);
+  std::fclose(f);
+
+  CLicenseStore::Entry loaded;
+  EXPECT_FALSE(m_store.Load(m_key, loaded, m_now));
+  EXPECT_FALSE(std::filesystem::exists(filePath));
+}
+
+TEST_F(LicenseStoreTest, ServiceCertificate)
+{
+  std::string certificate;
+  EXPECT_FALSE(m_store.LoadServiceCertificate(certificate, m_now));
+  EXPECT_FALSE(m_store.SaveServiceCertificate("", m_now));
+
+  ASSERT_TRUE(m_store.SaveServiceCertificate("certificate", m_now));
+  ASSERT_TRUE(m_store.LoadServiceCertificate(certificate, m_now + 1));
+  EXPECT_EQ(certificate, "certificate");
+
+  EXPECT_FALSE(m_store.LoadServiceCertificate(
+      certificate, m_now + CLicenseStore::SERVICE_CERTIFICATE_MAX_AGE));
+  // Stored in the future, the system clock has been changed
+  EXPECT_FALSE(m_store.LoadServiceCertificate(certificate, m_now - 1));
+}
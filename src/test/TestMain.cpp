@@ -14,8 +14,12 @@ int main(int argc, char** argv)
   std::vector<std::string> args(argv + 1, argv + argc);
 #ifdef _WIN32
   _putenv_s("DATADIR", args[0].c_str());
+  if (args.size() > 1)
+    _putenv_s("SAMPLESDIR", args[1].c_str());
 #else
   setenv("DATADIR", args[0].c_str(), 1);
+  if (args.size() > 1)
+    setenv("SAMPLESDIR", args[1].c_str(), 1);
 #endif
   return RUN_ALL_TESTS();
 }
@@ -0,0 +1,207 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../common/SampleAesDecrypter.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+const std::string KEY{"0123456789abcdef"};
+constexpr uint8_t IV[16]{0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+                         0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f};
+
+std::vector<uint8_t> CreatePayload(size_t size, uint8_t seed)
+{
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i < size; ++i)
+    data[i] = static_cast<uint8_t>((i * 7 + seed) % 251 + 4);
+  return data;
+}
+
+// Encrypt blocks with AES-128 CBC, starting from the IV
+void EncryptBlocks(uint8_t* data, size_t blocks, uint8_t* iv)
+{
+  AP4_BlockCipher* cipher{nullptr};
+  ASSERT_EQ(AP4_DefaultBlockCipherFactory::Instance.CreateCipher(
+                AP4_BlockCipher::AES_128, AP4_BlockCipher::ENCRYPT, AP4_BlockCipher::CBC,
+                nullptr, reinterpret_cast<const AP4_UI08*>(KEY.data()), 16, cipher),
+            AP4_SUCCESS);
+  uint8_t clearBlock[16];
+  for (size_t i = 0; i < blocks; ++i, data += 16)
+  {
+    std::memcpy(clearBlock, data, 16);
+    cipher->Process(clearBlock, 16, data, iv);
+    std::memcpy(iv, data, 16);
+  }
+  delete cipher;
+}
+
+// Encrypt a NAL unit as SAMPLE-AES, then insert the emulation prevention bytes
+std::vector<uint8_t> EncryptNalUnit(std::vector<uint8_t> nal)
+{
+  uint8_t iv[16];
+  std::memcpy(iv, IV, 16);
+  size_t pos = 32;
+  while (pos < nal.size())
+  {
+    if (nal.size() - pos > 16)
+    {
+      EncryptBlocks(nal.data() + pos, 1, iv);
+      pos += 16;
+    }
+    pos += 144;
+  }
+
+  std::vector<uint8_t> encNal;
+  size_t zeroCount = 0;
+  for (uint8_t byte : nal)
+  {
+    if (zeroCount >= 2 && byte <= 3)
+    {
+      encNal.emplace_back(0x03);
+      zeroCount = 0;
+    }
+    encNal.emplace_back(byte);
+    zeroCount = byte == 0 ? zeroCount + 1 : 0;
+  }
+  return encNal;
+}
+
+std::vector<uint8_t> CreateAdtsFrame(size_t payloadSize, uint8_t seed)
+{
+  const size_t frameSize = 7 + payloadSize;
+  std::vector<uint8_t> frame{0xFF,
+                             0xF1,
+                             0x50,
+                             static_cast<uint8_t>(0x80 | (frameSize >> 11)),
+                             static_cast<uint8_t>(frameSize >> 3),
+                             static_cast<uint8_t>(((frameSize & 0x07) << 5) | 0x1F),
+                             0xFC};
+  std::vector<uint8_t> payload{CreatePayload(payloadSize, seed)};
+  frame.insert(frame.end(), payload.begin(), payload.end());
+  return frame;
+}
+
+void EncryptAudioFrame(std::vector<uint8_t>& data, size_t framePos, size_t leaderSize)
+{
+  uint8_t iv[16];
+  std::memcpy(iv, IV, 16);
+  const size_t frameSize = data.size() - framePos;
+  if (frameSize > leaderSize)
+    EncryptBlocks(data.data() + framePos + leaderSize, (frameSize - leaderSize) / 16, iv);
+}
+} // unnamed namespace
+
+TEST(SampleAesDecrypterTest, SetKey)
+{
+  CSampleAesDecrypter decrypter;
+  EXPECT_FALSE(decrypter.IsKeySet());
+  EXPECT_TRUE(decrypter.SetKey(KEY, IV));
+  EXPECT_TRUE(decrypter.IsKeySet());
+  // Same key with a new IV reuse the AES context
+  EXPECT_TRUE(decrypter.SetKey(KEY, IV));
+  EXPECT_FALSE(decrypter.SetKey("0", IV));
+  EXPECT_FALSE(decrypter.IsKeySet());
+
+  uint8_t data[16]{};
+  size_t size = sizeof(data);
+  EXPECT_FALSE(decrypter.DecryptSample(CSampleAesDecrypter::Codec::H264, data, size));
+}
+
+TEST(SampleAesDecrypterTest, DecryptH264AccessUnit)
+{
+  // SPS and a short slice are not encrypted
+  std::vector<uint8_t> sps{0x67, 0x64, 0x00, 0x1f, 0xac, 0xd9, 0x40, 0x50};
+  std::vector<uint8_t> shortSlice{CreatePayload(40, 3)};
+  shortSlice[0] = 0x41;
+  // The clear leader of the IDR slice contains an emulation prevention sequence
+  std::vector<uint8_t> idrSlice{CreatePayload(500, 1)};
+  idrSlice[0] = 0x65;
+  std::memcpy(idrSlice.data() + 10, "\x00\x00\x03\x01", 4);
+
+  std::vector<uint8_t> clearAu;
+  std::vector<uint8_t> encryptedAu;
+  for (const std::vector<uint8_t>* nal : {&sps, &shortSlice, &idrSlice})
+  {
+    const std::vector<uint8_t> startCode{0x00, 0x00, 0x00, 0x01};
+    clearAu.insert(clearAu.end(), startCode.begin(), startCode.end());
+    clearAu.insert(clearAu.end(), nal->begin(), nal->end());
+    encryptedAu.insert(encryptedAu.end(), startCode.begin(), startCode.end());
+    if (nal == &idrSlice)
+    {
+      const std::vector<uint8_t> encNal{EncryptNalUnit(*nal)};
+      encryptedAu.insert(encryptedAu.end(), encNal.begin(), encNal.end());
+    }
+    else
+      encryptedAu.insert(encryptedAu.end(), nal->begin(), nal->end());
+  }
+  ASSERT_NE(clearAu, encryptedAu);
+
+  CSampleAesDecrypter decrypter;
+  ASSERT_TRUE(decrypter.SetKey(KEY, IV));
+  size_t size = encryptedAu.size();
+  ASSERT_TRUE(
+      decrypter.DecryptSample(CSampleAesDecrypter::Codec::H264, encryptedAu.data(), size));
+  encryptedAu.resize(size);
+  EXPECT_EQ(encryptedAu, clearAu);
+}
+
+TEST(SampleAesDecrypterTest, DecryptAdtsFrames)
+{
+  std::vector<uint8_t> clearData{CreateAdtsFrame(200, 5)};
+  std::vector<uint8_t> encryptedData{clearData};
+  EncryptAudioFrame(encryptedData, 0, 7 + 16);
+
+  const std::vector<uint8_t> secondFrame{CreateAdtsFrame(71, 9)};
+  const size_t secondFramePos = clearData.size();
+  clearData.insert(clearData.end(), secondFrame.begin(), secondFrame.end());
+  encryptedData.insert(encryptedData.end(), secondFrame.begin(), secondFrame.end());
+  EncryptAudioFrame(encryptedData, secondFramePos, 7 + 16);
+  ASSERT_NE(clearData, encryptedData);
+
+  CSampleAesDecrypter decrypter;
+  ASSERT_TRUE(decrypter.SetKey(KEY, IV));
+  size_t size = encryptedData.size();
+  ASSERT_TRUE(
+      decrypter.DecryptSample(CSampleAesDecrypter::Codec::AAC, encryptedData.data(), size));
+  EXPECT_EQ(size, clearData.size());
+  EXPECT_EQ(encryptedData, clearData);
+
+  // Not an ADTS frame
+  encryptedData[0] = 0x00;
+  EXPECT_FALSE(
+      decrypter.DecryptSample(CSampleAesDecrypter::Codec::AAC, encryptedData.data(), size));
+}
+
+TEST(SampleAesDecrypterTest, DecryptAc3Frames)
+{
+  // AC-3 frame 48 kHz 32 kbit/s (128 bytes), followed by an E-AC-3 frame (frmsiz 99, 200 bytes)
+  std::vector<uint8_t> clearData{CreatePayload(128, 2)};
+  std::memcpy(clearData.data(), "\x0B\x77\x00\x00\x00\x40", 6);
+  std::vector<uint8_t> eac3Frame{CreatePayload(200, 7)};
+  std::memcpy(eac3Frame.data(), "\x0B\x77\x00\x63\x00\x80", 6);
+
+  std::vector<uint8_t> encryptedData{clearData};
+  EncryptAudioFrame(encryptedData, 0, 16);
+  clearData.insert(clearData.end(), eac3Frame.begin(), eac3Frame.end());
+  encryptedData.insert(encryptedData.end(), eac3Frame.begin(), eac3Frame.end());
+  EncryptAudioFrame(encryptedData, 128, 16);
+  ASSERT_NE(clearData, encryptedData);
+
+  CSampleAesDecrypter decrypter;
+  ASSERT_TRUE(decrypter.SetKey(KEY, IV));
+  size_t size = encryptedData.size();
+  ASSERT_TRUE(
+      decrypter.DecryptSample(CSampleAesDecrypter::Codec::AC3, encryptedData.data(), size));
+  EXPECT_EQ(encryptedData, clearData);
+}
@@ -0,0 +1,736 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "ClearKeyDecrypter.h"
+#include "LicenseServerStub.h"
+#include "TestHelper.h"
+
+#include "../codechandler/TTMLCodecHandler.h"
+#include "../codechandler/WebVTTCodecHandler.h"
+#include "../common/KeySystemHandlers.h"
+#include "../samplereader/ADTSSampleReader.h"
+#include "../samplereader/EventMessage.h"
+#include "../samplereader/FragmentedSampleReader.h"
+#include "../samplereader/FragmentSampleIndex.h"
+#include "../samplereader/SubtitleSampleReader.h"
+#include "../samplereader/TSSampleReader.h"
+#include "../samplereader/WebmSampleReader.h"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+// The sample readers output is compared byte-exact with the ".golden" files
+// placed next to the sample files, each line describe a sample or a change
+// of the stream information. To regenerate the golden files after an intended
+// output change, run the tests with the UPDATE_GOLDENS environment variable set.
+
+namespace
+{
+// Protect from readers that never reach the EOS
+constexpr size_t MAX_DUMP_SAMPLES = 100000;
+
+std::string FromHex(std::string_view hex)
+{
+  std::string data;
+  for (size_t i = 0; i + 1 < hex.size(); i += 2)
+    data += static_cast<char>(std::stoi(std::string(hex.substr(i, 2)), nullptr, 16));
+  return data;
+}
+
+// Keys of the encrypted samples, "clear_video.mp4" has the same samples unencrypted.
+// The second fragment of "cenc_video.mp4" maps the first half of the samples
+// to a 'seig' sample group with KID_B, the second half to no group (KID_A).
+// The audio samples of "cenc_audio.mp4" are full sample encrypted with KID_A
+// and IVs that continue the counter of the previous sample, except the third
+// sample of the second fragment, mapped to a sample group of a KID without key.
+const std::string KID_A{FromHex("a1a1a1a1a1a1a1a1a1a1a1a1a1a1a1a1")};
+const std::string KID_B{FromHex("b2b2b2b2b2b2b2b2b2b2b2b2b2b2b2b2")};
+const std::string KEY_A{FromHex("2b7e151628aed2a6abf7158809cf4f3c")};
+const std::string KEY_B{FromHex("000102030405060708090a0b0c0d0e0f")};
+
+// FNV-1a 64 bit hash
+uint64_t HashData(const uint8_t* data, size_t size)
+{
+  uint64_t hash{0xcbf29ce484222325ULL};
+  for (size_t i{0}; i < size; ++i)
+  {
+    hash ^= data[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+std::string GetSampleFilePath(const std::string& name)
+{
+  return GetEnv("SAMPLESDIR") + "/" + name;
+}
+
+bool LoadFile(const std::string& filePath, std::string& data)
+{
+  std::ifstream file(filePath, std::ios::binary);
+  if (!file)
+    return false;
+  std::ostringstream stream;
+  stream << file.rdbuf();
+  data = stream.str();
+  return true;
+}
+
+void DumpHash(std::ostream& dump, const uint8_t* data, size_t size)
+{
+  dump << "size=" << size << " hash=" << std::hex << std::setw(16) << std::setfill('0')
+       << HashData(data, size) << std::dec;
+}
+
+void DumpSample(std::ostream& dump,
+                uint64_t pts,
+                uint64_t dts,
+                uint64_t duration,
+                const uint8_t* data,
+                size_t size)
+{
+  dump << "pts=" << pts << " dts=" << dts << " dur=" << duration << " ";
+  DumpHash(dump, data, size);
+  dump << "\n";
+}
+
+void DumpInfo(std::ostream& dump, const kodi::addon::InputstreamInfo& info)
+{
+  dump << "info codec=" << info.GetCodecName() << " profile=" << info.GetCodecProfile()
+       << " width=" << info.GetWidth() << " height=" << info.GetHeight()
+       << " fps=" << info.GetFpsRate() << "/" << info.GetFpsScale() << " aspect=" << std::fixed
+       << std::setprecision(4) << info.GetAspect() << " channels=" << info.GetChannels()
+       << " samplerate=" << info.GetSampleRate() << " bits=" << info.GetBitsPerSample()
+       << " extradata ";
+  DumpHash(dump, info.GetExtraData().data(), info.GetExtraData().size());
+  dump << "\n";
+}
+
+// The stream type is needed by the readers that demux several streams (e.g. TS)
+std::string DumpSampleReader(ISampleReader& reader,
+                             INPUTSTREAM_TYPE streamType = INPUTSTREAM_TYPE_NONE)
+{
+  std::ostringstream dump;
+  kodi::addon::InputstreamInfo info;
+  info.SetStreamType(streamType);
+
+  bool isStarted{false};
+  if (AP4_FAILED(reader.Start(isStarted)))
+    return "start failed\n";
+
+  for (size_t count{0}; !reader.EOS() && count < MAX_DUMP_SAMPLES; ++count)
+  {
+    if (reader.GetInformation(info))
+      DumpInfo(dump, info);
+
+    DumpSample(dump, reader.PTS(), reader.DTS(), reader.GetDuration(), reader.GetSampleData(),
+               reader.GetSampleDataSize());
+
+    if (AP4_FAILED(reader.ReadSample()))
+      break;
+  }
+  if (reader.EOS())
+    dump << "eos\n";
+
+  return dump.str();
+}
+
+std::string DumpCodecHandler(CodecHandler& codecHandler,
+                             const std::string& data,
+                             AP4_UI64 timescale)
+{
+  std::ostringstream dump;
+
+  AP4_DataBuffer buffer{reinterpret_cast<const AP4_Byte*>(data.data()),
+                        static_cast<AP4_Size>(data.size())};
+  if (!codecHandler.Transform(0, 0, buffer, timescale))
+    return "transform failed\n";
+
+  if (codecHandler.m_extraData.GetDataSize() > 0)
+  {
+    dump << "extradata ";
+    DumpHash(dump, codecHandler.m_extraData.GetData(), codecHandler.m_extraData.GetDataSize());
+    dump << "\n";
+  }
+
+  AP4_Sample sample;
+  AP4_DataBuffer sampleData;
+  for (size_t count{0};
+       codecHandler.ReadNextSample(sample, sampleData) && count < MAX_DUMP_SAMPLES; ++count)
+  {
+    DumpSample(dump, sample.GetCts(), sample.GetDts(), sample.GetDuration(),
+               sampleData.GetData(), sampleData.GetDataSize());
+  }
+  return dump.str();
+}
+
+// Open the fragmented reader of a track of a fragmented MP4 sample file
+bool WithFragmentedReader(const std::string& sampleName,
+                          Adaptive_CencSingleSampleDecrypter* ssd,
+                          AP4_Track::Type trackType,
+                          const std::function<void(CFragmentedSampleReader&)>& readFunc)
+{
+  std::string data;
+  if (!LoadFile(GetSampleFilePath(sampleName), data))
+    return false;
+
+  bool isTrackFound{false};
+  AP4_ByteStream* stream{new AP4_MemoryByteStream(
+      reinterpret_cast<const AP4_UI08*>(data.data()), static_cast<AP4_Size>(data.size()))};
+  {
+    AP4_File file{*stream, AP4_DefaultAtomFactory::Instance_, true};
+    AP4_Movie* movie{file.GetMovie()};
+    AP4_Track* track{movie ? movie->GetTrack(trackType) : nullptr};
+    if (track)
+    {
+      CFragmentedSampleReader reader{stream, movie, track, 1, ssd, {}};
+      readFunc(reader);
+      isTrackFound = true;
+    }
+  }
+  stream->Release();
+  return isTrackFound;
+}
+
+// Read all samples of a track of a fragmented MP4 sample file
+std::vector<std::string> ReadFragmentedSamples(const std::string& sampleName,
+                                               Adaptive_CencSingleSampleDecrypter* ssd,
+                                               AP4_Track::Type trackType = AP4_Track::TYPE_VIDEO)
+{
+  std::vector<std::string> samples;
+  WithFragmentedReader(sampleName, ssd, trackType,
+                       [&samples](CFragmentedSampleReader& reader)
+                       {
+                         bool isStarted{false};
+                         AP4_Result result{reader.Start(isStarted)};
+                         while (AP4_SUCCEEDED(result) && !reader.EOS() &&
+                                samples.size() < MAX_DUMP_SAMPLES)
+                         {
+                           samples.emplace_back(
+                               reinterpret_cast<const char*>(reader.GetSampleData()),
+                               reader.GetSampleDataSize());
+                           result = reader.ReadSample();
+                         }
+                       });
+  return samples;
+}
+
+std::string DumpFragmentedSampleReader(const std::string& sampleName,
+                                       Adaptive_CencSingleSampleDecrypter* ssd,
+                                       AP4_Track::Type trackType)
+{
+  std::string dump{"missing track\n"};
+  WithFragmentedReader(sampleName, ssd, trackType,
+                       [&dump](CFragmentedSampleReader& reader)
+                       { dump = DumpSampleReader(reader); });
+  return dump;
+}
+
+// Read all samples of a WebM sample file, Initialize is skipped as it needs
+// the segment offsets of an adaptive byte stream
+std::vector<std::string> ReadWebmSamples(const std::string& sampleName,
+                                         Adaptive_CencSingleSampleDecrypter* ssd)
+{
+  std::vector<std::string> samples;
+  std::string data;
+  if (!LoadFile(GetSampleFilePath(sampleName), data))
+    return samples;
+
+  AP4_ByteStream* stream{new AP4_MemoryByteStream(
+      reinterpret_cast<const AP4_UI08*>(data.data()), static_cast<AP4_Size>(data.size()))};
+  {
+    CWebmSampleReader reader{stream, 1};
+    reader.SetDecrypter(ssd);
+    bool isStarted{false};
+    AP4_Result result{reader.Start(isStarted)};
+    while (AP4_SUCCEEDED(result) && !reader.EOS() && samples.size() < MAX_DUMP_SAMPLES)
+    {
+      samples.emplace_back(reinterpret_cast<const char*>(reader.GetSampleData()),
+                           reader.GetSampleDataSize());
+      result = reader.ReadSample();
+    }
+  }
+  stream->Release();
+  return samples;
+}
+
+void CompareWithGolden(const std::string& sampleName, const std::string& dump)
+{
+  const std::string goldenPath = GetSampleFilePath(sampleName + ".golden");
+
+  if (!GetEnv("UPDATE_GOLDENS").empty())
+  {
+    std::ofstream file(goldenPath, std::ios::binary | std::ios::trunc);
+    ASSERT_TRUE(file.good()) << "Cannot write golden file: " << goldenPath;
+    file << dump;
+    return;
+  }
+
+  std::string golden;
+  ASSERT_TRUE(LoadFile(goldenPath, golden)) << "Missing golden file: " << goldenPath;
+
+  // Compare line by line to report the first sample that differ
+  std::istringstream goldenStream(golden);
+  std::istringstream dumpStream(dump);
+  std::string goldenLine;
+  std::string dumpLine;
+  size_t lineNumber{1};
+  while (std::getline(goldenStream, goldenLine))
+  {
+    if (!std::getline(dumpStream, dumpLine))
+      dumpLine = "<missing>";
+    ASSERT_EQ(goldenLine, dumpLine) << sampleName << " differs at line " << lineNumber;
+    ++lineNumber;
+  }
+  ASSERT_FALSE(std::getline(dumpStream, dumpLine))
+      << sampleName << " has unexpected output at line " << lineNumber << ": " << dumpLine;
+}
+} // unnamed namespace
+
+class SampleReaderTest : public ::testing::Test
+{
+protected:
+  void TearDown() override
+  {
+    if (m_byteStream)
+    {
+      m_byteStream->Release();
+      m_byteStream = nullptr;
+    }
+  }
+
+  AP4_ByteStream* OpenSample(const std::string& sampleName)
+  {
+    std::string data;
+    if (!LoadFile(GetSampleFilePath(sampleName), data))
+      return nullptr;
+
+    m_byteStream = new AP4_MemoryByteStream(reinterpret_cast<const AP4_UI08*>(data.data()),
+                                            static_cast<AP4_Size>(data.size()));
+    return m_byteStream;
+  }
+
+  AP4_ContainerAtom* OpenTrackFragment(const std::string& sampleName)
+  {
+    AP4_ByteStream* stream = OpenSample(sampleName);
+    AP4_Atom* atom{nullptr};
+    if (!stream ||
+        AP4_FAILED(AP4_DefaultAtomFactory::Instance_.CreateAtomFromStream(*stream, atom)))
+      return nullptr;
+
+    m_atom.reset(atom);
+    AP4_ContainerAtom* moof = AP4_DYNAMIC_CAST(AP4_ContainerAtom, atom);
+    if (!moof)
+      return nullptr;
+    return AP4_DYNAMIC_CAST(AP4_ContainerAtom, moof->GetChild(AP4_ATOM_TYPE_TRAF, 0));
+  }
+
+  AP4_ByteStream* m_byteStream{nullptr};
+  std::unique_ptr<AP4_Atom> m_atom;
+};
+
+class FragmentedDecryptTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_server.AddKey(KID_A, KEY_A);
+    m_server.AddKey(KID_B, KEY_B);
+    const DRM::IKeySystemHandler* handler{DRM::GetHandler(DRM::KeySystem::CLEARKEY)};
+    const std::string licenseTemplate{
+        handler->GetLicenseRequestTemplate("https://license.test/clearkey")};
+    ASSERT_TRUE(m_decrypter.OpenDRMSystem(licenseTemplate.c_str(), {}, 0));
+  }
+
+  void TearDown() override
+  {
+    if (m_ssd)
+      m_decrypter.DestroySingleSampleDecrypter(m_ssd);
+  }
+
+  Adaptive_CencSingleSampleDecrypter* CreateDecrypter(CryptoMode cryptoMode)
+  {
+    // The init data of the test decrypter can be the list of the KIDs
+    const std::string keyIds{KID_A + KID_B};
+    AP4_DataBuffer initData{keyIds.data(), static_cast<AP4_Size>(keyIds.size())};
+    m_ssd = m_decrypter.CreateSingleSampleDecrypter(initData, nullptr, KID_A, false, cryptoMode);
+    return m_ssd;
+  }
+
+  CLicenseServerStub m_server;
+  CTestSsdHost m_host{m_server};
+  CClearKeyDecrypter m_decrypter{m_host};
+  Adaptive_CencSingleSampleDecrypter* m_ssd{nullptr};
+};
+
+TEST_F(SampleReaderTest, ADTSPackedAudio)
+{
+  AP4_ByteStream* stream = OpenSample("packed_audio.aac");
+  ASSERT_NE(stream, nullptr);
+
+  CADTSSampleReader reader{stream, 1};
+  CompareWithGolden("packed_audio.aac", DumpSampleReader(reader));
+}
+
+TEST_F(SampleReaderTest, TSPackedAudio)
+{
+  // The ADTS frames of "packed_audio.aac" in PES packets, the last frame is
+  // delivered by the AAC parser only once the next frame header is found
+  AP4_ByteStream* stream = OpenSample("packed_audio.ts");
+  ASSERT_NE(stream, nullptr);
+
+  const uint32_t audioMask{1U << INPUTSTREAM_TYPE_AUDIO};
+  CTSSampleReader reader{stream, INPUTSTREAM_TYPE_AUDIO, 1, audioMask};
+  ASSERT_TRUE(reader.Initialize());
+  CompareWithGolden("packed_audio.ts", DumpSampleReader(reader, INPUTSTREAM_TYPE_AUDIO));
+}
+
+TEST_F(SampleReaderTest, WebmVideo)
+{
+  AP4_ByteStream* stream = OpenSample("vp9_video.webm");
+  ASSERT_NE(stream, nullptr);
+
+  // Initialize is skipped, it needs the segment offsets of an adaptive byte stream
+  CWebmSampleReader reader{stream, 1};
+  CompareWithGolden("vp9_video.webm", DumpSampleReader(reader, INPUTSTREAM_TYPE_VIDEO));
+}
+
+TEST_F(SampleReaderTest, FragmentedAudio)
+{
+  CompareWithGolden("clear_audio.mp4",
+                    DumpFragmentedSampleReader("clear_audio.mp4", nullptr, AP4_Track::TYPE_AUDIO));
+}
+
+TEST_F(SampleReaderTest, SubtitleReaderWebVTT)
+{
+  // The single file is read with the stubbed CURL file, the start does not
+  // read a sample so the first output is the empty sample at the start PTS
+  CSubtitleSampleReader reader{GetSampleFilePath("subtitles.vtt"), 1, "wvtt"};
+  reader.SetStartPTS(0);
+  CompareWithGolden("subtitles.vtt.reader", DumpSampleReader(reader));
+}
+
+TEST_F(SampleReaderTest, SubtitleReaderTTML)
+{
+  CSubtitleSampleReader reader{GetSampleFilePath("subtitles.ttml"), 1, "ttml"};
+  reader.SetStartPTS(0);
+  CompareWithGolden("subtitles.ttml.reader", DumpSampleReader(reader));
+}
+
+TEST_F(SampleReaderTest, WebVTTSingleFile)
+{
+  std::string data;
+  ASSERT_TRUE(LoadFile(GetSampleFilePath("subtitles.vtt"), data));
+
+  WebVTTCodecHandler codecHandler{nullptr, true};
+  CompareWithGolden("subtitles.vtt", DumpCodecHandler(codecHandler, data, 1000));
+}
+
+TEST_F(SampleReaderTest, TTMLSingleFile)
+{
+  std::string data;
+  ASSERT_TRUE(LoadFile(GetSampleFilePath("subtitles.ttml"), data));
+
+  TTMLCodecHandler codecHandler{nullptr};
+  CompareWithGolden("subtitles.ttml", DumpCodecHandler(codecHandler, data, 1000));
+}
+
+TEST_F(SampleReaderTest, FragmentIndexFromTrackRuns)
+{
+  // Two track runs of 24 samples of 3000 ticks, the sync samples are
+  // signalled by the first sample flags, the sdtp table and the sample flags
+  AP4_ContainerAtom* traf = OpenTrackFragment("fragment_video.m4s");
+  ASSERT_NE(traf, nullptr);
+
+  CFragmentSampleIndex index;
+  ASSERT_TRUE(index.Build(traf, nullptr, 900000));
+
+  EXPECT_EQ(index.GetSampleCount(), 48);
+  EXPECT_EQ(index.GetStartDts(), 900000);
+  EXPECT_EQ(index.GetEndDts(), 900000 + 48 * 3000);
+  EXPECT_EQ(index.GetSample(3).m_dts, 909000);
+  EXPECT_EQ(index.GetSample(3).m_cts, 915000);
+  EXPECT_EQ(index.GetSample(4).m_cts, 912000);
+
+  const std::vector<AP4_Ordinal> syncSamples{0, 12, 24, 36};
+  for (size_t i{0}; i < index.GetSampleCount(); ++i)
+  {
+    const bool isSync =
+        std::find(syncSamples.begin(), syncSamples.end(), i) != syncSamples.end();
+    EXPECT_EQ(index.GetSample(i).m_isSync, isSync) << "sample " << i;
+  }
+}
+
+TEST_F(SampleReaderTest, FragmentIndexFindSyncSample)
+{
+  AP4_ContainerAtom* traf = OpenTrackFragment("fragment_video.m4s");
+  ASSERT_NE(traf, nullptr);
+
+  CFragmentSampleIndex index;
+  ASSERT_TRUE(index.Build(traf, nullptr, 900000));
+
+  auto sampleDts = [](AP4_UI64 sampleNumber) { return 900000 + sampleNumber * 3000; };
+  AP4_Ordinal sampleIndex{0};
+
+  // Time in the middle of the sample 17
+  EXPECT_TRUE(index.FindSyncSample(sampleDts(17) + 1500, true, sampleIndex));
+  EXPECT_EQ(sampleIndex, 12);
+  EXPECT_TRUE(index.FindSyncSample(sampleDts(17) + 1500, false, sampleIndex));
+  EXPECT_EQ(sampleIndex, 24);
+
+  // Exact time of a sync sample
+  EXPECT_TRUE(index.FindSyncSample(sampleDts(24), true, sampleIndex));
+  EXPECT_EQ(sampleIndex, 24);
+  EXPECT_TRUE(index.FindSyncSample(sampleDts(24), false, sampleIndex));
+  EXPECT_EQ(sampleIndex, 24);
+
+  // Last samples have no following sync sample in the fragment
+  EXPECT_TRUE(index.FindSyncSample(sampleDts(47), true, sampleIndex));
+  EXPECT_EQ(sampleIndex, 36);
+  EXPECT_FALSE(index.FindSyncSample(sampleDts(47), false, sampleIndex));
+
+  // Outside of the fragment
+  EXPECT_FALSE(index.FindSyncSample(sampleDts(0) - 1, true, sampleIndex));
+  EXPECT_FALSE(index.FindSyncSample(sampleDts(48), true, sampleIndex));
+
+  index.Clear();
+  EXPECT_TRUE(index.IsEmpty());
+  EXPECT_FALSE(index.FindSyncSample(sampleDts(17), true, sampleIndex));
+}
+
+TEST_F(SampleReaderTest, EventMessageVersion0)
+{
+  // MPD validity expiration event, the message data is the MPD publishTime
+  const std::string emsg{"\x00\x00\x00\x00"
+                         "urn:mpeg:dash:event:2012\x00"
+                         "1\x00"
+                         "\x00\x00\x03\xE8" // timescale
+                         "\x00\x00\x07\xD0" // presentation_time_delta
+                         "\xFF\xFF\xFF\xFF" // event_duration
+                         "\x00\x00\x00\x2A" // id
+                         "2023-05-01T10:00:00Z",
+                         67};
+  CEventMessage eventMessage;
+  ASSERT_TRUE(eventMessage.Parse(reinterpret_cast<const AP4_UI08*>(emsg.data()),
+                                 static_cast<AP4_Size>(emsg.size())));
+
+  EXPECT_EQ(eventMessage.GetVersion(), 0);
+  EXPECT_TRUE(eventMessage.IsMpdEvent());
+  EXPECT_EQ(eventMessage.GetValue(), "1");
+  EXPECT_EQ(eventMessage.GetTimescale(), 1000);
+  EXPECT_EQ(eventMessage.GetPresentationTime(), 2000);
+  EXPECT_EQ(eventMessage.GetEventDuration(), 0xFFFFFFFF);
+  EXPECT_EQ(eventMessage.GetId(), 42);
+  EXPECT_EQ(eventMessage.GetMessageData(), "2023-05-01T10:00:00Z");
+}
+
+TEST_F(SampleReaderTest, EventMessageVersion1)
+{
+  const std::string emsg{"\x01\x00\x00\x00"
+                         "\x00\x01\x5F\x90" // timescale
+                         "\x00\x00\x00\x01\x00\x00\x00\x00" // presentation_time
+                         "\x00\x00\x00\x00" // event_duration
+                         "\x00\x00\x00\x07" // id
+                         "urn:scte:scte35:2013:bin\x00"
+                         "\x00"
+                         "\xFC\x30",
+                         52};
+  CEventMessage eventMessage;
+  ASSERT_TRUE(eventMessage.Parse(reinterpret_cast<const AP4_UI08*>(emsg.data()),
+                                 static_cast<AP4_Size>(emsg.size())));
+
+  EXPECT_EQ(eventMessage.GetVersion(), 1);
+  EXPECT_FALSE(eventMessage.IsMpdEvent());
+  EXPECT_EQ(eventMessage.GetSchemeIdUri(), "urn:scte:scte35:2013:bin");
+  EXPECT_EQ(eventMessage.GetValue(), "");
+  EXPECT_EQ(eventMessage.GetTimescale(), 90000);
+  EXPECT_EQ(eventMessage.GetPresentationTime(), 0x100000000ULL);
+  EXPECT_EQ(eventMessage.GetId(), 7);
+  EXPECT_EQ(eventMessage.GetMessageData(), std::string("\xFC\x30", 2));
+}
+
+TEST_F(SampleReaderTest, EventMessageMalformed)
+{
+  CEventMessage eventMessage;
+
+  // Scheme without null terminator
+  const std::string unterminated{"\x00\x00\x00\x00urn:mpeg:dash:event:2012", 28};
+  EXPECT_FALSE(eventMessage.Parse(reinterpret_cast<const AP4_UI08*>(unterminated.data()),
+                                  static_cast<AP4_Size>(unterminated.size())));
+
+  // Truncated fields
+  const std::string truncated{"\x01\x00\x00\x00\x00\x00\x03\xE8", 8};
+  EXPECT_FALSE(eventMessage.Parse(reinterpret_cast<const AP4_UI08*>(truncated.data()),
+                                  static_cast<AP4_Size>(truncated.size())));
+
+  // Unsupported version
+  const std::string version2{"\x02\x00\x00\x00", 4};
+  EXPECT_FALSE(eventMessage.Parse(reinterpret_cast<const AP4_UI08*>(version2.data()),
+                                  static_cast<AP4_Size>(version2.size())));
+}
+
+TEST_F(FragmentedDecryptTest, CencSampleGroupKeys)
+{
+  const std::vector<std::string> clearSamples{ReadFragmentedSamples("clear_video.mp4", nullptr)};
+  ASSERT_EQ(clearSamples.size(), 12);
+
+  Adaptive_CencSingleSampleDecrypter* ssd{CreateDecrypter(CryptoMode::AES_CTR)};
+  ASSERT_NE(ssd, nullptr);
+  const std::vector<std::string> samples{ReadFragmentedSamples("cenc_video.mp4", ssd)};
+  ASSERT_EQ(samples.size(), clearSamples.size());
+  for (size_t i{0}; i < samples.size(); ++i)
+    EXPECT_EQ(samples[i], clearSamples[i]) << "sample " << i;
+}
+
+TEST_F(FragmentedDecryptTest, CbcsPattern)
+{
+  const std::vector<std::string> clearSamples{ReadFragmentedSamples("clear_video.mp4", nullptr)};
+  ASSERT_EQ(clearSamples.size(), 12);
+
+  Adaptive_CencSingleSampleDecrypter* ssd{CreateDecrypter(CryptoMode::AES_CBC)};
+  ASSERT_NE(ssd, nullptr);
+  const std::vector<std::string> samples{ReadFragmentedSamples("cbcs_video.mp4", ssd)};
+  ASSERT_EQ(samples.size(), clearSamples.size());
+  for (size_t i{0}; i < samples.size(); ++i)
+    EXPECT_EQ(samples[i], clearSamples[i]) << "sample " << i;
+}
+
+TEST_F(FragmentedDecryptTest, AudioBatch)
+{
+  const std::vector<std::string> clearSamples{
+      ReadFragmentedSamples("clear_audio.mp4", nullptr, AP4_Track::TYPE_AUDIO)};
+  ASSERT_EQ(clearSamples.size(), 16);
+
+  Adaptive_CencSingleSampleDecrypter* ssd{CreateDecrypter(CryptoMode::AES_CTR)};
+  ASSERT_NE(ssd, nullptr);
+  const std::vector<std::string> samples{
+      ReadFragmentedSamples("cenc_audio.mp4", ssd, AP4_Track::TYPE_AUDIO)};
+  ASSERT_EQ(samples.size(), clearSamples.size());
+
+  // Only the sample without key fails, the others of its batch are decrypted
+  constexpr size_t failedSample{10};
+  for (size_t i{0}; i < samples.size(); ++i)
+  {
+    if (i == failedSample)
+      EXPECT_TRUE(samples[i].empty());
+    else
+      EXPECT_EQ(samples[i], clearSamples[i]) << "sample " << i;
+  }
+
+  // A request per run of samples with a continuous counter: in the first fragment the
+  // sixth sample is not block aligned, in the second one the failed sample split the run
+  EXPECT_EQ(static_cast<CClearKeySingleSampleDecrypter*>(ssd)->GetDecryptRequestCount(), 4);
+}
+
+TEST_F(FragmentedDecryptTest, AudioLocalKeysGolden)
+{
+  // Same output of "clear_audio.mp4" except the sample without key and the
+  // codec name, not set for the protected sample descriptions
+  Adaptive_CencSingleSampleDecrypter* ssd{CreateDecrypter(CryptoMode::AES_CTR)};
+  ASSERT_NE(ssd, nullptr);
+  CompareWithGolden("cenc_audio.mp4",
+                    DumpFragmentedSampleReader("cenc_audio.mp4", ssd, AP4_Track::TYPE_AUDIO));
+}
+
+TEST_F(FragmentedDecryptTest, TimeSeekWithinFragment)
+{
+  const std::vector<std::string> clearSamples{ReadFragmentedSamples("clear_video.mp4", nullptr)};
+  ASSERT_EQ(clearSamples.size(), 12);
+
+  Adaptive_CencSingleSampleDecrypter* ssd{CreateDecrypter(CryptoMode::AES_CTR)};
+  ASSERT_NE(ssd, nullptr);
+  auto clearKeySsd = static_cast<CClearKeySingleSampleDecrypter*>(ssd);
+
+  // Samples of 3000 ticks at 90 kHz, all sync samples, 6 samples per fragment
+  auto samplePts = [](uint64_t sampleNumber) { return (sampleNumber * 3000 * 100) / 9; };
+  auto sampleData = [](CFragmentedSampleReader& reader)
+  {
+    return std::string(reinterpret_cast<const char*>(reader.GetSampleData()),
+                       reader.GetSampleDataSize());
+  };
+
+  const bool isTrackFound = WithFragmentedReader(
+      "cenc_video.mp4", ssd, AP4_Track::TYPE_VIDEO,
+      [&](CFragmentedSampleReader& reader)
+      {
+        bool isStarted{false};
+        ASSERT_TRUE(AP4_SUCCEEDED(reader.Start(isStarted)));
+        EXPECT_EQ(reader.PTS(), samplePts(0));
+        EXPECT_EQ(clearKeySsd->GetDecryptRequestCount(), 1);
+
+        // Forward in the middle of a sample, the skipped samples are not decrypted
+        ASSERT_TRUE(reader.TimeSeek(samplePts(4) + 16666, true));
+        EXPECT_EQ(reader.PTS(), samplePts(4));
+        EXPECT_EQ(reader.DTS(), samplePts(4));
+        EXPECT_EQ(sampleData(reader), clearSamples[4]);
+        EXPECT_EQ(clearKeySsd->GetDecryptRequestCount(), 2);
+
+        // Backward within the same fragment
+        ASSERT_TRUE(reader.TimeSeek(samplePts(1) + 16666, true));
+        EXPECT_EQ(reader.PTS(), samplePts(1));
+        EXPECT_EQ(sampleData(reader), clearSamples[1]);
+        EXPECT_EQ(clearKeySsd->GetDecryptRequestCount(), 3);
+
+        // The samples are read again from the seek position up to the next fragment
+        for (size_t i{2}; i <= 6; ++i)
+        {
+          ASSERT_TRUE(AP4_SUCCEEDED(reader.ReadSample()));
+          EXPECT_EQ(reader.PTS(), samplePts(i)) << "sample " << i;
+          EXPECT_EQ(sampleData(reader), clearSamples[i]) << "sample " << i;
+        }
+        EXPECT_EQ(clearKeySsd->GetDecryptRequestCount(), 8);
+
+        // In the second fragment, to a sample of the default key after the
+        // samples of the sample group key
+        ASSERT_TRUE(reader.TimeSeek(samplePts(10) + 16666, true));
+        EXPECT_EQ(reader.PTS(), samplePts(10));
+        EXPECT_EQ(sampleData(reader), clearSamples[10]);
+        EXPECT_EQ(clearKeySsd->GetDecryptRequestCount(), 9);
+
+        ASSERT_TRUE(AP4_SUCCEEDED(reader.ReadSample()));
+        EXPECT_EQ(reader.PTS(), samplePts(11));
+        EXPECT_EQ(reader.GetDuration(), samplePts(1));
+        EXPECT_EQ(sampleData(reader), clearSamples[11]);
+      });
+  EXPECT_TRUE(isTrackFound);
+}
+
+TEST_F(FragmentedDecryptTest, WebmEncryptedBlocks)
+{
+  // "enc_vp9_video.webm" has the frames of "vp9_video.webm" encrypted with KID_A,
+  // as clear, full encrypted and partitioned blocks of the WebM encryption
+  const std::vector<std::string> clearSamples{ReadWebmSamples("vp9_video.webm", nullptr)};
+  ASSERT_EQ(clearSamples.size(), 10);
+
+  Adaptive_CencSingleSampleDecrypter* ssd{CreateDecrypter(CryptoMode::AES_CTR)};
+  ASSERT_NE(ssd, nullptr);
+  const std::vector<std::string> samples{ReadWebmSamples("enc_vp9_video.webm", ssd)};
+  ASSERT_EQ(samples.size(), clearSamples.size());
+  for (size_t i{0}; i < samples.size(); ++i)
+    EXPECT_EQ(samples[i], clearSamples[i]) << "sample " << i;
+
+  // Without decrypter only the clear blocks are delivered
+  const std::vector<std::string> noKeySamples{ReadWebmSamples("enc_vp9_video.webm", nullptr)};
+  ASSERT_EQ(noKeySamples.size(), clearSamples.size());
+  for (size_t i{0}; i < noKeySamples.size(); ++i)
+  {
+    if (i % 5 == 0)
+      EXPECT_EQ(noKeySamples[i], clearSamples[i]) << "sample " << i;
+    else
+      EXPECT_TRUE(noKeySamples[i].empty()) << "sample " << i;
+  }
+}
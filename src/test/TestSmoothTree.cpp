@@ -26,7 +26,7 @@ protected:
 
     tree = new SmoothTestTree(m_reprChooser);
     tree->Configure(kodiProps);
-    tree->m_supportedKeySystem = "urn:uuid:EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED";
+    tree->m_supportedKeySystems = {"urn:uuid:EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED"};
   }
 
   void TearDown() override
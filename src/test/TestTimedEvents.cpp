@@ -0,0 +1,171 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../common/TimedEvents.h"
+#include "../utils/Base64Utils.h"
+#include "../utils/Scte35Utils.h"
+
+#include <gtest/gtest.h>
+
+using namespace adaptive;
+using namespace UTILS;
+
+namespace
+{
+// splice_insert out of network, event id 0x4800008F, with break duration and avail descriptor
+constexpr const char* SPLICE_INSERT_B64 =
+    "/DAvAAAAAAAA///wFAVIAACPf+/+c2nALv4AUsz1AAAAAAAKAAhDVUVJAAABNWLbowo=";
+// time_signal with a segmentation descriptor of a provider placement opportunity start
+constexpr const char* TIME_SIGNAL_B64 =
+    "/DA0AAAAAAAA///wBQb+cr0AUAAeAhxDVUVJSAAAjn/PAAGlmbAICAAAAAAsoKGKNAIAmsnRfg==";
+
+TimedEvent MakeEvent(std::string id, uint64_t time, bool isManifestTime = false)
+{
+  TimedEvent event;
+  event.m_schemeIdUri = "urn:test";
+  event.m_id = id;
+  event.m_time = time;
+  event.m_isManifestTime = isManifestTime;
+  return event;
+}
+} // unnamed namespace
+
+TEST(Scte35Test, ParseSpliceInsert)
+{
+  const std::string section{BASE64::Decode(SPLICE_INSERT_B64)};
+  SCTE35::SpliceInfo info;
+  ASSERT_TRUE(SCTE35::ParseSpliceInfoSection(reinterpret_cast<const uint8_t*>(section.data()),
+                                             section.size(), info));
+
+  EXPECT_EQ(info.m_commandType, SCTE35::CommandType::SPLICE_INSERT);
+  EXPECT_EQ(info.m_eventId, 0x4800008FU);
+  EXPECT_FALSE(info.m_isCancel);
+  EXPECT_TRUE(info.m_isOutOfNetwork);
+  EXPECT_FALSE(info.m_isImmediate);
+  ASSERT_TRUE(info.m_ptsTime.has_value());
+  EXPECT_EQ(*info.m_ptsTime, 0x07369C02EULL);
+  ASSERT_TRUE(info.m_breakDuration.has_value());
+  EXPECT_EQ(*info.m_breakDuration, 0x0052CCF5ULL);
+  EXPECT_TRUE(info.m_isAutoReturn);
+  // The avail descriptor is not a segmentation descriptor
+  EXPECT_TRUE(info.m_segmentations.empty());
+
+  EXPECT_TRUE(SCTE35::IsAdStart(info));
+  EXPECT_FALSE(SCTE35::IsAdEnd(info));
+  EXPECT_EQ(SCTE35::GetAdDuration(info), 0x0052CCF5ULL);
+}
+
+TEST(Scte35Test, ParseTimeSignalSegmentation)
+{
+  const std::string section{BASE64::Decode(TIME_SIGNAL_B64)};
+  SCTE35::SpliceInfo info;
+  ASSERT_TRUE(SCTE35::ParseSpliceInfoSection(reinterpret_cast<const uint8_t*>(section.data()),
+                                             section.size(), info));
+
+  EXPECT_EQ(info.m_commandType, SCTE35::CommandType::TIME_SIGNAL);
+  ASSERT_TRUE(info.m_ptsTime.has_value());
+  EXPECT_EQ(*info.m_ptsTime, 0x072BD0050ULL);
+  ASSERT_EQ(info.m_segmentations.size(), 1U);
+  EXPECT_EQ(info.m_segmentations[0].m_eventId, 0x4800008EU);
+  EXPECT_EQ(info.m_segmentations[0].m_typeId, 0x34);
+  ASSERT_TRUE(info.m_segmentations[0].m_duration.has_value());
+  EXPECT_EQ(*info.m_segmentations[0].m_duration, 0x0001A599B0ULL);
+
+  EXPECT_TRUE(SCTE35::IsAdStart(info));
+  EXPECT_EQ(SCTE35::GetAdDuration(info), 0x0001A599B0ULL);
+}
+
+TEST(Scte35Test, ParseMalformed)
+{
+  const std::string section{BASE64::Decode(SPLICE_INSERT_B64)};
+  SCTE35::SpliceInfo info;
+  // Truncated section
+  EXPECT_FALSE(SCTE35::ParseSpliceInfoSection(reinterpret_cast<const uint8_t*>(section.data()),
+                                              20, info));
+  // Wrong table id
+  std::string wrongTable{section};
+  wrongTable[0] = 0x02;
+  EXPECT_FALSE(SCTE35::ParseSpliceInfoSection(
+      reinterpret_cast<const uint8_t*>(wrongTable.data()), wrongTable.size(), info));
+}
+
+TEST(TimedEventsTest, ApplySpliceInfo)
+{
+  TimedEvent event;
+  ASSERT_TRUE(ApplySpliceInfo(event, BASE64::Decode(SPLICE_INSERT_B64)));
+  EXPECT_EQ(event.m_type, TimedEventType::AD_START);
+  // 5426421 ticks of 90 kHz
+  EXPECT_EQ(event.m_duration, 60293566U);
+
+  TimedEvent invalidEvent;
+  EXPECT_FALSE(ApplySpliceInfo(invalidEvent, "invalid"));
+  EXPECT_EQ(invalidEvent.m_type, TimedEventType::METADATA);
+}
+
+TEST(TimedEventsTest, QueueDeliverDueEventsOnce)
+{
+  CTimedEventQueue queue;
+  EXPECT_TRUE(queue.Add(MakeEvent("2", 10500000)));
+  EXPECT_TRUE(queue.Add(MakeEvent("1", 10000000)));
+  // Repeated by an other segment or manifest update
+  EXPECT_FALSE(queue.Add(MakeEvent("1", 10000000)));
+  EXPECT_EQ(queue.GetCount(), 2U);
+
+  EXPECT_TRUE(queue.TakeDueEvents(9000000, 0).empty());
+
+  std::vector<TimedEvent> events{queue.TakeDueEvents(11000000, 0)};
+  ASSERT_EQ(events.size(), 2U);
+  EXPECT_EQ(events[0].m_id, "1");
+  EXPECT_EQ(events[1].m_id, "2");
+  EXPECT_EQ(queue.GetCount(), 0U);
+
+  // Delivered events are not added again
+  EXPECT_FALSE(queue.Add(MakeEvent("1", 10000000)));
+  EXPECT_TRUE(queue.TakeDueEvents(30000000, 0).empty());
+}
+
+TEST(TimedEventsTest, QueueManifestTimeAndStaleEvents)
+{
+  CTimedEventQueue queue;
+  queue.Add(MakeEvent("manifest", 5000000, true));
+  queue.Add(MakeEvent("stale", 1000000));
+
+  // The manifest time is converted to the stream PTS timeline
+  std::vector<TimedEvent> events{queue.TakeDueEvents(104000000, 100000000)};
+  EXPECT_TRUE(events.empty());
+  // The stale event has been discarded
+  EXPECT_EQ(queue.GetCount(), 1U);
+
+  events = queue.TakeDueEvents(105000000, 100000000);
+  ASSERT_EQ(events.size(), 1U);
+  EXPECT_EQ(events[0].m_id, "manifest");
+  EXPECT_EQ(events[0].m_time, 105000000U);
+  EXPECT_FALSE(events[0].m_isManifestTime);
+}
+
+TEST(TimedEventsTest, CreateID3Tag)
+{
+  TimedEvent event{MakeEvent("7", 0)};
+  event.m_type = TimedEventType::AD_START;
+  event.m_duration = 30000000;
+  event.m_messageData = std::string("\x01\x00\x02", 3);
+
+  const std::string tag{CreateID3Tag(event)};
+  ASSERT_GT(tag.size(), 10U);
+  EXPECT_EQ(tag.substr(0, 5), std::string("ID3\x04\x00", 5));
+
+  const size_t framesSize{(static_cast<size_t>(tag[6]) << 21) |
+                          (static_cast<size_t>(tag[7]) << 14) |
+                          (static_cast<size_t>(tag[8]) << 7) | static_cast<size_t>(tag[9])};
+  EXPECT_EQ(framesSize, tag.size() - 10);
+
+  EXPECT_NE(tag.find(std::string("\x03type\0ad_start", 14)), std::string::npos);
+  EXPECT_NE(tag.find(std::string("\x03" "duration\0" "30000", 15)), std::string::npos);
+  EXPECT_NE(tag.find(std::string("PRIV")), std::string::npos);
+  EXPECT_NE(tag.find(std::string("urn:test\0\x01\x00\x02", 12)), std::string::npos);
+}
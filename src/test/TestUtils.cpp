@@ -9,6 +9,7 @@
 #include "TestHelper.h"
 
 #include "../utils/UrlUtils.h"
+#include "../utils/Utils.h"
 
 #include <gtest/gtest.h>
 
@@ -136,3 +137,13 @@ TEST_F(UtilsTest, JoinUrls)
   otherUrl = "../../../ending";
   EXPECT_EQ(URL::Join(baseUrl, otherUrl), "../../../ending");
 }
+
+TEST_F(UtilsTest, GetVideoCodecFamily)
+{
+  EXPECT_EQ(GetVideoCodecFamily("avc1.64001f"), "h264");
+  EXPECT_EQ(GetVideoCodecFamily("hvc1.2.4.L120.90"), "hevc");
+  EXPECT_EQ(GetVideoCodecFamily("dvh1.05.06"), "hevc");
+  EXPECT_EQ(GetVideoCodecFamily("vp09.00.10.08"), "vp9");
+  EXPECT_EQ(GetVideoCodecFamily("av01.0.08M.08"), "av1");
+  EXPECT_EQ(GetVideoCodecFamily("mp4a.40.2"), "");
+}
@@ -0,0 +1,94 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include "../../common/AdaptiveTree.h"
+#include "../../common/ChooserDefault.h"
+#include "../../utils/PropertiesUtils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace FUZZ
+{
+/*!
+ * \brief Adaptive tree that serves the fuzzer input as response of every
+ *        download request (manifest and child playlists), manifest updates
+ *        are disabled because they would start the update thread.
+ */
+template<class TreeType>
+class ATTR_DLL_LOCAL CFuzzTree : public TreeType
+{
+public:
+  CFuzzTree(CHOOSER::IRepresentationChooser* reprChooser, std::string_view data)
+    : TreeType(reprChooser), m_data{data}
+  {
+  }
+
+protected:
+  bool Download(std::string_view url,
+                const std::map<std::string, std::string>& addHeaders,
+                std::string& data,
+                adaptive::HTTPRespHeaders& respHeaders) override
+  {
+    data = m_data;
+    respHeaders.m_effectiveUrl = url;
+    return true;
+  }
+
+  bool DownloadManifest(std::string url,
+                        const std::map<std::string, std::string>& addHeaders,
+                        std::string& data,
+                        adaptive::HTTPRespHeaders& respHeaders) override
+  {
+    return Download(url, addHeaders, data, respHeaders);
+  }
+
+  void StartUpdateThread() override {}
+
+private:
+  std::string_view m_data;
+};
+
+/*!
+ * \brief Open the fuzzer input as manifest of the specified tree type, then
+ *        prepare all the representations to parse also the child playlists.
+ * \param data The fuzzer input data
+ * \param size The fuzzer input size
+ * \param url The manifest url, the extension matters for some parsers
+ */
+template<class TreeType>
+void OpenManifest(const uint8_t* data, size_t size, const std::string& url)
+{
+  UTILS::PROPERTIES::KodiProperties kodiProps;
+  CHOOSER::CRepresentationChooserDefault reprChooser;
+
+  CFuzzTree<TreeType> tree{&reprChooser,
+                           std::string_view(reinterpret_cast<const char*>(data), size)};
+  tree.Configure(kodiProps);
+
+  if (!tree.open(url))
+    return;
+
+  for (auto& period : tree.m_periods)
+  {
+    for (auto& adpSet : period->GetAdaptationSets())
+    {
+      for (auto& repr : adpSet->GetRepresentations())
+      {
+        tree.prepareRepresentation(period.get(), adpSet.get(), repr.get());
+      }
+    }
+  }
+}
+
+} // namespace FUZZ
@@ -0,0 +1,32 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../../ADTSReader.h"
+
+#include <bento4/Ap4.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace
+{
+// Prevent endless loops on inputs that make the reader stuck
+constexpr int MAX_ADTS_PACKETS = 100000;
+} // unnamed namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  AP4_MemoryByteStream* stream = new AP4_MemoryByteStream(data, static_cast<AP4_Size>(size));
+  {
+    ADTSReader reader{stream};
+    for (int packets{0}; packets < MAX_ADTS_PACKETS && reader.ReadPacket(); ++packets)
+      ;
+  }
+  stream->Release();
+  return 0;
+}
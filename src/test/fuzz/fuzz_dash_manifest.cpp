@@ -0,0 +1,16 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../../parser/DASHTree.h"
+#include "FuzzHelper.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  FUZZ::OpenManifest<adaptive::CDashTree>(data, size, "http://foo.bar/manifest.mpd");
+  return 0;
+}
@@ -0,0 +1,16 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../../parser/HLSTree.h"
+#include "FuzzHelper.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  FUZZ::OpenManifest<adaptive::CHLSTree>(data, size, "http://foo.bar/master.m3u8");
+  return 0;
+}
@@ -0,0 +1,56 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../../common/AdaptiveStream.h"
+#include "../../parser/DASHTree.h"
+#include "FuzzHelper.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+using namespace PLAYLIST;
+
+namespace
+{
+/*!
+ * \brief Expose the SIDX index range parser of the adaptive stream,
+ *        the WebM cues are covered by the webm_parser fuzzer.
+ */
+class ATTR_DLL_LOCAL CFuzzAdaptiveStream : public adaptive::AdaptiveStream
+{
+public:
+  using adaptive::AdaptiveStream::AdaptiveStream;
+
+  bool ParseIndexRange(CRepresentation* rep, const std::string& buffer)
+  {
+    return parseIndexRange(rep, buffer);
+  }
+};
+} // unnamed namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  if (size < 1)
+    return 0;
+
+  UTILS::PROPERTIES::KodiProperties kodiProps;
+  CHOOSER::CRepresentationChooserDefault reprChooser;
+  FUZZ::CFuzzTree<adaptive::CDashTree> tree{&reprChooser, {}};
+
+  CAdaptationSet adpSet;
+  CRepresentation repr{&adpSet};
+  repr.SetContainerType(ContainerType::MP4);
+  // The first byte select if the buffer start with the initialization (MOOV)
+  // or directly with the SIDX atoms at the given index range offset
+  repr.m_segBaseIndexRangeMin = data[0] & 1 ? 0 : data[0];
+
+  CFuzzAdaptiveStream stream{tree, &adpSet, &repr, kodiProps, false};
+  stream.ParseIndexRange(&repr, std::string(reinterpret_cast<const char*>(data + 1), size - 1));
+  return 0;
+}
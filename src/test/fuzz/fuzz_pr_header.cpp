@@ -0,0 +1,21 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../../parser/PRProtectionParser.h"
+#include "../../utils/Base64Utils.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// The fuzzer input is the decoded PlayReady object, the parser accept it as base64
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  adaptive::PRProtectionParser parser;
+  parser.ParseHeader(UTILS::BASE64::Encode(data, size));
+  return 0;
+}
@@ -0,0 +1,76 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../../../lib/mpegts/tsDemuxer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+// Prevent endless loops on inputs that make the demuxer go back
+constexpr int MAX_TS_PACKETS = 100000;
+
+class CFuzzTSDemuxer : public TSDemux::TSDemuxer
+{
+public:
+  CFuzzTSDemuxer(const uint8_t* data, size_t size) : m_data{data}, m_size{size} {}
+
+  bool ReadAV(uint64_t pos, unsigned char* data, size_t len) override
+  {
+    if (pos > m_size || m_size - pos < len)
+      return false;
+    std::memcpy(data, m_data + pos, len);
+    return true;
+  }
+
+private:
+  const uint8_t* m_data;
+  size_t m_size;
+};
+} // unnamed namespace
+
+// Demux loop as done by TSReader::ReadPacket, all the streams are enabled
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  CFuzzTSDemuxer demuxer{data, size};
+  TSDemux::AVContext context{&demuxer, 0, 0};
+  TSDemux::STREAM_PKT pkt;
+
+  for (int packets{0}; packets < MAX_TS_PACKETS; ++packets)
+  {
+    if (context.TSResync() != TSDemux::AVCONTEXT_CONTINUE)
+      break;
+
+    int status = context.ProcessTSPacket();
+
+    while (context.HasPIDStreamData())
+    {
+      TSDemux::ElementaryStream* es = context.GetPIDStream();
+      if (!es || !es->GetStreamPacket(&pkt))
+        break;
+    }
+
+    if (context.HasPIDPayload())
+    {
+      status = context.ProcessTSPayload();
+      if (status == TSDemux::AVCONTEXT_PROGRAM_CHANGE)
+      {
+        for (TSDemux::ElementaryStream* es : context.GetStreams())
+          context.StartStreaming(es->pid);
+      }
+    }
+
+    if (status == TSDemux::AVCONTEXT_TS_ERROR)
+      context.Shift();
+    else
+      context.GoNext();
+  }
+  return 0;
+}
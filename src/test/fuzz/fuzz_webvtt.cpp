@@ -0,0 +1,26 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../../codechandler/WebVTTCodecHandler.h"
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  WebVTTCodecHandler codecHandler{nullptr, true};
+  AP4_DataBuffer buffer{data, static_cast<AP4_Size>(size)};
+  if (codecHandler.Transform(0, 0, buffer, 1000))
+  {
+    AP4_Sample sample;
+    AP4_DataBuffer sampleData;
+    while (codecHandler.ReadNextSample(sample, sampleData))
+      ;
+  }
+  return 0;
+}
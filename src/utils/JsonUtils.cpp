@@ -0,0 +1,354 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "JsonUtils.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+using namespace UTILS::JSON;
+
+namespace
+{
+// Max nesting of arrays and objects, to not overflow the stack on malicious data
+constexpr int MAX_DEPTH = 64;
+
+class CParser
+{
+public:
+  CParser(std::string_view data) : m_data{data} {}
+
+  bool ParseDocument(Value& value, bool allowTrailingData)
+  {
+    if (!ParseValue(value, 0))
+      return false;
+    SkipWhitespaces();
+    return allowTrailingData || m_pos == m_data.size();
+  }
+
+private:
+  void SkipWhitespaces()
+  {
+    while (m_pos < m_data.size() && (m_data[m_pos] == ' ' || m_data[m_pos] == '\t' ||
+                                     m_data[m_pos] == '\n' || m_data[m_pos] == '\r'))
+    {
+      ++m_pos;
+    }
+  }
+
+  bool Consume(std::string_view token)
+  {
+    if (m_data.substr(m_pos, token.size()) != token)
+      return false;
+    m_pos += token.size();
+    return true;
+  }
+
+  bool ParseValue(Value& value, int depth)
+  {
+    if (depth > MAX_DEPTH)
+      return false;
+
+    SkipWhitespaces();
+    if (m_pos >= m_data.size())
+      return false;
+
+    switch (m_data[m_pos])
+    {
+      case '{':
+        return ParseObject(value, depth);
+      case '[':
+        return ParseArray(value, depth);
+      case '"':
+        value.m_type = ValueType::STRING;
+        return ParseString(value.m_string);
+      case 't':
+        value.m_type = ValueType::BOOLEAN;
+        value.m_boolean = true;
+        return Consume("true");
+      case 'f':
+        value.m_type = ValueType::BOOLEAN;
+        return Consume("false");
+      case 'n':
+        return Consume("null");
+      default:
+        return ParseNumber(value);
+    }
+  }
+
+  bool ParseObject(Value& value, int depth)
+  {
+    value.m_type = ValueType::OBJECT;
+    ++m_pos; // {
+    SkipWhitespaces();
+    if (Consume("}"))
+      return true;
+
+    while (true)
+    {
+      SkipWhitespaces();
+      std::string name;
+      if (m_pos >= m_data.size() || m_data[m_pos] != '"' || !ParseString(name))
+        return false;
+
+      SkipWhitespaces();
+      if (!Consume(":"))
+        return false;
+
+      Value member;
+      if (!ParseValue(member, depth + 1))
+        return false;
+      value.m_object.emplace_back(std::move(name), std::move(member));
+
+      SkipWhitespaces();
+      if (Consume("}"))
+        return true;
+      if (!Consume(","))
+        return false;
+    }
+  }
+
+  bool ParseArray(Value& value, int depth)
+  {
+    value.m_type = ValueType::ARRAY;
+    ++m_pos; // [
+    SkipWhitespaces();
+    if (Consume("]"))
+      return true;
+
+    while (true)
+    {
+      Value item;
+      if (!ParseValue(item, depth + 1))
+        return false;
+      value.m_array.emplace_back(std::move(item));
+
+      SkipWhitespaces();
+      if (Consume("]"))
+        return true;
+      if (!Consume(","))
+        return false;
+    }
+  }
+
+  bool ParseHex4(uint32_t& code)
+  {
+    if (m_pos + 4 > m_data.size())
+      return false;
+
+    code = 0;
+    for (size_t i{0}; i < 4; ++i)
+    {
+      const char ch{m_data[m_pos++]};
+      code <<= 4;
+      if (ch >= '0' && ch <= '9')
+        code |= ch - '0';
+      else if (ch >= 'a' && ch <= 'f')
+        code |= ch - 'a' + 10;
+      else if (ch >= 'A' && ch <= 'F')
+        code |= ch - 'A' + 10;
+      else
+        return false;
+    }
+    return true;
+  }
+
+  static void AppendUtf8(std::string& str, uint32_t code)
+  {
+    if (code < 0x80)
+      str.push_back(static_cast<char>(code));
+    else if (code < 0x800)
+    {
+      str.push_back(static_cast<char>(0xC0 | (code >> 6)));
+      str.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+    else if (code < 0x10000)
+    {
+      str.push_back(static_cast<char>(0xE0 | (code >> 12)));
+      str.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+      str.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+    else
+    {
+      str.push_back(static_cast<char>(0xF0 | (code >> 18)));
+      str.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+      str.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+      str.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+  }
+
+  bool ParseString(std::string& str)
+  {
+    ++m_pos; // "
+    while (m_pos < m_data.size())
+    {
+      const char ch{m_data[m_pos++]};
+      if (ch == '"')
+        return true;
+      if (static_cast<unsigned char>(ch) < 0x20)
+        return false;
+      if (ch != '\\')
+      {
+        str.push_back(ch);
+        continue;
+      }
+
+      if (m_pos >= m_data.size())
+        return false;
+
+      switch (m_data[m_pos++])
+      {
+        case '"':
+          str.push_back('"');
+          break;
+        case '\\':
+          str.push_back('\\');
+          break;
+        case '/':
+          str.push_back('/');
+          break;
+        case 'b':
+          str.push_back('\b');
+          break;
+        case 'f':
+          str.push_back('\f');
+          break;
+        case 'n':
+          str.push_back('\n');
+          break;
+        case 'r':
+          str.push_back('\r');
+          break;
+        case 't':
+          str.push_back('\t');
+          break;
+        case 'u':
+        {
+          uint32_t code;
+          if (!ParseHex4(code))
+            return false;
+          // Surrogate pair
+          if (code >= 0xD800 && code <= 0xDBFF)
+          {
+            uint32_t lowCode;
+            if (!Consume("\\u") || !ParseHex4(lowCode) || lowCode < 0xDC00 || lowCode > 0xDFFF)
+              return false;
+            code = 0x10000 + ((code - 0xD800) << 10) + (lowCode - 0xDC00);
+          }
+          AppendUtf8(str, code);
+          break;
+        }
+        default:
+          return false;
+      }
+    }
+    return false;
+  }
+
+  bool ParseNumber(Value& value)
+  {
+    const size_t startPos{m_pos};
+    while (m_pos < m_data.size() &&
+           std::string_view("+-0123456789.eE").find(m_data[m_pos]) != std::string_view::npos)
+    {
+      ++m_pos;
+    }
+    if (m_pos == startPos)
+      return false;
+
+    const std::string number{m_data.substr(startPos, m_pos - startPos)};
+    char* endPtr{nullptr};
+    value.m_type = ValueType::NUMBER;
+    value.m_number = std::strtod(number.c_str(), &endPtr);
+    return endPtr == number.c_str() + number.size();
+  }
+
+  std::string_view m_data;
+  size_t m_pos{0};
+};
+} // unnamed namespace
+
+const Value* UTILS::JSON::Value::Get(std::string_view name) const
+{
+  if (m_type != ValueType::OBJECT)
+    return nullptr;
+
+  auto it = std::find_if(m_object.cbegin(), m_object.cend(),
+                         [&name](const auto& member) { return member.first == name; });
+  return it != m_object.cend() ? &it->second : nullptr;
+}
+
+std::string UTILS::JSON::Value::GetString(std::string_view name) const
+{
+  const Value* value{Get(name)};
+  return value && value->m_type == ValueType::STRING ? value->m_string : "";
+}
+
+double UTILS::JSON::Value::GetNumber(std::string_view name, double defaultValue) const
+{
+  const Value* value{Get(name)};
+  return value && value->m_type == ValueType::NUMBER ? value->m_number : defaultValue;
+}
+
+const Value* UTILS::JSON::Value::Find(std::string_view name) const
+{
+  for (const auto& [memberName, member] : m_object)
+  {
+    if (memberName == name)
+      return &member;
+    const Value* value{member.Find(name)};
+    if (value)
+      return value;
+  }
+  for (const Value& item : m_array)
+  {
+    const Value* value{item.Find(name)};
+    if (value)
+      return value;
+  }
+  return nullptr;
+}
+
+const Value* UTILS::JSON::Value::GetPath(std::string_view path) const
+{
+  const Value* value{this};
+  size_t start{0};
+
+  while (value && start <= path.size())
+  {
+    size_t end{path.find('/', start)};
+    if (end == std::string_view::npos)
+      end = path.size();
+    const std::string_view name{path.substr(start, end - start)};
+    start = end + 1;
+
+    if (name.empty())
+      continue;
+
+    if (value->m_type == ValueType::ARRAY)
+    {
+      if (!std::all_of(name.cbegin(), name.cend(), [](char ch) { return ch >= '0' && ch <= '9'; }))
+        return nullptr;
+      const size_t index{std::strtoul(std::string(name).c_str(), nullptr, 10)};
+      value = index < value->m_array.size() ? &value->m_array[index] : nullptr;
+    }
+    else
+    {
+      value = value->Get(name);
+    }
+  }
+  return value;
+}
+
+bool UTILS::JSON::Parse(std::string_view data, Value& value, bool allowTrailingData)
+{
+  value = Value();
+  CParser parser{data};
+  return parser.ParseDocument(value, allowTrailingData);
+}
@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace UTILS
+{
+namespace JSON
+{
+
+enum class ValueType
+{
+  NUL,
+  BOOLEAN,
+  NUMBER,
+  STRING,
+  ARRAY,
+  OBJECT,
+};
+
+/*!
+ * \brief A parsed JSON value, only the member of the value type is set.
+ */
+struct Value
+{
+  ValueType m_type{ValueType::NUL};
+  bool m_boolean{false};
+  double m_number{0};
+  std::string m_string;
+  std::vector<Value> m_array;
+  std::vector<std::pair<std::string, Value>> m_object; // Members in document order
+
+  /*!
+   * \brief Get an object member.
+   * \param name The member name
+   * \return The member value, or nullptr if not found or the value is not an object
+   */
+  const Value* Get(std::string_view name) const;
+
+  /*!
+   * \brief Get the string of an object member.
+   * \return The string, or empty if not found or the member is not a string
+   */
+  std::string GetString(std::string_view name) const;
+
+  /*!
+   * \brief Get the number of an object member.
+   * \return The number, or the default value if not found or the member is not a number
+   */
+  double GetNumber(std::string_view name, double defaultValue = 0) const;
+
+  /*!
+   * \brief Find the first object member with the specified name at any depth,
+   *        in document order.
+   * \param name The member name
+   * \return The member value, or nullptr if not found
+   */
+  const Value* Find(std::string_view name) const;
+
+  /*!
+   * \brief Get a value from the object member names and array indexes of a path,
+   *        separated by "/" (e.g. "data/licenses/0/license").
+   * \param path The path from this value
+   * \return The value, or nullptr if not found
+   */
+  const Value* GetPath(std::string_view path) const;
+};
+
+/*!
+ * \brief Parse a JSON document (RFC 8259).
+ * \param data The JSON data
+ * \param value [OUT] The root value
+ * \param allowTrailingData Ignore the data after the root value, some license
+ *                          servers append garbage to the JSON response
+ * \return True if success, otherwise false on malformed data
+ */
+bool Parse(std::string_view data, Value& value, bool allowTrailingData = false);
+
+} // namespace JSON
+} // namespace UTILS
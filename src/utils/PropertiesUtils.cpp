@@ -12,10 +12,12 @@
 #include "StringUtils.h"
 #include "Utils.h"
 #include "log.h"
+#include "kodi/tools/StringUtils.h"
 
 #include <string_view>
 
 using namespace UTILS::PROPERTIES;
+using namespace kodi::tools;
 
 namespace
 {
@@ -38,13 +40,31 @@ constexpr std::string_view PROP_AUDIO_LANG_ORIG = "inputstream.adaptive.original
 constexpr std::string_view PROP_PLAY_TIMESHIFT_BUFFER = "inputstream.adaptive.play_timeshift_buffer";
 constexpr std::string_view PROP_LIVE_DELAY = "inputstream.adaptive.live_delay";
 constexpr std::string_view PROP_PRE_INIT_DATA = "inputstream.adaptive.pre_init_data";
+constexpr std::string_view PROP_TIMED_METADATA = "inputstream.adaptive.timed_metadata";
+constexpr std::string_view PROP_AUDIO_ONLY = "inputstream.adaptive.audio_only";
 
 // Chooser's properties
 constexpr std::string_view PROP_STREAM_SELECTION_TYPE = "inputstream.adaptive.stream_selection_type";
 constexpr std::string_view PROP_CHOOSER_BANDWIDTH_MAX = "inputstream.adaptive.chooser_bandwidth_max";
 constexpr std::string_view PROP_CHOOSER_RES_MAX = "inputstream.adaptive.chooser_resolution_max";
 constexpr std::string_view PROP_CHOOSER_RES_SECURE_MAX = "inputstream.adaptive.chooser_resolution_secure_max";
+constexpr std::string_view PROP_CHOOSER_VIDEO_CODECS = "inputstream.adaptive.chooser_video_codecs";
+constexpr std::string_view PROP_CHOOSER_VIDEO_CODECS_SECURE = "inputstream.adaptive.chooser_video_codecs_secure";
 // clang-format on
+
+// Parse a comma separated list of codec families e.g. "h264,hevc"
+std::set<std::string> ParseCodecList(const std::string& value)
+{
+  std::set<std::string> codecs;
+  for (std::string codec : UTILS::STRING::Split(value, ','))
+  {
+    StringUtils::Trim(codec);
+    StringUtils::ToLower(codec);
+    if (!codec.empty())
+      codecs.emplace(codec);
+  }
+  return codecs;
+}
 } // unnamed namespace
 
 KodiProperties UTILS::PROPERTIES::ParseKodiProperties(
@@ -76,6 +96,8 @@ KodiProperties UTILS::PROPERTIES::ParseKodiProperties(
         props.m_isLicensePersistentStorage = true;
       if (prop.second.find("force_secure_decoder") != std::string::npos)
         props.m_isLicenseForceSecureDecoder = true;
+      if (prop.second.find("wait_license") != std::string::npos)
+        props.m_isLicenseDeferred = false;
     }
     else if (prop.first == PROP_SERVER_CERT)
     {
@@ -130,6 +152,14 @@ KodiProperties UTILS::PROPERTIES::ParseKodiProperties(
       props.m_drmPreInitData = prop.second;
       logPropValRedacted = true;
     }
+    else if (prop.first == PROP_TIMED_METADATA)
+    {
+      props.m_isTimedMetadata = STRING::CompareNoCase(prop.second, "true");
+    }
+    else if (prop.first == PROP_AUDIO_ONLY)
+    {
+      props.m_isAudioOnly = STRING::CompareNoCase(prop.second, "true");
+    }
     else if (prop.first == PROP_STREAM_SELECTION_TYPE)
     {
       props.m_streamSelectionType = prop.second;
@@ -154,6 +184,14 @@ KodiProperties UTILS::PROPERTIES::ParseKodiProperties(
       else
         LOG::Log(LOGERROR, "Resolution not valid on \"%s\" property.", prop.first.c_str());
     }
+    else if (prop.first == PROP_CHOOSER_VIDEO_CODECS)
+    {
+      props.m_chooserProps.m_videoCodecs = ParseCodecList(prop.second);
+    }
+    else if (prop.first == PROP_CHOOSER_VIDEO_CODECS_SECURE)
+    {
+      props.m_chooserProps.m_videoCodecsSecure = ParseCodecList(prop.second);
+    }
     else
     {
       LOG::Log(LOGWARNING, "Property found \"%s\" is not supported", prop.first.c_str());
@@ -10,6 +10,7 @@
 
 #include <cstdint>
 #include <map>
+#include <set>
 #include <string>
 #include <utility>
 
@@ -31,6 +32,10 @@ struct ChooserProps
   uint32_t m_bandwidthMax{0};
   std::pair<int, int> m_resolutionMax; // Res. limit for non-protected videos
   std::pair<int, int> m_resolutionSecureMax; // Res. limit for DRM protected videos
+  // Video codecs supported by the decoder, as codec family e.g. "hevc", empty for all codecs
+  std::set<std::string> m_videoCodecs;
+  // Video codecs supported by the secure decoder, if empty the m_videoCodecs apply
+  std::set<std::string> m_videoCodecsSecure;
 };
 
 struct KodiProperties
@@ -40,6 +45,11 @@ struct KodiProperties
   std::string m_licenseData;
   bool m_isLicensePersistentStorage{false};
   bool m_isLicenseForceSecureDecoder{false};
+  // Dont wait the license before starting playback, it is requested in background
+  // and the samples of a clear lead are played meanwhile. The decrypter capabilities
+  // are refreshed once the license is acquired. Can be disabled with the
+  // "wait_license" license flag
+  bool m_isLicenseDeferred{true};
   std::string m_serverCertificate;
   ManifestType m_manifestType{ManifestType::UNKNOWN};
   // Can be used to force enable manifest updates,
@@ -57,6 +67,11 @@ struct KodiProperties
   bool m_playTimeshiftBuffer{false};
   // Set a custom delay from live edge in seconds
   uint64_t m_liveDelay{0};
+  // Expose the timed events (e.g. ad markers) as a timed metadata stream of ID3 tags
+  bool m_isTimedMetadata{false};
+  // Play the audio only e.g. in background, the video downloads are suspended
+  // for the whole playback, the mode is set only when the stream is opened
+  bool m_isAudioOnly{false};
   // PSSH/KID used to "pre-initialize" the DRM, the property value must be as
   // "{PSSH as base64}|{KID as base64}". The challenge/session ID data generated
   // by the initialisation of the DRM will be attached to the manifest request
@@ -0,0 +1,254 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "Scte35Utils.h"
+
+#include <algorithm>
+
+using namespace UTILS::SCTE35;
+
+namespace
+{
+constexpr uint64_t PTS_MASK = 0x1FFFFFFFFULL; // 33 bits
+constexpr uint8_t SEGMENTATION_DESCRIPTOR_TAG = 0x02;
+constexpr uint32_t CUEI_IDENTIFIER = 0x43554549;
+
+// segmentation_type_id values of the ad break boundaries
+constexpr uint8_t AD_START_TYPES[] = {
+    0x22, // Break Start
+    0x30, // Provider Advertisement Start
+    0x32, // Distributor Advertisement Start
+    0x34, // Provider Placement Opportunity Start
+    0x36, // Distributor Placement Opportunity Start
+};
+constexpr uint8_t AD_END_TYPES[] = {0x23, 0x31, 0x33, 0x35, 0x37};
+
+// Big endian bit reader, the reads past the end of data fail the reader
+class CBitReader
+{
+public:
+  CBitReader(const uint8_t* data, size_t size) : m_data{data}, m_size{size} {}
+
+  uint64_t Read(int bits)
+  {
+    uint64_t value{0};
+    for (int i{0}; i < bits; ++i)
+    {
+      if (m_pos >= m_size * 8)
+      {
+        m_isFailed = true;
+        return 0;
+      }
+      value = (value << 1) | ((m_data[m_pos / 8] >> (7 - m_pos % 8)) & 1);
+      ++m_pos;
+    }
+    return value;
+  }
+
+  void Skip(size_t bits) { m_pos += bits; }
+  size_t GetBytePos() const { return m_pos / 8; }
+  void SetBytePos(size_t pos) { m_pos = pos * 8; }
+  bool IsFailed() const { return m_isFailed || m_pos > m_size * 8; }
+
+private:
+  const uint8_t* m_data;
+  size_t m_size;
+  size_t m_pos{0};
+  bool m_isFailed{false};
+};
+
+std::optional<uint64_t> ReadSpliceTime(CBitReader& reader)
+{
+  if (reader.Read(1) == 0) // time_specified_flag
+  {
+    reader.Skip(7);
+    return std::nullopt;
+  }
+  reader.Skip(6);
+  return reader.Read(33);
+}
+
+void ParseSpliceInsert(CBitReader& reader, SpliceInfo& info)
+{
+  info.m_eventId = static_cast<uint32_t>(reader.Read(32));
+  info.m_isCancel = reader.Read(1) == 1;
+  reader.Skip(7);
+  if (info.m_isCancel)
+    return;
+
+  info.m_isOutOfNetwork = reader.Read(1) == 1;
+  const bool isProgramSplice{reader.Read(1) == 1};
+  const bool hasDuration{reader.Read(1) == 1};
+  info.m_isImmediate = reader.Read(1) == 1;
+  reader.Skip(4);
+
+  if (isProgramSplice && !info.m_isImmediate)
+    info.m_ptsTime = ReadSpliceTime(reader);
+
+  if (!isProgramSplice)
+  {
+    const uint64_t componentCount{reader.Read(8)};
+    for (uint64_t i{0}; i < componentCount; ++i)
+    {
+      reader.Skip(8); // component_tag
+      if (!info.m_isImmediate)
+      {
+        // The component splice times are not handled, the first one is used
+        std::optional<uint64_t> ptsTime{ReadSpliceTime(reader)};
+        if (!info.m_ptsTime)
+          info.m_ptsTime = ptsTime;
+      }
+    }
+  }
+
+  if (hasDuration)
+  {
+    info.m_isAutoReturn = reader.Read(1) == 1;
+    reader.Skip(6);
+    info.m_breakDuration = reader.Read(33);
+  }
+}
+
+void ParseSegmentationDescriptor(CBitReader& reader, SpliceInfo& info)
+{
+  SegmentationDescriptor segmentation;
+  segmentation.m_eventId = static_cast<uint32_t>(reader.Read(32));
+  segmentation.m_isCancel = reader.Read(1) == 1;
+  reader.Skip(7);
+
+  if (!segmentation.m_isCancel)
+  {
+    const bool isProgramSegmentation{reader.Read(1) == 1};
+    const bool hasDuration{reader.Read(1) == 1};
+    reader.Skip(6); // delivery_not_restricted_flag and restrictions
+
+    if (!isProgramSegmentation)
+    {
+      const uint64_t componentCount{reader.Read(8)};
+      reader.Skip(componentCount * 48); // component_tag + reserved + pts_offset
+    }
+    if (hasDuration)
+      segmentation.m_duration = reader.Read(40);
+
+    reader.Skip(8); // segmentation_upid_type
+    const uint64_t upidLength{reader.Read(8)};
+    reader.Skip(upidLength * 8);
+    segmentation.m_typeId = static_cast<uint8_t>(reader.Read(8));
+  }
+
+  if (!reader.IsFailed())
+    info.m_segmentations.emplace_back(segmentation);
+}
+} // unnamed namespace
+
+bool UTILS::SCTE35::ParseSpliceInfoSection(const uint8_t* data, size_t size, SpliceInfo& info)
+{
+  info = SpliceInfo();
+
+  CBitReader reader{data, size};
+  if (reader.Read(8) != TABLE_ID)
+    return false;
+
+  reader.Skip(4); // section_syntax_indicator, private_indicator, sap_type
+  const size_t sectionLength{static_cast<size_t>(reader.Read(12))};
+  if (sectionLength + 3 > size)
+    return false;
+
+  reader.Skip(8); // protocol_version
+  info.m_isEncrypted = reader.Read(1) == 1;
+  reader.Skip(6); // encryption_algorithm
+  info.m_ptsAdjustment = reader.Read(33);
+  reader.Skip(8 + 12); // cw_index, tier
+  const size_t commandLength{static_cast<size_t>(reader.Read(12))};
+  info.m_commandType = static_cast<CommandType>(reader.Read(8));
+
+  if (reader.IsFailed())
+    return false;
+
+  // The encrypted part start from the splice command
+  if (info.m_isEncrypted)
+    return true;
+
+  const size_t commandPos{reader.GetBytePos()};
+
+  if (info.m_commandType == CommandType::SPLICE_INSERT)
+    ParseSpliceInsert(reader, info);
+  else if (info.m_commandType == CommandType::TIME_SIGNAL)
+    info.m_ptsTime = ReadSpliceTime(reader);
+
+  if (info.m_ptsTime)
+    info.m_ptsTime = (*info.m_ptsTime + info.m_ptsAdjustment) & PTS_MASK;
+
+  // The legacy value 0xFFF means that the command length is not specified
+  if (commandLength != 0xFFF)
+    reader.SetBytePos(commandPos + commandLength);
+
+  const size_t descriptorsLength{static_cast<size_t>(reader.Read(16))};
+  const size_t descriptorsEnd{reader.GetBytePos() + descriptorsLength};
+  if (reader.IsFailed() || descriptorsEnd > size)
+    return false;
+
+  while (reader.GetBytePos() + 2 <= descriptorsEnd)
+  {
+    const uint8_t tag{static_cast<uint8_t>(reader.Read(8))};
+    const size_t length{static_cast<size_t>(reader.Read(8))};
+    const size_t nextPos{reader.GetBytePos() + length};
+    if (nextPos > descriptorsEnd)
+      return false;
+
+    if (tag == SEGMENTATION_DESCRIPTOR_TAG && length >= 4 && reader.Read(32) == CUEI_IDENTIFIER)
+    {
+      CBitReader descReader{data + reader.GetBytePos(), nextPos - reader.GetBytePos()};
+      ParseSegmentationDescriptor(descReader, info);
+    }
+    reader.SetBytePos(nextPos);
+  }
+
+  return !reader.IsFailed();
+}
+
+bool UTILS::SCTE35::IsAdStart(const SpliceInfo& info)
+{
+  if (info.m_commandType == CommandType::SPLICE_INSERT && !info.m_isCancel &&
+      info.m_isOutOfNetwork)
+    return true;
+
+  return std::any_of(info.m_segmentations.cbegin(), info.m_segmentations.cend(),
+                     [](const SegmentationDescriptor& segmentation) {
+                       return !segmentation.m_isCancel &&
+                              std::find(std::begin(AD_START_TYPES), std::end(AD_START_TYPES),
+                                        segmentation.m_typeId) != std::end(AD_START_TYPES);
+                     });
+}
+
+bool UTILS::SCTE35::IsAdEnd(const SpliceInfo& info)
+{
+  if (info.m_commandType == CommandType::SPLICE_INSERT && !info.m_isCancel &&
+      !info.m_isOutOfNetwork)
+    return true;
+
+  return std::any_of(info.m_segmentations.cbegin(), info.m_segmentations.cend(),
+                     [](const SegmentationDescriptor& segmentation) {
+                       return !segmentation.m_isCancel &&
+                              std::find(std::begin(AD_END_TYPES), std::end(AD_END_TYPES),
+                                        segmentation.m_typeId) != std::end(AD_END_TYPES);
+                     });
+}
+
+uint64_t UTILS::SCTE35::GetAdDuration(const SpliceInfo& info)
+{
+  if (info.m_breakDuration)
+    return *info.m_breakDuration;
+
+  for (const SegmentationDescriptor& segmentation : info.m_segmentations)
+  {
+    if (segmentation.m_duration)
+      return *segmentation.m_duration;
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace UTILS
+{
+namespace SCTE35
+{
+
+constexpr uint8_t TABLE_ID = 0xFC;
+
+enum class CommandType : uint8_t
+{
+  SPLICE_NULL = 0x00,
+  SPLICE_SCHEDULE = 0x04,
+  SPLICE_INSERT = 0x05,
+  TIME_SIGNAL = 0x06,
+  BANDWIDTH_RESERVATION = 0x07,
+  PRIVATE_COMMAND = 0xFF,
+};
+
+struct SegmentationDescriptor
+{
+  uint32_t m_eventId{0};
+  bool m_isCancel{false};
+  uint8_t m_typeId{0}; // segmentation_type_id
+  std::optional<uint64_t> m_duration; // 90 kHz ticks
+};
+
+struct SpliceInfo
+{
+  CommandType m_commandType{CommandType::SPLICE_NULL};
+  bool m_isEncrypted{false};
+  uint64_t m_ptsAdjustment{0};
+  // splice_insert fields
+  uint32_t m_eventId{0};
+  bool m_isCancel{false};
+  bool m_isOutOfNetwork{false};
+  bool m_isImmediate{false};
+  std::optional<uint64_t> m_breakDuration; // 90 kHz ticks
+  bool m_isAutoReturn{false};
+  // splice_insert / time_signal splice time, in 90 kHz ticks with pts_adjustment applied
+  std::optional<uint64_t> m_ptsTime;
+  std::vector<SegmentationDescriptor> m_segmentations;
+};
+
+/*!
+ * \brief Parse a SCTE-35 splice_info_section.
+ * \param data The section data, starting from the table_id
+ * \param size The data size
+ * \param info [OUT] The splice info
+ * \return True if success, false on malformed section or wrong table id.
+ *         The splice command of encrypted sections is not parsed.
+ */
+bool ParseSpliceInfoSection(const uint8_t* data, size_t size, SpliceInfo& info);
+
+/*!
+ * \brief Check if the splice info signal the start of an ad break, with a
+ *        splice_insert out of the network or a segmentation descriptor of a
+ *        break / advertisement / placement opportunity start.
+ */
+bool IsAdStart(const SpliceInfo& info);
+
+/*!
+ * \brief Check if the splice info signal the end of an ad break.
+ */
+bool IsAdEnd(const SpliceInfo& info);
+
+/*!
+ * \brief Get the ad break duration, from the splice_insert break duration
+ *        or the segmentation descriptor duration.
+ * \return The duration in 90 kHz ticks, or 0 if not signalled
+ */
+uint64_t GetAdDuration(const SpliceInfo& info);
+
+} // namespace SCTE35
+} // namespace UTILS
@@ -345,6 +345,31 @@ std::string UTILS::GetVideoCodecDesc(std::string_view codecName)
     return "";
 }
 
+std::string UTILS::GetVideoCodecFamily(std::string_view codecName)
+{
+  if (codecName.find("avc") != std::string::npos || codecName.find("h264") != std::string::npos)
+  {
+    return "h264";
+  }
+  else if (codecName.find("hev") != std::string::npos ||
+           codecName.find("hvc") != std::string::npos || codecName.find("dvh") != std::string::npos)
+  {
+    return "hevc";
+  }
+  else if (codecName.find("vp9") != std::string::npos ||
+           codecName.find("vp09") != std::string::npos)
+  {
+    return "vp9";
+  }
+  else if (codecName.find("av1") != std::string::npos ||
+           codecName.find("av01") != std::string::npos)
+  {
+    return "av1";
+  }
+  else
+    return "";
+}
+
 uint64_t UTILS::GetTimestamp()
 {
   std::chrono::seconds unix_timestamp = std::chrono::seconds(std::time(NULL));
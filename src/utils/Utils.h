@@ -35,6 +35,13 @@ void ParseHeaderString(std::map<std::string, std::string>& headerMap, const std:
  */
 std::string GetVideoCodecDesc(std::string_view codecName);
 
+/*!
+ * \brief Get the video codec family from a codec name, as Kodi codec name
+ * \param codecName The codec name, e.g. "hvc1.2.4.L153.B0"
+ * \return The codec family ("h264", "hevc", "vp9", "av1"), otherwise empty if unsupported
+ */
+std::string GetVideoCodecFamily(std::string_view codecName);
+
 /*!
  * \brief Get the current timestamp
  * \return The timestamp in milliseconds
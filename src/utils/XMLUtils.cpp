@@ -98,6 +98,22 @@ xml_attribute UTILS::XML::FirstAttributeNoPrefix(pugi::xml_node node,
   return xml_attribute();
 }
 
+xml_node UTILS::XML::FirstChildNoPrefix(pugi::xml_node node, std::string_view childTagName)
+{
+  for (xml_node child : node.children())
+  {
+    std::string_view currentTagName = child.name();
+    size_t delimiterPos = currentTagName.find(':');
+    if (delimiterPos != std::string::npos)
+      currentTagName.remove_prefix(delimiterPos + 1);
+
+    if (currentTagName == childTagName)
+      return child;
+  }
+
+  return xml_node();
+}
+
 std::string_view UTILS::XML::GetAttrib(pugi::xml_node& node,
                                        std::string_view name,
                                        std::string_view defaultValue /* = "" */)
@@ -64,6 +64,15 @@ size_t CountChilds(pugi::xml_node node, std::string_view childTagName = "");
  */
 pugi::xml_attribute FirstAttributeNoPrefix(pugi::xml_node node, std::string_view attributeName);
 
+/*!
+ * \brief Find the first child that have the specified tag name with or without
+ *        the namespace prefix (prefix:name).
+ * \param node The node where search the child.
+ * \param childTagName The child tag name.
+ * \return The child node if found, otherwise an empty node.
+ */
+pugi::xml_node FirstChildNoPrefix(pugi::xml_node node, std::string_view childTagName);
+
 /*!
  * \brief Get the specified attribute name.
  * \param node The node where search the attribute.
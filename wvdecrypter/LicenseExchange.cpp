@@ -0,0 +1,97 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "LicenseExchange.h"
+
+#include "../src/utils/Base64Utils.h"
+
+#include <cstdlib>
+
+using namespace SSD;
+using namespace UTILS;
+
+bool CLicenseExchange::Send(const CLicenseRequestTemplate::RequestData& data)
+{
+  m_body.clear();
+  m_response.clear();
+  m_contentType.clear();
+  m_resolutionLimit = 0;
+  m_error.clear();
+
+  if (!m_licenseTemplate.IsValid())
+  {
+    m_error = m_licenseTemplate.GetError();
+    return false;
+  }
+
+  void* file{m_host.CURLCreate(m_licenseTemplate.BuildUrl(data).c_str())};
+
+  // Set our std headers
+  m_host.CURLAddOption(file, SSD_HOST::OPTION_PROTOCOL, "acceptencoding", "gzip, deflate");
+  m_host.CURLAddOption(file, SSD_HOST::OPTION_PROTOCOL, "seekable", "0");
+  if (m_isExpectHeader)
+    m_host.CURLAddOption(file, SSD_HOST::OPTION_HEADER, "Expect", "");
+
+  for (const auto& [name, value] : m_licenseTemplate.GetHeaders())
+  {
+    m_host.CURLAddOption(file, SSD_HOST::OPTION_PROTOCOL, name.c_str(), value.c_str());
+  }
+
+  if (m_licenseTemplate.HasBody())
+  {
+    m_body = m_licenseTemplate.BuildBody(data);
+    std::string encData{BASE64::Encode(m_body)};
+    m_host.CURLAddOption(file, SSD_HOST::OPTION_PROTOCOL, "postdata", encData.c_str());
+  }
+
+  if (!m_host.CURLOpen(file))
+  {
+    m_host.CloseFile(file);
+    m_error = "License server returned failure";
+    return false;
+  }
+
+  char buf[1024];
+  size_t nbRead;
+  while ((nbRead = m_host.ReadFile(file, buf, sizeof(buf))) > 0)
+    m_response.append(buf, nbRead);
+
+  const std::string resLimit{
+      m_host.CURLGetProperty(file, SSD_HOST::CURLPROPERTY::PROPERTY_HEADER, "X-Limit-Video")};
+  m_contentType =
+      m_host.CURLGetProperty(file, SSD_HOST::CURLPROPERTY::PROPERTY_HEADER, "Content-Type");
+
+  const std::string::size_type posMax{resLimit.find("max=")};
+  if (posMax != std::string::npos)
+    m_resolutionLimit = std::atoi(resLimit.c_str() + posMax + 4);
+
+  m_host.CloseFile(file);
+
+  if (nbRead != 0)
+  {
+    m_error = "Could not read full SessionMessage response";
+    return false;
+  }
+  return true;
+}
+
+bool CLicenseExchange::IsBinaryResponse() const
+{
+  return m_contentType.find("application/octet-stream") != std::string::npos;
+}
+
+bool CLicenseExchange::GetLicense(bool isServerCertRequest, std::string& license, int& hdcpLimit)
+{
+  // The server certificate response is always binary
+  if (!m_licenseTemplate.HasResponseWrapper() || (isServerCertRequest && IsBinaryResponse()))
+  {
+    license = m_response;
+    return true;
+  }
+  return m_licenseTemplate.UnwrapResponse(m_response, license, hdcpLimit, m_error);
+}
@@ -0,0 +1,85 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include "../src/SSD_dll.h"
+#include "LicenseRequestTemplate.h"
+
+#include <string>
+
+/*!
+ * \brief License exchange with the license server through the CURL interface
+ *        of the SSD host, the request is built from the license request
+ *        template and the license data is unwrapped from the response.
+ *        Shared by the decrypters of each platform, so the whole HTTP flow
+ *        can be tested with a stub host.
+ */
+class CLicenseExchange
+{
+public:
+  CLicenseExchange(SSD::SSD_HOST& host, const CLicenseRequestTemplate& licenseTemplate)
+    : m_host{host}, m_licenseTemplate{licenseTemplate}
+  {
+  }
+
+  /*!
+   * \brief Do not send the "Expect" header, to keep the default CURL behaviour.
+   */
+  void DisableExpectHeader() { m_isExpectHeader = false; }
+
+  /*!
+   * \brief Send the license request and read the response.
+   * \param data The request data
+   * \return True if success, otherwise false and GetError() describe the problem
+   */
+  bool Send(const CLicenseRequestTemplate::RequestData& data);
+
+  /*!
+   * \brief Get the POST data of the last request sent.
+   */
+  const std::string& GetRequestBody() const { return m_body; }
+
+  /*!
+   * \brief Get the raw response data of the license server.
+   */
+  std::string& GetResponse() { return m_response; }
+
+  /*!
+   * \brief True if the response content type is binary.
+   */
+  bool IsBinaryResponse() const;
+
+  /*!
+   * \brief Get the max video resolution allowed by the "X-Limit-Video" response header.
+   * \return The resolution limit, otherwise 0 if not set
+   */
+  int GetResolutionLimit() const { return m_resolutionLimit; }
+
+  /*!
+   * \brief Get the license data from the response.
+   * \param isServerCertRequest True if the request was a service certificate request,
+   *                            a binary response is the certificate and it is not unwrapped
+   * \param license [OUT] The license data
+   * \param hdcpLimit [OUT] Set when the HDCP limit is found in a JSON response
+   * \return True if success, otherwise false and GetError() describe the problem
+   */
+  bool GetLicense(bool isServerCertRequest, std::string& license, int& hdcpLimit);
+
+  const std::string& GetError() const { return m_error; }
+
+private:
+  SSD::SSD_HOST& m_host;
+  const CLicenseRequestTemplate& m_licenseTemplate;
+  bool m_isExpectHeader{true};
+  std::string m_body;
+  std::string m_response;
+  std::string m_contentType;
+  int m_resolutionLimit{0};
+  std::string m_error;
+};
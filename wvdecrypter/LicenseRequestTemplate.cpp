@@ -0,0 +1,469 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "LicenseRequestTemplate.h"
+
+#include "../src/utils/Base64Utils.h"
+#include "../src/utils/DigestMD5Utils.h"
+#include "../src/utils/JsonUtils.h"
+#include "../src/utils/StringUtils.h"
+#include "../src/utils/Utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+using namespace UTILS;
+
+namespace
+{
+const JSON::Value* FindJsonValue(const JSON::Value& root, std::string_view path)
+{
+  const JSON::Value* value{path.find('/') == std::string_view::npos ? root.Find(path)
+                                                                     : root.GetPath(path)};
+  // A value wrapped in a single element array is taken as is
+  if (value && value->m_type == JSON::ValueType::ARRAY && value->m_array.size() == 1)
+    value = &value->m_array[0];
+
+  return value;
+}
+
+std::string ToHex(std::string_view data)
+{
+  static const char hexDigits[] = "0123456789abcdef";
+  std::string hex;
+  hex.reserve(data.size() * 2);
+  for (const char ch : data)
+  {
+    hex += hexDigits[static_cast<uint8_t>(ch) >> 4];
+    hex += hexDigits[static_cast<uint8_t>(ch) & 15];
+  }
+  return hex;
+}
+
+void Trim(std::string_view& str)
+{
+  while (!str.empty() && std::isspace(static_cast<unsigned char>(str.front())))
+    str.remove_prefix(1);
+  while (!str.empty() && std::isspace(static_cast<unsigned char>(str.back())))
+    str.remove_suffix(1);
+}
+} // unnamed namespace
+
+bool CLicenseRequestTemplate::Compile(std::string_view licenseUrl)
+{
+  *this = CLicenseRequestTemplate();
+
+  std::vector<std::string_view> blocks;
+  size_t start{0};
+  while (true)
+  {
+    const size_t end{licenseUrl.find('|', start)};
+    blocks.emplace_back(licenseUrl.substr(start, end - start));
+    if (end == std::string_view::npos)
+      break;
+    start = end + 1;
+  }
+
+  if (blocks.size() != 4)
+  {
+    return Fail("Wrong \"|\" blocks in license URL. Four blocks (req | header | body | "
+                "response) are expected in license URL");
+  }
+
+  if (!CompileUrl(blocks[0]) || !CompileBody(blocks[2]) || !CompileResponse(blocks[3]))
+    return false;
+
+  CompileHeaders(blocks[1]);
+
+  m_isValid = true;
+  return true;
+}
+
+std::string CLicenseRequestTemplate::BuildUrl(const RequestData& data) const
+{
+  return BuildParts(m_urlParts, data);
+}
+
+std::string CLicenseRequestTemplate::BuildBody(const RequestData& data) const
+{
+  std::string body{BuildParts(m_bodyParts, data)};
+
+  if (m_bodyWrap == Encoding::BASE64)
+    body = BASE64::Encode(body);
+  else if (m_bodyWrap == Encoding::BASE64_URL)
+    body = STRING::URLEncode(BASE64::Encode(body));
+
+  return body;
+}
+
+bool CLicenseRequestTemplate::UnwrapResponse(std::string_view response,
+                                             std::string& license,
+                                             int& hdcpLimit,
+                                             std::string& error) const
+{
+  switch (m_responseType)
+  {
+    case ResponseType::RAW:
+      license = response;
+      return true;
+
+    case ResponseType::BASE64:
+      license = BASE64::Decode(response);
+      return true;
+
+    case ResponseType::HTTP_PAYLOAD:
+    {
+      const size_t payloadPos{response.find("\r\n\r\n")};
+      if (payloadPos == std::string_view::npos)
+      {
+        error = "Unable to find HTTP payload in response";
+        return false;
+      }
+      license = response.substr(payloadPos + 4);
+      return true;
+    }
+
+    case ResponseType::JSON:
+    {
+      std::string decodedResponse;
+      if (m_isResponseBase64 && response.size() >= 3)
+      {
+        decodedResponse = BASE64::Decode(response);
+        response = decodedResponse;
+      }
+
+      // Trailing data is ignored, some servers append garbage after the JSON
+      JSON::Value root;
+      if (!JSON::Parse(response, root, true))
+      {
+        error = "Unable to parse the JSON license response";
+        return false;
+      }
+
+      if (!m_jsonHdcpPath.empty())
+      {
+        const JSON::Value* hdcpValue{FindJsonValue(root, m_jsonHdcpPath)};
+        if (hdcpValue && hdcpValue->m_type == JSON::ValueType::NUMBER)
+          hdcpLimit = static_cast<int>(hdcpValue->m_number);
+        else if (hdcpValue && hdcpValue->m_type == JSON::ValueType::STRING)
+          hdcpLimit = std::atoi(hdcpValue->m_string.c_str());
+      }
+
+      const JSON::Value* licenseValue{FindJsonValue(root, m_jsonLicensePath)};
+      if (!licenseValue || licenseValue->m_type != JSON::ValueType::STRING)
+      {
+        error = "Unable to find " + m_jsonLicensePath + " in JSON string";
+        return false;
+      }
+
+      if (m_isJsonValueBase64)
+        license = BASE64::Decode(licenseValue->m_string);
+      else
+        license = licenseValue->m_string;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool CLicenseRequestTemplate::CompileUrl(std::string_view url)
+{
+  const size_t ssmPos{url.find("{SSM}")};
+  const size_t hashPos{url.find("{HASH}")};
+
+  // Only the base64 url encoded challenge is supported in the url
+  if (ssmPos != std::string_view::npos && (ssmPos == 0 || url[ssmPos - 1] != 'B'))
+    return Fail("Unsupported License request template (command)");
+
+  struct Placeholder
+  {
+    size_t m_start;
+    size_t m_end;
+    Part m_part;
+  };
+  std::vector<Placeholder> placeholders;
+
+  if (ssmPos != std::string_view::npos)
+    placeholders.push_back({ssmPos - 1, ssmPos + 5, {PartType::CHALLENGE, Encoding::BASE64_URL}});
+  if (hashPos != std::string_view::npos)
+    placeholders.push_back({hashPos, hashPos + 6, {PartType::CHALLENGE_HASH, Encoding::RAW}});
+
+  std::sort(placeholders.begin(), placeholders.end(),
+            [](const Placeholder& a, const Placeholder& b) { return a.m_start < b.m_start; });
+
+  size_t pos{0};
+  for (Placeholder& placeholder : placeholders)
+  {
+    if (placeholder.m_start < pos)
+      return Fail("Unsupported License request template (command)");
+    if (placeholder.m_start > pos)
+      m_urlParts.push_back({PartType::TEXT, Encoding::RAW,
+                            std::string(url.substr(pos, placeholder.m_start - pos))});
+    m_urlParts.emplace_back(std::move(placeholder.m_part));
+    pos = placeholder.m_end;
+  }
+  if (pos < url.size())
+    m_urlParts.push_back({PartType::TEXT, Encoding::RAW, std::string(url.substr(pos))});
+
+  return true;
+}
+
+void CLicenseRequestTemplate::CompileHeaders(std::string_view headers)
+{
+  size_t start{0};
+  while (start <= headers.size())
+  {
+    size_t end{headers.find('&', start)};
+    if (end == std::string_view::npos)
+      end = headers.size();
+    const std::string_view header{headers.substr(start, end - start)};
+    start = end + 1;
+
+    const size_t valuePos{header.find('=')};
+    std::string_view name{header.substr(0, valuePos)};
+    std::string_view value;
+    if (valuePos != std::string_view::npos)
+    {
+      // As the previous implementation, data after a second "=" is ignored
+      value = header.substr(valuePos + 1);
+      value = value.substr(0, value.find('='));
+    }
+    Trim(name);
+    Trim(value);
+
+    if (!name.empty())
+      m_headers.emplace_back(std::string(name), STRING::URLDecode(value));
+  }
+}
+
+bool CLicenseRequestTemplate::CompileBody(std::string_view bodyTemplate)
+{
+  m_hasBody = !bodyTemplate.empty();
+  if (!m_hasBody)
+    return true;
+
+  std::string body{bodyTemplate};
+  if (body[0] == '%')
+    body = STRING::URLDecode(body);
+
+  // Without challenge placeholder the body is sent as is
+  if (body.find("{SSM}") == std::string::npos)
+  {
+    m_bodyParts.push_back({PartType::TEXT, Encoding::RAW, body});
+    return true;
+  }
+
+  // Full body base64 encoding "B{...}" or "b{...}"
+  if (body.size() > 2 && (body[0] == 'B' || body[0] == 'b') && body[1] == '{' &&
+      body.find("{SSM}") > 1 && body.find("{SID}") > 1 && body.find("{KID}") > 1)
+  {
+    m_bodyWrap = body[0] == 'B' ? Encoding::BASE64_URL : Encoding::BASE64;
+    body = body.substr(2, body.size() - 3);
+  }
+
+  struct Placeholder
+  {
+    size_t m_start;
+    size_t m_end;
+    PartType m_type;
+    Encoding m_encoding{Encoding::RAW};
+  };
+  std::vector<Placeholder> placeholders;
+
+  const std::pair<std::string_view, PartType> names[] = {{"{SSM}", PartType::CHALLENGE},
+                                                         {"{SID}", PartType::SESSION_ID},
+                                                         {"{KID}", PartType::KEY_ID},
+                                                         {"{PSSH}", PartType::PSSH}};
+  for (const auto& [name, type] : names)
+  {
+    const size_t pos{body.find(name)};
+    if (pos != std::string::npos)
+      placeholders.push_back({pos, pos + name.size(), type});
+  }
+
+  std::sort(placeholders.begin(), placeholders.end(),
+            [](const Placeholder& a, const Placeholder& b) { return a.m_start < b.m_start; });
+
+  // The char that precede the placeholder select the encoding,
+  // when it's part of the previous placeholder there is no prefix
+  size_t prevEnd{0};
+  for (Placeholder& placeholder : placeholders)
+  {
+    const char prefix{placeholder.m_start > prevEnd ? body[placeholder.m_start - 1] : '\0'};
+    prevEnd = placeholder.m_end;
+
+    switch (placeholder.m_type)
+    {
+      case PartType::CHALLENGE:
+        if (prefix == '\0')
+          return Fail("Unsupported License request template (body / ?{SSM})");
+        if (prefix == 'B')
+          placeholder.m_encoding = Encoding::BASE64_URL;
+        else if (prefix == 'b')
+          placeholder.m_encoding = Encoding::BASE64;
+        else if (prefix == 'D')
+          placeholder.m_encoding = Encoding::DECIMAL;
+        placeholder.m_start--;
+        break;
+      case PartType::SESSION_ID:
+        if (prefix == '\0')
+          return Fail("Unsupported License request template (body / ?{SID})");
+        if (prefix == 'B')
+          placeholder.m_encoding = Encoding::BASE64_URL;
+        else if (prefix == 'b')
+          placeholder.m_encoding = Encoding::BASE64;
+        placeholder.m_start--;
+        break;
+      case PartType::KEY_ID:
+        if (prefix == 'H')
+        {
+          placeholder.m_encoding = Encoding::HEX;
+          placeholder.m_start--;
+        }
+        else
+          placeholder.m_encoding = Encoding::UUID;
+        break;
+      case PartType::PSSH:
+        placeholder.m_encoding = prefix == 'B' ? Encoding::BASE64_URL : Encoding::BASE64;
+        if (prefix != '\0')
+          placeholder.m_start--;
+        break;
+      default:
+        break;
+    }
+  }
+
+  size_t pos{0};
+  for (const Placeholder& placeholder : placeholders)
+  {
+    if (placeholder.m_start > pos)
+      m_bodyParts.push_back(
+          {PartType::TEXT, Encoding::RAW, body.substr(pos, placeholder.m_start - pos)});
+    m_bodyParts.push_back({placeholder.m_type, placeholder.m_encoding});
+    pos = placeholder.m_end;
+  }
+  if (pos < body.size())
+    m_bodyParts.push_back({PartType::TEXT, Encoding::RAW, body.substr(pos)});
+
+  return true;
+}
+
+bool CLicenseRequestTemplate::CompileResponse(std::string_view response)
+{
+  if (response.empty())
+  {
+    m_responseType = ResponseType::RAW;
+  }
+  else if (response[0] == 'J' || (response.size() > 1 && response[0] == 'B' && response[1] == 'J'))
+  {
+    m_responseType = ResponseType::JSON;
+    m_isResponseBase64 = response[0] == 'B';
+    const size_t dataPos{m_isResponseBase64 ? 3U : 2U};
+    if (response.size() < dataPos)
+      return Fail("Unsupported License request template (response)");
+
+    m_isJsonValueBase64 = response[dataPos - 1] == 'B';
+
+    // "licensePath;hdcpPath"
+    const std::string_view paths{response.substr(dataPos)};
+    const size_t separatorPos{paths.find(';')};
+    m_jsonLicensePath = paths.substr(0, separatorPos);
+    if (separatorPos != std::string_view::npos)
+    {
+      const std::string_view hdcpPath{paths.substr(separatorPos + 1)};
+      m_jsonHdcpPath = hdcpPath.substr(0, hdcpPath.find(';'));
+    }
+  }
+  else if (response[0] == 'H' && response.size() >= 2)
+  {
+    if (response[1] != 'B')
+      return Fail("Unsupported HTTP payload data type definition");
+    m_responseType = ResponseType::HTTP_PAYLOAD;
+  }
+  else if (response[0] == 'B' && response.size() == 1)
+  {
+    m_responseType = ResponseType::BASE64;
+  }
+  else
+  {
+    return Fail("Unsupported License request template (response)");
+  }
+  return true;
+}
+
+bool CLicenseRequestTemplate::Fail(std::string_view error)
+{
+  m_error = error;
+  m_isValid = false;
+  return false;
+}
+
+std::string CLicenseRequestTemplate::BuildParts(const std::vector<Part>& parts,
+                                                const RequestData& data)
+{
+  std::string result;
+
+  for (const Part& part : parts)
+  {
+    std::string_view value;
+    std::string hash;
+
+    switch (part.m_type)
+    {
+      case PartType::TEXT:
+        result += part.m_text;
+        continue;
+      case PartType::CHALLENGE:
+        value = data.m_challenge;
+        break;
+      case PartType::CHALLENGE_HASH:
+      {
+        DIGEST::MD5 md5;
+        md5.Update(data.m_challenge.data(), static_cast<uint32_t>(data.m_challenge.size()));
+        md5.Finalize();
+        hash = md5.HexDigest();
+        value = hash;
+        break;
+      }
+      case PartType::SESSION_ID:
+        value = data.m_sessionId;
+        break;
+      case PartType::KEY_ID:
+        value = data.m_defaultKeyId;
+        break;
+      case PartType::PSSH:
+        value = data.m_pssh;
+        break;
+    }
+
+    switch (part.m_encoding)
+    {
+      case Encoding::RAW:
+        result += value;
+        break;
+      case Encoding::BASE64:
+        result += BASE64::Encode(value.data(), value.size());
+        break;
+      case Encoding::BASE64_URL:
+        result += STRING::URLEncode(BASE64::Encode(value.data(), value.size()));
+        break;
+      case Encoding::DECIMAL:
+        result += STRING::ToDecimal(reinterpret_cast<const uint8_t*>(value.data()), value.size());
+        break;
+      case Encoding::HEX:
+        result += ToHex(value);
+        break;
+      case Encoding::UUID:
+        if (value.size() == 16)
+          result += ConvertKIDtoUUID(value);
+        break;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,154 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*!
+ * \brief License request template, the license URL mini-language
+ *        "request url|headers|body|response" is compiled once into typed parts,
+ *        then used to build every license request (and renewal) and to unwrap
+ *        the license data from the server response.
+ *
+ *        Request url placeholders: B{SSM} (base64 + url encoded challenge), {HASH}
+ *        (md5 of the challenge).
+ *        Body placeholders, the prefix char select the encoding:
+ *        {SSM} B/b/D/other (base64 url encoded / base64 / decimal / raw),
+ *        {SID} B/b/other, {KID} H (hexadecimal) otherwise UUID, {PSSH} B/other.
+ *        A body like B{...} or b{...} is entirely base64 encoded after the
+ *        substitutions, a body starting with % is url decoded.
+ *        Response: empty (raw), B (base64), HB (HTTP payload), J or BJ (JSON,
+ *        BJ when the response is base64 encoded), followed by the value encoding
+ *        char (B for base64) and "licensePath;hdcpPath". A JSON path without
+ *        "/" is the first key with that name at any depth, otherwise the keys
+ *        (or array indexes) from the root e.g. "data/licenses/0/license".
+ */
+class CLicenseRequestTemplate
+{
+public:
+  struct RequestData
+  {
+    std::string_view m_challenge;
+    std::string_view m_sessionId;
+    std::string_view m_defaultKeyId; // 16 bytes raw KID
+    std::string_view m_pssh;
+  };
+
+  /*!
+   * \brief Compile the license URL template.
+   * \param licenseUrl The license URL template "url|headers|body|response"
+   * \return True if success, otherwise false and GetError() describe the problem
+   */
+  bool Compile(std::string_view licenseUrl);
+
+  bool IsValid() const { return m_isValid; }
+  const std::string& GetError() const { return m_error; }
+
+  /*!
+   * \brief Build the license server url.
+   */
+  std::string BuildUrl(const RequestData& data) const;
+
+  /*!
+   * \brief Get the url decoded HTTP headers (name, value).
+   */
+  const std::vector<std::pair<std::string, std::string>>& GetHeaders() const { return m_headers; }
+
+  bool HasBody() const { return m_hasBody; }
+
+  /*!
+   * \brief True if the body has placeholders to be replaced for each request.
+   */
+  bool HasBodyPlaceholders() const { return m_bodyParts.size() > 1 || m_bodyWrap != Encoding::RAW; }
+
+  /*!
+   * \brief Build the POST data for the license request.
+   */
+  std::string BuildBody(const RequestData& data) const;
+
+  /*!
+   * \brief True if the response must be unwrapped to get the license data.
+   */
+  bool HasResponseWrapper() const { return m_responseType != ResponseType::RAW; }
+
+  /*!
+   * \brief Extract the license data from the license server response.
+   * \param response The response data
+   * \param license [OUT] The license data
+   * \param hdcpLimit [OUT] Set when the HDCP limit is found in a JSON response
+   * \param error [OUT] The error message if fails
+   * \return True if success, otherwise false
+   */
+  bool UnwrapResponse(std::string_view response,
+                      std::string& license,
+                      int& hdcpLimit,
+                      std::string& error) const;
+
+private:
+  enum class Encoding
+  {
+    RAW,
+    BASE64,
+    BASE64_URL, // Base64 then url encoded
+    DECIMAL, // Comma separated byte values
+    HEX,
+    UUID,
+  };
+
+  enum class PartType
+  {
+    TEXT,
+    CHALLENGE,
+    CHALLENGE_HASH,
+    SESSION_ID,
+    KEY_ID,
+    PSSH,
+  };
+
+  struct Part
+  {
+    PartType m_type{PartType::TEXT};
+    Encoding m_encoding{Encoding::RAW};
+    std::string m_text;
+  };
+
+  enum class ResponseType
+  {
+    RAW,
+    BASE64,
+    HTTP_PAYLOAD,
+    JSON,
+  };
+
+  bool CompileUrl(std::string_view url);
+  void CompileHeaders(std::string_view headers);
+  bool CompileBody(std::string_view body);
+  bool CompileResponse(std::string_view response);
+  bool Fail(std::string_view error);
+
+  static std::string BuildParts(const std::vector<Part>& parts, const RequestData& data);
+
+  bool m_isValid{false};
+  std::string m_error;
+
+  std::vector<Part> m_urlParts;
+  std::vector<std::pair<std::string, std::string>> m_headers;
+  bool m_hasBody{false};
+  std::vector<Part> m_bodyParts;
+  Encoding m_bodyWrap{Encoding::RAW};
+
+  ResponseType m_responseType{ResponseType::RAW};
+  bool m_isResponseBase64{false}; // JSON response is base64 encoded
+  bool m_isJsonValueBase64{false};
+  std::string m_jsonLicensePath;
+  std::string m_jsonHdcpPath;
+};
@@ -0,0 +1,202 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "LicenseStore.h"
+
+#include "../src/utils/DigestMD5Utils.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+constexpr char LICENSE_FILE_PREFIX[] = "license_";
+constexpr char LICENSE_FILE_MAGIC[] = {'I', 'S', 'A', 'L', 1}; // Last byte is the version
+constexpr char SERVICE_CERTIFICATE_FILENAME[] = "service_certificate";
+// Licenses and certificates are small, protect from damaged files
+constexpr size_t MAX_FILE_SIZE = 1024 * 1024;
+
+bool ReadFile(const std::string& filePath, std::string& data)
+{
+  FILE* f = std::fopen(filePath.c_str(), "rb");
+  if (!f)
+    return false;
+
+  data.clear();
+  char buffer[4096];
+  size_t nbRead;
+  while ((nbRead = std::fread(buffer, 1, sizeof(buffer), f)) > 0)
+  {
+    data.append(buffer, nbRead);
+    if (data.size() > MAX_FILE_SIZE)
+      break;
+  }
+  std::fclose(f);
+  return data.size() <= MAX_FILE_SIZE;
+}
+
+bool WriteFile(const std::string& filePath, const std::string& data)
+{
+  FILE* f = std::fopen(filePath.c_str(), "wb");
+  if (!f)
+    return false;
+
+  const bool isWritten = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+  return std::fclose(f) == 0 && isWritten;
+}
+
+template<typename T>
+void Append(std::string& data, T value)
+{
+  data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void AppendString(std::string& data, const std::string& value)
+{
+  Append(data, static_cast<uint32_t>(value.size()));
+  data += value;
+}
+
+template<typename T>
+bool Extract(std::string_view& data, T& value)
+{
+  if (data.size() < sizeof(T))
+    return false;
+  std::memcpy(&value, data.data(), sizeof(T));
+  data.remove_prefix(sizeof(T));
+  return true;
+}
+
+bool ExtractString(std::string_view& data, std::string& value)
+{
+  uint32_t size;
+  if (!Extract(data, size) || data.size() < size)
+    return false;
+  value.assign(data.data(), size);
+  data.remove_prefix(size);
+  return true;
+}
+
+} // unnamed namespace
+
+std::string CLicenseStore::MakeKey(std::string_view licenseUrl,
+                                   std::string_view keyId,
+                                   std::string_view pssh)
+{
+  // Only the request url, the headers part can contains volatile values e.g. auth tokens
+  licenseUrl = licenseUrl.substr(0, licenseUrl.find('|'));
+
+  UTILS::DIGEST::MD5 md5;
+  md5.Update(licenseUrl.data(), static_cast<uint32_t>(licenseUrl.size()));
+  md5.Update("|", 1);
+  md5.Update(keyId.data(), static_cast<uint32_t>(keyId.size()));
+  md5.Update("|", 1);
+  md5.Update(pssh.data(), static_cast<uint32_t>(pssh.size()));
+  md5.Finalize();
+  return md5.HexDigest();
+}
+
+bool CLicenseStore::Load(const std::string& key, Entry& entry, uint64_t now) const
+{
+  if (!IsEnabled())
+    return false;
+
+  const std::string filePath{GetLicenseFilePath(key)};
+  std::string fileData;
+  if (!ReadFile(filePath, fileData))
+    return false;
+
+  std::string_view data{fileData};
+  bool isValid = data.size() > sizeof(LICENSE_FILE_MAGIC) &&
+                 data.compare(0, sizeof(LICENSE_FILE_MAGIC),
+                              {LICENSE_FILE_MAGIC, sizeof(LICENSE_FILE_MAGIC)}) == 0;
+  if (isValid)
+  {
+    data.remove_prefix(sizeof(LICENSE_FILE_MAGIC));
+    isValid = Extract(data, entry.m_storeTime) && Extract(data, entry.m_expireTime) &&
+              ExtractString(data, entry.m_sessionId) && data.empty();
+  }
+
+  if (isValid)
+  {
+    if (entry.m_expireTime != 0)
+      isValid = now < entry.m_expireTime;
+    else
+      isValid = entry.m_storeTime <= now && now - entry.m_storeTime < LICENSE_MAX_AGE;
+  }
+
+  if (!isValid)
+    std::remove(filePath.c_str());
+
+  return isValid;
+}
+
+bool CLicenseStore::Save(const std::string& key, const Entry& entry) const
+{
+  if (!IsEnabled())
+    return false;
+
+  std::string data{LICENSE_FILE_MAGIC, sizeof(LICENSE_FILE_MAGIC)};
+  Append(data, entry.m_storeTime);
+  Append(data, entry.m_expireTime);
+  AppendString(data, entry.m_sessionId);
+
+  return WriteFile(GetLicenseFilePath(key), data);
+}
+
+void CLicenseStore::Remove(const std::string& key) const
+{
+  if (IsEnabled())
+    std::remove(GetLicenseFilePath(key).c_str());
+}
+
+bool CLicenseStore::LoadServiceCertificate(std::string& certificate, uint64_t now) const
+{
+  if (!IsEnabled())
+    return false;
+
+  std::string fileData;
+  if (!ReadFile(m_basePath + SERVICE_CERTIFICATE_FILENAME, fileData))
+    return false;
+
+  std::string_view data{fileData};
+  uint64_t certTime;
+  if (!Extract(data, certTime) || data.empty())
+    return false;
+
+  if (certTime > now || now - certTime >= SERVICE_CERTIFICATE_MAX_AGE)
+    return false;
+
+  certificate = data;
+  return true;
+}
+
+bool CLicenseStore::SaveServiceCertificate(std::string_view certificate, uint64_t now) const
+{
+  if (!IsEnabled() || certificate.empty())
+    return false;
+
+  std::string data;
+  Append(data, now);
+  data += certificate;
+
+  return WriteFile(m_basePath + SERVICE_CERTIFICATE_FILENAME, data);
+}
+
+uint64_t CLicenseStore::Now()
+{
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string CLicenseStore::GetLicenseFilePath(const std::string& key) const
+{
+  return m_basePath + LICENSE_FILE_PREFIX + key;
+}
@@ -0,0 +1,108 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*!
+ * \brief Persistent storage of the DRM licenses and service certificates, allow
+ *        to restore a license without a new license server round-trip when the
+ *        same content is played again.
+ *        The license data is kept by the DRM (persistent session / offline keys),
+ *        here its stored the id to restore it, in a separate file of the DRM base
+ *        path for each license, named with the MD5 of the license server url,
+ *        the default KID and the PSSH init data. Expired entries are deleted when read.
+ */
+class CLicenseStore
+{
+public:
+  // The max age of a license without an expiry time provided by the DRM
+  static constexpr uint64_t LICENSE_MAX_AGE = 7 * 86400;
+  // The max age of a stored service certificate
+  static constexpr uint64_t SERVICE_CERTIFICATE_MAX_AGE = 86400;
+
+  struct Entry
+  {
+    uint64_t m_storeTime{0}; // Seconds since epoch
+    uint64_t m_expireTime{0}; // Seconds since epoch, 0 if not provided by the DRM
+    std::string m_sessionId; // The DRM persistent session id or offline key set id
+  };
+
+  CLicenseStore() = default;
+
+  /*!
+   * \brief Set the folder where store the files.
+   * \param basePath The folder path, including the trailing path separator
+   */
+  void SetBasePath(std::string_view basePath) { m_basePath = basePath; }
+  const std::string& GetBasePath() const { return m_basePath; }
+  bool IsEnabled() const { return !m_basePath.empty(); }
+
+  /*!
+   * \brief Make the key that identify a license.
+   * \param licenseUrl The license URL, the headers / body / response parts
+   *                   of the license request template are ignored
+   * \param keyId The default KID (16 bytes raw)
+   * \param pssh The PSSH init data
+   * \return The key
+   */
+  static std::string MakeKey(std::string_view licenseUrl,
+                             std::string_view keyId,
+                             std::string_view pssh);
+
+  /*!
+   * \brief Load a stored license, when expired it will be deleted.
+   * \param key The license key
+   * \param entry [OUT] The license
+   * \param now The current time, in seconds since epoch
+   * \return True if a valid license has been found, otherwise false
+   */
+  bool Load(const std::string& key, Entry& entry, uint64_t now) const;
+
+  /*!
+   * \brief Store a license, replacing the existing one.
+   * \param key The license key
+   * \param entry The license
+   * \return True if success, otherwise false
+   */
+  bool Save(const std::string& key, const Entry& entry) const;
+
+  /*!
+   * \brief Delete a stored license, e.g. when it cannot be restored by the DRM.
+   */
+  void Remove(const std::string& key) const;
+
+  /*!
+   * \brief Load the stored service certificate of the license server.
+   * \param certificate [OUT] The certificate
+   * \param now The current time, in seconds since epoch
+   * \return True if a not outdated certificate has been found, otherwise false
+   */
+  bool LoadServiceCertificate(std::string& certificate, uint64_t now) const;
+
+  /*!
+   * \brief Store the service certificate of the license server.
+   * \param certificate The certificate
+   * \param now The current time, in seconds since epoch
+   * \return True if success, otherwise false
+   */
+  bool SaveServiceCertificate(std::string_view certificate, uint64_t now) const;
+
+  /*!
+   * \brief Get the current time in seconds since epoch.
+   */
+  static uint64_t Now();
+
+private:
+  std::string GetLicenseFilePath(const std::string& key) const;
+
+  std::string m_basePath;
+};
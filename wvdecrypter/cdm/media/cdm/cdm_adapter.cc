@@ -559,7 +559,9 @@ void CdmAdapter::OnExpirationChange(const char* session_id,
                   uint32_t session_id_size,
                   cdm::Time new_expiry_time)
 {
-  SendClientMessage(session_id, session_id_size, CdmAdapterClient::kSessionExpired, nullptr, 0, 0);
+  SendClientMessage(session_id, session_id_size, CdmAdapterClient::kSessionExpired,
+                    reinterpret_cast<const uint8_t*>(&new_expiry_time), sizeof(new_expiry_time),
+                    0);
 }
 
 void CdmAdapter::OnSessionClosed(const char* session_id,
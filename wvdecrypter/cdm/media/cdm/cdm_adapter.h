@@ -34,7 +34,7 @@ public:
   {
     kError,
     kSessionMessage,
-    kSessionExpired,
+    kSessionExpired, // data is the new expiry time (cdm::Time)
     kSessionKeysChange,
     kSessionClosed,
     kLegacySessionError
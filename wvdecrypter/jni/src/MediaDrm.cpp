@@ -131,6 +131,13 @@ std::vector<char> CJNIMediaDrm::provideKeyResponse(const std::vector<char> &scop
   return result;
 }
 
+void CJNIMediaDrm::restoreKeys(const std::vector<char> &sessionId, const std::vector<char> &keySetId) const
+{
+  call_method<void>(m_object,
+    "restoreKeys", "([B[B)V", jcast<jhbyteArray, std::vector<char> >(sessionId),
+    jcast<jhbyteArray, std::vector<char> >(keySetId));
+}
+
 CJNIMediaDrmProvisionRequest CJNIMediaDrm::getProvisionRequest() const
 {
   return call_method<jhobject>(m_object,
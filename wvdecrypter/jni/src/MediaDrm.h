@@ -50,6 +50,7 @@ public:
     const std::vector<char> &init, const std::string &mimeType, int keyType,
     const std::map<std::string, std::string> &optionalParameters) const;
   std::vector<char> provideKeyResponse(const std::vector<char> &scope, const std::vector<char> &response) const;
+  void restoreKeys(const std::vector<char> &sessionId, const std::vector<char> &keySetId) const;
 
   CJNIMediaDrmProvisionRequest getProvisionRequest() const;
   void provideProvisionResponse(const std::vector<char> &response) const;
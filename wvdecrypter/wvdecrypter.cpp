@@ -8,16 +8,18 @@
 
 #include "../src/common/AdaptiveDecrypter.h"
 #include "../src/utils/Base64Utils.h"
-#include "../src/utils/DigestMD5Utils.h"
 #include "../src/utils/StringUtils.h"
 #include "../src/utils/Utils.h"
 #include "Helper.h"
+#include "LicenseExchange.h"
+#include "LicenseRequestTemplate.h"
+#include "LicenseStore.h"
 #include "cdm/media/cdm/cdm_adapter.h"
 #include "cdm/media/cdm/cdm_type_conversion.h"
-#include "jsmn.h"
 #include "kodi/tools/StringUtils.h"
 
 #include <algorithm>
+#include <cmath>
 #include <list>
 #include <optional>
 #include <thread>
@@ -169,6 +171,7 @@ public:
   }
 
   void AddSessionKey(const uint8_t *data, size_t data_size, uint32_t status);
+  void SetExpiration(const uint8_t* data, size_t data_size);
   bool HasKeyId(const uint8_t *keyid);
 
   virtual AP4_Result SetFragmentInfo(AP4_UI32 pool_id,
@@ -195,7 +198,14 @@ public:
     const AP4_UI16* bytes_of_cleartext_data,
 
     // array of <subsample_count> integers. NULL if subsample_count is 0
-    const AP4_UI32* bytes_of_encrypted_data) override;
+    const AP4_UI32* bytes_of_encrypted_data,
+
+    // per-sample key and pattern, NULL to use the fragment ones
+    const SampleKeyInfo* sampleKeyInfo) override;
+
+  AP4_Result DecryptSampleBatch(AP4_UI32 poolId,
+                                SampleDecryptDesc* samples,
+                                size_t count) override;
 
   bool OpenVideoDecoder(const SSD_VIDEOINITDATA *initData);
   SSD_DECODE_RETVAL DecryptAndDecodeVideo(void* hostInstance, SSD_SAMPLE* sample);
@@ -204,15 +214,27 @@ public:
 
   void SetDefaultKeyId(std::string_view keyId) override;
   void AddKeyId(std::string_view keyId) override;
+  bool AcquirePendingLicense() override;
 
 private:
   void CheckLicenseRenewal();
+  /*!
+   * \brief Decrypt with a single CDM request a run of samples whose encrypted
+   *        data are a single AES-CTR stream, see GetCtrSampleRun.
+   */
+  void DecryptCtrSampleRun(AP4_UI32 poolId, SampleDecryptDesc* samples, size_t count);
+  bool CreateSession(cdm::SessionType sessionType, bool skipSessionMessage);
+  bool RestoreSession();
+  void SaveSession();
   bool SendSessionMessage();
 
   WV_DRM &drm_;
   std::string session_;
   AP4_DataBuffer pssh_, challenge_;
   std::string m_defaultKeyId;
+  bool m_isPersistentSession{false};
+  std::string m_licenseStoreKey;
+  uint64_t m_expireTime{0};
   struct WVSKEY
   {
     bool operator == (WVSKEY const &other) const { return keyid == other.keyid; };
@@ -226,6 +248,8 @@ private:
   int resolution_limit_;
 
   AP4_DataBuffer decrypt_in_, decrypt_out_;
+  std::vector<cdm::SubsampleEntry> m_subsamples; // Reused between the samples
+  bool m_isBatchDecrypt{false};
 
   struct FINFO
   {
@@ -254,13 +278,16 @@ private:
                 const AP4_DataBuffer& inputData,
                 const unsigned int subsampleCount,
                 const uint8_t* iv,
-                const FINFO& fragInfo,
+                const uint8_t* keyId,
+                const CryptoInfo& cryptoInfo,
                 const std::vector<cdm::SubsampleEntry>& subsamples);
   uint32_t promise_id_;
   bool drained_;
 
   std::list<media::CdmVideoFrame> m_videoFrames;
   std::mutex renewal_lock_;
+  // Serialize the license requests of the decrypt and the deferred license acquisition
+  std::mutex m_licenseRequestMutex;
   CryptoMode m_EncryptionMode;
 
   std::optional<cdm::VideoDecoderConfig_3> m_currentVideoDecConfig;
@@ -298,6 +325,9 @@ public:
 
   media::CdmAdapter *GetCdmAdapter() { return wv_adapter.get(); };
   const std::string &GetLicenseURL() { return license_url_; };
+  const CLicenseRequestTemplate& GetLicenseTemplate() const { return m_licenseTemplate; }
+  const CLicenseStore& GetLicenseStore() const { return m_licenseStore; }
+  bool IsPersistentStorage() const { return m_isPersistentStorage; }
 
   cdm::Status DecryptAndDecodeFrame(void* hostInstance, cdm::InputBuffer_2 &cdm_in, media::CdmVideoFrame *frame)
   {
@@ -313,6 +343,9 @@ public:
 private:
   std::shared_ptr<media::CdmAdapter> wv_adapter;
   std::string license_url_;
+  CLicenseRequestTemplate m_licenseTemplate;
+  CLicenseStore m_licenseStore;
+  bool m_isPersistentStorage;
   void *host_instance_;
 
   std::vector<WV_CencSingleSampleDecrypter*> ssds;
@@ -320,6 +353,7 @@ private:
 
 WV_DRM::WV_DRM(const char* licenseURL, const AP4_DataBuffer &serverCert, const uint8_t config)
   : license_url_(licenseURL)
+  , m_isPersistentStorage((config & SSD::SSD_DECRYPTER::CONFIG_PERSISTENTSTORAGE) != 0)
   , host_instance_(0)
 {
   std::string strLibPath = GLOBAL::Host->GetLibraryPath();
@@ -355,12 +389,13 @@ WV_DRM::WV_DRM(const char* licenseURL, const AP4_DataBuffer &serverCert, const u
   strBasePath += buffer;
   strBasePath += cSep;
   GLOBAL::Host->CreateDir(strBasePath.c_str());
+  m_licenseStore.SetBasePath(strBasePath);
 
   wv_adapter = std::shared_ptr<media::CdmAdapter>(new media::CdmAdapter(
     "com.widevine.alpha",
     strLibPath,
     strBasePath,
-    media::CdmConfig(false, (config & SSD::SSD_DECRYPTER::CONFIG_PERSISTENTSTORAGE) != 0),
+    media::CdmConfig(false, m_isPersistentStorage),
     dynamic_cast<media::CdmAdapterClient*>(this)));
   if (!wv_adapter->valid())
   {
@@ -371,10 +406,21 @@ WV_DRM::WV_DRM(const char* licenseURL, const AP4_DataBuffer &serverCert, const u
 
   if (serverCert.GetDataSize())
     wv_adapter->SetServerCertificate(0, serverCert.GetData(), serverCert.GetDataSize());
+  else
+  {
+    // Avoid the service certificate request to the license server
+    std::string storedCert;
+    if (m_licenseStore.LoadServiceCertificate(storedCert, CLicenseStore::Now()))
+    {
+      LOG::Log(SSDDEBUG, "Use stored Service Certificate");
+      wv_adapter->SetServerCertificate(0, reinterpret_cast<const uint8_t*>(storedCert.data()),
+                                       static_cast<uint32_t>(storedCert.size()));
+    }
+  }
 
-  // For backward compatibility: If no | is found in URL, use the most common working config
-  if (license_url_.find('|') == std::string::npos)
-    license_url_ += "|Content-Type=application%2Foctet-stream|R{SSM}|";
+  // A bare URL is completed with the default headers by the key system handler
+  if (!m_licenseTemplate.Compile(license_url_))
+    LOG::Log(SSDERROR, "License URL: %s", m_licenseTemplate.GetError().c_str());
 
   //wv_adapter->GetStatusForPolicy();
   //wv_adapter->QueryOutputProtectionStatus();
@@ -406,6 +452,8 @@ void WV_DRM::OnCDMMessage(const char* session, uint32_t session_size, CDMADPMSG
   }
   else if (msg == CDMADPMSG::kSessionKeysChange)
     (*b)->AddSessionKey(data, data_size, status);
+  else if (msg == CDMADPMSG::kSessionExpired)
+    (*b)->SetExpiration(data, data_size);
 };
 
 /*----------------------------------------------------------------------
@@ -470,8 +518,39 @@ WV_CencSingleSampleDecrypter::WV_CencSingleSampleDecrypter(WV_DRM& drm,
     pssh_.SetData(buf, buf_size);
   }
 
-  drm.GetCdmAdapter()->CreateSessionAndGenerateRequest(promise_id_++, cdm::SessionType::kTemporary, cdm::InitDataType::kCenc,
-    reinterpret_cast<const uint8_t *>(pssh_.GetData()), pssh_.GetDataSize());
+  if (drm_.IsPersistentStorage() && !skipSessionMessage)
+  {
+    m_licenseStoreKey = CLicenseStore::MakeKey(
+        drm_.GetLicenseURL(), m_defaultKeyId,
+        {reinterpret_cast<const char*>(pssh_.GetData()), pssh_.GetDataSize()});
+
+    if (RestoreSession())
+      return;
+
+    m_isPersistentSession = true;
+    if (CreateSession(cdm::SessionType::kPersistentLicense, skipSessionMessage))
+      return;
+
+    // The CDM or the license server may not support persistent licenses
+    LOG::Log(SSDWARNING, "Persistent license not available, fallback to temporary session");
+    m_isPersistentSession = false;
+    CloseSessionId();
+  }
+
+  CreateSession(cdm::SessionType::kTemporary, skipSessionMessage);
+}
+
+WV_CencSingleSampleDecrypter::~WV_CencSingleSampleDecrypter()
+{
+  drm_.removessd(this);
+}
+
+bool WV_CencSingleSampleDecrypter::CreateSession(cdm::SessionType sessionType,
+                                                 bool skipSessionMessage)
+{
+  drm_.GetCdmAdapter()->CreateSessionAndGenerateRequest(
+      promise_id_++, sessionType, cdm::InitDataType::kCenc,
+      reinterpret_cast<const uint8_t*>(pssh_.GetData()), pssh_.GetDataSize());
 
   int retrycount=0;
   while (session_.empty() && ++retrycount < 100)
@@ -480,18 +559,75 @@ WV_CencSingleSampleDecrypter::WV_CencSingleSampleDecrypter(WV_DRM& drm,
   if (session_.empty())
   {
     LOG::LogF(SSDERROR, "Cannot perform License update, no session available");
-    return;
+    return false;
   }
 
   if (skipSessionMessage)
-    return;
+    return true;
 
   while (challenge_.GetDataSize() > 0 && SendSessionMessage());
+
+  return !keys_.empty();
 }
 
-WV_CencSingleSampleDecrypter::~WV_CencSingleSampleDecrypter()
+bool WV_CencSingleSampleDecrypter::RestoreSession()
 {
-  drm_.removessd(this);
+  const CLicenseStore& licenseStore{drm_.GetLicenseStore()};
+  CLicenseStore::Entry entry;
+
+  if (!licenseStore.Load(m_licenseStoreKey, entry, CLicenseStore::Now()) ||
+      entry.m_sessionId.empty())
+    return false;
+
+  LOG::Log(SSDDEBUG, "Restoring stored license session ID: %s", entry.m_sessionId.c_str());
+
+  {
+    // The CDM does not report the session id of a loaded session, set it
+    // before loading to have the CDM messages routed to this decrypter
+    std::lock_guard<std::mutex> lock(renewal_lock_);
+    session_ = entry.m_sessionId;
+  }
+  drm_.GetCdmAdapter()->LoadSession(promise_id_++, cdm::SessionType::kPersistentLicense,
+                                    session_.data(), static_cast<uint32_t>(session_.size()));
+
+  int retrycount = 0;
+  while (keys_.empty() && ++retrycount < 100)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  const bool hasUsableKey = std::any_of(keys_.begin(), keys_.end(), [](const WVSKEY& key)
+                                        { return key.status == cdm::KeyStatus::kUsable; });
+  if (!hasUsableKey)
+  {
+    LOG::Log(SSDWARNING, "Cannot restore the stored license, a new license will be requested");
+    licenseStore.Remove(m_licenseStoreKey);
+    CloseSessionId();
+    keys_.clear();
+    challenge_.SetDataSize(0);
+    return false;
+  }
+
+  m_isPersistentSession = true;
+  // Keep the expiration time when just updated by the CDM
+  if (m_expireTime == 0)
+    m_expireTime = entry.m_expireTime;
+  LOG::Log(SSDDEBUG, "License restored from persistent storage");
+  // Handle a license renewal requested by the CDM while loading
+  CheckLicenseRenewal();
+  return true;
+}
+
+void WV_CencSingleSampleDecrypter::SaveSession()
+{
+  if (!m_isPersistentSession || session_.empty() || keys_.empty())
+    return;
+
+  CLicenseStore::Entry entry;
+  entry.m_storeTime = CLicenseStore::Now();
+  entry.m_expireTime = m_expireTime;
+  entry.m_sessionId = session_;
+
+  if (!drm_.GetLicenseStore().Save(m_licenseStoreKey, entry))
+    LOG::LogF(SSDWARNING, "Cannot store the license of session ID: %s", session_.c_str());
 }
 
 void WV_CencSingleSampleDecrypter::GetCapabilities(const uint8_t* key, uint32_t media, SSD_DECRYPTER::SSD_CAPS &caps)
@@ -545,7 +681,7 @@ void WV_CencSingleSampleDecrypter::GetCapabilities(const uint8_t* key, uint32_t
     try {
       encb[0] = 12;
       clearb[0] = 0;
-      if (DecryptSampleData(poolid, in, out, iv, 1, clearb, encb) != AP4_SUCCESS)
+      if (DecryptSampleData(poolid, in, out, iv, 1, clearb, encb, nullptr) != AP4_SUCCESS)
       {
         LOG::LogF(SSDDEBUG, "Single decrypt failed, secure path only");
         if (media == SSD_DECRYPTER::SSD_CAPS::SSD_MEDIA_VIDEO)
@@ -595,6 +731,7 @@ AP4_DataBuffer WV_CencSingleSampleDecrypter::GetChallengeData()
 
 void WV_CencSingleSampleDecrypter::CheckLicenseRenewal()
 {
+  std::lock_guard<std::mutex> requestLock(m_licenseRequestMutex);
   {
     std::lock_guard<std::mutex> lock(renewal_lock_);
     if (!challenge_.GetDataSize())
@@ -603,14 +740,19 @@ void WV_CencSingleSampleDecrypter::CheckLicenseRenewal()
   SendSessionMessage();
 }
 
+bool WV_CencSingleSampleDecrypter::AcquirePendingLicense()
+{
+  CheckLicenseRenewal();
+  return !keys_.empty();
+}
+
 bool WV_CencSingleSampleDecrypter::SendSessionMessage()
 {
-  std::vector<std::string> blocks{StringUtils::Split(drm_.GetLicenseURL(), '|')};
+  const CLicenseRequestTemplate& licenseTemplate{drm_.GetLicenseTemplate()};
 
-  if (blocks.size() != 4)
+  if (!licenseTemplate.IsValid())
   {
-    LOG::LogF(SSDERROR, "Wrong \"|\" blocks in license URL. Four blocks (req | header | body | "
-                        "response) are expected in license URL");
+    LOG::LogF(SSDERROR, "%s", licenseTemplate.GetError().c_str());
     return false;
   }
 
@@ -625,219 +767,27 @@ bool WV_CencSingleSampleDecrypter::SendSessionMessage()
     SSD_UTILS::SaveFile(debugFilePath, data);
   }
 
-  //Process placeholder in GET String
-  std::string::size_type insPos(blocks[0].find("{SSM}"));
-  if (insPos != std::string::npos)
-  {
-    if (insPos > 0 && blocks[0][insPos - 1] == 'B')
-    {
-      std::string msgEncoded{BASE64::Encode(challenge_.GetData(), challenge_.GetDataSize())};
-      msgEncoded = STRING::URLEncode(msgEncoded);
-      blocks[0].replace(insPos - 1, 6, msgEncoded);
-    }
-    else
-    {
-      LOG::Log(SSDERROR, "Unsupported License request template (command)");
-      return false;
-    }
-  }
-
-  insPos = blocks[0].find("{HASH}");
-  if (insPos != std::string::npos)
-  {
-    DIGEST::MD5 md5;
-    md5.Update(challenge_.GetData(), challenge_.GetDataSize());
-    md5.Finalize();
-    blocks[0].replace(insPos, 6, md5.HexDigest());
-  }
-
-  void* file = GLOBAL::Host->CURLCreate(blocks[0].c_str());
-
-  size_t nbRead;
-  std::string response, resLimit, contentType;
-  char buf[2048];
-  bool serverCertRequest;
-
-  //Set our std headers
-  GLOBAL::Host->CURLAddOption(file, SSD_HOST::OPTION_PROTOCOL, "acceptencoding", "gzip, deflate");
-  GLOBAL::Host->CURLAddOption(file, SSD_HOST::OPTION_PROTOCOL, "seekable", "0");
-  GLOBAL::Host->CURLAddOption(file, SSD_HOST::OPTION_HEADER, "Expect", "");
-
-  //Process headers
-  std::vector<std::string> headers{StringUtils::Split(blocks[1], '&')};
-  for (std::string& headerStr : headers)
-  {
-    std::vector<std::string> header{StringUtils::Split(headerStr, '=')};
-    if (!header.empty())
-    {
-      StringUtils::Trim(header[0]);
-      std::string value;
-      if (header.size() > 1)
-      {
-        StringUtils::Trim(header[1]);
-        value = STRING::URLDecode(header[1]);
-      }
-      GLOBAL::Host->CURLAddOption(file, SSD_HOST::OPTION_PROTOCOL, header[0].c_str(),
-                                  value.c_str());
-    }
-  }
-
-  //Process body
-  if (!blocks[2].empty())
-  {
-    if (blocks[2][0] == '%')
-      blocks[2] = STRING::URLDecode(blocks[2]);
-
-    insPos = blocks[2].find("{SSM}");
-    if (insPos != std::string::npos)
-    {
-      std::string::size_type sidPos(blocks[2].find("{SID}"));
-      std::string::size_type kidPos(blocks[2].find("{KID}"));
-
-      char fullDecode = 0;
-      if (insPos > 1 && sidPos > 1 && kidPos > 1 && (blocks[2][0] == 'b' || blocks[2][0] == 'B') && blocks[2][1] == '{')
-      {
-        fullDecode = blocks[2][0];
-        blocks[2] = blocks[2].substr(2, blocks[2].size() - 3);
-        insPos -= 2;
-        if (kidPos != std::string::npos)
-          kidPos -= 2;
-        if (sidPos != std::string::npos)
-          sidPos -= 2;
-      }
-
-      size_t size_written(0);
-
-      if (insPos > 0)
-      {
-        if (blocks[2][insPos - 1] == 'B' || blocks[2][insPos - 1] == 'b')
-        {
-          std::string msgEncoded{BASE64::Encode(challenge_.GetData(), challenge_.GetDataSize())};
-          if (blocks[2][insPos - 1] == 'B') {
-            msgEncoded = STRING::URLEncode(msgEncoded);
-          }
-          blocks[2].replace(insPos - 1, 6, msgEncoded);
-          size_written = msgEncoded.size();
-        }
-        else if (blocks[2][insPos - 1] == 'D')
-        {
-          std::string msgEncoded{STRING::ToDecimal(challenge_.GetData(), challenge_.GetDataSize())};
-          blocks[2].replace(insPos - 1, 6, msgEncoded);
-          size_written = msgEncoded.size();
-        }
-        else
-        {
-          blocks[2].replace(insPos - 1, 6, reinterpret_cast<const char*>(challenge_.GetData()), challenge_.GetDataSize());
-          size_written = challenge_.GetDataSize();
-        }
-      }
-      else
-      {
-        LOG::Log(SSDERROR, "Unsupported License request template (body / ?{SSM})");
-        goto SSMFAIL;
-      }
-
-      if (sidPos != std::string::npos && insPos < sidPos)
-        sidPos += size_written, sidPos -= 6;
-
-      if (kidPos != std::string::npos && insPos < kidPos)
-        kidPos += size_written, kidPos -= 6;
-
-      size_written = 0;
-
-      if (sidPos != std::string::npos)
-      {
-        if (sidPos > 0)
-        {
-          if (blocks[2][sidPos - 1] == 'B' || blocks[2][sidPos - 1] == 'b')
-          {
-            std::string msgEncoded{BASE64::Encode(session_)};
-
-            if (blocks[2][sidPos - 1] == 'B') {
-              msgEncoded = STRING::URLEncode(msgEncoded);
-            }
-            
-            blocks[2].replace(sidPos - 1, 6, msgEncoded);
-            size_written = msgEncoded.size();
-          }
-          else
-          {
-            blocks[2].replace(sidPos - 1, 6, session_.data(), session_.size());
-            size_written = session_.size();
-          }
-        }
-        else
-        {
-          LOG::LogF(SSDERROR, "Unsupported License request template (body / ?{SID})");
-          goto SSMFAIL;
-        }
-      }
-
-      if (kidPos != std::string::npos)
-      {
-        if (sidPos < kidPos)
-          kidPos += size_written, kidPos -= 6;
-
-        if (blocks[2][kidPos - 1] == 'H')
-        {
-          std::string keyIdUUID{StringUtils::ToHexadecimal(m_defaultKeyId)};
-          blocks[2].replace(kidPos - 1, 6, keyIdUUID.c_str(), 32);
-        }
-        else
-        {
-          std::string kidUUID{ConvertKIDtoUUID(m_defaultKeyId)};
-          blocks[2].replace(kidPos, 5, kidUUID.c_str(), 36);
-        }
-      }
-
-      if (fullDecode)
-      {
-        std::string msgEncoded{BASE64::Encode(blocks[2])};
-        if (fullDecode == 'B')
-        {
-          msgEncoded = STRING::URLEncode(msgEncoded);
-        }
-        blocks[2] = msgEncoded;
-      }
-    }
+  CLicenseRequestTemplate::RequestData requestData;
+  requestData.m_challenge = {reinterpret_cast<const char*>(challenge_.GetData()),
+                             challenge_.GetDataSize()};
+  requestData.m_sessionId = session_;
+  requestData.m_defaultKeyId = m_defaultKeyId;
+  requestData.m_pssh = {reinterpret_cast<const char*>(pssh_.GetData()), pssh_.GetDataSize()};
 
-    std::string encData{BASE64::Encode(blocks[2])};
-    GLOBAL::Host->CURLAddOption(file, SSD_HOST::OPTION_PROTOCOL, "postdata", encData.c_str());
-  }
+  bool serverCertRequest{challenge_.GetDataSize() == 2};
 
-  serverCertRequest = challenge_.GetDataSize() == 2;
+  CLicenseExchange exchange{*GLOBAL::Host, licenseTemplate};
+  const bool isSent{exchange.Send(requestData)};
   challenge_.SetDataSize(0);
 
-  if (!GLOBAL::Host->CURLOpen(file))
+  if (!isSent)
   {
-    LOG::Log(SSDERROR, "License server returned failure");
-    goto SSMFAIL;
-  }
-
-  // read the file
-  while ((nbRead = GLOBAL::Host->ReadFile(file, buf, 1024)) > 0)
-    response += std::string((const char*)buf, nbRead);
-
-  resLimit =
-      GLOBAL::Host->CURLGetProperty(file, SSD_HOST::CURLPROPERTY::PROPERTY_HEADER, "X-Limit-Video");
-  contentType =
-      GLOBAL::Host->CURLGetProperty(file, SSD_HOST::CURLPROPERTY::PROPERTY_HEADER, "Content-Type");
-
-  if (!resLimit.empty())
-  {
-    std::string::size_type posMax = resLimit.find("max=");
-    if (posMax != std::string::npos)
-      resolution_limit_ = std::atoi(resLimit.data() + (posMax + 4));
+    LOG::LogF(SSDERROR, "%s", exchange.GetError().c_str());
+    return false;
   }
 
-  GLOBAL::Host->CloseFile(file);
-  file = 0;
-
-  if (nbRead != 0)
-  {
-    LOG::LogF(SSDERROR, "Could not read full SessionMessage response");
-    goto SSMFAIL;
-  }
+  if (exchange.GetResolutionLimit() > 0)
+    resolution_limit_ = exchange.GetResolutionLimit();
 
   if (GLOBAL::Host->IsDebugSaveLicense())
   {
@@ -846,119 +796,25 @@ bool WV_CencSingleSampleDecrypter::SendSessionMessage()
     std::string debugFilePath = GLOBAL::Host->GetProfilePath();
     debugFilePath += "EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED.response";
 
-    SSD_UTILS::SaveFile(debugFilePath, response);
+    SSD_UTILS::SaveFile(debugFilePath, exchange.GetResponse());
   }
 
-  if (serverCertRequest && contentType.find("application/octet-stream") == std::string::npos)
+  if (serverCertRequest && !exchange.IsBinaryResponse())
     serverCertRequest = false;
 
-  if (!blocks[3].empty() && !serverCertRequest)
+  std::string response;
+  if (!exchange.GetLicense(serverCertRequest, response, hdcp_limit_))
   {
-    if (blocks[3][0] == 'J' || (blocks[3].size() > 1 && blocks[3][0] == 'B' && blocks[3][1] == 'J'))
-    {
-      int dataPos = 2;
-
-      if (response.size() >= 3 && blocks[3][0] == 'B')
-      {
-        response = BASE64::Decode(response);
-        dataPos = 3;
-      }
-
-      jsmn_parser jsn;
-      jsmntok_t tokens[256];
-
-      jsmn_init(&jsn);
-      int i(0), numTokens = jsmn_parse(&jsn, response.c_str(), response.size(), tokens, 256);
-
-      std::vector<std::string> jsonVals{StringUtils::Split(blocks[3].substr(dataPos), ';')};
-
-      // Find HDCP limit
-      if (jsonVals.size() > 1)
-      {
-        for (; i < numTokens; ++i)
-          if (tokens[i].type == JSMN_STRING && tokens[i].size == 1 && jsonVals[1].size() == static_cast<unsigned int>(tokens[i].end - tokens[i].start)
-            && strncmp(response.c_str() + tokens[i].start, jsonVals[1].c_str(), tokens[i].end - tokens[i].start) == 0)
-            break;
-        if (i < numTokens)
-          hdcp_limit_ = std::atoi((response.c_str() + tokens[i + 1].start));
-      }
-      // Find license key
-      if (jsonVals.size() > 0)
-      {
-        for (i = 0; i < numTokens; ++i)
-          if (tokens[i].type == JSMN_STRING && tokens[i].size == 1 && jsonVals[0].size() == static_cast<unsigned int>(tokens[i].end - tokens[i].start)
-            && strncmp(response.c_str() + tokens[i].start, jsonVals[0].c_str(), tokens[i].end - tokens[i].start) == 0)
-          {
-            if (i + 1 < numTokens && tokens[i + 1].type == JSMN_ARRAY && tokens[i + 1].size == 1)
-              ++i;
-            break;
-          }
-      }
-      else
-        i = numTokens;
-
-      if (i < numTokens)
-      {
-        std::string respData{
-            response.substr(tokens[i + 1].start, tokens[i + 1].end - tokens[i + 1].start)};
+    LOG::LogF(SSDERROR, "%s", exchange.GetError().c_str());
+    return false;
+  }
 
-        if (blocks[3][dataPos - 1] == 'B')
-        {
-          respData = BASE64::Decode(respData);
-        }
+  drm_.GetCdmAdapter()->UpdateSession(++promise_id_, session_.data(), session_.size(),
+                                      reinterpret_cast<const uint8_t*>(response.data()),
+                                      response.size());
 
-        drm_.GetCdmAdapter()->UpdateSession(++promise_id_, session_.data(), session_.size(),
-                                            reinterpret_cast<const uint8_t*>(respData.c_str()),
-                                            respData.size());
-      }
-      else
-      {
-        LOG::LogF(SSDERROR, "Unable to find %s in JSON string", blocks[3].c_str() + 2);
-        goto SSMFAIL;
-      }
-    }
-    else if (blocks[3][0] == 'H' && blocks[3].size() >= 2)
-    {
-      //Find the payload
-      std::string::size_type payloadPos = response.find("\r\n\r\n");
-      if (payloadPos != std::string::npos)
-      {
-        payloadPos += 4;
-        if (blocks[3][1] == 'B')
-          drm_.GetCdmAdapter()->UpdateSession(++promise_id_, session_.data(), session_.size(),
-            reinterpret_cast<const uint8_t*>(response.c_str() + payloadPos), response.size() - payloadPos);
-        else
-        {
-          LOG::LogF(SSDERROR, "Unsupported HTTP payload data type definition");
-          goto SSMFAIL;
-        }
-      }
-      else
-      {
-        LOG::LogF(SSDERROR, "Unable to find HTTP payload in response");
-        goto SSMFAIL;
-      }
-    }
-    else if (blocks[3][0] == 'B' && blocks[3].size() == 1)
-    {
-      std::string decRespData{BASE64::Decode(response)};
-
-      drm_.GetCdmAdapter()->UpdateSession(++promise_id_, session_.data(), session_.size(),
-                                          reinterpret_cast<const uint8_t*>(decRespData.c_str()),
-                                          decRespData.size());
-    }
-    else
-    {
-      LOG::LogF(SSDERROR, "Unsupported License request template (response)");
-      goto SSMFAIL;
-    }
-  }
-  else // its binary - simply push the returned data as update
-  {
-    drm_.GetCdmAdapter()->UpdateSession(++promise_id_, session_.data(), session_.size(),
-                                        reinterpret_cast<const uint8_t*>(response.data()),
-                                        response.size());
-  }
+  if (serverCertRequest)
+    drm_.GetLicenseStore().SaveServiceCertificate(response, CLicenseStore::Now());
 
   if (keys_.empty())
   {
@@ -967,14 +823,10 @@ bool WV_CencSingleSampleDecrypter::SendSessionMessage()
     return false;
   }
 
+  SaveSession();
+
   LOG::Log(SSDDEBUG, "License update successful");
   return true;
-
-SSMFAIL:
-  if (file)
-    GLOBAL::Host->CloseFile(file);
-
-  return false;
 }
 
 void WV_CencSingleSampleDecrypter::AddSessionKey(const uint8_t *data, size_t data_size, uint32_t status)
@@ -988,6 +840,27 @@ void WV_CencSingleSampleDecrypter::AddSessionKey(const uint8_t *data, size_t dat
   res->status = static_cast<cdm::KeyStatus>(status);
 }
 
+void WV_CencSingleSampleDecrypter::SetExpiration(const uint8_t* data, size_t data_size)
+{
+  cdm::Time expiryTime;
+  if (data_size != sizeof(expiryTime))
+    return;
+
+  std::memcpy(&expiryTime, data, sizeof(expiryTime));
+  // Zero, NaN or infinity means that the license never expires
+  const uint64_t expireTime{std::isfinite(expiryTime) && expiryTime > 0
+                                ? static_cast<uint64_t>(expiryTime)
+                                : 0};
+  if (expireTime == m_expireTime)
+    return;
+
+  m_expireTime = expireTime;
+  LOG::Log(SSDDEBUG, "License expiration time changed: %llu",
+           static_cast<unsigned long long>(m_expireTime));
+  // The expiration can change after the license has been stored
+  SaveSession();
+}
+
 /*----------------------------------------------------------------------
 |   WV_CencSingleSampleDecrypter::SetKeyId
 +---------------------------------------------------------------------*/
@@ -1092,7 +965,8 @@ void WV_CencSingleSampleDecrypter::SetInput(cdm::InputBuffer_2& cdmInputBuffer,
                                             const AP4_DataBuffer& inputData,
                                             const unsigned int subsampleCount,
                                             const uint8_t* iv,
-                                            const FINFO& fragInfo,
+                                            const uint8_t* keyId,
+                                            const CryptoInfo& cryptoInfo,
                                             const std::vector<cdm::SubsampleEntry>& subsamples)
 {
   cdmInputBuffer.data = inputData.GetData();
@@ -1100,12 +974,12 @@ void WV_CencSingleSampleDecrypter::SetInput(cdm::InputBuffer_2& cdmInputBuffer,
   cdmInputBuffer.num_subsamples = subsampleCount;
   cdmInputBuffer.iv = iv;
   cdmInputBuffer.iv_size = 16; //Always 16, see AP4_CencSingleSampleDecrypter declaration.
-  cdmInputBuffer.key_id = fragInfo.key_;
+  cdmInputBuffer.key_id = keyId;
   cdmInputBuffer.key_id_size = 16;
   cdmInputBuffer.subsamples = subsamples.data();
-  cdmInputBuffer.encryption_scheme = media::ToCdmEncryptionScheme(fragInfo.m_cryptoInfo.m_mode);
+  cdmInputBuffer.encryption_scheme = media::ToCdmEncryptionScheme(cryptoInfo.m_mode);
   cdmInputBuffer.timestamp = 0;
-  cdmInputBuffer.pattern = {fragInfo.m_cryptoInfo.m_cryptBlocks, fragInfo.m_cryptoInfo.m_skipBlocks};
+  cdmInputBuffer.pattern = {cryptoInfo.m_cryptBlocks, cryptoInfo.m_skipBlocks};
 }
 
 /*----------------------------------------------------------------------
@@ -1117,7 +991,8 @@ AP4_Result WV_CencSingleSampleDecrypter::DecryptSampleData(AP4_UI32 pool_id,
   const AP4_UI08* iv,
   unsigned int    subsample_count,
   const AP4_UI16* bytes_of_cleartext_data,
-  const AP4_UI32* bytes_of_encrypted_data)
+  const AP4_UI32* bytes_of_encrypted_data,
+  const SampleKeyInfo* sampleKeyInfo)
 {
   if (!drm_.GetCdmAdapter())
   {
@@ -1127,6 +1002,17 @@ AP4_Result WV_CencSingleSampleDecrypter::DecryptSampleData(AP4_UI32 pool_id,
 
   FINFO &fragInfo(fragment_pool_[pool_id]);
 
+  // The sample can be encrypted with a different key / pattern of the fragment
+  const AP4_UI08* key{fragInfo.key_};
+  CryptoInfo cryptoInfo{fragInfo.m_cryptoInfo};
+  if (sampleKeyInfo)
+  {
+    if (sampleKeyInfo->m_keyId)
+      key = sampleKeyInfo->m_keyId;
+    cryptoInfo.m_cryptBlocks = sampleKeyInfo->m_cryptBlocks;
+    cryptoInfo.m_skipBlocks = sampleKeyInfo->m_skipBlocks;
+  }
+
   if(fragInfo.decrypter_flags_ & SSD_DECRYPTER::SSD_CAPS::SSD_SECURE_PATH) //we can not decrypt only
   {
     if (fragInfo.nal_length_size_ > 4)
@@ -1151,7 +1037,7 @@ AP4_Result WV_CencSingleSampleDecrypter::DecryptSampleData(AP4_UI32 pool_id,
       data_out.AppendData(reinterpret_cast<const AP4_Byte*>(bytes_of_cleartext_data), subsample_count * sizeof(AP4_UI16));
       data_out.AppendData(reinterpret_cast<const AP4_Byte*>(bytes_of_encrypted_data), subsample_count * sizeof(AP4_UI32));
       data_out.AppendData(reinterpret_cast<const AP4_Byte*>(iv), 16);
-      data_out.AppendData(reinterpret_cast<const AP4_Byte*>(fragInfo.key_), 16);
+      data_out.AppendData(reinterpret_cast<const AP4_Byte*>(key), 16);
     }
     else
     {
@@ -1237,7 +1123,7 @@ AP4_Result WV_CencSingleSampleDecrypter::DecryptSampleData(AP4_UI32 pool_id,
     return AP4_SUCCESS;
   }
 
-  if (!fragInfo.key_)
+  if (!key)
   {
     LOG::LogF(SSDDEBUG, "No Key");
     return AP4_ERROR_INVALID_PARAMETERS;
@@ -1264,10 +1150,10 @@ AP4_Result WV_CencSingleSampleDecrypter::DecryptSampleData(AP4_UI32 pool_id,
     bytes_of_encrypted_data = &cipherb;
   }
   cdm::Status ret{cdm::Status::kSuccess};
-  std::vector<cdm::SubsampleEntry> subsamples;
-  subsamples.reserve(subsample_count);
+  std::vector<cdm::SubsampleEntry>& subsamples{m_subsamples};
+  subsamples.clear();
 
-  bool useCbcDecrypt{fragInfo.m_cryptoInfo.m_mode == CryptoMode::AES_CBC};
+  bool useCbcDecrypt{cryptoInfo.m_mode == CryptoMode::AES_CBC};
   
   // We can only decrypt with subsamples set to 1
   // This must be handled differently for CENC and CBCS
@@ -1321,13 +1207,15 @@ AP4_Result WV_CencSingleSampleDecrypter::DecryptSampleData(AP4_UI32 pool_id,
     }
 
     cdm::InputBuffer_2 cdm_in;
-    SetInput(cdm_in, decrypt_in_, 1, iv, fragInfo, subsamples);
+    SetInput(cdm_in, decrypt_in_, 1, iv, key, cryptoInfo, subsamples);
     decrypt_out_.SetDataSize(decrypt_in_.GetDataSize());
     CdmBuffer buf{&decrypt_out_};
     CdmDecryptedBlock cdm_out;
     cdm_out.SetDecryptedBuffer(&buf);
 
-    CheckLicenseRenewal();
+    // On batch decrypt the renewal is checked once for all the samples
+    if (!m_isBatchDecrypt)
+      CheckLicenseRenewal();
     ret = drm_.GetCdmAdapter()->Decrypt(cdm_in, &cdm_out);
 
     if (ret == cdm::Status::kSuccess)
@@ -1350,12 +1238,139 @@ AP4_Result WV_CencSingleSampleDecrypter::DecryptSampleData(AP4_UI32 pool_id,
     }
     else
     {
-      LogDecryptError(ret, fragInfo.key_);
+      LogDecryptError(ret, key);
     }
   }
   return (ret == cdm::Status::kSuccess) ? AP4_SUCCESS : AP4_ERROR_INVALID_PARAMETERS;
 }
 
+AP4_Result WV_CencSingleSampleDecrypter::DecryptSampleBatch(AP4_UI32 poolId,
+                                                            SampleDecryptDesc* samples,
+                                                            size_t count)
+{
+  if (!drm_.GetCdmAdapter() || poolId >= fragment_pool_.size())
+    return Adaptive_CencSingleSampleDecrypter::DecryptSampleBatch(poolId, samples, count);
+
+  // The renewal is checked once for all the samples
+  CheckLicenseRenewal();
+
+  const FINFO& fragInfo{fragment_pool_[poolId]};
+  const bool isCtrDecrypt{
+      !(fragInfo.decrypter_flags_ & SSD_DECRYPTER::SSD_CAPS::SSD_SECURE_PATH) &&
+      fragInfo.m_cryptoInfo.m_mode != CryptoMode::AES_CBC};
+
+  m_isBatchDecrypt = true;
+  AP4_Result result{AP4_SUCCESS};
+  for (size_t i = 0; i < count;)
+  {
+    // The 'cenc' samples that continue the counter of the previous sample are
+    // decrypted with a single CDM request, the others one by one
+    const size_t run{isCtrDecrypt ? GetCtrSampleRun(samples + i, count - i) : 1};
+    if (run > 1)
+      DecryptCtrSampleRun(poolId, samples + i, run);
+    else
+    {
+      SampleDecryptDesc& sample{samples[i]};
+      sample.m_result = DecryptSampleData(poolId, *sample.m_dataIn, *sample.m_dataOut,
+                                          sample.m_iv, sample.m_subsampleCount,
+                                          sample.m_clearBytes, sample.m_cipherBytes,
+                                          sample.m_keyInfo);
+    }
+
+    for (size_t end{i + run}; i < end; ++i)
+    {
+      if (AP4_FAILED(samples[i].m_result) && AP4_SUCCEEDED(result))
+        result = samples[i].m_result;
+    }
+  }
+  m_isBatchDecrypt = false;
+  return result;
+}
+
+void WV_CencSingleSampleDecrypter::DecryptCtrSampleRun(AP4_UI32 poolId,
+                                                       SampleDecryptDesc* samples,
+                                                       size_t count)
+{
+  const FINFO& fragInfo{fragment_pool_[poolId]};
+  const AP4_UI08* key{samples[0].m_keyInfo && samples[0].m_keyInfo->m_keyId
+                          ? samples[0].m_keyInfo->m_keyId
+                          : fragInfo.key_};
+  if (!key)
+  {
+    LOG::LogF(SSDDEBUG, "No Key");
+    for (size_t i = 0; i < count; ++i)
+      samples[i].m_result = AP4_ERROR_INVALID_PARAMETERS;
+    return;
+  }
+
+  // Join the encrypted data of all the samples in a single AES-CTR stream
+  AP4_UI64 encryptedSize{0};
+  for (size_t i = 0; i < count; ++i)
+    encryptedSize += GetEncryptedSize(samples[i]);
+
+  decrypt_in_.Reserve(static_cast<AP4_Size>(encryptedSize));
+  decrypt_in_.SetDataSize(0);
+  for (size_t i = 0; i < count; ++i)
+  {
+    SampleDecryptDesc& sample{samples[i]};
+    if (sample.m_subsampleCount == 0)
+    {
+      decrypt_in_.AppendData(sample.m_dataIn->GetData(), sample.m_dataIn->GetDataSize());
+      continue;
+    }
+    size_t pos{0};
+    for (unsigned int subsamplePos{0}; subsamplePos < sample.m_subsampleCount; ++subsamplePos)
+    {
+      UnpackSubsampleData(*sample.m_dataIn, pos, subsamplePos, sample.m_clearBytes,
+                          sample.m_cipherBytes);
+    }
+  }
+
+  std::vector<cdm::SubsampleEntry>& subsamples{m_subsamples};
+  subsamples.clear();
+  SetCdmSubsamples(subsamples, false);
+
+  cdm::InputBuffer_2 cdm_in;
+  SetInput(cdm_in, decrypt_in_, 1, samples[0].m_iv, key, fragInfo.m_cryptoInfo, subsamples);
+  decrypt_out_.SetDataSize(decrypt_in_.GetDataSize());
+  CdmBuffer buf{&decrypt_out_};
+  CdmDecryptedBlock cdm_out;
+  cdm_out.SetDecryptedBuffer(&buf);
+
+  const cdm::Status ret{drm_.GetCdmAdapter()->Decrypt(cdm_in, &cdm_out)};
+  if (ret != cdm::Status::kSuccess)
+  {
+    LogDecryptError(ret, key);
+    for (size_t i = 0; i < count; ++i)
+      samples[i].m_result = AP4_ERROR_INVALID_PARAMETERS;
+    return;
+  }
+
+  // Split the decrypted stream back to the samples
+  size_t cipherPos{0};
+  for (size_t i = 0; i < count; ++i)
+  {
+    SampleDecryptDesc& sample{samples[i]};
+    AP4_DataBuffer& dataOut{*sample.m_dataOut};
+    dataOut.SetDataSize(0);
+    if (sample.m_subsampleCount == 0)
+    {
+      dataOut.AppendData(decrypt_out_.GetData() + cipherPos, sample.m_dataIn->GetDataSize());
+      cipherPos += sample.m_dataIn->GetDataSize();
+    }
+    else
+    {
+      size_t pos{0};
+      for (unsigned int subsamplePos{0}; subsamplePos < sample.m_subsampleCount; ++subsamplePos)
+      {
+        RepackSubsampleData(*sample.m_dataIn, dataOut, pos, cipherPos, subsamplePos,
+                            sample.m_clearBytes, sample.m_cipherBytes);
+      }
+    }
+    sample.m_result = AP4_SUCCESS;
+  }
+}
+
 bool WV_CencSingleSampleDecrypter::OpenVideoDecoder(const SSD_VIDEOINITDATA* initData)
 {
   cdm::VideoDecoderConfig_3 vconfig = media::ToCdmVideoDecoderConfig(initData, m_EncryptionMode);
@@ -8,15 +8,16 @@
 
 #include "../src/common/AdaptiveDecrypter.h"
 #include "../src/utils/Base64Utils.h"
-#include "../src/utils/DigestMD5Utils.h"
 #include "../src/utils/StringUtils.h"
 #include "../src/utils/Utils.h"
 #include "ClassLoader.h"
 #include "Helper.h"
+#include "LicenseExchange.h"
+#include "LicenseRequestTemplate.h"
+#include "LicenseStore.h"
 #include "jni/src/MediaDrm.h"
 #include "jni/src/MediaDrmOnEventListener.h"
 #include "jni/src/UUID.h"
-#include "jsmn.h"
 #include "kodi/tools/StringUtils.h"
 
 #include <chrono>
@@ -46,12 +47,19 @@ enum WV_KEYSYSTEM
 class WV_DRM
 {
 public:
-  WV_DRM(WV_KEYSYSTEM ks, const char* licenseURL, const AP4_DataBuffer &serverCert, jni::CJNIMediaDrmOnEventListener *listener);
+  WV_DRM(WV_KEYSYSTEM ks,
+         const char* licenseURL,
+         const AP4_DataBuffer& serverCert,
+         const uint8_t config,
+         jni::CJNIMediaDrmOnEventListener* listener);
   ~WV_DRM();
 
   jni::CJNIMediaDrm *GetMediaDrm() { return media_drm_; };
 
   const std::string &GetLicenseURL() const { return license_url_; };
+  const CLicenseRequestTemplate& GetLicenseTemplate() const { return m_licenseTemplate; }
+  const CLicenseStore& GetLicenseStore() const { return m_licenseStore; }
+  bool IsPersistentStorage() const { return m_isPersistentStorage; }
 
   const uint8_t *GetKeySystem() const
   {
@@ -71,13 +79,20 @@ private:
   WV_KEYSYSTEM key_system_;
   jni::CJNIMediaDrm *media_drm_;
   std::string license_url_;
-  std::string m_strBasePath;
+  CLicenseRequestTemplate m_licenseTemplate;
+  CLicenseStore m_licenseStore;
+  bool m_isPersistentStorage;
 };
 
-WV_DRM::WV_DRM(WV_KEYSYSTEM ks, const char* licenseURL, const AP4_DataBuffer &serverCert, jni::CJNIMediaDrmOnEventListener *listener)
+WV_DRM::WV_DRM(WV_KEYSYSTEM ks,
+               const char* licenseURL,
+               const AP4_DataBuffer& serverCert,
+               const uint8_t config,
+               jni::CJNIMediaDrmOnEventListener* listener)
   : key_system_(ks)
   , media_drm_(0)
   , license_url_(licenseURL)
+  , m_isPersistentStorage((config & SSD::SSD_DECRYPTER::CONFIG_PERSISTENTSTORAGE) != 0)
 {
   std::string strBasePath = GLOBAL::Host->GetProfilePath();
   char cSep = strBasePath.back();
@@ -104,7 +119,7 @@ WV_DRM::WV_DRM(WV_KEYSYSTEM ks, const char* licenseURL, const AP4_DataBuffer &se
   strBasePath += buffer;
   strBasePath += cSep;
   GLOBAL::Host->CreateDir(strBasePath.c_str());
-  m_strBasePath = strBasePath;
+  m_licenseStore.SetBasePath(strBasePath);
 
   int64_t mostSigBits(0), leastSigBits(0);
   const uint8_t *keySystem = GetKeySystem();
@@ -163,15 +178,9 @@ WV_DRM::WV_DRM(WV_KEYSYSTEM ks, const char* licenseURL, const AP4_DataBuffer &se
            "MediaDrm initialized (Device unique ID size: %ld, System ID: %s, Security level: %s)",
            strDeviceId.size(), strSystemId.c_str(), strSecurityLevel.c_str());
 
-  if (license_url_.find('|') == std::string::npos)
-  {
-    if (key_system_ == WIDEVINE)
-      license_url_ += "|Content-Type=application%2Foctet-stream|R{SSM}|";
-    else if (key_system_ == PLAYREADY)
-      license_url_ += "|Content-Type=text%2Fxml&SOAPAction=http%3A%2F%2Fschemas.microsoft.com%2FDRM%2F2007%2F03%2Fprotocols%2FAcquireLicense|R{SSM}|";
-    else
-      license_url_ += "|Content-Type=application/json|R{SSM}|";
-  }
+  // A bare URL is completed with the default headers by the key system handler
+  if (!m_licenseTemplate.Compile(license_url_))
+    LOG::Log(SSDERROR, "License URL: %s", m_licenseTemplate.GetError().c_str());
 }
 
 WV_DRM::~WV_DRM()
@@ -190,40 +199,18 @@ WV_DRM::~WV_DRM()
 
 void WV_DRM::LoadServiceCertificate()
 {
-  std::string filename = m_strBasePath + "service_certificate";
-  char* data(nullptr);
-  size_t sz(0);
-  FILE *f = fopen(filename.c_str(), "rb");
-
-  if (f)
+  std::string certificate;
+  if (m_licenseStore.LoadServiceCertificate(certificate, CLicenseStore::Now()))
   {
-    fseek(f, 0L, SEEK_END);
-    sz = ftell(f);
-    fseek(f, 0L, SEEK_SET);
-    if (sz > 8 && (data = (char*)malloc(sz)))
-      fread(data, 1, sz, f);
-    fclose(f);
-  }
-  if (data)
-  {
-    auto now = std::chrono::system_clock::now();
-    uint64_t certTime = *((uint64_t*)data), nowTime = std::chrono::time_point_cast<std::chrono::seconds>(now).time_since_epoch().count();
-
-    if (certTime < nowTime && nowTime - certTime < 86400)
-      media_drm_->setPropertyByteArray("serviceCertificate", std::vector<char>(data + 8, data + sz));
-    else
-      free(data), data = nullptr;
+    LOG::Log(SSDDEBUG, "Use stored Service Certificate");
+    media_drm_->setPropertyByteArray("serviceCertificate",
+                                     std::vector<char>(certificate.begin(), certificate.end()));
   }
-  if (!data)
+  else
   {
     LOG::Log(SSDDEBUG, "Requesting new Service Certificate");
     media_drm_->setPropertyString("privacyMode", "enable");
   }
-  else
-  {
-    LOG::Log(SSDDEBUG, "Use stored Service Certificate");
-    free(data), data = nullptr;
-  }
 }
 
 void WV_DRM::SaveServiceCertificate()
@@ -242,16 +229,8 @@ void WV_DRM::SaveServiceCertificate()
     return;
   }
 
-  std::string filename = m_strBasePath + "service_certificate";
-  FILE *f = fopen(filename.c_str(), "wb");
-  if (f)
-  {
-    auto now = std::chrono::system_clock::now();
-    uint64_t nowTime = std::chrono::time_point_cast<std::chrono::seconds>(now).time_since_epoch().count();
-    fwrite((char*)&nowTime, 1, sizeof(uint64_t), f);
-    fwrite(sc.data(), 1, sc.size(), f);
-    fclose(f);
-  }
+  if (!m_licenseStore.SaveServiceCertificate({sc.data(), sc.size()}, CLicenseStore::Now()))
+    LOG::LogF(SSDWARNING, "Cannot store the Service Certificate");
 }
 
 /*----------------------------------------------------------------------
@@ -267,7 +246,7 @@ public:
                                std::string_view defaultKeyId);
   ~WV_CencSingleSampleDecrypter();
 
-  bool StartSession(bool skipSessionMessage) { return KeyUpdateRequest(true, skipSessionMessage); };
+  bool StartSession(bool skipSessionMessage);
   const std::vector<char> &GetSessionIdRaw() { return session_id_; };
   virtual const char *GetSessionId() override;
   std::vector<char> GetChallengeData();
@@ -296,7 +275,10 @@ public:
     const AP4_UI16* bytes_of_cleartext_data,
 
     // array of <subsample_count> integers. NULL if subsample_count is 0
-    const AP4_UI32* bytes_of_encrypted_data) override;
+    const AP4_UI32* bytes_of_encrypted_data,
+
+    // per-sample key, NULL to use the fragment one
+    const SampleKeyInfo* sampleKeyInfo) override;
 
   void GetCapabilities(const uint8_t *keyid, uint32_t media, SSD_DECRYPTER::SSD_CAPS &caps);
 
@@ -304,13 +286,17 @@ public:
 
 private:
   bool ProvisionRequest();
+  bool RestoreKeys();
+  void SaveKeys();
   bool GetKeyRequest(std::vector<char>& keyRequestData);
   bool KeyUpdateRequest(bool waitForKeys, bool skipSessionMessage);
   bool SendSessionMessage(const std::vector<char> &keyRequestData);
 
   WV_DRM &media_drm_;
   std::vector<char> pssh_, initial_pssh_;
-  std::map<std::string, std::string> optParams_;
+  std::map<std::string, std::string> optParams_, initialOptParams_;
+  bool m_isOfflineLicense{false};
+  std::string m_licenseStoreKey;
 
   std::vector<char> session_id_;
   std::vector<char> keySetId_;
@@ -390,6 +376,14 @@ WV_CencSingleSampleDecrypter::WV_CencSingleSampleDecrypter(WV_DRM& drm,
 
   if (optionalKeyParameter)
     optParams_["PRCustomData"] = optionalKeyParameter;
+  initialOptParams_ = optParams_;
+
+  if (media_drm_.IsPersistentStorage())
+  {
+    m_isOfflineLicense = true;
+    m_licenseStoreKey = CLicenseStore::MakeKey(media_drm_.GetLicenseURL(), m_defaultKeyId,
+                                               {initial_pssh_.data(), initial_pssh_.size()});
+  }
 
   /*
   std::vector<char> pui = media_drm_.GetMediaDrm()->getPropertyByteArray("provisioningUniqueId");
@@ -504,6 +498,77 @@ void WV_CencSingleSampleDecrypter::GetCapabilities(const uint8_t *keyid, uint32_
   caps.hdcpVersion = 99;
 }
 
+bool WV_CencSingleSampleDecrypter::StartSession(bool skipSessionMessage)
+{
+  if (m_isOfflineLicense && !skipSessionMessage)
+  {
+    if (RestoreKeys() || KeyUpdateRequest(true, false))
+      return true;
+
+    // The DRM or the license server may not support offline licenses
+    LOG::Log(SSDWARNING, "Offline license not available, fallback to streaming license");
+    pssh_ = initial_pssh_;
+    optParams_ = initialOptParams_;
+  }
+  m_isOfflineLicense = false;
+
+  return KeyUpdateRequest(true, skipSessionMessage);
+}
+
+bool WV_CencSingleSampleDecrypter::RestoreKeys()
+{
+  const CLicenseStore& licenseStore{media_drm_.GetLicenseStore()};
+  CLicenseStore::Entry entry;
+
+  if (!licenseStore.Load(m_licenseStoreKey, entry, CLicenseStore::Now()) ||
+      entry.m_sessionId.empty())
+    return false;
+
+  const std::vector<char> keySetId(entry.m_sessionId.begin(), entry.m_sessionId.end());
+  media_drm_.GetMediaDrm()->restoreKeys(session_id_, keySetId);
+  if (xbmc_jnienv()->ExceptionCheck())
+  {
+    LOG::LogF(SSDWARNING,
+              "Cannot restore the stored offline license, a new license will be requested");
+    xbmc_jnienv()->ExceptionClear();
+    licenseStore.Remove(m_licenseStoreKey);
+    return false;
+  }
+
+  keySetId_ = keySetId;
+  // Keys renewals use the license stored by the DRM
+  pssh_.clear();
+  optParams_.clear();
+  LOG::Log(SSDDEBUG, "License restored from persistent storage");
+  return true;
+}
+
+void WV_CencSingleSampleDecrypter::SaveKeys()
+{
+  if (!m_isOfflineLicense || keySetId_.empty())
+    return;
+
+  CLicenseStore::Entry entry;
+  entry.m_storeTime = CLicenseStore::Now();
+  entry.m_sessionId.assign(keySetId_.data(), keySetId_.size());
+
+  // Widevine report the remaining license duration in seconds
+  std::map<std::string, std::string> keyStatus =
+      media_drm_.GetMediaDrm()->queryKeyStatus(session_id_);
+  xbmc_jnienv()->ExceptionClear();
+  auto itDuration = keyStatus.find("LicenseDurationRemaining");
+  if (itDuration != keyStatus.end())
+  {
+    const long long duration{std::atoll(itDuration->second.c_str())};
+    // Huge values are used for unlimited durations
+    if (duration > 0 && static_cast<uint64_t>(duration) < CLicenseStore::LICENSE_MAX_AGE)
+      entry.m_expireTime = entry.m_storeTime + duration;
+  }
+
+  if (!media_drm_.GetLicenseStore().Save(m_licenseStoreKey, entry))
+    LOG::LogF(SSDWARNING, "Cannot store the offline license");
+}
+
 bool WV_CencSingleSampleDecrypter::ProvisionRequest()
 {
   LOG::Log(SSDWARNING, "Provision data request (DRM:%p)" , media_drm_.GetMediaDrm());
@@ -557,7 +622,10 @@ bool WV_CencSingleSampleDecrypter::ProvisionRequest()
 bool WV_CencSingleSampleDecrypter::GetKeyRequest(std::vector<char>& keyRequestData)
 {
   jni::CJNIMediaDrmKeyRequest keyRequest = media_drm_.GetMediaDrm()->getKeyRequest(
-      session_id_, pssh_, "video/mp4", jni::CJNIMediaDrm::KEY_TYPE_STREAMING, optParams_);
+      session_id_, pssh_, "video/mp4",
+      m_isOfflineLicense ? jni::CJNIMediaDrm::KEY_TYPE_OFFLINE
+                         : jni::CJNIMediaDrm::KEY_TYPE_STREAMING,
+      optParams_);
 
   if (xbmc_jnienv()->ExceptionCheck())
   {
@@ -625,12 +693,11 @@ bool WV_CencSingleSampleDecrypter::KeyUpdateRequest(bool waitKeys, bool skipSess
 
 bool WV_CencSingleSampleDecrypter::SendSessionMessage(const std::vector<char> &keyRequestData)
 {
-  std::vector<std::string> blocks{StringUtils::Split(media_drm_.GetLicenseURL(), '|')};
+  const CLicenseRequestTemplate& licenseTemplate{media_drm_.GetLicenseTemplate()};
 
-  if (blocks.size() != 4)
+  if (!licenseTemplate.IsValid())
   {
-    LOG::LogF(SSDERROR, "Wrong \"|\" blocks in license URL. Four blocks (req | header | body | "
-                        "response) are expected in license URL");
+    LOG::LogF(SSDERROR, "%s", licenseTemplate.GetError().c_str());
     return false;
   }
 
@@ -644,249 +711,38 @@ bool WV_CencSingleSampleDecrypter::SendSessionMessage(const std::vector<char> &k
     SSD_UTILS::SaveFile(debugFilePath, keyRequestData.data());
   }
 
-  //Process placeholder in GET String
-  std::string::size_type insPos(blocks[0].find("{SSM}"));
-  if (insPos != std::string::npos)
-  {
-    if (insPos>0 && blocks[0][insPos - 1] == 'B')
-    {
-      std::string msgEncoded{BASE64::Encode(keyRequestData.data(), keyRequestData.size())};
-      msgEncoded = STRING::URLEncode(msgEncoded);
-      blocks[0].replace(insPos - 1, 6, msgEncoded);
-    }
-    else
-    {
-      LOG::Log(SSDERROR, "Unsupported License request template (command)");
-      return false;
-    }
-  }
+  CLicenseRequestTemplate::RequestData requestData;
+  requestData.m_challenge = {keyRequestData.data(), keyRequestData.size()};
+  requestData.m_sessionId = {session_id_.data(), session_id_.size()};
+  requestData.m_defaultKeyId = m_defaultKeyId;
+  requestData.m_pssh = {initial_pssh_.data(), initial_pssh_.size()};
 
-  insPos = blocks[0].find("{HASH}");
-  if (insPos != std::string::npos)
+  CLicenseExchange exchange{*GLOBAL::Host, licenseTemplate};
+  exchange.DisableExpectHeader();
+  if (!exchange.Send(requestData))
   {
-    DIGEST::MD5 md5;
-    md5.Update(keyRequestData.data(), static_cast<uint32_t>(keyRequestData.size()));
-    md5.Finalize();
-    blocks[0].replace(insPos, 6, md5.HexDigest());
-  }
-
-  void* file = GLOBAL::Host->CURLCreate(blocks[0].c_str());
-
-  size_t nbRead;
-  std::string response, resLimit, contentType;
-  char buf[2048];
-
-  //Set our std headers
-  GLOBAL::Host->CURLAddOption(file, SSD_HOST::OPTION_PROTOCOL, "acceptencoding", "gzip, deflate");
-  GLOBAL::Host->CURLAddOption(file, SSD_HOST::OPTION_PROTOCOL, "seekable", "0");
-
-  //Process headers
-  std::vector<std::string> headers{StringUtils::Split(blocks[1], '&')};
-  for (std::string& headerStr : headers)
-  {
-    std::vector<std::string> header{StringUtils::Split(headerStr, '=')};
-    if (!header.empty())
-    {
-      StringUtils::Trim(header[0]);
-      std::string value;
-      if (header.size() > 1)
-      {
-        StringUtils::Trim(header[1]);
-        value = STRING::URLDecode(header[1]);
-      }
-      GLOBAL::Host->CURLAddOption(file, SSD_HOST::OPTION_PROTOCOL, header[0].c_str(),
-                                  value.c_str());
-    }
-  }
-
-  //Process body
-  if (!blocks[2].empty())
-  {
-    if (blocks[2][0] == '%')
-      blocks[2] = STRING::URLDecode(blocks[2]);
-
-    insPos = blocks[2].find("{SSM}");
-    if (insPos != std::string::npos)
-    {
-      std::string::size_type sidPos(blocks[2].find("{SID}"));
-      std::string::size_type kidPos(blocks[2].find("{KID}"));
-      std::string::size_type psshPos(blocks[2].find("{PSSH}"));
-
-      char fullDecode = 0;
-      if (insPos > 1 && sidPos > 1 && kidPos > 1 && (blocks[2][0] == 'b' || blocks[2][0] == 'B') && blocks[2][1] == '{')
-      {
-        fullDecode = blocks[2][0];
-        blocks[2] = blocks[2].substr(2, blocks[2].size() - 3);
-        insPos -= 2;
-        if (kidPos != std::string::npos)
-          kidPos -= 2;
-        if (sidPos != std::string::npos)
-          sidPos -= 2;
-        if (psshPos != std::string::npos)
-          psshPos -= 2;
-      }
-
-      size_t size_written(0);
-
-      if (insPos > 0)
-      {
-        if (blocks[2][insPos - 1] == 'B' || blocks[2][insPos - 1] == 'b')
-        {
-          std::string msgEncoded{BASE64::Encode(keyRequestData.data(), keyRequestData.size())};
-          if (blocks[2][insPos - 1] == 'B') {
-            msgEncoded = STRING::URLEncode(msgEncoded);
-          }
-          blocks[2].replace(insPos - 1, 6, msgEncoded);
-          size_written = msgEncoded.size();
-        }
-        else if (blocks[2][insPos - 1] == 'D')
-        {
-          std::string msgEncoded{STRING::ToDecimal(
-              reinterpret_cast<const uint8_t*>(keyRequestData.data()), keyRequestData.size())};
-          blocks[2].replace(insPos - 1, 6, msgEncoded);
-          size_written = msgEncoded.size();
-        }
-        else
-        {
-          blocks[2].replace(insPos - 1, 6, keyRequestData.data(), keyRequestData.size());
-          size_written =  keyRequestData.size();
-        }
-      }
-      else
-      {
-        LOG::Log(SSDERROR, "Unsupported License request template (body / ?{SSM})");
-        goto SSMFAIL;
-      }
-
-      if (sidPos != std::string::npos && insPos < sidPos)
-        sidPos += size_written, sidPos -= 6;
-
-      if (kidPos != std::string::npos && insPos < kidPos)
-        kidPos += size_written, kidPos -= 6;
-
-      if (psshPos != std::string::npos && insPos < psshPos)
-        psshPos += size_written, psshPos -= 6;
-
-      size_written = 0;
-
-      if (sidPos != std::string::npos)
-      {
-        if (sidPos > 0)
-        {
-          if (blocks[2][sidPos - 1] == 'B' || blocks[2][sidPos - 1] == 'b')
-          {
-            std::string msgEncoded{BASE64::Encode(session_id_.data(), session_id_.size())};
-            if (blocks[2][sidPos - 1] == 'B') {
-              msgEncoded = STRING::URLEncode(msgEncoded);
-            }
-            blocks[2].replace(sidPos - 1, 6, msgEncoded);
-            size_written = msgEncoded.size();
-          }
-          else
-          {
-            blocks[2].replace(sidPos - 1, 6, session_id_.data(), session_id_.size());
-            size_written = session_id_.size();
-          }
-        }
-        else
-        {
-          LOG::Log(SSDERROR, "Unsupported License request template (body / ?{SID})");
-          goto SSMFAIL;
-        }
-      }
-
-      if (kidPos != std::string::npos && sidPos < kidPos)
-        kidPos += size_written, kidPos -= 6;
-
-      if (psshPos != std::string::npos && sidPos < psshPos)
-        psshPos += size_written, psshPos -= 6;
-
-      size_t kidPlaceholderLen = 6;
-      if (kidPos != std::string::npos)
-      {
-        if (blocks[2][kidPos - 1] == 'H')
-        {
-          std::string keyIdUUID{StringUtils::ToHexadecimal(m_defaultKeyId)};
-          blocks[2].replace(kidPos - 1, 6, keyIdUUID.c_str(), 32);
-        }
-        else
-        {
-          std::string kidUUID{ConvertKIDtoUUID(m_defaultKeyId)};
-          blocks[2].replace(kidPos, 5, kidUUID.c_str(), 36);
-          kidPlaceholderLen = 5;
-        }
-      }
-
-      if (psshPos != std::string::npos && kidPos < psshPos)
-        psshPos += size_written, psshPos -= kidPlaceholderLen;
-
-      if (psshPos != std::string::npos)
-      {
-        std::string msgEncoded{BASE64::Encode(initial_pssh_.data(), initial_pssh_.size())};
-        if (blocks[2][psshPos - 1] == 'B') {
-          msgEncoded = STRING::URLEncode(msgEncoded);
-        }
-        blocks[2].replace(psshPos - 1, 7, msgEncoded);
-        size_written = msgEncoded.size();
-      }
-
-      if (fullDecode)
-      {
-        std::string msgEncoded{BASE64::Encode(blocks[2])};
-        if (fullDecode == 'B')
-        {
-          msgEncoded = STRING::URLEncode(msgEncoded);
-        }
-        blocks[2] = msgEncoded;
-      }
-
-      if (GLOBAL::Host->IsDebugSaveLicense())
-      {
-        //! @todo: with ssd_wv refactor the path must be combined with
-        //!        UTILS::FILESYS::PathCombine
-        std::string debugFilePath = GLOBAL::Host->GetProfilePath();
-        debugFilePath += "EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED.postdata";
-
-        SSD_UTILS::SaveFile(debugFilePath, blocks[2]);
-      }
-    }
-
-    std::string encData{BASE64::Encode(blocks[2])};
-    GLOBAL::Host->CURLAddOption(file, SSD_HOST::OPTION_PROTOCOL, "postdata", encData.c_str());
+    LOG::LogF(SSDERROR, "%s", exchange.GetError().c_str());
+    return false;
   }
 
-  if (!GLOBAL::Host->CURLOpen(file))
+  if (licenseTemplate.HasBodyPlaceholders() && GLOBAL::Host->IsDebugSaveLicense())
   {
-    LOG::Log(SSDERROR, "License server returned failure");
-    goto SSMFAIL;
-  }
-
-  // read the file
-  while ((nbRead = GLOBAL::Host->ReadFile(file, buf, 1024)) > 0)
-    response += std::string((const char*)buf, nbRead);
-
-  resLimit = GLOBAL::Host->CURLGetProperty(file, SSD_HOST::CURLPROPERTY::PROPERTY_HEADER, "X-Limit-Video");
-  contentType = GLOBAL::Host->CURLGetProperty(file, SSD_HOST::CURLPROPERTY::PROPERTY_HEADER, "Content-Type");
+    //! @todo: with ssd_wv refactor the path must be combined with
+    //!        UTILS::FILESYS::PathCombine
+    std::string debugFilePath = GLOBAL::Host->GetProfilePath();
+    debugFilePath += "EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED.postdata";
 
-  if (!resLimit.empty())
-  {
-    std::string::size_type posMax = resLimit.find("max=");
-    if (posMax != std::string::npos)
-      resolution_limit_ = std::atoi(resLimit.data() + (posMax + 4));
+    SSD_UTILS::SaveFile(debugFilePath, exchange.GetRequestBody());
   }
 
-  GLOBAL::Host->CloseFile(file);
-  file = 0;
+  if (exchange.GetResolutionLimit() > 0)
+    resolution_limit_ = exchange.GetResolutionLimit();
 
-  if (nbRead != 0)
-  {
-    LOG::LogF(SSDERROR, "Could not read full SessionMessage response");
-    goto SSMFAIL;
-  }
-  else if (response.empty())
+  std::string& response{exchange.GetResponse()};
+  if (response.empty())
   {
     LOG::LogF(SSDERROR, "Empty SessionMessage response - invalid");
-    goto SSMFAIL;
+    return false;
   }
 
   if (media_drm_.GetKeySystemType() == PLAYREADY && response.find("<LicenseNonce>") == std::string::npos)
@@ -913,99 +769,14 @@ bool WV_CencSingleSampleDecrypter::SendSessionMessage(const std::vector<char> &k
     SSD_UTILS::SaveFile(debugFilePath, response);
   }
 
-  if (!blocks[3].empty() && (keyRequestData.size() > 2 || contentType.find("application/octet-stream") == std::string::npos))
+  std::string license;
+  if (!exchange.GetLicense(keyRequestData.size() == 2, license, hdcp_limit_))
   {
-    if (blocks[3][0] == 'J' || (blocks[3].size() > 1 && blocks[3][0] == 'B' && blocks[3][1] == 'J'))
-    {
-      int dataPos = 2;
-
-      if (response.size() >= 3 && blocks[3][0] == 'B')
-      {
-        response = BASE64::Decode(response);
-        dataPos = 3;
-      }
-
-      jsmn_parser jsn;
-      jsmntok_t tokens[256];
-
-      jsmn_init(&jsn);
-      int i(0), numTokens = jsmn_parse(&jsn, response.c_str(), response.size(), tokens, 256);
-
-      std::vector<std::string> jsonVals{StringUtils::Split(blocks[3].substr(dataPos), ';')};
-
-      // Find HDCP limit
-      if (jsonVals.size() > 1)
-      {
-        for (; i < numTokens; ++i)
-          if (tokens[i].type == JSMN_STRING && tokens[i].size == 1 && jsonVals[1].size() == static_cast<unsigned int>(tokens[i].end - tokens[i].start)
-            && strncmp(response.c_str() + tokens[i].start, jsonVals[1].c_str(), tokens[i].end - tokens[i].start) == 0)
-            break;
-        if (i < numTokens)
-          hdcp_limit_ = atoi((response.c_str() + tokens[i + 1].start));
-      }
-      // Find license key
-      if (jsonVals.size() > 0)
-      {
-        for (i = 0; i < numTokens; ++i)
-          if (tokens[i].type == JSMN_STRING && tokens[i].size == 1 && jsonVals[0].size() == static_cast<unsigned int>(tokens[i].end - tokens[i].start)
-            && strncmp(response.c_str() + tokens[i].start, jsonVals[0].c_str(), tokens[i].end - tokens[i].start) == 0)
-          {
-            if (i + 1 < numTokens && tokens[i + 1].type == JSMN_ARRAY && tokens[i + 1].size == 1)
-              ++i;
-            break;
-          }
-      }
-      else
-        i = numTokens;
-
-      if (i < numTokens)
-      {
-        response = response.substr(tokens[i + 1].start, tokens[i + 1].end - tokens[i + 1].start);
-
-        if (blocks[3][dataPos - 1] == 'B')
-        {
-          response = BASE64::Decode(response);
-        }
-      }
-      else
-      {
-        LOG::LogF(SSDERROR, "Unable to find %s in JSON string", blocks[3].c_str() + 2);
-        goto SSMFAIL;
-      }
-    }
-    else if (blocks[3][0] == 'H' && blocks[3].size() >= 2)
-    {
-      //Find the payload
-      std::string::size_type payloadPos = response.find("\r\n\r\n");
-      if (payloadPos != std::string::npos)
-      {
-        payloadPos += 4;
-        if (blocks[3][1] == 'B')
-          response = std::string(response.c_str() + payloadPos, response.c_str() + response.size());
-        else
-        {
-          LOG::LogF(SSDERROR, "Unsupported HTTP payload data type definition");
-          goto SSMFAIL;
-        }
-      }
-      else
-      {
-        LOG::LogF(SSDERROR, "Unable to find HTTP payload in response");
-        goto SSMFAIL;
-      }
-    }
-    else if (blocks[3][0] == 'B' && blocks[3].size() == 1)
-    {
-      response = BASE64::Decode(response);
-    }
-    else
-    {
-      LOG::LogF(SSDERROR, "Unsupported License request template (response)");
-      goto SSMFAIL;
-    }
+    LOG::LogF(SSDERROR, "%s", exchange.GetError().c_str());
+    return false;
   }
 
-  keySetId_ = media_drm_.GetMediaDrm()->provideKeyResponse(session_id_, std::vector<char>(response.data(), response.data() + response.size()));
+  keySetId_ = media_drm_.GetMediaDrm()->provideKeyResponse(session_id_, std::vector<char>(license.data(), license.data() + license.size()));
   if (xbmc_jnienv()->ExceptionCheck())
   {
     LOG::LogF(SSDERROR, "provideKeyResponse has raised an exception");
@@ -1015,14 +786,11 @@ bool WV_CencSingleSampleDecrypter::SendSessionMessage(const std::vector<char> &k
 
   if (keyRequestData.size() == 2)
    media_drm_.SaveServiceCertificate();
+  else
+    SaveKeys();
 
   LOG::Log(SSDDEBUG, "License update successful");
   return true;
-
-SSMFAIL:
-  if (file)
-    GLOBAL::Host->CloseFile(file);
-  return false;
 }
 
 /*----------------------------------------------------------------------
@@ -1079,7 +847,8 @@ AP4_Result WV_CencSingleSampleDecrypter::DecryptSampleData(AP4_UI32 pool_id,
   const AP4_UI08* iv,
   unsigned int    subsample_count,
   const AP4_UI16* bytes_of_cleartext_data,
-  const AP4_UI32* bytes_of_encrypted_data)
+  const AP4_UI32* bytes_of_encrypted_data,
+  const SampleKeyInfo* sampleKeyInfo)
 {
   if (!media_drm_.GetMediaDrm())
     return AP4_ERROR_INVALID_STATE;
@@ -1110,7 +879,9 @@ AP4_Result WV_CencSingleSampleDecrypter::DecryptSampleData(AP4_UI32 pool_id,
       data_out.AppendData(reinterpret_cast<const AP4_Byte*>(bytes_of_cleartext_data), subsample_count * sizeof(AP4_UI16));
       data_out.AppendData(reinterpret_cast<const AP4_Byte*>(bytes_of_encrypted_data), subsample_count * sizeof(AP4_UI32));
       data_out.AppendData(reinterpret_cast<const AP4_Byte*>(iv), 16);
-      data_out.AppendData(reinterpret_cast<const AP4_Byte*>(fragInfo.key_), 16);
+      const AP4_UI08* key{sampleKeyInfo && sampleKeyInfo->m_keyId ? sampleKeyInfo->m_keyId
+                                                                  : fragInfo.key_};
+      data_out.AppendData(reinterpret_cast<const AP4_Byte*>(key), 16);
     }
     else
     {
@@ -1278,7 +1049,7 @@ public:
     if (key_system_ == NONE)
       return false;
 
-    cdmsession_ = new WV_DRM(key_system_, licenseURL, serverCertificate, this);
+    cdmsession_ = new WV_DRM(key_system_, licenseURL, serverCertificate, config, this);
 
     return cdmsession_->GetMediaDrm();
   }